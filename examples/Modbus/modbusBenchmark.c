@@ -0,0 +1,215 @@
+/*
+ * Measures the time per call of the functions in modbus.h, which run on every
+ * Modbus command sent to a LabJack. The buffers are the ones the functions
+ * see in use: a read of AIN0 to AIN13 (28 registers), whose response holds 14
+ * floats, responses holding ints and shorts, and a write of DAC0 and DAC1.
+ * Like testModbusFunctions, it does not need a LabJack, the Exodriver, or
+ * libusb. Each test repeats the calls for a time and prints the nanoseconds
+ * per call and the calls per second, so changes to modbus.c can be compared.
+ *
+ * Usage: modbusBenchmark [seconds per test]    (default 1)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "modbus.h"
+
+#define NUM_BUFFERS 64      // Buffers of each kind, so the data is not always the same
+#define BATCH_CALLS 4096
+#define NUM_AIN 14
+#define RESPONSE_SIZE (9 + NUM_AIN*4)   // Header, then 2 registers per AIN
+#define WRITE_SIZE (13 + 2*4 + 2)       // DAC0 and DAC1, 2 registers each
+
+static unsigned char readResponses[NUM_BUFFERS][RESPONSE_SIZE];
+static unsigned char sendBuffers[NUM_BUFFERS][WRITE_SIZE];
+static float dacValues[NUM_BUFFERS*2];
+
+static volatile double sink;
+
+static double getSeconds() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec/1.0e9;
+}
+
+// Pseudo-random numbers, the same on every run
+static unsigned int nextRandom() {
+    static unsigned int state = 0x12345678;
+
+    state = state*1664525 + 1013904223;
+    return state >> 8;
+}
+
+static void fillBuffers() {
+    int b, i;
+
+    for(b = 0; b < NUM_BUFFERS; b++) {
+        // Header of a Read Holding Registers response
+        readResponses[b][0] = 0;
+        readResponses[b][1] = (unsigned char)b;     // TransID
+        readResponses[b][2] = 0;
+        readResponses[b][3] = 0;                    // ProtocolID
+        readResponses[b][4] = 0;
+        readResponses[b][5] = 3 + NUM_AIN*4;        // Length
+        readResponses[b][6] = 0;                    // Unit ID
+        readResponses[b][7] = 3;                    // Function
+        readResponses[b][8] = NUM_AIN*4;            // Byte count
+
+        // AIN readings between -10 and 10 V
+        for(i = 0; i < NUM_AIN; i++) {
+            putFPIntoBuffer(readResponses[b], 9 + i*4, (nextRandom() % 20000)/1000.0f - 10.0f);
+        }
+
+        dacValues[b*2] = (nextRandom() % 5000)/1000.0f;
+        dacValues[b*2 + 1] = (nextRandom() % 5000)/1000.0f;
+    }
+}
+
+/*
+ * Each batch function makes BATCH_CALLS calls over the buffers and returns a
+ * sum of the results, so the calls are not optimized out.
+ */
+
+static double batchBuildRead() {
+    unsigned char sendBuffer[14];
+    double total = 0;
+    int i;
+
+    for(i = 0; i < BATCH_CALLS; i++) {
+        total += buildReadHoldingRegistersPacket(sendBuffer, 0, NUM_AIN*2, 0, 1);
+        total += sendBuffer[3];
+    }
+    return total;
+}
+
+static double batchParseFP() {
+    double total = 0;
+    int i;
+
+    for(i = 0; i < BATCH_CALLS; i++) {
+        total += parseFPRegisterResponse(readResponses[(i/NUM_AIN) % NUM_BUFFERS], 9 + (i % NUM_AIN)*4);
+    }
+    return total;
+}
+
+static double batchParseInt() {
+    double total = 0;
+    int i;
+
+    for(i = 0; i < BATCH_CALLS; i++) {
+        total += parseIntRegisterResponse(readResponses[(i/NUM_AIN) % NUM_BUFFERS], 9 + (i % NUM_AIN)*4);
+    }
+    return total;
+}
+
+static double batchParseShort() {
+    double total = 0;
+    int i;
+
+    for(i = 0; i < BATCH_CALLS; i++) {
+        total += parseShortRegisterResponse(readResponses[(i/(NUM_AIN*2)) % NUM_BUFFERS], 9 + (i % (NUM_AIN*2))*2);
+    }
+    return total;
+}
+
+static double batchBuildWrite() {
+    double total = 0;
+    int i;
+
+    for(i = 0; i < BATCH_CALLS; i++) {
+        total += buildWriteHoldingRegistersPacket(sendBuffers[i % NUM_BUFFERS], 5000, 4, 0, 1);
+    }
+    return total;
+}
+
+static double batchPutFP() {
+    double total = 0;
+    int i;
+
+    for(i = 0; i < BATCH_CALLS; i++) {
+        putFPIntoBuffer(sendBuffers[(i/2) % NUM_BUFFERS], 15 + (i % 2)*4, dacValues[i % (NUM_BUFFERS*2)]);
+        total += sendBuffers[(i/2) % NUM_BUFFERS][15];
+    }
+    return total;
+}
+
+static double batchPutInt() {
+    double total = 0;
+    int i;
+
+    for(i = 0; i < BATCH_CALLS; i++) {
+        putIntIntoBuffer(sendBuffers[(i/2) % NUM_BUFFERS], 15 + (i % 2)*4, 8675309 + i);
+        total += sendBuffers[(i/2) % NUM_BUFFERS][15];
+    }
+    return total;
+}
+
+static double batchPutShort() {
+    double total = 0;
+    int i;
+
+    for(i = 0; i < BATCH_CALLS; i++) {
+        putShortIntoBuffer(sendBuffers[(i/4) % NUM_BUFFERS], 15 + (i % 4)*2, (short)i);
+        total += sendBuffers[(i/4) % NUM_BUFFERS][15];
+    }
+    return total;
+}
+
+typedef struct {
+    const char *name;
+    double (*batch)();
+} ModbusTest;
+
+static const ModbusTest tests[] = {
+    {"buildReadHoldingRegistersPacket, 28 registers", batchBuildRead},
+    {"parseFPRegisterResponse, 14 AIN response", batchParseFP},
+    {"parseIntRegisterResponse", batchParseInt},
+    {"parseShortRegisterResponse", batchParseShort},
+    {"buildWriteHoldingRegistersPacket, 4 registers", batchBuildWrite},
+    {"putFPIntoBuffer, DAC0 and DAC1", batchPutFP},
+    {"putIntIntoBuffer", batchPutInt},
+    {"putShortIntoBuffer", batchPutShort},
+};
+#define NUM_TESTS (sizeof(tests)/sizeof(tests[0]))
+
+/*
+ * Runs a test in batches for the given number of seconds and prints the time
+ * per call.
+ */
+static void runTest(const ModbusTest *test, double seconds) {
+    unsigned long long calls = 0;
+    double start, elapsed, total = 0;
+
+    start = getSeconds();
+    do {
+        total += test->batch();
+        calls += BATCH_CALLS;
+        elapsed = getSeconds() - start;
+    } while(elapsed < seconds);
+    sink = total;
+
+    printf("%-46s %8.2f ns/call %11.0f calls/s\n", test->name, elapsed*1.0e9/calls, calls/elapsed);
+}
+
+int main(int argc, char **argv) {
+    double seconds = 1.0;
+    unsigned int i;
+
+    if(argc > 1) {
+        seconds = atof(argv[1]);
+    }
+    if(seconds <= 0) {
+        printf("Usage: %s [seconds per test]\n", argv[0]);
+        return 1;
+    }
+
+    fillBuffers();
+
+    for(i = 0; i < NUM_TESTS; i++) {
+        runTest(&tests[i], seconds);
+        fflush(stdout);
+    }
+
+    return 0;
+}
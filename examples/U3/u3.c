@@ -4,6 +4,68 @@
 
 #include "u3.h"
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include "labjacki2c.h"
+
+//Size of the calibration memory read by getCalibrationInfo (blocks 0-4)
+#define U3_CALIBRATION_MEM_SIZE    160
+#define U3_CALIBRATION_BLOCK_SIZE  32
+
+//ReadMem commands of the calibration memory written ahead of their responses
+#define U3_CALIBRATION_READ_AHEAD  4
+
+//Largest IOType data sizes of a Feedback command and response (64 byte packets)
+#define U3_FEEDBACK_MAX_COMMAND_DATA   57
+#define U3_FEEDBACK_MAX_RESPONSE_DATA  55
+
+//Number of handles whose ConfigIO and ConfigTimerClock settings are shadowed.
+//When more handles are used, the least recently used shadow is evicted.
+#define U3_MAX_CONFIG_SHADOWS  16
+
+//Shadow of a U3's ConfigIO and ConfigTimerClock settings.  Updated from every
+//ehConfigIO and ehConfigTimerClock response so the easy functions can skip
+//ConfigIO calls that would not change anything.
+struct U3_CONFIG_SHADOW {
+    HANDLE hDevice;
+    int configIOValid;
+    uint8 timerCounterConfig;
+    uint8 dac1Enable;
+    uint8 fioAnalog;
+    uint8 eioAnalog;
+    int timerClockValid;
+    uint8 timerClockConfig;
+    uint8 timerClockDivisor;
+    unsigned long lastUse;
+};
+
+static struct U3_CONFIG_SHADOW configShadows[U3_MAX_CONFIG_SHADOWS];
+
+//Counts the uses of the shadows, for evicting the least recently used one
+static unsigned long configShadowsUses = 0;
+
+//Protects configShadows, which is shared by the handles of all threads
+static pthread_mutex_t configShadowsMutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+//Number of LJTDACs (handle and pin pairs) whose calibration is cached
+#define U3_MAX_TDAC_CACHE  16
+
+//Cached LJTDAC calibration constants of a handle and DIOA pin
+struct U3_TDAC_CACHE {
+    HANDLE hDevice;
+    uint8 DIOAPinNum;
+    u3TdacCalibrationInfo caliInfo;
+};
+
+static struct U3_TDAC_CACHE tdacCache[U3_MAX_TDAC_CACHE];
+
+static void clearTdacCache(HANDLE hDevice);
+static long feedbackWrite(HANDLE hDevice, u3PreparedFeedback *feedback);
+static long feedbackRead(HANDLE hDevice, u3PreparedFeedback *feedback, uint8 *outErrorcode, uint8 *outErrorFrame);
 
 
 u3CalibrationInfo U3_CALIBRATION_INFO_DEFAULT = {
@@ -120,6 +182,10 @@ HANDLE openUSBConnection(int localID)
         hDevice = LJUSB_OpenDevice(dev, 0, U3_PRODUCT_ID);
         if( hDevice != NULL )
         {
+            //A new handle can have the value of a closed one, so a shadow
+            //left for that value is not used
+            invalidateConfigShadow(hDevice);
+
             if( localID < 0 )
             {
                 return hDevice;
@@ -188,10 +254,182 @@ locid_error:
 
 void closeUSBConnection(HANDLE hDevice)
 {
+    invalidateConfigShadow(hDevice);
+    clearTdacCache(hDevice);
     LJUSB_CloseDevice(hDevice);
 }
 
 
+//Returns the shadow of hDevice, or NULL if there is none.  If create is
+//nonzero, an unused (invalid) shadow is claimed for hDevice if needed, or the
+//least recently used shadow of another handle if all are in use; that handle
+//then reads its settings from the U3 again.  The caller must hold
+//configShadowsMutex.
+static struct U3_CONFIG_SHADOW * getConfigShadow(HANDLE hDevice, int create)
+{
+    struct U3_CONFIG_SHADOW *unused = NULL, *oldest = NULL;
+    int i;
+
+    if( hDevice == NULL )
+        return NULL;
+
+    for( i = 0; i < U3_MAX_CONFIG_SHADOWS; i++ )
+    {
+        if( configShadows[i].hDevice == hDevice )
+        {
+            configShadows[i].lastUse = ++configShadowsUses;
+            return &configShadows[i];
+        }
+        if( unused == NULL && configShadows[i].hDevice == NULL )
+            unused = &configShadows[i];
+        if( oldest == NULL || configShadows[i].lastUse < oldest->lastUse )
+            oldest = &configShadows[i];
+    }
+
+    if( create == 0 )
+        return NULL;
+    if( unused == NULL )
+        unused = oldest;
+
+    memset(unused, 0, sizeof(struct U3_CONFIG_SHADOW));
+    unused->hDevice = hDevice;
+    unused->lastUse = ++configShadowsUses;
+    return unused;
+}
+
+
+//Copies the shadow of hDevice to copy.  Returns 1 if hDevice has a shadow, 0
+//if it does not (copy is then zeroed, so its settings are not valid).
+static int copyConfigShadow(HANDLE hDevice, struct U3_CONFIG_SHADOW *copy)
+{
+    struct U3_CONFIG_SHADOW *shadow;
+
+    pthread_mutex_lock(&configShadowsMutex);
+    if( (shadow = getConfigShadow(hDevice, 0)) != NULL )
+        *copy = *shadow;
+    else
+        memset(copy, 0, sizeof(struct U3_CONFIG_SHADOW));
+    pthread_mutex_unlock(&configShadowsMutex);
+
+    return (shadow != NULL) ? 1 : 0;
+}
+
+
+//Updates the shadowed ConfigIO settings of hDevice from a response, or marks
+//them not valid if settings is NULL.
+static void setConfigIOShadow(HANDLE hDevice, const uint8 *settings)
+{
+    struct U3_CONFIG_SHADOW *shadow;
+
+    pthread_mutex_lock(&configShadowsMutex);
+    if( (shadow = getConfigShadow(hDevice, (settings != NULL) ? 1 : 0)) != NULL )
+    {
+        if( settings != NULL )
+        {
+            shadow->timerCounterConfig = settings[0];
+            shadow->dac1Enable = settings[1];
+            shadow->fioAnalog = settings[2];
+            shadow->eioAnalog = settings[3];
+        }
+        shadow->configIOValid = (settings != NULL) ? 1 : 0;
+    }
+    pthread_mutex_unlock(&configShadowsMutex);
+}
+
+
+//Updates the shadowed ConfigTimerClock settings of hDevice from a response,
+//or marks them not valid if settings is NULL.
+static void setTimerClockShadow(HANDLE hDevice, const uint8 *settings)
+{
+    struct U3_CONFIG_SHADOW *shadow;
+
+    pthread_mutex_lock(&configShadowsMutex);
+    if( (shadow = getConfigShadow(hDevice, (settings != NULL) ? 1 : 0)) != NULL )
+    {
+        if( settings != NULL )
+        {
+            shadow->timerClockConfig = settings[0] & 7;
+            shadow->timerClockDivisor = settings[1];
+        }
+        shadow->timerClockValid = (settings != NULL) ? 1 : 0;
+    }
+    pthread_mutex_unlock(&configShadowsMutex);
+}
+
+
+void invalidateConfigShadow(HANDLE hDevice)
+{
+    struct U3_CONFIG_SHADOW *shadow;
+
+    pthread_mutex_lock(&configShadowsMutex);
+    if( (shadow = getConfigShadow(hDevice, 0)) != NULL )
+        memset(shadow, 0, sizeof(struct U3_CONFIG_SHADOW));
+    pthread_mutex_unlock(&configShadowsMutex);
+}
+
+
+//Gets the current ConfigIO settings from the shadow, or with a ConfigIO read
+//if the shadow is not valid.  Returns -1 or errorcode (>1 value) on error, 0
+//on success.
+static long getConfigIOState(HANDLE hDevice, uint8 *timerCounterConfig, uint8 *dac1Enable, uint8 *fioAnalog, uint8 *eioAnalog)
+{
+    struct U3_CONFIG_SHADOW shadow;
+
+    copyConfigShadow(hDevice, &shadow);
+    if( shadow.configIOValid == 0 )
+        return ehConfigIO(hDevice, 0, 0, 0, 0, 0, timerCounterConfig, dac1Enable, fioAnalog, eioAnalog);
+
+    if( timerCounterConfig != NULL )
+        *timerCounterConfig = shadow.timerCounterConfig;
+    if( dac1Enable != NULL )
+        *dac1Enable = shadow.dac1Enable;
+    if( fioAnalog != NULL )
+        *fioAnalog = shadow.fioAnalog;
+    if( eioAnalog != NULL )
+        *eioAnalog = shadow.eioAnalog;
+    return 0;
+}
+
+
+//Sets the FIO and EIO lines in fioMask and eioMask as analog inputs with
+//ConfigIO, unless the shadowed settings show they already are.  dac1Enable
+//returns the DAC1Enable setting if it is not NULL.  Returns -1 or errorcode
+//(>1 value) on error, 0 on success.
+static long setAnalogLines(HANDLE hDevice, uint8 fioMask, uint8 eioMask, uint8 *dac1Enable)
+{
+    uint8 curTCConfig, curFIOAnalog, curEIOAnalog;
+    long error;
+
+    error = getConfigIOState(hDevice, &curTCConfig, dac1Enable, &curFIOAnalog, &curEIOAnalog);
+    if( error != 0 )
+        return error;
+
+    if( (fioMask | curFIOAnalog) == curFIOAnalog && (eioMask | curEIOAnalog) == curEIOAnalog )
+        return 0;
+
+    return ehConfigIO(hDevice, 12, curTCConfig, 0, fioMask | curFIOAnalog, eioMask | curEIOAnalog, NULL, NULL, NULL, NULL);
+}
+
+
+//Sets the FIO and EIO lines in fioMask and eioMask as digital with ConfigIO,
+//unless the shadowed settings show they already are.  Returns -1 or errorcode
+//(>1 value) on error, 0 on success.
+static long setDigitalLines(HANDLE hDevice, uint8 fioMask, uint8 eioMask)
+{
+    uint8 curTCConfig, curFIOAnalog, curEIOAnalog;
+    long error;
+
+    error = getConfigIOState(hDevice, &curTCConfig, NULL, &curFIOAnalog, &curEIOAnalog);
+    if( error != 0 )
+        return error;
+
+    if( (fioMask & curFIOAnalog) == 0 && (eioMask & curEIOAnalog) == 0 )
+        return 0;
+
+    return ehConfigIO(hDevice, 12, curTCConfig, 0, curFIOAnalog & ~fioMask, curEIOAnalog & ~eioMask, NULL, NULL, NULL, NULL);
+}
+
+
 long getTickCount()
 {
     struct timeval tv;
@@ -228,112 +466,351 @@ invalid:
 }
 
 
-long getCalibrationInfo(HANDLE hDevice, u3CalibrationInfo *caliInfo)
+//Reads the ConfigU3 response (38 bytes) without changing the configuration.
+static long readConfigU3(HANDLE hDevice, uint8 *recBuffer)
 {
-    uint8 sendBuffer[8], recBuffer[40];
-    uint8 cU3SendBuffer[26], cU3RecBuffer[38];
-    int sentRec = 0, offset = 0, i = 0;
+    uint8 sendBuffer[26];
+    int sentRec = 0, i = 0;
 
-    /* Sending ConfigU3 command to get hardware version and see if HV */
-    cU3SendBuffer[1] = (uint8)(0xF8);  //Command byte
-    cU3SendBuffer[2] = (uint8)(0x0A);  //Number of data words
-    cU3SendBuffer[3] = (uint8)(0x08);  //Extended command number
+    sendBuffer[1] = (uint8)(0xF8);  //command byte
+    sendBuffer[2] = (uint8)(0x0A);  //number of data words
+    sendBuffer[3] = (uint8)(0x08);  //extended command number
 
-    //Setting WriteMask0 and all other bytes to 0 since we only want to read the
-    //response
+    //setting WriteMask0 and all other bytes to 0 since we only want to read the response
     for( i = 6; i < 26; i++ )
-        cU3SendBuffer[i] = 0;
+        sendBuffer[i] = 0;
 
-    extendedChecksum(cU3SendBuffer, 26);
+    extendedChecksum(sendBuffer, 26);
 
-    sentRec = LJUSB_Write(hDevice, cU3SendBuffer, 26);
+    sentRec = LJUSB_Write(hDevice, sendBuffer, 26);
     if( sentRec < 26 )
     {
         if( sentRec == 0 )
-            goto writeError0;
+            printf("Error : getCalibrationInfo write failed\n");
         else
-            goto writeError1;
+            printf("Error : getCalibrationInfo did not write all of the buffer\n");
+        return -1;
     }
 
-    sentRec = LJUSB_Read(hDevice, cU3RecBuffer, 38);
+    sentRec = LJUSB_Read(hDevice, recBuffer, 38);
     if( sentRec < 38 )
     {
         if( sentRec == 0 )
-            goto readError0;
+            printf("Error : getCalibrationInfo read failed\n");
+        else
+            printf("Error : getCalibrationInfo did not read all of the buffer\n");
+        return -1;
+    }
+
+    if( recBuffer[1] != (uint8)(0xF8) || recBuffer[2] != (uint8)(0x10) || recBuffer[3] != (uint8)(0x08) )
+    {
+        printf("Error : getCalibrationInfo received wrong command bytes for ConfigU3\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+
+//Writes the ReadMem command of a block of calibration memory.
+static long writeCalibrationBlockRequest(HANDLE hDevice, int blockNum)
+{
+    uint8 sendBuffer[8];
+    int sentRec = 0;
+
+    sendBuffer[1] = (uint8)(0xF8);  //command byte
+    sendBuffer[2] = (uint8)(0x01);  //number of data words
+    sendBuffer[3] = (uint8)(0x2D);  //extended command number
+    sendBuffer[6] = 0;
+    sendBuffer[7] = (uint8)blockNum;  //Blocknum
+    extendedChecksum(sendBuffer, 8);
+
+    sentRec = LJUSB_Write(hDevice, sendBuffer, 8);
+    if( sentRec < 8 )
+    {
+        if( sentRec == 0 )
+            printf("Error : getCalibrationInfo write failed\n");
+        else
+            printf("Error : getCalibrationInfo did not write all of the buffer\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+
+//Reads the ReadMem response of a block of calibration memory.
+static long readCalibrationBlockResponse(HANDLE hDevice, uint8 *blockData)
+{
+    uint8 recBuffer[40];
+    int sentRec = 0;
+
+    sentRec = LJUSB_Read(hDevice, recBuffer, 40);
+    if( sentRec < 40 )
+    {
+        if( sentRec == 0 )
+            printf("Error : getCalibrationInfo read failed\n");
         else
-            goto readError1;
+            printf("Error : getCalibrationInfo did not read all of the buffer\n");
+        return -1;
+    }
+
+    if( recBuffer[1] != (uint8)(0xF8) || recBuffer[2] != (uint8)(0x11) || recBuffer[3] != (uint8)(0x2D) )
+    {
+        printf("Error : getCalibrationInfo received wrong command bytes for ReadMem\n");
+        return -1;
+    }
+
+    //block data starts on byte 8 of the buffer
+    memcpy(blockData, recBuffer + 8, U3_CALIBRATION_BLOCK_SIZE);
+
+    return 0;
+}
+
+
+//Reads all of the calibration memory.  Up to U3_CALIBRATION_READ_AHEAD ReadMem
+//commands are written before their responses are read, so the round trips of
+//the blocks overlap.
+static long readCalibrationMem(HANDLE hDevice, uint8 *calMem)
+{
+    int numBlocks = U3_CALIBRATION_MEM_SIZE/U3_CALIBRATION_BLOCK_SIZE;
+    int numWritten = 0, numRead = 0;
+
+    while( numRead < numBlocks )
+    {
+        while( numWritten < numBlocks && numWritten - numRead < U3_CALIBRATION_READ_AHEAD )
+        {
+            if( writeCalibrationBlockRequest(hDevice, numWritten) != 0 )
+            {
+                //Reading the responses already in flight, so the next command
+                //does not read one of them
+                for( ; numRead < numWritten; numRead++ )
+                    readCalibrationBlockResponse(hDevice, calMem + numRead*U3_CALIBRATION_BLOCK_SIZE);
+                return -1;
+            }
+            numWritten++;
+        }
+
+        if( readCalibrationBlockResponse(hDevice, calMem + numRead*U3_CALIBRATION_BLOCK_SIZE) != 0 )
+            return -1;
+        numRead++;
     }
 
-    if( cU3RecBuffer[1] != (uint8)(0xF8) || cU3RecBuffer[2] != (uint8)(0x10) ||
-        cU3RecBuffer[3] != (uint8)(0x08))
-        goto commandByteError;
+    return 0;
+}
+
+
+//Converts the calibration memory blocks to the calibration constants.
+static void decodeCalibrationMem(uint8 *calMem, u3CalibrationInfo *caliInfo)
+{
+    int i;
+
+    for( i = 0; i < 20; i++ )
+        caliInfo->ccConstants[i] = FPuint8ArrayToFPDouble(calMem, i*8);
+
+    caliInfo->prodID = 3;
+}
+
+
+long getCalibrationInfo(HANDLE hDevice, u3CalibrationInfo *caliInfo)
+{
+    uint8 recBuffer[38], calMem[U3_CALIBRATION_MEM_SIZE];
+
+    /* Sending ConfigU3 command to get hardware version and see if HV */
+    if( readConfigU3(hDevice, recBuffer) != 0 )
+        return -1;
 
-    caliInfo->hardwareVersion = cU3RecBuffer[14] + cU3RecBuffer[13]/100.0;
-    if( (cU3RecBuffer[37] & 18) == 18 )
+    caliInfo->hardwareVersion = recBuffer[14] + recBuffer[13]/100.0;
+    if( (recBuffer[37] & 18) == 18 )
         caliInfo->highVoltage = 1;
     else
         caliInfo->highVoltage = 0;
 
-    for( i = 0; i < 5; i++ )
-    {
-        /* Reading block i from memory */
-        sendBuffer[1] = (uint8)(0xF8);  //Command byte
-        sendBuffer[2] = (uint8)(0x01);  //Cumber of data words
-        sendBuffer[3] = (uint8)(0x2D);  //Extended command number
-        sendBuffer[6] = 0;
-        sendBuffer[7] = (uint8)i;  //Blocknum = i
-        extendedChecksum(sendBuffer, 8);
+    /* Reading blocks 0-4 from memory */
+    if( readCalibrationMem(hDevice, calMem) != 0 )
+        return -1;
+
+    decodeCalibrationMem(calMem, caliInfo);
+
+    return 0;
+}
+
+
+/* Calibration cache */
 
-        sentRec = LJUSB_Write(hDevice, sendBuffer, 8);
-        if( sentRec < 8 )
+//Header of a calibration cache file.  The header is followed by memSize bytes
+//of calibration memory.
+struct CALIBRATION_CACHE_HEADER {
+    char magic[4];        //"LJCC"
+    uint8 version;
+    uint8 prodID;
+    uint16 reserved;
+    uint32 key;           //calibrationMemKey of the calibration memory
+    uint32 serialNumber;
+    uint32 memSize;
+};
+
+//The key of a calibration memory copy:  the 32-bit FNV-1a hash of all of its
+//bytes, so a change to any block gives a different key.
+static uint32 calibrationMemKey(uint8 *calMem, int memSize)
+{
+    int i;
+    uint32 key = 2166136261u;
+
+    for( i = 0; i < memSize; i++ )
+        key = (key ^ calMem[i])*16777619u;
+
+    return key;
+}
+
+
+//Gets the path of the cache file of a device.  The default cache directory is
+//only created if createDir is nonzero.  Returns -1 if the cache is disabled or
+//there is no cache directory.
+static long getCalibrationCachePath(uint32 serialNumber, int createDir, char *path, int pathSize)
+{
+    char cacheDir[256];
+    const char *dir;
+
+    dir = getenv("LJ_CALIBRATION_CACHE_DIR");
+    if( dir == NULL )
+    {
+        if( (dir = getenv("XDG_CACHE_HOME")) != NULL && dir[0] != '\0' )
         {
-            if( sentRec == 0 )
-                goto writeError0;
-            else
-                goto writeError1;
+            snprintf(cacheDir, sizeof(cacheDir), "%s", dir);
         }
-
-        sentRec = LJUSB_Read(hDevice, recBuffer, 40);
-        if( sentRec < 40 )
+        else if( (dir = getenv("HOME")) != NULL && dir[0] != '\0' )
         {
-            if( sentRec == 0 )
-                goto readError0;
-            else
-                goto readError1;
+            snprintf(cacheDir, sizeof(cacheDir), "%s/.cache", dir);
         }
+        else
+            return -1;
+
+        if( createDir != 0 )
+            mkdir(cacheDir, 0755);
+        strncat(cacheDir, "/labjack", sizeof(cacheDir) - strlen(cacheDir) - 1);
+        if( createDir != 0 )
+            mkdir(cacheDir, 0755);
+        dir = cacheDir;
+    }
+
+    //An empty LJ_CALIBRATION_CACHE_DIR disables the cache
+    if( dir[0] == '\0' )
+        return -1;
+
+    if( snprintf(path, pathSize, "%s/u3_%u.cal", dir, serialNumber) >= pathSize )
+        return -1;
+
+    return 0;
+}
+
+
+//Reads a cache file.  Returns -1 if it is missing, it is for another device,
+//or its memory does not match its key.
+static long readCalibrationCache(const char *path, uint32 serialNumber, uint8 *calMem, int memSize)
+{
+    struct CALIBRATION_CACHE_HEADER header;
+    FILE *file;
+    long ret = -1;
+
+    if( (file = fopen(path, "rb")) == NULL )
+        return -1;
+
+    if( fread(&header, sizeof(header), 1, file) == 1 &&
+        memcmp(header.magic, "LJCC", 4) == 0 &&
+        header.version == 2 &&
+        header.prodID == 3 &&
+        header.serialNumber == serialNumber &&
+        header.memSize == (uint32)memSize &&
+        fread(calMem, 1, memSize, file) == (size_t)memSize &&
+        calibrationMemKey(calMem, memSize) == header.key )
+        ret = 0;
+
+    fclose(file);
+    return ret;
+}
+
+
+static void writeCalibrationCache(const char *path, uint32 serialNumber, uint8 *calMem, int memSize)
+{
+    struct CALIBRATION_CACHE_HEADER header;
+    char tmpPath[512];
+    FILE *file;
+    int ok;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "LJCC", 4);
+    header.version = 2;
+    header.prodID = 3;
+    header.key = calibrationMemKey(calMem, memSize);
+    header.serialNumber = serialNumber;
+    header.memSize = memSize;
+
+    //Writing to a temporary file and renaming it so other processes never
+    //read a partial file
+    if( snprintf(tmpPath, sizeof(tmpPath), "%s.%d", path, (int)getpid()) >= (int)sizeof(tmpPath) )
+        return;
+
+    if( (file = fopen(tmpPath, "wb")) == NULL )
+        return;
+
+    ok = (fwrite(&header, sizeof(header), 1, file) == 1 &&
+          fwrite(calMem, 1, memSize, file) == (size_t)memSize);
+    if( fclose(file) != 0 )
+        ok = 0;
+
+    if( !ok || rename(tmpPath, path) != 0 )
+        remove(tmpPath);
+}
+
+
+long getCalibrationInfoCached(HANDLE hDevice, u3CalibrationInfo *caliInfo, long CreateCacheDir)
+{
+    uint8 recBuffer[38], calMem[U3_CALIBRATION_MEM_SIZE], cachedMem[U3_CALIBRATION_MEM_SIZE];
+    uint32 serialNumber;
+    char path[512];
+    int cacheEnabled;
+
+    /* Sending ConfigU3 command to get the serial number, hardware version and
+     * see if HV */
+    if( readConfigU3(hDevice, recBuffer) != 0 )
+        return -1;
+
+    caliInfo->hardwareVersion = recBuffer[14] + recBuffer[13]/100.0;
+    if( (recBuffer[37] & 18) == 18 )
+        caliInfo->highVoltage = 1;
+    else
+        caliInfo->highVoltage = 0;
+    serialNumber = recBuffer[15] + recBuffer[16]*256 + recBuffer[17]*65536 + ((uint32)recBuffer[18])*16777216;
 
-        if( recBuffer[1] != (uint8)(0xF8) || recBuffer[2] != (uint8)(0x11) ||
-            recBuffer[3] != (uint8)(0x2D) )
-            goto commandByteError;
+    cacheEnabled = (getCalibrationCachePath(serialNumber, (int)CreateCacheDir, path, sizeof(path)) == 0);
 
-        offset = i * 4;
+    //Using the cached memory if block 0 of the device's memory matches it, one
+    //ReadMem round trip instead of one per block
+    if( cacheEnabled &&
+        readCalibrationCache(path, serialNumber, cachedMem, U3_CALIBRATION_MEM_SIZE) == 0 )
+    {
+        if( writeCalibrationBlockRequest(hDevice, 0) != 0 ||
+            readCalibrationBlockResponse(hDevice, calMem) != 0 )
+            return -1;
 
-        //Block data starts on byte 8 of the buffer
-        caliInfo->ccConstants[offset] = FPuint8ArrayToFPDouble(recBuffer + 8, 0);
-        caliInfo->ccConstants[offset + 1] = FPuint8ArrayToFPDouble(recBuffer + 8, 8);
-        caliInfo->ccConstants[offset + 2] = FPuint8ArrayToFPDouble(recBuffer + 8, 16);
-        caliInfo->ccConstants[offset + 3] = FPuint8ArrayToFPDouble(recBuffer + 8, 24);
+        if( memcmp(calMem, cachedMem, U3_CALIBRATION_BLOCK_SIZE) == 0 )
+        {
+            decodeCalibrationMem(cachedMem, caliInfo);
+            return 0;
+        }
     }
 
-    caliInfo->prodID = 3;
+    /* reading blocks 0-4 from memory */
+    if( readCalibrationMem(hDevice, calMem) != 0 )
+        return -1;
 
-    return 0;
+    decodeCalibrationMem(calMem, caliInfo);
+
+    if( cacheEnabled )
+        writeCalibrationCache(path, serialNumber, calMem, U3_CALIBRATION_MEM_SIZE);
 
-writeError0:
-    printf("Error : getCalibrationInfo write failed\n");
-    return -1;
-writeError1:
-    printf("Error : getCalibrationInfo did not write all of the buffer\n");
-    return -1;
-readError0:
-    printf("Error : getCalibrationInfo read failed\n");
-    return -1;
-readError1:
-    printf("Error : getCalibrationInfo did not read all of the buffer\n");
-    return -1;
-commandByteError:
-    printf("Error : getCalibrationInfo received wrong command bytes for ReadMem\n");
-    return -1;
+    return 0;
 }
 
 
@@ -385,6 +862,49 @@ long getTdacCalibrationInfo( HANDLE hDevice, u3TdacCalibrationInfo *caliInfo, ui
 }
 
 
+static void clearTdacCache(HANDLE hDevice)
+{
+    int i;
+
+    for( i = 0; i < U3_MAX_TDAC_CACHE; i++ )
+    {
+        if( tdacCache[i].hDevice == hDevice )
+            memset(&tdacCache[i], 0, sizeof(struct U3_TDAC_CACHE));
+    }
+}
+
+
+long getTdacCalibrationInfoCached(HANDLE hDevice, u3TdacCalibrationInfo *caliInfo, uint8 DIOAPinNum)
+{
+    struct U3_TDAC_CACHE *unused = NULL;
+    int i;
+
+    for( i = 0; i < U3_MAX_TDAC_CACHE; i++ )
+    {
+        if( tdacCache[i].hDevice == hDevice && tdacCache[i].DIOAPinNum == DIOAPinNum )
+        {
+            *caliInfo = tdacCache[i].caliInfo;
+            return 0;
+        }
+        if( unused == NULL && tdacCache[i].hDevice == NULL )
+            unused = &tdacCache[i];
+    }
+
+    if( getTdacCalibrationInfo(hDevice, caliInfo, DIOAPinNum) < 0 )
+        return -1;
+
+    //When the cache is full the constants are returned but not cached
+    if( unused != NULL )
+    {
+        unused->hDevice = hDevice;
+        unused->DIOAPinNum = DIOAPinNum;
+        unused->caliInfo = *caliInfo;
+    }
+
+    return 0;
+}
+
+
 double FPuint8ArrayToFPDouble(uint8 *buffer, int startIndex)
 {
     uint32 resultDec = 0, resultWh = 0;
@@ -497,6 +1017,34 @@ long getAinVoltCalibrated_hw130(u3CalibrationInfo *caliInfo, uint8 positiveChann
 }
 
 
+long getStreamCalibration(u3CalibrationInfo *caliInfo, int dac1Enabled, uint8 positiveChannel, uint8 negChannel, LJUSB_StreamChannelCal *streamCal)
+{
+    double minVolt, maxVolt;
+
+    //The U3 conversions are linear, so the slope and offset are found from the
+    //voltages of the lowest and highest binary values
+    if( caliInfo->hardwareVersion >= 1.30 )
+    {
+        if( getAinVoltCalibrated_hw130(caliInfo, positiveChannel, negChannel, 0, &minVolt) != 0 ||
+            getAinVoltCalibrated_hw130(caliInfo, positiveChannel, negChannel, 65535, &maxVolt) != 0 )
+            return -1;
+    }
+    else
+    {
+        if( getAinVoltCalibrated(caliInfo, dac1Enabled, negChannel, 0, &minVolt) != 0 ||
+            getAinVoltCalibrated(caliInfo, dac1Enabled, negChannel, 65535, &maxVolt) != 0 )
+            return -1;
+    }
+
+    streamCal->center = 0;
+    streamCal->slopeBelow = (maxVolt - minVolt)/65535.0;
+    streamCal->slopeAbove = streamCal->slopeBelow;
+    streamCal->offset = minVolt;
+
+    return 0;
+}
+
+
 long getDacBinVoltCalibrated(u3CalibrationInfo *caliInfo, int dacNumber, double analogVolt, uint8 *bytesVolt)
 {
     return getDacBinVoltCalibrated8Bit(caliInfo, dacNumber, analogVolt, bytesVolt);
@@ -567,7 +1115,7 @@ long getDacBinVoltCalibrated16Bit(u3CalibrationInfo *caliInfo, int dacNumber, do
 
 long getTdacBinVoltCalibrated(u3TdacCalibrationInfo *caliInfo, int dacNumber, double analogVolt, uint16 *bytesVolt)
 {
-    uint32 tBytesVolt;
+    double tBytesVolt;
 
     if( isTdacCalibrationInfoValid(caliInfo) == 0 )
         return -1;
@@ -581,7 +1129,9 @@ long getTdacBinVoltCalibrated(u3TdacCalibrationInfo *caliInfo, int dacNumber, do
     tBytesVolt = analogVolt*caliInfo->ccConstants[dacNumber*2] + caliInfo->ccConstants[dacNumber*2 + 1];
 
     //Checking to make sure bytesVolt will be a value between 0 and 65535.
-    if( tBytesVolt > 65535 )
+    if( tBytesVolt < 0 )
+        tBytesVolt = 0;
+    else if( tBytesVolt > 65535 )
         tBytesVolt = 65535;
 
     *bytesVolt = (uint16)tBytesVolt;
@@ -649,132 +1199,62 @@ long getTempKUncalibrated(uint16 bytesTemp, double *kelvinTemp)
 
 long I2C(HANDLE hDevice, uint8 I2COptions, uint8 SpeedAdjust, uint8 SDAPinNum, uint8 SCLPinNum, uint8 Address, uint8 NumI2CBytesToSend, uint8 NumI2CBytesToReceive, uint8 *I2CBytesCommand, uint8 *Errorcode, uint8 *AckArray, uint8 *I2CBytesResponse)
 {
-    uint8 *sendBuff, *recBuff;
-    uint16 checksumTotal = 0;
-    uint32 ackArrayTotal, expectedAckArray;
-    int sendChars, recChars, sendSize, recSize;
-    int i, ret;
+    LJUSB_I2CEngine engine;
+    LJUSB_I2CTransaction *t;
+    uint32 expectedAckArray;
+    int i;
 
     *Errorcode = 0;
-    ret = 0;
-    sendSize = 6 + 8 + ((NumI2CBytesToSend%2 != 0)?(NumI2CBytesToSend + 1):(NumI2CBytesToSend));
-    recSize = 6 + 6 + ((NumI2CBytesToReceive%2 != 0)?(NumI2CBytesToReceive + 1):(NumI2CBytesToReceive));
-
-    sendBuff = (uint8 *)malloc(sizeof(uint8)*sendSize);
-    recBuff = (uint8 *)malloc(sizeof(uint8)*recSize);
-
-    sendBuff[sendSize - 1] = 0;
-
-    //I2C command
-    sendBuff[1] = (uint8)(0xF8);  //Command byte
-    sendBuff[2] = (sendSize - 6) / 2;  //Number of data words = 4 + NumI2CBytesToSend
-    sendBuff[3] = (uint8)(0x3B);  //extended command number
-
-    sendBuff[6] = I2COptions;  //I2COptions
-    sendBuff[7] = SpeedAdjust;  //SpeedAdjust
-    sendBuff[8] = SDAPinNum;  //SDAPinNum
-    sendBuff[9] = SCLPinNum;  //SCLPinNum
-    sendBuff[10] = Address;  //Address
-    sendBuff[11] = 0;  //Reserved
-    sendBuff[12] = NumI2CBytesToSend;  //NumI2CByteToSend
-    sendBuff[13] = NumI2CBytesToReceive;  //NumI2CBytesToReceive
-
-    for( i = 0; i < NumI2CBytesToSend; i++ )
-        sendBuff[14 + i] = I2CBytesCommand[i];  //I2CByte
-
-    extendedChecksum(sendBuff, sendSize);
 
-    //Sending command to U3
-    sendChars = LJUSB_Write(hDevice, sendBuff, sendSize);
-    if( sendChars < sendSize )
+    //Sending the I2C command with the I2C engine of labjacki2c.h, one command
+    //at a time and without allocating memory
+    if( LJUSB_I2CEngineInit(&engine, hDevice, I2COptions, SpeedAdjust, SDAPinNum, SCLPinNum, 1) < 0 )
     {
-        if( sendChars == 0 )
-            printf("I2C Error : write failed\n");
-        else
-            printf("I2C Error : did not write all of the buffer\n");
-        ret = -1;
-        goto cleanmem;
+        printf("I2C Error : invalid handle\n");
+        return -1;
     }
 
-    //Reading response from U3
-    recChars = LJUSB_Read(hDevice, recBuff, recSize);
-    if( recChars < recSize )
+    //A response with a non-zero errorcode or missing acks is still returned
+    t = &engine.queue[0];
+    if( LJUSB_I2CTransfer(&engine, Address, I2CBytesCommand, NumI2CBytesToSend, I2CBytesResponse, NumI2CBytesToReceive) < 0 &&
+        errno != EPROTO && errno != ENXIO )
     {
-        if( recChars == 0 )
-            printf("I2C Error : read failed\n");
+        if( errno == EINVAL )
+            printf("I2C Error : invalid byte counts or buffers\n");
+        else if( errno == EBADMSG )
+            printf("I2C Error : read buffer has bad checksum or command bytes\n");
         else
-        {
-            printf("I2C Error : did not read all of the buffer\n");
-            if( recChars >= 12 )
-                *Errorcode = recBuff[6];
-        }
-        ret = -1;
-        goto cleanmem;
+            printf("I2C Error : write or read failed\n");
+        *Errorcode = (uint8)t->errorcode;
+        return -1;
     }
 
-    *Errorcode = recBuff[6];
+    *Errorcode = (uint8)t->errorcode;
 
-    AckArray[0] = recBuff[8];
-    AckArray[1] = recBuff[9];
-    AckArray[2] = recBuff[10];
-    AckArray[3] = recBuff[11];
+    AckArray[0] = (uint8)(t->ackArray & 0xFF);
+    AckArray[1] = (uint8)((t->ackArray >> 8) & 0xFF);
+    AckArray[2] = (uint8)((t->ackArray >> 16) & 0xFF);
+    AckArray[3] = (uint8)((t->ackArray >> 24) & 0xFF);
 
     for( i = 0; i < NumI2CBytesToReceive; i++ )
-        I2CBytesResponse[i] = recBuff[12 + i];
+        I2CBytesResponse[i] = t->response[i];
 
-    if( (uint8)(extendedChecksum8(recBuff)) != recBuff[0] )
-    {
-        printf("I2C Error : read buffer has bad checksum (%d)\n", recBuff[0]);
-        ret = -1;
-    }
-
-    if( recBuff[1] != (uint8)(0xF8) )
-    {
-        printf("I2C Error : read buffer has incorrect command byte (%d)\n", recBuff[1]);
-        ret = -1;
-    }
-
-    if( recBuff[2] != (uint8)((recSize - 6)/2) )
-    {
-        printf("I2C Error : read buffer has incorrect number of data words (%d)\n", recBuff[2]);
-        ret = -1;
-    }
-
-    if( recBuff[3] != (uint8)(0x3B) )
-    {
-        printf("I2C Error : read buffer has incorrect extended command number (%d)\n", recBuff[3]);
-        ret = -1;
-    }
-
-    checksumTotal = extendedChecksum16(recBuff, recSize);
-    if( (uint8)((checksumTotal / 256) & 0xff) != recBuff[5] || (uint8)(checksumTotal & 255) != recBuff[4])
+    //AckArray should ack the Address byte in the first ack bit, but did not
+    //until firmware 1.44
+    if( t->acked == 0 )
     {
-        printf("I2C error : read buffer has bad checksum16 (%u)\n", checksumTotal);
-        ret = -1;
+        expectedAckArray = (NumI2CBytesToSend + 1 >= 32) ? 0xFFFFFFFF : ((uint32)1 << (NumI2CBytesToSend + 1)) - 1;
+        printf("I2C error : expected an ack of %u, but received %u\n", expectedAckArray, t->ackArray);
     }
 
-    //ackArray should ack the Address byte in the first ack bit, but did not 
-    //until firmware 1.44
-    ackArrayTotal = AckArray[0] + AckArray[1]*256 + AckArray[2]*65536 + AckArray[3]*16777216;
-    expectedAckArray = pow(2.0,  NumI2CBytesToSend+1)-1;
-    if( ackArrayTotal != expectedAckArray )
-        printf("I2C error : expected an ack of %u, but received %u\n", expectedAckArray, ackArrayTotal);
-
-cleanmem:
-    free(sendBuff);
-    free(recBuff);
-    sendBuff = NULL;
-    recBuff = NULL;
-
-    return ret;
+    return 0;
 }
 
 
 long eAIN(HANDLE Handle, u3CalibrationInfo *CalibrationInfo, long ConfigIO, long *DAC1Enable, long ChannelP, long ChannelN, double *Voltage, long Range, long Resolution, long Settling, long Binary, long Reserved1, long Reserved2)
 {
     uint8 sendDataBuff[3], recDataBuff[2];
-    uint8 FIOAnalog, EIOAnalog, curFIOAnalog, curEIOAnalog;
-    uint8 curTCConfig, settling, quicksample, Errorcode;
+    uint8 FIOAnalog, EIOAnalog, settling, quicksample, Errorcode;
     uint8 ErrorFrame, outDAC1Enable;
     uint16 bytesVT;
     int hv, isSpecialRange = 0;
@@ -828,22 +1308,11 @@ long eAIN(HANDLE Handle, u3CalibrationInfo *CalibrationInfo, long ConfigIO, long
         else if( ChannelN <= 15 )
             EIOAnalog = EIOAnalog | (int)pow(2, (ChannelN - 8));
 
-        //Using ConfigIO to get current FIOAnalog and EIOAnalog settings
-        if( (error = ehConfigIO(Handle, 0, 0, 0, 0, 0, &curTCConfig, &outDAC1Enable, &curFIOAnalog, &curEIOAnalog)) != 0 )
+        //Setting the channels as analog inputs with ConfigIO if needed
+        if( (error = setAnalogLines(Handle, FIOAnalog, EIOAnalog, &outDAC1Enable)) != 0 )
             return error;
 
         *DAC1Enable = outDAC1Enable;
-
-        if( !(FIOAnalog == curFIOAnalog && EIOAnalog == curEIOAnalog) )
-        {
-            //Creating new FIOAnalog and EIOAnalog settings
-            FIOAnalog = FIOAnalog | curFIOAnalog;
-            EIOAnalog = EIOAnalog | curEIOAnalog;
-
-            //Using ConfigIO to set new FIOAnalog and EIOAnalog settings
-            if( (error = ehConfigIO(Handle, 12, curTCConfig, 0, FIOAnalog, EIOAnalog, NULL, NULL, &curFIOAnalog, &curEIOAnalog)) != 0 )
-                return error;
-        }
     }
 
     /* Setting up Feedback command to read analog input */
@@ -899,6 +1368,7 @@ long eDAC(HANDLE Handle, u3CalibrationInfo *CalibrationInfo, long ConfigIO, long
     uint8 byteV, DAC1Enabled, Errorcode, ErrorFrame;
     uint16 bytesV;
     long error, sendSize;
+    struct U3_CONFIG_SHADOW shadow;
 
     if( isCalibrationInfoValid(CalibrationInfo) == 0 )
     {
@@ -914,10 +1384,14 @@ long eDAC(HANDLE Handle, u3CalibrationInfo *CalibrationInfo, long ConfigIO, long
 
     if( ConfigIO != 0 && Channel == 1 && CalibrationInfo->hardwareVersion < 1.30 )
     {
-        //Using ConfigIO to enable DAC1
-        error = ehConfigIO(Handle, 2, 0, 1, 0, 0, NULL, &DAC1Enabled, NULL, NULL);
-        if( error != 0 )
-            return error;
+        copyConfigShadow(Handle, &shadow);
+        if( shadow.configIOValid == 0 || shadow.dac1Enable == 0 )
+        {
+            //Using ConfigIO to enable DAC1
+            error = ehConfigIO(Handle, 2, 0, 1, 0, 0, NULL, &DAC1Enabled, NULL, NULL);
+            if( error != 0 )
+                return error;
+        }
     }
 
     /* Setting up Feedback command to set DAC */
@@ -954,11 +1428,67 @@ long eDAC(HANDLE Handle, u3CalibrationInfo *CalibrationInfo, long ConfigIO, long
 }
 
 
+long eTDAC(HANDLE Handle, u3TdacCalibrationInfo *TdacCalibrationInfo, long DIOAPinNum, double VoltageA, double VoltageB)
+{
+    u3TdacCalibrationInfo caliInfo;
+    LJUSB_I2CEngine engine;
+    uint8 bytesCommand[6];
+    uint16 bytesVolt;
+    int i;
+
+    if( DIOAPinNum < 0 || DIOAPinNum > 254 )
+    {
+        printf("eTDAC error: Invalid DIOAPinNum.\n");
+        return -1;
+    }
+
+    if( TdacCalibrationInfo == NULL )
+    {
+        if( getTdacCalibrationInfoCached(Handle, &caliInfo, (uint8)DIOAPinNum) < 0 )
+            return -1;
+        TdacCalibrationInfo = &caliInfo;
+    }
+    else if( isTdacCalibrationInfoValid(TdacCalibrationInfo) == 0 )
+    {
+        printf("eTDAC error: Invalid LJTDAC calibration information.\n");
+        return -1;
+    }
+
+    /* Setting up the DACA and DACB command bytes (h0x30 and h0x31) and values
+       (MSB first) of one I2C command to the DAC (address h0x24) */
+    for( i = 0; i < 2; i++ )
+    {
+        if( getTdacBinVoltCalibrated(TdacCalibrationInfo, i, (i == 0) ? VoltageA : VoltageB, &bytesVolt) < 0 )
+            return -1;
+
+        bytesCommand[i*3] = (uint8)(0x30 + i);  //LJTDAC command byte : DACA or DACB
+        bytesCommand[i*3 + 1] = (uint8)(bytesVolt/256);  //value (high)
+        bytesCommand[i*3 + 2] = (uint8)(bytesVolt & 255);  //value (low)
+    }
+
+    //Sending the I2C command with the I2C engine of labjacki2c.h, which
+    //builds it in the engine's buffers instead of allocating them
+    if( LJUSB_I2CEngineInit(&engine, Handle, 0, 0, (uint8)DIOAPinNum + 1, (uint8)DIOAPinNum, 1) < 0 ||
+        LJUSB_I2CTransfer(&engine, (uint8)(0x24), bytesCommand, 6, NULL, 0) < 0 )
+    {
+        if( errno == EPROTO )
+            return (long)engine.queue[0].errorcode;
+
+        if( errno == ENXIO )
+            printf("eTDAC error: the LJTDAC did not acknowledge the I2C command\n");
+        else
+            printf("eTDAC error: I2C command failed : %s\n", strerror(errno));
+        return -1;
+    }
+
+    return 0;
+}
+
+
 long eDI(HANDLE Handle, long ConfigIO, long Channel, long *State)
 {
     uint8 sendDataBuff[4], recDataBuff[1];
-    uint8 Errorcode, ErrorFrame, FIOAnalog, EIOAnalog;
-    uint8 curFIOAnalog, curEIOAnalog, curTCConfig;
+    uint8 Errorcode, ErrorFrame;
     long error;
 
     if( Channel < 0 || Channel > 19 )
@@ -969,31 +1499,13 @@ long eDI(HANDLE Handle, long ConfigIO, long Channel, long *State)
 
     if( ConfigIO != 0 && Channel <= 15 )
     {
-        FIOAnalog = 255;
-        EIOAnalog = 255;
-
-        //Setting Channel to digital using FIOAnalog and EIOAnalog
+        //Setting Channel as digital with ConfigIO if needed
         if( Channel <= 7 )
-            FIOAnalog = 255 - pow(2, Channel);
+            error = setDigitalLines(Handle, (uint8)(1 << Channel), 0);
         else
-            EIOAnalog = 255 - pow(2, (Channel - 8));
-
-        //Using ConfigIO to get current FIOAnalog and EIOAnalog settings
-        error = ehConfigIO(Handle, 0, 0, 0, 0, 0, &curTCConfig, NULL, &curFIOAnalog, &curEIOAnalog);
+            error = setDigitalLines(Handle, 0, (uint8)(1 << (Channel - 8)));
         if( error != 0 )
             return error;
-
-        if( !(FIOAnalog == curFIOAnalog && EIOAnalog == curEIOAnalog) )
-        {
-            //Creating new FIOAnalog and EIOAnalog settings
-            FIOAnalog = FIOAnalog & curFIOAnalog;
-            EIOAnalog = EIOAnalog & curEIOAnalog;
-
-            //Using ConfigIO to set new FIOAnalog and EIOAnalog settings
-            error = ehConfigIO(Handle, 12, curTCConfig, 0, FIOAnalog, EIOAnalog, NULL, NULL, &curFIOAnalog, &curEIOAnalog);
-            if( error != 0 )
-                return error;
-        }
     }
 
     /* Setting up Feedback command to set digital Channel to input and to read from it */
@@ -1016,8 +1528,7 @@ long eDI(HANDLE Handle, long ConfigIO, long Channel, long *State)
 long eDO(HANDLE Handle, long ConfigIO, long Channel, long State)
 {
     uint8 sendDataBuff[4];
-    uint8 Errorcode, ErrorFrame, FIOAnalog, EIOAnalog;
-    uint8 curFIOAnalog, curEIOAnalog, curTCConfig;
+    uint8 Errorcode, ErrorFrame;
     long error;
 
     if( Channel < 0 || Channel > 19 )
@@ -1028,31 +1539,13 @@ long eDO(HANDLE Handle, long ConfigIO, long Channel, long State)
 
     if( ConfigIO != 0 && Channel <= 15 )
     {
-        FIOAnalog = 255;
-        EIOAnalog = 255;
-
-        //Setting Channel to digital using FIOAnalog and EIOAnalog
+        //Setting Channel as digital with ConfigIO if needed
         if( Channel <= 7 )
-            FIOAnalog = 255 - pow(2, Channel);
+            error = setDigitalLines(Handle, (uint8)(1 << Channel), 0);
         else
-            EIOAnalog = 255 - pow(2, (Channel - 8));
-
-        //Using ConfigIO to get current FIOAnalog and EIOAnalog settings
-        error = ehConfigIO(Handle, 0, 0, 0, 0, 0, &curTCConfig, NULL, &curFIOAnalog, &curEIOAnalog);
+            error = setDigitalLines(Handle, 0, (uint8)(1 << (Channel - 8)));
         if( error != 0 )
             return error;
-
-        if( !(FIOAnalog == curFIOAnalog && EIOAnalog == curEIOAnalog) )
-        {
-            //Using ConfigIO to get current FIOAnalog and EIOAnalog settings
-            FIOAnalog = FIOAnalog & curFIOAnalog;
-            EIOAnalog = EIOAnalog & curEIOAnalog;
-
-            //Using ConfigIO to set new FIOAnalog and EIOAnalog settings
-            error = ehConfigIO(Handle, 12, curTCConfig, 0, FIOAnalog, EIOAnalog, NULL, NULL, &curFIOAnalog, &curEIOAnalog);
-            if( error != 0 )
-                return error;
-        }
     }
 
     /* Setting up Feedback command to set digital Channel to output and to set the state */
@@ -1071,6 +1564,311 @@ long eDO(HANDLE Handle, long ConfigIO, long Channel, long State)
 }
 
 
+long eAINs(HANDLE Handle, u3CalibrationInfo *CalibrationInfo, long ConfigIO, long *DAC1Enable, long NumChannels, long *aChannelP, long *aChannelN, double *aVoltages, long Range, long Resolution, long Settling, long Binary, long *aErrors, long Reserved1, long Reserved2)
+{
+    u3PreparedFeedback feedback;
+    uint8 sendDataBuff[U3_FEEDBACK_MAX_COMMAND_DATA], *recDataBuff;
+    uint8 FIOAnalog, EIOAnalog, settling, quicksample, Errorcode, ErrorFrame;
+    uint8 outDAC1Enable, channelN;
+    uint16 bytesVT;
+    int hv, i, start, numFrames, maxFrames, firstError;
+    int next, retryStart, retryEnd, numValid;
+    long recChars, error, ChannelP, ChannelN;
+    double hwver;
+
+    if( isCalibrationInfoValid(CalibrationInfo) == 0 )
+    {
+        printf("eAINs error: calibration information is required");
+        return -1;
+    }
+
+    if( NumChannels < 1 || aChannelP == NULL || aChannelN == NULL || aVoltages == NULL )
+    {
+        printf("eAINs error: Invalid channel arrays\n");
+        return -1;
+    }
+
+    hwver = CalibrationInfo->hardwareVersion;
+    hv = CalibrationInfo->highVoltage;
+    FIOAnalog = 0;
+    EIOAnalog = 0;
+
+    for( i = 0; i < NumChannels; i++ )
+    {
+        ChannelP = aChannelP[i];
+        ChannelN = aChannelN[i];
+
+        if( ChannelP < 0 || (ChannelP > 15 && ChannelP != 30 && ChannelP != 31) )
+        {
+            printf("eAINs error: Invalid positive channel %ld\n", ChannelP);
+            return -1;
+        }
+
+        if( ChannelN < 0 ||
+            (ChannelN > 15 && ChannelN != 30 && ChannelN != 31 && ChannelN != 32) ||
+            (hwver >= 1.30 && hv == 1 && ((ChannelP < 4 && ChannelN != 31 && ChannelN != 32) ||
+            ChannelN < 4)) )
+        {
+            printf("eAINs error: Invalid negative channel %ld\n", ChannelN);
+            return -1;
+        }
+
+        //Collecting the channels to set as analog inputs
+        if( !(hwver >= 1.30 && hv == 1 && ChannelP < 4) )
+        {
+            if( ChannelP <= 7 )
+                FIOAnalog |= (uint8)(1 << ChannelP);
+            else if( ChannelP <= 15 )
+                EIOAnalog |= (uint8)(1 << (ChannelP - 8));
+
+            if( ChannelN <= 7 )
+                FIOAnalog |= (uint8)(1 << ChannelN);
+            else if( ChannelN <= 15 )
+                EIOAnalog |= (uint8)(1 << (ChannelN - 8));
+        }
+
+        if( aErrors != NULL )
+            aErrors[i] = 0;
+    }
+
+    if( ConfigIO != 0 )
+    {
+        //Setting all of the channels as analog inputs with one ConfigIO if
+        //needed
+        if( (error = setAnalogLines(Handle, FIOAnalog, EIOAnalog, &outDAC1Enable)) != 0 )
+            return error;
+
+        *DAC1Enable = outDAC1Enable;
+    }
+
+    settling = (Settling != 0) ? 1 : 0;
+    quicksample = (Resolution != 0) ? 1 : 0;
+    maxFrames = U3_FEEDBACK_MAX_COMMAND_DATA/3;  //19 AIN readings
+    firstError = 0;
+    error = 0;
+
+    //Channels next and up have not been sent yet, and the channels from
+    //retryStart to retryEnd - 1 followed a failed frame and are sent again.
+    //The U3 runs one command at a time, so each Feedback command is written
+    //after the response of the previous one is read.
+    next = 0;
+    retryStart = retryEnd = 0;
+
+    while( next < NumChannels || retryStart < retryEnd )
+    {
+        /* Setting up Feedback command to read as many analog inputs as fit */
+        if( retryStart < retryEnd )
+        {
+            start = retryStart;
+            numFrames = retryEnd - retryStart;
+            retryStart = retryEnd;
+        }
+        else
+        {
+            start = next;
+            numFrames = (NumChannels - next < maxFrames) ? NumChannels - next : maxFrames;
+            next += numFrames;
+        }
+
+        for( i = 0; i < numFrames; i++ )
+        {
+            channelN = (aChannelN[start + i] == 32) ? 30 : (uint8)aChannelN[start + i];  //32 is sent as 30
+            sendDataBuff[i*3] = 1;  //IOType is AIN
+            sendDataBuff[i*3 + 1] = (uint8)aChannelP[start + i] + settling*64 + quicksample*128;  //Positive channel (bits 0-4), LongSettling (bit 6)
+                                                                                                  //QuickSample (bit 7)
+            sendDataBuff[i*3 + 2] = channelN;  //Negative channel
+        }
+
+        if( ehFeedbackPrepare(&feedback, sendDataBuff, numFrames*3, numFrames*2) < 0 ||
+            feedbackWrite(Handle, &feedback) < 0 )
+            return -1;
+        if( (recChars = feedbackRead(Handle, &feedback, &Errorcode, &ErrorFrame)) < 0 )
+            return -1;
+        recDataBuff = feedback.recBuff + 9;
+
+        //On an error the frames before ErrorFrame are valid, the failed frame
+        //gets the errorcode, and the frames after it are sent again.  An
+        //ErrorFrame outside of the command cannot be matched to a channel, so
+        //then every channel of the command gets the errorcode.
+        numValid = numFrames;
+        if( Errorcode != 0 )
+        {
+            if( firstError == 0 )
+                firstError = Errorcode;
+
+            if( ErrorFrame < numFrames )
+            {
+                numValid = ErrorFrame;
+                if( aErrors != NULL )
+                    aErrors[start + ErrorFrame] = Errorcode;
+                retryStart = start + ErrorFrame + 1;
+                retryEnd = start + numFrames;
+            }
+            else
+            {
+                numValid = 0;
+                for( i = 0; i < numFrames && aErrors != NULL; i++ )
+                    aErrors[start + i] = Errorcode;
+            }
+        }
+        if( numValid > (recChars - 9)/2 )
+            numValid = (recChars - 9)/2;
+
+        for( i = 0; i < numValid; i++ )
+        {
+            ChannelP = aChannelP[start + i];
+            ChannelN = aChannelN[start + i];
+            bytesVT = recDataBuff[i*2] + recDataBuff[i*2 + 1]*256;
+
+            //A conversion error does not stop the other channels
+            if( Binary != 0 )
+                aVoltages[start + i] = (double)bytesVT;
+            else if( ChannelP == 30 )
+            {
+                if( getTempKCalibrated(CalibrationInfo, bytesVT, &aVoltages[start + i]) < 0 )
+                    error = -1;
+            }
+            else if( hwver < 1.30 )
+            {
+                if( getAinVoltCalibrated(CalibrationInfo, (int)(*DAC1Enable), (uint8)ChannelN, bytesVT, &aVoltages[start + i]) < 0 )
+                    error = -1;
+            }
+            else if( getAinVoltCalibrated_hw130(CalibrationInfo, (uint8)ChannelP, (uint8)ChannelN, bytesVT, &aVoltages[start + i]) < 0 )
+                error = -1;
+        }
+    }
+
+    return (error < 0) ? -1 : firstError;
+}
+
+
+long eDIs(HANDLE Handle, long ConfigIO, long NumChannels, long *aChannels, long *aStates, long *aErrors)
+{
+    uint8 sendDataBuff[8], recDataBuff[3];
+    uint8 Errorcode, ErrorFrame;
+    uint32 mask;
+    int i;
+    long error;
+
+    if( NumChannels < 1 || aChannels == NULL || aStates == NULL )
+    {
+        printf("eDIs error: Invalid channel arrays\n");
+        return -1;
+    }
+
+    mask = 0;
+    for( i = 0; i < NumChannels; i++ )
+    {
+        if( aChannels[i] < 0 || aChannels[i] > 19 )
+        {
+            printf("eDIs error: Invalid DI channel %ld\n", aChannels[i]);
+            return -1;
+        }
+        mask |= 1 << aChannels[i];
+    }
+
+    if( ConfigIO != 0 && (mask & 0xFFFF) != 0 )
+    {
+        //Setting all of the channels as digital with one ConfigIO if needed
+        if( (error = setDigitalLines(Handle, (uint8)(mask & 0xFF), (uint8)((mask >> 8) & 0xFF))) != 0 )
+            return error;
+    }
+
+    /* Setting up Feedback command to set all channels to input and to read
+       them */
+    sendDataBuff[0] = 29;  //IOType is PortDirWrite
+    sendDataBuff[1] = (uint8)(mask & 0xFF);  //Writemask : FIO
+    sendDataBuff[2] = (uint8)((mask >> 8) & 0xFF);  //Writemask : EIO
+    sendDataBuff[3] = (uint8)((mask >> 16) & 0xFF);  //Writemask : CIO
+    sendDataBuff[4] = 0;  //Direction : FIO (input)
+    sendDataBuff[5] = 0;  //Direction : EIO (input)
+    sendDataBuff[6] = 0;  //Direction : CIO (input)
+
+    sendDataBuff[7] = 26;  //IOType is PortStateRead
+
+    if( ehFeedback(Handle, sendDataBuff, 8, &Errorcode, &ErrorFrame, recDataBuff, 3) < 0 )
+        return -1;
+
+    for( i = 0; i < NumChannels; i++ )
+    {
+        if( aErrors != NULL )
+            aErrors[i] = Errorcode;
+        if( Errorcode == 0 )
+            aStates[i] = (recDataBuff[aChannels[i]/8] >> (aChannels[i]%8)) & 1;
+    }
+
+    return (long)Errorcode;
+}
+
+
+long eDOs(HANDLE Handle, long ConfigIO, long NumChannels, long *aChannels, long *aStates, long *aErrors)
+{
+    uint8 sendDataBuff[14];
+    uint8 Errorcode, ErrorFrame;
+    uint32 mask, state;
+    int i;
+    long error;
+
+    if( NumChannels < 1 || aChannels == NULL || aStates == NULL )
+    {
+        printf("eDOs error: Invalid channel arrays\n");
+        return -1;
+    }
+
+    mask = 0;
+    state = 0;
+    for( i = 0; i < NumChannels; i++ )
+    {
+        if( aChannels[i] < 0 || aChannels[i] > 19 )
+        {
+            printf("eDOs error: Invalid DO channel %ld\n", aChannels[i]);
+            return -1;
+        }
+        mask |= 1 << aChannels[i];
+        if( aStates[i] > 0 )
+            state |= 1 << aChannels[i];
+        else
+            state &= ~(1 << aChannels[i]);
+    }
+
+    if( ConfigIO != 0 && (mask & 0xFFFF) != 0 )
+    {
+        //Setting all of the channels as digital with one ConfigIO if needed
+        if( (error = setDigitalLines(Handle, (uint8)(mask & 0xFF), (uint8)((mask >> 8) & 0xFF))) != 0 )
+            return error;
+    }
+
+    /* Setting up Feedback command to set all channels to output and to set
+       their states */
+    sendDataBuff[0] = 29;  //IOType is PortDirWrite
+    sendDataBuff[1] = (uint8)(mask & 0xFF);  //Writemask : FIO
+    sendDataBuff[2] = (uint8)((mask >> 8) & 0xFF);  //Writemask : EIO
+    sendDataBuff[3] = (uint8)((mask >> 16) & 0xFF);  //Writemask : CIO
+    sendDataBuff[4] = sendDataBuff[1];  //Direction : FIO (output)
+    sendDataBuff[5] = sendDataBuff[2];  //Direction : EIO (output)
+    sendDataBuff[6] = sendDataBuff[3];  //Direction : CIO (output)
+
+    sendDataBuff[7] = 27;  //IOType is PortStateWrite
+    sendDataBuff[8] = sendDataBuff[1];  //Writemask : FIO
+    sendDataBuff[9] = sendDataBuff[2];  //Writemask : EIO
+    sendDataBuff[10] = sendDataBuff[3];  //Writemask : CIO
+    sendDataBuff[11] = (uint8)(state & 0xFF);  //State : FIO
+    sendDataBuff[12] = (uint8)((state >> 8) & 0xFF);  //State : EIO
+    sendDataBuff[13] = (uint8)((state >> 16) & 0xFF);  //State : CIO
+
+    if( ehFeedback(Handle, sendDataBuff, 14, &Errorcode, &ErrorFrame, NULL, 0) < 0 )
+        return -1;
+
+    if( aErrors != NULL )
+    {
+        for( i = 0; i < NumChannels; i++ )
+            aErrors[i] = Errorcode;
+    }
+
+    return (long)Errorcode;
+}
+
+
 long eTCConfig(HANDLE Handle, long *aEnableTimers, long *aEnableCounters, long TCPinOffset, long TimerClockBaseIndex, long TimerClockDivisor, long *aTimerModes, double *aTimerValues, long Reserved1, long Reserved2)
 {
     uint8 sendDataBuff[8];
@@ -1078,6 +1876,7 @@ long eTCConfig(HANDLE Handle, long *aEnableTimers, long *aEnableCounters, long T
     uint8 TimerCounterConfig, curTimerCounterConfig, Errorcode, ErrorFrame;
     int sendDataBuffSize, numTimers, numCounters, i;
     long error;
+    struct U3_CONFIG_SHADOW shadow;
 
     if( TCPinOffset < 0 || TCPinOffset > 8 )
     {
@@ -1101,12 +1900,20 @@ long eTCConfig(HANDLE Handle, long *aEnableTimers, long *aEnableCounters, long T
         TimerClockBaseIndex = TimerClockBaseIndex - 20;
     }
 
-    error = ehConfigTimerClock(Handle, (uint8)(TimerClockBaseIndex + 128), (uint8)TimerClockDivisor, NULL, NULL);
-    if( error != 0 )
-        return error;
+    //Only setting the timer clock if it differs from the shadowed setting
+    copyConfigShadow(Handle, &shadow);
+    if( shadow.timerClockValid == 0 ||
+        shadow.timerClockConfig != (uint8)(TimerClockBaseIndex & 7) ||
+        shadow.timerClockDivisor != (uint8)TimerClockDivisor )
+    {
+        error = ehConfigTimerClock(Handle, (uint8)(TimerClockBaseIndex + 128), (uint8)TimerClockDivisor, NULL, NULL);
+        if( error != 0 )
+            return error;
+    }
 
-    //Using ConfigIO to get current FIOAnalog and curEIOAnalog settings
-    error = ehConfigIO(Handle, 0, 0, 0, 0, 0, NULL, NULL, &curFIOAnalog, &curEIOAnalog);
+    //Getting current TimerCounterConfig, FIOAnalog and EIOAnalog settings
+    //from the shadow, or with ConfigIO
+    error = getConfigIOState(Handle, &curTimerCounterConfig, NULL, &curFIOAnalog, &curEIOAnalog);
     if( error != 0 )
         return error;
 
@@ -1145,9 +1952,12 @@ long eTCConfig(HANDLE Handle, long *aEnableTimers, long *aEnableCounters, long T
 
     FIOAnalog = FIOAnalog & curFIOAnalog;
     EIOAnalog = EIOAnalog & curEIOAnalog;
-    error = ehConfigIO(Handle, 13, TimerCounterConfig, 0, FIOAnalog, EIOAnalog, &curTimerCounterConfig, NULL, &curFIOAnalog, &curEIOAnalog);
-    if( error != 0 )
-        return error;
+    if( TimerCounterConfig != curTimerCounterConfig || FIOAnalog != curFIOAnalog || EIOAnalog != curEIOAnalog )
+    {
+        error = ehConfigIO(Handle, 13, TimerCounterConfig, 0, FIOAnalog, EIOAnalog, &curTimerCounterConfig, NULL, &curFIOAnalog, &curEIOAnalog);
+        if( error != 0 )
+            return error;
+    }
 
     if( numTimers > 0 )
     {
@@ -1262,6 +2072,10 @@ long ehConfigIO(HANDLE hDevice, uint8 inWriteMask, uint8 inTimerCounterConfig, u
     sendBuff[11] = inEIOAnalog;  //EIOAnalog
     extendedChecksum(sendBuff, 12);
 
+    //The settings are unknown until a response to a write is received
+    if( inWriteMask != 0 )
+        setConfigIOShadow(hDevice, NULL);
+
     //Sending command to U3
     if( (sendChars = LJUSB_Write(hDevice, sendBuff, 12)) < 12 )
     {
@@ -1313,6 +2127,9 @@ long ehConfigIO(HANDLE hDevice, uint8 inWriteMask, uint8 inTimerCounterConfig, u
         return (int)recBuff[6];
     }
 
+    //The response has the current settings, after any writes
+    setConfigIOShadow(hDevice, recBuff + 8);
+
     if( outTimerCounterConfig != NULL )
         *outTimerCounterConfig = recBuff[8];
     if( outDAC1Enable != NULL )
@@ -1343,6 +2160,10 @@ long ehConfigTimerClock(HANDLE hDevice, uint8 inTimerClockConfig, uint8 inTimerC
     sendBuff[9] = inTimerClockDivisor;  //TimerClockDivisor
     extendedChecksum(sendBuff, 10);
 
+    //The settings are unknown until a response to a write is received
+    if( (inTimerClockConfig & 128) != 0 )
+        setTimerClockShadow(hDevice, NULL);
+
     //Sending command to U3
     if( (sendChars = LJUSB_Write(hDevice, sendBuff, 10)) < 10 )
     {
@@ -1400,6 +2221,9 @@ long ehConfigTimerClock(HANDLE hDevice, uint8 inTimerClockConfig, uint8 inTimerC
         return recBuff[6];
     }
 
+    //The response has the current settings, after any writes
+    setTimerClockShadow(hDevice, recBuff + 8);
+
     return 0;
 }
 
@@ -1515,3 +2339,324 @@ cleanmem:
 
     return ret;
 }
+
+
+long ehFeedbackPrepare(u3PreparedFeedback *feedback, uint8 *inIOTypesDataBuff, long inIOTypesDataSize, long outDataSize)
+{
+    int sendDWSize, recDWSize, i;
+
+    if( inIOTypesDataSize < 0 || inIOTypesDataSize > U3_FEEDBACK_MAX_COMMAND_DATA )
+    {
+        printf("ehFeedbackPrepare error : invalid IOTypes data size %ld\n", inIOTypesDataSize);
+        return -1;
+    }
+
+    if( outDataSize < 0 || outDataSize > U3_FEEDBACK_MAX_RESPONSE_DATA )
+    {
+        printf("ehFeedbackPrepare error : invalid response data size %ld\n", outDataSize);
+        return -1;
+    }
+
+    if( ((sendDWSize = inIOTypesDataSize + 1)%2) != 0 )
+        sendDWSize++;
+    if( ((recDWSize = outDataSize + 3)%2) != 0 )
+        recDWSize++;
+
+    memset(feedback, 0, sizeof(u3PreparedFeedback));
+    feedback->sendSize = 6 + sendDWSize;
+    feedback->recSize = 6 + recDWSize;
+    feedback->ioTypesSize = inIOTypesDataSize;
+    feedback->dataSize = outDataSize;
+
+    /* Setting up Feedback command */
+    feedback->sendBuff[1] = (uint8)(0xF8);  //Command byte
+    feedback->sendBuff[2] = sendDWSize/2;   //Number of data words
+    feedback->sendBuff[3] = (uint8)(0x00);  //Extended command number
+    feedback->sendBuff[6] = 0;              //Echo
+
+    for( i = 0; i < inIOTypesDataSize; i++ )
+        feedback->sendBuff[i + 7] = inIOTypesDataBuff[i];
+
+    extendedChecksum(feedback->sendBuff, feedback->sendSize);
+    feedback->checksum16 = feedback->sendBuff[4] + feedback->sendBuff[5]*256;
+
+    return 0;
+}
+
+
+long ehFeedbackPatch8(u3PreparedFeedback *feedback, long offset, uint8 value)
+{
+    uint8 *b = feedback->sendBuff;
+
+    if( offset < 0 || offset >= feedback->ioTypesSize )
+    {
+        printf("ehFeedbackPatch8 error : offset %ld is outside the %d IOTypes bytes\n", offset, feedback->ioTypesSize);
+        return -1;
+    }
+
+    //Only the change of the byte is added to checksum16, and checksum8 is
+    //recalculated from bytes 1-5
+    feedback->checksum16 += value - b[offset + 7];
+    b[offset + 7] = value;
+    b[4] = (uint8)(feedback->checksum16 & 0xFF);
+    b[5] = (uint8)((feedback->checksum16 / 256) & 0xFF);
+    b[0] = extendedChecksum8(b);
+
+    return 0;
+}
+
+
+long ehFeedbackPatch16(u3PreparedFeedback *feedback, long offset, uint16 value)
+{
+    uint8 *b = feedback->sendBuff;
+
+    if( offset < 0 || offset + 1 >= feedback->ioTypesSize )
+    {
+        printf("ehFeedbackPatch16 error : offsets %ld and %ld are not both in the %d IOTypes bytes\n", offset, offset + 1, feedback->ioTypesSize);
+        return -1;
+    }
+
+    feedback->checksum16 += (value & 0xFF) - b[offset + 7];
+    feedback->checksum16 += (value / 256) - b[offset + 8];
+    b[offset + 7] = (uint8)(value & 0xFF);
+    b[offset + 8] = (uint8)((value / 256) & 0xFF);
+    b[4] = (uint8)(feedback->checksum16 & 0xFF);
+    b[5] = (uint8)((feedback->checksum16 / 256) & 0xFF);
+    b[0] = extendedChecksum8(b);
+
+    return 0;
+}
+
+
+//Writes a prepared Feedback command without reading its response.  Used by
+//ehFeedbackExecute and eAINs.
+static long feedbackWrite(HANDLE hDevice, u3PreparedFeedback *feedback)
+{
+    int sendChars;
+
+    //Sending command to U3
+    if( (sendChars = LJUSB_Write(hDevice, feedback->sendBuff, feedback->sendSize)) < feedback->sendSize )
+    {
+        if( sendChars == 0 )
+            printf("ehFeedbackExecute error : write failed\n");
+        else
+            printf("ehFeedbackExecute error : did not write all of the buffer\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+
+//Reads and checks the response of a prepared Feedback command into its
+//recBuff.  Returns the number of bytes read, or -1 on error.  Used by
+//ehFeedbackExecute and eAINs.
+static long feedbackRead(HANDLE hDevice, u3PreparedFeedback *feedback, uint8 *outErrorcode, uint8 *outErrorFrame)
+{
+    uint8 *recBuff = feedback->recBuff;
+    uint16 checksumTotal;
+    int recChars;
+
+    //Reading response from U3.  A response with a non-zero errorcode can be
+    //shorter than expected.
+    recChars = LJUSB_Read(hDevice, recBuff, feedback->recSize);
+    if( recChars < 8 )
+    {
+        if( recChars == 0 )
+            printf("ehFeedbackExecute error : read failed\n");
+        else
+            printf("ehFeedbackExecute error : response buffer is too small\n");
+        return -1;
+    }
+
+    checksumTotal = extendedChecksum16(recBuff, recChars);
+    if( (uint8)((checksumTotal / 256) & 0xFF) != recBuff[5] ||
+        (uint8)(checksumTotal & 0xFF) != recBuff[4] ||
+        extendedChecksum8(recBuff) != recBuff[0] )
+    {
+        printf("ehFeedbackExecute error : read buffer has bad checksum\n");
+        return -1;
+    }
+
+    if( recBuff[1] != (uint8)(0xF8) || recBuff[3] != (uint8)(0x00) )
+    {
+        printf("ehFeedbackExecute error : read buffer has wrong command bytes\n");
+        return -1;
+    }
+
+    *outErrorcode = recBuff[6];
+    *outErrorFrame = recBuff[7];
+
+    if( recChars < feedback->recSize && recBuff[6] == 0 )
+    {
+        printf("ehFeedbackExecute error : did not read all of the expected buffer (received %d, expected %d)\n", recChars, feedback->recSize);
+        return -1;
+    }
+
+    return recChars;
+}
+
+
+long ehFeedbackExecute(HANDLE hDevice, u3PreparedFeedback *feedback, uint8 *outErrorcode, uint8 *outErrorFrame, uint8 *outDataBuff)
+{
+    long recChars;
+    int i;
+
+    if( feedbackWrite(hDevice, feedback) < 0 )
+        return -1;
+
+    if( (recChars = feedbackRead(hDevice, feedback, outErrorcode, outErrorFrame)) < 0 )
+        return -1;
+
+    if( outDataBuff != NULL )
+    {
+        for( i = 0; i + 9 < recChars && i < feedback->dataSize; i++ )
+            outDataBuff[i] = feedback->recBuff[i + 9];
+    }
+
+    return 0;
+}
+
+
+long ehStreamConfig(HANDLE hDevice, uint8 inNumChannels, uint8 inSamplesPerPacket, uint8 inScanConfig, uint16 inScanInterval, uint8 *inPChannels, uint8 *inNChannels)
+{
+    uint8 sendBuff[64], recBuff[8];
+    uint16 checksumTotal;
+    int sendChars, recChars, sendSize, i;
+
+    if( inNumChannels < 1 || inNumChannels > 25 )
+    {
+        printf("ehStreamConfig error: Invalid number of channels\n");
+        return -1;
+    }
+
+    sendSize = 12 + inNumChannels*2;
+
+    sendBuff[1] = (uint8)(0xF8);          //Command byte
+    sendBuff[2] = 3 + inNumChannels;      //Number of data words = NumChannels + 3
+    sendBuff[3] = (uint8)(0x11);          //Extended command number
+    sendBuff[6] = inNumChannels;          //NumChannels
+    sendBuff[7] = inSamplesPerPacket;     //SamplesPerPacket
+    sendBuff[8] = 0;                      //Reserved
+    sendBuff[9] = inScanConfig;           //ScanConfig
+    sendBuff[10] = (uint8)(inScanInterval & 0x00FF);  //ScanInterval (low byte)
+    sendBuff[11] = (uint8)(inScanInterval / 256);     //ScanInterval (high byte)
+
+    for( i = 0; i < inNumChannels; i++ )
+    {
+        sendBuff[12 + i*2] = inPChannels[i];  //PChannel
+        sendBuff[13 + i*2] = inNChannels[i];  //NChannel
+    }
+    extendedChecksum(sendBuff, sendSize);
+
+    //Sending command to U3
+    if( (sendChars = LJUSB_Write(hDevice, sendBuff, sendSize)) < sendSize )
+    {
+        if( sendChars == 0 )
+            printf("ehStreamConfig error : write failed\n");
+        else
+            printf("ehStreamConfig error : did not write all of the buffer\n");
+        return -1;
+    }
+
+    //Reading response from U3
+    if( (recChars = LJUSB_Read(hDevice, recBuff, 8)) < 8 )
+    {
+        if( recChars == 0 )
+            printf("ehStreamConfig error : read failed\n");
+        else
+            printf("ehStreamConfig error : did not read all of the buffer\n");
+        return -1;
+    }
+
+    checksumTotal = extendedChecksum16(recBuff, 8);
+    if( (uint8)((checksumTotal / 256 ) & 0xff) != recBuff[5] || (uint8)(checksumTotal & 0xff) != recBuff[4] )
+    {
+        printf("ehStreamConfig error : read buffer has bad checksum16\n");
+        return -1;
+    }
+
+    if( extendedChecksum8(recBuff) != recBuff[0] )
+    {
+        printf("ehStreamConfig error : read buffer has bad checksum8\n");
+        return -1;
+    }
+
+    if( recBuff[1] != (uint8)(0xF8) || recBuff[2] != (uint8)(0x01) || recBuff[3] != (uint8)(0x11) || recBuff[7] != (uint8)(0x00) )
+    {
+        printf("ehStreamConfig error : read buffer has wrong command bytes\n");
+        return -1;
+    }
+
+    if( recBuff[6] != 0 )
+    {
+        printf("ehStreamConfig error : read buffer received errorcode %d\n", recBuff[6]);
+        return recBuff[6];
+    }
+
+    return 0;
+}
+
+
+//Sends a StreamStart (0xA8) or StreamStop (0xB0) command and checks the
+//response
+static long streamStartStop(HANDLE hDevice, uint8 command, const char *name)
+{
+    uint8 sendBuff[2], recBuff[4];
+    int sendChars, recChars;
+
+    sendBuff[0] = command;  //Checksum8
+    sendBuff[1] = command;  //Command byte
+
+    //Sending command to U3
+    if( (sendChars = LJUSB_Write(hDevice, sendBuff, 2)) < 2 )
+    {
+        if( sendChars == 0 )
+            printf("%s error : write failed\n", name);
+        else
+            printf("%s error : did not write all of the buffer\n", name);
+        return -1;
+    }
+
+    //Reading response from U3
+    if( (recChars = LJUSB_Read(hDevice, recBuff, 4)) < 4 )
+    {
+        if( recChars == 0 )
+            printf("%s error : read failed\n", name);
+        else
+            printf("%s error : did not read all of the buffer\n", name);
+        return -1;
+    }
+
+    if( normalChecksum8(recBuff, 4) != recBuff[0] )
+    {
+        printf("%s error : read buffer has bad checksum8\n", name);
+        return -1;
+    }
+
+    if( recBuff[1] != (uint8)(command + 1) || recBuff[3] != (uint8)(0x00) )
+    {
+        printf("%s error : read buffer has wrong command bytes\n", name);
+        return -1;
+    }
+
+    return recBuff[2];
+}
+
+
+long ehStreamStart(HANDLE hDevice)
+{
+    long error;
+
+    error = streamStartStop(hDevice, 0xA8, "ehStreamStart");
+    if( error > 0 )
+        printf("ehStreamStart error : read buffer received errorcode %ld\n", error);
+    return error;
+}
+
+
+long ehStreamStop(HANDLE hDevice)
+{
+    //Errorcode 52 (stream not running) is not printed
+    return streamStartStop(hDevice, 0xB0, "ehStreamStop");
+}
@@ -23,6 +23,7 @@
 #include <math.h>
 #include <stdlib.h>
 #include "labjackusb.h"
+#include "labjackstream.h"
 
 
 #ifdef __cplusplus
@@ -82,6 +83,20 @@ struct U3_TDAC_CALIBRATION_INFORMATION {
 
 typedef struct U3_TDAC_CALIBRATION_INFORMATION u3TdacCalibrationInfo;
 
+//Structure for a prepared Feedback command (see ehFeedbackPrepare).  The
+//buffers hold the full command and response packets.
+struct U3_PREPARED_FEEDBACK {
+    uint8 sendBuff[64];
+    uint8 recBuff[64];
+    int sendSize;        //Number of command bytes written
+    int recSize;         //Number of response bytes expected
+    int ioTypesSize;     //Number of IOType command bytes
+    int dataSize;        //Number of IOType response bytes
+    uint16 checksum16;   //Sum of command bytes 6 and up
+};
+
+typedef struct U3_PREPARED_FEEDBACK u3PreparedFeedback;
+
 
 /* Functions */
 
@@ -121,6 +136,21 @@ HANDLE openUSBConnection( int localID);
 void closeUSBConnection( HANDLE hDevice);
 //Closes a HANDLE to a U3 device.
 
+void invalidateConfigShadow( HANDLE hDevice);
+//The ConfigIO (TimerCounterConfig, DAC1Enable, FIOAnalog and EIOAnalog) and
+//ConfigTimerClock settings of each handle are shadowed from the ehConfigIO and
+//ehConfigTimerClock responses, so the easy functions with ConfigIO set only
+//make ConfigIO calls when a setting needs to change.  Call this function to
+//discard the shadow of a handle after changing these settings some other way
+//(for example a ConfigIO or ConfigU3 command sent with LJUSB_Write, or a
+//device reset).  The next easy function call will then read the settings from
+//the U3.  closeUSBConnection and openUSBConnection discard the shadow of the
+//handle.  Up to 16 handles are shadowed; beyond that the least recently used
+//shadow is discarded.  The shadows are protected by a mutex, but the settings
+//of a handle used from several threads at once can still change between a
+//shadow read and the command that relies on it.
+//hDevice = handle to a U3 device
+
 long getTickCount( void);
 //Returns the number of milliseconds that has elasped since the system was
 //started.
@@ -132,6 +162,26 @@ long getCalibrationInfo( HANDLE hDevice,
 //hDevice = handle to a U3 device
 //caliInfo = structure where calibrarion information will be stored
 
+long getCalibrationInfoCached( HANDLE hDevice,
+                               u3CalibrationInfo *caliInfo,
+                               long CreateCacheDir);
+//Same as getCalibrationInfo, but also keeps a copy of the calibration memory
+//in a cache file per serial number.  When the file exists, only the first
+//memory block is read from the device:  if it matches the file, the cached
+//memory is used, which saves the ReadMem round trips of the other blocks.
+//Otherwise all of the blocks are read and the file is rewritten.  A
+//recalibration that leaves the first block unchanged is not seen; use
+//getCalibrationInfo after recalibrating only other ranges.  The file holds a
+//32-bit hash of the memory, so a damaged file is not used.  The cache
+//directory is $LJ_CALIBRATION_CACHE_DIR, or $XDG_CACHE_HOME/labjack or
+//$HOME/.cache/labjack if it is not set.  Set LJ_CALIBRATION_CACHE_DIR to an
+//empty string to disable the cache.  Returns -1 on error, 0 on success.
+//hDevice = handle to a U3 device
+//caliInfo = structure where calibrarion information will be stored
+//CreateCacheDir = If this is nonzero (True), the default cache directory is
+//                 created if it does not exist.  Otherwise the cache is only
+//                 kept if the directory exists.
+
 long getTdacCalibrationInfo( HANDLE hDevice,
                              u3TdacCalibrationInfo *caliInfo,
                              uint8 DIOAPinNum);
@@ -142,6 +192,17 @@ long getTdacCalibrationInfo( HANDLE hDevice,
 //DIOAPinNum = The U3 digital IO line where the LJTDAC DIOA pin is connected.
 //             The DIOB pin is assumed to be the next digital IO line.
 
+long getTdacCalibrationInfoCached( HANDLE hDevice,
+                                   u3TdacCalibrationInfo *caliInfo,
+                                   uint8 DIOAPinNum);
+//Same as getTdacCalibrationInfo, but the calibration constants of each handle
+//and DIOAPinNum are read from the LJTDAC once and kept until
+//closeUSBConnection is called.  Returns -1 on error, 0 on success.
+//hDevice = handle to a U3 device
+//caliInfo = structure where LJTDAC calibration information will be stored
+//DIOAPinNum = The U3 digital IO line where the LJTDAC DIOA pin is connected.
+//             The DIOB pin is assumed to be the next digital IO line.
+
 
 double FPuint8ArrayToFPDouble( uint8 *buffer,
                                int startIndex);
@@ -193,6 +254,24 @@ long getAinVoltCalibrated_hw130( u3CalibrationInfo *caliInfo,
 //bytesVolt = the 2 byte voltage that will be converted
 //analogVolt = the converted analog voltage
 
+long getStreamCalibration( u3CalibrationInfo *caliInfo,
+                           int dac1Enabled,
+                           uint8 positiveChannel,
+                           uint8 negChannel,
+                           LJUSB_StreamChannelCal *streamCal);
+//Gets the binary to volts conversion of a stream channel for the stream
+//decoder (LJUSB_StreamDecoderSetCal).  The conversion is the same as
+//getAinVoltCalibrated for hardware versions less than 1.30, and
+//getAinVoltCalibrated_hw130 for hardware version 1.30.  Call
+//getCalibrationInfo first to set up caliInfo.  Returns -1 on error, 0 on
+//success.
+//caliInfo = structure where calibrarion information is stored
+//dac1Enabled = If this is nonzero (True), then it is indicated that DAC1 is
+//              enabled.  Only used with hardware versions less than 1.30.
+//positiveChannel = the positive channel of the stream channel
+//negChannel = the negative channel of the stream channel
+//streamCal = the conversion of the stream channel
+
 long getDacBinVoltCalibrated( u3CalibrationInfo *caliInfo,
                               int dacNumber,
                               double analogVolt,
@@ -342,7 +421,9 @@ long I2C( HANDLE hDevice,
           uint8 *I2CBytesResponse);
 //This function will perform the I2C low-level function call.  Please refer to
 //section 5.3.19 of the U3 User's Guide for parameter documentation.  Returns
-//-1 on error, 0 on success.
+//-1 on error, 0 on success.  The command is sent with the I2C engine of
+//labjacki2c.h, so no memory is allocated; up to 50 bytes can be sent and 52
+//received.
 //hDevice = handle to a U3 device
 //I2COptions = byte 6 of the command
 //SpeedAdjust = byte 7 of the command
@@ -383,9 +464,11 @@ long eAIN( HANDLE Handle,
 //Call getCalibrationInfo first to set up CalibrationInfo.
 //Handle = Handle to a U3 device.
 //CalibrationInfo = Structure where calibration information is stored.
-//ConfigIO = If this is nonzero (True), then 1 or 2 ConfigIO low-level function
-//           calls will be made in addition to the 1 Feedback call to set the
-//           specified Channels to analog inputs.  If this is 0 (False), then
+//ConfigIO = If this is nonzero (True), then up to 2 ConfigIO low-level
+//           function calls will be made in addition to the 1 Feedback call to
+//           set the specified Channels to analog inputs.  No ConfigIO calls
+//           are made if the shadowed settings show the Channels are already
+//           analog inputs (see invalidateConfigShadow).  If this is 0 (False), then
 //           only a Feedback low-level call will be made, and an error will be
 //           returned if the specified Channels are not already set to analog
 //           inputs.
@@ -426,7 +509,8 @@ long eDAC( HANDLE Handle,
 //CalibrationInfo = structure where calibrarion information is stored
 //ConfigIO = If this is nonzero (True) and Channel is 1, then 1 ConfigIO
 //           low-level function call will be made in addition to the 1 Feedback
-//           call to enable DAC1.  If this is 0 (False), then only a Feedback
+//           call to enable DAC1, unless the shadowed settings show DAC1 is
+//           already enabled.  If this is 0 (False), then only a Feedback
 //           low-level call will be made, and an error will be returned if DAC1
 //           is not already enabled.
 //Channel = The analog output channel to write to.
@@ -435,6 +519,25 @@ long eDAC( HANDLE Handle,
 //         binary.
 //Reserved (1&2) = Pass 0.
 
+long eTDAC( HANDLE Handle,
+            u3TdacCalibrationInfo *TdacCalibrationInfo,
+            long DIOAPinNum,
+            double VoltageA,
+            double VoltageB);
+//An "easy" function that sets both outputs of an LJTick-DAC with one I2C
+//command, instead of one I2C command per output.  The command is sent with the
+//I2C engine of labjacki2c.h, so no memory is allocated.  Returns 0 for no
+//error, or -1 or >0 value (low-level errorcode) on error.  It returns -1 if the
+//LJTDAC does not acknowledge the command.
+//Handle = Handle to a U3 device.
+//TdacCalibrationInfo = Structure where LJTDAC calibration information is
+//                      stored.  Pass NULL to use the constants cached by
+//                      getTdacCalibrationInfoCached.
+//DIOAPinNum = The digital IO line where the LJTDAC DIOA pin is connected.
+//             The DIOB pin is assumed to be the next digital IO line.
+//VoltageA = The voltage to set DACA to.
+//VoltageB = The voltage to set DACB to.
+
 long eDI( HANDLE Handle,
           long ConfigIO,
           long Channel,
@@ -444,11 +547,13 @@ long eDI( HANDLE Handle,
 //ConfigIO is set as True.  Returns 0 for no error, or -1 or >0 value
 //(low-level errorcode) on error.
 //Handle = Handle to a U3 device.
-//ConfigIO = If this is nonzero (True), then 2 ConfigIO low-level functions
-//           calls will be made in addition to the 1 Feedback call to set
-//           Channel as digital.  If this is 0 (False), then only a Feedback
-//           low-level call will be made, and an error will be returned if
-//           Channel is not already set as digital.
+//ConfigIO = If this is nonzero (True), then up to 2 ConfigIO low-level
+//           functions calls will be made in addition to the 1 Feedback call to
+//           set Channel as digital.  No ConfigIO calls are made if the
+//           shadowed settings show Channel is already digital.  If this is 0
+//           (False), then only a Feedback low-level call will be made, and
+//           an error will be returned if Channel is not already set as
+//           digital.
 //Channel = The channel to read.  0-19 corresponds to FIO0-CIO3.
 //          For U3 hardware versions 1.30, HV model, Channel needs to be 4-19,
 //State = Returns the state of the digital input.  0=False=Low and 1=True=High.
@@ -462,16 +567,100 @@ long eDO( HANDLE Handle,
 //unless ConfigIO is set as True.  Returns 0 for no error, or -1 or >0 value
 //(low-level errorcode) on error.
 //Handle = Handle to a U3 device.
-//ConfigIO = If this is nonzero (True), then 2 ConfigIO low-level functions
-//           calls will be made in addition to the 1 Feedback call to set
-//           Channel as digital. If this is 0 (False), then only a Feedback
-//           low-level call will be made, and an error will be returned if
-//           Channel is not already set as digital.
+//ConfigIO = If this is nonzero (True), then up to 2 ConfigIO low-level
+//           functions calls will be made in addition to the 1 Feedback call to
+//           set Channel as digital.  No ConfigIO calls are made if the
+//           shadowed settings show Channel is already digital.  If this is 0
+//           (False), then only a Feedback low-level call will be made, and
+//           an error will be returned if Channel is not already set as
+//           digital.
 //Channel = The channel to write to.  0-19 corresponds to FIO0-CIO3.
 //          For U3 hardware versions 1.30, HV model, Channel needs to be 4-19,
 //State = The state to write to the digital output.  0=False=Low and
 //        1=True=High.
 
+long eAINs( HANDLE Handle,
+            u3CalibrationInfo *CalibrationInfo,
+            long ConfigIO,
+            long *DAC1Enable,
+            long NumChannels,
+            long *aChannelP,
+            long *aChannelN,
+            double *aVoltages,
+            long Range,
+            long Resolution,
+            long Settling,
+            long Binary,
+            long *aErrors,
+            long Reserved1,
+            long Reserved2);
+//An "easy" function that returns readings from several analog inputs, like
+//calling eAIN for each channel.  Up to 19 channels are read with each Feedback
+//call, so the minimum number of Feedback calls are made, and each one is
+//written before the response of the previous one is read.  Returns 0 for no
+//error, -1 on error, or the low-level errorcode (>0 value) of the first
+//channel that failed.
+//Call getCalibrationInfo first to set up CalibrationInfo.
+//Handle = Handle to a U3 device.
+//CalibrationInfo = Structure where calibration information is stored.
+//ConfigIO = If this is nonzero (True), then up to 2 ConfigIO low-level
+//           function calls will be made to set all of the channels to analog
+//           inputs, as in eAIN.
+//DAC1Enable = See eAIN.
+//NumChannels = The number of channels to read.
+//aChannelP = An array of the positive AIN channels to acquire (see eAIN).
+//aChannelN = An array of the negative AIN channels to acquire (see eAIN).
+//aVoltages = Returns the analog input readings.
+//Range = Ignored on the U3.
+//Resolution = Pass a nonzero value to enable QuickSample.
+//Settling = Pass a nonzero value to enable LongSettling.
+//Binary = If this is nonzero (True), aVoltages will return the raw binary
+//         values.
+//aErrors = Returns the low-level errorcode of each channel, 0 if it was read.
+//          The aVoltages element of a channel with an error is not set.  Pass
+//          NULL if not needed.
+//Reserved (1&2) = Pass 0.
+
+long eDIs( HANDLE Handle,
+           long ConfigIO,
+           long NumChannels,
+           long *aChannels,
+           long *aStates,
+           long *aErrors);
+//An "easy" function that reads the states of several digital inputs with one
+//Feedback call (PortDirWrite and PortStateRead).  Returns 0 for no error, or
+//-1 or >0 value (low-level errorcode) on error.
+//Handle = Handle to a U3 device.
+//ConfigIO = If this is nonzero (True), then up to 2 ConfigIO low-level
+//           function calls will be made to set all of the channels as
+//           digital, as in eDI.
+//NumChannels = The number of channels to read.
+//aChannels = An array of the channels to read.  0-19 corresponds to
+//            FIO0-CIO3.
+//aStates = Returns the states of the digital inputs.
+//aErrors = Returns the low-level errorcode of each channel.  Pass NULL if not
+//          needed.
+
+long eDOs( HANDLE Handle,
+           long ConfigIO,
+           long NumChannels,
+           long *aChannels,
+           long *aStates,
+           long *aErrors);
+//An "easy" function that writes the states of several digital outputs with
+//one Feedback call (PortDirWrite and PortStateWrite).  Returns 0 for no error,
+//or -1 or >0 value (low-level errorcode) on error.
+//Handle = Handle to a U3 device.
+//ConfigIO = If this is nonzero (True), then up to 2 ConfigIO low-level
+//           function calls will be made to set all of the channels as
+//           digital, as in eDO.
+//NumChannels = The number of channels to write.
+//aChannels = An array of the channels to write.  0-19 corresponds to
+//            FIO0-CIO3.
+//aStates = An array of the states to write.  0=False=Low and 1=True=High.
+//aErrors = Returns the low-level errorcode of each channel.  Pass NULL if not
+//          needed.
+
 long eTCConfig( HANDLE Handle,
                 long *aEnableTimers,
                 long *aEnableCounters,
@@ -484,8 +673,9 @@ long eTCConfig( HANDLE Handle,
                 long Reserved2);
 //An "easy" function that configures and initializes all the timers and
 //counters.  When needed, this function automatically configures the needed
-//lines as digital.  Returns 0 for no error, or -1 or >0 value (low-level
-//errorcode) on error.
+//lines as digital.  The ConfigTimerClock and ConfigIO calls are skipped when
+//the shadowed settings already match (see invalidateConfigShadow).  Returns 0
+//for no error, or -1 or >0 value (low-level errorcode) on error.
 //Handle = Handle to a U3 device.
 //aEnableTimers = An array where each element specifies whether that timer is
 //                enabled.  Timers must be enabled in order starting from 0, so
@@ -597,6 +787,90 @@ long ehFeedback( HANDLE hDevice,
 //bytes) as its parameter and performs a Feedback call with the U3.  Returns -1
 //or errorcode (>1 value) on error, 0 on success.
 
+long ehFeedbackPrepare( u3PreparedFeedback *feedback,
+                        uint8 *inIOTypesDataBuff,
+                        long inIOTypesDataSize,
+                        long outDataSize);
+//Builds a Feedback command packet, with its data word count, echo and
+//checksums, and the expected response size once, so that a Feedback command
+//with the same IOTypes can be sent many times with ehFeedbackExecute without
+//rebuilding it.  Values in the command, such as DAC values, are changed with
+//ehFeedbackPatch8 and ehFeedbackPatch16.  Returns 0 on success, or -1 if the
+//command or response does not fit in a packet.
+//feedback = The prepared Feedback command.
+//inIOTypesDataBuff = The IOTypes and their data, like the ehFeedback
+//                    parameter.
+//inIOTypesDataSize = The number of IOTypes bytes (up to 57).
+//outDataSize = The number of IOTypes response bytes (up to 55).
+
+long ehFeedbackPatch8( u3PreparedFeedback *feedback,
+                       long offset,
+                       uint8 value);
+//Changes one byte of the IOTypes data of a prepared Feedback command and
+//updates the checksums with the difference, without summing the packet again.
+//Returns 0 on success, or -1 if offset is not within the IOTypes data (the
+//command is then unchanged).
+//feedback = The prepared Feedback command.
+//offset = The index of the byte in inIOTypesDataBuff passed to
+//         ehFeedbackPrepare.
+//value = The new value.
+
+long ehFeedbackPatch16( u3PreparedFeedback *feedback,
+                        long offset,
+                        uint16 value);
+//Same as ehFeedbackPatch8, but changes two bytes (LSB first), for example the
+//value of a DAC0 (16-bit) IOType.  Returns -1 if either byte is not within the
+//IOTypes data.
+//feedback = The prepared Feedback command.
+//offset = The index of the LSB in inIOTypesDataBuff passed to
+//         ehFeedbackPrepare.
+//value = The new value.
+
+long ehFeedbackExecute( HANDLE hDevice,
+                        u3PreparedFeedback *feedback,
+                        uint8 *outErrorcode,
+                        uint8 *outErrorFrame,
+                        uint8 *outDataBuff);
+//Sends a prepared Feedback command and reads its response.  No memory is
+//allocated.  Returns -1 on error, 0 on success.
+//hDevice = Handle to a U3 device.
+//feedback = The prepared Feedback command.
+//outErrorcode = Returns the Feedback errorcode.
+//outErrorFrame = Returns the Feedback error frame.
+//outDataBuff = Returns the IOTypes response bytes (outDataSize bytes).  Pass
+//              NULL to not copy them; they are also at feedback->recBuff + 9.
+
+long ehStreamConfig( HANDLE hDevice,
+                     uint8 inNumChannels,
+                     uint8 inSamplesPerPacket,
+                     uint8 inScanConfig,
+                     uint16 inScanInterval,
+                     uint8 *inPChannels,
+                     uint8 *inNChannels);
+//Performs a StreamConfig call with the U3.  The parameters are the StreamConfig
+//low-level command bytes.  LJUSB_StreamPlanCompute (labjackstream.h) can pick
+//inSamplesPerPacket, inScanConfig (with the resolution bits) and
+//inScanInterval.  The analog inputs must be set as analog with ConfigIO.
+//Returns -1 or errorcode (>1 value) on error, 0 on success.
+//hDevice = Handle to a U3 device.
+//inNumChannels = The number of channels in each scan (1-25).
+//inSamplesPerPacket = The number of samples in each StreamData response
+//                     (1-25).
+//inScanConfig = The ScanConfig byte (clock frequency, divide by 256 and
+//               resolution bits).
+//inScanInterval = The ScanInterval, in clock ticks.
+//inPChannels = An array of the positive channel of each channel.
+//inNChannels = An array of the negative channel of each channel (31 for
+//              single-ended).
+
+long ehStreamStart( HANDLE hDevice);
+//Performs a StreamStart call with the U3.  Returns -1 or errorcode (>1 value)
+//on error, 0 on success.
+
+long ehStreamStop( HANDLE hDevice);
+//Performs a StreamStop call with the U3.  Returns -1 or errorcode (>1 value)
+//on error, 0 on success.  Errorcode 52 means the stream was not running.
+
 
 /* Easy function constants */
 
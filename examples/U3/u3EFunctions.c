@@ -38,8 +38,9 @@ int main(int argc, char **argv)
     if( hDevice  == NULL )
         goto done;
 
-    //Get calibration information from U3
-    error = getCalibrationInfo(hDevice, &caliInfo);
+    //Get calibration information from U3, keeping a copy in the calibration
+    //cache if its directory exists
+    error = getCalibrationInfoCached(hDevice, &caliInfo, 0);
     if( error < 0 )
         goto close;
 
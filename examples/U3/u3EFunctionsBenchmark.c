@@ -0,0 +1,98 @@
+//Author: LabJack
+//October 18, 2026
+//Measures the call rates of the eAIN and eDI "easy" functions with ConfigIO
+//set, with the ConfigIO settings shadow discarded before every call (each call
+//reads the settings with ConfigIO) and with the shadow kept (ConfigIO calls are
+//skipped when nothing changes).  Calls with ConfigIO set to 0 are measured for
+//reference.  Pass the number of seconds to run each test as an argument
+//(default 1).  Build with "make SIM=1" to run against a simulated U3, and set
+//LJSIM_LATENCY_US to model the USB round trip time.
+
+#include "u3.h"
+#include <time.h>
+
+enum { NO_SHADOW, SHADOW, NO_CONFIGIO };
+
+static const char *modeNames[] = {
+    "ConfigIO=1, no shadow",
+    "ConfigIO=1, shadow",
+    "ConfigIO=0"
+};
+
+static double getSeconds()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec/1.0e9;
+}
+
+//Calls eAIN (AIN3) or eDI (FIO4) for the given number of seconds and prints
+//the call rate.  Returns the easy function's error, or 0.
+static long benchmark(HANDLE hDevice, u3CalibrationInfo *caliInfo, int useAIN, int mode, double seconds)
+{
+    long DAC1Enable = 0, state, error = 0, calls = 0;
+    double voltage, start, elapsed;
+
+    start = getSeconds();
+    do
+    {
+        if( mode == NO_SHADOW )
+            invalidateConfigShadow(hDevice);
+
+        if( useAIN )
+            error = eAIN(hDevice, caliInfo, (mode != NO_CONFIGIO), &DAC1Enable, 3, 31, &voltage, 0, 0, 0, 0, 0, 0);
+        else
+            error = eDI(hDevice, (mode != NO_CONFIGIO), 4, &state);
+        if( error != 0 )
+        {
+            printf("%s error %ld\n", (useAIN ? "eAIN" : "eDI"), error);
+            return error;
+        }
+
+        calls++;
+        elapsed = getSeconds() - start;
+    } while( elapsed < seconds );
+
+    printf("%-5s %-22s %9.0f calls/s %9.1f us/call\n", (useAIN ? "eAIN" : "eDI"),
+           modeNames[mode], calls/elapsed, elapsed*1.0e6/calls);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    HANDLE hDevice;
+    u3CalibrationInfo caliInfo;
+    double seconds = 1.0;
+    int useAIN, mode;
+
+    if( argc > 1 )
+        seconds = atof(argv[1]);
+    if( seconds <= 0 )
+    {
+        printf("Usage: %s [seconds per test]\n", argv[0]);
+        return 1;
+    }
+
+    //Open first found U3 over USB
+    hDevice = openUSBConnection(-1);
+    if( hDevice == NULL )
+        return 1;
+
+    //Get calibration information from U3
+    if( getCalibrationInfo(hDevice, &caliInfo) < 0 )
+        goto close;
+
+    for( useAIN = 1; useAIN >= 0; useAIN-- )
+    {
+        for( mode = NO_SHADOW; mode <= NO_CONFIGIO; mode++ )
+        {
+            if( benchmark(hDevice, &caliInfo, useAIN, mode, seconds) != 0 )
+                goto close;
+        }
+    }
+
+close:
+    closeUSBConnection(hDevice);
+    return 0;
+}
@@ -0,0 +1,172 @@
+//Author: LabJack
+//October 18, 2026
+//Measures the command-response times of the U3 Feedback command for the
+//IOType mixes of Section 3.1 of the U3 User's Guide:  no I/O, the digital
+//I/O states, both DACs, one AIN with and without QuickSample and
+//LongSettling, and 16 AINs in one packet.  Each test sends a prepared
+//Feedback command (see ehFeedbackPrepare) many times and prints the mean,
+//median, 99th and 99.9th percentile and maximum round trip in microseconds,
+//so the times of a host can be compared with the Windows times of the User's
+//Guide and with earlier runs.  The AIN tests read FIO0-7 and EIO0-7 as they
+//are configured; u3allio configures them as analog inputs.  The DAC test
+//sets DAC0 and DAC1 to 0 V, and the digital write test writes the states the
+//lines already have.  Pass the number of commands per test as an argument
+//(default 2000); a test stops after 10 s if it has sent at least 100
+//commands.  Build with "make SIM=1" to run against a simulated U3, and set
+//LJSIM_LATENCY_US to add a USB round trip time.
+
+#include <string.h>
+#include <sys/utsname.h>
+#include "u3.h"
+
+#define MAX_TESTS         24
+#define WARMUP_COMMANDS   20
+#define MAX_TEST_SECONDS  10  //A slow test stops early, after at least 100 commands
+
+typedef struct
+{
+    char name[40];
+    uint8 ioTypes[64];
+    long ioTypesSize;
+    long dataSize;
+} FeedbackTest;
+
+static FeedbackTest tests[MAX_TESTS];
+static int numTests = 0;
+
+static FeedbackTest *addTest(const char *name, long dataSize)
+{
+    FeedbackTest *test = &tests[numTests++];
+
+    snprintf(test->name, sizeof(test->name), "%s", name);
+    test->ioTypesSize = 0;
+    test->dataSize = dataSize;
+    return test;
+}
+
+//Adds AIN IOTypes for single-ended AIN0 to AIN(numChannels-1)
+static void addAin(FeedbackTest *test, int numChannels, int quickSample, int longSettling)
+{
+    int i;
+
+    for( i = 0; i < numChannels; i++ )
+    {
+        test->ioTypes[test->ioTypesSize++] = 1;  //IOType is AIN
+        test->ioTypes[test->ioTypesSize++] = i + longSettling*64 + quickSample*128;  //Positive channel (bits 0-4), LongSettling (6), QuickSample (7)
+        test->ioTypes[test->ioTypesSize++] = 31;  //Negative channel is single-ended
+    }
+}
+
+//Runs a test and prints its times.  Returns -1 on error.
+static int runTest(HANDLE hDevice, FeedbackTest *test, int numCommands)
+{
+    u3PreparedFeedback feedback;
+    LJUSB_StreamAgeStats times;
+    unsigned long long startNs, testStartNs = 0;
+    uint8 errorcode, errorFrame, firstErrorcode = 0;
+    int i;
+
+    if( ehFeedbackPrepare(&feedback, test->ioTypes, test->ioTypesSize, test->dataSize) < 0 )
+        return -1;
+
+    LJUSB_StreamAgeStatsReset(&times);
+    for( i = -WARMUP_COMMANDS; i < numCommands; i++ )
+    {
+        startNs = LJUSB_GetTimestampNs();
+        if( ehFeedbackExecute(hDevice, &feedback, &errorcode, &errorFrame, NULL) < 0 )
+            return -1;
+        if( i >= 0 )
+            LJUSB_StreamAgeStatsAdd(&times, (LJUSB_GetTimestampNs() - startNs)/1.0e3);
+        else
+            testStartNs = LJUSB_GetTimestampNs();
+        if( errorcode != 0 && firstErrorcode == 0 )
+            firstErrorcode = errorcode;
+        if( times.count >= 100 && LJUSB_GetTimestampNs() - testStartNs > MAX_TEST_SECONDS*1000000000ULL )
+            break;
+    }
+
+    printf("%-32s %6llu %8.1f %8.1f %8.1f %8.1f %8.1f", test->name, times.count, times.sumUs/times.count,
+           LJUSB_StreamAgeStatsPercentile(&times, 50), LJUSB_StreamAgeStatsPercentile(&times, 99),
+           LJUSB_StreamAgeStatsPercentile(&times, 99.9), times.maxUs);
+    if( firstErrorcode != 0 )
+        printf("  (errorcode %d)", firstErrorcode);
+    printf("\n");
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    HANDLE hDevice;
+    u3CalibrationInfo caliInfo;
+    FeedbackTest *test;
+    struct utsname host;
+    uint8 readState[1], state[3], errorcode, errorFrame, bits8;
+    int numCommands = 2000, i, ret = 1;
+
+    if( argc > 1 )
+        numCommands = atoi(argv[1]);
+    if( numCommands < 1 )
+        numCommands = 1;
+
+    //Open first found U3 over USB
+    hDevice = openUSBConnection(-1);
+    if( hDevice == NULL )
+        return 1;
+
+    if( getCalibrationInfo(hDevice, &caliInfo) < 0 )
+        goto close;
+
+    //The digital write test writes the current states
+    readState[0] = 26;  //IOType is PortStateRead
+    if( ehFeedback(hDevice, readState, 1, &errorcode, &errorFrame, state, 3) != 0 )
+        goto close;
+
+    addTest("no I/O", 0);
+
+    test = addTest("read DIO states", 3);
+    test->ioTypes[test->ioTypesSize++] = 26;  //IOType is PortStateRead
+
+    test = addTest("write DIO states", 0);
+    test->ioTypes[test->ioTypesSize++] = 27;  //IOType is PortStateWrite
+    test->ioTypes[test->ioTypesSize++] = 255; //FIO WriteMask
+    test->ioTypes[test->ioTypesSize++] = 255; //EIO WriteMask
+    test->ioTypes[test->ioTypesSize++] = 15;  //CIO WriteMask
+    for( i = 0; i < 3; i++ )
+        test->ioTypes[test->ioTypesSize++] = state[i];
+
+    test = addTest("write DAC0 and DAC1", 0);
+    for( i = 0; i < 2; i++ )
+    {
+        if( getDacBinVoltCalibrated8Bit(&caliInfo, i, 0.0, &bits8) < 0 )
+            goto close;
+        test->ioTypes[test->ioTypesSize++] = 34 + i;  //IOType is DAC0 or DAC1 (8-bit)
+        test->ioTypes[test->ioTypesSize++] = bits8;
+    }
+
+    addAin(addTest("1 AIN", 2), 1, 0, 0);
+    addAin(addTest("1 AIN, QuickSample", 2), 1, 1, 0);
+    addAin(addTest("1 AIN, LongSettling", 2), 1, 0, 1);
+    addAin(addTest("4 AIN", 4*2), 4, 0, 0);
+    addAin(addTest("16 AIN", 16*2), 16, 0, 0);
+    addAin(addTest("16 AIN, QuickSample", 16*2), 16, 1, 0);
+
+    test = addTest("16 AIN and DIO states", 16*2 + 3);
+    addAin(test, 16, 0, 0);
+    test->ioTypes[test->ioTypesSize++] = 26;  //IOType is PortStateRead
+
+    uname(&host);
+    printf("U3 Feedback round trip times in us, %d commands per test, %s %s %s\n", numCommands, host.sysname,
+           host.release, host.machine);
+    printf("%-32s %6s %8s %8s %8s %8s %8s\n", "test", "n", "mean", "p50", "p99", "p99.9", "max");
+    for( i = 0; i < numTests; i++ )
+    {
+        if( runTest(hDevice, &tests[i], numCommands) < 0 )
+            goto close;
+        fflush(stdout);
+    }
+    ret = 0;
+
+close:
+    closeUSBConnection(hDevice);
+    return ret;
+}
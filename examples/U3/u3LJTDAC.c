@@ -23,11 +23,19 @@ int main(int argc, char **argv)
     if( configIO_example(hDevice) != 0 )
         goto close;
 
-    //Getting calibration information from LJTDAC
-    if( getTdacCalibrationInfo(hDevice, &caliInfo, 4) < 0 )
+    //Getting calibration information from LJTDAC.  It is read from the LJTDAC
+    //once and cached for the handle and pin.
+    if( getTdacCalibrationInfoCached(hDevice, &caliInfo, 4) < 0 )
         goto close;
 
-    LJTDAC_example(hDevice, &caliInfo);
+    if( LJTDAC_example(hDevice, &caliInfo) != 0 )
+        goto close;
+
+    //Setting DACA to 1.2 volts and DACB to 2.3 volts with one I2C command, using
+    //the cached calibration information
+    if( eTDAC(hDevice, NULL, 4, 1.2, 2.3) != 0 )
+        goto close;
+    printf("DACA and DACB set to 1.2 and 2.3 volts with one I2C command\n");
 
 close:
     closeUSBConnection(hDevice);
@@ -3,6 +3,7 @@
 //This example program reads analog inputs AI0-AI4 using stream mode.  Requires
 //a U3 with hardware version 1.21 or higher.
 
+#include <errno.h>
 #include "u3.h"
 
 int ConfigIO_example(HANDLE hDevice, int *isDAC1Enabled);
@@ -302,48 +303,72 @@ int StreamStart(HANDLE hDevice)
     return 0;
 }
 
-//Reads the StreamData low-level function response in a loop.  All voltages from
-//the stream are stored in the voltages 2D array.
+//Reads the StreamData low-level function response in a loop.  All samples from
+//the stream are stored as binary codes in the codes array, and only the
+//displayed scans are converted to voltages.
 int StreamData_example(HANDLE hDevice, u3CalibrationInfo *caliInfo, int isDAC1Enabled)
 {
-    uint16 voltageBytes, checksumTotal;
-    long startTime, endTime;
-    double hardwareVersion;
-    int recBuffSize, recChars, backLog, autoRecoveryOn;
-    int packetCounter, currChannel, scanNumber;
-    int i, j, k, m;
-    int totalPackets;  //The total number of StreamData responses read
-    int numDisplay;  //Number of times to display streaming information
-    int numReadsPerDisplay;  //Number of packets to read before displaying 
-                             //streaming information
+    LJUSB_StreamDecoder decoder;
+    LJUSB_StreamChannelCal streamCal;
+    uint8 *recBuff;
+    uint16 *codes;
+    double voltages[LJUSB_STREAM_MAX_CHANNELS];
+    unsigned long recBuffSize;
+    unsigned long totalScans;  //Number of scans the codes array can hold
+    unsigned long long startTime, timestampNs;
+    long numScans;
+    int recChars, autoRecoveryOn;
+    int i, j, k, scanNumber;
+    int ret;
+
+    int numDisplay;          //Number of times to display streaming information
+    int numReadsPerDisplay;  //Number of packets to read before displaying streaming information
     int readSizeMultiplier;  //Multiplier for the StreamData receive buffer size
-    int responseSize;  //The number of bytes in a StreamData response
-                       //(differs with SamplesPerPacket)
 
     numDisplay = 6;
     numReadsPerDisplay = 24;
     readSizeMultiplier = 5;
-    responseSize = 14 + SamplesPerPacket*2;
 
-    /* Each StreamData response contains (SamplesPerPacket / NumChannels) * readSizeMultiplier
-     * samples for each channel.
-     * Total number of scans = (SamplesPerPacket / NumChannels) * readSizeMultiplier * numReadsPerDisplay * numDisplay
+    //The decoder stores raw binary codes, 2 bytes per sample.  Use
+    //LJUSB_STREAM_OUTPUT_FLOAT32 or LJUSB_STREAM_OUTPUT_FLOAT64 to have it
+    //store calibrated voltages instead.
+    if( LJUSB_StreamDecoderInit(&decoder, U3_PRODUCT_ID, NumChannels, SamplesPerPacket, LJUSB_STREAM_OUTPUT_RAW16) != 0 )
+    {
+        printf("Error : could not set up the stream decoder.\n");
+        return -1;
+    }
+
+    for( i = 0; i < NumChannels; i++ )
+    {
+        //Single-ended channels, negative channel = 31 (see StreamConfig_example)
+        if( getStreamCalibration(caliInfo, isDAC1Enabled, i, 31, &streamCal) != 0 )
+            return -1;
+        LJUSB_StreamDecoderSetCal(&decoder, i, &streamCal);
+    }
+
+    /* Each StreamData response contains SamplesPerPacket samples and
+     * readSizeMultiplier responses are read at a time.
+     * Total number of scans = (SamplesPerPacket * readSizeMultiplier * numReadsPerDisplay * numDisplay) / NumChannels
      */
-    double voltages[(SamplesPerPacket/NumChannels)*readSizeMultiplier*numReadsPerDisplay*numDisplay][NumChannels];
-    uint8 recBuff[responseSize*readSizeMultiplier];
+    recBuffSize = LJUSB_StreamReadSize(&decoder, readSizeMultiplier);
+    totalScans = ((unsigned long)SamplesPerPacket*readSizeMultiplier*numReadsPerDisplay*numDisplay)/NumChannels;
+    recBuff = (uint8 *)malloc(sizeof(uint8)*recBuffSize);
+    codes = (uint16 *)malloc(sizeof(uint16)*totalScans*NumChannels);
+    if( recBuff == NULL || codes == NULL )
+    {
+        printf("Error : could not allocate the stream buffers.\n");
+        ret = -1;
+        goto cleanmem;
+    }
 
-    packetCounter = 0;
-    currChannel = 0;
     scanNumber = 0;
-    totalPackets = 0;
     recChars = 0;
     autoRecoveryOn = 0;
-    recBuffSize = 14 + SamplesPerPacket*2;
-    hardwareVersion = caliInfo->hardwareVersion;
+    ret = 0;
 
     printf("Reading Samples...\n");
 
-    startTime = getTickCount();
+    startTime = LJUSB_GetTimestampNs();
 
     for( i = 0; i < numDisplay; i++ )
     {
@@ -357,115 +382,73 @@ int StreamData_example(HANDLE hDevice, u3CalibrationInfo *caliInfo, int isDAC1En
              */
 
             //Reading stream response from U3
-            recChars = LJUSB_Stream(hDevice, recBuff, responseSize*readSizeMultiplier);
-            if( recChars < responseSize*readSizeMultiplier )
+            recChars = LJUSB_StreamStampedTO(hDevice, recBuff, recBuffSize, 1000, &timestampNs);
+            if( recChars < recBuffSize )
             {
-                if( recChars == 0 )
+                if(recChars == 0)
                     printf("Error : read failed (StreamData).\n");
                 else
-                    printf("Error : did not read all of the buffer, expected %d bytes but received %d(StreamData).\n", responseSize*readSizeMultiplier, recChars);
-                return -1;
+                    printf("Error : did not read all of the buffer, expected %lu bytes but received %d(StreamData).\n", recBuffSize, recChars);
+
+                ret = -1;
+                goto cleanmem;
             }
 
-            //Checking for errors and getting data out of each StreamData
-            //response
-            for( m = 0; m < readSizeMultiplier; m++ )
+            //Checking for errors and getting data out of each StreamData response
+            numScans = LJUSB_StreamDecodeStamped(&decoder, recBuff, recChars, timestampNs, codes + scanNumber*NumChannels, totalScans - scanNumber);
+            if( numScans < 0 )
             {
-                totalPackets++;
-
-                checksumTotal = extendedChecksum16(recBuff + m*recBuffSize, recBuffSize);
-                if( (uint8)((checksumTotal / 256) & 0xFF) != recBuff[m*recBuffSize + 5] )
-                {
-                    printf("Error : read buffer has bad checksum16(MSB) (StreamData).\n");
-                    return -1;
-                }
-
-                if( (uint8)(checksumTotal & 0xFF) != recBuff[m*recBuffSize + 4] )
-                {
-                    printf("Error : read buffer has bad checksum16(LBS) (StreamData).\n");
-                    return -1;
-                }
-
-                checksumTotal = extendedChecksum8(recBuff + m*recBuffSize);
-                if( checksumTotal != recBuff[m*recBuffSize] )
-                {
-                    printf("Error : read buffer has bad checksum8 (StreamData).\n");
-                    return -1;
-                }
-
-                if( recBuff[m*recBuffSize + 1] != (uint8)(0xF9) ||
-                    recBuff[m*recBuffSize + 2] != 4 + SamplesPerPacket ||
-                    recBuff[m*recBuffSize + 3] != (uint8)(0xC0) )
-                {
-                    printf("Error : read buffer has wrong command bytes (StreamData).\n");
-                    return -1;
-                }
-
-                if( recBuff[m*recBuffSize + 11] == 59 )
-                {
-                    if( !autoRecoveryOn )
-                    {
-                        printf("\nU3 data buffer overflow detected in packet %d.\nNow using auto-recovery and reading buffered samples.\n", totalPackets);
-                        autoRecoveryOn = 1;
-                    }
-                }
-                else if( recBuff[m*recBuffSize + 11] == 60 )
-                {
-                    printf("Auto-recovery report in packet %d: %d scans were dropped.\nAuto-recovery is now off.\n", totalPackets, recBuff[m*recBuffSize + 6] + recBuff[m*recBuffSize + 7]*256);
-                    autoRecoveryOn = 0;
-                }
-                else if( recBuff[m*recBuffSize + 11] != 0 )
-                {
-                    printf("Errorcode # %d from StreamData read.\n", (unsigned int)recBuff[11]);
-                    return -1;
-                }
-
-                if( packetCounter != (int)recBuff[m*recBuffSize + 10] )
-                {
-                    printf("PacketCounter (%d) does not match with with current packet count (%d)(StreamData).\n", recBuff[m*recBuffSize + 10], packetCounter);
-                    return -1;
-                }
-
-                backLog = (int)recBuff[m*48 + 12 + SamplesPerPacket*2];
-
-                for( k = 12; k < (12 + SamplesPerPacket*2); k += 2 )
-                {
-                    voltageBytes = (uint16)recBuff[m*recBuffSize + k] + (uint16)recBuff[m*recBuffSize + k+1]*256;
-
-                    if( hardwareVersion >= 1.30 )
-                        getAinVoltCalibrated_hw130(caliInfo, currChannel, 31, voltageBytes, &(voltages[scanNumber][currChannel]));
-                    else
-                        getAinVoltCalibrated(caliInfo, isDAC1Enabled, 31, voltageBytes, &(voltages[scanNumber][currChannel]));
-
-                    currChannel++;
-                    if( currChannel >= NumChannels )
-                    {
-                        currChannel = 0;
-                        scanNumber++;
-                    }
-                }
-
-                if( packetCounter >= 255 )
-                    packetCounter = 0;
+                if( errno == EIO )
+                    printf("Errorcode # %d from StreamData read.\n", decoder.errorcode);
+                else if( errno == EPROTO )
+                    printf("PacketCounter does not match with with current packet count (StreamData).\n");
                 else
-                    packetCounter++;
+                    printf("Error : read buffer has bad checksum or command bytes (StreamData).\n");
+
+                ret = -1;
+                goto cleanmem;
+            }
+            scanNumber += numScans;
+
+            if( decoder.autoRecoveryOn && !autoRecoveryOn )
+            {
+                printf("\nU3 data buffer overflow detected in packet %llu.\nNow using auto-recovery and reading buffered samples.\n", decoder.packets);
+                autoRecoveryOn = 1;
+            }
+
+            //Each auto-recovery report is a gap in the stream.  The scan
+            //indexes of the samples after it count the dropped scans.
+            for( k = 0; k < decoder.numGaps && k < LJUSB_STREAM_MAX_GAPS; k++ )
+                printf("Auto-recovery report: %llu scans were dropped starting at scan %llu.\n", decoder.gaps[k].numScans, decoder.gaps[k].scanIndex);
+
+            if( !decoder.autoRecoveryOn && autoRecoveryOn )
+            {
+                printf("Auto-recovery is now off.\n");
+                autoRecoveryOn = 0;
             }
         }
 
         printf("\nNumber of scans: %d\n", scanNumber);
-        printf("Total packets read: %d\n", totalPackets);
-        printf("Current PacketCounter: %d\n", ((packetCounter == 0) ? 255 : packetCounter-1));
-        printf("Current BackLog: %d\n", backLog);
-
+        printf("Total packets read: %llu\n", decoder.packets);
+        printf("Current PacketCounter: %d\n", ((decoder.packetCounter == 0) ? 255 : decoder.packetCounter-1));
+        printf("Current BackLog: %d\n", decoder.backlog);
+        printf("Last read completed at %.6f s, first sample in scan %llu\n", (decoder.timestampNs - startTime)/1.0e9, decoder.firstScanIndex);
+        printf("Measured scan rate: %.3f scans per second of host time\n", LJUSB_StreamClockScanRate(&decoder.clock));
+
+        //Converting the last scan to voltages
+        LJUSB_StreamConvert(decoder.cal, NumChannels, codes + (scanNumber - 1)*NumChannels, 1, voltages, LJUSB_STREAM_OUTPUT_FLOAT64);
         for( k = 0; k < NumChannels; k++ )
-            printf("  AI%d: %.4f V\n", k, voltages[scanNumber - 1][k]);
+            printf("  AI%d: %.4f V\n", k, voltages[k]);
     }
 
-    endTime = getTickCount();
-    printf("\nRate of samples: %.0lf samples per second\n", ((scanNumber*NumChannels) / ((endTime-startTime) / 1000.0)));
-    printf("Rate of scans: %.0lf scans per second\n\n", (scanNumber / ((endTime - startTime) / 1000.0)));
+    printf("\nRate of samples: %.0lf samples per second\n", (scanNumber*NumChannels)/((timestampNs - startTime)/1.0e9));
+    printf("Rate of scans: %.0lf scans per second\n\n", scanNumber/((timestampNs - startTime)/1.0e9));
 
-    return 0;
+cleanmem:
+    free(recBuff);
+    free(codes);
+
+    return ret;
 }
 
 //Sends a StreamStop low-level command to stop streaming.
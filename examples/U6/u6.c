@@ -4,6 +4,39 @@
 
 #include "u6.h"
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include "labjacki2c.h"
+
+//Size of the calibration memory read by getCalibrationInfo (blocks 0-9)
+#define U6_CALIBRATION_MEM_SIZE    320
+#define U6_CALIBRATION_BLOCK_SIZE  32
+
+//ReadMem commands of the calibration memory written ahead of their responses
+#define U6_CALIBRATION_READ_AHEAD  4
+
+//Largest IOType data sizes of a Feedback command and response (64 byte packets)
+#define U6_FEEDBACK_MAX_COMMAND_DATA   57
+#define U6_FEEDBACK_MAX_RESPONSE_DATA  55
+
+//Number of LJTDACs (handle and pin pairs) whose calibration is cached
+#define U6_MAX_TDAC_CACHE  16
+
+//Cached LJTDAC calibration constants of a handle and DIOA pin
+struct U6_TDAC_CACHE {
+    HANDLE hDevice;
+    uint8 DIOAPinNum;
+    u6TdacCalibrationInfo caliInfo;
+};
+
+static struct U6_TDAC_CACHE tdacCache[U6_MAX_TDAC_CACHE];
+
+static void clearTdacCache(HANDLE hDevice);
+static long feedbackWrite(HANDLE hDevice, u6PreparedFeedback *feedback);
+static long feedbackRead(HANDLE hDevice, u6PreparedFeedback *feedback, uint8 *outErrorcode, uint8 *outErrorFrame);
+
 
 u6CalibrationInfo U6_CALIBRATION_INFO_DEFAULT = {
     6,
@@ -199,6 +232,7 @@ locid_error:
 
 void closeUSBConnection(HANDLE hDevice)
 {
+    clearTdacCache(hDevice);
     LJUSB_CloseDevice(hDevice);
 }
 
@@ -240,12 +274,12 @@ invalid:
 }
 
 
-long getCalibrationInfo(HANDLE hDevice, u6CalibrationInfo *caliInfo)
+//Reads the ConfigU6 response (38 bytes) without changing the configuration.
+static long readConfigU6(HANDLE hDevice, uint8 *recBuffer)
 {
-    uint8 sendBuffer[64], recBuffer[64];
-    int sentRec = 0, offset = 0, i = 0;
+    uint8 sendBuffer[26];
+    int sentRec = 0, i = 0;
 
-    /* sending ConfigU6 command to get see if hi res */
     sendBuffer[1] = (uint8)(0xF8);  //command byte
     sendBuffer[2] = (uint8)(0x0A);  //number of data words
     sendBuffer[3] = (uint8)(0x08);  //extended command number
@@ -260,88 +294,322 @@ long getCalibrationInfo(HANDLE hDevice, u6CalibrationInfo *caliInfo)
     if( sentRec < 26 )
     {
         if( sentRec == 0 )
-            goto writeError0;
+            printf("Error : getCalibrationInfo write failed\n");
         else
-            goto writeError1;
+            printf("Error : getCalibrationInfo did not write all of the buffer\n");
+        return -1;
     }
 
     sentRec = LJUSB_Read(hDevice, recBuffer, 38);
     if( sentRec < 38 )
     {
         if( sentRec == 0 )
-            goto readError0;
+            printf("Error : getCalibrationInfo read failed\n");
         else
-            goto readError1;
+            printf("Error : getCalibrationInfo did not read all of the buffer\n");
+        return -1;
     }
 
     if( recBuffer[1] != (uint8)(0xF8) || recBuffer[2] != (uint8)(0x10) || recBuffer[3] != (uint8)(0x08) )
-        goto commandByteError;
+    {
+        printf("Error : getCalibrationInfo received wrong command bytes for ConfigU6\n");
+        return -1;
+    }
 
-    caliInfo->hiRes = (((recBuffer[37]&8) == 8)?1:0);
+    return 0;
+}
+
+
+//Writes the ReadMem command of a block of calibration memory.
+static long writeCalibrationBlockRequest(HANDLE hDevice, int blockNum)
+{
+    uint8 sendBuffer[8];
+    int sentRec = 0;
 
-    for( i = 0; i < 10; i++ )
+    sendBuffer[1] = (uint8)(0xF8);  //command byte
+    sendBuffer[2] = (uint8)(0x01);  //number of data words
+    sendBuffer[3] = (uint8)(0x2D);  //extended command number
+    sendBuffer[6] = 0;
+    sendBuffer[7] = (uint8)blockNum;  //Blocknum
+    extendedChecksum(sendBuffer, 8);
+
+    sentRec = LJUSB_Write(hDevice, sendBuffer, 8);
+    if( sentRec < 8 )
     {
-        /* reading block i from memory */
-        sendBuffer[1] = (uint8)(0xF8);  //command byte
-        sendBuffer[2] = (uint8)(0x01);  //number of data words
-        sendBuffer[3] = (uint8)(0x2D);  //extended command number
-        sendBuffer[6] = 0;
-        sendBuffer[7] = (uint8)i;       //Blocknum = i
-        extendedChecksum(sendBuffer, 8);
+        if( sentRec == 0 )
+            printf("Error : getCalibrationInfo write failed\n");
+        else
+            printf("Error : getCalibrationInfo did not write all of the buffer\n");
+        return -1;
+    }
 
-        sentRec = LJUSB_Write(hDevice, sendBuffer, 8);
-        if( sentRec < 8 )
-        {
-            if( sentRec == 0 )
-                goto writeError0;
-            else
-                goto writeError1;
-        }
+    return 0;
+}
+
+
+//Reads the ReadMem response of a block of calibration memory.
+static long readCalibrationBlockResponse(HANDLE hDevice, uint8 *blockData)
+{
+    uint8 recBuffer[40];
+    int sentRec = 0;
+
+    sentRec = LJUSB_Read(hDevice, recBuffer, 40);
+    if( sentRec < 40 )
+    {
+        if( sentRec == 0 )
+            printf("Error : getCalibrationInfo read failed\n");
+        else
+            printf("Error : getCalibrationInfo did not read all of the buffer\n");
+        return -1;
+    }
+
+    if( recBuffer[1] != (uint8)(0xF8) || recBuffer[2] != (uint8)(0x11) || recBuffer[3] != (uint8)(0x2D) )
+    {
+        printf("Error : getCalibrationInfo received wrong command bytes for ReadMem\n");
+        return -1;
+    }
 
-        sentRec = LJUSB_Read(hDevice, recBuffer, 40);
-        if( sentRec < 40 )
+    //block data starts on byte 8 of the buffer
+    memcpy(blockData, recBuffer + 8, U6_CALIBRATION_BLOCK_SIZE);
+
+    return 0;
+}
+
+
+//Reads all of the calibration memory.  Up to U6_CALIBRATION_READ_AHEAD ReadMem
+//commands are written before their responses are read, so the round trips of
+//the blocks overlap.
+static long readCalibrationMem(HANDLE hDevice, uint8 *calMem)
+{
+    int numBlocks = U6_CALIBRATION_MEM_SIZE/U6_CALIBRATION_BLOCK_SIZE;
+    int numWritten = 0, numRead = 0;
+
+    while( numRead < numBlocks )
+    {
+        while( numWritten < numBlocks && numWritten - numRead < U6_CALIBRATION_READ_AHEAD )
         {
-            if( sentRec == 0 )
-                goto readError0;
-            else
-                goto readError1;
+            if( writeCalibrationBlockRequest(hDevice, numWritten) != 0 )
+            {
+                //Reading the responses already in flight, so the next command
+                //does not read one of them
+                for( ; numRead < numWritten; numRead++ )
+                    readCalibrationBlockResponse(hDevice, calMem + numRead*U6_CALIBRATION_BLOCK_SIZE);
+                return -1;
+            }
+            numWritten++;
         }
 
-        if( recBuffer[1] != (uint8)(0xF8) || recBuffer[2] != (uint8)(0x11) || recBuffer[3] != (uint8)(0x2D) )
-            goto commandByteError;
+        if( readCalibrationBlockResponse(hDevice, calMem + numRead*U6_CALIBRATION_BLOCK_SIZE) != 0 )
+            return -1;
+        numRead++;
+    }
+
+    return 0;
+}
+
 
-        offset = i*4;
+//Converts the calibration memory blocks to the calibration constants.
+static void decodeCalibrationMem(uint8 *calMem, u6CalibrationInfo *caliInfo)
+{
+    int i;
 
-        //block data starts on byte 8 of the buffer
-        caliInfo->ccConstants[offset] = FPuint8ArrayToFPDouble(recBuffer + 8, 0);
-        caliInfo->ccConstants[offset + 1] = FPuint8ArrayToFPDouble(recBuffer + 8, 8);
-        caliInfo->ccConstants[offset + 2] = FPuint8ArrayToFPDouble(recBuffer + 8, 16);
-        caliInfo->ccConstants[offset + 3] = FPuint8ArrayToFPDouble(recBuffer + 8, 24);
-    }
+    for( i = 0; i < 40; i++ )
+        caliInfo->ccConstants[i] = FPuint8ArrayToFPDouble(calMem, i*8);
 
     caliInfo->prodID = 6;
+}
+
+
+long getCalibrationInfo(HANDLE hDevice, u6CalibrationInfo *caliInfo)
+{
+    uint8 recBuffer[38], calMem[U6_CALIBRATION_MEM_SIZE];
+
+    /* sending ConfigU6 command to get see if hi res */
+    if( readConfigU6(hDevice, recBuffer) != 0 )
+        return -1;
+
+    caliInfo->hiRes = (((recBuffer[37]&8) == 8)?1:0);
+
+    /* reading blocks 0-9 from memory */
+    if( readCalibrationMem(hDevice, calMem) != 0 )
+        return -1;
+
+    decodeCalibrationMem(calMem, caliInfo);
 
     return 0;
+}
 
-writeError0:
-    printf("Error : getCalibrationInfo write failed\n");
-    return -1;
 
-writeError1:
-    printf("Error : getCalibrationInfo did not write all of the buffer\n");
-    return -1;
+/* Calibration cache */
 
-readError0:
-    printf("Error : getCalibrationInfo read failed\n");
-    return -1;
+//Header of a calibration cache file.  The header is followed by memSize bytes
+//of calibration memory.
+struct CALIBRATION_CACHE_HEADER {
+    char magic[4];        //"LJCC"
+    uint8 version;
+    uint8 prodID;
+    uint16 reserved;
+    uint32 key;           //calibrationMemKey of the calibration memory
+    uint32 serialNumber;
+    uint32 memSize;
+};
 
-readError1:
-    printf("Error : getCalibrationInfo did not read all of the buffer\n");
-    return -1;
+//The key of a calibration memory copy:  the 32-bit FNV-1a hash of all of its
+//bytes, so a change to any block gives a different key.
+static uint32 calibrationMemKey(uint8 *calMem, int memSize)
+{
+    int i;
+    uint32 key = 2166136261u;
 
-commandByteError:
-    printf("Error : getCalibrationInfo received wrong command bytes for ReadMem\n");
-    return -1;
+    for( i = 0; i < memSize; i++ )
+        key = (key ^ calMem[i])*16777619u;
+
+    return key;
+}
+
+
+//Gets the path of the cache file of a device.  The default cache directory is
+//only created if createDir is nonzero.  Returns -1 if the cache is disabled or
+//there is no cache directory.
+static long getCalibrationCachePath(uint32 serialNumber, int createDir, char *path, int pathSize)
+{
+    char cacheDir[256];
+    const char *dir;
+
+    dir = getenv("LJ_CALIBRATION_CACHE_DIR");
+    if( dir == NULL )
+    {
+        if( (dir = getenv("XDG_CACHE_HOME")) != NULL && dir[0] != '\0' )
+        {
+            snprintf(cacheDir, sizeof(cacheDir), "%s", dir);
+        }
+        else if( (dir = getenv("HOME")) != NULL && dir[0] != '\0' )
+        {
+            snprintf(cacheDir, sizeof(cacheDir), "%s/.cache", dir);
+        }
+        else
+            return -1;
+
+        if( createDir != 0 )
+            mkdir(cacheDir, 0755);
+        strncat(cacheDir, "/labjack", sizeof(cacheDir) - strlen(cacheDir) - 1);
+        if( createDir != 0 )
+            mkdir(cacheDir, 0755);
+        dir = cacheDir;
+    }
+
+    //An empty LJ_CALIBRATION_CACHE_DIR disables the cache
+    if( dir[0] == '\0' )
+        return -1;
+
+    if( snprintf(path, pathSize, "%s/u6_%u.cal", dir, serialNumber) >= pathSize )
+        return -1;
+
+    return 0;
+}
+
+
+//Reads a cache file.  Returns -1 if it is missing, it is for another device,
+//or its memory does not match its key.
+static long readCalibrationCache(const char *path, uint32 serialNumber, uint8 *calMem, int memSize)
+{
+    struct CALIBRATION_CACHE_HEADER header;
+    FILE *file;
+    long ret = -1;
+
+    if( (file = fopen(path, "rb")) == NULL )
+        return -1;
+
+    if( fread(&header, sizeof(header), 1, file) == 1 &&
+        memcmp(header.magic, "LJCC", 4) == 0 &&
+        header.version == 2 &&
+        header.prodID == 6 &&
+        header.serialNumber == serialNumber &&
+        header.memSize == (uint32)memSize &&
+        fread(calMem, 1, memSize, file) == (size_t)memSize &&
+        calibrationMemKey(calMem, memSize) == header.key )
+        ret = 0;
+
+    fclose(file);
+    return ret;
+}
+
+
+static void writeCalibrationCache(const char *path, uint32 serialNumber, uint8 *calMem, int memSize)
+{
+    struct CALIBRATION_CACHE_HEADER header;
+    char tmpPath[512];
+    FILE *file;
+    int ok;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "LJCC", 4);
+    header.version = 2;
+    header.prodID = 6;
+    header.key = calibrationMemKey(calMem, memSize);
+    header.serialNumber = serialNumber;
+    header.memSize = memSize;
+
+    //Writing to a temporary file and renaming it so other processes never
+    //read a partial file
+    if( snprintf(tmpPath, sizeof(tmpPath), "%s.%d", path, (int)getpid()) >= (int)sizeof(tmpPath) )
+        return;
+
+    if( (file = fopen(tmpPath, "wb")) == NULL )
+        return;
+
+    ok = (fwrite(&header, sizeof(header), 1, file) == 1 &&
+          fwrite(calMem, 1, memSize, file) == (size_t)memSize);
+    if( fclose(file) != 0 )
+        ok = 0;
+
+    if( !ok || rename(tmpPath, path) != 0 )
+        remove(tmpPath);
+}
+
+
+long getCalibrationInfoCached(HANDLE hDevice, u6CalibrationInfo *caliInfo, long CreateCacheDir)
+{
+    uint8 recBuffer[38], calMem[U6_CALIBRATION_MEM_SIZE], cachedMem[U6_CALIBRATION_MEM_SIZE];
+    uint32 serialNumber;
+    char path[512];
+    int cacheEnabled;
+
+    /* sending ConfigU6 command to get the serial number and see if hi res */
+    if( readConfigU6(hDevice, recBuffer) != 0 )
+        return -1;
+
+    caliInfo->hiRes = (((recBuffer[37]&8) == 8)?1:0);
+    serialNumber = recBuffer[15] + recBuffer[16]*256 + recBuffer[17]*65536 + ((uint32)recBuffer[18])*16777216;
+
+    cacheEnabled = (getCalibrationCachePath(serialNumber, (int)CreateCacheDir, path, sizeof(path)) == 0);
+
+    //Using the cached memory if block 0 of the device's memory matches it, one
+    //ReadMem round trip instead of one per block
+    if( cacheEnabled &&
+        readCalibrationCache(path, serialNumber, cachedMem, U6_CALIBRATION_MEM_SIZE) == 0 )
+    {
+        if( writeCalibrationBlockRequest(hDevice, 0) != 0 ||
+            readCalibrationBlockResponse(hDevice, calMem) != 0 )
+            return -1;
+
+        if( memcmp(calMem, cachedMem, U6_CALIBRATION_BLOCK_SIZE) == 0 )
+        {
+            decodeCalibrationMem(cachedMem, caliInfo);
+            return 0;
+        }
+    }
+
+    /* reading blocks 0-9 from memory */
+    if( readCalibrationMem(hDevice, calMem) != 0 )
+        return -1;
+
+    decodeCalibrationMem(calMem, caliInfo);
+
+    if( cacheEnabled )
+        writeCalibrationCache(path, serialNumber, calMem, U6_CALIBRATION_MEM_SIZE);
+
+    return 0;
 }
 
 
@@ -387,6 +655,49 @@ long getTdacCalibrationInfo(HANDLE hDevice, u6TdacCalibrationInfo *caliInfo, uin
 }
 
 
+static void clearTdacCache(HANDLE hDevice)
+{
+    int i;
+
+    for( i = 0; i < U6_MAX_TDAC_CACHE; i++ )
+    {
+        if( tdacCache[i].hDevice == hDevice )
+            memset(&tdacCache[i], 0, sizeof(struct U6_TDAC_CACHE));
+    }
+}
+
+
+long getTdacCalibrationInfoCached(HANDLE hDevice, u6TdacCalibrationInfo *caliInfo, uint8 DIOAPinNum)
+{
+    struct U6_TDAC_CACHE *unused = NULL;
+    int i;
+
+    for( i = 0; i < U6_MAX_TDAC_CACHE; i++ )
+    {
+        if( tdacCache[i].hDevice == hDevice && tdacCache[i].DIOAPinNum == DIOAPinNum )
+        {
+            *caliInfo = tdacCache[i].caliInfo;
+            return 0;
+        }
+        if( unused == NULL && tdacCache[i].hDevice == NULL )
+            unused = &tdacCache[i];
+    }
+
+    if( getTdacCalibrationInfo(hDevice, caliInfo, DIOAPinNum) < 0 )
+        return -1;
+
+    //When the cache is full the constants are returned but not cached
+    if( unused != NULL )
+    {
+        unused->hDevice = hDevice;
+        unused->DIOAPinNum = DIOAPinNum;
+        unused->caliInfo = *caliInfo;
+    }
+
+    return 0;
+}
+
+
 double FPuint8ArrayToFPDouble(uint8 *buffer, int startIndex)
 {
     uint32 resultDec = 0, resultWh = 0;
@@ -434,6 +745,31 @@ long getAinVoltCalibrated(u6CalibrationInfo *caliInfo, int resolutionIndex, int
 }
 
 
+long getStreamCalibration(u6CalibrationInfo *caliInfo, int resolutionIndex, int gainIndex, LJUSB_StreamChannelCal *streamCal)
+{
+    int indexAdjust = 0;
+
+    if( isCalibrationInfoValid(caliInfo) == 0 )
+        return -1;
+
+    if( gainIndex < 0 || gainIndex > 3 )
+    {
+        printf("getStreamCalibration error: invalid gain index.\n");
+        return -1;
+    }
+    if( resolutionIndex > 8 )
+        indexAdjust = 24;
+
+    //Codes below the center point use the negative slope
+    streamCal->center = caliInfo->ccConstants[indexAdjust + gainIndex*2 + 9];
+    streamCal->slopeBelow = -caliInfo->ccConstants[indexAdjust + gainIndex*2 + 8];
+    streamCal->slopeAbove = caliInfo->ccConstants[indexAdjust + gainIndex*2];
+    streamCal->offset = 0;
+
+    return 0;
+}
+
+
 long getDacBinVoltCalibrated8Bit(u6CalibrationInfo *caliInfo, int dacNumber, double analogVolt, uint8 *bytesVolt8)
 {
     uint16 u16BytesVolt = 0;
@@ -486,7 +822,7 @@ long getTempKCalibrated(u6CalibrationInfo *caliInfo, int resolutionIndex, int ga
 
 long getTdacBinVoltCalibrated(u6TdacCalibrationInfo *caliInfo, int dacNumber, double analogVolt, uint16 *bytesVolt)
 {
-    uint32 dBytesVolt;
+    double dBytesVolt;
 
     if( isTdacCalibrationInfoValid(caliInfo) == 0 )
         return -1;
@@ -500,7 +836,9 @@ long getTdacBinVoltCalibrated(u6TdacCalibrationInfo *caliInfo, int dacNumber, do
     dBytesVolt = analogVolt*caliInfo->ccConstants[dacNumber*2] + caliInfo->ccConstants[dacNumber*2 + 1];
 
     //Checking to make sure bytesVolt will be a value between 0 and 65535.
-    if( dBytesVolt > 65535 )
+    if( dBytesVolt < 0 )
+        dBytesVolt = 0;
+    else if( dBytesVolt > 65535 )
         dBytesVolt = 65535;
 
     *bytesVolt = (uint16)dBytesVolt;
@@ -534,122 +872,54 @@ long getTempKUncalibrated(int resolutionIndex, int gainIndex, int bits24, uint32
 
 long I2C(HANDLE hDevice, uint8 I2COptions, uint8 SpeedAdjust, uint8 SDAPinNum, uint8 SCLPinNum, uint8 Address, uint8 NumI2CBytesToSend, uint8 NumI2CBytesToReceive, uint8 *I2CBytesCommand, uint8 *Errorcode, uint8 *AckArray, uint8 *I2CBytesResponse)
 {
-    uint8 *sendBuff, *recBuff;
-    uint16 checksumTotal = 0;
-    uint32 ackArrayTotal, expectedAckArray;
-    int sendChars, recChars, sendSize, recSize, i, ret;
+    LJUSB_I2CEngine engine;
+    LJUSB_I2CTransaction *t;
+    uint32 expectedAckArray;
+    int i;
 
     *Errorcode = 0;
-    ret = 0;
-    sendSize = 6 + 8 + ((NumI2CBytesToSend%2 != 0)?(NumI2CBytesToSend + 1):(NumI2CBytesToSend));
-    recSize = 6 + 6 + ((NumI2CBytesToReceive%2 != 0)?(NumI2CBytesToReceive + 1):(NumI2CBytesToReceive));
-
-    sendBuff = (uint8 *)malloc(sizeof(uint8)*sendSize);
-    recBuff = (uint8 *)malloc(sizeof(uint8)*recSize);
-
-    sendBuff[sendSize - 1] = 0;
-
-    //I2C command
-    sendBuff[1] = (uint8)(0xF8);     //Command byte
-    sendBuff[2] = (sendSize - 6)/2;  //Number of data words = 4 + NumI2CBytesToSend
-    sendBuff[3] = (uint8)(0x3B);     //Extended command number
-
-    sendBuff[6] = I2COptions;             //I2COptions
-    sendBuff[7] = SpeedAdjust;            //SpeedAdjust
-    sendBuff[8] = SDAPinNum;              //SDAPinNum
-    sendBuff[9] = SCLPinNum;              //SCLPinNum
-    sendBuff[10] = Address;               //Address
-    sendBuff[11] = 0;                     //Reserved
-    sendBuff[12] = NumI2CBytesToSend;     //NumI2CByteToSend
-    sendBuff[13] = NumI2CBytesToReceive;  //NumI2CBytesToReceive
-
-    for( i = 0; i < NumI2CBytesToSend; i++ )
-        sendBuff[14 + i] = I2CBytesCommand[i];  //I2CByte
-
-    extendedChecksum(sendBuff, sendSize);
 
-    //Sending command to U6
-    sendChars = LJUSB_Write(hDevice, sendBuff, sendSize);
-    if( sendChars < sendSize )
+    //Sending the I2C command with the I2C engine of labjacki2c.h, one command
+    //at a time and without allocating memory
+    if( LJUSB_I2CEngineInit(&engine, hDevice, I2COptions, SpeedAdjust, SDAPinNum, SCLPinNum, 1) < 0 )
     {
-        if( sendChars == 0 )
-            printf("I2C Error : write failed\n");
-        else
-            printf("I2C Error : did not write all of the buffer\n");
-        ret = -1;
-        goto cleanmem;
+        printf("I2C Error : invalid handle\n");
+        return -1;
     }
 
-    //Reading response from U6
-    recChars = LJUSB_Read(hDevice, recBuff, recSize);
-    if( recChars < recSize )
+    //A response with a non-zero errorcode or missing acks is still returned
+    t = &engine.queue[0];
+    if( LJUSB_I2CTransfer(&engine, Address, I2CBytesCommand, NumI2CBytesToSend, I2CBytesResponse, NumI2CBytesToReceive) < 0 &&
+        errno != EPROTO && errno != ENXIO )
     {
-        if( recChars == 0 )
-            printf("I2C Error : read failed\n");
+        if( errno == EINVAL )
+            printf("I2C Error : invalid byte counts or buffers\n");
+        else if( errno == EBADMSG )
+            printf("I2C Error : read buffer has bad checksum or command bytes\n");
         else
-        {
-            printf("I2C Error : did not read all of the buffer\n");
-            if( recChars >= 12 )
-                *Errorcode = recBuff[6];
-        }
-        ret = -1;
-        goto cleanmem;
+            printf("I2C Error : write or read failed\n");
+        *Errorcode = (uint8)t->errorcode;
+        return -1;
     }
 
-    *Errorcode = recBuff[6];
+    *Errorcode = (uint8)t->errorcode;
 
-    AckArray[0] = recBuff[8];
-    AckArray[1] = recBuff[9];
-    AckArray[2] = recBuff[10];
-    AckArray[3] = recBuff[11];
+    AckArray[0] = (uint8)(t->ackArray & 0xFF);
+    AckArray[1] = (uint8)((t->ackArray >> 8) & 0xFF);
+    AckArray[2] = (uint8)((t->ackArray >> 16) & 0xFF);
+    AckArray[3] = (uint8)((t->ackArray >> 24) & 0xFF);
 
     for( i = 0; i < NumI2CBytesToReceive; i++ )
-        I2CBytesResponse[i] = recBuff[12 + i];
-
-    if( (uint8)(extendedChecksum8(recBuff)) != recBuff[0] )
-    {
-        printf("I2C Error : read buffer has bad checksum (%d)\n", recBuff[0]);
-        ret = -1;
-    }
-
-    if( recBuff[1] != (uint8)(0xF8) )
-    {
-        printf("I2C Error : read buffer has incorrect command byte (%d)\n", recBuff[1]);
-        ret = -1;
-    }
-
-    if( recBuff[2] != (uint8)((recSize - 6)/2) )
-    {
-        printf("I2C Error : read buffer has incorrect number of data words (%d)\n", recBuff[2]);
-        ret = -1;
-    }
-
-    if( recBuff[3] != (uint8)(0x3B) )
-    {
-        printf("I2C Error : read buffer has incorrect extended command number (%d)\n", recBuff[3]);
-        ret = -1;
-    }
+        I2CBytesResponse[i] = t->response[i];
 
-    checksumTotal = extendedChecksum16(recBuff, recSize);
-    if( (uint8)((checksumTotal / 256) & 0xff) != recBuff[5] || (uint8)(checksumTotal & 255) != recBuff[4] )
+    //AckArray should ack the Address byte in the first ack bit
+    if( t->acked == 0 )
     {
-        printf("I2C error : read buffer has bad checksum16 (%u)\n", checksumTotal);
-        ret = -1;
+        expectedAckArray = (NumI2CBytesToSend + 1 >= 32) ? 0xFFFFFFFF : ((uint32)1 << (NumI2CBytesToSend + 1)) - 1;
+        printf("I2C error : expected an ack of %u, but received %u\n", expectedAckArray, t->ackArray);
     }
 
-    //ackArray should ack the Address byte in the first ack bit
-    ackArrayTotal = AckArray[0] + AckArray[1]*256 + AckArray[2]*65536 + AckArray[3]*16777216;
-    expectedAckArray = pow(2.0,  NumI2CBytesToSend+1)-1;
-    if( ackArrayTotal != expectedAckArray )
-        printf("I2C error : expected an ack of %u, but received %u\n", expectedAckArray, ackArrayTotal);
-
-cleanmem:
-    free(sendBuff);
-    free(recBuff);
-    sendBuff = NULL;
-    recBuff = NULL;
-
-    return ret;
+    return 0;
 }
 
 
@@ -793,28 +1063,85 @@ long eDAC(HANDLE Handle, u6CalibrationInfo *CalibrationInfo, long Channel, doubl
 }
 
 
-long eDI(HANDLE Handle, long Channel, long *State)
+long eTDAC(HANDLE Handle, u6TdacCalibrationInfo *TdacCalibrationInfo, long DIOAPinNum, double VoltageA, double VoltageB)
 {
-    uint8 sendDataBuff[4], recDataBuff[1];
-    uint8 Errorcode, ErrorFrame;
+    u6TdacCalibrationInfo caliInfo;
+    LJUSB_I2CEngine engine;
+    uint8 bytesCommand[6];
+    uint16 bytesVolt;
+    int i;
 
-    if( Channel < 0 || Channel > 19 )
+    if( DIOAPinNum < 0 || DIOAPinNum > 254 )
     {
-        printf("eDI error: Invalid Channel.\n");
+        printf("eTDAC error: Invalid DIOAPinNum.\n");
         return -1;
     }
 
+    if( TdacCalibrationInfo == NULL )
+    {
+        if( getTdacCalibrationInfoCached(Handle, &caliInfo, (uint8)DIOAPinNum) < 0 )
+            return -1;
+        TdacCalibrationInfo = &caliInfo;
+    }
+    else if( isTdacCalibrationInfoValid(TdacCalibrationInfo) == 0 )
+    {
+        printf("eTDAC error: Invalid LJTDAC calibration information.\n");
+        return -1;
+    }
 
-    /* Setting up Feedback command to set digital Channel to input and to read from it */
-    sendDataBuff[0] = 13;       //IOType is BitDirWrite
-    sendDataBuff[1] = Channel;  //IONumber(bits 0-4) + Direction (bit 7)
+    /* Setting up the DACA and DACB command bytes (h0x30 and h0x31) and values
+       (MSB first) of one I2C command to the DAC (address h0x24) */
+    for( i = 0; i < 2; i++ )
+    {
+        if( getTdacBinVoltCalibrated(TdacCalibrationInfo, i, (i == 0) ? VoltageA : VoltageB, &bytesVolt) < 0 )
+            return -1;
 
-    sendDataBuff[2] = 10;       //IOType is BitStateRead
-    sendDataBuff[3] = Channel;  //IONumber
+        bytesCommand[i*3] = (uint8)(0x30 + i);  //LJTDAC command byte : DACA or DACB
+        bytesCommand[i*3 + 1] = (uint8)(bytesVolt/256);  //value (high)
+        bytesCommand[i*3 + 2] = (uint8)(bytesVolt & 255);  //value (low)
+    }
 
-    if( ehFeedback(Handle, sendDataBuff, 4, &Errorcode, &ErrorFrame, recDataBuff, 1) < 0 )
-        return -1;
-    if( Errorcode )
+    //Sending the I2C command with the I2C engine of labjacki2c.h, which
+    //builds it in the engine's buffers instead of allocating them
+    if( LJUSB_I2CEngineInit(&engine, Handle, 0, 0, (uint8)DIOAPinNum + 1, (uint8)DIOAPinNum, 1) < 0 ||
+        LJUSB_I2CTransfer(&engine, (uint8)(0x24), bytesCommand, 6, NULL, 0) < 0 )
+    {
+        if( errno == EPROTO )
+            return (long)engine.queue[0].errorcode;
+
+        if( errno == ENXIO )
+            printf("eTDAC error: the LJTDAC did not acknowledge the I2C command\n");
+        else
+            printf("eTDAC error: I2C command failed : %s\n", strerror(errno));
+        return -1;
+    }
+
+    return 0;
+}
+
+
+long eDI(HANDLE Handle, long Channel, long *State)
+{
+    uint8 sendDataBuff[4], recDataBuff[1];
+    uint8 Errorcode, ErrorFrame;
+
+    if( Channel < 0 || Channel > 19 )
+    {
+        printf("eDI error: Invalid Channel.\n");
+        return -1;
+    }
+
+
+    /* Setting up Feedback command to set digital Channel to input and to read from it */
+    sendDataBuff[0] = 13;       //IOType is BitDirWrite
+    sendDataBuff[1] = Channel;  //IONumber(bits 0-4) + Direction (bit 7)
+
+    sendDataBuff[2] = 10;       //IOType is BitStateRead
+    sendDataBuff[3] = Channel;  //IONumber
+
+    if( ehFeedback(Handle, sendDataBuff, 4, &Errorcode, &ErrorFrame, recDataBuff, 1) < 0 )
+        return -1;
+    if( Errorcode )
         return (long)Errorcode;
 
     *State = recDataBuff[0];
@@ -849,6 +1176,293 @@ long eDO(HANDLE Handle, long Channel, long State)
 }
 
 
+long eAINs(HANDLE Handle, u6CalibrationInfo *CalibrationInfo, long NumChannels, long *aChannelP, long *aChannelN, double *aVoltages, long Range, long Resolution, long Settling, long Binary, long *aErrors, long Reserved1, long Reserved2)
+{
+    u6PreparedFeedback feedback;
+    uint8 sendDataBuff[U6_FEEDBACK_MAX_COMMAND_DATA], *recDataBuff;
+    uint8 diff, gain, frameGain, ioType, Errorcode, ErrorFrame;
+    uint32 bytesV;
+    int i, start, numFrames, maxFrames, recSize, firstError;
+    int next, retryStart, retryEnd, numValid;
+    long recChars, error;
+
+    if( isCalibrationInfoValid(CalibrationInfo) == 0 )
+    {
+        printf("eAINs error: Invalid calibration information.\n");
+        return -1;
+    }
+
+    if( NumChannels < 1 || aChannelP == NULL || aChannelN == NULL || aVoltages == NULL )
+    {
+        printf("eAINs error: Invalid channel arrays.\n");
+        return -1;
+    }
+
+    for( i = 0; i < NumChannels; i++ )
+    {
+        //Checking if acceptable positive channel
+        if( aChannelP[i] < 0 || aChannelP[i] > 143 )
+        {
+            printf("eAINs error: Invalid ChannelP value %ld.\n", aChannelP[i]);
+            return -1;
+        }
+
+        //Checking if single ended or differential reading
+        if( !(aChannelN[i] == 0 || aChannelN[i] == 15 ||
+              ((aChannelN[i]&1) == 1 && aChannelN[i] == aChannelP[i] + 1)) )
+        {
+            printf("eAINs error: Invalid ChannelN value %ld.\n", aChannelN[i]);
+            return -1;
+        }
+
+        if( aErrors != NULL )
+            aErrors[i] = 0;
+    }
+
+    if( Range == LJ_rgAUTO )
+        gain = 15;
+    else if( Range == LJ_rgBIP10V )
+        gain = 0;
+    else if( Range == LJ_rgBIP1V )
+        gain = 1;
+    else if( Range == LJ_rgBIPP1V )
+        gain = 2;
+    else if( Range == LJ_rgBIPP01V )
+        gain = 3;
+    else
+    {
+        printf("eAINs error: Invalid Range value\n");
+        return -1;
+    }
+
+    if( Resolution < 0 || Resolution > 13 )
+    {
+        printf("eAINs error: Invalid Resolution value\n");
+        return -1;
+    }
+
+    if( Settling < 0 || Settling > 4 )
+    {
+        printf("eAINs error: Invalid Settling value\n");
+        return -1;
+    }
+
+    //AIN24AR returns the gain used with auto range, so it is only needed for
+    //LJ_rgAUTO.  14 AIN24 or 11 AIN24AR readings fit in a Feedback call.
+    ioType = (gain == 15) ? 3 : 2;
+    recSize = (gain == 15) ? 5 : 3;
+    maxFrames = U6_FEEDBACK_MAX_COMMAND_DATA/4;
+    if( maxFrames > U6_FEEDBACK_MAX_RESPONSE_DATA/recSize )
+        maxFrames = U6_FEEDBACK_MAX_RESPONSE_DATA/recSize;
+    firstError = 0;
+    error = 0;
+
+    //Channels next and up have not been sent yet, and the channels from
+    //retryStart to retryEnd - 1 followed a failed frame and are sent again.
+    //The U6 runs one command at a time, so each Feedback command is written
+    //after the response of the previous one is read.
+    next = 0;
+    retryStart = retryEnd = 0;
+
+    while( next < NumChannels || retryStart < retryEnd )
+    {
+        /* Setting up Feedback command to read as many analog inputs as fit */
+        if( retryStart < retryEnd )
+        {
+            start = retryStart;
+            numFrames = retryEnd - retryStart;
+            retryStart = retryEnd;
+        }
+        else
+        {
+            start = next;
+            numFrames = (NumChannels - next < maxFrames) ? NumChannels - next : maxFrames;
+            next += numFrames;
+        }
+
+        for( i = 0; i < numFrames; i++ )
+        {
+            diff = (aChannelN[start + i] == 0 || aChannelN[start + i] == 15) ? 0 : 1;
+            sendDataBuff[i*4] = ioType;  //IOType is AIN24 or AIN24AR
+            sendDataBuff[i*4 + 1] = (uint8)aChannelP[start + i];  //Positive channel
+            sendDataBuff[i*4 + 2] = (uint8)Resolution + gain*16;  //Res Index (0-3), Gain Index (4-7)
+            sendDataBuff[i*4 + 3] = (uint8)Settling + diff*128;  //Settling factor (0-2), Differential (7)
+        }
+
+        if( ehFeedbackPrepare(&feedback, sendDataBuff, numFrames*4, numFrames*recSize) < 0 ||
+            feedbackWrite(Handle, &feedback) < 0 )
+            return -1;
+        if( (recChars = feedbackRead(Handle, &feedback, &Errorcode, &ErrorFrame)) < 0 )
+            return -1;
+        recDataBuff = feedback.recBuff + 9;
+
+        //On an error the frames before ErrorFrame are valid, the failed frame
+        //gets the errorcode, and the frames after it are sent again.  An
+        //ErrorFrame outside of the command cannot be matched to a channel, so
+        //then every channel of the command gets the errorcode.
+        numValid = numFrames;
+        if( Errorcode != 0 )
+        {
+            if( firstError == 0 )
+                firstError = Errorcode;
+
+            if( ErrorFrame < numFrames )
+            {
+                numValid = ErrorFrame;
+                if( aErrors != NULL )
+                    aErrors[start + ErrorFrame] = Errorcode;
+                retryStart = start + ErrorFrame + 1;
+                retryEnd = start + numFrames;
+            }
+            else
+            {
+                numValid = 0;
+                for( i = 0; i < numFrames && aErrors != NULL; i++ )
+                    aErrors[start + i] = Errorcode;
+            }
+        }
+        if( numValid > (recChars - 9)/recSize )
+            numValid = (recChars - 9)/recSize;
+
+        for( i = 0; i < numValid; i++ )
+        {
+            bytesV = recDataBuff[i*recSize] + ((uint32)recDataBuff[i*recSize + 1])*256 +
+                     ((uint32)recDataBuff[i*recSize + 2])*65536;
+
+            if( Binary != 0 )
+            {
+                aVoltages[start + i] = (double)bytesV;
+                continue;
+            }
+
+            frameGain = (ioType == 3) ? recDataBuff[i*recSize + 3]/16 : gain;
+
+            //A conversion error does not stop the other channels
+            if( aChannelP[start + i] == 14 )
+            {
+                if( getTempKCalibrated(CalibrationInfo, Resolution, frameGain, 1, bytesV, &aVoltages[start + i]) < 0 )
+                    error = -1;
+            }
+            else if( getAinVoltCalibrated(CalibrationInfo, Resolution, frameGain, 1, bytesV, &aVoltages[start + i]) < 0 )
+                error = -1;
+        }
+    }
+
+    return (error < 0) ? -1 : firstError;
+}
+
+
+long eDIs(HANDLE Handle, long NumChannels, long *aChannels, long *aStates, long *aErrors)
+{
+    uint8 sendDataBuff[8], recDataBuff[3];
+    uint8 Errorcode, ErrorFrame;
+    uint32 mask;
+    int i;
+
+    if( NumChannels < 1 || aChannels == NULL || aStates == NULL )
+    {
+        printf("eDIs error: Invalid channel arrays.\n");
+        return -1;
+    }
+
+    mask = 0;
+    for( i = 0; i < NumChannels; i++ )
+    {
+        if( aChannels[i] < 0 || aChannels[i] > 19 )
+        {
+            printf("eDIs error: Invalid Channel %ld.\n", aChannels[i]);
+            return -1;
+        }
+        mask |= 1 << aChannels[i];
+    }
+
+    /* Setting up Feedback command to set all channels to input and to read
+       them */
+    sendDataBuff[0] = 29;  //IOType is PortDirWrite
+    sendDataBuff[1] = (uint8)(mask & 0xFF);  //Writemask : FIO
+    sendDataBuff[2] = (uint8)((mask >> 8) & 0xFF);  //Writemask : EIO
+    sendDataBuff[3] = (uint8)((mask >> 16) & 0xFF);  //Writemask : CIO
+    sendDataBuff[4] = 0;  //Direction : FIO (input)
+    sendDataBuff[5] = 0;  //Direction : EIO (input)
+    sendDataBuff[6] = 0;  //Direction : CIO (input)
+
+    sendDataBuff[7] = 26;  //IOType is PortStateRead
+
+    if( ehFeedback(Handle, sendDataBuff, 8, &Errorcode, &ErrorFrame, recDataBuff, 3) < 0 )
+        return -1;
+
+    for( i = 0; i < NumChannels; i++ )
+    {
+        if( aErrors != NULL )
+            aErrors[i] = Errorcode;
+        if( Errorcode == 0 )
+            aStates[i] = (recDataBuff[aChannels[i]/8] >> (aChannels[i]%8)) & 1;
+    }
+
+    return (long)Errorcode;
+}
+
+
+long eDOs(HANDLE Handle, long NumChannels, long *aChannels, long *aStates, long *aErrors)
+{
+    uint8 sendDataBuff[14];
+    uint8 Errorcode, ErrorFrame;
+    uint32 mask, state;
+    int i;
+
+    if( NumChannels < 1 || aChannels == NULL || aStates == NULL )
+    {
+        printf("eDOs error: Invalid channel arrays.\n");
+        return -1;
+    }
+
+    mask = 0;
+    state = 0;
+    for( i = 0; i < NumChannels; i++ )
+    {
+        if( aChannels[i] < 0 || aChannels[i] > 19 )
+        {
+            printf("eDOs error: Invalid Channel %ld.\n", aChannels[i]);
+            return -1;
+        }
+        mask |= 1 << aChannels[i];
+        if( aStates[i] > 0 )
+            state |= 1 << aChannels[i];
+        else
+            state &= ~(1 << aChannels[i]);
+    }
+
+    /* Setting up Feedback command to set all channels to output and to set
+       their states */
+    sendDataBuff[0] = 29;  //IOType is PortDirWrite
+    sendDataBuff[1] = (uint8)(mask & 0xFF);  //Writemask : FIO
+    sendDataBuff[2] = (uint8)((mask >> 8) & 0xFF);  //Writemask : EIO
+    sendDataBuff[3] = (uint8)((mask >> 16) & 0xFF);  //Writemask : CIO
+    sendDataBuff[4] = sendDataBuff[1];  //Direction : FIO (output)
+    sendDataBuff[5] = sendDataBuff[2];  //Direction : EIO (output)
+    sendDataBuff[6] = sendDataBuff[3];  //Direction : CIO (output)
+
+    sendDataBuff[7] = 27;  //IOType is PortStateWrite
+    sendDataBuff[8] = sendDataBuff[1];  //Writemask : FIO
+    sendDataBuff[9] = sendDataBuff[2];  //Writemask : EIO
+    sendDataBuff[10] = sendDataBuff[3];  //Writemask : CIO
+    sendDataBuff[11] = (uint8)(state & 0xFF);  //State : FIO
+    sendDataBuff[12] = (uint8)((state >> 8) & 0xFF);  //State : EIO
+    sendDataBuff[13] = (uint8)((state >> 16) & 0xFF);  //State : CIO
+
+    if( ehFeedback(Handle, sendDataBuff, 14, &Errorcode, &ErrorFrame, NULL, 0) < 0 )
+        return -1;
+
+    if( aErrors != NULL )
+    {
+        for( i = 0; i < NumChannels; i++ )
+            aErrors[i] = Errorcode;
+    }
+
+    return (long)Errorcode;
+}
+
+
 long eTCConfig(HANDLE Handle, long *aEnableTimers, long *aEnableCounters, long TCPinOffset, long TimerClockBaseIndex, long TimerClockDivisor, long *aTimerModes, double *aTimerValues, long Reserved1, long Reserved2)
 {
     uint8 sendDataBuff[20];
@@ -1267,3 +1881,326 @@ cleanmem:
 
     return ret;
 }
+
+
+long ehFeedbackPrepare(u6PreparedFeedback *feedback, uint8 *inIOTypesDataBuff, long inIOTypesDataSize, long outDataSize)
+{
+    int sendDWSize, recDWSize, i;
+
+    if( inIOTypesDataSize < 0 || inIOTypesDataSize > U6_FEEDBACK_MAX_COMMAND_DATA )
+    {
+        printf("ehFeedbackPrepare error : invalid IOTypes data size %ld\n", inIOTypesDataSize);
+        return -1;
+    }
+
+    if( outDataSize < 0 || outDataSize > U6_FEEDBACK_MAX_RESPONSE_DATA )
+    {
+        printf("ehFeedbackPrepare error : invalid response data size %ld\n", outDataSize);
+        return -1;
+    }
+
+    if( ((sendDWSize = inIOTypesDataSize + 1)%2) != 0 )
+        sendDWSize++;
+    if( ((recDWSize = outDataSize + 3)%2) != 0 )
+        recDWSize++;
+
+    memset(feedback, 0, sizeof(u6PreparedFeedback));
+    feedback->sendSize = 6 + sendDWSize;
+    feedback->recSize = 6 + recDWSize;
+    feedback->ioTypesSize = inIOTypesDataSize;
+    feedback->dataSize = outDataSize;
+
+    /* Setting up Feedback command */
+    feedback->sendBuff[1] = (uint8)(0xF8);  //Command byte
+    feedback->sendBuff[2] = sendDWSize/2;   //Number of data words
+    feedback->sendBuff[3] = (uint8)(0x00);  //Extended command number
+    feedback->sendBuff[6] = 0;              //Echo
+
+    for( i = 0; i < inIOTypesDataSize; i++ )
+        feedback->sendBuff[i + 7] = inIOTypesDataBuff[i];
+
+    extendedChecksum(feedback->sendBuff, feedback->sendSize);
+    feedback->checksum16 = feedback->sendBuff[4] + feedback->sendBuff[5]*256;
+
+    return 0;
+}
+
+
+long ehFeedbackPatch8(u6PreparedFeedback *feedback, long offset, uint8 value)
+{
+    uint8 *b = feedback->sendBuff;
+
+    if( offset < 0 || offset >= feedback->ioTypesSize )
+    {
+        printf("ehFeedbackPatch8 error : offset %ld is outside the %d IOTypes bytes\n", offset, feedback->ioTypesSize);
+        return -1;
+    }
+
+    //Only the change of the byte is added to checksum16, and checksum8 is
+    //recalculated from bytes 1-5
+    feedback->checksum16 += value - b[offset + 7];
+    b[offset + 7] = value;
+    b[4] = (uint8)(feedback->checksum16 & 0xFF);
+    b[5] = (uint8)((feedback->checksum16 / 256) & 0xFF);
+    b[0] = extendedChecksum8(b);
+
+    return 0;
+}
+
+
+long ehFeedbackPatch16(u6PreparedFeedback *feedback, long offset, uint16 value)
+{
+    uint8 *b = feedback->sendBuff;
+
+    if( offset < 0 || offset + 1 >= feedback->ioTypesSize )
+    {
+        printf("ehFeedbackPatch16 error : offsets %ld and %ld are not both in the %d IOTypes bytes\n", offset, offset + 1, feedback->ioTypesSize);
+        return -1;
+    }
+
+    feedback->checksum16 += (value & 0xFF) - b[offset + 7];
+    feedback->checksum16 += (value / 256) - b[offset + 8];
+    b[offset + 7] = (uint8)(value & 0xFF);
+    b[offset + 8] = (uint8)((value / 256) & 0xFF);
+    b[4] = (uint8)(feedback->checksum16 & 0xFF);
+    b[5] = (uint8)((feedback->checksum16 / 256) & 0xFF);
+    b[0] = extendedChecksum8(b);
+
+    return 0;
+}
+
+
+//Writes a prepared Feedback command without reading its response.  Used by
+//ehFeedbackExecute and eAINs.
+static long feedbackWrite(HANDLE hDevice, u6PreparedFeedback *feedback)
+{
+    int sendChars;
+
+    //Sending command to U6
+    if( (sendChars = LJUSB_Write(hDevice, feedback->sendBuff, feedback->sendSize)) < feedback->sendSize )
+    {
+        if( sendChars == 0 )
+            printf("ehFeedbackExecute error : write failed\n");
+        else
+            printf("ehFeedbackExecute error : did not write all of the buffer\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+
+//Reads and checks the response of a prepared Feedback command into its
+//recBuff.  Returns the number of bytes read, or -1 on error.  Used by
+//ehFeedbackExecute and eAINs.
+static long feedbackRead(HANDLE hDevice, u6PreparedFeedback *feedback, uint8 *outErrorcode, uint8 *outErrorFrame)
+{
+    uint8 *recBuff = feedback->recBuff;
+    uint16 checksumTotal;
+    int recChars;
+
+    //Reading response from U6.  A response with a non-zero errorcode can be
+    //shorter than expected.
+    recChars = LJUSB_Read(hDevice, recBuff, feedback->recSize);
+    if( recChars < 8 )
+    {
+        if( recChars == 0 )
+            printf("ehFeedbackExecute error : read failed\n");
+        else
+            printf("ehFeedbackExecute error : response buffer is too small\n");
+        return -1;
+    }
+
+    checksumTotal = extendedChecksum16(recBuff, recChars);
+    if( (uint8)((checksumTotal / 256) & 0xFF) != recBuff[5] ||
+        (uint8)(checksumTotal & 0xFF) != recBuff[4] ||
+        extendedChecksum8(recBuff) != recBuff[0] )
+    {
+        printf("ehFeedbackExecute error : read buffer has bad checksum\n");
+        return -1;
+    }
+
+    if( recBuff[1] != (uint8)(0xF8) || recBuff[3] != (uint8)(0x00) )
+    {
+        printf("ehFeedbackExecute error : read buffer has wrong command bytes\n");
+        return -1;
+    }
+
+    *outErrorcode = recBuff[6];
+    *outErrorFrame = recBuff[7];
+
+    if( recChars < feedback->recSize && recBuff[6] == 0 )
+    {
+        printf("ehFeedbackExecute error : did not read all of the expected buffer (received %d, expected %d)\n", recChars, feedback->recSize);
+        return -1;
+    }
+
+    return recChars;
+}
+
+
+long ehFeedbackExecute(HANDLE hDevice, u6PreparedFeedback *feedback, uint8 *outErrorcode, uint8 *outErrorFrame, uint8 *outDataBuff)
+{
+    long recChars;
+    int i;
+
+    if( feedbackWrite(hDevice, feedback) < 0 )
+        return -1;
+
+    if( (recChars = feedbackRead(hDevice, feedback, outErrorcode, outErrorFrame)) < 0 )
+        return -1;
+
+    if( outDataBuff != NULL )
+    {
+        for( i = 0; i + 9 < recChars && i < feedback->dataSize; i++ )
+            outDataBuff[i] = feedback->recBuff[i + 9];
+    }
+
+    return 0;
+}
+
+
+long ehStreamConfig(HANDLE hDevice, uint8 inNumChannels, uint8 inResolutionIndex, uint8 inSamplesPerPacket, uint8 inSettlingFactor, uint8 inScanConfig, uint16 inScanInterval, uint8 *inChannelNumbers, uint8 *inChannelOptions)
+{
+    uint8 sendBuff[64], recBuff[8];
+    uint16 checksumTotal;
+    int sendChars, recChars, sendSize, i;
+
+    if( inNumChannels < 1 || inNumChannels > 25 )
+    {
+        printf("ehStreamConfig error: Invalid number of channels\n");
+        return -1;
+    }
+
+    sendSize = 14 + inNumChannels*2;
+
+    sendBuff[1] = (uint8)(0xF8);          //Command byte
+    sendBuff[2] = 4 + inNumChannels;      //Number of data words = NumChannels + 4
+    sendBuff[3] = (uint8)(0x11);          //Extended command number
+    sendBuff[6] = inNumChannels;          //NumChannels
+    sendBuff[7] = inResolutionIndex;      //ResolutionIndex
+    sendBuff[8] = inSamplesPerPacket;     //SamplesPerPacket
+    sendBuff[9] = 0;                      //Reserved
+    sendBuff[10] = inSettlingFactor;      //SettlingFactor
+    sendBuff[11] = inScanConfig;          //ScanConfig
+    sendBuff[12] = (uint8)(inScanInterval & 0x00FF);  //ScanInterval (low byte)
+    sendBuff[13] = (uint8)(inScanInterval / 256);     //ScanInterval (high byte)
+
+    for( i = 0; i < inNumChannels; i++ )
+    {
+        sendBuff[14 + i*2] = inChannelNumbers[i];  //ChannelNumber (Positive)
+        sendBuff[15 + i*2] = inChannelOptions[i];  //ChannelOptions
+    }
+    extendedChecksum(sendBuff, sendSize);
+
+    //Sending command to U6
+    if( (sendChars = LJUSB_Write(hDevice, sendBuff, sendSize)) < sendSize )
+    {
+        if( sendChars == 0 )
+            printf("ehStreamConfig error : write failed\n");
+        else
+            printf("ehStreamConfig error : did not write all of the buffer\n");
+        return -1;
+    }
+
+    //Reading response from U6
+    if( (recChars = LJUSB_Read(hDevice, recBuff, 8)) < 8 )
+    {
+        if( recChars == 0 )
+            printf("ehStreamConfig error : read failed\n");
+        else
+            printf("ehStreamConfig error : did not read all of the buffer\n");
+        return -1;
+    }
+
+    checksumTotal = extendedChecksum16(recBuff, 8);
+    if( (uint8)((checksumTotal / 256 ) & 0xff) != recBuff[5] || (uint8)(checksumTotal & 0xff) != recBuff[4] )
+    {
+        printf("ehStreamConfig error : read buffer has bad checksum16\n");
+        return -1;
+    }
+
+    if( extendedChecksum8(recBuff) != recBuff[0] )
+    {
+        printf("ehStreamConfig error : read buffer has bad checksum8\n");
+        return -1;
+    }
+
+    if( recBuff[1] != (uint8)(0xF8) || recBuff[2] != (uint8)(0x01) || recBuff[3] != (uint8)(0x11) || recBuff[7] != (uint8)(0x00) )
+    {
+        printf("ehStreamConfig error : read buffer has wrong command bytes\n");
+        return -1;
+    }
+
+    if( recBuff[6] != 0 )
+    {
+        printf("ehStreamConfig error : read buffer received errorcode %d\n", recBuff[6]);
+        return recBuff[6];
+    }
+
+    return 0;
+}
+
+
+//Sends a StreamStart (0xA8) or StreamStop (0xB0) command and checks the
+//response
+static long streamStartStop(HANDLE hDevice, uint8 command, const char *name)
+{
+    uint8 sendBuff[2], recBuff[4];
+    int sendChars, recChars;
+
+    sendBuff[0] = command;  //Checksum8
+    sendBuff[1] = command;  //Command byte
+
+    //Sending command to U6
+    if( (sendChars = LJUSB_Write(hDevice, sendBuff, 2)) < 2 )
+    {
+        if( sendChars == 0 )
+            printf("%s error : write failed\n", name);
+        else
+            printf("%s error : did not write all of the buffer\n", name);
+        return -1;
+    }
+
+    //Reading response from U6
+    if( (recChars = LJUSB_Read(hDevice, recBuff, 4)) < 4 )
+    {
+        if( recChars == 0 )
+            printf("%s error : read failed\n", name);
+        else
+            printf("%s error : did not read all of the buffer\n", name);
+        return -1;
+    }
+
+    if( normalChecksum8(recBuff, 4) != recBuff[0] )
+    {
+        printf("%s error : read buffer has bad checksum8\n", name);
+        return -1;
+    }
+
+    if( recBuff[1] != (uint8)(command + 1) || recBuff[3] != (uint8)(0x00) )
+    {
+        printf("%s error : read buffer has wrong command bytes\n", name);
+        return -1;
+    }
+
+    return recBuff[2];
+}
+
+
+long ehStreamStart(HANDLE hDevice)
+{
+    long error;
+
+    error = streamStartStop(hDevice, 0xA8, "ehStreamStart");
+    if( error > 0 )
+        printf("ehStreamStart error : read buffer received errorcode %ld\n", error);
+    return error;
+}
+
+
+long ehStreamStop(HANDLE hDevice)
+{
+    //Errorcode 52 (stream not running) is not printed
+    return streamStartStop(hDevice, 0xB0, "ehStreamStop");
+}
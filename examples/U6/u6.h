@@ -10,6 +10,7 @@
 #include <math.h>
 #include <stdlib.h>
 #include "labjackusb.h"
+#include "labjackstream.h"
 
 
 #ifdef __cplusplus
@@ -90,6 +91,20 @@ struct U6_TDAC_CALIBRATION_INFORMATION{
 
 typedef struct U6_TDAC_CALIBRATION_INFORMATION u6TdacCalibrationInfo;
 
+//Structure for a prepared Feedback command (see ehFeedbackPrepare).  The
+//buffers hold the full command and response packets.
+struct U6_PREPARED_FEEDBACK {
+    uint8 sendBuff[64];
+    uint8 recBuff[64];
+    int sendSize;        //Number of command bytes written
+    int recSize;         //Number of response bytes expected
+    int ioTypesSize;     //Number of IOType command bytes
+    int dataSize;        //Number of IOType response bytes
+    uint16 checksum16;   //Sum of command bytes 6 and up
+};
+
+typedef struct U6_PREPARED_FEEDBACK u6PreparedFeedback;
+
 
 /* Functions */
 
@@ -140,6 +155,26 @@ long getCalibrationInfo( HANDLE hDevice,
 //hDevice = handle to a U6 device
 //caliInfo = structure where calibrarion information will be stored
 
+long getCalibrationInfoCached( HANDLE hDevice,
+                               u6CalibrationInfo *caliInfo,
+                               long CreateCacheDir);
+//Same as getCalibrationInfo, but also keeps a copy of the calibration memory
+//in a cache file per serial number.  When the file exists, only the first
+//memory block is read from the device:  if it matches the file, the cached
+//memory is used, which saves the ReadMem round trips of the other blocks.
+//Otherwise all of the blocks are read and the file is rewritten.  A
+//recalibration that leaves the first block unchanged is not seen; use
+//getCalibrationInfo after recalibrating only other ranges.  The file holds a
+//32-bit hash of the memory, so a damaged file is not used.  The cache
+//directory is $LJ_CALIBRATION_CACHE_DIR, or $XDG_CACHE_HOME/labjack or
+//$HOME/.cache/labjack if it is not set.  Set LJ_CALIBRATION_CACHE_DIR to an
+//empty string to disable the cache.  Returns -1 on error, 0 on success.
+//hDevice = handle to a U6 device
+//caliInfo = structure where calibrarion information will be stored
+//CreateCacheDir = If this is nonzero (True), the default cache directory is
+//                 created if it does not exist.  Otherwise the cache is only
+//                 kept if the directory exists.
+
 long getTdacCalibrationInfo( HANDLE hDevice,
                              u6TdacCalibrationInfo *caliInfo,
                              uint8 DIOAPinNum);
@@ -150,6 +185,17 @@ long getTdacCalibrationInfo( HANDLE hDevice,
 //DIOAPinNum = The U6 digital IO line where the LJTDAC DIOA pin is connected.
 //             The DIOB pin is assumed to be the next digital IO line.
 
+long getTdacCalibrationInfoCached( HANDLE hDevice,
+                                   u6TdacCalibrationInfo *caliInfo,
+                                   uint8 DIOAPinNum);
+//Same as getTdacCalibrationInfo, but the calibration constants of each handle
+//and DIOAPinNum are read from the LJTDAC once and kept until
+//closeUSBConnection is called.  Returns -1 on error, 0 on success.
+//hDevice = handle to a U6 device
+//caliInfo = structure where LJTDAC calibration information will be stored
+//DIOAPinNum = The U6 digital IO line where the LJTDAC DIOA pin is connected.
+//             The DIOB pin is assumed to be the next digital IO line.
+
 double FPuint8ArrayToFPDouble( uint8 *buffer,
                                int startIndex);
 //Converts a fixed point byte array (starting a startIndex) to a floating point
@@ -185,6 +231,20 @@ long getAinVoltCalibrated( u6CalibrationInfo *caliInfo,
 //            value.
 //analogVolt = The converted analog voltage.
 
+long getStreamCalibration( u6CalibrationInfo *caliInfo,
+                           int resolutionIndex,
+                           int gainIndex,
+                           LJUSB_StreamChannelCal *streamCal);
+//Gets the binary to volts conversion of a stream channel for the stream
+//decoder (LJUSB_StreamDecoderSetCal).  The conversion is the same as
+//getAinVoltCalibrated with 16-bit values.  Call getCalibrationInfo first to
+//set up caliInfo.  Returns -1 on error, 0 on success.
+//caliInfo = structure where calibrarion information is stored
+//resolutionIndex = The ResolutionIndex of the StreamConfig.
+//gainIndex = The gain index of the stream channel.
+//            0 = +-10V, 1 = +-1V, 2 = +-100mV, 3 = +-10mV
+//streamCal = The conversion of the stream channel.
+
 long getDacBinVoltCalibrated8Bit( u6CalibrationInfo *caliInfo,
                                   int dacNumber,
                                   double analogVolt,
@@ -308,7 +368,9 @@ long I2C( HANDLE hDevice,
           uint8 *I2CBytesResponse);
 //This function will perform the I2C low-level function call.  Please refer to
 //section 5.3.19 of the U6 User's Guide for parameter documentation.  Returns
-//-1 on error, 0 on success.
+//-1 on error, 0 on success.  The command is sent with the I2C engine of
+//labjacki2c.h, so no memory is allocated; up to 50 bytes can be sent and 52
+//received.
 //hDevice = handle to a U6 device
 //I2COptions = byte 6 of the command
 //SpeedAdjust = byte 7 of the command
@@ -376,6 +438,25 @@ long eDAC( HANDLE Handle,
 //         binary.
 //Reserved (1&2) = Pass 0.
 
+long eTDAC( HANDLE Handle,
+            u6TdacCalibrationInfo *TdacCalibrationInfo,
+            long DIOAPinNum,
+            double VoltageA,
+            double VoltageB);
+//An "easy" function that sets both outputs of an LJTick-DAC with one I2C
+//command, instead of one I2C command per output.  The command is sent with the
+//I2C engine of labjacki2c.h, so no memory is allocated.  Returns 0 for no
+//error, or -1 or >0 value (low-level errorcode) on error.  It returns -1 if the
+//LJTDAC does not acknowledge the command.
+//Handle = Handle to a U6 device.
+//TdacCalibrationInfo = Structure where LJTDAC calibration information is
+//                      stored.  Pass NULL to use the constants cached by
+//                      getTdacCalibrationInfoCached.
+//DIOAPinNum = The digital IO line where the LJTDAC DIOA pin is connected.
+//             The DIOB pin is assumed to be the next digital IO line.
+//VoltageA = The voltage to set DACA to.
+//VoltageB = The voltage to set DACB to.
+
 long eDI( HANDLE Handle,
           long Channel,
           long *State);
@@ -397,6 +478,73 @@ long eDO( HANDLE Handle,
 //State = The state to write to the digital output.  0=False=Low and
 //        1=True=High.
 
+long eAINs( HANDLE Handle,
+            u6CalibrationInfo *CalibrationInfo,
+            long NumChannels,
+            long *aChannelP,
+            long *aChannelN,
+            double *aVoltages,
+            long Range,
+            long Resolution,
+            long Settling,
+            long Binary,
+            long *aErrors,
+            long Reserved1,
+            long Reserved2);
+//An "easy" function that returns readings from several analog inputs, like
+//calling eAIN for each channel.  Up to 14 channels (11 with LJ_rgAUTO) are read
+//with each Feedback call, so the minimum number of Feedback calls are made, and
+//each one is written before the response of the previous one is read.  Returns 0 for no error, -1 on error, or the low-level
+//errorcode (>0 value) of the first channel that failed.
+//Call getCalibrationInfo first to set up CalibrationInfo.
+//Handle = Handle to a U6 device.
+//CalibrationInfo = Structure where calibration information is stored.
+//NumChannels = The number of channels to read.
+//aChannelP = An array of the positive AIN channels to acquire.
+//aChannelN = An array of the negative AIN channels to acquire (see eAIN).
+//aVoltages = Returns the analog input readings.
+//Range = Pass a range constant.  It applies to all channels.
+//Resolution = Pass a resolution index.
+//Settling = Pass a settling factor.
+//Binary = If this is nonzero (True), aVoltages will return the raw binary
+//         values.
+//aErrors = Returns the low-level errorcode of each channel, 0 if it was read.
+//          The aVoltages element of a channel with an error is not set.  Pass
+//          NULL if not needed.
+//Reserved (1&2) = Pass 0.
+
+long eDIs( HANDLE Handle,
+           long NumChannels,
+           long *aChannels,
+           long *aStates,
+           long *aErrors);
+//An "easy" function that reads the states of several digital inputs with one
+//Feedback call (PortDirWrite and PortStateRead).  Returns 0 for no error, or
+//-1 or >0 value (low-level errorcode) on error.
+//Handle = Handle to a U6 device.
+//NumChannels = The number of channels to read.
+//aChannels = An array of the channels to read.  0-19 corresponds to
+//            FIO0-CIO3.
+//aStates = Returns the states of the digital inputs.
+//aErrors = Returns the low-level errorcode of each channel.  Pass NULL if not
+//          needed.
+
+long eDOs( HANDLE Handle,
+           long NumChannels,
+           long *aChannels,
+           long *aStates,
+           long *aErrors);
+//An "easy" function that writes the states of several digital outputs with
+//one Feedback call (PortDirWrite and PortStateWrite).  Returns 0 for no error,
+//or -1 or >0 value (low-level errorcode) on error.
+//Handle = Handle to a U6 device.
+//NumChannels = The number of channels to write.
+//aChannels = An array of the channels to write.  0-19 corresponds to
+//            FIO0-CIO3.
+//aStates = An array of the states to write.  0=False=Low and 1=True=High.
+//aErrors = Returns the low-level errorcode of each channel.  Pass NULL if not
+//          needed.
+
 long eTCConfig( HANDLE Handle,
                 long *aEnableTimers,
                 long *aEnableCounters,
@@ -519,6 +667,93 @@ long ehFeedback( HANDLE hDevice,
 //bytes) as its parameter and performs a Feedback call with the U6.  Returns -1
 //or errorcode (>1 value) on error, 0 on success.
 
+long ehFeedbackPrepare( u6PreparedFeedback *feedback,
+                        uint8 *inIOTypesDataBuff,
+                        long inIOTypesDataSize,
+                        long outDataSize);
+//Builds a Feedback command packet, with its data word count, echo and
+//checksums, and the expected response size once, so that a Feedback command
+//with the same IOTypes can be sent many times with ehFeedbackExecute without
+//rebuilding it.  Values in the command, such as DAC values, are changed with
+//ehFeedbackPatch8 and ehFeedbackPatch16.  Returns 0 on success, or -1 if the
+//command or response does not fit in a packet.
+//feedback = The prepared Feedback command.
+//inIOTypesDataBuff = The IOTypes and their data, like the ehFeedback
+//                    parameter.
+//inIOTypesDataSize = The number of IOTypes bytes (up to 57).
+//outDataSize = The number of IOTypes response bytes (up to 55).
+
+long ehFeedbackPatch8( u6PreparedFeedback *feedback,
+                       long offset,
+                       uint8 value);
+//Changes one byte of the IOTypes data of a prepared Feedback command and
+//updates the checksums with the difference, without summing the packet again.
+//Returns 0 on success, or -1 if offset is not within the IOTypes data (the
+//command is then unchanged).
+//feedback = The prepared Feedback command.
+//offset = The index of the byte in inIOTypesDataBuff passed to
+//         ehFeedbackPrepare.
+//value = The new value.
+
+long ehFeedbackPatch16( u6PreparedFeedback *feedback,
+                        long offset,
+                        uint16 value);
+//Same as ehFeedbackPatch8, but changes two bytes (LSB first), for example the
+//value of a DAC0 (16-bit) IOType.  Returns -1 if either byte is not within the
+//IOTypes data.
+//feedback = The prepared Feedback command.
+//offset = The index of the LSB in inIOTypesDataBuff passed to
+//         ehFeedbackPrepare.
+//value = The new value.
+
+long ehFeedbackExecute( HANDLE hDevice,
+                        u6PreparedFeedback *feedback,
+                        uint8 *outErrorcode,
+                        uint8 *outErrorFrame,
+                        uint8 *outDataBuff);
+//Sends a prepared Feedback command and reads its response.  No memory is
+//allocated.  Returns -1 on error, 0 on success.
+//hDevice = Handle to a U6 device.
+//feedback = The prepared Feedback command.
+//outErrorcode = Returns the Feedback errorcode.
+//outErrorFrame = Returns the Feedback error frame.
+//outDataBuff = Returns the IOTypes response bytes (outDataSize bytes).  Pass
+//              NULL to not copy them; they are also at feedback->recBuff + 9.
+
+
+long ehStreamConfig( HANDLE hDevice,
+                     uint8 inNumChannels,
+                     uint8 inResolutionIndex,
+                     uint8 inSamplesPerPacket,
+                     uint8 inSettlingFactor,
+                     uint8 inScanConfig,
+                     uint16 inScanInterval,
+                     uint8 *inChannelNumbers,
+                     uint8 *inChannelOptions);
+//Performs a StreamConfig call with the U6.  The parameters are the StreamConfig
+//low-level command bytes.  LJUSB_StreamPlanCompute (labjackstream.h) can pick
+//inSamplesPerPacket, inScanConfig and inScanInterval.  Returns -1 or errorcode
+//(>1 value) on error, 0 on success.
+//hDevice = Handle to a U6 device.
+//inNumChannels = The number of channels in each scan (1-25).
+//inResolutionIndex = The ResolutionIndex of the samples.
+//inSamplesPerPacket = The number of samples in each StreamData response
+//                     (1-25).
+//inSettlingFactor = The SettlingFactor.
+//inScanConfig = The ScanConfig byte (clock frequency and divide by 256 bits).
+//inScanInterval = The ScanInterval, in clock ticks.
+//inChannelNumbers = An array of the positive channel of each channel.
+//inChannelOptions = An array of the ChannelOptions (gain and differential
+//                   bits) of each channel.
+
+long ehStreamStart( HANDLE hDevice);
+//Performs a StreamStart call with the U6.  Returns -1 or errorcode (>1 value)
+//on error, 0 on success.
+
+long ehStreamStop( HANDLE hDevice);
+//Performs a StreamStop call with the U6.  Returns -1 or errorcode (>1 value)
+//on error, 0 on success.  Errorcode 52 means the stream was not running.
+
 
 /* Easy function constants */
 
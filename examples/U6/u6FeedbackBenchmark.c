@@ -0,0 +1,175 @@
+//Author: LabJack
+//October 18, 2026
+//Measures the command-response times of the U6 Feedback command for the
+//IOType mixes of Section 3.1 of the U6 User's Guide:  no I/O, the digital
+//I/O states, both DACs, one AIN at each resolution index and several AINs
+//in one packet.  Each test sends a prepared Feedback command (see
+//ehFeedbackPrepare) many times and prints the mean, median, 99th and 99.9th
+//percentile and maximum round trip in microseconds, so the times of a host
+//can be compared with the Windows times of the User's Guide and with earlier
+//runs.  The DAC test sets DAC0 and DAC1 to 0 V, and the digital write test
+//writes the states the lines already have.  Pass the number of commands per
+//test as an argument (default 2000); a test stops after 10 s if it has sent
+//at least 100 commands.  Build with "make SIM=1" to run against
+//a simulated U6, and set LJSIM_LATENCY_US to add a USB round trip time.
+
+#include <string.h>
+#include <sys/utsname.h>
+#include "u6.h"
+
+#define MAX_TESTS         24
+#define WARMUP_COMMANDS   20
+#define MAX_TEST_SECONDS  10  //A slow test stops early, after at least 100 commands
+
+typedef struct
+{
+    char name[40];
+    uint8 ioTypes[64];
+    long ioTypesSize;
+    long dataSize;
+} FeedbackTest;
+
+static FeedbackTest tests[MAX_TESTS];
+static int numTests = 0;
+
+static FeedbackTest *addTest(const char *name, long dataSize)
+{
+    FeedbackTest *test = &tests[numTests++];
+
+    snprintf(test->name, sizeof(test->name), "%s", name);
+    test->ioTypesSize = 0;
+    test->dataSize = dataSize;
+    return test;
+}
+
+//Adds AIN24 IOTypes for AIN0 to AIN(numChannels-1)
+static void addAin(FeedbackTest *test, int numChannels, int resolutionIndex)
+{
+    int i;
+
+    for( i = 0; i < numChannels; i++ )
+    {
+        test->ioTypes[test->ioTypesSize++] = 2;                //IOType is AIN24
+        test->ioTypes[test->ioTypesSize++] = i;                //Positive channel
+        test->ioTypes[test->ioTypesSize++] = resolutionIndex;  //Res Index (0-3), Gain Index (4-7) is x1
+        test->ioTypes[test->ioTypesSize++] = 0;                //Settling factor (0-2) is auto, single-ended
+    }
+}
+
+//Runs a test and prints its times.  Returns -1 on error.
+static int runTest(HANDLE hDevice, FeedbackTest *test, int numCommands)
+{
+    u6PreparedFeedback feedback;
+    LJUSB_StreamAgeStats times;
+    unsigned long long startNs, testStartNs = 0;
+    uint8 errorcode, errorFrame, firstErrorcode = 0;
+    int i;
+
+    if( ehFeedbackPrepare(&feedback, test->ioTypes, test->ioTypesSize, test->dataSize) < 0 )
+        return -1;
+
+    LJUSB_StreamAgeStatsReset(&times);
+    for( i = -WARMUP_COMMANDS; i < numCommands; i++ )
+    {
+        startNs = LJUSB_GetTimestampNs();
+        if( ehFeedbackExecute(hDevice, &feedback, &errorcode, &errorFrame, NULL) < 0 )
+            return -1;
+        if( i >= 0 )
+            LJUSB_StreamAgeStatsAdd(&times, (LJUSB_GetTimestampNs() - startNs)/1.0e3);
+        else
+            testStartNs = LJUSB_GetTimestampNs();
+        if( errorcode != 0 && firstErrorcode == 0 )
+            firstErrorcode = errorcode;
+        if( times.count >= 100 && LJUSB_GetTimestampNs() - testStartNs > MAX_TEST_SECONDS*1000000000ULL )
+            break;
+    }
+
+    printf("%-32s %6llu %8.1f %8.1f %8.1f %8.1f %8.1f", test->name, times.count, times.sumUs/times.count,
+           LJUSB_StreamAgeStatsPercentile(&times, 50), LJUSB_StreamAgeStatsPercentile(&times, 99),
+           LJUSB_StreamAgeStatsPercentile(&times, 99.9), times.maxUs);
+    if( firstErrorcode != 0 )
+        printf("  (errorcode %d)", firstErrorcode);
+    printf("\n");
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    HANDLE hDevice;
+    u6CalibrationInfo caliInfo;
+    FeedbackTest *test;
+    struct utsname host;
+    uint8 readState[1], state[3], errorcode, errorFrame;
+    uint16 bits16;
+    char name[40];
+    int numCommands = 2000, res, i, ret = 1;
+
+    if( argc > 1 )
+        numCommands = atoi(argv[1]);
+    if( numCommands < 1 )
+        numCommands = 1;
+
+    //Open first found U6 over USB
+    hDevice = openUSBConnection(-1);
+    if( hDevice == NULL )
+        return 1;
+
+    if( getCalibrationInfo(hDevice, &caliInfo) < 0 )
+        goto close;
+
+    //The digital write test writes the current states
+    readState[0] = 26;  //IOType is PortStateRead
+    if( ehFeedback(hDevice, readState, 1, &errorcode, &errorFrame, state, 3) != 0 )
+        goto close;
+
+    addTest("no I/O", 0);
+
+    test = addTest("read DIO states", 3);
+    test->ioTypes[test->ioTypesSize++] = 26;  //IOType is PortStateRead
+
+    test = addTest("write DIO states", 0);
+    test->ioTypes[test->ioTypesSize++] = 27;  //IOType is PortStateWrite
+    test->ioTypes[test->ioTypesSize++] = 255; //FIO WriteMask
+    test->ioTypes[test->ioTypesSize++] = 255; //EIO WriteMask
+    test->ioTypes[test->ioTypesSize++] = 15;  //CIO WriteMask
+    for( i = 0; i < 3; i++ )
+        test->ioTypes[test->ioTypesSize++] = state[i];
+
+    test = addTest("write DAC0 and DAC1", 0);
+    for( i = 0; i < 2; i++ )
+    {
+        if( getDacBinVoltCalibrated16Bit(&caliInfo, i, 0.0, &bits16) < 0 )
+            goto close;
+        test->ioTypes[test->ioTypesSize++] = 38 + i;  //IOType is DAC0 or DAC1 (16-bit)
+        test->ioTypes[test->ioTypesSize++] = (uint8)(bits16 & 255);
+        test->ioTypes[test->ioTypesSize++] = (uint8)(bits16/256);
+    }
+
+    for( res = 1; res <= 12; res++ )
+    {
+        snprintf(name, sizeof(name), "1 AIN, resolution %d%s", res, (res > 8) ? " (U6-Pro)" : "");
+        addAin(addTest(name, 3), 1, res);
+    }
+    addAin(addTest("4 AIN, resolution 1", 4*3), 4, 1);
+    addAin(addTest("14 AIN, resolution 1", 14*3), 14, 1);
+
+    test = addTest("14 AIN and DIO states", 14*3 + 3);
+    addAin(test, 14, 1);
+    test->ioTypes[test->ioTypesSize++] = 26;  //IOType is PortStateRead
+
+    uname(&host);
+    printf("U6 Feedback round trip times in us, %d commands per test, %s %s %s\n", numCommands, host.sysname,
+           host.release, host.machine);
+    printf("%-32s %6s %8s %8s %8s %8s %8s\n", "test", "n", "mean", "p50", "p99", "p99.9", "max");
+    for( i = 0; i < numTests; i++ )
+    {
+        if( runTest(hDevice, &tests[i], numCommands) < 0 )
+            goto close;
+        fflush(stdout);
+    }
+    ret = 0;
+
+close:
+    closeUSBConnection(hDevice);
+    return ret;
+}
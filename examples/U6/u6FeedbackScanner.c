@@ -0,0 +1,192 @@
+//Author: LabJack
+//October 18, 2026
+//Reads AIN0 to AIN3 of a U6 with a Feedback command 1000 times a second, and
+//compares how late each command starts when the loop is timed by the
+//application with usleep and when it runs on the Feedback scanner of
+//labjackscanner.h, which sleeps to absolute deadlines on its own thread,
+//with and without a busy-wait before each deadline.  For each run the start
+//lateness and the round trip time of the commands are printed as
+//percentiles.  Pass the number of seconds of each run (default 2) and a
+//SCHED_FIFO priority for the scanner thread (default 0, normal scheduling)
+//as arguments.  Build with "make SIM=1" to run against a simulated U6, and
+//set LJSIM_LATENCY_US to add a USB round trip time.
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include "u6.h"
+#include "labjackscanner.h"
+
+#define NUM_CHANNELS      4
+#define RESOLUTION_INDEX  1
+#define GAIN_INDEX        0
+#define PERIOD_US         1000.0
+#define SPIN_US           100.0
+
+typedef struct
+{
+    u6CalibrationInfo *caliInfo;
+    unsigned long long responses;
+    double volts[NUM_CHANNELS];
+} ScanResults;
+
+static double getSeconds()
+{
+    return LJUSB_GetTimestampNs()/1.0e9;
+}
+
+static void printStats(const char *name, const LJUSB_StreamAgeStats *late, const LJUSB_StreamAgeStats *roundTrip,
+                       unsigned long long missed)
+{
+    printf("%-26s late us: p50 %7.1f  p99 %7.1f  p99.9 %7.1f  max %7.1f | round trip us: p50 %6.1f  p99 %6.1f | %llu missed\n",
+           name, LJUSB_StreamAgeStatsPercentile(late, 50), LJUSB_StreamAgeStatsPercentile(late, 99),
+           LJUSB_StreamAgeStatsPercentile(late, 99.9), late->maxUs, LJUSB_StreamAgeStatsPercentile(roundTrip, 50),
+           LJUSB_StreamAgeStatsPercentile(roundTrip, 99), missed);
+}
+
+//Converts the AIN24 readings of a Feedback response
+static void convertResponse(u6CalibrationInfo *caliInfo, const uint8 *recBuff, double *volts)
+{
+    uint32 bytesV;
+    int i;
+
+    for( i = 0; i < NUM_CHANNELS; i++ )
+    {
+        bytesV = recBuff[9 + i*3] + ((uint32)recBuff[10 + i*3])*256 + ((uint32)recBuff[11 + i*3])*65536;
+        getAinVoltCalibrated(caliInfo, RESOLUTION_INDEX, GAIN_INDEX, 1, bytesV, &volts[i]);
+    }
+}
+
+static void scanCallback(const BYTE *pResponse, unsigned long responseSize, unsigned long long cycle,
+                         unsigned long long timestampNs, void *userData)
+{
+    ScanResults *results = (ScanResults *)userData;
+
+    if( pResponse[6] == 0 )
+    {
+        convertResponse(results->caliInfo, pResponse, results->volts);
+        results->responses++;
+    }
+}
+
+//The usual application loop:  a usleep to the next deadline, then the
+//command.  Returns -1 on error.
+static int usleepLoop(HANDLE hDevice, u6PreparedFeedback *feedback, u6CalibrationInfo *caliInfo, double seconds)
+{
+    LJUSB_StreamAgeStats late, roundTrip;
+    unsigned long long deadline, now, t0, cycles, i, missed = 0;
+    double volts[NUM_CHANNELS];
+    uint8 errorcode, errorFrame;
+
+    LJUSB_StreamAgeStatsReset(&late);
+    LJUSB_StreamAgeStatsReset(&roundTrip);
+    cycles = (unsigned long long)(seconds*1.0e6/PERIOD_US);
+    deadline = LJUSB_GetTimestampNs();
+    for( i = 0; i < cycles; i++ )
+    {
+        //Deadlines that passed are skipped, like the scanner does
+        deadline += (unsigned long long)(PERIOD_US*1000);
+        now = LJUSB_GetTimestampNs();
+        while( now > deadline )
+        {
+            deadline += (unsigned long long)(PERIOD_US*1000);
+            missed++;
+        }
+        usleep((useconds_t)((deadline - now)/1000));
+
+        t0 = LJUSB_GetTimestampNs();
+        LJUSB_StreamAgeStatsAdd(&late, (t0 > deadline) ? (t0 - deadline)/1.0e3 : 0);
+        if( ehFeedbackExecute(hDevice, feedback, &errorcode, &errorFrame, NULL) < 0 )
+            return -1;
+        LJUSB_StreamAgeStatsAdd(&roundTrip, (LJUSB_GetTimestampNs() - t0)/1.0e3);
+        if( errorcode == 0 )
+            convertResponse(caliInfo, feedback->recBuff, volts);
+    }
+
+    printStats("usleep loop", &late, &roundTrip, missed);
+    return 0;
+}
+
+//Runs the Feedback scanner.  Returns -1 on error.
+static int scannerRun(const char *name, HANDLE hDevice, u6PreparedFeedback *feedback, u6CalibrationInfo *caliInfo,
+                      double seconds, double spinUs, int priority)
+{
+    LJUSB_FeedbackScanner *scanner;
+    LJUSB_FeedbackScannerStats stats;
+    ScanResults results;
+    double start;
+    int i;
+
+    memset(&results, 0, sizeof(results));
+    results.caliInfo = caliInfo;
+    scanner = LJUSB_FeedbackScannerStart(hDevice, feedback->sendBuff, feedback->sendSize, feedback->recSize, PERIOD_US,
+                                         spinUs, priority, scanCallback, &results);
+    if( scanner == NULL )
+    {
+        printf("LJUSB_FeedbackScannerStart error : %s\n", strerror(errno));
+        return -1;
+    }
+
+    start = getSeconds();
+    while( getSeconds() - start < seconds )
+        usleep(100000);
+    LJUSB_FeedbackScannerStop(scanner, &stats);
+
+    printStats(name, &stats.startJitter, &stats.roundTrip, stats.missed);
+    if( stats.errors > 0 )
+        printf("%llu cycles failed, last error : %s\n", stats.errors, strerror(stats.error));
+    if( priority > 0 && !stats.realtime )
+        printf("  (SCHED_FIFO priority %d could not be set, ran with normal scheduling)\n", priority);
+    if( results.responses > 0 )
+    {
+        printf("  %llu responses, last:", results.responses);
+        for( i = 0; i < NUM_CHANNELS; i++ )
+            printf(" AIN%d %.4f V", i, results.volts[i]);
+        printf("\n");
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    HANDLE hDevice;
+    u6CalibrationInfo caliInfo;
+    u6PreparedFeedback feedback;
+    uint8 sendDataBuff[NUM_CHANNELS*4];
+    double seconds = 2;
+    int priority = 0, i, ret = 1;
+
+    if( argc > 1 )
+        seconds = atof(argv[1]);
+    if( argc > 2 )
+        priority = atoi(argv[2]);
+
+    //Open first found U6 over USB
+    hDevice = openUSBConnection(-1);
+    if( hDevice == NULL )
+        return 1;
+
+    if( getCalibrationInfo(hDevice, &caliInfo) < 0 )
+        goto close;
+
+    for( i = 0; i < NUM_CHANNELS; i++ )
+    {
+        sendDataBuff[i*4] = 2;      //IOType is AIN24
+        sendDataBuff[i*4 + 1] = i;  //Positive channel
+        sendDataBuff[i*4 + 2] = RESOLUTION_INDEX + GAIN_INDEX*16;  //Res Index (0-3), Gain Index (4-7)
+        sendDataBuff[i*4 + 3] = 0;  //Settling factor (0-2), Differential (7)
+    }
+    if( ehFeedbackPrepare(&feedback, sendDataBuff, NUM_CHANNELS*4, NUM_CHANNELS*3) < 0 )
+        goto close;
+
+    printf("Feedback with %d AIN24 readings every %.0f us, %.0f s per run\n", NUM_CHANNELS, PERIOD_US, seconds);
+    if( usleepLoop(hDevice, &feedback, &caliInfo, seconds) < 0 ||
+        scannerRun("scanner, no busy-wait", hDevice, &feedback, &caliInfo, seconds, 0, priority) < 0 ||
+        scannerRun("scanner, 100 us busy-wait", hDevice, &feedback, &caliInfo, seconds, SPIN_US, priority) < 0 )
+        goto close;
+    ret = 0;
+
+close:
+    closeUSBConnection(hDevice);
+    return ret;
+}
@@ -0,0 +1,273 @@
+//Author: LabJack
+//October 18, 2026
+//Measures the throughput of the labjackfilter.h stream decimation filters on
+//one core, checks their response, and runs one in the stream reading loop of
+//a U6.  The first table is the input sample rate each filter sustains and
+//the share of a core it takes at the U6 maximum stream rate (50 ksamples/s).
+//The second is the gain of each filter for a tone in the output band and
+//for tones above the output Nyquist frequency that alias into it.  Last,
+//AIN0 to AIN3 are streamed at 12500 scans/s and decimated by 50 with a FIR
+//filter in the loop that reads the stream, printing the time the filter
+//takes per read.  Pass the number of seconds to stream as an argument
+//(default 5).  Build with "make SIM=1" to run against a simulated U6.
+
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+#include "u6.h"
+#include "labjackfilter.h"
+
+#define BENCH_SCANS        4096   //Scans per LJUSB_StreamFilterProcess call
+#define BENCH_SAMPLES      20000000
+#define U6_MAX_SAMPLE_RATE 50000.0
+#define NUM_CHANNELS       4
+#define SCAN_RATE          12500.0
+#define RESOLUTION_INDEX   1
+#define STREAM_RATIO       50
+#define MAX_READ_SIZE      (64*256)
+
+typedef struct
+{
+    const char *name;
+    int type;
+    unsigned int ratio;
+    unsigned int param;
+} FilterSpec;
+
+static const FilterSpec filterSpecs[] =
+{
+    {"boxcar /10",       LJUSB_FILTER_BOXCAR, 10,  0},
+    {"boxcar /100",      LJUSB_FILTER_BOXCAR, 100, 0},
+    {"CIC order 3 /10",  LJUSB_FILTER_CIC,    10,  3},
+    {"CIC order 3 /100", LJUSB_FILTER_CIC,    100, 3},
+    {"FIR 161 taps /10", LJUSB_FILTER_FIR,    10,  0},
+    {"FIR 801 taps /50", LJUSB_FILTER_FIR,    50,  0},
+};
+#define NUM_SPECS  (sizeof(filterSpecs)/sizeof(filterSpecs[0]))
+
+static double getSeconds()
+{
+    return LJUSB_GetTimestampNs()/1.0e9;
+}
+
+//Filters BENCH_SAMPLES samples of noise and returns the input samples per
+//second, or -1 on error
+static double benchmarkFilter(const FilterSpec *spec, unsigned int numChannels, float *in, float *out)
+{
+    LJUSB_StreamFilter *filter;
+    unsigned long calls, i;
+    double start, elapsed;
+
+    filter = LJUSB_StreamFilterCreate(numChannels, spec->type, spec->ratio, spec->param);
+    if( filter == NULL )
+    {
+        printf("LJUSB_StreamFilterCreate error : %s\n", strerror(errno));
+        return -1;
+    }
+
+    calls = BENCH_SAMPLES/(BENCH_SCANS*numChannels) + 1;
+    start = getSeconds();
+    for( i = 0; i < calls; i++ )
+    {
+        if( LJUSB_StreamFilterProcess(filter, in, BENCH_SCANS, out, BENCH_SCANS) < 0 )
+        {
+            printf("LJUSB_StreamFilterProcess error : %s\n", strerror(errno));
+            LJUSB_StreamFilterDestroy(filter);
+            return -1;
+        }
+    }
+    elapsed = getSeconds() - start;
+
+    LJUSB_StreamFilterDestroy(filter);
+    return calls*BENCH_SCANS*numChannels/elapsed;
+}
+
+//Returns the gain in dB of a filter for a tone at the given fraction of the
+//output Nyquist frequency, from the RMS of the output after the filter
+//settles
+static double toneGain(const FilterSpec *spec, double frequency, float *in, float *out)
+{
+    LJUSB_StreamFilter *filter;
+    unsigned long numIn = 400*spec->ratio + 8192, skip, i;
+    double sumSq = 0, f = frequency*0.5/spec->ratio;
+    long n;
+
+    if( numIn > BENCH_SCANS*16 )
+        numIn = BENCH_SCANS*16;
+    filter = LJUSB_StreamFilterCreate(1, spec->type, spec->ratio, spec->param);
+    if( filter == NULL )
+        return NAN;
+
+    for( i = 0; i < numIn; i++ )
+        in[i] = (float)(sqrt(2)*sin(2*M_PI*f*i));
+    n = LJUSB_StreamFilterProcess(filter, in, numIn, out, numIn);
+    LJUSB_StreamFilterDestroy(filter);
+
+    //Skip the outputs that include the zeros the filter starts with (the FIR
+    //filters have 16*ratio + 1 taps)
+    skip = 20;
+    if( n <= (long)skip )
+        return NAN;
+    for( i = skip; i < (unsigned long)n; i++ )
+        sumSq += out[i]*out[i];
+    return 10*log10(sumSq/(n - skip));
+}
+
+//Streams and decimates with a FIR filter in the reading loop
+static int streamFiltered(double seconds)
+{
+    HANDLE hDevice;
+    u6CalibrationInfo caliInfo;
+    LJUSB_StreamPlan plan;
+    LJUSB_StreamDecoder decoder;
+    LJUSB_StreamChannelCal cal;
+    LJUSB_StreamFilter *filter;
+    BYTE recBuff[MAX_READ_SIZE];
+    float volts[MAX_READ_SIZE];
+    uint8 channelNumbers[NUM_CHANNELS], channelOptions[NUM_CHANNELS];
+    unsigned long long inScans = 0, outScans = 0, reads = 0, startNs, filterNs = 0, maxFilterNs = 0, ns;
+    unsigned long recChars;
+    double start;
+    long n;
+    int i, ret = 1;
+
+    if( LJUSB_StreamPlanCompute(U6_PRODUCT_ID, NUM_CHANNELS, SCAN_RATE, RESOLUTION_INDEX, 0, &plan) != 0 ||
+        plan.readSize > MAX_READ_SIZE )
+    {
+        printf("LJUSB_StreamPlanCompute error\n");
+        return 1;
+    }
+
+    filter = LJUSB_StreamFilterCreate(NUM_CHANNELS, LJUSB_FILTER_FIR, STREAM_RATIO, 0);
+    if( filter == NULL )
+    {
+        printf("LJUSB_StreamFilterCreate error : %s\n", strerror(errno));
+        return 1;
+    }
+
+    //Open first found U6 over USB
+    hDevice = openUSBConnection(-1);
+    if( hDevice == NULL )
+        goto destroy;
+
+    if( getCalibrationInfo(hDevice, &caliInfo) < 0 ||
+        LJUSB_StreamDecoderInit(&decoder, U6_PRODUCT_ID, NUM_CHANNELS, plan.samplesPerPacket, LJUSB_STREAM_OUTPUT_FLOAT32) != 0 )
+        goto close;
+    for( i = 0; i < NUM_CHANNELS; i++ )
+    {
+        channelNumbers[i] = i;
+        channelOptions[i] = 0;  //Gain x1, single-ended
+        if( getStreamCalibration(&caliInfo, RESOLUTION_INDEX, 0, &cal) != 0 ||
+            LJUSB_StreamDecoderSetCal(&decoder, i, &cal) != 0 )
+            goto close;
+    }
+
+    ehStreamStop(hDevice);  //In case a previous program left a stream running
+    if( ehStreamConfig(hDevice, NUM_CHANNELS, RESOLUTION_INDEX, plan.samplesPerPacket, 0, plan.scanConfig, plan.scanInterval,
+                       channelNumbers, channelOptions) != 0 ||
+        ehStreamStart(hDevice) != 0 )
+        goto close;
+
+    printf("\nStreaming %d channels at %.0f scans/s, %lu bytes per read, FIR decimating by %d\n", NUM_CHANNELS,
+           plan.scanRate, plan.readSize, STREAM_RATIO);
+    start = getSeconds();
+    while( getSeconds() - start < seconds )
+    {
+        recChars = LJUSB_Stream(hDevice, recBuff, plan.readSize);
+        if( recChars < plan.readSize )
+        {
+            printf("Error : read failed (%lu of %lu bytes)\n", recChars, plan.readSize);
+            break;
+        }
+        n = LJUSB_StreamDecode(&decoder, recBuff, recChars, volts, MAX_READ_SIZE/NUM_CHANNELS);
+        if( n < 0 )
+        {
+            printf("LJUSB_StreamDecode error : errorcode %d\n", decoder.errorcode);
+            break;
+        }
+        inScans += n;
+
+        //Filter in place: the consumer only gets the decimated scans
+        startNs = LJUSB_GetTimestampNs();
+        n = LJUSB_StreamFilterProcess(filter, volts, n, volts, n);
+        ns = LJUSB_GetTimestampNs() - startNs;
+        if( n < 0 )
+        {
+            printf("LJUSB_StreamFilterProcess error : %s\n", strerror(errno));
+            break;
+        }
+        outScans += n;
+        filterNs += ns;
+        if( ns > maxFilterNs )
+            maxFilterNs = ns;
+        reads++;
+    }
+    ehStreamStop(hDevice);
+
+    if( reads > 0 )
+    {
+        printf("%llu scans in, %llu scans out (%.0f scans/s), filter delay %.1f scans\n", inScans, outScans,
+               outScans/seconds, LJUSB_StreamFilterDelay(filter));
+        printf("filter time per read: mean %.1f us, max %.1f us, %.3f%% of the read period\n", filterNs/1.0e3/reads,
+               maxFilterNs/1.0e3, 100.0*filterNs/1.0e9/reads*plan.readRate);
+    }
+    ret = 0;
+
+close:
+    closeUSBConnection(hDevice);
+destroy:
+    LJUSB_StreamFilterDestroy(filter);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    static float in[BENCH_SCANS*16], out[BENCH_SCANS*16];
+    static const unsigned int channels[] = {1, 4, 16};
+    static const double tones[] = {0.25, 1.2, 1.5, 3.0};
+    double seconds = 5, rate;
+    unsigned int s, c, t;
+    unsigned long i;
+
+    if( argc > 1 )
+        seconds = atof(argv[1]);
+
+    //Noise, so that the filters do not see denormals or repeating data
+    srand(1);
+    for( i = 0; i < BENCH_SCANS*16; i++ )
+        in[i] = (float)(rand()/(double)RAND_MAX - 0.5);
+
+    printf("Input Msamples/s on one core (%% of a core at %.0f ksamples/s)\n", U6_MAX_SAMPLE_RATE/1000);
+    printf("%-18s", "filter");
+    for( c = 0; c < sizeof(channels)/sizeof(channels[0]); c++ )
+        printf("  %11u ch   ", channels[c]);
+    printf("\n");
+    for( s = 0; s < NUM_SPECS; s++ )
+    {
+        printf("%-18s", filterSpecs[s].name);
+        for( c = 0; c < sizeof(channels)/sizeof(channels[0]); c++ )
+        {
+            rate = benchmarkFilter(&filterSpecs[s], channels[c], in, out);
+            if( rate < 0 )
+                return 1;
+            printf("  %7.1f (%5.2f%%)", rate/1.0e6, 100*U6_MAX_SAMPLE_RATE/rate);
+        }
+        printf("\n");
+        fflush(stdout);
+    }
+
+    printf("\nGain in dB for a tone at a fraction of the output Nyquist frequency\n");
+    printf("%-18s", "filter");
+    for( t = 0; t < sizeof(tones)/sizeof(tones[0]); t++ )
+        printf("  %7.2f", tones[t]);
+    printf("\n");
+    for( s = 0; s < NUM_SPECS; s++ )
+    {
+        printf("%-18s", filterSpecs[s].name);
+        for( t = 0; t < sizeof(tones)/sizeof(tones[0]); t++ )
+            printf("  %7.1f", toneGain(&filterSpecs[s], tones[t], in, out));
+        printf("\n");
+    }
+
+    return streamFiltered(seconds);
+}
@@ -0,0 +1,252 @@
+//Author: LabJack
+//October 18, 2026
+//Measures the time per call of the u6.c helpers that run on every command and
+//reading:  the normalChecksum8, extendedChecksum16 and extendedChecksum8
+//checksums, FPuint8ArrayToFPDouble and getAinVoltCalibrated.  The buffers
+//are the ones the helpers see in use:  StreamStart responses, Feedback
+//responses with 14 AIN24 readings, 64-byte StreamData responses, the
+//calibration memory read by getCalibrationInfo (nominal U6 constants) and
+//AIN24 readings at ResolutionIndex 1 and 9.  No U6 is needed.  Each test
+//repeats the calls for a time and prints the nanoseconds per call and the
+//calls per second, so changes to the helpers can be compared.  Pass the
+//number of seconds to run each test as an argument (default 1).
+
+#include <string.h>
+#include "u6.h"
+
+#define NUM_BUFFERS   64   //Buffers of each kind, so the data is not always the same
+#define BATCH_CALLS   4096
+
+//Nominal calibration constants, in the order of u6CalibrationInfo
+//ccConstants (see u6.h)
+static const double nominalConstants[40] =
+{
+    3.1580578e-4, -10.586956522, 3.1580578e-5, -1.0586956522,       //AIN slopes and offsets
+    3.1580578e-6, -0.10586956522, 3.1580578e-7, -0.010586956522,
+    -3.1580578e-4, 33523.0, -3.1580578e-5, 33523.0,                 //Negative slopes and center points
+    -3.1580578e-6, 33523.0, -3.1580578e-7, 33523.0,
+    13200.0, 0.0, 13200.0, 0.0,                                     //DAC0 and DAC1
+    -92.379, 465.129, 0.0, 0.0,                                     //Temperature
+    3.1580578e-4, -10.586956522, 3.1580578e-5, -1.0586956522,       //High resolution
+    3.1580578e-6, -0.10586956522, 3.1580578e-7, -0.010586956522,
+    -3.1580578e-4, 33523.0, -3.1580578e-5, 33523.0,
+    -3.1580578e-6, 33523.0, -3.1580578e-7, 33523.0
+};
+
+static uint8 streamStartResponses[NUM_BUFFERS][4];
+static uint8 feedbackResponses[NUM_BUFFERS][52];    //14 AIN24 readings
+static uint8 streamDataResponses[NUM_BUFFERS][64];  //25 samples
+static uint8 calMem[40*8];
+static uint32 ainReadings[NUM_BUFFERS*14];
+
+static volatile double sink;
+
+static double getSeconds()
+{
+    return LJUSB_GetTimestampNs()/1.0e9;
+}
+
+//Pseudo-random bytes, the same on every run
+static uint32 nextRandom()
+{
+    static uint32 state = 0x12345678;
+
+    state = state*1664525 + 1013904223;
+    return state >> 8;
+}
+
+//Stores a value in the 32.32 fixed point format of the calibration memory,
+//which FPuint8ArrayToFPDouble decodes
+static void putFixedPoint(uint8 *buffer, double value)
+{
+    int whole = (int)floor(value);
+    uint32 fraction = (uint32)((value - floor(value))*4294967296.0);
+    int i;
+
+    for( i = 0; i < 4; i++ )
+    {
+        buffer[i] = (uint8)(fraction >> (i*8));
+        buffer[4 + i] = (uint8)((uint32)whole >> (i*8));
+    }
+}
+
+static void fillBuffers(u6CalibrationInfo *caliInfo)
+{
+    uint32 code;
+    int b, i;
+
+    for( b = 0; b < NUM_BUFFERS; b++ )
+    {
+        streamStartResponses[b][1] = (uint8)(0xA9);
+        streamStartResponses[b][2] = (uint8)(nextRandom() % 2)*52;  //Errorcode 0 or 52
+        streamStartResponses[b][0] = normalChecksum8(streamStartResponses[b], 4);
+
+        feedbackResponses[b][1] = (uint8)(0xF8);
+        feedbackResponses[b][2] = (uint8)(52/2 - 3);
+        feedbackResponses[b][3] = (uint8)(0x00);
+        for( i = 0; i < 14; i++ )
+        {
+            //AIN24 readings around the center of the range
+            code = 0x800000 + nextRandom() % 0x100000 - 0x80000;
+            ainReadings[b*14 + i] = code;
+            feedbackResponses[b][9 + i*3] = (uint8)(code & 0xFF);
+            feedbackResponses[b][10 + i*3] = (uint8)((code >> 8) & 0xFF);
+            feedbackResponses[b][11 + i*3] = (uint8)((code >> 16) & 0xFF);
+        }
+        extendedChecksum(feedbackResponses[b], 52);
+
+        streamDataResponses[b][1] = (uint8)(0xF9);
+        streamDataResponses[b][2] = (uint8)(64/2 - 3);
+        streamDataResponses[b][3] = (uint8)(0xC0);
+        streamDataResponses[b][10] = (uint8)b;  //PacketCounter
+        for( i = 12; i < 62; i++ )
+            streamDataResponses[b][i] = (uint8)nextRandom();
+        extendedChecksum(streamDataResponses[b], 64);
+    }
+
+    for( i = 0; i < 40; i++ )
+        putFixedPoint(calMem + i*8, nominalConstants[i]);
+
+    memset(caliInfo, 0, sizeof(u6CalibrationInfo));
+    caliInfo->prodID = 6;
+    caliInfo->hiRes = 1;
+    for( i = 0; i < 40; i++ )
+        caliInfo->ccConstants[i] = FPuint8ArrayToFPDouble(calMem, i*8);
+}
+
+//Each batch function makes BATCH_CALLS calls over the buffers and returns a
+//sum of the results, so the calls are not optimized out
+
+static double batchNormalChecksum8(u6CalibrationInfo *caliInfo)
+{
+    uint32 total = 0;
+    int i;
+
+    for( i = 0; i < BATCH_CALLS; i++ )
+        total += normalChecksum8(streamStartResponses[i % NUM_BUFFERS], 4);
+    return total;
+}
+
+static double batchChecksum16Feedback(u6CalibrationInfo *caliInfo)
+{
+    uint32 total = 0;
+    int i;
+
+    for( i = 0; i < BATCH_CALLS; i++ )
+        total += extendedChecksum16(feedbackResponses[i % NUM_BUFFERS], 52);
+    return total;
+}
+
+static double batchChecksum16StreamData(u6CalibrationInfo *caliInfo)
+{
+    uint32 total = 0;
+    int i;
+
+    for( i = 0; i < BATCH_CALLS; i++ )
+        total += extendedChecksum16(streamDataResponses[i % NUM_BUFFERS], 64);
+    return total;
+}
+
+static double batchChecksum8(u6CalibrationInfo *caliInfo)
+{
+    uint32 total = 0;
+    int i;
+
+    for( i = 0; i < BATCH_CALLS; i++ )
+        total += extendedChecksum8(streamDataResponses[i % NUM_BUFFERS]);
+    return total;
+}
+
+static double batchFPuint8ArrayToFPDouble(u6CalibrationInfo *caliInfo)
+{
+    double sum = 0;
+    int i;
+
+    for( i = 0; i < BATCH_CALLS; i++ )
+        sum += FPuint8ArrayToFPDouble(calMem, (i % 40)*8);
+    return sum;
+}
+
+static double batchAinResolution(u6CalibrationInfo *caliInfo, int resolutionIndex)
+{
+    double sum = 0, volts;
+    int i;
+
+    for( i = 0; i < BATCH_CALLS; i++ )
+    {
+        getAinVoltCalibrated(caliInfo, resolutionIndex, 0, 1, ainReadings[i % (NUM_BUFFERS*14)], &volts);
+        sum += volts;
+    }
+    return sum;
+}
+
+static double batchAin(u6CalibrationInfo *caliInfo)
+{
+    return batchAinResolution(caliInfo, 1);
+}
+
+static double batchAinHiRes(u6CalibrationInfo *caliInfo)
+{
+    return batchAinResolution(caliInfo, 9);
+}
+
+typedef struct
+{
+    const char *name;
+    double (*batch)(u6CalibrationInfo *caliInfo);
+} HelperTest;
+
+static const HelperTest tests[] =
+{
+    {"normalChecksum8, 4-byte StreamStart response", batchNormalChecksum8},
+    {"extendedChecksum16, 52-byte Feedback response", batchChecksum16Feedback},
+    {"extendedChecksum16, 64-byte StreamData", batchChecksum16StreamData},
+    {"extendedChecksum8", batchChecksum8},
+    {"FPuint8ArrayToFPDouble, calibration memory", batchFPuint8ArrayToFPDouble},
+    {"getAinVoltCalibrated, AIN24, resolution 1", batchAin},
+    {"getAinVoltCalibrated, AIN24, resolution 9", batchAinHiRes},
+};
+#define NUM_TESTS  (sizeof(tests)/sizeof(tests[0]))
+
+//Runs a test in batches for the given number of seconds and prints the time
+//per call
+static void runTest(const HelperTest *test, u6CalibrationInfo *caliInfo, double seconds)
+{
+    unsigned long long calls = 0;
+    double start, elapsed, sum = 0;
+
+    start = getSeconds();
+    do
+    {
+        sum += test->batch(caliInfo);
+        calls += BATCH_CALLS;
+        elapsed = getSeconds() - start;
+    } while( elapsed < seconds );
+    sink = sum;
+
+    printf("%-46s %8.2f ns/call %11.0f calls/s\n", test->name, elapsed*1.0e9/calls, calls/elapsed);
+}
+
+int main(int argc, char **argv)
+{
+    u6CalibrationInfo caliInfo;
+    double seconds = 1.0;
+    unsigned int i;
+
+    if( argc > 1 )
+        seconds = atof(argv[1]);
+    if( seconds <= 0 )
+    {
+        printf("Usage: %s [seconds per test]\n", argv[0]);
+        return 1;
+    }
+
+    fillBuffers(&caliInfo);
+
+    for( i = 0; i < NUM_TESTS; i++ )
+    {
+        runTest(&tests[i], &caliInfo, seconds);
+        fflush(stdout);
+    }
+    return 0;
+}
@@ -0,0 +1,131 @@
+//Author: LabJack
+//October 18, 2026
+//Measures the I2C transaction rate of the I2C helper function and of the
+//labjacki2c.h I2C engine, with one command at a time and with several
+//commands written ahead of their responses.  Each transaction reads the 4
+//byte serial number from the EEPROM of an LJTDAC with SCL on FIO2 and SDA on
+//FIO3, like u6LJTDAC.  Pass the number of seconds to run each test as an
+//argument (default 1).  Build with "make SIM=1" to run against a simulated U6,
+//and set LJSIM_LATENCY_US to model the USB round trip time.
+
+#include "u6.h"
+#include "labjacki2c.h"
+#include <time.h>
+
+#define SCL_PIN_NUM  2
+#define SDA_PIN_NUM  3
+#define BATCH_SIZE   8
+
+static double getSeconds()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec/1.0e9;
+}
+
+static void printRate(const char *name, long transactions, double elapsed)
+{
+    printf("%-32s %9.0f transactions/s %9.1f us/transaction\n", name,
+           transactions/elapsed, elapsed*1.0e6/transactions);
+}
+
+//Reads the serial number with the I2C helper function, which allocates its
+//buffers and waits for each response.
+static long benchmarkHelper(HANDLE hDevice, double seconds)
+{
+    uint8 bytesCommand[1], bytesResponse[4], ackArray[4], errorcode;
+    double start, elapsed;
+    long transactions = 0;
+
+    bytesCommand[0] = 96;  //EEPROM address of the serial number
+    start = getSeconds();
+    do
+    {
+        if( I2C(hDevice, 0, 0, SDA_PIN_NUM, SCL_PIN_NUM, 0xA0, 1, 4, bytesCommand, &errorcode, ackArray, bytesResponse) < 0 || errorcode != 0 )
+        {
+            printf("I2C error %d\n", errorcode);
+            return -1;
+        }
+        transactions++;
+        elapsed = getSeconds() - start;
+    } while( elapsed < seconds );
+
+    printRate("I2C helper", transactions, elapsed);
+    return 0;
+}
+
+//Reads the serial number in batches of BATCH_SIZE transactions with an I2C
+//engine that writes up to maxInFlight commands ahead.
+static long benchmarkEngine(HANDLE hDevice, unsigned int maxInFlight, double seconds)
+{
+    LJUSB_I2CEngine engine;
+    BYTE bytesCommand[1];
+    double start, elapsed;
+    long transactions = 0;
+    char name[64];
+    int i;
+
+    if( LJUSB_I2CEngineInit(&engine, hDevice, 0, 0, SDA_PIN_NUM, SCL_PIN_NUM, maxInFlight) != 0 )
+    {
+        printf("LJUSB_I2CEngineInit error\n");
+        return -1;
+    }
+
+    bytesCommand[0] = 96;  //EEPROM address of the serial number
+    start = getSeconds();
+    do
+    {
+        for( i = 0; i < BATCH_SIZE; i++ )
+            LJUSB_I2CQueue(&engine, 0xA0, bytesCommand, 1, 4);
+
+        if( LJUSB_I2CFlush(&engine) != BATCH_SIZE )
+        {
+            printf("LJUSB_I2CFlush error\n");
+            return -1;
+        }
+
+        for( i = 0; i < BATCH_SIZE; i++ )
+        {
+            if( engine.queue[i].errorcode != 0 || engine.queue[i].acked == 0 )
+            {
+                printf("I2C engine error %d, ack array %u\n", engine.queue[i].errorcode, engine.queue[i].ackArray);
+                return -1;
+            }
+        }
+
+        transactions += BATCH_SIZE;
+        elapsed = getSeconds() - start;
+    } while( elapsed < seconds );
+
+    snprintf(name, sizeof(name), "I2C engine, %u in flight", maxInFlight);
+    printRate(name, transactions, elapsed);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    HANDLE hDevice;
+    double seconds = 1.0;
+
+    if( argc > 1 )
+        seconds = atof(argv[1]);
+    if( seconds <= 0 )
+    {
+        printf("Usage: %s [seconds per test]\n", argv[0]);
+        return 1;
+    }
+
+    //Open first found U6 over USB
+    hDevice = openUSBConnection(-1);
+    if( hDevice == NULL )
+        return 1;
+
+    if( benchmarkHelper(hDevice, seconds) == 0 &&
+        benchmarkEngine(hDevice, 1, seconds) == 0 &&
+        benchmarkEngine(hDevice, 2, seconds) == 0 )
+        benchmarkEngine(hDevice, 4, seconds);
+
+    closeUSBConnection(hDevice);
+    return 0;
+}
@@ -22,11 +22,19 @@ int main(int argc, char **argv)
     if( configIO_example(hDevice) != 0 )
         goto close;
 
-    //Getting calibration information from LJTDAC
-    if( getTdacCalibrationInfo(hDevice, &caliInfo, 2) < 0 )
+    //Getting calibration information from LJTDAC.  It is read from the LJTDAC
+    //once and cached for the handle and pin.
+    if( getTdacCalibrationInfoCached(hDevice, &caliInfo, 2) < 0 )
         goto close;
 
-    tdac_example(hDevice, &caliInfo);
+    if( tdac_example(hDevice, &caliInfo) != 0 )
+        goto close;
+
+    //Setting DACA to 1.2 volts and DACB to 2.3 volts with one I2C command, using
+    //the cached calibration information
+    if( eTDAC(hDevice, NULL, 2, 1.2, 2.3) != 0 )
+        goto close;
+    printf("DACA and DACB set to 1.2 and 2.3 volts with one I2C command\n");
 
 close:
     closeUSBConnection(hDevice);
@@ -43,7 +51,7 @@ int configIO_example(HANDLE hDevice)
     int sendChars, recChars, i;
 
     sendBuff[1] = (uint8)(0xF8);  //Command byte
-    sendBuff[2] = (uint8)(0x03);  //Number of data words
+    sendBuff[2] = (uint8)(0x05);  //Number of data words
     sendBuff[3] = (uint8)(0x0B);  //Extended command number
 
     sendBuff[6] = 1;  //Writemask : Setting writemask for TimerCounterConfig (bit 0)
@@ -0,0 +1,222 @@
+//Author: LabJack
+//October 18, 2026
+//Streams AIN0 to AIN3 with a low latency plan (short StreamData responses,
+//one per read) and measures the age of the newest sample when the host gets
+//it, first with LJUSB_Stream calls in a loop and then with several
+//asynchronous reads in flight and a callback for each.  The sample ages are
+//printed as percentiles.  Pass the number of seconds to run each test and the
+//latency budget in microseconds as arguments (default 5 s and 1500 us).
+//Build with "make SIM=1" to run against a simulated U6, and set
+//LJSIM_LATENCY_US to model the USB round trip time.
+
+#include <errno.h>
+#include <string.h>
+#include "u6.h"
+
+#define NUM_CHANNELS      4
+#define SCAN_RATE         2000.0
+#define RESOLUTION_INDEX  1
+
+typedef struct
+{
+    LJUSB_StreamDecoder decoder;
+    LJUSB_StreamAgeStats ages;
+    unsigned long long startNs;
+    unsigned short scan[LJUSB_STREAM_MAX_CHANNELS * 16];
+    unsigned short newest[NUM_CHANNELS];
+    int error;
+} StreamState;
+
+static StreamState state;
+
+//Decodes a read and records the age of its newest sample.  A control loop
+//would compute its output from state->newest here.
+static void processRead(StreamState *s, BYTE *pBuff, unsigned long count, unsigned long long timestampNs)
+{
+    long numScans;
+
+    numScans = LJUSB_StreamDecodeStamped(&s->decoder, pBuff, count, timestampNs, s->scan, LJUSB_StreamMaxScans(&s->decoder, count));
+    if( numScans < 0 )
+    {
+        printf("LJUSB_StreamDecode error : errorcode %d\n", s->decoder.errorcode);
+        s->error = -1;
+        return;
+    }
+    if( numScans > 0 )
+        memcpy(s->newest, s->scan + (numScans - 1)*NUM_CHANNELS, sizeof(s->newest));
+
+    LJUSB_StreamAgeStatsAdd(&s->ages, LJUSB_StreamSampleAgeUs(&s->decoder, s->startNs, LJUSB_GetTimestampNs()));
+}
+
+static void streamCallback(BYTE *pBuff, unsigned long count, unsigned long long timestampNs, int error, void *userData)
+{
+    StreamState *s = (StreamState *)userData;
+
+    if( error != 0 )
+    {
+        printf("Stream read error : %s\n", strerror(error));
+        s->error = -1;
+        return;
+    }
+    processRead(s, pBuff, count, timestampNs);
+}
+
+//Configures and starts the stream of a plan, and sets state.startNs to the
+//middle of the StreamStart command and response.
+static long startStream(HANDLE hDevice, const LJUSB_StreamPlan *plan)
+{
+    uint8 channelNumbers[NUM_CHANNELS], channelOptions[NUM_CHANNELS];
+    unsigned long long beforeNs;
+    int i;
+
+    for( i = 0; i < NUM_CHANNELS; i++ )
+    {
+        channelNumbers[i] = i;
+        channelOptions[i] = 0;  //Gain x1, single-ended
+    }
+
+    ehStreamStop(hDevice);  //In case a previous program left a stream running
+    if( ehStreamConfig(hDevice, NUM_CHANNELS, RESOLUTION_INDEX, plan->samplesPerPacket, 0, plan->scanConfig, plan->scanInterval, channelNumbers, channelOptions) != 0 )
+        return -1;
+
+    if( LJUSB_StreamDecoderInit(&state.decoder, U6_PRODUCT_ID, NUM_CHANNELS, plan->samplesPerPacket, LJUSB_STREAM_OUTPUT_RAW16) != 0 )
+    {
+        printf("LJUSB_StreamDecoderInit error\n");
+        return -1;
+    }
+    //Keeps about a minute of reads in the clock estimate
+    LJUSB_StreamClockInit(&state.decoder.clock, plan->scanRate, 1 - 1/(plan->readRate*60));
+    LJUSB_StreamAgeStatsReset(&state.ages);
+    state.error = 0;
+
+    beforeNs = LJUSB_GetTimestampNs();
+    if( ehStreamStart(hDevice) != 0 )
+        return -1;
+    state.startNs = beforeNs + (LJUSB_GetTimestampNs() - beforeNs)/2;
+    return 0;
+}
+
+static void printAges(const char *name)
+{
+    const LJUSB_StreamAgeStats *a = &state.ages;
+
+    if( a->count == 0 )
+    {
+        printf("%-26s no reads\n", name);
+        return;
+    }
+    printf("%-26s %7llu reads  mean %6.0f  p50 %6.0f  p90 %6.0f  p99 %6.0f  p99.9 %6.0f  max %6.0f us  gaps %llu\n",
+           name, a->count, a->sumUs/a->count, LJUSB_StreamAgeStatsPercentile(a, 50),
+           LJUSB_StreamAgeStatsPercentile(a, 90), LJUSB_StreamAgeStatsPercentile(a, 99),
+           LJUSB_StreamAgeStatsPercentile(a, 99.9), a->maxUs, state.decoder.totalGaps);
+}
+
+//Reads with LJUSB_StreamStampedTO in a loop, one read in flight at a time.
+static long runSynchronous(HANDLE hDevice, const LJUSB_StreamPlan *plan, double seconds)
+{
+    BYTE recBuff[64*16];
+    unsigned long long timestampNs, endNs;
+    unsigned long recChars;
+
+    if( startStream(hDevice, plan) != 0 )
+        return -1;
+
+    endNs = state.startNs + (unsigned long long)(seconds*1.0e9);
+    do
+    {
+        recChars = LJUSB_StreamStampedTO(hDevice, recBuff, plan->readSize, 1000, &timestampNs);
+        if( recChars < plan->readSize )
+        {
+            printf("Error : read failed (%lu of %lu bytes)\n", recChars, plan->readSize);
+            state.error = -1;
+            break;
+        }
+        processRead(&state, recBuff, recChars, timestampNs);
+    } while( state.error == 0 && timestampNs < endNs );
+
+    ehStreamStop(hDevice);
+    if( state.error == 0 )
+        printAges("LJUSB_Stream loop");
+    return state.error;
+}
+
+//Keeps plan->numTransfers reads in flight and handles each in a callback.
+static long runAsynchronous(HANDLE hDevice, const LJUSB_StreamPlan *plan, double seconds)
+{
+    LJUSB_StreamAsync *async;
+    unsigned long long endNs;
+    char name[64];
+
+    async = LJUSB_StreamAsyncStart(hDevice, plan->readSize, plan->numTransfers, 1000, streamCallback, &state);
+    if( async == NULL )
+    {
+        printf("LJUSB_StreamAsyncStart error : %s\n", strerror(errno));
+        return -1;
+    }
+    if( startStream(hDevice, plan) != 0 )
+    {
+        LJUSB_StreamAsyncStop(async);
+        return -1;
+    }
+
+    endNs = state.startNs + (unsigned long long)(seconds*1.0e9);
+    while( state.error == 0 && LJUSB_GetTimestampNs() < endNs )
+    {
+        if( LJUSB_StreamAsyncHandleEvents(async, 100) < 0 )
+        {
+            printf("LJUSB_StreamAsyncHandleEvents error : %s\n", strerror(errno));
+            state.error = -1;
+        }
+    }
+
+    LJUSB_StreamAsyncStop(async);
+    ehStreamStop(hDevice);
+    if( state.error == 0 )
+    {
+        snprintf(name, sizeof(name), "Async, %u in flight", plan->numTransfers);
+        printAges(name);
+    }
+    return state.error;
+}
+
+int main(int argc, char **argv)
+{
+    HANDLE hDevice;
+    LJUSB_StreamPlan plan;
+    double seconds = 5.0, budgetUs = 1500.0;
+
+    if( argc > 1 )
+        seconds = atof(argv[1]);
+    if( argc > 2 )
+        budgetUs = atof(argv[2]);
+    if( seconds <= 0 || budgetUs <= 0 )
+    {
+        printf("Usage: %s [seconds per test] [latency budget in us]\n", argv[0]);
+        return 1;
+    }
+
+    if( LJUSB_StreamPlanCompute(U6_PRODUCT_ID, NUM_CHANNELS, SCAN_RATE, RESOLUTION_INDEX, budgetUs, &plan) != 0 )
+    {
+        printf("LJUSB_StreamPlanCompute error : %s\n", strerror(errno));
+        return 1;
+    }
+    if( plan.readSize > 64*16 )
+    {
+        printf("The latency budget is too large for this example\n");
+        return 1;
+    }
+    printf("%d channels at %.0f scans/s: SamplesPerPacket %u, %lu packets per read, %.0f reads/s, planned latency %.0f us%s\n",
+           NUM_CHANNELS, plan.scanRate, plan.samplesPerPacket, plan.packetsPerRead, plan.readRate,
+           plan.latencyUs, (plan.meetsLatency ? "" : " (budget not met)"));
+
+    //Open first found U6 over USB
+    hDevice = openUSBConnection(-1);
+    if( hDevice == NULL )
+        return 1;
+
+    if( runSynchronous(hDevice, &plan, seconds) == 0 )
+        runAsynchronous(hDevice, &plan, seconds);
+
+    closeUSBConnection(hDevice);
+    return 0;
+}
@@ -0,0 +1,258 @@
+//Author: LabJack
+//October 18, 2026
+//Measures Feedback command latency with several processes sharing a U6.
+//"u6SharedBench [clients] [seconds] [-stream]" forks the given number of
+//processes (default 4, for 5 seconds), each of which opens the first found
+//U6 and reads AIN0 with a prepared Feedback command as fast as it can, then
+//prints the mean, median and 99th percentile round trip.  With -stream, one
+//more process streams AIN0 to AIN3 at 12500 scans/s while the commands run,
+//and another subscribes to the same stream with LJUSB_Stream alone.
+//Build with "make CLIENT=1" to go through the ljshared daemon (start it
+//first, see ljshared/ljshared.c); each process then also prints how much of
+//the round trip is device time, waiting behind the other clients, and daemon
+//overhead.  Build with "make SIM=1" or plainly to measure direct access with
+//one client for comparison.
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "u6.h"
+#ifdef LJSHARED_CLIENT
+#include "labjackshared.h"
+#endif
+
+#define MAX_CLIENTS       32
+#define NUM_CHANNELS      4
+#define SCAN_RATE         12500.0
+#define RESOLUTION_INDEX  1
+#define MAX_READ_SIZE     (64*256)
+#define HIST_BIN_US       5
+#define HIST_BINS         20000  //100 ms
+
+static double getSeconds()
+{
+    return LJUSB_GetTimestampNs()/1.0e9;
+}
+
+//Returns the round trip in us below which the given fraction of commands
+//were, from a histogram of HIST_BIN_US bins
+static double percentile(const unsigned long *hist, unsigned long count, double fraction)
+{
+    unsigned long total = 0;
+    int i;
+
+    for( i = 0; i < HIST_BINS; i++ )
+    {
+        total += hist[i];
+        if( total >= fraction*count )
+            return (i + 1)*HIST_BIN_US;
+    }
+    return HIST_BINS*HIST_BIN_US;
+}
+
+//Reads AIN0 with a Feedback command for the given number of seconds
+static int feedbackClient(int id, double seconds)
+{
+    static unsigned long hist[HIST_BINS];
+    HANDLE hDevice;
+    u6PreparedFeedback feedback;
+    uint8 ioTypes[4], data[3], errorcode, errorFrame;
+    unsigned long long startNs, ns, totalNs = 0;
+    unsigned long count = 0, bin;
+    double start;
+#ifdef LJSHARED_CLIENT
+    LJUSB_SharedStats stats;
+#endif
+    int ret = 1;
+
+    hDevice = openUSBConnection(-1);
+    if( hDevice == NULL )
+        return 1;
+
+    ioTypes[0] = 2;   //IOType is AIN24
+    ioTypes[1] = 0;   //Positive channel AIN0
+    ioTypes[2] = 1;   //ResolutionIndex 1, gain x1
+    ioTypes[3] = 0;   //Settling factor auto, single-ended
+    if( ehFeedbackPrepare(&feedback, ioTypes, 4, 3) != 0 )
+        goto close;
+
+    start = getSeconds();
+    while( getSeconds() - start < seconds )
+    {
+        startNs = LJUSB_GetTimestampNs();
+        if( ehFeedbackExecute(hDevice, &feedback, &errorcode, &errorFrame, data) < 0 )
+            goto close;
+        ns = LJUSB_GetTimestampNs() - startNs;
+        if( errorcode != 0 )
+        {
+            printf("client %d : Feedback errorcode %d\n", id, errorcode);
+            goto close;
+        }
+        totalNs += ns;
+        bin = ns/1000/HIST_BIN_US;
+        hist[(bin < HIST_BINS) ? bin : HIST_BINS - 1]++;
+        count++;
+    }
+
+    printf("client %d : %lu commands, %.0f/s, round trip mean %.1f us, p50 %.0f us, p99 %.0f us\n", id, count,
+           count/seconds, (count > 0) ? totalNs/1.0e3/count : 0, percentile(hist, count, 0.5), percentile(hist, count, 0.99));
+#ifdef LJSHARED_CLIENT
+    if( LJUSB_SharedGetStats(hDevice, &stats) != 0 )
+    {
+        printf("LJUSB_SharedGetStats error : %s\n", strerror(errno));
+        goto close;
+    }
+    printf("client %d : device %.1f us, queue %.1f us, overhead mean %.1f us, max %.1f us\n", id, stats.meanDeviceUs,
+           stats.meanQueueUs, stats.meanOverheadUs, stats.maxOverheadUs);
+#endif
+    ret = 0;
+
+close:
+    closeUSBConnection(hDevice);
+    return ret;
+}
+
+//Starts a stream when owner is set, and counts the scans of the stream for
+//the given number of seconds.  A subscriber only reads.
+static int streamClient(int owner, double seconds)
+{
+    const char *label = owner ? "stream owner" : "stream subscriber";
+    HANDLE hDevice;
+    LJUSB_StreamPlan plan;
+    LJUSB_StreamDecoder decoder;
+    BYTE recBuff[MAX_READ_SIZE];
+    unsigned short codes[MAX_READ_SIZE];
+    uint8 channelNumbers[NUM_CHANNELS], channelOptions[NUM_CHANNELS];
+    unsigned long long scans = 0;
+    unsigned long recChars;
+    double start;
+    long n;
+    int i, ret = 1;
+
+    if( LJUSB_StreamPlanCompute(U6_PRODUCT_ID, NUM_CHANNELS, SCAN_RATE, RESOLUTION_INDEX, 0, &plan) != 0 ||
+        plan.readSize > MAX_READ_SIZE )
+    {
+        printf("LJUSB_StreamPlanCompute error\n");
+        return 1;
+    }
+
+    hDevice = openUSBConnection(-1);
+    if( hDevice == NULL )
+        return 1;
+
+    if( LJUSB_StreamDecoderInit(&decoder, U6_PRODUCT_ID, NUM_CHANNELS, plan.samplesPerPacket, LJUSB_STREAM_OUTPUT_RAW16) != 0 )
+        goto close;
+
+    if( owner )
+    {
+        for( i = 0; i < NUM_CHANNELS; i++ )
+        {
+            channelNumbers[i] = i;
+            channelOptions[i] = 0;  //Gain x1, single-ended
+        }
+        ehStreamStop(hDevice);  //In case a previous program left a stream running
+        if( ehStreamConfig(hDevice, NUM_CHANNELS, RESOLUTION_INDEX, plan.samplesPerPacket, 0, plan.scanConfig,
+                           plan.scanInterval, channelNumbers, channelOptions) != 0 ||
+            ehStreamStart(hDevice) != 0 )
+            goto close;
+    }
+
+    start = getSeconds();
+    while( getSeconds() - start < seconds )
+    {
+        errno = 0;
+        recChars = LJUSB_StreamTO(hDevice, recBuff, plan.readSize, 1000);
+        if( recChars == 0 && errno == ETIMEDOUT && !owner )
+            continue;  //The owner has not started the stream yet
+        if( recChars < plan.readSize )
+        {
+            printf("%s : read failed (%lu of %lu bytes)\n", label, recChars, plan.readSize);
+            break;
+        }
+        n = LJUSB_StreamDecode(&decoder, recBuff, recChars, codes, MAX_READ_SIZE/NUM_CHANNELS);
+        if( n < 0 )
+        {
+            printf("%s : LJUSB_StreamDecode error : errorcode %d\n", label, decoder.errorcode);
+            break;
+        }
+        scans += n;
+    }
+    if( owner )
+        ehStreamStop(hDevice);
+
+    //A subscriber reads the packets from the start of the stream, including
+    //the ones the daemon read after the owner's last read, so it only counts
+    if( owner )
+        printf("%s : %llu scans, %.0f scans/s\n", label, scans, scans/seconds);
+    else
+        printf("%s : %llu scans\n", label, scans);
+    ret = 0;
+
+close:
+    closeUSBConnection(hDevice);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    pid_t pids[MAX_CLIENTS + 2];
+    int numClients = 4, stream = 0, numPids = 0, status, failed = 0, i;
+    double seconds = 5;
+
+    for( i = 1; i < argc; i++ )
+    {
+        if( strcmp(argv[i], "-stream") == 0 )
+            stream = 1;
+        else if( i == 1 )
+            numClients = atoi(argv[i]);
+        else
+            seconds = atof(argv[i]);
+    }
+    if( numClients < 1 || numClients > MAX_CLIENTS || seconds <= 0 )
+    {
+        printf("Usage : u6SharedBench [clients (1-%d)] [seconds] [-stream]\n", MAX_CLIENTS);
+        return 1;
+    }
+
+#ifdef LJSHARED_CLIENT
+    printf("%d Feedback clients through ljshared for %.0f seconds%s\n", numClients, seconds, stream ? ", with a stream" : "");
+#else
+    //Only one process can open a device directly
+    if( numClients > 1 || stream )
+    {
+        printf("Direct access: running 1 Feedback client without a stream (build with make CLIENT=1 to share)\n");
+        numClients = 1;
+        stream = 0;
+    }
+    printf("1 Feedback client with direct access for %.0f seconds\n", seconds);
+#endif
+    fflush(stdout);
+
+    for( i = 0; i < numClients + 2*stream; i++ )
+    {
+        pids[numPids] = fork();
+        if( pids[numPids] < 0 )
+        {
+            printf("fork error : %s\n", strerror(errno));
+            failed = 1;
+            break;
+        }
+        if( pids[numPids] == 0 )
+        {
+            if( i < numClients )
+                exit(feedbackClient(i, seconds));
+            //The subscriber outlasts the owner to see the whole stream
+            exit(streamClient(i == numClients, (i == numClients) ? seconds : seconds + 1));
+        }
+        numPids++;
+    }
+
+    for( i = 0; i < numPids; i++ )
+    {
+        if( waitpid(pids[i], &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0 )
+            failed = 1;
+    }
+    return failed;
+}
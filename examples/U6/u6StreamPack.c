@@ -0,0 +1,268 @@
+//Author: LabJack
+//October 18, 2026
+//Streams AIN0 to AIN3 at 12500 scans/s (the U6 maximum of 50000 samples/s at
+//ResolutionIndex 1) to a packed stream file (labjackpack.h) with the U6's
+//calibration in its header.  Then reads the file back, checks that every code
+//matches the streamed ones, and measures how fast the scans are packed and
+//unpacked compared to the stream rate.  Pass the file path (default
+//u6stream.ljpk) and the number of seconds to stream (default 10) as arguments.
+//Build with "make SIM=1" to run against a simulated U6.
+
+#include <errno.h>
+#include <string.h>
+#include "u6.h"
+#include "labjackpack.h"
+
+#define NUM_CHANNELS      4
+#define SCAN_RATE         12500.0
+#define RESOLUTION_INDEX  1
+#define SCANS_PER_CHUNK   8192
+#define MAX_READ_SIZE     (64*256)
+
+static double getSeconds()
+{
+    return LJUSB_GetTimestampNs()/1.0e9;
+}
+
+//Streams for the given number of seconds to the packed file, and keeps a copy
+//of the codes in *pCodes for the check.  Auto-recovery gaps are filled, so
+//scan n of the stream is scan n of the copy.  Returns the number of scans, or
+//-1 on error.
+static long streamToFile(HANDLE hDevice, const char *path, const LJUSB_StreamPackHeader *header, double seconds, unsigned short **pCodes)
+{
+    LJUSB_StreamPlan plan;
+    LJUSB_StreamDecoder decoder;
+    LJUSB_StreamPackWriter *packWriter;
+    LJUSB_StreamPackStats stats;
+    BYTE recBuff[MAX_READ_SIZE];
+    unsigned short *codes;
+    unsigned long long timestampNs;
+    unsigned long recChars, maxScans, numScans = 0;
+    long n;
+    double start;
+
+    if( LJUSB_StreamPlanCompute(U6_PRODUCT_ID, NUM_CHANNELS, SCAN_RATE, RESOLUTION_INDEX, 0, &plan) != 0 ||
+        plan.readSize > MAX_READ_SIZE )
+    {
+        printf("LJUSB_StreamPlanCompute error\n");
+        return -1;
+    }
+
+    //Room for the scans of the run and one more read
+    maxScans = (unsigned long)(SCAN_RATE*(seconds + 1)) + MAX_READ_SIZE;
+    codes = (unsigned short *)malloc(maxScans*NUM_CHANNELS*sizeof(unsigned short));
+    if( codes == NULL )
+    {
+        printf("Out of memory\n");
+        return -1;
+    }
+
+    packWriter = LJUSB_StreamPackWriterOpen(path, header, 1024*1024, 16, 0);
+    if( packWriter == NULL )
+    {
+        printf("LJUSB_StreamPackWriterOpen error : %s\n", strerror(errno));
+        free(codes);
+        return -1;
+    }
+
+    ehStreamStop(hDevice);  //In case a previous program left a stream running
+    if( ehStreamConfig(hDevice, NUM_CHANNELS, RESOLUTION_INDEX, plan.samplesPerPacket, 0, plan.scanConfig, plan.scanInterval,
+                       (uint8 *)header->channelNumbers, (uint8 *)header->channelOptions) != 0 ||
+        LJUSB_StreamDecoderInit(&decoder, U6_PRODUCT_ID, NUM_CHANNELS, plan.samplesPerPacket, LJUSB_STREAM_OUTPUT_RAW16) != 0 ||
+        LJUSB_StreamDecoderSetGapFill(&decoder, 1, 32768) != 0 ||
+        LJUSB_StreamClockInit(&decoder.clock, plan.scanRate, LJUSB_STREAM_CLOCK_DEFAULT_FORGETTING) != 0 ||
+        ehStreamStart(hDevice) != 0 )
+    {
+        LJUSB_StreamPackWriterClose(packWriter, NULL);
+        free(codes);
+        return -1;
+    }
+
+    start = getSeconds();
+    while( getSeconds() - start < seconds && maxScans - numScans >= LJUSB_StreamMaxScans(&decoder, plan.readSize) )
+    {
+        recChars = LJUSB_StreamStampedTO(hDevice, recBuff, plan.readSize, 1000, &timestampNs);
+        if( recChars < plan.readSize )
+        {
+            printf("Error : read failed (%lu of %lu bytes)\n", recChars, plan.readSize);
+            break;
+        }
+        n = LJUSB_StreamDecodeStamped(&decoder, recBuff, recChars, timestampNs, codes + numScans*NUM_CHANNELS, maxScans - numScans);
+        if( n < 0 )
+        {
+            printf("LJUSB_StreamDecode error : errorcode %d\n", decoder.errorcode);
+            break;
+        }
+        //The host time of each chunk goes in the index of the file
+        if( n > 0 && LJUSB_StreamPackWriterWriteStamped(packWriter, decoder.firstScanIndex,
+                         LJUSB_StreamClockScanTime(&decoder.clock, decoder.firstScanIndex, NULL),
+                         codes + numScans*NUM_CHANNELS, n) < 0 )
+            printf("LJUSB_StreamPackWriterWriteStamped error : %s\n", strerror(errno));
+        numScans += n;
+    }
+    ehStreamStop(hDevice);
+
+    if( LJUSB_StreamPackWriterClose(packWriter, &stats) != 0 )
+        printf("LJUSB_StreamPackWriterClose error : %s\n", strerror(errno));
+
+    printf("Streamed %lu scans (%llu gaps) to %s\n", numScans, decoder.totalGaps, path);
+    printf("  %.2f MB of codes in %.2f MB: ratio %.2f, %.2f bits per sample\n",
+           stats.rawBytes/1.0e6, stats.packedBytes/1.0e6, (double)stats.rawBytes/stats.packedBytes,
+           stats.packedBytes*8.0/(stats.scans*NUM_CHANNELS));
+    printf("  %llu chunks, %llu dropped, packing took %.2f%% of the stream time\n",
+           stats.chunks, stats.droppedChunks, stats.packNs/1.0e7/seconds);
+
+    *pCodes = codes;
+    return (long)numScans;
+}
+
+//Reads the file back and compares it to the streamed codes.  Returns 0 if
+//they match.
+static long checkFile(const char *path, const unsigned short *codes, unsigned long numScans)
+{
+    LJUSB_StreamPackReader *reader;
+    LJUSB_StreamPackHeader header;
+    unsigned short *chunk;
+    unsigned long long firstScan;
+    unsigned long numRead = 0;
+    long n;
+    double volts;
+    int mismatch = 0;
+
+    reader = LJUSB_StreamPackReaderOpen(path, &header);
+    if( reader == NULL )
+    {
+        printf("LJUSB_StreamPackReaderOpen error : %s\n", strerror(errno));
+        return -1;
+    }
+    chunk = (unsigned short *)malloc((size_t)header.scansPerChunk*header.numChannels*sizeof(unsigned short));
+    if( chunk == NULL )
+    {
+        LJUSB_StreamPackReaderClose(reader);
+        return -1;
+    }
+
+    while( (n = LJUSB_StreamPackReaderRead(reader, chunk, header.scansPerChunk, &firstScan)) > 0 )
+    {
+        if( firstScan + n > numScans ||
+            memcmp(chunk, codes + firstScan*NUM_CHANNELS, n*NUM_CHANNELS*sizeof(unsigned short)) != 0 )
+            mismatch = 1;
+        numRead += n;
+    }
+    if( n < 0 )
+        printf("LJUSB_StreamPackReaderRead error : %s\n", strerror(errno));
+
+    //The header's calibration converts the codes without the device
+    if( numRead > 0 && LJUSB_StreamConvert(header.cal, header.numChannels, codes, 1, &volts, LJUSB_STREAM_OUTPUT_FLOAT64) == 0 )
+        printf("  first AIN%d sample from the file header calibration: %.4f V\n", header.channelNumbers[0], volts);
+
+    printf("  read back %lu of %lu scans: %s\n", numRead, numScans, (mismatch || numRead != numScans || n < 0) ? "MISMATCH" : "identical");
+
+    free(chunk);
+    LJUSB_StreamPackReaderClose(reader);
+    return (mismatch || numRead != numScans || n < 0) ? -1 : 0;
+}
+
+//Packs and unpacks the streamed codes in memory for at least a second each
+//and prints the speeds in samples/s
+static void measureSpeed(const unsigned short *codes, unsigned long numScans)
+{
+    unsigned long bound = LJUSB_StreamPackBound(NUM_CHANNELS, SCANS_PER_CHUNK);
+    unsigned short out[SCANS_PER_CHUNK*NUM_CHANNELS];
+    unsigned long long samples = 0;
+    unsigned long scan;
+    double start, packRate, unpackRate;
+    BYTE *chunk;
+    long size = 0, n;
+
+    chunk = (BYTE *)malloc(bound);
+    if( chunk == NULL || numScans < SCANS_PER_CHUNK )
+    {
+        free(chunk);
+        return;
+    }
+
+    start = getSeconds();
+    do
+    {
+        for( scan = 0; scan + SCANS_PER_CHUNK <= numScans; scan += SCANS_PER_CHUNK )
+        {
+            size = LJUSB_StreamPack(codes + scan*NUM_CHANNELS, NUM_CHANNELS, SCANS_PER_CHUNK, scan, 0, chunk, bound);
+            samples += SCANS_PER_CHUNK*NUM_CHANNELS;
+        }
+    } while( getSeconds() - start < 1.0 );
+    packRate = samples/(getSeconds() - start);
+
+    samples = 0;
+    start = getSeconds();
+    do
+    {
+        n = LJUSB_StreamUnpack(chunk, size, NUM_CHANNELS, out, SCANS_PER_CHUNK, NULL);
+        if( n < 0 )
+        {
+            printf("LJUSB_StreamUnpack error : %s\n", strerror(errno));
+            free(chunk);
+            return;
+        }
+        samples += n*NUM_CHANNELS;
+    } while( getSeconds() - start < 1.0 );
+    unpackRate = samples/(getSeconds() - start);
+
+    printf("Pack   %7.1f Msamples/s (%.0f x the U6 stream rate)\n", packRate/1.0e6, packRate/(SCAN_RATE*NUM_CHANNELS));
+    printf("Unpack %7.1f Msamples/s (%.0f x the U6 stream rate)\n", unpackRate/1.0e6, unpackRate/(SCAN_RATE*NUM_CHANNELS));
+    free(chunk);
+}
+
+int main(int argc, char **argv)
+{
+    HANDLE hDevice;
+    u6CalibrationInfo caliInfo;
+    LJUSB_StreamPackHeader header;
+    const char *path = "u6stream.ljpk";
+    double seconds = 10.0;
+    unsigned short *codes = NULL;
+    long numScans;
+    int i;
+
+    if( argc > 1 )
+        path = argv[1];
+    if( argc > 2 )
+        seconds = atof(argv[2]);
+    if( seconds <= 0 )
+    {
+        printf("Usage: %s [file] [seconds]\n", argv[0]);
+        return 1;
+    }
+
+    //Open first found U6 over USB
+    hDevice = openUSBConnection(-1);
+    if( hDevice == NULL )
+        return 1;
+
+    if( getCalibrationInfo(hDevice, &caliInfo) < 0 )
+        goto close;
+
+    memset(&header, 0, sizeof(header));
+    header.productID = U6_PRODUCT_ID;
+    header.numChannels = NUM_CHANNELS;
+    header.scansPerChunk = SCANS_PER_CHUNK;
+    header.resolutionIndex = RESOLUTION_INDEX;
+    header.scanRate = SCAN_RATE;
+    header.startTimeNs = LJUSB_GetTimestampNs();
+    for( i = 0; i < NUM_CHANNELS; i++ )
+    {
+        header.channelNumbers[i] = i;
+        header.channelOptions[i] = 0;  //Gain x1, single-ended
+        if( getStreamCalibration(&caliInfo, RESOLUTION_INDEX, 0, &header.cal[i]) != 0 )
+            goto close;
+    }
+
+    numScans = streamToFile(hDevice, path, &header, seconds, &codes);
+    if( numScans > 0 && checkFile(path, codes, numScans) == 0 )
+        measureSpeed(codes, numScans);
+    free(codes);
+
+close:
+    closeUSBConnection(hDevice);
+    return 0;
+}
@@ -0,0 +1,163 @@
+//Author: LabJack
+//October 18, 2026
+//Plans streams with LJUSB_StreamPlanCompute for several channel counts, scan
+//rates and latency budgets, runs each plan and compares the planned scan rate,
+//read rate and latency to the measured ones.  The latency of a read is the age
+//of its first sample when the read completes, with the sample times counted
+//from the StreamStart call at the planned scan rate.  Pass the number of
+//seconds to run each stream as an argument (default 2).  Build with
+//"make SIM=1" to run against a simulated U6, and set LJSIM_LATENCY_US to
+//model the USB round trip time.
+
+#include <errno.h>
+#include <string.h>
+#include "u6.h"
+
+typedef struct
+{
+    unsigned int numChannels;
+    double scanRate;
+    double latencyBudgetUs;
+} Scenario;
+
+static const Scenario scenarios[] = {
+    { 1,  1000.0,     0.0 },
+    { 4, 10000.0, 20000.0 },
+    { 4, 10000.0,  2000.0 },
+    { 8,  6250.0,  1500.0 },
+    { 2, 25000.0,     0.0 },
+    { 1, 50000.0,  5000.0 }
+};
+
+#define NUM_SCENARIOS      (sizeof(scenarios)/sizeof(scenarios[0]))
+#define RESOLUTION_INDEX   1
+#define MAX_READ_SIZE      (LJUSB_STREAM_MAX_CHANNELS*64*256)
+
+static BYTE recBuff[MAX_READ_SIZE];
+static unsigned short codes[MAX_READ_SIZE];
+
+//Runs a planned stream on AIN0 to AIN(numChannels-1) for the given number of
+//seconds and prints the planned and measured values.  Returns 0, or -1 on
+//error.
+static long runPlan(HANDLE hDevice, const Scenario *s, const LJUSB_StreamPlan *plan, double seconds)
+{
+    LJUSB_StreamDecoder decoder;
+    uint8 channelNumbers[LJUSB_STREAM_MAX_CHANNELS], channelOptions[LJUSB_STREAM_MAX_CHANNELS];
+    unsigned long long startTime, timestampNs, firstSample, firstSampleNs;
+    unsigned long recChars, reads = 0;
+    double elapsed, ageUs, sumAgeUs = 0, maxAgeUs = 0;
+    long numScans, error = 0;
+    unsigned int i;
+
+    for( i = 0; i < s->numChannels; i++ )
+    {
+        channelNumbers[i] = i;
+        channelOptions[i] = 0;  //Gain x1, single-ended
+    }
+
+    ehStreamStop(hDevice);  //In case a previous program left a stream running
+    if( ehStreamConfig(hDevice, s->numChannels, RESOLUTION_INDEX, plan->samplesPerPacket, 0, plan->scanConfig, plan->scanInterval, channelNumbers, channelOptions) != 0 )
+        return -1;
+
+    if( LJUSB_StreamDecoderInit(&decoder, U6_PRODUCT_ID, s->numChannels, plan->samplesPerPacket, LJUSB_STREAM_OUTPUT_RAW16) != 0 )
+    {
+        printf("LJUSB_StreamDecoderInit error\n");
+        return -1;
+    }
+    LJUSB_StreamClockInit(&decoder.clock, plan->scanRate, LJUSB_STREAM_CLOCK_DEFAULT_FORGETTING);
+
+    startTime = LJUSB_GetTimestampNs();
+    if( ehStreamStart(hDevice) != 0 )
+        return -1;
+
+    do
+    {
+        recChars = LJUSB_StreamStampedTO(hDevice, recBuff, plan->readSize, 1000, &timestampNs);
+        if( recChars < plan->readSize )
+        {
+            printf("Error : read failed (%lu of %lu bytes)\n", recChars, plan->readSize);
+            error = -1;
+            break;
+        }
+
+        numScans = LJUSB_StreamDecodeStamped(&decoder, recBuff, recChars, timestampNs, codes, LJUSB_StreamMaxScans(&decoder, recChars));
+        if( numScans < 0 )
+        {
+            printf("LJUSB_StreamDecode error : errorcode %d\n", decoder.errorcode);
+            error = -1;
+            break;
+        }
+
+        firstSample = decoder.firstScanIndex*s->numChannels + decoder.firstChannel;
+        firstSampleNs = startTime + (unsigned long long)(firstSample*1.0e9/plan->sampleRate);
+        ageUs = (timestampNs > firstSampleNs) ? (timestampNs - firstSampleNs)/1.0e3 : 0;
+        sumAgeUs += ageUs;
+        if( ageUs > maxAgeUs )
+            maxAgeUs = ageUs;
+        reads++;
+
+        elapsed = (timestampNs - startTime)/1.0e9;
+    } while( elapsed < seconds );
+
+    ehStreamStop(hDevice);
+    if( error != 0 )
+        return error;
+
+    printf("  scan rate   planned %10.1f  measured %10.1f scans/s\n", plan->scanRate, LJUSB_StreamClockScanRate(&decoder.clock));
+    printf("  read rate   planned %10.1f  measured %10.1f reads/s\n", plan->readRate, reads/elapsed);
+    printf("  latency     planned %10.0f  measured %10.0f us mean, %.0f us max\n", plan->latencyUs, sumAgeUs/reads, maxAgeUs);
+    printf("  gaps %llu, dropped scans %llu\n", decoder.totalGaps, decoder.droppedScans);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    HANDLE hDevice;
+    LJUSB_StreamPlan plan;
+    double seconds = 2.0;
+    unsigned int i;
+
+    if( argc > 1 )
+        seconds = atof(argv[1]);
+    if( seconds <= 0 )
+    {
+        printf("Usage: %s [seconds per stream]\n", argv[0]);
+        return 1;
+    }
+
+    //Open first found U6 over USB
+    hDevice = openUSBConnection(-1);
+    if( hDevice == NULL )
+        return 1;
+
+    for( i = 0; i < NUM_SCENARIOS; i++ )
+    {
+        printf("%u channels at %.0f scans/s, latency budget ", scenarios[i].numChannels, scenarios[i].scanRate);
+        if( scenarios[i].latencyBudgetUs > 0 )
+            printf("%.0f us\n", scenarios[i].latencyBudgetUs);
+        else
+            printf("none\n");
+
+        if( LJUSB_StreamPlanCompute(U6_PRODUCT_ID, scenarios[i].numChannels, scenarios[i].scanRate, RESOLUTION_INDEX, scenarios[i].latencyBudgetUs, &plan) != 0 )
+        {
+            printf("  LJUSB_StreamPlanCompute error : %s\n", strerror(errno));
+            continue;
+        }
+
+        printf("  plan: ScanConfig 0x%02X, ScanInterval %u, SamplesPerPacket %u, %lu packets (%lu bytes) per read, %u transfers%s\n",
+               plan.scanConfig, plan.scanInterval, plan.samplesPerPacket, plan.packetsPerRead,
+               plan.readSize, plan.numTransfers, (plan.meetsLatency ? "" : ", budget not met"));
+
+        if( plan.readSize > MAX_READ_SIZE )
+        {
+            printf("  read size is too large for this program\n");
+            continue;
+        }
+
+        if( runPlan(hDevice, &scenarios[i], &plan, seconds) != 0 )
+            break;
+    }
+
+    closeUSBConnection(hDevice);
+    return 0;
+}
@@ -0,0 +1,270 @@
+//Author: LabJack
+//October 18, 2026
+//Reviews a window of a packed stream file (labjackpack.h), such as the ones
+//written by u6StreamPack: finds the chunks of the window in the file's index,
+//maps only those into memory and prints the minimum, maximum and mean volts of
+//each channel with the calibration of the file header.  For comparison, it
+//then finds the same window by reading the file from the start.  Pass the
+//file path (default u6stream.ljpk), the start of the window in seconds from
+//the start of the file (default the middle) and its length in seconds
+//(default 1).  "u6StreamReview -synthetic hours [file]" writes a synthetic
+//capture of that many hours of 4 channels at 12500 scans/s to try it on a
+//long file without a device.
+
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+#include <unistd.h>
+#include "u6.h"
+#include "labjackpack.h"
+
+typedef struct
+{
+    unsigned long long samples;
+    double min[LJUSB_STREAM_MAX_CHANNELS];
+    double max[LJUSB_STREAM_MAX_CHANNELS];
+    double sum[LJUSB_STREAM_MAX_CHANNELS];
+} WindowStats;
+
+static double getSeconds()
+{
+    return LJUSB_GetTimestampNs()/1.0e9;
+}
+
+static void resetStats(WindowStats *w, unsigned int numChannels)
+{
+    unsigned int i;
+
+    w->samples = 0;
+    for( i = 0; i < numChannels; i++ )
+    {
+        w->min[i] = INFINITY;
+        w->max[i] = -INFINITY;
+        w->sum[i] = 0;
+    }
+}
+
+//Adds the scans of a chunk that fall in [firstScan, endScan)
+static void addScans(WindowStats *w, const LJUSB_StreamPackHeader *header, const unsigned short *codes, unsigned long long chunkScan,
+                     long numScans, unsigned long long firstScan, unsigned long long endScan)
+{
+    double volts[LJUSB_STREAM_MAX_CHANNELS];
+    unsigned int i;
+    long s;
+
+    for( s = 0; s < numScans; s++ )
+    {
+        if( chunkScan + s < firstScan || chunkScan + s >= endScan )
+            continue;
+        LJUSB_StreamConvert(header->cal, header->numChannels, codes + s*header->numChannels, 1, volts, LJUSB_STREAM_OUTPUT_FLOAT64);
+        for( i = 0; i < header->numChannels; i++ )
+        {
+            if( volts[i] < w->min[i] )
+                w->min[i] = volts[i];
+            if( volts[i] > w->max[i] )
+                w->max[i] = volts[i];
+            w->sum[i] += volts[i];
+        }
+        w->samples++;
+    }
+}
+
+static void printStats(const WindowStats *w, const LJUSB_StreamPackHeader *header)
+{
+    unsigned int i;
+
+    for( i = 0; i < header->numChannels; i++ )
+        printf("  AIN%-3d min %8.4f  max %8.4f  mean %8.4f V\n", header->channelNumbers[i], w->min[i], w->max[i],
+               (w->samples > 0) ? w->sum[i]/w->samples : 0);
+}
+
+//Writes hours of a synthetic 4 channel capture: slow sines with a few LSBs of
+//noise, like the simulated U6
+static int writeSynthetic(const char *path, double hours)
+{
+    LJUSB_StreamPackHeader header;
+    LJUSB_StreamPackWriter *packWriter;
+    LJUSB_StreamPackStats stats;
+    static unsigned short codes[8192*4];
+    unsigned long long scan, numScans;
+    unsigned int noise = 1, i, c;
+    double start;
+
+    memset(&header, 0, sizeof(header));
+    header.productID = U6_PRODUCT_ID;
+    header.numChannels = 4;
+    header.scansPerChunk = 8192;
+    header.resolutionIndex = 1;
+    header.scanRate = 12500.0;
+    header.startTimeNs = LJUSB_GetTimestampNs();
+    for( i = 0; i < 4; i++ )
+    {
+        header.channelNumbers[i] = i;
+        header.cal[i].center = 32768;
+        header.cal[i].slopeBelow = 10.0/32768;
+        header.cal[i].slopeAbove = 10.0/32768;
+    }
+
+    //Synthetic data is not time critical, so the writer only needs a few
+    //buffers and the writes wait for room instead of dropping chunks
+    packWriter = LJUSB_StreamPackWriterOpen(path, &header, 4*1024*1024, 8, 0);
+    if( packWriter == NULL )
+    {
+        printf("LJUSB_StreamPackWriterOpen error : %s\n", strerror(errno));
+        return -1;
+    }
+
+    numScans = (unsigned long long)(hours*3600*header.scanRate);
+    start = getSeconds();
+    for( scan = 0; scan < numScans; scan += 8192 )
+    {
+        for( i = 0; i < 8192; i++ )
+        {
+            for( c = 0; c < 4; c++ )
+            {
+                noise = noise*1103515245u + 12345u;
+                codes[i*4 + c] = (unsigned short)(32768 + 15000*sin(2*M_PI*(c + 1)*0.1*(scan + i)/header.scanRate) + ((noise >> 16) & 7));
+            }
+        }
+        while( LJUSB_StreamPackWriterWrite(packWriter, scan, codes, (numScans - scan < 8192) ? (unsigned long)(numScans - scan) : 8192) < 0 )
+        {
+            if( errno != ENOBUFS )
+            {
+                printf("LJUSB_StreamPackWriterWrite error : %s\n", strerror(errno));
+                LJUSB_StreamPackWriterClose(packWriter, NULL);
+                return -1;
+            }
+            //The chunk was dropped, so write it again once there is room
+            usleep(1000);
+        }
+    }
+
+    if( LJUSB_StreamPackWriterClose(packWriter, &stats) != 0 )
+    {
+        printf("LJUSB_StreamPackWriterClose error : %s\n", strerror(errno));
+        return -1;
+    }
+    printf("Wrote %llu scans (%.1f hours) to %s: %.1f MB, %llu chunks, in %.1f s\n", numScans, hours, path,
+           stats.packedBytes/1.0e6, stats.chunks, getSeconds() - start);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    LJUSB_StreamPackHeader header;
+    LJUSB_StreamPackFileInfo info;
+    LJUSB_StreamPackFile *file;
+    LJUSB_StreamPackReader *reader;
+    LJUSB_StreamPackRegion region;
+    WindowStats stats;
+    unsigned short *codes = NULL;
+    const char *path = "u6stream.ljpk";
+    unsigned long long startNs, endNs, firstScan, endScan, chunkScan, lo, hi;
+    unsigned long i;
+    double fileSeconds, windowStart = -1, windowLength = 1.0, t0, openMs, indexedMs, sequentialMs;
+    long n;
+
+    if( argc > 2 && strcmp(argv[1], "-synthetic") == 0 )
+        return (writeSynthetic((argc > 3) ? argv[3] : path, atof(argv[2])) == 0) ? 0 : 1;
+
+    if( argc > 1 )
+        path = argv[1];
+    if( argc > 2 )
+        windowStart = atof(argv[2]);
+    if( argc > 3 )
+        windowLength = atof(argv[3]);
+    if( windowLength <= 0 )
+    {
+        printf("Usage: %s [file] [window start s] [window length s]\n       %s -synthetic hours [file]\n", argv[0], argv[0]);
+        return 1;
+    }
+
+    t0 = getSeconds();
+    file = LJUSB_StreamPackFileOpen(path, &header);
+    if( file == NULL )
+    {
+        printf("LJUSB_StreamPackFileOpen error : %s\n", strerror(errno));
+        return 1;
+    }
+    openMs = (getSeconds() - t0)*1000;
+    LJUSB_StreamPackFileGetInfo(file, &info);
+    fileSeconds = (info.endTimeNs - info.startTimeNs)/1.0e9;
+    printf("%s: %u channels at %.0f scans/s, %llu scans in %lu chunks, %.1f s%s\n", path, header.numChannels, header.scanRate,
+           info.numScans, info.numChunks, fileSeconds, (info.indexRebuilt ? " (index rebuilt from the chunks)" : ""));
+    printf("  opened with its index in %.2f ms\n", openMs);
+
+    if( windowStart < 0 )
+        windowStart = fileSeconds/2;
+    startNs = info.startTimeNs + (unsigned long long)(windowStart*1.0e9);
+    endNs = startNs + (unsigned long long)(windowLength*1.0e9);
+
+    codes = (unsigned short *)malloc((size_t)header.scansPerChunk*header.numChannels*sizeof(unsigned short));
+    if( codes == NULL )
+        goto done;
+
+    //Indexed: binary search for the window and map only its chunks.  The
+    //window in scans is found from the chunk times.
+    t0 = getSeconds();
+    if( LJUSB_StreamPackFileMapTime(file, startNs, endNs, &region) != 0 )
+    {
+        printf("LJUSB_StreamPackFileMapTime error : %s\n", strerror(errno));
+        goto done;
+    }
+    firstScan = endScan = 0;
+    resetStats(&stats, header.numChannels);
+    for( i = 0; i < region.numChunks; i++ )
+    {
+        n = LJUSB_StreamPackRegionUnpack(file, &region, i, codes, header.scansPerChunk, &chunkScan);
+        if( n < 0 )
+        {
+            printf("LJUSB_StreamPackRegionUnpack error : %s\n", strerror(errno));
+            break;
+        }
+        if( i == 0 )
+        {
+            //The first scan at or after startNs, by a binary search of the
+            //scan times of the first chunk
+            lo = chunkScan;
+            hi = chunkScan + n;
+            while( lo < hi )
+            {
+                firstScan = lo + (hi - lo)/2;
+                if( LJUSB_StreamPackFileScanTime(file, firstScan) < startNs )
+                    lo = firstScan + 1;
+                else
+                    hi = firstScan;
+            }
+            firstScan = lo;
+            endScan = firstScan + (unsigned long long)llround(windowLength*header.scanRate);
+        }
+        addScans(&stats, &header, codes, chunkScan, n, firstScan, endScan);
+    }
+    indexedMs = (getSeconds() - t0)*1000;
+    printf("Window %.3f s to %.3f s, scans %llu to %llu, %lu of %lu chunks mapped:\n", windowStart, windowStart + windowLength,
+           firstScan, endScan - 1, region.numChunks, info.numChunks);
+    LJUSB_StreamPackFileUnmap(&region);
+
+    printStats(&stats, &header);
+
+    //Sequential: read and unpack every chunk from the start of the file
+    t0 = getSeconds();
+    reader = LJUSB_StreamPackReaderOpen(path, &header);
+    if( reader == NULL )
+    {
+        printf("LJUSB_StreamPackReaderOpen error : %s\n", strerror(errno));
+        goto done;
+    }
+    resetStats(&stats, header.numChannels);
+    while( (n = LJUSB_StreamPackReaderRead(reader, codes, header.scansPerChunk, &chunkScan)) > 0 && chunkScan < endScan )
+        addScans(&stats, &header, codes, chunkScan, n, firstScan, endScan);
+    LJUSB_StreamPackReaderClose(reader);
+    sequentialMs = (getSeconds() - t0)*1000;
+
+    printf("Indexed seek and map: %8.2f ms\n", indexedMs);
+    printf("Sequential read:      %8.2f ms (%.0f times longer)\n", sequentialMs, sequentialMs/indexedMs);
+
+done:
+    free(codes);
+    LJUSB_StreamPackFileClose(file);
+    return 0;
+}
@@ -0,0 +1,272 @@
+//Author: LabJack
+//October 18, 2026
+//Shares one U6 stream with several processes through a shared memory stream
+//ring (labjackring.h).  "u6StreamShare publish [name] [seconds]" streams AIN0
+//to AIN3 at 12500 scans/s and publishes the scans to the ring (default name
+//u6stream, for 10 seconds).  "u6StreamShare read [name] [stall ms]" attaches
+//to the ring, reads the scans in place and prints once a second how far
+//behind the publisher it is and the scans it lost, stalling for the given
+//time after each read to play a slow consumer.  "u6StreamShare demo
+//[seconds]" forks a fast reader and a reader that stalls for longer than
+//the ring holds, then publishes: the publisher never waits for the readers,
+//and the slow one detects the scans it lost.
+//Build with "make SIM=1" to run against a simulated U6.
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "u6.h"
+#include "labjackring.h"
+
+#define NUM_CHANNELS      4
+#define SCAN_RATE         12500.0
+#define RESOLUTION_INDEX  1
+#define RING_CAPACITY     32768  //2.6 s of scans
+#define MAX_READ_SIZE     (64*256)
+
+static double getSeconds()
+{
+    return LJUSB_GetTimestampNs()/1.0e9;
+}
+
+//Streams for the given number of seconds and publishes the scans
+static int publish(const char *name, double seconds)
+{
+    HANDLE hDevice;
+    u6CalibrationInfo caliInfo;
+    LJUSB_StreamRingInfo info;
+    LJUSB_StreamRing *ring;
+    LJUSB_StreamPlan plan;
+    LJUSB_StreamDecoder decoder;
+    BYTE recBuff[MAX_READ_SIZE];
+    unsigned short codes[MAX_READ_SIZE];
+    unsigned long long timestampNs, publishNs = 0, publishes = 0, published = 0;
+    unsigned long recChars;
+    double start, lastPrint;
+    long n;
+    int i, ret = 1;
+
+    if( LJUSB_StreamPlanCompute(U6_PRODUCT_ID, NUM_CHANNELS, SCAN_RATE, RESOLUTION_INDEX, 0, &plan) != 0 ||
+        plan.readSize > MAX_READ_SIZE )
+    {
+        printf("LJUSB_StreamPlanCompute error\n");
+        return 1;
+    }
+
+    //Open first found U6 over USB
+    hDevice = openUSBConnection(-1);
+    if( hDevice == NULL )
+        return 1;
+
+    if( getCalibrationInfo(hDevice, &caliInfo) < 0 )
+        goto close;
+
+    //The readers convert the codes with the calibration in the ring
+    memset(&info, 0, sizeof(info));
+    info.productID = U6_PRODUCT_ID;
+    info.numChannels = NUM_CHANNELS;
+    info.capacity = RING_CAPACITY;
+    info.resolutionIndex = RESOLUTION_INDEX;
+    info.scanRate = plan.scanRate;
+    for( i = 0; i < NUM_CHANNELS; i++ )
+    {
+        info.channelNumbers[i] = i;
+        info.channelOptions[i] = 0;  //Gain x1, single-ended
+        if( getStreamCalibration(&caliInfo, RESOLUTION_INDEX, 0, &info.cal[i]) != 0 )
+            goto close;
+    }
+
+    ehStreamStop(hDevice);  //In case a previous program left a stream running
+    if( ehStreamConfig(hDevice, NUM_CHANNELS, RESOLUTION_INDEX, plan.samplesPerPacket, 0, plan.scanConfig, plan.scanInterval,
+                       info.channelNumbers, info.channelOptions) != 0 ||
+        LJUSB_StreamDecoderInit(&decoder, U6_PRODUCT_ID, NUM_CHANNELS, plan.samplesPerPacket, LJUSB_STREAM_OUTPUT_RAW16) != 0 ||
+        LJUSB_StreamDecoderSetGapFill(&decoder, 1, 32768) != 0 )
+        goto close;
+
+    info.startTimeNs = LJUSB_GetTimestampNs();
+    ring = LJUSB_StreamRingCreate(name, &info);
+    if( ring == NULL )
+    {
+        printf("LJUSB_StreamRingCreate error : %s\n", strerror(errno));
+        goto close;
+    }
+    if( ehStreamStart(hDevice) != 0 )
+    {
+        LJUSB_StreamRingDestroy(ring);
+        goto close;
+    }
+    printf("Publishing %d channels at %.0f scans/s to ring %s (%d scans)\n", NUM_CHANNELS, plan.scanRate, name, RING_CAPACITY);
+
+    start = lastPrint = getSeconds();
+    while( getSeconds() - start < seconds )
+    {
+        recChars = LJUSB_StreamStampedTO(hDevice, recBuff, plan.readSize, 1000, &timestampNs);
+        if( recChars < plan.readSize )
+        {
+            printf("Error : read failed (%lu of %lu bytes)\n", recChars, plan.readSize);
+            break;
+        }
+        n = LJUSB_StreamDecode(&decoder, recBuff, recChars, codes, MAX_READ_SIZE/NUM_CHANNELS);
+        if( n < 0 )
+        {
+            printf("LJUSB_StreamDecode error : errorcode %d\n", decoder.errorcode);
+            break;
+        }
+
+        timestampNs = LJUSB_GetTimestampNs();
+        if( LJUSB_StreamRingPublish(ring, codes, n) < 0 )
+        {
+            printf("LJUSB_StreamRingPublish error : %s\n", strerror(errno));
+            break;
+        }
+        publishNs += LJUSB_GetTimestampNs() - timestampNs;
+        publishes++;
+        published += n;
+
+        if( getSeconds() - lastPrint >= 1.0 )
+        {
+            printf("publisher : %llu scans, %.2f us per publish\n", published, publishNs/1.0e3/publishes);
+            lastPrint = getSeconds();
+        }
+    }
+    ehStreamStop(hDevice);
+
+    printf("publisher : done, %llu scans in %llu publishes, %.2f us per publish\n", published, publishes,
+           (publishes > 0) ? publishNs/1.0e3/publishes : 0);
+    LJUSB_StreamRingDestroy(ring);
+    ret = 0;
+
+close:
+    closeUSBConnection(hDevice);
+    return ret;
+}
+
+//Reads the ring until the publisher closes it, stalling for stallMs after
+//each read
+static int readRing(const char *name, const char *label, unsigned int stallMs)
+{
+    LJUSB_StreamRingInfo info;
+    LJUSB_StreamRingReader *reader;
+    LJUSB_StreamRingStatus status;
+    const unsigned short *scans;
+    unsigned long long seq, expected = 0, numRead = 0, skipped = 0;
+    double volts[NUM_CHANNELS], sum = 0, batchSum, start, lastPrint;
+    long n, s;
+    int tries;
+
+    //The publisher may not have created the ring yet
+    for( tries = 0; (reader = LJUSB_StreamRingAttach(name, &info, 0)) == NULL; tries++ )
+    {
+        if( errno != ENOENT || tries == 200 )
+        {
+            printf("%s : LJUSB_StreamRingAttach error : %s\n", label, strerror(errno));
+            return 1;
+        }
+        usleep(10000);
+    }
+    if( info.numChannels != NUM_CHANNELS )
+    {
+        printf("%s : ring has %u channels, expected %d\n", label, info.numChannels, NUM_CHANNELS);
+        LJUSB_StreamRingDetach(reader);
+        return 1;
+    }
+
+    //Every scan from here on is either read or counted as lost
+    LJUSB_StreamRingGetStatus(reader, &status);
+    expected = status.nextSeq;
+
+    start = lastPrint = getSeconds();
+    while( LJUSB_StreamRingWait(reader, 256, 1000) >= 0 )
+    {
+        //Use the scans in place, and discard them if the publisher overwrote
+        //them meanwhile
+        n = LJUSB_StreamRingPeek(reader, &scans, &seq);
+        if( n < 0 )
+        {
+            printf("%s : LJUSB_StreamRingPeek error : %s\n", label, strerror(errno));
+            break;
+        }
+        skipped += seq - expected;
+        expected = seq;
+        batchSum = 0;
+        for( s = 0; s < n; s++ )
+        {
+            LJUSB_StreamConvert(info.cal, NUM_CHANNELS, scans + s*NUM_CHANNELS, 1, volts, LJUSB_STREAM_OUTPUT_FLOAT64);
+            batchSum += volts[0];
+        }
+        if( stallMs > 0 )
+            usleep(stallMs*1000);
+        if( LJUSB_StreamRingRelease(reader, n) == 0 )
+        {
+            numRead += n;
+            sum += batchSum;
+            expected = seq + n;
+        }
+        else if( errno != EOVERFLOW )
+        {
+            printf("%s : LJUSB_StreamRingRelease error : %s\n", label, strerror(errno));
+            break;
+        }
+
+        if( getSeconds() - lastPrint >= 1.0 )
+        {
+            LJUSB_StreamRingGetStatus(reader, &status);
+            printf("%s : %llu scans read, lag %llu scans (%.1f ms), %llu lost in %llu overruns\n", label, numRead,
+                   status.lag, status.lag*1000.0/info.scanRate, status.lostScans, status.overruns);
+            lastPrint = getSeconds();
+        }
+    }
+
+    LJUSB_StreamRingGetStatus(reader, &status);
+    printf("%s : done, %llu scans read in %.1f s (mean AIN%d %.4f V), %llu lost in %llu overruns, sequence %s\n",
+           label, numRead, getSeconds() - start, info.channelNumbers[0], (numRead > 0) ? sum/numRead : 0,
+           status.lostScans, status.overruns, (skipped == status.lostScans) ? "consistent" : "INCONSISTENT");
+    LJUSB_StreamRingDetach(reader);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    const char *name = "u6stream";
+    double seconds = 10.0;
+    pid_t readers[2];
+    int i;
+
+    if( argc > 1 && strcmp(argv[1], "publish") == 0 )
+    {
+        if( argc > 2 )
+            name = argv[2];
+        if( argc > 3 )
+            seconds = atof(argv[3]);
+        return publish(name, seconds);
+    }
+    if( argc > 1 && strcmp(argv[1], "read") == 0 )
+    {
+        if( argc > 2 )
+            name = argv[2];
+        return readRing(name, "reader", (argc > 3) ? (unsigned int)atoi(argv[3]) : 0);
+    }
+    if( argc > 1 && strcmp(argv[1], "demo") == 0 )
+    {
+        if( argc > 2 )
+            seconds = atof(argv[2]);
+        fflush(stdout);
+        for( i = 0; i < 2; i++ )
+        {
+            readers[i] = fork();
+            if( readers[i] == 0 )
+                return (i == 0) ? readRing(name, "fast reader", 0) : readRing(name, "slow reader", 4000);
+        }
+        publish(name, seconds);
+        for( i = 0; i < 2; i++ )
+            if( readers[i] > 0 )
+                waitpid(readers[i], NULL, 0);
+        return 0;
+    }
+
+    printf("Usage: %s publish [name] [seconds]\n       %s read [name] [stall ms]\n       %s demo [seconds]\n",
+           argv[0], argv[0], argv[0]);
+    return 1;
+}
@@ -0,0 +1,182 @@
+//Author: LabJack
+//October 18, 2026
+//Streams AIN0 to AIN3 from a U6 at 12500 scans/s and prints the min, max,
+//mean, RMS and saturated samples of each channel once a second, computed by
+//the stream decoder in the pass that decodes the samples
+//(LJUSB_StreamDecoderSetStats).  Each read is also decoded without
+//statistics, and without statistics followed by a second pass over the volts
+//that computes them, to print what the statistics cost each way and check
+//that both agree.  Pass the number of seconds to stream as an argument
+//(default 5).  Build with "make SIM=1" to run against a simulated U6.
+
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+#include "u6.h"
+
+#define NUM_CHANNELS      4
+#define SCAN_RATE         12500.0
+#define RESOLUTION_INDEX  1
+#define MAX_READ_SIZE     (64*256)
+
+static double getSeconds()
+{
+    return LJUSB_GetTimestampNs()/1.0e9;
+}
+
+//The second pass the decoder statistics replace
+static void scanStats(const float *volts, long numScans, LJUSB_StreamChannelStats *stats)
+{
+    double v, sum[NUM_CHANNELS], sumSq[NUM_CHANNELS];
+    long s;
+    int i;
+
+    for( i = 0; i < NUM_CHANNELS; i++ )
+    {
+        stats[i].min = INFINITY;
+        stats[i].max = -INFINITY;
+        sum[i] = sumSq[i] = 0;
+    }
+    for( s = 0; s < numScans; s++ )
+    {
+        for( i = 0; i < NUM_CHANNELS; i++ )
+        {
+            v = volts[s*NUM_CHANNELS + i];
+            if( v < stats[i].min )
+                stats[i].min = v;
+            if( v > stats[i].max )
+                stats[i].max = v;
+            sum[i] += v;
+            sumSq[i] += v*v;
+        }
+    }
+    for( i = 0; i < NUM_CHANNELS; i++ )
+    {
+        stats[i].mean = sum[i]/numScans;
+        stats[i].rms = sqrt(sumSq[i]/numScans);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    HANDLE hDevice;
+    u6CalibrationInfo caliInfo;
+    LJUSB_StreamPlan plan;
+    LJUSB_StreamDecoder decoders[3];  //Without statistics, with, and with a second pass
+    LJUSB_StreamChannelCal cal;
+    LJUSB_StreamChannelStats stats[NUM_CHANNELS], passStats[NUM_CHANNELS];
+    BYTE recBuff[MAX_READ_SIZE];
+    float volts[MAX_READ_SIZE];
+    uint8 channelNumbers[NUM_CHANNELS], channelOptions[NUM_CHANNELS];
+    unsigned long long ns[3] = {0, 0, 0}, startNs, reads = 0, mismatches = 0;
+    unsigned long recChars;
+    double seconds = 5, start, lastPrint;
+    long n = 0;
+    int d, i, ret = 1;
+
+    if( argc > 1 )
+        seconds = atof(argv[1]);
+
+    if( LJUSB_StreamPlanCompute(U6_PRODUCT_ID, NUM_CHANNELS, SCAN_RATE, RESOLUTION_INDEX, 0, &plan) != 0 ||
+        plan.readSize > MAX_READ_SIZE )
+    {
+        printf("LJUSB_StreamPlanCompute error\n");
+        return 1;
+    }
+
+    //Open first found U6 over USB
+    hDevice = openUSBConnection(-1);
+    if( hDevice == NULL )
+        return 1;
+
+    if( getCalibrationInfo(hDevice, &caliInfo) < 0 )
+        goto close;
+    for( d = 0; d < 3; d++ )
+    {
+        if( LJUSB_StreamDecoderInit(&decoders[d], U6_PRODUCT_ID, NUM_CHANNELS, plan.samplesPerPacket, LJUSB_STREAM_OUTPUT_FLOAT32) != 0 )
+            goto close;
+        for( i = 0; i < NUM_CHANNELS; i++ )
+        {
+            if( getStreamCalibration(&caliInfo, RESOLUTION_INDEX, 0, &cal) != 0 ||
+                LJUSB_StreamDecoderSetCal(&decoders[d], i, &cal) != 0 )
+                goto close;
+        }
+    }
+    if( LJUSB_StreamDecoderSetStats(&decoders[1], 1, 0, 65535) != 0 )
+    {
+        printf("LJUSB_StreamDecoderSetStats error : %s\n", strerror(errno));
+        goto close;
+    }
+
+    for( i = 0; i < NUM_CHANNELS; i++ )
+    {
+        channelNumbers[i] = i;
+        channelOptions[i] = 0;  //Gain x1, single-ended
+    }
+    ehStreamStop(hDevice);  //In case a previous program left a stream running
+    if( ehStreamConfig(hDevice, NUM_CHANNELS, RESOLUTION_INDEX, plan.samplesPerPacket, 0, plan.scanConfig, plan.scanInterval,
+                       channelNumbers, channelOptions) != 0 ||
+        ehStreamStart(hDevice) != 0 )
+        goto close;
+
+    start = lastPrint = getSeconds();
+    while( getSeconds() - start < seconds )
+    {
+        recChars = LJUSB_Stream(hDevice, recBuff, plan.readSize);
+        if( recChars < plan.readSize )
+        {
+            printf("Error : read failed (%lu of %lu bytes)\n", recChars, plan.readSize);
+            break;
+        }
+
+        for( d = 0; d < 3; d++ )
+        {
+            startNs = LJUSB_GetTimestampNs();
+            n = LJUSB_StreamDecode(&decoders[d], recBuff, recChars, volts, MAX_READ_SIZE/NUM_CHANNELS);
+            if( n > 0 && d == 2 )
+                scanStats(volts, n, passStats);
+            ns[d] += LJUSB_GetTimestampNs() - startNs;
+            if( n < 0 )
+            {
+                printf("LJUSB_StreamDecode error : errorcode %d\n", decoders[d].errorcode);
+                goto stop;
+            }
+        }
+        reads++;
+
+        //The decoder also counts the samples of a scan split across reads, so
+        //only the reads of whole scans are compared
+        LJUSB_StreamDecoderGetStats(&decoders[1], stats);
+        for( i = 0; i < NUM_CHANNELS && (long long)stats[i].count == n; i++ )
+        {
+            if( fabs(stats[i].mean - passStats[i].mean) > 1e-4 || fabs(stats[i].rms - passStats[i].rms) > 1e-4 ||
+                fabs(stats[i].min - passStats[i].min) > 1e-4 || fabs(stats[i].max - passStats[i].max) > 1e-4 )
+            {
+                mismatches++;
+                break;
+            }
+        }
+
+        if( getSeconds() - lastPrint >= 1.0 )
+        {
+            for( i = 0; i < NUM_CHANNELS; i++ )
+                printf("AIN%d: %llu samples, min %.4f V, max %.4f V, mean %.4f V, RMS %.4f V, %llu saturated\n", i,
+                       stats[i].count, stats[i].min, stats[i].max, stats[i].mean, stats[i].rms, stats[i].saturated);
+            lastPrint = getSeconds();
+        }
+    }
+
+    if( reads > 0 )
+    {
+        printf("\nDecode time per read: %.1f us without statistics, %.1f us with, %.1f us with a second pass\n",
+               ns[0]/1.0e3/reads, ns[1]/1.0e3/reads, ns[2]/1.0e3/reads);
+        printf("%llu reads, %llu with statistics that differ from the second pass\n", reads, mismatches);
+    }
+    ret = 0;
+
+stop:
+    ehStreamStop(hDevice);
+close:
+    closeUSBConnection(hDevice);
+    return ret;
+}
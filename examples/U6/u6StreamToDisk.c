@@ -0,0 +1,279 @@
+//Author: LabJack
+//October 18, 2026
+//Streams every connected U6 at its maximum rate (50000 samples/s, AIN0 at
+//ResolutionIndex 1) and writes the raw codes of each to its own file with a
+//labjackwriter.h stream writer, one reading thread per device.  Then measures
+//how fast the writers can go with the same settings and no devices, to show
+//the headroom of the disk.  Prints, for each device, the data written and
+//dropped, the writer queue depth, the write times and the longest time the
+//reading thread spent handing data to the writer.  Pass the directory for the
+//files (default the current directory), the number of seconds to stream
+//(default 10) and "direct" to bypass the page cache.  Build with "make SIM=1"
+//and set LJSIM_DEVICES (for example "U6,U6,U6,U6") to run against simulated
+//U6s.
+
+#include <errno.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "u6.h"
+#include "labjackwriter.h"
+
+#define MAX_DEVICES       16
+#define SCAN_RATE         50000.0
+#define RESOLUTION_INDEX  1
+#define BUFFER_SIZE       (1024*1024)
+#define NUM_BUFFERS       32
+#define MAX_READ_SIZE     (64*256)
+
+typedef struct
+{
+    HANDLE hDevice;
+    int index;
+    char path[1024];
+    double seconds;
+    int options;
+
+    //Results
+    int error;
+    unsigned long long scans;
+    unsigned long long totalGaps;
+    double maxHandOffUs;
+    double elapsed;
+    LJUSB_StreamWriterStats stats;
+} DeviceTest;
+
+static double getSeconds()
+{
+    return LJUSB_GetTimestampNs()/1.0e9;
+}
+
+//Streams one device to its writer for test->seconds
+static void *streamThread(void *arg)
+{
+    DeviceTest *test = (DeviceTest *)arg;
+    LJUSB_StreamPlan plan;
+    LJUSB_StreamDecoder decoder;
+    LJUSB_StreamWriter *writer;
+    BYTE recBuff[MAX_READ_SIZE];
+    unsigned short codes[MAX_READ_SIZE/2];
+    uint8 channelNumbers[1] = {0}, channelOptions[1] = {0};
+    unsigned long recChars;
+    long numScans;
+    double start, t0, handOffUs;
+
+    test->error = -1;
+    if( LJUSB_StreamPlanCompute(U6_PRODUCT_ID, 1, SCAN_RATE, RESOLUTION_INDEX, 0, &plan) != 0 ||
+        plan.readSize > MAX_READ_SIZE )
+    {
+        printf("U6 %d: LJUSB_StreamPlanCompute error\n", test->index);
+        return NULL;
+    }
+
+    writer = LJUSB_StreamWriterOpen(test->path, BUFFER_SIZE, NUM_BUFFERS, (unsigned long long)(SCAN_RATE*2*(test->seconds + 1)), test->options);
+    if( writer == NULL )
+    {
+        printf("U6 %d: LJUSB_StreamWriterOpen error : %s\n", test->index, strerror(errno));
+        return NULL;
+    }
+
+    ehStreamStop(test->hDevice);  //In case a previous program left a stream running
+    if( ehStreamConfig(test->hDevice, 1, RESOLUTION_INDEX, plan.samplesPerPacket, 0, plan.scanConfig, plan.scanInterval, channelNumbers, channelOptions) != 0 ||
+        LJUSB_StreamDecoderInit(&decoder, U6_PRODUCT_ID, 1, plan.samplesPerPacket, LJUSB_STREAM_OUTPUT_RAW16) != 0 ||
+        ehStreamStart(test->hDevice) != 0 )
+    {
+        LJUSB_StreamWriterClose(writer, NULL);
+        return NULL;
+    }
+
+    test->error = 0;
+    start = getSeconds();
+    do
+    {
+        recChars = LJUSB_Stream(test->hDevice, recBuff, plan.readSize);
+        if( recChars < plan.readSize )
+        {
+            printf("U6 %d: read failed (%lu of %lu bytes)\n", test->index, recChars, plan.readSize);
+            test->error = -1;
+            break;
+        }
+
+        numScans = LJUSB_StreamDecode(&decoder, recBuff, recChars, codes, LJUSB_StreamMaxScans(&decoder, recChars));
+        if( numScans < 0 )
+        {
+            printf("U6 %d: LJUSB_StreamDecode error : errorcode %d\n", test->index, decoder.errorcode);
+            test->error = -1;
+            break;
+        }
+
+        //Data that does not fit is counted by the writer, so errors are
+        //only checked at the end
+        t0 = getSeconds();
+        LJUSB_StreamWriterWrite(writer, codes, numScans*sizeof(unsigned short));
+        handOffUs = (getSeconds() - t0)*1.0e6;
+        if( handOffUs > test->maxHandOffUs )
+            test->maxHandOffUs = handOffUs;
+
+        test->elapsed = getSeconds() - start;
+    } while( test->elapsed < test->seconds );
+
+    ehStreamStop(test->hDevice);
+    test->scans = decoder.scanIndex;
+    test->totalGaps = decoder.totalGaps;
+    if( LJUSB_StreamWriterClose(writer, &test->stats) != 0 )
+    {
+        printf("U6 %d: LJUSB_StreamWriterClose error : %s\n", test->index, strerror(errno));
+        test->error = -1;
+    }
+    return NULL;
+}
+
+//Writes synthetic data to the writer as fast as it is accepted
+static void *headroomThread(void *arg)
+{
+    DeviceTest *test = (DeviceTest *)arg;
+    LJUSB_StreamWriter *writer;
+    unsigned short codes[MAX_READ_SIZE/2];
+    LJUSB_StreamWriterStats stats;
+    double start;
+    unsigned int i;
+
+    for( i = 0; i < MAX_READ_SIZE/2; i++ )
+        codes[i] = (unsigned short)(32768 + i);
+
+    test->error = -1;
+    writer = LJUSB_StreamWriterOpen(test->path, BUFFER_SIZE, NUM_BUFFERS, 0, test->options);
+    if( writer == NULL )
+    {
+        printf("Writer %d: LJUSB_StreamWriterOpen error : %s\n", test->index, strerror(errno));
+        return NULL;
+    }
+
+    //Keeps the queue full without dropping data
+    test->error = 0;
+    start = getSeconds();
+    do
+    {
+        LJUSB_StreamWriterGetStats(writer, &stats);
+        if( stats.queueDepth < NUM_BUFFERS - 2 )
+            LJUSB_StreamWriterWrite(writer, codes, sizeof(codes));
+        else
+            usleep(100);
+        test->elapsed = getSeconds() - start;
+    } while( test->elapsed < test->seconds );
+
+    if( LJUSB_StreamWriterClose(writer, &test->stats) != 0 )
+    {
+        printf("Writer %d: LJUSB_StreamWriterClose error : %s\n", test->index, strerror(errno));
+        test->error = -1;
+    }
+    test->elapsed = getSeconds() - start;
+    return NULL;
+}
+
+static void printStats(const char *name, const DeviceTest *test)
+{
+    const LJUSB_StreamWriterStats *s = &test->stats;
+    const LJUSB_StreamAgeStats *w = &s->writeLatency;
+
+    printf("%-9s %8.2f MB/s  %7.1f MB written  %llu bytes dropped  queue max %u/%u  write p50 %.0f p99 %.0f max %.0f us%s%s\n",
+           name, s->bytesWritten/test->elapsed/1.0e6, s->bytesWritten/1.0e6, s->bytesDropped,
+           s->maxQueueDepth, s->numBuffers, LJUSB_StreamAgeStatsPercentile(w, 50),
+           LJUSB_StreamAgeStatsPercentile(w, 99), w->maxUs,
+           (s->direct ? ", direct" : ""), (s->preallocated ? ", preallocated" : ""));
+}
+
+static int runThreads(DeviceTest *tests, int numTests, void *(*fn)(void *))
+{
+    pthread_t threads[MAX_DEVICES];
+    int i;
+
+    for( i = 0; i < numTests; i++ )
+    {
+        if( pthread_create(&threads[i], NULL, fn, &tests[i]) != 0 )
+        {
+            printf("pthread_create error\n");
+            numTests = i;
+            break;
+        }
+    }
+    for( i = 0; i < numTests; i++ )
+        pthread_join(threads[i], NULL);
+    return numTests;
+}
+
+int main(int argc, char **argv)
+{
+    static DeviceTest tests[MAX_DEVICES];
+    const char *directory = ".";
+    double seconds = 10.0;
+    int options = 0, numDevices, i;
+    char name[32];
+
+    if( argc > 1 )
+        directory = argv[1];
+    if( argc > 2 )
+        seconds = atof(argv[2]);
+    if( argc > 3 && strcmp(argv[3], "direct") == 0 )
+        options = LJUSB_WRITER_DIRECT;
+    if( seconds <= 0 )
+    {
+        printf("Usage: %s [directory] [seconds] [direct]\n", argv[0]);
+        return 1;
+    }
+
+    numDevices = LJUSB_GetDevCount(U6_PRODUCT_ID);
+    if( numDevices > MAX_DEVICES )
+        numDevices = MAX_DEVICES;
+    if( numDevices == 0 )
+    {
+        printf("No U6 found\n");
+        return 1;
+    }
+
+    for( i = 0; i < numDevices; i++ )
+    {
+        tests[i].index = i + 1;
+        tests[i].seconds = seconds;
+        tests[i].options = options;
+        snprintf(tests[i].path, sizeof(tests[i].path), "%s/u6stream%d.bin", directory, i + 1);
+        tests[i].hDevice = LJUSB_OpenDevice(i + 1, 0, U6_PRODUCT_ID);
+        if( tests[i].hDevice == NULL )
+        {
+            printf("Couldn't open U6 %d. Please connect one and try again.\n", i + 1);
+            numDevices = i;
+            break;
+        }
+    }
+
+    printf("Streaming %d U6 at %.0f samples/s each for %.0f s\n", numDevices, SCAN_RATE, seconds);
+    runThreads(tests, numDevices, streamThread);
+    for( i = 0; i < numDevices; i++ )
+    {
+        LJUSB_CloseDevice(tests[i].hDevice);
+        if( tests[i].error != 0 )
+            continue;
+        snprintf(name, sizeof(name), "U6 %d", tests[i].index);
+        printStats(name, &tests[i]);
+        printf("          %llu scans, %llu gaps, longest hand-off to the writer %.1f us\n",
+               tests[i].scans, tests[i].totalGaps, tests[i].maxHandOffUs);
+    }
+
+    printf("Writer headroom: %d writers without devices for %.0f s\n", numDevices, seconds);
+    for( i = 0; i < numDevices; i++ )
+    {
+        memset(&tests[i].stats, 0, sizeof(tests[i].stats));
+        snprintf(tests[i].path, sizeof(tests[i].path), "%s/u6headroom%d.bin", directory, i + 1);
+    }
+    runThreads(tests, numDevices, headroomThread);
+    for( i = 0; i < numDevices; i++ )
+    {
+        if( tests[i].error != 0 )
+            continue;
+        snprintf(name, sizeof(name), "Writer %d", tests[i].index);
+        printStats(name, &tests[i]);
+        remove(tests[i].path);
+    }
+
+    return 0;
+}
@@ -0,0 +1,236 @@
+//Author: LabJack
+//October 18, 2026
+//Captures stream data around a trigger with labjacktrigger.h.  First the
+//cost of the trigger search is measured on one core with generated scans,
+//as the sample rate it sustains and the share of a core it takes at the U6
+//maximum stream rate (50 ksamples/s).  Then AIN0 to AIN3 are streamed at
+//12500 scans/s with a rising edge trigger on AIN3 at 0 V (0.1 V of
+//hysteresis), and each capture of 0.2 s before and 0.2 s after the trigger
+//is printed with the time the trigger search takes per read.  Pass the
+//number of seconds to stream as an argument (default 5).  Build with
+//"make SIM=1" to run against a simulated U6, whose AIN3 is a 0.4 Hz sine.
+
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+#include "u6.h"
+#include "labjacktrigger.h"
+
+#define NUM_CHANNELS       4
+#define SCAN_RATE          12500.0
+#define RESOLUTION_INDEX   1
+#define MAX_READ_SIZE      (64*256)
+#define TRIGGER_CHANNEL    3
+#define PRE_SCANS          2500
+#define POST_SCANS         2500
+#define BENCH_BLOCK        1250   //Scans per LJUSB_StreamTriggerProcess call
+#define BENCH_SCANS        (1 << 22)
+#define U6_MAX_SAMPLE_RATE 50000.0
+
+static double getSeconds()
+{
+    return LJUSB_GetTimestampNs()/1.0e9;
+}
+
+static void benchCallback(const float *pScans, unsigned long numScans, unsigned long triggerScan,
+                          unsigned long long triggerIndex, void *userData)
+{
+    (*(unsigned long *)userData)++;
+}
+
+//Searches BENCH_SCANS generated scans of the given number of channels, and
+//returns the samples per second, or -1 on error
+static double benchmarkTrigger(unsigned int numChannels, double *capturesPerSecond)
+{
+    LJUSB_StreamTriggerConfig config;
+    LJUSB_StreamTrigger *trigger;
+    float *scans;
+    unsigned long i, captures = 0;
+    unsigned int c;
+    double start, elapsed;
+
+    scans = (float *)malloc((size_t)BENCH_SCANS*numChannels*sizeof(float));
+    if( scans == NULL )
+        return -1;
+
+    //A sine with a period of 10000 scans and some noise on every channel
+    srand(1);
+    for( i = 0; i < BENCH_SCANS; i++ )
+        for( c = 0; c < numChannels; c++ )
+            scans[i*numChannels + c] = (float)(sin(2*M_PI*i/10000.0) + (rand()/(double)RAND_MAX - 0.5)*0.05);
+
+    memset(&config, 0, sizeof(config));
+    config.type = LJUSB_TRIGGER_EDGE;
+    config.direction = LJUSB_TRIGGER_RISING;
+    config.channel = numChannels - 1;
+    config.bit = -1;
+    config.level = 0;
+    config.hysteresis = 0.1;
+    config.preScans = PRE_SCANS;
+    config.postScans = POST_SCANS;
+    trigger = LJUSB_StreamTriggerCreate(numChannels, &config, benchCallback, &captures);
+    if( trigger == NULL )
+    {
+        printf("LJUSB_StreamTriggerCreate error : %s\n", strerror(errno));
+        free(scans);
+        return -1;
+    }
+
+    start = getSeconds();
+    for( i = 0; i < BENCH_SCANS; i += BENCH_BLOCK )
+        LJUSB_StreamTriggerProcess(trigger, scans + i*numChannels, (BENCH_SCANS - i < BENCH_BLOCK) ? BENCH_SCANS - i : BENCH_BLOCK);
+    elapsed = getSeconds() - start;
+
+    *capturesPerSecond = captures/elapsed;
+    LJUSB_StreamTriggerDestroy(trigger);
+    free(scans);
+    return (double)BENCH_SCANS*numChannels/elapsed;
+}
+
+static void captureCallback(const float *pScans, unsigned long numScans, unsigned long triggerScan,
+                            unsigned long long triggerIndex, void *userData)
+{
+    double before = INFINITY, after = -INFINITY;
+    unsigned long i;
+
+    //The trigger channel is below the level before the trigger and rises
+    //above it after
+    for( i = 0; i < numScans; i++ )
+    {
+        if( i < triggerScan && pScans[i*NUM_CHANNELS + TRIGGER_CHANNEL] < before )
+            before = pScans[i*NUM_CHANNELS + TRIGGER_CHANNEL];
+        if( i >= triggerScan && pScans[i*NUM_CHANNELS + TRIGGER_CHANNEL] > after )
+            after = pScans[i*NUM_CHANNELS + TRIGGER_CHANNEL];
+    }
+    printf("Trigger at scan %llu (%.3f s): %lu scans before, %lu after, AIN%d %.4f V at the trigger, min before %.4f V, max after %.4f V\n",
+           triggerIndex, triggerIndex/SCAN_RATE, triggerScan, numScans - triggerScan, TRIGGER_CHANNEL,
+           pScans[triggerScan*NUM_CHANNELS + TRIGGER_CHANNEL], before, after);
+}
+
+//Streams with a trigger searched in the reading loop
+static int streamTriggered(double seconds)
+{
+    HANDLE hDevice;
+    u6CalibrationInfo caliInfo;
+    LJUSB_StreamPlan plan;
+    LJUSB_StreamDecoder decoder;
+    LJUSB_StreamChannelCal cal;
+    LJUSB_StreamTriggerConfig config;
+    LJUSB_StreamTrigger *trigger;
+    BYTE recBuff[MAX_READ_SIZE];
+    float volts[MAX_READ_SIZE];
+    uint8 channelNumbers[NUM_CHANNELS], channelOptions[NUM_CHANNELS];
+    unsigned long long reads = 0, startNs, ns, triggerNs = 0, maxTriggerNs = 0;
+    unsigned long recChars;
+    double start;
+    long n;
+    int i, ret = 1;
+
+    if( LJUSB_StreamPlanCompute(U6_PRODUCT_ID, NUM_CHANNELS, SCAN_RATE, RESOLUTION_INDEX, 0, &plan) != 0 ||
+        plan.readSize > MAX_READ_SIZE )
+    {
+        printf("LJUSB_StreamPlanCompute error\n");
+        return 1;
+    }
+
+    memset(&config, 0, sizeof(config));
+    config.type = LJUSB_TRIGGER_EDGE;
+    config.direction = LJUSB_TRIGGER_RISING;
+    config.channel = TRIGGER_CHANNEL;
+    config.bit = -1;
+    config.level = 0;
+    config.hysteresis = 0.1;
+    config.preScans = PRE_SCANS;
+    config.postScans = POST_SCANS;
+    config.holdoffScans = 0;
+    trigger = LJUSB_StreamTriggerCreate(NUM_CHANNELS, &config, captureCallback, NULL);
+    if( trigger == NULL )
+    {
+        printf("LJUSB_StreamTriggerCreate error : %s\n", strerror(errno));
+        return 1;
+    }
+
+    //Open first found U6 over USB
+    hDevice = openUSBConnection(-1);
+    if( hDevice == NULL )
+        goto destroy;
+
+    if( getCalibrationInfo(hDevice, &caliInfo) < 0 ||
+        LJUSB_StreamDecoderInit(&decoder, U6_PRODUCT_ID, NUM_CHANNELS, plan.samplesPerPacket, LJUSB_STREAM_OUTPUT_FLOAT32) != 0 )
+        goto close;
+    for( i = 0; i < NUM_CHANNELS; i++ )
+    {
+        channelNumbers[i] = i;
+        channelOptions[i] = 0;  //Gain x1, single-ended
+        if( getStreamCalibration(&caliInfo, RESOLUTION_INDEX, 0, &cal) != 0 ||
+            LJUSB_StreamDecoderSetCal(&decoder, i, &cal) != 0 )
+            goto close;
+    }
+
+    ehStreamStop(hDevice);  //In case a previous program left a stream running
+    if( ehStreamConfig(hDevice, NUM_CHANNELS, RESOLUTION_INDEX, plan.samplesPerPacket, 0, plan.scanConfig, plan.scanInterval,
+                       channelNumbers, channelOptions) != 0 ||
+        ehStreamStart(hDevice) != 0 )
+        goto close;
+
+    printf("\nStreaming %d channels at %.0f scans/s, rising edge trigger on AIN%d at 0 V\n", NUM_CHANNELS, plan.scanRate,
+           TRIGGER_CHANNEL);
+    start = getSeconds();
+    while( getSeconds() - start < seconds )
+    {
+        recChars = LJUSB_Stream(hDevice, recBuff, plan.readSize);
+        if( recChars < plan.readSize )
+        {
+            printf("Error : read failed (%lu of %lu bytes)\n", recChars, plan.readSize);
+            break;
+        }
+        n = LJUSB_StreamDecode(&decoder, recBuff, recChars, volts, MAX_READ_SIZE/NUM_CHANNELS);
+        if( n < 0 )
+        {
+            printf("LJUSB_StreamDecode error : errorcode %d\n", decoder.errorcode);
+            break;
+        }
+
+        startNs = LJUSB_GetTimestampNs();
+        LJUSB_StreamTriggerProcess(trigger, volts, n);
+        ns = LJUSB_GetTimestampNs() - startNs;
+        triggerNs += ns;
+        if( ns > maxTriggerNs )
+            maxTriggerNs = ns;
+        reads++;
+    }
+    ehStreamStop(hDevice);
+
+    if( reads > 0 )
+        printf("%llu triggers, trigger time per read: mean %.1f us, max %.1f us (including the callbacks)\n",
+               LJUSB_StreamTriggerCount(trigger), triggerNs/1.0e3/reads, maxTriggerNs/1.0e3);
+    ret = 0;
+
+close:
+    closeUSBConnection(hDevice);
+destroy:
+    LJUSB_StreamTriggerDestroy(trigger);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    static const unsigned int channels[] = {1, 4, 16};
+    double seconds = 5, rate, captures;
+    unsigned int c;
+
+    if( argc > 1 )
+        seconds = atof(argv[1]);
+
+    printf("Rising edge trigger search with %d pre-trigger and %d post-trigger scans, on one core\n", PRE_SCANS, POST_SCANS);
+    for( c = 0; c < sizeof(channels)/sizeof(channels[0]); c++ )
+    {
+        rate = benchmarkTrigger(channels[c], &captures);
+        if( rate < 0 )
+            return 1;
+        printf("%2u channels: %7.1f Msamples/s, %.3f%% of a core at %.0f ksamples/s (%.0f captures/s)\n", channels[c],
+               rate/1.0e6, 100*U6_MAX_SAMPLE_RATE/rate, U6_MAX_SAMPLE_RATE/1000, captures);
+    }
+
+    return streamTriggered(seconds);
+}
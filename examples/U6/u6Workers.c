@@ -0,0 +1,237 @@
+//Author: LabJack
+//October 18, 2026
+//Reads AIN0 to AIN3 of every U6 connected with a Feedback command, first
+//one device after the other from the main thread, then with a device worker
+//of labjackworker.h for each U6:  the main thread submits a command to every
+//worker and waits for all of them, so the round trips of the devices
+//overlap.  For each run the rounds per second (a Feedback command to every
+//U6) are printed, and for the workers the queue time and round trip
+//percentiles of each device.  The workers are pinned to the CPUs in turn.
+//Pass the number of seconds of each run as an argument (default 2).  Build
+//with "make SIM=1" to run against simulated U6s, for example with
+//LJSIM_DEVICES=U6,U6,U6,U6, and set LJSIM_LATENCY_US to add a USB round
+//trip time.
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include "u6.h"
+#include "labjackworker.h"
+
+#define MAX_DEVICES       16
+#define NUM_CHANNELS      4
+#define RESOLUTION_INDEX  1
+#define GAIN_INDEX        0
+
+typedef struct
+{
+    HANDLE hDevice;
+    u6CalibrationInfo caliInfo;
+    u6PreparedFeedback feedback;
+    LJUSB_DeviceWorker *worker;
+    LJUSB_WorkerCommand command;
+    double volts[NUM_CHANNELS];
+} Device;
+
+static Device devices[MAX_DEVICES];
+static int numDevices = 0;
+
+static double getSeconds()
+{
+    return LJUSB_GetTimestampNs()/1.0e9;
+}
+
+//Checks a Feedback response and converts its AIN24 readings.  Returns -1 on
+//error.
+static int convertResponse(Device *dev, const uint8 *recBuff, long recChars)
+{
+    uint16 checksumTotal;
+    uint32 bytesV;
+    int i;
+
+    if( recChars < dev->feedback.recSize )
+        return -1;
+    checksumTotal = extendedChecksum16((uint8 *)recBuff, recChars);
+    if( (uint8)((checksumTotal / 256) & 0xff) != recBuff[5] || (uint8)(checksumTotal & 0xff) != recBuff[4] ||
+        extendedChecksum8((uint8 *)recBuff) != recBuff[0] || recBuff[6] != 0 )
+        return -1;
+
+    for( i = 0; i < NUM_CHANNELS; i++ )
+    {
+        bytesV = recBuff[9 + i*3] + ((uint32)recBuff[10 + i*3])*256 + ((uint32)recBuff[11 + i*3])*65536;
+        getAinVoltCalibrated(&dev->caliInfo, RESOLUTION_INDEX, GAIN_INDEX, 1, bytesV, &dev->volts[i]);
+    }
+    return 0;
+}
+
+//Sends the Feedback commands of the devices one after the other.  Returns -1
+//on error.
+static int sequentialRun(double seconds)
+{
+    unsigned long long rounds = 0;
+    uint8 errorcode, errorFrame;
+    double start, elapsed;
+    int d;
+
+    start = getSeconds();
+    do
+    {
+        for( d = 0; d < numDevices; d++ )
+        {
+            if( ehFeedbackExecute(devices[d].hDevice, &devices[d].feedback, &errorcode, &errorFrame, NULL) < 0 )
+                return -1;
+            if( convertResponse(&devices[d], devices[d].feedback.recBuff, devices[d].feedback.recSize) < 0 )
+            {
+                printf("Feedback error : bad response (errorcode %d)\n", errorcode);
+                return -1;
+            }
+        }
+        rounds++;
+        elapsed = getSeconds() - start;
+    } while( elapsed < seconds );
+
+    printf("%-22s %8.1f rounds/s\n", "one after the other", rounds/elapsed);
+    return 0;
+}
+
+//Submits the Feedback command of every device to its worker and waits for
+//them.  Returns -1 on error.
+static int workerRun(double seconds)
+{
+    LJUSB_WorkerStats stats;
+    unsigned long long rounds = 0;
+    double start, elapsed;
+    long numCpus;
+    int d, ret = 0;
+
+    numCpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if( numCpus < 1 )
+        numCpus = 1;
+
+    for( d = 0; d < numDevices; d++ )
+    {
+        devices[d].worker = LJUSB_WorkerStart(devices[d].hDevice, d % numCpus, 0);
+        if( devices[d].worker == NULL )
+        {
+            printf("LJUSB_WorkerStart error : %s\n", strerror(errno));
+            while( --d >= 0 )
+                LJUSB_WorkerStop(devices[d].worker, NULL);
+            return -1;
+        }
+        memset(&devices[d].command, 0, sizeof(LJUSB_WorkerCommand));
+        devices[d].command.pCommand = devices[d].feedback.sendBuff;
+        devices[d].command.commandSize = devices[d].feedback.sendSize;
+        devices[d].command.pResponse = devices[d].feedback.recBuff;
+        devices[d].command.responseSize = devices[d].feedback.recSize;
+    }
+
+    start = getSeconds();
+    do
+    {
+        for( d = 0; d < numDevices; d++ )
+        {
+            if( LJUSB_WorkerSubmit(devices[d].worker, &devices[d].command) < 0 )
+            {
+                printf("LJUSB_WorkerSubmit error : %s\n", strerror(errno));
+                ret = -1;
+                goto stop;
+            }
+        }
+
+        //The commands are in flight on every device, so the last one to
+        //complete sets the time of the round
+        for( d = 0; d < numDevices; d++ )
+        {
+            LJUSB_WorkerWait(devices[d].worker, &devices[d].command, 0);
+            if( devices[d].command.error != 0 )
+            {
+                printf("Worker error : device %d : %s\n", d, strerror(devices[d].command.error));
+                ret = -1;
+            }
+            else if( convertResponse(&devices[d], devices[d].command.pResponse, devices[d].command.readCount) < 0 )
+            {
+                printf("Worker error : device %d : bad response\n", d);
+                ret = -1;
+            }
+        }
+        if( ret != 0 )
+            goto stop;
+        rounds++;
+        elapsed = getSeconds() - start;
+    } while( elapsed < seconds );
+
+    printf("%-22s %8.1f rounds/s\n", "device workers", rounds/elapsed);
+
+stop:
+    for( d = 0; d < numDevices; d++ )
+    {
+        LJUSB_WorkerStop(devices[d].worker, &stats);
+        if( ret == 0 )
+        {
+            printf("  U6 %d, CPU %2d: queue us p50 %6.1f  p99 %6.1f | round trip us p50 %6.1f  p99 %6.1f  max %6.1f\n",
+                   d, stats.cpu, LJUSB_StreamAgeStatsPercentile(&stats.queueTime, 50),
+                   LJUSB_StreamAgeStatsPercentile(&stats.queueTime, 99),
+                   LJUSB_StreamAgeStatsPercentile(&stats.roundTrip, 50),
+                   LJUSB_StreamAgeStatsPercentile(&stats.roundTrip, 99), stats.roundTrip.maxUs);
+        }
+    }
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    uint8 sendDataBuff[NUM_CHANNELS*4];
+    unsigned int count, dev;
+    double seconds = 2;
+    int d, i, ret = 1;
+
+    if( argc > 1 )
+        seconds = atof(argv[1]);
+
+    //Open every U6 found over USB
+    count = LJUSB_GetDevCount(U6_PRODUCT_ID);
+    for( dev = 1; dev <= count && numDevices < MAX_DEVICES; dev++ )
+    {
+        devices[numDevices].hDevice = LJUSB_OpenDevice(dev, 0, U6_PRODUCT_ID);
+        if( devices[numDevices].hDevice != NULL )
+            numDevices++;
+    }
+    if( numDevices == 0 )
+    {
+        printf("Open error: No U6 devices could be found\n");
+        return 1;
+    }
+
+    for( i = 0; i < NUM_CHANNELS; i++ )
+    {
+        sendDataBuff[i*4] = 2;      //IOType is AIN24
+        sendDataBuff[i*4 + 1] = i;  //Positive channel
+        sendDataBuff[i*4 + 2] = RESOLUTION_INDEX + GAIN_INDEX*16;  //Res Index (0-3), Gain Index (4-7)
+        sendDataBuff[i*4 + 3] = 0;  //Settling factor (0-2), Differential (7)
+    }
+    for( d = 0; d < numDevices; d++ )
+    {
+        if( getCalibrationInfo(devices[d].hDevice, &devices[d].caliInfo) < 0 )
+            goto close;
+        if( ehFeedbackPrepare(&devices[d].feedback, sendDataBuff, NUM_CHANNELS*4, NUM_CHANNELS*3) < 0 )
+            goto close;
+    }
+
+    printf("Feedback with %d AIN24 readings to each of %d U6s, %.0f s per run\n", NUM_CHANNELS, numDevices, seconds);
+    if( sequentialRun(seconds) < 0 || workerRun(seconds) < 0 )
+        goto close;
+
+    for( d = 0; d < numDevices; d++ )
+    {
+        printf("U6 %d:", d);
+        for( i = 0; i < NUM_CHANNELS; i++ )
+            printf(" AIN%d %.4f V", i, devices[d].volts[i]);
+        printf("\n");
+    }
+    ret = 0;
+
+close:
+    for( d = 0; d < numDevices; d++ )
+        closeUSBConnection(devices[d].hDevice);
+    return ret;
+}
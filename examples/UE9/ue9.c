@@ -3,6 +3,33 @@
 //Example UE9 helper functions.  Function descriptions are in ue9.h.
 
 #include "ue9.h"
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include "labjacki2c.h"
+
+//Size of the calibration memory read by getCalibrationInfo (blocks 0-4)
+#define UE9_CALIBRATION_MEM_SIZE    640
+#define UE9_CALIBRATION_BLOCK_SIZE  128
+
+//ReadMem commands of the calibration memory written ahead of their responses
+#define UE9_CALIBRATION_READ_AHEAD  4
+
+
+//Number of LJTDACs (handle and pin pairs) whose calibration is cached
+#define UE9_MAX_TDAC_CACHE  16
+
+//Cached LJTDAC calibration constants of a handle and DIOA pin
+struct UE9_TDAC_CACHE {
+    HANDLE hDevice;
+    uint8 DIOAPinNum;
+    ue9TdacCalibrationInfo caliInfo;
+};
+
+static struct UE9_TDAC_CACHE tdacCache[UE9_MAX_TDAC_CACHE];
+
+static void clearTdacCache(HANDLE hDevice);
 
 
 ue9CalibrationInfo UE9_CALIBRATION_INFO_DEFAULT = {
@@ -189,6 +216,7 @@ locid_error:
 
 void closeUSBConnection(HANDLE hDevice) 
 {
+    clearTdacCache(hDevice);
     LJUSB_CloseDevice(hDevice);
 }
 
@@ -203,48 +231,147 @@ long getTickCount()
 }
 
 
-long getCalibrationInfo(HANDLE hDevice, ue9CalibrationInfo *caliInfo)
+//Reads the CommConfig response (38 bytes) without changing the configuration.
+static long readCommConfig(HANDLE hDevice, uint8 *recBuffer)
 {
-    BYTE sendBuffer[8], recBuffer[136];
-    int sentRec = 0, i = 0, j = 0, ccTotal = 0, count = 0;
+    uint8 sendBuffer[38];
+    int sentRec = 0, i = 0;
 
-    /* Setting up command */
-    sendBuffer[1] = (BYTE)(0xF8);  //command byte
-    sendBuffer[2] = (BYTE)(0x01);  //number of data words
-    sendBuffer[3] = (BYTE)(0x2A);  //extended command number
-    sendBuffer[6] = (BYTE)(0x00);
+    sendBuffer[1] = (uint8)(0x78);  //command byte
+    sendBuffer[2] = (uint8)(0x10);  //number of data words
+    sendBuffer[3] = (uint8)(0x01);  //extended command number
 
-    for( i = 0; i < 5; i++ )
+    //setting WriteMask and all other bytes to 0 since we only want to read the response
+    for( i = 6; i < 38; i++ )
+        sendBuffer[i] = 0;
+
+    extendedChecksum(sendBuffer, 38);
+
+    sentRec = LJUSB_Write(hDevice, sendBuffer, 38);
+    if( sentRec < 38 )
     {
-        /* Reading block 1 from memory */
-        sendBuffer[7] = (BYTE)i;    //Blocknum = i
-        extendedChecksum(sendBuffer, 8);
+        if( sentRec == 0 )
+            printf("getCalibrationInfo error : write failed\n");
+        else
+            printf("getCalibrationInfo error : did not write all of the buffer\n");
+        return -1;
+    }
 
-        sentRec = LJUSB_Write(hDevice, sendBuffer, 8);
-        if( sentRec < 8 )
-        {
-            if( sentRec == 0 )
-                printf("getCalibrationInfo error : write failed\n");
-            else
-                printf("getCalibrationInfo error : did not write all of the buffer\n");
-            return -1;
-        }
+    sentRec = LJUSB_Read(hDevice, recBuffer, 38);
+    if( sentRec < 38 )
+    {
+        if( sentRec == 0 )
+            printf("getCalibrationInfo error : read failed\n");
+        else
+            printf("getCalibrationInfo error : did not read all of the buffer\n");
+        return -1;
+    }
+
+    if( recBuffer[1] != (uint8)(0x78) || recBuffer[2] != (uint8)(0x10) || recBuffer[3] != (uint8)(0x01) )
+    {
+        printf("getCalibrationInfo error : incorrect command bytes for CommConfig response\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+
+//Writes the ReadMem command of a block of calibration memory.
+static long writeCalibrationBlockRequest(HANDLE hDevice, int blockNum)
+{
+    uint8 sendBuffer[8];
+    int sentRec = 0;
+
+    sendBuffer[1] = (uint8)(0xF8);  //command byte
+    sendBuffer[2] = (uint8)(0x01);  //number of data words
+    sendBuffer[3] = (uint8)(0x2A);  //extended command number
+    sendBuffer[6] = 0;
+    sendBuffer[7] = (uint8)blockNum;  //Blocknum
+    extendedChecksum(sendBuffer, 8);
+
+    sentRec = LJUSB_Write(hDevice, sendBuffer, 8);
+    if( sentRec < 8 )
+    {
+        if( sentRec == 0 )
+            printf("getCalibrationInfo error : write failed\n");
+        else
+            printf("getCalibrationInfo error : did not write all of the buffer\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+
+//Reads the ReadMem response of a block of calibration memory.
+static long readCalibrationBlockResponse(HANDLE hDevice, uint8 *blockData)
+{
+    uint8 recBuffer[136];
+    int sentRec = 0;
+
+    sentRec = LJUSB_Read(hDevice, recBuffer, 136);
+    if( sentRec < 136 )
+    {
+        if( sentRec == 0 )
+            printf("getCalibrationInfo error : read failed\n");
+        else
+            printf("getCalibrationInfo error : did not read all of the buffer\n");
+        return -1;
+    }
 
-        sentRec = LJUSB_Read(hDevice, recBuffer, 136);
-        if( sentRec < 136 )
+    if( recBuffer[1] != (uint8)(0xF8) || recBuffer[2] != (uint8)(0x41) || recBuffer[3] != (uint8)(0x2A) )
+    {
+        printf("getCalibrationInfo error : incorrect command bytes for ReadMem response\n");
+        return -1;
+    }
+
+    //block data starts on byte 8 of the buffer
+    memcpy(blockData, recBuffer + 8, UE9_CALIBRATION_BLOCK_SIZE);
+
+    return 0;
+}
+
+
+//Reads all of the calibration memory.  Up to UE9_CALIBRATION_READ_AHEAD ReadMem
+//commands are written before their responses are read, so the round trips of
+//the blocks overlap.
+static long readCalibrationMem(HANDLE hDevice, uint8 *calMem)
+{
+    int numBlocks = UE9_CALIBRATION_MEM_SIZE/UE9_CALIBRATION_BLOCK_SIZE;
+    int numWritten = 0, numRead = 0;
+
+    while( numRead < numBlocks )
+    {
+        while( numWritten < numBlocks && numWritten - numRead < UE9_CALIBRATION_READ_AHEAD )
         {
-            if( sentRec == 0 )
-                printf("getCalibrationInfo Error : read failed\n");
-            else
-                printf("getCalibrationInfo Error : did not read all of the buffer\n");
+            if( writeCalibrationBlockRequest(hDevice, numWritten) != 0 )
+            {
+                //Reading the responses already in flight, so the next command
+                //does not read one of them
+                for( ; numRead < numWritten; numRead++ )
+                    readCalibrationBlockResponse(hDevice, calMem + numRead*UE9_CALIBRATION_BLOCK_SIZE);
+                return -1;
+            }
+            numWritten++;
         }
 
-        if( recBuffer[1] != (BYTE)(0xF8) || recBuffer[2] != (BYTE)(0x41) || recBuffer[3] != (BYTE)(0x2A) )
-        {
-            printf("getCalibrationInfo error: incorrect command bytes for ReadMem response");
+        if( readCalibrationBlockResponse(hDevice, calMem + numRead*UE9_CALIBRATION_BLOCK_SIZE) != 0 )
             return -1;
-        }
+        numRead++;
+    }
+
+    return 0;
+}
+
+
+//Converts the calibration memory blocks to the calibration constants.
+static void decodeCalibrationMem(uint8 *calMem, ue9CalibrationInfo *caliInfo)
+{
+    int i = 0, j = 0, ccTotal = 0, count = 0;
 
+    for( i = 0; i < 5; i++ )
+    {
         //Reading out calbration constants
         if( i == 0 )
             ccTotal = 8;
@@ -261,14 +388,197 @@ long getCalibrationInfo(HANDLE hDevice, ue9CalibrationInfo *caliInfo)
         {
             if( i != 2 || (i == 2 && j != 5 && j != 7) )
             {
-                //Block data starts on byte 8 of the buffer
-                caliInfo->ccConstants[count] = FPuint8ArrayToFPDouble(recBuffer + 8, j*8);
+                caliInfo->ccConstants[count] = FPuint8ArrayToFPDouble(calMem + i*UE9_CALIBRATION_BLOCK_SIZE, j*8);
                 count++;
             }
         }
     }
 
     caliInfo->prodID = 9;
+}
+
+
+long getCalibrationInfo(HANDLE hDevice, ue9CalibrationInfo *caliInfo)
+{
+    uint8 calMem[UE9_CALIBRATION_MEM_SIZE];
+
+    /* Reading blocks 0-4 from memory */
+    if( readCalibrationMem(hDevice, calMem) != 0 )
+        return -1;
+
+    decodeCalibrationMem(calMem, caliInfo);
+
+    return 0;
+}
+
+
+/* Calibration cache */
+
+//Header of a calibration cache file.  The header is followed by memSize bytes
+//of calibration memory.
+struct CALIBRATION_CACHE_HEADER {
+    char magic[4];        //"LJCC"
+    uint8 version;
+    uint8 prodID;
+    uint16 reserved;
+    uint32 key;           //calibrationMemKey of the calibration memory
+    uint32 serialNumber;
+    uint32 memSize;
+};
+
+//The key of a calibration memory copy:  the 32-bit FNV-1a hash of all of its
+//bytes, so a change to any block gives a different key.
+static uint32 calibrationMemKey(uint8 *calMem, int memSize)
+{
+    int i;
+    uint32 key = 2166136261u;
+
+    for( i = 0; i < memSize; i++ )
+        key = (key ^ calMem[i])*16777619u;
+
+    return key;
+}
+
+
+//Gets the path of the cache file of a device.  The default cache directory is
+//only created if createDir is nonzero.  Returns -1 if the cache is disabled or
+//there is no cache directory.
+static long getCalibrationCachePath(uint32 serialNumber, int createDir, char *path, int pathSize)
+{
+    char cacheDir[256];
+    const char *dir;
+
+    dir = getenv("LJ_CALIBRATION_CACHE_DIR");
+    if( dir == NULL )
+    {
+        if( (dir = getenv("XDG_CACHE_HOME")) != NULL && dir[0] != '\0' )
+        {
+            snprintf(cacheDir, sizeof(cacheDir), "%s", dir);
+        }
+        else if( (dir = getenv("HOME")) != NULL && dir[0] != '\0' )
+        {
+            snprintf(cacheDir, sizeof(cacheDir), "%s/.cache", dir);
+        }
+        else
+            return -1;
+
+        if( createDir != 0 )
+            mkdir(cacheDir, 0755);
+        strncat(cacheDir, "/labjack", sizeof(cacheDir) - strlen(cacheDir) - 1);
+        if( createDir != 0 )
+            mkdir(cacheDir, 0755);
+        dir = cacheDir;
+    }
+
+    //An empty LJ_CALIBRATION_CACHE_DIR disables the cache
+    if( dir[0] == '\0' )
+        return -1;
+
+    if( snprintf(path, pathSize, "%s/ue9_%u.cal", dir, serialNumber) >= pathSize )
+        return -1;
+
+    return 0;
+}
+
+
+//Reads a cache file.  Returns -1 if it is missing, it is for another device,
+//or its memory does not match its key.
+static long readCalibrationCache(const char *path, uint32 serialNumber, uint8 *calMem, int memSize)
+{
+    struct CALIBRATION_CACHE_HEADER header;
+    FILE *file;
+    long ret = -1;
+
+    if( (file = fopen(path, "rb")) == NULL )
+        return -1;
+
+    if( fread(&header, sizeof(header), 1, file) == 1 &&
+        memcmp(header.magic, "LJCC", 4) == 0 &&
+        header.version == 2 &&
+        header.prodID == 9 &&
+        header.serialNumber == serialNumber &&
+        header.memSize == (uint32)memSize &&
+        fread(calMem, 1, memSize, file) == (size_t)memSize &&
+        calibrationMemKey(calMem, memSize) == header.key )
+        ret = 0;
+
+    fclose(file);
+    return ret;
+}
+
+
+static void writeCalibrationCache(const char *path, uint32 serialNumber, uint8 *calMem, int memSize)
+{
+    struct CALIBRATION_CACHE_HEADER header;
+    char tmpPath[512];
+    FILE *file;
+    int ok;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "LJCC", 4);
+    header.version = 2;
+    header.prodID = 9;
+    header.key = calibrationMemKey(calMem, memSize);
+    header.serialNumber = serialNumber;
+    header.memSize = memSize;
+
+    //Writing to a temporary file and renaming it so other processes never
+    //read a partial file
+    if( snprintf(tmpPath, sizeof(tmpPath), "%s.%d", path, (int)getpid()) >= (int)sizeof(tmpPath) )
+        return;
+
+    if( (file = fopen(tmpPath, "wb")) == NULL )
+        return;
+
+    ok = (fwrite(&header, sizeof(header), 1, file) == 1 &&
+          fwrite(calMem, 1, memSize, file) == (size_t)memSize);
+    if( fclose(file) != 0 )
+        ok = 0;
+
+    if( !ok || rename(tmpPath, path) != 0 )
+        remove(tmpPath);
+}
+
+
+long getCalibrationInfoCached(HANDLE hDevice, ue9CalibrationInfo *caliInfo, long CreateCacheDir)
+{
+    uint8 recBuffer[38], calMem[UE9_CALIBRATION_MEM_SIZE], cachedMem[UE9_CALIBRATION_MEM_SIZE];
+    uint32 serialNumber;
+    char path[512];
+    int cacheEnabled;
+
+    /* Sending CommConfig command to get the serial number */
+    if( readCommConfig(hDevice, recBuffer) != 0 )
+        return -1;
+
+    serialNumber = recBuffer[28] + recBuffer[29]*256 + recBuffer[30]*65536 + ((uint32)0x10)*16777216;
+
+    cacheEnabled = (getCalibrationCachePath(serialNumber, (int)CreateCacheDir, path, sizeof(path)) == 0);
+
+    //Using the cached memory if block 0 of the device's memory matches it, one
+    //ReadMem round trip instead of one per block
+    if( cacheEnabled &&
+        readCalibrationCache(path, serialNumber, cachedMem, UE9_CALIBRATION_MEM_SIZE) == 0 )
+    {
+        if( writeCalibrationBlockRequest(hDevice, 0) != 0 ||
+            readCalibrationBlockResponse(hDevice, calMem) != 0 )
+            return -1;
+
+        if( memcmp(calMem, cachedMem, UE9_CALIBRATION_BLOCK_SIZE) == 0 )
+        {
+            decodeCalibrationMem(cachedMem, caliInfo);
+            return 0;
+        }
+    }
+
+    /* reading blocks 0-4 from memory */
+    if( readCalibrationMem(hDevice, calMem) != 0 )
+        return -1;
+
+    decodeCalibrationMem(calMem, caliInfo);
+
+    if( cacheEnabled )
+        writeCalibrationCache(path, serialNumber, calMem, UE9_CALIBRATION_MEM_SIZE);
 
     return 0;
 }
@@ -317,6 +627,49 @@ long getTdacCalibrationInfo(HANDLE hDevice, ue9TdacCalibrationInfo *caliInfo, ui
 }
 
 
+static void clearTdacCache(HANDLE hDevice)
+{
+    int i;
+
+    for( i = 0; i < UE9_MAX_TDAC_CACHE; i++ )
+    {
+        if( tdacCache[i].hDevice == hDevice )
+            memset(&tdacCache[i], 0, sizeof(struct UE9_TDAC_CACHE));
+    }
+}
+
+
+long getTdacCalibrationInfoCached(HANDLE hDevice, ue9TdacCalibrationInfo *caliInfo, uint8 DIOAPinNum)
+{
+    struct UE9_TDAC_CACHE *unused = NULL;
+    int i;
+
+    for( i = 0; i < UE9_MAX_TDAC_CACHE; i++ )
+    {
+        if( tdacCache[i].hDevice == hDevice && tdacCache[i].DIOAPinNum == DIOAPinNum )
+        {
+            *caliInfo = tdacCache[i].caliInfo;
+            return 0;
+        }
+        if( unused == NULL && tdacCache[i].hDevice == NULL )
+            unused = &tdacCache[i];
+    }
+
+    if( getTdacCalibrationInfo(hDevice, caliInfo, DIOAPinNum) < 0 )
+        return -1;
+
+    //When the cache is full the constants are returned but not cached
+    if( unused != NULL )
+    {
+        unused->hDevice = hDevice;
+        unused->DIOAPinNum = DIOAPinNum;
+        unused->caliInfo = *caliInfo;
+    }
+
+    return 0;
+}
+
+
 double FPuint8ArrayToFPDouble(uint8 *buffer, int startIndex) 
 { 
     uint32 resultDec = 0, resultWh = 0;
@@ -397,6 +750,25 @@ invalidGainBip:
 }
 
 
+long getStreamCalibration(ue9CalibrationInfo *caliInfo, uint8 gainBip, uint8 resolution, LJUSB_StreamChannelCal *streamCal)
+{
+    double minVolt, maxVolt;
+
+    //The UE9 conversions are linear, so the slope and offset are found from
+    //the voltages of the lowest and highest binary values
+    if( getAinVoltCalibrated(caliInfo, gainBip, resolution, 0, &minVolt) != 0 ||
+        getAinVoltCalibrated(caliInfo, gainBip, resolution, 65535, &maxVolt) != 0 )
+        return -1;
+
+    streamCal->center = 0;
+    streamCal->slopeBelow = (maxVolt - minVolt)/65535.0;
+    streamCal->slopeAbove = streamCal->slopeBelow;
+    streamCal->offset = minVolt;
+
+    return 0;
+}
+
+
 long getDacBinVoltCalibrated(ue9CalibrationInfo *caliInfo, int dacNumber, double analogVolt, uint16 *bytesVolt)
 {
     double tBytesVolt;
@@ -429,7 +801,7 @@ long getDacBinVoltCalibrated(ue9CalibrationInfo *caliInfo, int dacNumber, double
 
 long getTdacBinVoltCalibrated(ue9TdacCalibrationInfo *caliInfo, int dacNumber, double analogVolt, uint16 *bytesVolt)
 {
-    uint32 tBytesVolt;
+    double tBytesVolt;
 
     if( isTdacCalibrationInfoValid(caliInfo) == 0 )
         return -1;
@@ -443,12 +815,14 @@ long getTdacBinVoltCalibrated(ue9TdacCalibrationInfo *caliInfo, int dacNumber, d
     tBytesVolt = analogVolt*caliInfo->ccConstants[dacNumber*2] + caliInfo->ccConstants[dacNumber*2 + 1];
 
     //Checking to make sure bytesVolt will be a value between 0 and 65535.
-    if( tBytesVolt > 65535 )
+    if( tBytesVolt < 0 )
+        tBytesVolt = 0;
+    else if( tBytesVolt > 65535 )
         tBytesVolt = 65535;
 
     *bytesVolt = (uint16)tBytesVolt;
 
-    return 0;  
+    return 0;
 }
 
 
@@ -488,122 +862,55 @@ long getTempKUncalibrated(int powerLevel, uint16 bytesTemp, double *kelvinTemp)
 
 long I2C(HANDLE hDevice, uint8 I2COptions, uint8 SpeedAdjust, uint8 SDAPinNum, uint8 SCLPinNum, uint8 Address, uint8 NumI2CBytesToSend, uint8 NumI2CBytesToReceive, uint8 *I2CBytesCommand, uint8 *Errorcode, uint8 *AckArray, uint8 *I2CBytesResponse)
 {
-    uint8 *sendBuff, *recBuff;
-    uint16 checksumTotal = 0;
-    uint32 ackArrayTotal, expectedAckArray;
-    int sendChars, recChars, sendSize, recSize, i, ret;
+    LJUSB_I2CEngine engine;
+    LJUSB_I2CTransaction *t;
+    uint32 expectedAckArray;
+    int i;
 
     *Errorcode = 0;
-    ret = 0;
-    sendSize = 6 + 8 + ((NumI2CBytesToSend%2 != 0)?(NumI2CBytesToSend + 1):(NumI2CBytesToSend));
-    recSize = 6 + 6 + ((NumI2CBytesToReceive%2 != 0)?(NumI2CBytesToReceive + 1):(NumI2CBytesToReceive));
-
-    sendBuff = (uint8 *)malloc(sizeof(uint8)*sendSize);
-    recBuff = (uint8 *)malloc(sizeof(uint8)*recSize);
-
-    sendBuff[sendSize - 1] = 0;
-
-    //I2C command
-    sendBuff[1] = (uint8)(0xF8);     //Command byte
-    sendBuff[2] = (sendSize - 6)/2;  //Number of data words = 4 + NumI2CBytesToSend
-    sendBuff[3] = (uint8)(0x3B);     //Extended command number
-
-    sendBuff[6] = I2COptions;   //I2COptions
-    sendBuff[7] = SpeedAdjust;  //SpeedAdjust
-    sendBuff[8] = SDAPinNum;    //SDAPinNum
-    sendBuff[9] = SCLPinNum;    //SCLPinNum
-    sendBuff[10] = Address;     //Address
-    sendBuff[11] = 0;           //Reserved
-    sendBuff[12] = NumI2CBytesToSend;     //NumI2CByteToSend
-    sendBuff[13] = NumI2CBytesToReceive;  //NumI2CBytesToReceive
 
-    for( i = 0; i < NumI2CBytesToSend; i++ )
-        sendBuff[14 + i] = I2CBytesCommand[i];  //I2CByte
-
-    extendedChecksum(sendBuff, sendSize);
-
-    //Sending command to UE9
-    sendChars = LJUSB_Write(hDevice, sendBuff, sendSize);
-    if( sendChars < sendSize )
+    //Sending the I2C command with the I2C engine of labjacki2c.h, one command
+    //at a time and without allocating memory
+    if( LJUSB_I2CEngineInit(&engine, hDevice, I2COptions, SpeedAdjust, SDAPinNum, SCLPinNum, 1) < 0 )
     {
-        if( sendChars == 0 )
-            printf("I2C Error : write failed\n");
-        else
-            printf("I2C Error : did not write all of the buffer\n");
-        ret = -1;
-        goto cleanmem;
+        printf("I2C Error : invalid handle\n");
+        return -1;
     }
 
-    //Reading response from UE9
-    recChars = LJUSB_Read(hDevice, recBuff, recSize);
-    if( recChars < recSize )
+    //A response with a non-zero errorcode or missing acks is still returned
+    t = &engine.queue[0];
+    if( LJUSB_I2CTransfer(&engine, Address, I2CBytesCommand, NumI2CBytesToSend, I2CBytesResponse, NumI2CBytesToReceive) < 0 &&
+        errno != EPROTO && errno != ENXIO )
     {
-        if( recChars == 0 )
-            printf("I2C Error : read failed\n");
+        if( errno == EINVAL )
+            printf("I2C Error : invalid byte counts or buffers\n");
+        else if( errno == EBADMSG )
+            printf("I2C Error : read buffer has bad checksum or command bytes\n");
         else
-        {
-            printf("I2C Error : did not read all of the buffer\n");
-            if( recChars >= 12 )
-                *Errorcode = recBuff[6];
-        }
-        ret = -1;
-        goto cleanmem;
+            printf("I2C Error : write or read failed\n");
+        *Errorcode = (uint8)t->errorcode;
+        return -1;
     }
 
-    *Errorcode = recBuff[6];
+    *Errorcode = (uint8)t->errorcode;
 
-    AckArray[0] = recBuff[8];
-    AckArray[1] = recBuff[9];
-    AckArray[2] = recBuff[10];
-    AckArray[3] = recBuff[11];
+    AckArray[0] = (uint8)(t->ackArray & 0xFF);
+    AckArray[1] = (uint8)((t->ackArray >> 8) & 0xFF);
+    AckArray[2] = (uint8)((t->ackArray >> 16) & 0xFF);
+    AckArray[3] = (uint8)((t->ackArray >> 24) & 0xFF);
 
     for( i = 0; i < NumI2CBytesToReceive; i++ )
-        I2CBytesResponse[i] = recBuff[12 + i];
-
-    if( (uint8)(extendedChecksum8(recBuff)) != recBuff[0] )
-    {
-        printf("I2C Error : read buffer has bad checksum (%d)\n", recBuff[0]);
-        ret = -1;
-    }
-
-    if( recBuff[1] != (uint8)(0xF8) )
-    {
-        printf("I2C Error : read buffer has incorrect command byte (%d)\n", recBuff[1]);
-        ret = -1;
-    }
-
-    if( recBuff[2] != (uint8)((recSize - 6)/2) )
-    {
-        printf("I2C Error : read buffer has incorrect number of data words (%d)\n", recBuff[2]);
-        ret = -1;
-    }
-
-    if( recBuff[3] != (uint8)(0x3B) )
-    {
-        printf("I2C Error : read buffer has incorrect extended command number (%d)\n", recBuff[3]);
-        ret = -1;
-    }
+        I2CBytesResponse[i] = t->response[i];
 
-    checksumTotal = extendedChecksum16(recBuff, recSize);
-    if( (uint8)((checksumTotal / 256) & 0xFF) != recBuff[5] || (uint8)(checksumTotal & 0xFF) != recBuff[4] )
+    //AckArray should ack the Address byte in the first ack bit, but did not
+    //until control firmware 1.84
+    if( t->acked == 0 )
     {
-        printf("I2C error : read buffer has bad checksum16 (%u)\n", checksumTotal);
-        ret = -1;
+        expectedAckArray = (NumI2CBytesToSend + 1 >= 32) ? 0xFFFFFFFF : ((uint32)1 << (NumI2CBytesToSend + 1)) - 1;
+        printf("I2C error : expected an ack of %u, but received %u\n", expectedAckArray, t->ackArray);
     }
 
-    //ackArray should ack the Address byte in the first ack bit, but did not until control firmware 1.84
-    ackArrayTotal = AckArray[0] + AckArray[1]*256 + AckArray[2]*65536 + AckArray[3]*16777216;
-    expectedAckArray = pow(2.0,  NumI2CBytesToSend+1) - 1;
-    if( ackArrayTotal != expectedAckArray )
-        printf("I2C error : expected an ack of %u, but received %u\n", expectedAckArray, ackArrayTotal);
-
-cleanmem:
-    free(sendBuff);
-    free(recBuff);
-    sendBuff = NULL;
-    recBuff = NULL;
-
-    return ret;
+    return 0;
 }
 
 
@@ -679,6 +986,63 @@ long eDAC(HANDLE Handle, ue9CalibrationInfo *CalibrationInfo, long Channel, doub
 }
 
 
+long eTDAC(HANDLE Handle, ue9TdacCalibrationInfo *TdacCalibrationInfo, long DIOAPinNum, double VoltageA, double VoltageB)
+{
+    ue9TdacCalibrationInfo caliInfo;
+    LJUSB_I2CEngine engine;
+    uint8 bytesCommand[6];
+    uint16 bytesVolt;
+    int i;
+
+    if( DIOAPinNum < 0 || DIOAPinNum > 254 )
+    {
+        printf("eTDAC error: Invalid DIOAPinNum.\n");
+        return -1;
+    }
+
+    if( TdacCalibrationInfo == NULL )
+    {
+        if( getTdacCalibrationInfoCached(Handle, &caliInfo, (uint8)DIOAPinNum) < 0 )
+            return -1;
+        TdacCalibrationInfo = &caliInfo;
+    }
+    else if( isTdacCalibrationInfoValid(TdacCalibrationInfo) == 0 )
+    {
+        printf("eTDAC error: Invalid LJTDAC calibration information.\n");
+        return -1;
+    }
+
+    /* Setting up the DACA and DACB command bytes (h0x30 and h0x31) and values
+       (MSB first) of one I2C command to the DAC (address h0x24) */
+    for( i = 0; i < 2; i++ )
+    {
+        if( getTdacBinVoltCalibrated(TdacCalibrationInfo, i, (i == 0) ? VoltageA : VoltageB, &bytesVolt) < 0 )
+            return -1;
+
+        bytesCommand[i*3] = (uint8)(0x30 + i);  //LJTDAC command byte : DACA or DACB
+        bytesCommand[i*3 + 1] = (uint8)(bytesVolt/256);  //value (high)
+        bytesCommand[i*3 + 2] = (uint8)(bytesVolt & 255);  //value (low)
+    }
+
+    //Sending the I2C command with the I2C engine of labjacki2c.h, which
+    //builds it in the engine's buffers instead of allocating them
+    if( LJUSB_I2CEngineInit(&engine, Handle, 0, 0, (uint8)DIOAPinNum + 1, (uint8)DIOAPinNum, 1) < 0 ||
+        LJUSB_I2CTransfer(&engine, (uint8)(0x24), bytesCommand, 6, NULL, 0) < 0 )
+    {
+        if( errno == EPROTO )
+            return (long)engine.queue[0].errorcode;
+
+        if( errno == ENXIO )
+            printf("eTDAC error: the LJTDAC did not acknowledge the I2C command\n");
+        else
+            printf("eTDAC error: I2C command failed : %s\n", strerror(errno));
+        return -1;
+    }
+
+    return 0;
+}
+
+
 long eDI(HANDLE Handle, long Channel, long *State)
 {
     uint8 state;
@@ -713,6 +1077,309 @@ long eDO(HANDLE Handle, long Channel, long State)
 }
 
 
+//Sends a Feedback command (34 bytes) and reads and checks the response (64
+//bytes).  Used by the eAINs, eDIs and eDOs easy functions.
+static long feedbackWriteRead(HANDLE hDevice, uint8 *sendBuff, uint8 *recBuff)
+{
+    uint16 checksumTotal;
+    int sendChars, recChars;
+
+    sendBuff[1] = (uint8)(0xF8);  //Command byte
+    sendBuff[2] = (uint8)(0x0E);  //Number of data words
+    sendBuff[3] = (uint8)(0x00);  //Extended command number
+    extendedChecksum(sendBuff, 34);
+
+    //Sending command to UE9
+    sendChars = LJUSB_Write(hDevice, sendBuff, 34);
+    if( sendChars < 34 )
+    {
+        if( sendChars == 0 )
+            printf("Feedback error : write failed\n");
+        else
+            printf("Feedback error : did not write all of the buffer\n");
+        return -1;
+    }
+
+    //Reading response from UE9
+    recChars = LJUSB_Read(hDevice, recBuff, 64);
+    if( recChars < 64 )
+    {
+        if( recChars == 0 )
+            printf("Feedback error : read failed\n");
+        else
+            printf("Feedback error : did not read all of the buffer\n");
+        return -1;
+    }
+
+    checksumTotal = extendedChecksum16(recBuff, 64);
+    if( (uint8)((checksumTotal / 256) & 0xFF) != recBuff[5] ||
+        (uint8)(checksumTotal & 0xFF) != recBuff[4] ||
+        extendedChecksum8(recBuff) != recBuff[0] )
+    {
+        printf("Feedback error : read buffer has bad checksum\n");
+        return -1;
+    }
+
+    if( recBuff[1] != (uint8)(0xF8) || recBuff[2] != (uint8)(0x1D) || recBuff[3] != (uint8)(0x00) )
+    {
+        printf("Feedback error : read buffer has wrong command bytes\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+
+long eAINs(HANDLE Handle, ue9CalibrationInfo *CalibrationInfo, long NumChannels, long *aChannelP, long *aChannelN, double *aVoltages, long Range, long Resolution, long Settling, long Binary, long *aErrors, long Reserved1, long Reserved2)
+{
+    uint8 sendBuff[34], recBuff[64];
+    uint8 ainGain, slotUsed[16];
+    uint16 bytesVT;
+    long i, slot, numRead, error;
+    long *aSlots;
+
+    if( isCalibrationInfoValid(CalibrationInfo) == 0 )
+    {
+        printf("eAINs error: calibration information is required");
+        return -1;
+    }
+
+    if( NumChannels < 1 || aChannelP == NULL || aVoltages == NULL )
+    {
+        printf("eAINs error: Invalid channel arrays\n");
+        return -1;
+    }
+
+    for( i = 0; i < NumChannels; i++ )
+    {
+        if( aChannelP[i] < 0 || aChannelP[i] > 255 )
+        {
+            printf("eAINs error: Invalid ChannelP %ld\n", aChannelP[i]);
+            return -1;
+        }
+
+        //The UE9 Feedback command does not return errorcodes
+        if( aErrors != NULL )
+            aErrors[i] = 0;
+    }
+
+    if( Range == LJ_rgBIP5V )
+        ainGain = 8;
+    else if( Range == LJ_rgUNI5V )
+        ainGain = 0;
+    else if( Range == LJ_rgUNI2P5V )
+        ainGain = 1;
+    else if( Range == LJ_rgUNI1P25V )
+        ainGain = 2;
+    else if( Range == LJ_rgUNIP625V )
+        ainGain = 3;
+    else
+    {
+        printf("eAINs error: Invalid Range\n");
+        return -1;
+    }
+
+    //Slot (AINMask bit) of each channel in the current Feedback command, -1
+    //if it has not been read yet and -2 if it was read already
+    aSlots = (long *)malloc(NumChannels*sizeof(long));
+    if( aSlots == NULL )
+    {
+        printf("eAINs error: could not allocate memory\n");
+        return -1;
+    }
+    for( i = 0; i < NumChannels; i++ )
+        aSlots[i] = -1;
+
+    //The UE9 runs one command at a time, so each Feedback command is written
+    //after the response of the previous one is read
+    error = 0;
+    numRead = 0;
+    while( numRead < NumChannels )
+    {
+        /* Setting up Feedback command.  AIN0-AIN13 are read with their AINMask
+           bits, and up to two other channels with the AIN14 and AIN15 bits and
+           channel numbers.  Channels that do not fit are read with the next
+           Feedback command. */
+        memset(sendBuff, 0, 34);
+        memset(slotUsed, 0, 16);
+        for( i = 0; i < NumChannels; i++ )
+        {
+            if( aSlots[i] != -1 )
+                continue;
+
+            if( aChannelP[i] <= 13 )
+                slot = aChannelP[i];
+            else if( slotUsed[14] == 0 || sendBuff[22] == aChannelP[i] )
+                slot = 14;
+            else if( slotUsed[15] == 0 || sendBuff[23] == aChannelP[i] )
+                slot = 15;
+            else
+                continue;
+
+            aSlots[i] = slot;
+            slotUsed[slot] = 1;
+            if( slot >= 14 )
+                sendBuff[slot + 8] = (uint8)aChannelP[i];  //AIN14/AIN15ChannelNumber
+            sendBuff[20 + slot/8] |= (uint8)(1 << (slot%8));  //AINMask
+            sendBuff[26 + slot/2] |= (uint8)(ainGain << ((slot%2)*4));  //BipGain
+        }
+        sendBuff[24] = (uint8)Resolution;  //Resolution
+        sendBuff[25] = (uint8)Settling;  //SettlingTime
+
+        if( feedbackWriteRead(Handle, sendBuff, recBuff) < 0 )
+        {
+            free(aSlots);
+            return -1;
+        }
+
+        //A conversion error does not stop the other channels
+        for( i = 0; i < NumChannels; i++ )
+        {
+            if( aSlots[i] < 0 )
+                continue;
+
+            bytesVT = recBuff[12 + aSlots[i]*2] + recBuff[13 + aSlots[i]*2]*256;
+            aSlots[i] = -2;
+            numRead++;
+
+            if( Binary != 0 )
+                aVoltages[i] = (double)bytesVT;
+            else if( aChannelP[i] == 133 || aChannelP[i] == 141 )
+            {
+                if( getTempKCalibrated(CalibrationInfo, 0, bytesVT, &aVoltages[i]) < 0 )
+                    error = -1;
+            }
+            else if( getAinVoltCalibrated(CalibrationInfo, ainGain, (uint8)Resolution, bytesVT, &aVoltages[i]) < 0 )
+                error = -1;
+        }
+    }
+
+    free(aSlots);
+    return (error < 0) ? -1 : 0;
+}
+
+
+long eDIs(HANDLE Handle, long NumChannels, long *aChannels, long *aStates, long *aErrors)
+{
+    uint8 sendBuff[34], recBuff[64];
+    long i;
+
+    if( NumChannels < 1 || aChannels == NULL || aStates == NULL )
+    {
+        printf("eDIs error: Invalid channel arrays\n");
+        return -1;
+    }
+
+    /* Setting up Feedback command to set the channels to input and to read
+       their states.  Direction and state bits are 0 (input). */
+    memset(sendBuff, 0, 34);
+    for( i = 0; i < NumChannels; i++ )
+    {
+        if( aChannels[i] < 0 || aChannels[i] > 22 )
+        {
+            printf("eDIs error: Invalid Channel %ld\n", aChannels[i]);
+            return -1;
+        }
+
+        if( aChannels[i] <= 7 )
+            sendBuff[6] |= (uint8)(1 << aChannels[i]);  //FIOMask
+        else if( aChannels[i] <= 15 )
+            sendBuff[9] |= (uint8)(1 << (aChannels[i] - 8));  //EIOMask
+        else if( aChannels[i] <= 19 )
+            sendBuff[12] |= (uint8)(1 << (aChannels[i] - 16));  //CIOMask
+        else
+            sendBuff[14] |= (uint8)(1 << (aChannels[i] - 20));  //MIOMask
+    }
+
+    if( feedbackWriteRead(Handle, sendBuff, recBuff) < 0 )
+        return -1;
+
+    for( i = 0; i < NumChannels; i++ )
+    {
+        if( aChannels[i] <= 7 )
+            aStates[i] = (recBuff[7] >> aChannels[i]) & 1;
+        else if( aChannels[i] <= 15 )
+            aStates[i] = (recBuff[9] >> (aChannels[i] - 8)) & 1;
+        else if( aChannels[i] <= 19 )
+            aStates[i] = (recBuff[10] >> (aChannels[i] - 16)) & 1;
+        else
+            aStates[i] = (recBuff[11] >> (aChannels[i] - 20)) & 1;
+
+        //The UE9 Feedback command does not return errorcodes
+        if( aErrors != NULL )
+            aErrors[i] = 0;
+    }
+
+    return 0;
+}
+
+
+long eDOs(HANDLE Handle, long NumChannels, long *aChannels, long *aStates, long *aErrors)
+{
+    uint8 sendBuff[34], recBuff[64];
+    uint8 bit;
+    long i;
+
+    if( NumChannels < 1 || aChannels == NULL || aStates == NULL )
+    {
+        printf("eDOs error: Invalid channel arrays\n");
+        return -1;
+    }
+
+    /* Setting up Feedback command to set the channels to output and to set
+       their states */
+    memset(sendBuff, 0, 34);
+    for( i = 0; i < NumChannels; i++ )
+    {
+        if( aChannels[i] < 0 || aChannels[i] > 22 )
+        {
+            printf("eDOs error: Invalid Channel %ld\n", aChannels[i]);
+            return -1;
+        }
+
+        if( aChannels[i] <= 7 )
+        {
+            bit = (uint8)(1 << aChannels[i]);
+            sendBuff[6] |= bit;  //FIOMask
+            sendBuff[7] |= bit;  //FIODir
+            sendBuff[8] = (aStates[i] > 0) ? (sendBuff[8] | bit) : (sendBuff[8] & ~bit);  //FIOState
+        }
+        else if( aChannels[i] <= 15 )
+        {
+            bit = (uint8)(1 << (aChannels[i] - 8));
+            sendBuff[9] |= bit;  //EIOMask
+            sendBuff[10] |= bit;  //EIODir
+            sendBuff[11] = (aStates[i] > 0) ? (sendBuff[11] | bit) : (sendBuff[11] & ~bit);  //EIOState
+        }
+        else if( aChannels[i] <= 19 )
+        {
+            bit = (uint8)(1 << (aChannels[i] - 16));
+            sendBuff[12] |= bit;  //CIOMask
+            sendBuff[13] |= bit*16;  //CIODir
+            sendBuff[13] = (aStates[i] > 0) ? (sendBuff[13] | bit) : (sendBuff[13] & ~bit);  //CIOState
+        }
+        else
+        {
+            bit = (uint8)(1 << (aChannels[i] - 20));
+            sendBuff[14] |= bit;  //MIOMask
+            sendBuff[15] |= bit*16;  //MIODir
+            sendBuff[15] = (aStates[i] > 0) ? (sendBuff[15] | bit) : (sendBuff[15] & ~bit);  //MIOState
+        }
+    }
+
+    if( feedbackWriteRead(Handle, sendBuff, recBuff) < 0 )
+        return -1;
+
+    if( aErrors != NULL )
+    {
+        for( i = 0; i < NumChannels; i++ )
+            aErrors[i] = 0;
+    }
+
+    return 0;
+}
+
+
 long eTCConfig(HANDLE Handle, long *aEnableTimers, long *aEnableCounters, long TCPinOffset, long TimerClockBaseIndex, long TimerClockDivisor, long *aTimerModes, double *aTimerValues, long Reserved1, long Reserved2)
 {
     uint8 enableMask, timerMode[6], counterMode[2];
@@ -1072,3 +1739,185 @@ long ehTimerCounter(HANDLE hDevice, uint8 inTimerClockDivisor, uint8 inEnableMas
 
     return recBuff[6];
 }
+
+
+long ehStreamConfig(HANDLE hDevice, uint8 inNumChannels, uint8 inResolution, uint8 inSettlingTime, uint8 inScanConfig, uint16 inScanInterval, uint8 *inChannelNumbers, uint8 *inBipGains)
+{
+    uint8 sendBuff[64], recBuff[8];
+    uint16 checksumTotal;
+    int sendChars, recChars, sendSize, i;
+
+    if( inNumChannels < 1 || inNumChannels > 16 )
+    {
+        printf("ehStreamConfig error: Invalid number of channels\n");
+        return -1;
+    }
+
+    sendSize = 12 + inNumChannels*2;
+
+    sendBuff[1] = (uint8)(0xF8);          //Command byte
+    sendBuff[2] = 3 + inNumChannels;      //Number of data words = NumChannels + 3
+    sendBuff[3] = (uint8)(0x11);          //Extended command number
+    sendBuff[6] = inNumChannels;          //NumChannels
+    sendBuff[7] = inResolution;           //Resolution
+    sendBuff[8] = inSettlingTime;         //SettlingTime
+    sendBuff[9] = inScanConfig;           //ScanConfig
+    sendBuff[10] = (uint8)(inScanInterval & 0x00FF);  //ScanInterval (low byte)
+    sendBuff[11] = (uint8)(inScanInterval / 256);     //ScanInterval (high byte)
+
+    for( i = 0; i < inNumChannels; i++ )
+    {
+        sendBuff[12 + i*2] = inChannelNumbers[i];  //ChannelNumber
+        sendBuff[13 + i*2] = inBipGains[i];        //BipGain
+    }
+    extendedChecksum(sendBuff, sendSize);
+
+    //Sending command to UE9
+    if( (sendChars = LJUSB_Write(hDevice, sendBuff, sendSize)) < sendSize )
+    {
+        if( sendChars == 0 )
+            printf("ehStreamConfig error : write failed\n");
+        else
+            printf("ehStreamConfig error : did not write all of the buffer\n");
+        return -1;
+    }
+
+    //Reading response from UE9
+    if( (recChars = LJUSB_Read(hDevice, recBuff, 8)) < 8 )
+    {
+        if( recChars == 0 )
+            printf("ehStreamConfig error : read failed\n");
+        else
+            printf("ehStreamConfig error : did not read all of the buffer\n");
+        return -1;
+    }
+
+    checksumTotal = extendedChecksum16(recBuff, 8);
+    if( (uint8)((checksumTotal / 256 ) & 0xff) != recBuff[5] || (uint8)(checksumTotal & 0xff) != recBuff[4] )
+    {
+        printf("ehStreamConfig error : read buffer has bad checksum16\n");
+        return -1;
+    }
+
+    if( extendedChecksum8(recBuff) != recBuff[0] )
+    {
+        printf("ehStreamConfig error : read buffer has bad checksum8\n");
+        return -1;
+    }
+
+    if( recBuff[1] != (uint8)(0xF8) || recBuff[2] != (uint8)(0x01) || recBuff[3] != (uint8)(0x11) )
+    {
+        printf("ehStreamConfig error : read buffer has wrong command bytes\n");
+        return -1;
+    }
+
+    if( recBuff[6] != 0 )
+    {
+        printf("ehStreamConfig error : read buffer received errorcode %d\n", recBuff[6]);
+        return recBuff[6];
+    }
+
+    return 0;
+}
+
+
+//Sends a StreamStart (0xA8) or StreamStop (0xB0) command and checks the
+//response
+static long streamStartStop(HANDLE hDevice, uint8 command, const char *name)
+{
+    uint8 sendBuff[2], recBuff[4];
+    int sendChars, recChars;
+
+    sendBuff[0] = command;  //Checksum8
+    sendBuff[1] = command;  //Command byte
+
+    //Sending command to UE9
+    if( (sendChars = LJUSB_Write(hDevice, sendBuff, 2)) < 2 )
+    {
+        if( sendChars == 0 )
+            printf("%s error : write failed\n", name);
+        else
+            printf("%s error : did not write all of the buffer\n", name);
+        return -1;
+    }
+
+    //Reading response from UE9
+    if( (recChars = LJUSB_Read(hDevice, recBuff, 4)) < 4 )
+    {
+        if( recChars == 0 )
+            printf("%s error : read failed\n", name);
+        else
+            printf("%s error : did not read all of the buffer\n", name);
+        return -1;
+    }
+
+    if( normalChecksum8(recBuff, 4) != recBuff[0] )
+    {
+        printf("%s error : read buffer has bad checksum8\n", name);
+        return -1;
+    }
+
+    if( recBuff[1] != (uint8)(command + 1) || recBuff[3] != (uint8)(0x00) )
+    {
+        printf("%s error : read buffer has wrong command bytes\n", name);
+        return -1;
+    }
+
+    return recBuff[2];
+}
+
+
+long ehStreamStart(HANDLE hDevice)
+{
+    long error;
+
+    error = streamStartStop(hDevice, 0xA8, "ehStreamStart");
+    if( error > 0 )
+        printf("ehStreamStart error : read buffer received errorcode %ld\n", error);
+    return error;
+}
+
+
+long ehStreamStop(HANDLE hDevice)
+{
+    //Errorcode 52 (stream not running) is not printed
+    return streamStartStop(hDevice, 0xB0, "ehStreamStop");
+}
+
+
+long ehFlushBuffer(HANDLE hDevice)
+{
+    uint8 sendBuff[2], recBuff[2];
+    int sendChars, recChars;
+
+    sendBuff[0] = (uint8)(0x08);  //Checksum8
+    sendBuff[1] = (uint8)(0x08);  //Command byte
+
+    //Sending command to UE9
+    if( (sendChars = LJUSB_Write(hDevice, sendBuff, 2)) < 2 )
+    {
+        if( sendChars == 0 )
+            printf("ehFlushBuffer error : write failed\n");
+        else
+            printf("ehFlushBuffer error : did not write all of the buffer\n");
+        return -1;
+    }
+
+    //Reading response from UE9
+    if( (recChars = LJUSB_Read(hDevice, recBuff, 2)) < 2 )
+    {
+        if( recChars == 0 )
+            printf("ehFlushBuffer error : read failed\n");
+        else
+            printf("ehFlushBuffer error : did not read all of the buffer\n");
+        return -1;
+    }
+
+    if( recBuff[0] != (uint8)(0x08) || recBuff[1] != (uint8)(0x08) )
+    {
+        printf("ehFlushBuffer error : read buffer has wrong command bytes\n");
+        return -1;
+    }
+
+    return 0;
+}
@@ -22,6 +22,7 @@
 #include <math.h>
 #include <stdlib.h>
 #include "labjackusb.h"
+#include "labjackstream.h"
 
 
 #ifdef __cplusplus
@@ -134,6 +135,26 @@ long getCalibrationInfo( HANDLE hDevice,
 //hDevice = handle to a UE9 device
 //caliInfo = structure where calibration information will be stored
 
+long getCalibrationInfoCached( HANDLE hDevice,
+                               ue9CalibrationInfo *caliInfo,
+                               long CreateCacheDir);
+//Same as getCalibrationInfo, but also keeps a copy of the calibration memory
+//in a cache file per serial number.  When the file exists, only the first
+//memory block is read from the device:  if it matches the file, the cached
+//memory is used, which saves the ReadMem round trips of the other blocks.
+//Otherwise all of the blocks are read and the file is rewritten.  A
+//recalibration that leaves the first block unchanged is not seen; use
+//getCalibrationInfo after recalibrating only other ranges.  The file holds a
+//32-bit hash of the memory, so a damaged file is not used.  The cache
+//directory is $LJ_CALIBRATION_CACHE_DIR, or $XDG_CACHE_HOME/labjack or
+//$HOME/.cache/labjack if it is not set.  Set LJ_CALIBRATION_CACHE_DIR to an
+//empty string to disable the cache.  Returns -1 on error, 0 on success.
+//hDevice = handle to a UE9 device
+//caliInfo = structure where calibration information will be stored
+//CreateCacheDir = If this is nonzero (True), the default cache directory is
+//                 created if it does not exist.  Otherwise the cache is only
+//                 kept if the directory exists.
+
 long getTdacCalibrationInfo( HANDLE hDevice,
                              ue9TdacCalibrationInfo *caliInfo,
                              uint8 DIOAPinNum);
@@ -144,6 +165,17 @@ long getTdacCalibrationInfo( HANDLE hDevice,
 //DIOAPinNum = The UE9 digital IO line where the LJTDAC DIOA pin is connected.
 //             The DIOB pin is assumed to be the next digital IO line.
 
+long getTdacCalibrationInfoCached( HANDLE hDevice,
+                                   ue9TdacCalibrationInfo *caliInfo,
+                                   uint8 DIOAPinNum);
+//Same as getTdacCalibrationInfo, but the calibration constants of each handle
+//and DIOAPinNum are read from the LJTDAC once and kept until
+//closeUSBConnection is called.  Returns -1 on error, 0 on success.
+//hDevice = handle to a UE9 device
+//caliInfo = structure where LJTDAC calibration information will be stored
+//DIOAPinNum = The UE9 digital IO line where the LJTDAC DIOA pin is connected.
+//             The DIOB pin is assumed to be the next digital IO line.
+
 double FPuint8ArrayToFPDouble( uint8 *buffer,
                                int startIndex);
 //Converts a fixed point byte array (starting a startIndex) to a floating point
@@ -176,6 +208,19 @@ long getAinVoltCalibrated( ue9CalibrationInfo *caliInfo,
 //bytesVolt = the 2 byte voltage that will be converted to a analog value
 //analogVolt = the converted analog voltage
 
+long getStreamCalibration( ue9CalibrationInfo *caliInfo,
+                           uint8 gainBip,
+                           uint8 resolution,
+                           LJUSB_StreamChannelCal *streamCal);
+//Gets the binary to volts conversion of a stream channel for the stream
+//decoder (LJUSB_StreamDecoderSetCal).  The conversion is the same as
+//getAinVoltCalibrated.  Call getCalibrationInfo first to set up caliInfo.
+//Returns -1 on error, 0 on success.
+//caliInfo = structure where calibrarion information is stored
+//gainBip = the BipGain of the stream channel
+//resolution = the Resolution of the StreamConfig
+//streamCal = the conversion of the stream channel
+
 long getDacBinVoltCalibrated( ue9CalibrationInfo *caliInfo,
                               int dacNumber,
                               double analogVolt,
@@ -262,7 +307,8 @@ long I2C( HANDLE hDevice,
           uint8 *I2CBytesResponse);
 //This function will perform the I2C low-level function call.  Please refer to
 //section 5.3.20 of the UE9 User's Guide for parameter documentation.  Returns
-//-1 on error, 0 on success.
+//-1 on error, 0 on success.  The command is sent with the I2C engine of
+//labjacki2c.h, so no memory is allocated.
 //hDevice = handle to a UE9 device
 //I2COptions = byte 6 of the command
 //SpeedAdjust = byte 7 of the command
@@ -328,6 +374,25 @@ long eDAC( HANDLE Handle,
 //         binary.
 //Reserved (1&2) = Pass 0.
 
+long eTDAC( HANDLE Handle,
+            ue9TdacCalibrationInfo *TdacCalibrationInfo,
+            long DIOAPinNum,
+            double VoltageA,
+            double VoltageB);
+//An "easy" function that sets both outputs of an LJTick-DAC with one I2C
+//command, instead of one I2C command per output.  The command is sent with the
+//I2C engine of labjacki2c.h, so no memory is allocated.  Returns 0 for no
+//error, or -1 or >0 value (low-level errorcode) on error.  It returns -1 if the
+//LJTDAC does not acknowledge the command.
+//Handle = Handle to a UE9 device.
+//TdacCalibrationInfo = Structure where LJTDAC calibration information is
+//                      stored.  Pass NULL to use the constants cached by
+//                      getTdacCalibrationInfoCached.
+//DIOAPinNum = The digital IO line where the LJTDAC DIOA pin is connected.
+//             The DIOB pin is assumed to be the next digital IO line.
+//VoltageA = The voltage to set DACA to.
+//VoltageB = The voltage to set DACB to.
+
 long eDI( HANDLE Handle,
           long Channel,
           long *State);
@@ -349,6 +414,69 @@ long eDO( HANDLE Handle,
 //State = The state to write to the digital output.  0=False=Low and 
 //        1=True=High.
 
+long eAINs( HANDLE Handle,
+            ue9CalibrationInfo *CalibrationInfo,
+            long NumChannels,
+            long *aChannelP,
+            long *aChannelN,
+            double *aVoltages,
+            long Range,
+            long Resolution,
+            long Settling,
+            long Binary,
+            long *aErrors,
+            long Reserved1,
+            long Reserved2);
+//An "easy" function that returns readings from several analog inputs, like
+//calling eAIN for each channel.  Each Feedback call reads AIN0-AIN13 and up to
+//two other channels, so the minimum number of Feedback calls are made, and
+//each one is written before the response of the previous one is read.
+//Returns 0 for no error, or -1 on error.
+//Handle = Handle to a UE9 device.
+//CalibrationInfo = Structure where calibration information is stored.
+//NumChannels = The number of channels to read.
+//aChannelP = An array of the positive AIN channels to acquire.
+//aChannelN = For the UE9, this parameter is ignored.
+//aVoltages = Returns the analog input readings.
+//Range = Pass a constant specifying the voltage range.  It applies to all
+//        channels.
+//Resolution = Pass 12-17 to specify the resolution of the analog input
+//             readings, and 18 for high-res readings from UE9-Pro.
+//Settling = Pass 0 for default settling.
+//Binary = If this is nonzero (True), aVoltages will return the raw binary
+//         values.
+//aErrors = Returns 0 for each channel, since the UE9 Feedback command does not
+//          return errorcodes.  Pass NULL if not needed.
+//Reserved (1&2) = Pass 0.
+
+long eDIs( HANDLE Handle,
+           long NumChannels,
+           long *aChannels,
+           long *aStates,
+           long *aErrors);
+//An "easy" function that sets several channels to input and reads their states
+//with one Feedback call.  Returns 0 for no error, or -1 on error.
+//Handle = Handle to a UE9 device.
+//NumChannels = The number of channels to read.
+//aChannels = An array of the channels to read.  0-22 corresponds to
+//            FIO0-MIO2.
+//aStates = Returns the states of the digital inputs.
+//aErrors = Returns 0 for each channel.  Pass NULL if not needed.
+
+long eDOs( HANDLE Handle,
+           long NumChannels,
+           long *aChannels,
+           long *aStates,
+           long *aErrors);
+//An "easy" function that sets several channels to output and writes their
+//states with one Feedback call.  Returns 0 for no error, or -1 on error.
+//Handle = Handle to a UE9 device.
+//NumChannels = The number of channels to write.
+//aChannels = An array of the channels to write.  0-22 corresponds to
+//            FIO0-MIO2.
+//aStates = An array of the states to write.  0=False=Low and 1=True=High.
+//aErrors = Returns 0 for each channel.  Pass NULL if not needed.
+
 long eTCConfig( HANDLE Handle,
                 long *aEnableTimers,
                 long *aEnableCounters,
@@ -476,6 +604,41 @@ long ehTimerCounter( HANDLE hDevice,
 //Returns -1 or errorcode (>1 value) on error, 0 on success.
 
 
+long ehStreamConfig( HANDLE hDevice,
+                     uint8 inNumChannels,
+                     uint8 inResolution,
+                     uint8 inSettlingTime,
+                     uint8 inScanConfig,
+                     uint16 inScanInterval,
+                     uint8 *inChannelNumbers,
+                     uint8 *inBipGains);
+//Performs a StreamConfig call with the UE9.  The parameters are the
+//StreamConfig low-level command bytes.  LJUSB_StreamPlanCompute
+//(labjackstream.h) can pick inScanConfig and inScanInterval.  Returns -1 or
+//errorcode (>1 value) on error, 0 on success.
+//hDevice = Handle to a UE9 device.
+//inNumChannels = The number of channels in each scan (1-16).
+//inResolution = The resolution of the samples (12-16).
+//inSettlingTime = The SettlingTime.
+//inScanConfig = The ScanConfig byte (clock frequency and divide by 256 bits).
+//inScanInterval = The ScanInterval, in clock ticks.
+//inChannelNumbers = An array of the channel number of each channel.
+//inBipGains = An array of the BipGain of each channel.
+
+long ehStreamStart( HANDLE hDevice);
+//Performs a StreamStart call with the UE9.  Returns -1 or errorcode (>1 value)
+//on error, 0 on success.
+
+long ehStreamStop( HANDLE hDevice);
+//Performs a StreamStop call with the UE9.  Returns -1 or errorcode (>1 value)
+//on error, 0 on success.  Errorcode 52 means the stream was not running.
+
+long ehFlushBuffer( HANDLE hDevice);
+//Performs a FlushBuffer call with the UE9, which clears the stream buffer,
+//after a StreamStop.  Use it to clear a Comm buffer overflow.  Returns -1 on
+//error, 0 on success.
+
+
 /* Easy Functions Constants */
 
 /* Ranges */
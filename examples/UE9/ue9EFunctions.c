@@ -37,8 +37,9 @@ int main(int argc, char **argv)
     if( hDevice  == NULL )
         goto done;
 
-    //Get calibration information from UE9
-    error = getCalibrationInfo(hDevice, &caliInfo);
+    //Get calibration information from UE9, keeping a copy in the calibration
+    //cache if its directory exists
+    error = getCalibrationInfoCached(hDevice, &caliInfo, 0);
     if( error < 0 )
         goto close;
 
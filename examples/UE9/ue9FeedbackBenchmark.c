@@ -0,0 +1,206 @@
+//Author: LabJack
+//October 18, 2026
+//Measures the command-response times of the UE9 Feedback command for the
+//mixes of Section 3.1 of the UE9 User's Guide:  no I/O (the response still
+//has the digital I/O states), writing the digital I/O, both DACs, one AIN at
+//each resolution and several AINs in one packet.  Each test sends the same
+//Feedback command many times and prints the mean, median, 99th and 99.9th
+//percentile and maximum round trip in microseconds, so the times of a host
+//can be compared with the Windows times of the User's Guide and with earlier
+//runs.  The DAC test sets DAC0 and DAC1 to 0 V, and the digital write test
+//writes the directions and states the lines already have.  Pass the number
+//of commands per test as an argument (default 2000); a test stops after 10 s
+//if it has sent at least 100 commands.  Build with "make SIM=1" to run
+//against a simulated UE9, and set LJSIM_LATENCY_US to add a USB round trip
+//time.
+
+#include <string.h>
+#include <sys/utsname.h>
+#include "ue9.h"
+
+#define WARMUP_COMMANDS   20
+#define MAX_TEST_SECONDS  10  //A slow test stops early, after at least 100 commands
+
+typedef struct
+{
+    const char *name;
+    int writeDio;       //Write the directions and states the lines have
+    int updateDacs;     //Update DAC0 and DAC1
+    uint16 ainMask;     //AINs read
+    uint8 resolution;
+} FeedbackTest;
+
+static const FeedbackTest tests[] =
+{
+    {"no I/O",                         0, 0, 0,      12},
+    {"write DIO directions and states", 1, 0, 0,      12},
+    {"write DAC0 and DAC1",            0, 1, 0,      12},
+    {"1 AIN, resolution 12",           0, 0, 0x0001, 12},
+    {"1 AIN, resolution 14",           0, 0, 0x0001, 14},
+    {"1 AIN, resolution 16",           0, 0, 0x0001, 16},
+    {"1 AIN, resolution 17",           0, 0, 0x0001, 17},
+    {"1 AIN, resolution 18 (UE9-Pro)", 0, 0, 0x0001, 18},
+    {"4 AIN, resolution 12",           0, 0, 0x000F, 12},
+    {"16 AIN, resolution 12",          0, 0, 0xFFFF, 12},
+    {"16 AIN, resolution 16",          0, 0, 0xFFFF, 16},
+};
+#define NUM_TESTS  (sizeof(tests)/sizeof(tests[0]))
+
+//Sends a Feedback command and reads its response.  Returns -1 on error.
+static int feedback(HANDLE hDevice, uint8 *sendBuff, uint8 *recBuff)
+{
+    uint16 checksumTotal;
+
+    if( LJUSB_Write(hDevice, sendBuff, 34) < 34 )
+    {
+        printf("Feedback error : write failed\n");
+        return -1;
+    }
+    if( LJUSB_Read(hDevice, recBuff, 64) < 64 )
+    {
+        printf("Feedback error : read failed\n");
+        return -1;
+    }
+
+    checksumTotal = extendedChecksum16(recBuff, 64);
+    if( (uint8)((checksumTotal / 256) & 0xff) != recBuff[5] || (uint8)(checksumTotal & 255) != recBuff[4] ||
+        extendedChecksum8(recBuff) != recBuff[0] )
+    {
+        printf("Feedback error : read buffer has bad checksum\n");
+        return -1;
+    }
+    if( recBuff[1] != (uint8)(0xF8) || recBuff[2] != (uint8)(0x1D) || recBuff[3] != (uint8)(0x00) )
+    {
+        printf("Feedback error : read buffer has wrong command bytes\n");
+        return -1;
+    }
+    return 0;
+}
+
+//Builds the Feedback command of a test.  dio is bytes 6-11 of a response, and
+//dacBits the DAC0 and DAC1 values.
+static void buildCommand(const FeedbackTest *test, const uint8 *dio, const uint16 *dacBits, uint8 *sendBuff)
+{
+    int i;
+
+    memset(sendBuff, 0, 34);
+    sendBuff[1] = (uint8)(0xF8);  //Command byte
+    sendBuff[2] = (uint8)(0x0E);  //Number of data words
+    sendBuff[3] = (uint8)(0x00);  //Extended command number
+
+    if( test->writeDio )
+    {
+        sendBuff[6] = 255;      //FIOMask
+        sendBuff[7] = dio[0];   //FIODir
+        sendBuff[8] = dio[1];   //FIOState
+        sendBuff[9] = 255;      //EIOMask
+        sendBuff[10] = dio[2];  //EIODir
+        sendBuff[11] = dio[3];  //EIOState
+        sendBuff[12] = 15;      //CIOMask
+        sendBuff[13] = dio[4];  //CIODirState
+        sendBuff[14] = 7;       //MIOMask
+        sendBuff[15] = dio[5];  //MIODirState
+    }
+
+    //The DACs stay enabled (bit 7), and are only updated (bit 6) by the DAC
+    //test
+    for( i = 0; i < 2; i++ )
+    {
+        sendBuff[16 + i*2] = (uint8)(dacBits[i] & 255);
+        sendBuff[17 + i*2] = (uint8)(dacBits[i]/256) + 128 + (test->updateDacs ? 64 : 0);
+    }
+
+    sendBuff[20] = test->ainMask & 255;  //AINMask (low byte)
+    sendBuff[21] = test->ainMask/256;    //AINMask (high byte)
+    sendBuff[22] = 14;                   //AIN14ChannelNumber
+    sendBuff[23] = 15;                   //AIN15ChannelNumber
+    sendBuff[24] = test->resolution;     //Resolution
+    sendBuff[25] = 0;                    //SettlingTime
+    //BipGains 26-33 are 0 (Gain = 1, unipolar)
+
+    extendedChecksum(sendBuff, 34);
+}
+
+//Runs a test and prints its times.  Returns -1 on error.
+static int runTest(HANDLE hDevice, const FeedbackTest *test, const uint8 *dio, const uint16 *dacBits, int numCommands)
+{
+    LJUSB_StreamAgeStats times;
+    unsigned long long startNs, testStartNs = 0;
+    uint8 sendBuff[34], recBuff[64];
+    int i;
+
+    buildCommand(test, dio, dacBits, sendBuff);
+
+    LJUSB_StreamAgeStatsReset(&times);
+    for( i = -WARMUP_COMMANDS; i < numCommands; i++ )
+    {
+        startNs = LJUSB_GetTimestampNs();
+        if( feedback(hDevice, sendBuff, recBuff) < 0 )
+            return -1;
+        if( i >= 0 )
+            LJUSB_StreamAgeStatsAdd(&times, (LJUSB_GetTimestampNs() - startNs)/1.0e3);
+        else
+            testStartNs = LJUSB_GetTimestampNs();
+        if( times.count >= 100 && LJUSB_GetTimestampNs() - testStartNs > MAX_TEST_SECONDS*1000000000ULL )
+            break;
+    }
+
+    printf("%-32s %6llu %8.1f %8.1f %8.1f %8.1f %8.1f\n", test->name, times.count, times.sumUs/times.count,
+           LJUSB_StreamAgeStatsPercentile(&times, 50), LJUSB_StreamAgeStatsPercentile(&times, 99),
+           LJUSB_StreamAgeStatsPercentile(&times, 99.9), times.maxUs);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    HANDLE hDevice;
+    ue9CalibrationInfo caliInfo;
+    struct utsname host;
+    uint8 sendBuff[34], recBuff[64], dio[6];
+    uint16 dacBits[2];
+    int numCommands = 2000, i, ret = 1;
+    unsigned int t;
+
+    if( argc > 1 )
+        numCommands = atoi(argv[1]);
+    if( numCommands < 1 )
+        numCommands = 1;
+
+    //Open first found UE9 over USB
+    hDevice = openUSBConnection(-1);
+    if( hDevice == NULL )
+        return 1;
+
+    if( getCalibrationInfo(hDevice, &caliInfo) < 0 )
+        goto close;
+
+    for( i = 0; i < 2; i++ )
+    {
+        if( getDacBinVoltCalibrated(&caliInfo, i, 0.0, &dacBits[i]) < 0 )
+            goto close;
+    }
+
+    //The digital write test writes the current directions and states, from
+    //the response of a command that writes nothing
+    memset(dio, 0, sizeof(dio));
+    buildCommand(&tests[0], dio, dacBits, sendBuff);
+    if( feedback(hDevice, sendBuff, recBuff) < 0 )
+        goto close;
+    memcpy(dio, recBuff + 6, 6);
+
+    uname(&host);
+    printf("UE9 Feedback round trip times in us, %d commands per test, %s %s %s\n", numCommands, host.sysname,
+           host.release, host.machine);
+    printf("%-32s %6s %8s %8s %8s %8s %8s\n", "test", "n", "mean", "p50", "p99", "p99.9", "max");
+    for( t = 0; t < NUM_TESTS; t++ )
+    {
+        if( runTest(hDevice, &tests[t], dio, dacBits, numCommands) < 0 )
+            goto close;
+        fflush(stdout);
+    }
+    ret = 0;
+
+close:
+    closeUSBConnection(hDevice);
+    return ret;
+}
@@ -3,6 +3,7 @@
 //This example program reads analog inputs AI0-AI3 using stream mode.
 
 #include "ue9.h"
+#include <errno.h>
 #include <math.h>
 #include <stdio.h>
 
@@ -187,24 +188,29 @@ int StreamStart(HANDLE hDevice)
     return 0;
 }
 
-//Reads the StreamData low-level function response in a loop.  All voltages
-//from the stream are stored in the voltages 2D array.
+//Reads the StreamData low-level function response in a loop.  All samples from
+//the stream are stored as binary codes in the codes array, and only the
+//displayed scans are converted to voltages.
 int StreamData_example(HANDLE hDevice, ue9CalibrationInfo *caliInfo)
 {
-    uint16 voltageBytes, checksumTotal;
-    int recChars, backLog, overflow;
-    int i, j, k, m, packetCounter, currChannel, scanNumber;
-    int totalPackets;  //The total number of StreamData responses read
+    LJUSB_StreamDecoder decoder;
+    LJUSB_StreamChannelCal streamCal;
+    uint8 *recBuff;
+    uint16 *codes;
+    double voltages[LJUSB_STREAM_MAX_CHANNELS];
+    unsigned long recBuffSize;
+    unsigned long totalScans;  //Total scans that will be read.  Meant for
+                               //calculating the size of the codes array.
+    unsigned long long totalPackets;  //The total number of StreamData responses read
+    unsigned long long startTime, timestampNs;
+    long numScans;
+    int recChars, i, j, k, scanNumber;
     int numDisplay;  //Number of times to display streaming information
     int numReadsPerDisplay;  //Number of packets to read before displaying
                              //streaming information
     int readSizeMultiplier;  //Multiplier for the StreamData receive buffer size
-    int totalScans;  //Total scans that will be read  Meant for calculating the
-                     //size of the voltages array.
-    long startTime, endTime;
+    int ret;
 
-    packetCounter = 0;
-    currChannel = 0;
     scanNumber = 0;
     totalPackets = 0;
     recChars = 0;
@@ -212,148 +218,128 @@ int StreamData_example(HANDLE hDevice, ue9CalibrationInfo *caliInfo)
     numReadsPerDisplay = 3;
     readSizeMultiplier = 10;
 
-    /* Each StreamData response contains (16/NUM_CHANNELS) * readSizeMultiplier
-     * samples for each channel.
-     * Total number of scans = (16 / NUM_CHANNELS) * 4 * readSizeMultiplier * numReadsPerDisplay * numDisplay
+    //The decoder stores raw binary codes, 2 bytes per sample.  Use
+    //LJUSB_STREAM_OUTPUT_FLOAT32 or LJUSB_STREAM_OUTPUT_FLOAT64 to have it
+    //store calibrated voltages instead.
+    if( LJUSB_StreamDecoderInit(&decoder, UE9_PRODUCT_ID, NUM_CHANNELS, 0, LJUSB_STREAM_OUTPUT_RAW16) != 0 )
+    {
+        printf("Error : could not set up the stream decoder.\n");
+        return -1;
+    }
+
+    for( i = 0; i < NUM_CHANNELS; i++ )
+    {
+        //BipGain = 0, Resolution = AIN_RESOLUTION (see StreamConfig_example)
+        if( getStreamCalibration(caliInfo, (uint8)(0x00), AIN_RESOLUTION, &streamCal) != 0 )
+            return -1;
+        LJUSB_StreamDecoderSetCal(&decoder, i, &streamCal);
+    }
+
+    /* For USB StreamData, use Endpoint 2 for reads and 192 byte packets
+     * instead of the 46.  The 192 byte response is 4 StreamData packet
+     * responses of 48 bytes.  Each StreamData response contains 16 samples.
+     * Total number of scans = (16 * 4 * readSizeMultiplier * numReadsPerDisplay * numDisplay) / NUM_CHANNELS
      */
-    totalScans = ceil((16.0/NUM_CHANNELS)*4.0*readSizeMultiplier*numReadsPerDisplay*numDisplay);
-    double voltages[totalScans][NUM_CHANNELS];
-    uint8 recBuff[192*readSizeMultiplier];
+    recBuffSize = LJUSB_StreamReadSize(&decoder, 4*readSizeMultiplier);
+    totalScans = (16UL*4*readSizeMultiplier*numReadsPerDisplay*numDisplay)/NUM_CHANNELS;
+    recBuff = (uint8 *)malloc(sizeof(uint8)*recBuffSize);
+    codes = (uint16 *)malloc(sizeof(uint16)*totalScans*NUM_CHANNELS);
+    if( recBuff == NULL || codes == NULL )
+    {
+        printf("Error : could not allocate the stream buffers.\n");
+        ret = -1;
+        goto cleanmem;
+    }
+    ret = 0;
 
     printf("Reading Samples...\n");
 
-    startTime = getTickCount();
+    startTime = LJUSB_GetTimestampNs();
 
     for( i = 0; i < numDisplay; i++ )
     {
         for( j = 0; j < numReadsPerDisplay; j++ )
         {
-            /* For USB StreamData, use Endpoint 2 for reads and 192 byte
-             * packets instead of the 46.  The 192 byte response is 4
-             * StreamData packet responses of 48 bytes.
-             * You can read the multiple StreamData responses of 192 bytes to
+            /* You can read the multiple StreamData responses of 192 bytes to
              * help improve streaming performance.  In this example this
              * multiple is adjusted by the readSizeMultiplier variable.
              */
 
             //Reading response from UE9
-            recChars = LJUSB_Stream(hDevice, recBuff, 192*readSizeMultiplier);
-            if( recChars < 192*readSizeMultiplier )
+            recChars = LJUSB_StreamStampedTO(hDevice, recBuff, recBuffSize, 1000, &timestampNs);
+            if( recChars < recBuffSize )
             {
                 if( recChars == 0 )
                     printf("Error : read failed (StreamData).\n");
                 else
                     printf("Error : did not read all of the buffer %d (StreamData).\n", recChars);
-                return -1;
+                ret = -1;
+                goto cleanmem;
             }
 
-            overflow = 0;
-
             //Checking for errors and getting data out of each StreamData response
-            for( m = 0; m < 4*readSizeMultiplier; m++ )
+            numScans = LJUSB_StreamDecodeStamped(&decoder, recBuff, recChars, timestampNs, codes + scanNumber*NUM_CHANNELS, totalScans - scanNumber);
+            if( numScans < 0 )
             {
-                totalPackets++;
-                checksumTotal = extendedChecksum16(recBuff + m*48, 46);
-                if( (uint8)((checksumTotal >> 8) & 0xff) != recBuff[m*48 + 5] )
-                {
-                    printf("Error : read buffer has bad checksum16(MSB) (StreamData).\n");
-                    return -1;
-                }
-
-                if( (uint8)(checksumTotal & 0xff) != recBuff[m*48 + 4] )
-                {
-                    printf("Error : read buffer has bad checksum16(LSB) (StreamData).\n");
-                    return -1;
-                }
-
-                checksumTotal = extendedChecksum8(recBuff + m*48);
-                if( checksumTotal != recBuff[m*48] )
-                {
-                    printf("Error : read buffer has bad checksum8 (StreamData).\n");
-                    return -1;
-                }
-
-                if( recBuff[m*48 + 1] != (uint8)(0xF9) || recBuff[m*48 + 2] != (uint8)(0x14) || recBuff[m*48 + 3] != (uint8)(0xC0) )
-                {
-                    printf("Error : read buffer has wrong command bytes (StreamData).\n");
-                    return -1;
-                }
-
-                if( recBuff[m*48 + 11] != 0 )
-                {
-                    printf("Errorcode # %d from StreamData read.\n", (unsigned int)recBuff[11]);
-                    return -1;
-                }
-
-                if( packetCounter != (int) recBuff[m*48 + 10] )
-                {
+                if( errno == EIO )
+                    printf("Errorcode # %d from StreamData read.\n", decoder.errorcode);
+                else if( errno == EPROTO )
                     printf("PacketCounter does not match with with current packet count (StreamData).\n");
-                    return -1;
-                }
-
-                backLog = recBuff[m*48 + 45]&0x7F;
+                else
+                    printf("Error : read buffer has bad checksum or command bytes (StreamData).\n");
+                ret = -1;
+                goto cleanmem;
+            }
+            scanNumber += numScans;
 
-                //Checking MSB for Comm buffer overflow
-                if( (recBuff[m*48 + 45] & 128) == 128 )
-                {
-                    printf("\nComm buffer overflow detected in packet %d\n", totalPackets);
-                    printf("Current Comm backlog: %d\n", recBuff[m*48 + 45]&0x7F);
-                    overflow = 1;
-                }
+            //Checking MSB for Comm buffer overflow
+            if( decoder.overflow )
+            {
+                printf("\nComm buffer overflow detected in packet %llu\n", totalPackets + decoder.packets);
+                printf("Current Comm backlog: %d\n", decoder.backlog);
 
-                for( k = 12; k < 43; k += 2 )
+                //Handle Comm buffer overflow by stopping, flushing and restarting stream
+                printf("\nRestarting stream...\n");
+                doFlush(hDevice);
+                if( StreamConfig_example(hDevice) != 0 )
                 {
-                    voltageBytes = (uint16)recBuff[m*48 + k] + (uint16)recBuff[m*48 + k+1]*256;
-                    getAinVoltCalibrated(caliInfo, (uint8)(0x00), AIN_RESOLUTION, voltageBytes, &(voltages[scanNumber][currChannel]));
-                    currChannel++;
-                    if( currChannel >= NUM_CHANNELS )
-                    {
-                        currChannel = 0;
-                        scanNumber++;
-                    }
+                    printf("Error restarting StreamConfig.\n");
+                    ret = -1;
+                    goto cleanmem;
                 }
 
-                if( packetCounter >= 255 )
-                    packetCounter = 0;
-                else
-                    packetCounter++;
-
-                //Handle Comm buffer overflow by stopping, flushing and restarting stream
-                if( overflow == 1 )
+                if( StreamStart(hDevice) != 0 )
                 {
-                    printf("\nRestarting stream...\n");
-                    doFlush(hDevice);
-                    if( StreamConfig_example(hDevice) != 0 )
-                    {
-                        printf("Error restarting StreamConfig.\n");
-                        return -1;
-                    }
-
-                    if( StreamStart(hDevice) != 0 )
-                    {
-                        printf("Error restarting StreamStart.\n");
-                        return -1;
-                    }
-                    packetCounter = 0;
-                    break;
+                    printf("Error restarting StreamStart.\n");
+                    ret = -1;
+                    goto cleanmem;
                 }
+                totalPackets += decoder.packets;
+                LJUSB_StreamDecoderReset(&decoder);
             }
         }
 
         printf("\nNumber of scans: %d\n", scanNumber);
-        printf("Total packets read: %d\n", totalPackets);
-        printf("Current PacketCounter: %d\n", ((packetCounter == 0) ? 255 : packetCounter-1));
-        printf("Current Comm backlog: %d\n", backLog);
-
+        printf("Total packets read: %llu\n", totalPackets + decoder.packets);
+        printf("Current PacketCounter: %d\n", ((decoder.packetCounter == 0) ? 255 : decoder.packetCounter-1));
+        printf("Current Comm backlog: %d\n", decoder.backlog);
+        printf("Last read completed at %.6f s, first sample in scan %llu\n", (decoder.timestampNs - startTime)/1.0e9, decoder.firstScanIndex);
+        printf("Measured scan rate: %.3f scans per second of host time\n", LJUSB_StreamClockScanRate(&decoder.clock));
+
+        //Converting the last scan to voltages
+        LJUSB_StreamConvert(decoder.cal, NUM_CHANNELS, codes + (scanNumber - 1)*NUM_CHANNELS, 1, voltages, LJUSB_STREAM_OUTPUT_FLOAT64);
         for( k = 0; k < NUM_CHANNELS; k++ )
-            printf("  AIN%d: %.4f V\n", k, voltages[scanNumber - 1][k]);
+            printf("  AIN%d: %.4f V\n", k, voltages[k]);
     }
 
-    endTime = getTickCount();
-    printf("\nRate of samples: %.0lf samples per second\n", (scanNumber*NUM_CHANNELS)/((endTime - startTime)/1000.0));
-    printf("Rate of scans: %.0lf scans per second\n\n", scanNumber/((endTime - startTime)/1000.0));
+    printf("\nRate of samples: %.0lf samples per second\n", (scanNumber*NUM_CHANNELS)/((timestampNs - startTime)/1.0e9));
+    printf("Rate of scans: %.0lf scans per second\n\n", scanNumber/((timestampNs - startTime)/1.0e9));
 
-    return 0;
+cleanmem:
+    free(recBuff);
+    free(codes);
+
+    return ret;
 }
 
 //Sends a StreamStop low-level command to stop streaming.
@@ -0,0 +1,276 @@
+//Author: LabJack
+//October 18, 2026
+//Measures the stream throughput of a UE9 over a sweep of stream settings:  the
+//number of channels, the resolution, the StreamData responses in each host
+//read and the reads kept in flight with LJUSB_StreamAsyncStart.  UE9
+//StreamData responses always have 16 samples and are read in groups of 4, so
+//SamplesPerPacket is not swept.  Each setting streams at the maximum sample
+//rate of its resolution (LJUSB_StreamPlanCompute) and reports the scans per
+//second received, the CPU time of the process per scan, the largest backlog
+//of the UE9 Comm stream buffer and the number of buffer overflows (runs of
+//responses with the overflow bit).  A setting is sustained if nothing
+//overflowed and 99% of the scan rate was received.  The results are printed
+//as JSON, and the progress on stderr.
+//Usage: ue9StreamBenchmark [quick|full] [seconds per setting]
+//The quick sweep (default, 1 s per setting) is for CI with a simulated UE9:
+//build with "make SIM=1" and run with LJSIM_DEVICES=UE9.  The full sweep
+//(default 5 s per setting) is for qualifying a new host or kernel with a UE9
+//connected.  Settings whose reads take longer to fill run for 4 reads.  With
+//a simulated UE9 the CPU time includes the simulation.  The stream buffer is
+//flushed after each setting.  Returns 1 if a setting fails.
+
+#include <errno.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/utsname.h>
+#include "ue9.h"
+
+#define MAX_SWEEP_VALUES  4
+#define MAX_READ_PACKETS  64
+#define NUM_AIN           14
+
+typedef struct
+{
+    int count;
+    int values[MAX_SWEEP_VALUES];
+} SweepValues;
+
+typedef struct
+{
+    const char *mode;
+    double seconds;  //Default seconds per setting
+    SweepValues channels;
+    SweepValues resolutions;
+    SweepValues samplesPerPacket;
+    SweepValues packetsPerRead;
+    SweepValues transfers;
+} Sweep;
+
+static const Sweep sweeps[] =
+{
+    {"quick", 1, {2, {1, 4}}, {1, {12}}, {1, {16}}, {2, {4, 16}}, {2, {1, 8}}},
+    {"full", 5, {3, {1, 4, 16}}, {3, {12, 14, 16}}, {1, {16}}, {3, {4, 16, 64}}, {3, {1, 4, 16}}},
+};
+#define NUM_SWEEPS  (sizeof(sweeps)/sizeof(sweeps[0]))
+
+typedef struct
+{
+    LJUSB_StreamDecoder decoder;
+    unsigned short scans[MAX_READ_PACKETS*16 + LJUSB_STREAM_MAX_CHANNELS];
+    unsigned long long startNs;
+    unsigned long long lastNs;   //Completion time of the last read
+    int error;                   //errno of a failed read or decode, or 0
+} BenchState;
+
+static BenchState state;
+
+static double getCpuSeconds()
+{
+    struct rusage usage;
+
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec/1.0e6 + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec/1.0e6;
+}
+
+static void streamCallback(BYTE *pBuff, unsigned long count, unsigned long long timestampNs, int error, void *userData)
+{
+    BenchState *s = (BenchState *)userData;
+
+    if( s->error != 0 )
+        return;
+    if( error != 0 )
+    {
+        s->error = error;
+        return;
+    }
+    if( LJUSB_StreamDecode(&s->decoder, pBuff, count, s->scans, LJUSB_StreamMaxScans(&s->decoder, count)) < 0 )
+    {
+        s->error = errno;
+        return;
+    }
+    s->lastNs = timestampNs;
+}
+
+//Plans the fastest stream of a resolution.  Returns -1 on error.
+static int planSetting(int numChannels, int resolution, int packetsPerRead, LJUSB_StreamPlan *plan)
+{
+    double scanRate;
+
+    if( LJUSB_StreamPlanCompute(UE9_PRODUCT_ID, numChannels, 1, resolution, 0, plan) != 0 )
+        return -1;
+
+    //The closest ScanInterval can be slightly faster than the maximum
+    scanRate = plan->maxSampleRate/numChannels;
+    while( LJUSB_StreamPlanCompute(UE9_PRODUCT_ID, numChannels, scanRate, resolution, 0, plan) != 0 )
+    {
+        if( errno != ERANGE )
+            return -1;
+        scanRate *= 0.999;
+    }
+
+    plan->packetsPerRead = packetsPerRead;
+    plan->readSize = packetsPerRead*plan->packetSize;
+    return 0;
+}
+
+//Streams one setting and prints its JSON result.  Returns -1 on error.
+static int runSetting(HANDLE hDevice, int numChannels, int resolution, int samplesPerPacket, int packetsPerRead,
+                      int transfers, double seconds)
+{
+    LJUSB_StreamPlan plan;
+    LJUSB_StreamAsync *async = NULL;
+    uint8 channelNumbers[LJUSB_STREAM_MAX_CHANNELS], bipGains[LJUSB_STREAM_MAX_CHANNELS];
+    unsigned long long beforeNs, endNs, scans = 0;
+    double fillSeconds, cpuStart, cpuSeconds = 0, elapsed = 0, scansPerSecond;
+    const char *failure = NULL;
+    int i;
+
+    memset(&plan, 0, sizeof(plan));
+    fprintf(stderr, "%d channels, resolution %d, %d samples per packet, %d packets per read, %d transfers\n",
+            numChannels, resolution, samplesPerPacket, packetsPerRead, transfers);
+
+    if( planSetting(numChannels, resolution, packetsPerRead, &plan) != 0 )
+    {
+        failure = "LJUSB_StreamPlanCompute failed";
+        goto print;
+    }
+    fillSeconds = (double)packetsPerRead*samplesPerPacket/plan.sampleRate;
+    if( seconds < 4*fillSeconds )
+        seconds = 4*fillSeconds;
+
+    for( i = 0; i < numChannels; i++ )
+    {
+        channelNumbers[i] = i % NUM_AIN;
+        bipGains[i] = 0;  //Unipolar, gain x1
+    }
+    ehStreamStop(hDevice);  //In case a previous program left a stream running
+    ehFlushBuffer(hDevice);
+    if( ehStreamConfig(hDevice, numChannels, resolution, 0, plan.scanConfig, plan.scanInterval, channelNumbers,
+                       bipGains) != 0 )
+    {
+        failure = "StreamConfig failed";
+        goto print;
+    }
+    if( LJUSB_StreamDecoderInit(&state.decoder, UE9_PRODUCT_ID, numChannels, samplesPerPacket, LJUSB_STREAM_OUTPUT_RAW16) != 0 )
+    {
+        failure = "LJUSB_StreamDecoderInit failed";
+        goto print;
+    }
+    state.error = 0;
+
+    cpuStart = getCpuSeconds();
+    async = LJUSB_StreamAsyncStart(hDevice, plan.readSize, transfers, (unsigned int)(2000*fillSeconds) + 1000,
+                                   streamCallback, &state);
+    if( async == NULL )
+    {
+        failure = "LJUSB_StreamAsyncStart failed";
+        goto print;
+    }
+    beforeNs = LJUSB_GetTimestampNs();
+    if( ehStreamStart(hDevice) != 0 )
+    {
+        failure = "StreamStart failed";
+        goto stop;
+    }
+    state.startNs = beforeNs + (LJUSB_GetTimestampNs() - beforeNs)/2;
+    state.lastNs = state.startNs;
+
+    endNs = state.startNs + (unsigned long long)(seconds*1.0e9);
+    while( state.error == 0 && LJUSB_GetTimestampNs() < endNs )
+    {
+        if( LJUSB_StreamAsyncHandleEvents(async, 100) < 0 && state.error == 0 )
+            state.error = errno;
+    }
+    if( state.error != 0 )
+        failure = strerror(state.error);
+
+stop:
+    LJUSB_StreamAsyncStop(async);
+    cpuSeconds = getCpuSeconds() - cpuStart;
+    ehStreamStop(hDevice);
+    ehFlushBuffer(hDevice);
+    scans = state.decoder.scanIndex - state.decoder.droppedScans;
+    elapsed = (state.lastNs - state.startNs)/1.0e9;
+
+print:
+    printf("    {\"channels\": %d, \"resolution\": %d, \"samplesPerPacket\": %d, \"packetsPerRead\": %d, "
+           "\"readSize\": %lu, \"transfers\": %d, \"scanRate\": %.3f, ", numChannels, resolution, samplesPerPacket,
+           packetsPerRead, plan.readSize, transfers, plan.scanRate);
+    if( failure != NULL )
+    {
+        printf("\"error\": \"%s\"}", failure);
+        return -1;
+    }
+    scansPerSecond = (elapsed > 0) ? scans/elapsed : 0;
+    printf("\"seconds\": %.3f, \"scans\": %llu, \"scansPerSecond\": %.1f, \"cpuPerScanUs\": %.4f, "
+           "\"maxBacklog\": %d, \"overflows\": %llu, \"droppedScans\": %llu, \"sustained\": %s}",
+           elapsed, scans, scansPerSecond, (scans > 0) ? cpuSeconds*1.0e6/scans : 0, state.decoder.maxBacklog,
+           state.decoder.overflows, state.decoder.droppedScans,
+           (state.decoder.overflows == 0 && scansPerSecond >= 0.99*plan.scanRate) ? "true" : "false");
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    HANDLE hDevice;
+    const Sweep *sweep = NULL;
+    struct utsname host;
+    double seconds;
+    int numSettings, n, k, c, r, s, p, t, first = 1, ret = 0;
+    unsigned int i;
+
+    for( i = 0; i < NUM_SWEEPS; i++ )
+    {
+        if( argc < 2 || strcmp(argv[1], sweeps[i].mode) == 0 )
+        {
+            sweep = &sweeps[i];
+            break;
+        }
+    }
+    seconds = (sweep != NULL) ? sweep->seconds : 0;
+    if( argc > 2 )
+        seconds = atof(argv[2]);
+    if( sweep == NULL || !(seconds > 0) )
+    {
+        printf("Usage: %s [quick|full] [seconds per setting]\n", argv[0]);
+        return 1;
+    }
+
+    //Open first found UE9 over USB
+    hDevice = openUSBConnection(-1);
+    if( hDevice == NULL )
+        return 1;
+
+    uname(&host);
+    printf("{\n  \"benchmark\": \"ue9StreamBenchmark\",\n  \"device\": \"UE9\",\n  \"mode\": \"%s\",\n"
+           "  \"secondsPerSetting\": %g,\n  \"host\": {\"sysname\": \"%s\", \"release\": \"%s\", \"machine\": \"%s\"},\n"
+           "  \"results\": [\n", sweep->mode, seconds, host.sysname, host.release, host.machine);
+
+    //Every combination of the sweep values, the transfers changing fastest
+    numSettings = sweep->channels.count*sweep->resolutions.count*sweep->samplesPerPacket.count*
+                  sweep->packetsPerRead.count*sweep->transfers.count;
+    for( n = 0; n < numSettings && ret == 0; n++ )
+    {
+        k = n;
+        t = k % sweep->transfers.count;
+        k /= sweep->transfers.count;
+        p = k % sweep->packetsPerRead.count;
+        k /= sweep->packetsPerRead.count;
+        s = k % sweep->samplesPerPacket.count;
+        k /= sweep->samplesPerPacket.count;
+        r = k % sweep->resolutions.count;
+        c = k/sweep->resolutions.count;
+        printf("%s", first ? "" : ",\n");
+        fflush(stdout);
+        first = 0;
+        if( runSetting(hDevice, sweep->channels.values[c], sweep->resolutions.values[r],
+                       sweep->samplesPerPacket.values[s], sweep->packetsPerRead.values[p],
+                       sweep->transfers.values[t], seconds) != 0 )
+            ret = 1;
+        fflush(stdout);
+    }
+    printf("\n  ]\n}\n");
+
+    closeUSBConnection(hDevice);
+    return ret;
+}
@@ -0,0 +1,419 @@
+//---------------------------------------------------------------------------
+//
+//  labjackfilter.c
+//
+//    Stream decimation filters (boxcar, CIC and FIR) for U3, U6 and UE9
+//    stream scans.
+//
+//  support@labjack.com
+//
+//  SPDX-FileCopyrightText: Copyright (c) 2009 LabJack Corporation
+//  SPDX-License-Identifier: X11
+//
+//---------------------------------------------------------------------------
+//
+
+#include "labjackfilter.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#define LJUSB_FILTER_SSE
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define LJUSB_FILTER_NEON
+#endif
+
+// Scans summed in float by a boxcar filter before they are added to its
+// double sums, so long averages keep their precision
+#define LJUSB_FILTER_FLUSH_SCANS    256
+
+
+struct LJUSB_StreamFilter
+{
+    unsigned int numChannels;
+    int type;
+    unsigned int ratio;
+    unsigned int phase;             // Input scans since the last output scan
+    double delay;
+
+    // Boxcar
+    float part[LJUSB_STREAM_MAX_CHANNELS];  // Sum of the last partScans scans
+    unsigned int partScans;
+    double sum[LJUSB_STREAM_MAX_CHANNELS];
+
+    // FIR and CIC
+    unsigned int numTaps;           // A multiple of 4, the taps padded with
+                                    // zeros
+    float *taps;                    // Reversed: taps[numTaps - 1] applies to
+                                    // the newest scan
+    float *history;                 // Of each channel, the last numTaps scans
+                                    // twice in a row, so that they are always
+                                    // contiguous
+    unsigned int pos;               // Oldest scan of each history, and where
+                                    // the next scan goes
+};
+
+
+// acc[0..n-1] += x[0..n-1]
+static void LJUSB_FilterAdd(float *acc, const float *x, unsigned int n)
+{
+    unsigned int i = 0;
+
+#if defined(LJUSB_FILTER_SSE)
+    for (; i + 4 <= n; i += 4) {
+        _mm_storeu_ps(acc + i, _mm_add_ps(_mm_loadu_ps(acc + i), _mm_loadu_ps(x + i)));
+    }
+#elif defined(LJUSB_FILTER_NEON)
+    for (; i + 4 <= n; i += 4) {
+        vst1q_f32(acc + i, vaddq_f32(vld1q_f32(acc + i), vld1q_f32(x + i)));
+    }
+#endif
+    for (; i < n; i++) {
+        acc[i] += x[i];
+    }
+}
+
+
+// Returns the dot product of a and b, n a multiple of 4
+static float LJUSB_FilterDot(const float *a, const float *b, unsigned int n)
+{
+    unsigned int i = 0;
+
+#if defined(LJUSB_FILTER_SSE)
+    // Two accumulators, so that each add does not wait for the previous one
+    __m128 s0 = _mm_setzero_ps();
+    __m128 s1 = _mm_setzero_ps();
+    float t[4];
+
+    for (; i + 8 <= n; i += 8) {
+        s0 = _mm_add_ps(s0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        s1 = _mm_add_ps(s1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+    if (i < n) {
+        s0 = _mm_add_ps(s0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    }
+    _mm_storeu_ps(t, _mm_add_ps(s0, s1));
+    return (t[0] + t[1]) + (t[2] + t[3]);
+#elif defined(LJUSB_FILTER_NEON)
+    float32x4_t s0 = vdupq_n_f32(0);
+    float32x4_t s1 = vdupq_n_f32(0);
+
+    for (; i + 8 <= n; i += 8) {
+        s0 = vmlaq_f32(s0, vld1q_f32(a + i), vld1q_f32(b + i));
+        s1 = vmlaq_f32(s1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+    }
+    if (i < n) {
+        s0 = vmlaq_f32(s0, vld1q_f32(a + i), vld1q_f32(b + i));
+    }
+    s0 = vaddq_f32(s0, s1);
+    return (vgetq_lane_f32(s0, 0) + vgetq_lane_f32(s0, 1)) + (vgetq_lane_f32(s0, 2) + vgetq_lane_f32(s0, 3));
+#else
+    float s[4] = {0, 0, 0, 0};
+
+    for (; i < n; i += 4) {
+        s[0] += a[i]*b[i];
+        s[1] += a[i + 1]*b[i + 1];
+        s[2] += a[i + 2]*b[i + 2];
+        s[3] += a[i + 3]*b[i + 3];
+    }
+    return (s[0] + s[1]) + (s[2] + s[3]);
+#endif
+}
+
+
+static LJUSB_StreamFilter *LJUSB_FilterAlloc(unsigned int numChannels, int type, unsigned int ratio)
+{
+    LJUSB_StreamFilter *filter;
+
+    if (numChannels < 1 || numChannels > LJUSB_STREAM_MAX_CHANNELS || ratio < 1) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    filter = (LJUSB_StreamFilter *)calloc(1, sizeof(LJUSB_StreamFilter));
+    if (filter == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    filter->numChannels = numChannels;
+    filter->type = type;
+    filter->ratio = ratio;
+    return filter;
+}
+
+
+// Sets the taps of a FIR or CIC filter, h[0] applied to the newest scan
+static int LJUSB_FilterSetTaps(LJUSB_StreamFilter *filter, const double *h, unsigned int numTaps)
+{
+    double sum = 0, moment = 0;
+    unsigned int k;
+
+    filter->numTaps = (numTaps + 3) & ~3u;
+    filter->taps = (float *)calloc(filter->numTaps, sizeof(float));
+    filter->history = (float *)calloc((size_t)filter->numChannels*2*filter->numTaps, sizeof(float));
+    if (filter->taps == NULL || filter->history == NULL) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    for (k = 0; k < numTaps; k++) {
+        filter->taps[filter->numTaps - 1 - k] = (float)h[k];
+        sum += h[k];
+        moment += k*h[k];
+    }
+
+    // The centroid of the taps is the delay at DC, (numTaps - 1)/2 for the
+    // symmetric taps of the designed filters
+    filter->delay = (sum != 0) ? moment/sum : (numTaps - 1)/2.0;
+    return 0;
+}
+
+
+int LJUSB_StreamFilterDesign(float *taps, unsigned int numTaps, double cutoff)
+{
+    double h, m, x, sum = 0;
+    unsigned int k;
+
+    if (taps == NULL || numTaps < 1 || numTaps > LJUSB_FILTER_MAX_TAPS || !(cutoff > 0) || cutoff > 0.5) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    m = numTaps - 1;
+    for (k = 0; k < numTaps; k++) {
+        x = k - m/2;
+        h = (x == 0) ? 2*cutoff : sin(2*M_PI*cutoff*x)/(M_PI*x);
+        if (numTaps > 1) {
+            h *= 0.42 - 0.5*cos(2*M_PI*k/m) + 0.08*cos(4*M_PI*k/m);
+        }
+        taps[k] = (float)h;
+        sum += h;
+    }
+
+    for (k = 0; k < numTaps; k++) {
+        taps[k] = (float)(taps[k]/sum);
+    }
+    return 0;
+}
+
+
+LJUSB_StreamFilter *LJUSB_StreamFilterCreate(unsigned int numChannels, int type, unsigned int ratio, unsigned int param)
+{
+    LJUSB_StreamFilter *filter;
+    double *h, *prev, run;
+    float *taps;
+    unsigned int numTaps = 0, order, k;
+
+    if (type == LJUSB_FILTER_BOXCAR) {
+        if (ratio > LJUSB_FILTER_MAX_RATIO) {
+            errno = EINVAL;
+            return NULL;
+        }
+        filter = LJUSB_FilterAlloc(numChannels, type, ratio);
+        if (filter != NULL) {
+            filter->delay = (ratio - 1)/2.0;
+        }
+        return filter;
+    }
+
+    if (ratio < 1 ||
+        (type == LJUSB_FILTER_CIC && (param < 1 || param > LJUSB_FILTER_MAX_CIC_ORDER ||
+                                      (unsigned long long)param*(ratio - 1) + 1 > LJUSB_FILTER_MAX_TAPS)) ||
+        (type == LJUSB_FILTER_FIR && param > LJUSB_FILTER_MAX_TAPS) ||
+        (type != LJUSB_FILTER_CIC && type != LJUSB_FILTER_FIR)) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    h = (double *)malloc(2*LJUSB_FILTER_MAX_TAPS*sizeof(double));
+    taps = (float *)malloc(LJUSB_FILTER_MAX_TAPS*sizeof(float));
+    if (h == NULL || taps == NULL) {
+        free(h);
+        free(taps);
+        errno = ENOMEM;
+        return NULL;
+    }
+    prev = h + LJUSB_FILTER_MAX_TAPS;
+
+    if (type == LJUSB_FILTER_CIC) {
+        // The impulse response of param boxcars of ratio taps, each scaled to
+        // a gain of 1 at DC, as a running sum of the previous response
+        numTaps = 1;
+        h[0] = 1;
+        for (order = 0; order < param; order++) {
+            memcpy(prev, h, numTaps*sizeof(double));
+            run = 0;
+            for (k = 0; k < numTaps + ratio - 1; k++) {
+                if (k < numTaps) {
+                    run += prev[k];
+                }
+                if (k >= ratio && k - ratio < numTaps) {
+                    run -= prev[k - ratio];
+                }
+                h[k] = run/ratio;
+            }
+            numTaps += ratio - 1;
+        }
+    }
+    else {
+        numTaps = param;
+        if (numTaps == 0) {
+            numTaps = (16ull*ratio + 1 > LJUSB_FILTER_MAX_TAPS) ? LJUSB_FILTER_MAX_TAPS - 1 : 16*ratio + 1;
+        }
+        LJUSB_StreamFilterDesign(taps, numTaps, LJUSB_FILTER_FIR_CUTOFF*0.5/ratio);
+        for (k = 0; k < numTaps; k++) {
+            h[k] = taps[k];
+        }
+    }
+
+    filter = LJUSB_FilterAlloc(numChannels, type, ratio);
+    if (filter != NULL && LJUSB_FilterSetTaps(filter, h, numTaps) != 0) {
+        LJUSB_StreamFilterDestroy(filter);
+        filter = NULL;
+    }
+    free(h);
+    free(taps);
+    return filter;
+}
+
+
+LJUSB_StreamFilter *LJUSB_StreamFilterCreateTaps(unsigned int numChannels, unsigned int ratio, const float *taps, unsigned int numTaps)
+{
+    LJUSB_StreamFilter *filter;
+    double *h;
+    unsigned int k;
+
+    if (taps == NULL || numTaps < 1 || numTaps > LJUSB_FILTER_MAX_TAPS) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    h = (double *)malloc(numTaps*sizeof(double));
+    if (h == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    for (k = 0; k < numTaps; k++) {
+        h[k] = taps[k];
+    }
+
+    filter = LJUSB_FilterAlloc(numChannels, LJUSB_FILTER_FIR, ratio);
+    if (filter != NULL && LJUSB_FilterSetTaps(filter, h, numTaps) != 0) {
+        LJUSB_StreamFilterDestroy(filter);
+        filter = NULL;
+    }
+    free(h);
+    return filter;
+}
+
+
+unsigned long LJUSB_StreamFilterMaxScans(const LJUSB_StreamFilter *filter, unsigned long numScans)
+{
+    return (filter->phase + numScans)/filter->ratio;
+}
+
+
+long LJUSB_StreamFilterProcess(LJUSB_StreamFilter *filter, const float *pIn, unsigned long numScans, float *pOut, unsigned long maxScans)
+{
+    unsigned int nc, numTaps, c;
+    unsigned long s, n = 0;
+    const float *x;
+    float *y, *h;
+
+    if (filter == NULL || pIn == NULL || pOut == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+    nc = filter->numChannels;
+    numTaps = filter->numTaps;
+
+    if (LJUSB_StreamFilterMaxScans(filter, numScans) > maxScans) {
+        errno = ENOBUFS;
+        return -1;
+    }
+
+    // Each input scan is used before an output scan is stored, and output
+    // scans are never ahead of input scans, so pOut can be pIn
+    if (filter->type == LJUSB_FILTER_BOXCAR) {
+        for (s = 0; s < numScans; s++) {
+            LJUSB_FilterAdd(filter->part, pIn + s*nc, nc);
+            filter->partScans++;
+            filter->phase++;
+
+            if (filter->phase == filter->ratio || filter->partScans == LJUSB_FILTER_FLUSH_SCANS) {
+                for (c = 0; c < nc; c++) {
+                    filter->sum[c] += filter->part[c];
+                    filter->part[c] = 0;
+                }
+                filter->partScans = 0;
+            }
+
+            if (filter->phase == filter->ratio) {
+                y = pOut + n*nc;
+                for (c = 0; c < nc; c++) {
+                    y[c] = (float)(filter->sum[c]/filter->ratio);
+                    filter->sum[c] = 0;
+                }
+                filter->phase = 0;
+                n++;
+            }
+        }
+        return n;
+    }
+
+    for (s = 0; s < numScans; s++) {
+        x = pIn + s*nc;
+        h = filter->history;
+        for (c = 0; c < nc; c++, h += 2*numTaps) {
+            h[filter->pos] = x[c];
+            h[filter->pos + numTaps] = x[c];
+        }
+        filter->pos = (filter->pos + 1 == numTaps) ? 0 : filter->pos + 1;
+
+        // Only the scans kept are computed
+        if (++filter->phase == filter->ratio) {
+            y = pOut + n*nc;
+            h = filter->history + filter->pos;
+            for (c = 0; c < nc; c++, h += 2*numTaps) {
+                y[c] = LJUSB_FilterDot(filter->taps, h, numTaps);
+            }
+            filter->phase = 0;
+            n++;
+        }
+    }
+    return n;
+}
+
+
+double LJUSB_StreamFilterDelay(const LJUSB_StreamFilter *filter)
+{
+    return filter->delay;
+}
+
+
+void LJUSB_StreamFilterReset(LJUSB_StreamFilter *filter)
+{
+    filter->phase = 0;
+    filter->partScans = 0;
+    memset(filter->part, 0, sizeof(filter->part));
+    memset(filter->sum, 0, sizeof(filter->sum));
+    filter->pos = 0;
+    if (filter->history != NULL) {
+        memset(filter->history, 0, (size_t)filter->numChannels*2*filter->numTaps*sizeof(float));
+    }
+}
+
+
+void LJUSB_StreamFilterDestroy(LJUSB_StreamFilter *filter)
+{
+    if (filter == NULL) {
+        return;
+    }
+    free(filter->taps);
+    free(filter->history);
+    free(filter);
+}
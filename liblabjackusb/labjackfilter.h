@@ -0,0 +1,139 @@
+//-----------------------------------------------------------------------------
+//
+//  labjackfilter.h
+//
+//  Header file for the stream decimation filters of the labjackusb library.
+//  Low-pass filters and decimates scans of volts decoded with
+//  LJUSB_STREAM_OUTPUT_FLOAT32, channel by channel, so that consumers which
+//  only need a fraction of the stream rate get fewer, cleaner scans.
+//
+//  support@labjack.com
+//
+//  SPDX-FileCopyrightText: Copyright (c) 2009 LabJack Corporation
+//  SPDX-License-Identifier: X11
+//
+//-----------------------------------------------------------------------------
+//
+
+#ifndef LABJACKFILTER_H_
+#define LABJACKFILTER_H_
+
+#include "labjackstream.h"
+
+//Stream filter types
+#define LJUSB_FILTER_BOXCAR           0  //Average of each ratio scans
+#define LJUSB_FILTER_CIC              1  //Cascade of boxcars (sinc^order response)
+#define LJUSB_FILTER_FIR              2  //Windowed-sinc low-pass FIR
+
+//Maximum number of FIR taps, and of CIC taps (order*(ratio - 1) + 1)
+#define LJUSB_FILTER_MAX_TAPS         4096
+
+//Maximum order of a CIC filter
+#define LJUSB_FILTER_MAX_CIC_ORDER    6
+
+//Maximum decimation ratio of a boxcar filter
+#define LJUSB_FILTER_MAX_RATIO        1048576
+
+//Cutoff of the FIR filters of LJUSB_StreamFilterCreate, as a fraction of the
+//output Nyquist frequency
+#define LJUSB_FILTER_FIR_CUTOFF       0.8
+
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+
+//Stream decimation filter, from LJUSB_StreamFilterCreate
+typedef struct LJUSB_StreamFilter LJUSB_StreamFilter;
+
+
+LJUSB_StreamFilter *LJUSB_StreamFilterCreate(unsigned int numChannels, int type, unsigned int ratio, unsigned int param);
+// Creates a filter that keeps one scan out of every ratio, low-pass filtered
+// on each channel.  Only the scans kept are computed, so each input scan costs
+// about numTaps/ratio multiply-adds per channel (a polyphase decimator), and 1
+// add for a boxcar filter; the cost does not depend on the data and no memory
+// is allocated after this call, so LJUSB_StreamFilterProcess can be called in
+// the thread reading the stream.  With SSE or NEON when available, a boxcar
+// filter sums 4 channels at a time, and a CIC or FIR filter computes each
+// channel 4 taps at a time.  Returns the filter, or NULL on error and errno
+// is set.
+// numChannels = The number of channels in each scan (1 to
+//               LJUSB_STREAM_MAX_CHANNELS).
+// type = LJUSB_FILTER_BOXCAR: the average of each ratio scans.  The
+//        cheapest, with a sinc response whose first null is at the output
+//        rate, so it rejects line frequency noise when the output rate is 50
+//        or 60 Hz.
+//        LJUSB_FILTER_CIC: param boxcars in cascade (a CIC decimator), for
+//        better alias rejection near the nulls at multiples of the output
+//        rate.
+//        LJUSB_FILTER_FIR: a Blackman windowed-sinc low-pass with param taps
+//        and its cutoff at LJUSB_FILTER_FIR_CUTOFF of the output Nyquist
+//        frequency, for a flat pass band and about 74 dB of stop band.  Use
+//        LJUSB_StreamFilterCreateTaps for other responses.
+// ratio = The decimation ratio, 1 or more.
+// param = The order of a CIC filter (1 to LJUSB_FILTER_MAX_CIC_ORDER), or the
+//         number of taps of a FIR filter (0 for 16*ratio + 1, up to
+//         LJUSB_FILTER_MAX_TAPS).  Ignored for a boxcar filter.
+
+LJUSB_StreamFilter *LJUSB_StreamFilterCreateTaps(unsigned int numChannels, unsigned int ratio, const float *taps, unsigned int numTaps);
+// Creates a FIR decimation filter with the given taps, for example from
+// LJUSB_StreamFilterDesign.  Returns the filter, or NULL on error and errno
+// is set.
+// numChannels = The number of channels in each scan.
+// ratio = The decimation ratio, 1 or more.
+// taps = The impulse response, taps[0] applied to the newest scan.
+// numTaps = The number of taps (1 to LJUSB_FILTER_MAX_TAPS).
+
+int LJUSB_StreamFilterDesign(float *taps, unsigned int numTaps, double cutoff);
+// Computes the taps of a Blackman windowed-sinc low-pass filter with a gain
+// of 1 at DC.  Returns 0 on success, or -1 on error and errno is set.
+// taps = Returns the numTaps taps.
+// numTaps = The number of taps.  More taps give a sharper transition; the
+//           transition is about 5.5/numTaps of the input rate wide.
+// cutoff = The cutoff frequency as a fraction of the input rate (0 to 0.5).
+
+long LJUSB_StreamFilterProcess(LJUSB_StreamFilter *filter, const float *pIn, unsigned long numScans, float *pOut, unsigned long maxScans);
+// Filters scans and stores the decimated scans, channel-interleaved like the
+// input.  Scans are kept across calls, so any number of scans can be passed
+// in each call.  A scan is output after every ratio input scans; the first
+// outputs of a FIR or CIC filter include the zeros it starts with.  NaN fill
+// scans of gaps (LJUSB_StreamDecoderSetGapFill) make the outputs they are
+// part of NaN.  Returns the number of scans stored in pOut, or -1 on error
+// and errno is set:
+//   EINVAL - filter, pIn or pOut is NULL
+//   ENOBUFS - maxScans is too small (see LJUSB_StreamFilterMaxScans)
+// filter = The filter.
+// pIn = The scans, numScans*numChannels floats, from LJUSB_StreamDecode with
+//       LJUSB_STREAM_OUTPUT_FLOAT32 or LJUSB_StreamConvert.
+// numScans = The number of scans in pIn.
+// pOut = The buffer for the decimated scans, maxScans*numChannels floats.
+//        May be pIn, to filter in place.
+// maxScans = The number of scans pOut can hold.
+
+unsigned long LJUSB_StreamFilterMaxScans(const LJUSB_StreamFilter *filter, unsigned long numScans);
+// Returns the number of scans LJUSB_StreamFilterProcess stores for numScans
+// more input scans.
+// filter = The filter.
+// numScans = The number of input scans.
+
+double LJUSB_StreamFilterDelay(const LJUSB_StreamFilter *filter);
+// Returns the delay of the filter in input scans: the n-th output scan (from
+// 0) is centered on input scan (n + 1)*ratio - 1 - delay, for timestamping it
+// with LJUSB_StreamClockScanTime.
+// filter = The filter.
+
+void LJUSB_StreamFilterReset(LJUSB_StreamFilter *filter);
+// Discards the scans kept by a filter, for when a stream is restarted.
+// filter = The filter.
+
+void LJUSB_StreamFilterDestroy(LJUSB_StreamFilter *filter);
+// Frees a filter.
+// filter = The filter.
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LABJACKFILTER_H_
@@ -0,0 +1,260 @@
+//---------------------------------------------------------------------------
+//
+//  labjacki2c.c
+//
+//    I2C transaction engine for U3, U6 and UE9 devices.
+//
+//  support@labjack.com
+//
+//  SPDX-FileCopyrightText: Copyright (c) 2009 LabJack Corporation
+//  SPDX-License-Identifier: X11
+//
+//---------------------------------------------------------------------------
+//
+
+#include "labjacki2c.h"
+#include <string.h>
+#include <errno.h>
+
+
+static void LJUSB_I2CChecksum(BYTE *b, unsigned int n)
+{
+    unsigned int i, a = 0, bb;
+
+    //Sums bytes 6 to n-1 to an unsigned 2 byte value for checksum16
+    for (i = 6; i < n; i++) {
+        a += b[i];
+    }
+    b[4] = (BYTE)(a & 0xFF);
+    b[5] = (BYTE)((a >> 8) & 0xFF);
+
+    //Sums bytes 1 to 5.  Sums quotient and remainder of 256 division.  Again,
+    //sums quotient and remainder of 256 division.
+    a = 0;
+    for (i = 1; i < 6; i++) {
+        a += b[i];
+    }
+    bb = a / 256;
+    a = (a - 256*bb) + bb;
+    bb = a / 256;
+    b[0] = (BYTE)((a - 256*bb) + bb);
+}
+
+
+// Checks the response of a transaction and stores its results.  Returns 0 on
+// success, or -1 and sets errno.
+static int LJUSB_I2CCheckResponse(LJUSB_I2CTransaction *t, int recChars)
+{
+    BYTE check[LJUSB_I2C_PACKET_SIZE];
+    unsigned int expectedAck;
+
+    if (recChars < (int)t->recSize) {
+        if (recChars >= 7) {
+            t->errorcode = t->recBuff[6];
+        }
+        errno = EIO;
+        return -1;
+    }
+
+    memcpy(check, t->recBuff, t->recSize);
+    LJUSB_I2CChecksum(check, t->recSize);
+    if (check[0] != t->recBuff[0] || check[4] != t->recBuff[4] || check[5] != t->recBuff[5]) {
+        errno = EBADMSG;
+        return -1;
+    }
+
+    if (t->recBuff[1] != (BYTE)(0xF8) || t->recBuff[2] != (BYTE)((t->recSize - 6)/2) ||
+        t->recBuff[3] != (BYTE)(0x3B)) {
+        errno = EBADMSG;
+        return -1;
+    }
+
+    t->errorcode = t->recBuff[6];
+    t->ackArray = t->recBuff[8] | (t->recBuff[9] << 8) | (t->recBuff[10] << 16) |
+                  ((unsigned int)t->recBuff[11] << 24);
+
+    //The address and each byte sent are acked in consecutive bits
+    if (t->numBytesToSend + 1 >= 32) {
+        expectedAck = 0xFFFFFFFF;
+    }
+    else {
+        expectedAck = (1u << (t->numBytesToSend + 1)) - 1;
+    }
+    t->acked = (t->ackArray == expectedAck) ? 1 : 0;
+
+    return 0;
+}
+
+
+// Ends a batch after an error.  The responses of the commands written after
+// the failed one are read and discarded, so the next batch does not take
+// them for its own.  Returns -1 with errno set to error.
+static int LJUSB_I2CAbort(LJUSB_I2CEngine *engine, unsigned int numWritten, int error)
+{
+    LJUSB_I2CTransaction *t;
+    BYTE discard[LJUSB_I2C_PACKET_SIZE];
+    unsigned int i;
+
+    for (i = engine->numDone + 1; i < numWritten; i++) {
+        t = &engine->queue[i];
+        LJUSB_Read(engine->hDevice, discard, t->recSize);
+    }
+    engine->numQueued = engine->numDone;
+
+    errno = error;
+    return -1;
+}
+
+
+int LJUSB_I2CEngineInit(LJUSB_I2CEngine *engine, HANDLE hDevice, BYTE options, BYTE speedAdjust, BYTE sdaPinNum, BYTE sclPinNum, unsigned int maxInFlight)
+{
+    if (engine == NULL || hDevice == NULL || maxInFlight == 0 || maxInFlight > LJUSB_I2C_MAX_QUEUE) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    memset(engine, 0, sizeof(LJUSB_I2CEngine));
+    engine->hDevice = hDevice;
+    engine->options = options;
+    engine->speedAdjust = speedAdjust;
+    engine->sdaPinNum = sdaPinNum;
+    engine->sclPinNum = sclPinNum;
+    engine->maxInFlight = maxInFlight;
+
+    return 0;
+}
+
+
+int LJUSB_I2CQueue(LJUSB_I2CEngine *engine, BYTE address, const BYTE *pSend, unsigned int numBytesToSend, unsigned int numBytesToReceive)
+{
+    LJUSB_I2CTransaction *t;
+    BYTE *b;
+
+    if (engine == NULL || numBytesToSend > LJUSB_I2C_MAX_BYTES_TO_SEND ||
+        numBytesToReceive > LJUSB_I2C_MAX_BYTES_TO_RECEIVE ||
+        (pSend == NULL && numBytesToSend > 0)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    //Queuing after a flush starts a new batch
+    if (engine->numDone > 0 && engine->numDone == engine->numQueued) {
+        engine->numQueued = 0;
+        engine->numDone = 0;
+    }
+
+    if (engine->numQueued >= LJUSB_I2C_MAX_QUEUE) {
+        errno = ENOBUFS;
+        return -1;
+    }
+
+    t = &engine->queue[engine->numQueued];
+    b = t->sendBuff;
+    t->numBytesToSend = numBytesToSend;
+    t->numBytesToReceive = numBytesToReceive;
+    t->sendSize = 14 + numBytesToSend + (numBytesToSend & 1);
+    t->recSize = 12 + numBytesToReceive + (numBytesToReceive & 1);
+    t->errorcode = 0;
+    t->ackArray = 0;
+    t->acked = 0;
+    t->response = t->recBuff + 12;
+
+    b[1] = (BYTE)(0xF8);                //Command byte
+    b[2] = (BYTE)((t->sendSize - 6)/2); //Number of data words
+    b[3] = (BYTE)(0x3B);                //Extended command number
+    b[6] = engine->options;             //I2COptions
+    b[7] = engine->speedAdjust;         //SpeedAdjust
+    b[8] = engine->sdaPinNum;           //SDAPinNum
+    b[9] = engine->sclPinNum;           //SCLPinNum
+    b[10] = address;                    //Address
+    b[11] = 0;                          //Reserved
+    b[12] = (BYTE)numBytesToSend;       //NumI2CBytesToSend
+    b[13] = (BYTE)numBytesToReceive;    //NumI2CBytesToReceive
+    if (numBytesToSend > 0) {
+        memcpy(b + 14, pSend, numBytesToSend);
+    }
+    if (numBytesToSend & 1) {
+        b[t->sendSize - 1] = 0;         //Pad byte
+    }
+    LJUSB_I2CChecksum(b, t->sendSize);
+
+    return (int)(engine->numQueued++);
+}
+
+
+int LJUSB_I2CFlush(LJUSB_I2CEngine *engine)
+{
+    LJUSB_I2CTransaction *t;
+    unsigned int numWritten;
+    int recChars, writeFailed;
+
+    if (engine == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    //Commands are written until maxInFlight responses are outstanding, then
+    //the oldest response is read.  The device answers in order.  After a
+    //failed write, the responses of the commands written are still read.
+    writeFailed = 0;
+    numWritten = engine->numDone;
+    while (engine->numDone < engine->numQueued) {
+        while (!writeFailed && numWritten < engine->numQueued &&
+               numWritten - engine->numDone < engine->maxInFlight) {
+            t = &engine->queue[numWritten];
+            if (LJUSB_Write(engine->hDevice, t->sendBuff, t->sendSize) < t->sendSize) {
+                writeFailed = 1;
+                break;
+            }
+            numWritten++;
+        }
+
+        if (numWritten == engine->numDone) {
+            return LJUSB_I2CAbort(engine, numWritten, EIO);
+        }
+
+        t = &engine->queue[engine->numDone];
+        recChars = (int)LJUSB_Read(engine->hDevice, t->recBuff, t->recSize);
+        if (LJUSB_I2CCheckResponse(t, recChars) != 0) {
+            return LJUSB_I2CAbort(engine, numWritten, errno);
+        }
+        engine->numDone++;
+        engine->transactions++;
+    }
+
+    return (int)engine->numDone;
+}
+
+
+int LJUSB_I2CTransfer(LJUSB_I2CEngine *engine, BYTE address, const BYTE *pSend, unsigned int numBytesToSend, BYTE *pReceive, unsigned int numBytesToReceive)
+{
+    LJUSB_I2CTransaction *t;
+
+    if (engine == NULL || (pReceive == NULL && numBytesToReceive > 0)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    engine->numQueued = 0;
+    engine->numDone = 0;
+    if (LJUSB_I2CQueue(engine, address, pSend, numBytesToSend, numBytesToReceive) < 0 ||
+        LJUSB_I2CFlush(engine) < 0) {
+        return -1;
+    }
+
+    t = &engine->queue[0];
+    if (t->errorcode != 0) {
+        errno = EPROTO;
+        return -1;
+    }
+    if (!t->acked) {
+        errno = ENXIO;
+        return -1;
+    }
+
+    if (numBytesToReceive > 0) {
+        memcpy(pReceive, t->response, numBytesToReceive);
+    }
+
+    return 0;
+}
@@ -0,0 +1,142 @@
+//-----------------------------------------------------------------------------
+//
+//  labjacki2c.h
+//
+//  Header file for the I2C transaction engine of the labjackusb library.
+//  Builds, queues and sends U3, U6 and UE9 I2C low-level commands (0x3B) with
+//  preallocated buffers, and writes several queued commands before reading
+//  their responses so the USB round trips overlap.
+//
+//  support@labjack.com
+//
+//  SPDX-FileCopyrightText: Copyright (c) 2009 LabJack Corporation
+//  SPDX-License-Identifier: X11
+//
+//-----------------------------------------------------------------------------
+//
+
+#ifndef LABJACKI2C_H_
+#define LABJACKI2C_H_
+
+#include "labjackusb.h"
+
+//Maximum number of transactions queued on an engine
+#define LJUSB_I2C_MAX_QUEUE             16
+
+//Maximum I2C bytes of one transaction.  The U3 and U6 take up to 50 bytes to
+//send and 52 to receive (64 byte packets); the UE9 takes larger packets.
+#define LJUSB_I2C_MAX_BYTES_TO_SEND     242
+#define LJUSB_I2C_MAX_BYTES_TO_RECEIVE  244
+
+#define LJUSB_I2C_PACKET_SIZE           256
+
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+
+//One I2C transaction: its command and response packets and its results.
+//The results are set by LJUSB_I2CFlush.
+typedef struct LJUSB_I2CTransaction
+{
+    BYTE sendBuff[LJUSB_I2C_PACKET_SIZE];
+    BYTE recBuff[LJUSB_I2C_PACKET_SIZE];
+    unsigned int sendSize;          //Bytes in the command
+    unsigned int recSize;           //Bytes in the response
+    unsigned int numBytesToSend;
+    unsigned int numBytesToReceive;
+
+    int errorcode;                  //Errorcode of the response (byte 6)
+    unsigned int ackArray;          //AckArray of the response (bytes 8-11)
+    int acked;                      //1 if the address and all bytes sent were acked
+    const BYTE *response;           //Bytes received, in recBuff
+} LJUSB_I2CTransaction;
+
+//I2C engine of one device and one pair of I2C lines.  Set up with
+//LJUSB_I2CEngineInit and do not modify the fields directly, except for
+//reading them.  An engine must only be used by one thread at a time.
+typedef struct LJUSB_I2CEngine
+{
+    HANDLE hDevice;
+    BYTE options;                   //I2COptions
+    BYTE speedAdjust;               //SpeedAdjust
+    BYTE sdaPinNum;                 //SDAPinNum
+    BYTE sclPinNum;                 //SCLPinNum
+    unsigned int maxInFlight;       //Commands written before reading a response
+
+    unsigned int numQueued;         //Transactions in the current batch
+    unsigned int numDone;           //Transactions of the batch that were sent
+    unsigned long long transactions;  //Number of transactions completed
+    LJUSB_I2CTransaction queue[LJUSB_I2C_MAX_QUEUE];
+} LJUSB_I2CEngine;
+
+
+int LJUSB_I2CEngineInit(LJUSB_I2CEngine *engine, HANDLE hDevice, BYTE options, BYTE speedAdjust, BYTE sdaPinNum, BYTE sclPinNum, unsigned int maxInFlight);
+// Sets up an I2C engine for a device and a pair of I2C lines.  Returns 0 on
+// success, or -1 on error and errno is set.
+// engine = The engine to set up.
+// hDevice = The handle of a U3, U6 or UE9.
+// options = The I2COptions byte of the commands.
+// speedAdjust = The SpeedAdjust byte of the commands.  0 is the fastest.
+// sdaPinNum = The SDAPinNum byte of the commands.
+// sclPinNum = The SCLPinNum byte of the commands.
+// maxInFlight = The maximum number of commands written to the device before
+//               the response of the first one is read (1 to
+//               LJUSB_I2C_MAX_QUEUE).  1 sends one command at a time, like
+//               the I2C helper functions.  The device still runs the
+//               commands one at a time, but with 2 or more the USB round
+//               trips overlap.
+
+int LJUSB_I2CQueue(LJUSB_I2CEngine *engine, BYTE address, const BYTE *pSend, unsigned int numBytesToSend, unsigned int numBytesToReceive);
+// Builds the command of an I2C transaction and adds it to the batch sent by
+// the next LJUSB_I2CFlush.  Queuing after a flush starts a new batch, and the
+// results of the previous batch are discarded.  Returns the index of the
+// transaction in engine->queue, or -1 on error and errno is set:
+//   EINVAL - a byte count is too large
+//   ENOBUFS - LJUSB_I2C_MAX_QUEUE transactions are queued already
+// engine = The engine.
+// address = The Address byte of the command (the 7-bit address shifted left).
+// pSend = The bytes to send, numBytesToSend bytes.
+// numBytesToSend = The number of bytes to send (0 to
+//                  LJUSB_I2C_MAX_BYTES_TO_SEND).
+// numBytesToReceive = The number of bytes to receive (0 to
+//                     LJUSB_I2C_MAX_BYTES_TO_RECEIVE).
+
+int LJUSB_I2CFlush(LJUSB_I2CEngine *engine);
+// Sends the queued transactions, keeping up to maxInFlight commands written
+// ahead of the responses, and checks the responses.  The results are stored
+// in the transactions of engine->queue.  A transaction that was not acked or
+// has a non-zero errorcode does not stop the batch.  Returns the number of
+// transactions sent, or -1 on error and errno is set:
+//   EIO - a write or read failed, or a response was short
+//   EBADMSG - a response has a bad checksum or bad command bytes
+// On error, the responses of the commands already written are read and
+// discarded, and the batch ends:  the transactions before engine->numDone
+// have results, the others were not sent or have no results, and the next
+// LJUSB_I2CQueue starts a new batch.  A response that arrives after its
+// read timed out can still be read by the next batch, so close and reopen
+// the device if reads time out.
+// engine = The engine.
+
+int LJUSB_I2CTransfer(LJUSB_I2CEngine *engine, BYTE address, const BYTE *pSend, unsigned int numBytesToSend, BYTE *pReceive, unsigned int numBytesToReceive);
+// Sends one I2C transaction and waits for its response, without allocating
+// memory.  Discards the results of a previous batch.  Returns 0 on success, or
+// -1 on error and errno is set:
+//   ENXIO - the address or a byte sent was not acked
+//   EPROTO - the response has a non-zero errorcode (see engine->queue[0])
+//   others - see LJUSB_I2CQueue and LJUSB_I2CFlush
+// engine = The engine.
+// address = The Address byte of the command.
+// pSend = The bytes to send.
+// numBytesToSend = The number of bytes to send.
+// pReceive = Returns the bytes received, numBytesToReceive bytes.  Can be
+//            NULL if numBytesToReceive is 0.
+// numBytesToReceive = The number of bytes to receive.
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LABJACKI2C_H_
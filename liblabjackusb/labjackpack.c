@@ -0,0 +1,1559 @@
+//---------------------------------------------------------------------------
+//
+//  labjackpack.c
+//
+//    Lossless packed format for U3, U6 and UE9 raw stream codes.
+//
+//  support@labjack.com
+//
+//  SPDX-FileCopyrightText: Copyright (c) 2009 LabJack Corporation
+//  SPDX-License-Identifier: X11
+//
+//---------------------------------------------------------------------------
+//
+
+#include "labjackpack.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define LJUSB_PACK_SSE
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define LJUSB_PACK_NEON
+#endif
+
+// File header: "LJPK", version, header size, productID, numChannels,
+// scansPerChunk, resolutionIndex, scanRate and startTimeNs, then
+// LJUSB_PACK_CHANNEL_SIZE bytes per channel (channel number, options, 2
+// reserved bytes and the 4 conversion values) and a CRC-32 of all of it.
+#define LJUSB_PACK_HEADER_FIXED_SIZE  40
+#define LJUSB_PACK_CHANNEL_SIZE       36
+
+// Chunk header: "LJPC", chunk size, firstScan, timestampNs, numScans and a
+// CRC-32 of the data.  The data holds, for each channel, its first code and then the
+// deltas to the following codes in blocks of LJUSB_STREAM_PACK_BLOCK_SIZE,
+// each block a bit width byte followed by the bit-packed zigzag deltas.
+static const BYTE LJUSB_PackFileMagic[4] = {'L', 'J', 'P', 'K'};
+static const BYTE LJUSB_PackChunkMagic[4] = {'L', 'J', 'P', 'C'};
+
+// Index: "LJPX", the number of entries, LJUSB_PACK_INDEX_ENTRY_SIZE bytes per
+// chunk (firstScan, timestampNs, offset, numScans and size) and a CRC-32 of
+// all of it.  It is followed by the footer that ends the file: "LJPF", the
+// offset of the index and a CRC-32 of the two.
+#define LJUSB_PACK_INDEX_ENTRY_SIZE   32
+#define LJUSB_PACK_FOOTER_SIZE        16
+static const BYTE LJUSB_PackIndexMagic[4] = {'L', 'J', 'P', 'X'};
+static const BYTE LJUSB_PackFooterMagic[4] = {'L', 'J', 'P', 'F'};
+
+
+struct LJUSB_StreamPackWriter
+{
+    LJUSB_StreamWriter *writer;
+    unsigned int numChannels;
+    unsigned long scansPerChunk;
+    unsigned short *pending;        // scansPerChunk scans waiting to be packed
+    unsigned long numPending;
+    unsigned long long firstScan;   // Stream index of pending[0]
+    unsigned long long timeNs;      // Host time of pending[0]
+    unsigned long long lastTimeNs;  // Host time of the last chunk
+    double scanPeriodNs;
+    unsigned long long startTimeNs;
+    BYTE *chunk;                    // LJUSB_StreamPackBound bytes
+    LJUSB_StreamPackChunk *index;   // Chunks written
+    unsigned long numIndex;
+    unsigned long maxIndex;
+    LJUSB_StreamPackStats stats;
+};
+
+
+struct LJUSB_StreamPackReader
+{
+    FILE *file;
+    unsigned int numChannels;
+    unsigned long chunkSize;        // Size of chunk
+    BYTE *chunk;
+};
+
+
+struct LJUSB_StreamPackFile
+{
+    int fd;
+    unsigned long long fileSize;
+    unsigned int numChannels;
+    double scanPeriodNs;
+    LJUSB_StreamPackChunk *chunks;  // The index
+    unsigned long numChunks;
+    int indexRebuilt;
+};
+
+
+static uint32_t LJUSB_PackCrcTable[256];
+static pthread_once_t LJUSB_PackCrcOnce = PTHREAD_ONCE_INIT;
+
+
+static void LJUSB_PackCrcInit(void)
+{
+    uint32_t c;
+    unsigned int i, k;
+
+    for (i = 0; i < 256; i++) {
+        c = i;
+        for (k = 0; k < 8; k++) {
+            c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+        }
+        LJUSB_PackCrcTable[i] = c;
+    }
+}
+
+
+// CRC-32 (the one of zlib and Ethernet) of count bytes
+static uint32_t LJUSB_PackCrc(const BYTE *p, unsigned long count)
+{
+    uint32_t c = 0xFFFFFFFFu;
+
+    pthread_once(&LJUSB_PackCrcOnce, LJUSB_PackCrcInit);
+    while (count-- > 0) {
+        c = LJUSB_PackCrcTable[(c ^ *p++) & 0xFF] ^ (c >> 8);
+    }
+    return c ^ 0xFFFFFFFFu;
+}
+
+
+static void LJUSB_PackPut16(BYTE *p, unsigned int v)
+{
+    p[0] = (BYTE)v;
+    p[1] = (BYTE)(v >> 8);
+}
+
+
+static void LJUSB_PackPut32(BYTE *p, uint32_t v)
+{
+    p[0] = (BYTE)v;
+    p[1] = (BYTE)(v >> 8);
+    p[2] = (BYTE)(v >> 16);
+    p[3] = (BYTE)(v >> 24);
+}
+
+
+static void LJUSB_PackPut64(BYTE *p, uint64_t v)
+{
+    LJUSB_PackPut32(p, (uint32_t)v);
+    LJUSB_PackPut32(p + 4, (uint32_t)(v >> 32));
+}
+
+
+static void LJUSB_PackPutDouble(BYTE *p, double d)
+{
+    uint64_t v;
+
+    memcpy(&v, &d, sizeof(v));
+    LJUSB_PackPut64(p, v);
+}
+
+
+static unsigned int LJUSB_PackGet16(const BYTE *p)
+{
+    return p[0] | ((unsigned int)p[1] << 8);
+}
+
+
+static uint32_t LJUSB_PackGet32(const BYTE *p)
+{
+    return p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+
+static uint64_t LJUSB_PackGet64(const BYTE *p)
+{
+    return LJUSB_PackGet32(p) | ((uint64_t)LJUSB_PackGet32(p + 4) << 32);
+}
+
+
+static double LJUSB_PackGetDouble(const BYTE *p)
+{
+    uint64_t v = LJUSB_PackGet64(p);
+    double d;
+
+    memcpy(&d, &v, sizeof(d));
+    return d;
+}
+
+
+// Stores the zigzag coded deltas between codes[0..n] in zigzag[0..n-1] and
+// returns the OR of them.  Zigzag maps the signed deltas 0, -1, 1, -2, ... to
+// 0, 1, 2, 3, ... so small deltas of either sign need few bits.
+static unsigned int LJUSB_PackZigzag(const unsigned short *codes, unsigned int n, unsigned short *zigzag)
+{
+    unsigned int all = 0;
+    unsigned int i = 0;
+    short delta;
+
+#if defined(LJUSB_PACK_SSE)
+    __m128i acc = _mm_setzero_si128();
+    __m128i d, z;
+    unsigned short t[8];
+
+    for (; i + 8 <= n; i += 8) {
+        d = _mm_sub_epi16(_mm_loadu_si128((const __m128i *)(codes + i + 1)), _mm_loadu_si128((const __m128i *)(codes + i)));
+        z = _mm_xor_si128(_mm_slli_epi16(d, 1), _mm_srai_epi16(d, 15));
+        _mm_storeu_si128((__m128i *)(zigzag + i), z);
+        acc = _mm_or_si128(acc, z);
+    }
+    _mm_storeu_si128((__m128i *)t, acc);
+    all = t[0] | t[1] | t[2] | t[3] | t[4] | t[5] | t[6] | t[7];
+#elif defined(LJUSB_PACK_NEON)
+    uint16x8_t acc = vdupq_n_u16(0);
+    uint16x8_t d, z;
+    unsigned short t[8];
+
+    for (; i + 8 <= n; i += 8) {
+        d = vsubq_u16(vld1q_u16(codes + i + 1), vld1q_u16(codes + i));
+        z = veorq_u16(vshlq_n_u16(d, 1), vreinterpretq_u16_s16(vshrq_n_s16(vreinterpretq_s16_u16(d), 15)));
+        vst1q_u16(zigzag + i, z);
+        acc = vorrq_u16(acc, z);
+    }
+    vst1q_u16(t, acc);
+    all = t[0] | t[1] | t[2] | t[3] | t[4] | t[5] | t[6] | t[7];
+#endif
+    for (; i < n; i++) {
+        delta = (short)(codes[i + 1] - codes[i]);
+        zigzag[i] = (unsigned short)(((unsigned int)delta << 1) ^ (unsigned int)(delta >> 15));
+        all |= zigzag[i];
+    }
+
+    return all;
+}
+
+
+#if defined(LJUSB_PACK_SSE) || defined(LJUSB_PACK_NEON)
+// Eight values of width bits take exactly width bytes, so the packed bits of a
+// block split into byte aligned groups of 8 values.  The vector code packs a
+// group into two 64-bit lanes, values 0 to 3 and 4 to 7 with 4*width bits
+// each, and these helpers move the lanes to and from the group's bytes.
+
+static BYTE *LJUSB_PackPutGroup(const uint64_t *lanes, unsigned int width, BYTE *p)
+{
+    unsigned int half = 4*width;
+    BYTE b[16];
+
+    if (half == 0 || half == 64) {
+        LJUSB_PackPut64(b, lanes[0]);
+        LJUSB_PackPut64(b + 8, lanes[1]);
+    }
+    else {
+        LJUSB_PackPut64(b, lanes[0] | (lanes[1] << half));
+        LJUSB_PackPut64(b + 8, lanes[1] >> (64 - half));
+    }
+    memcpy(p, b, width);
+
+    return p + width;
+}
+
+
+// Reads 16 bytes, so at least that many must follow p
+static const BYTE *LJUSB_UnpackGetGroup(const BYTE *p, unsigned int width, uint64_t *lanes)
+{
+    unsigned int half = 4*width;
+    uint64_t lo = LJUSB_PackGet64(p);
+    uint64_t hi = LJUSB_PackGet64(p + 8);
+
+    if (half == 0) {
+        lanes[0] = 0;
+        lanes[1] = 0;
+    }
+    else if (half == 64) {
+        lanes[0] = lo;
+        lanes[1] = hi;
+    }
+    else {
+        lanes[0] = lo & (((uint64_t)1 << half) - 1);
+        lanes[1] = ((lo >> half) | (hi << (64 - half))) & (((uint64_t)1 << half) - 1);
+    }
+
+    return p + width;
+}
+
+
+// Packs 8 values of width bits into lanes, by joining pairs of 16-bit values
+// and then pairs of 32-bit values
+static void LJUSB_PackLanes(const unsigned short *v, unsigned int width, uint64_t *lanes)
+{
+#if defined(LJUSB_PACK_SSE)
+    __m128i x = _mm_loadu_si128((const __m128i *)v);
+
+    x = _mm_or_si128(_mm_and_si128(x, _mm_set1_epi32(0xFFFF)), _mm_sll_epi32(_mm_srli_epi32(x, 16), _mm_cvtsi32_si128((int)width)));
+    x = _mm_or_si128(_mm_and_si128(x, _mm_set_epi32(0, -1, 0, -1)), _mm_sll_epi64(_mm_srli_epi64(x, 32), _mm_cvtsi32_si128((int)(2*width))));
+    _mm_storeu_si128((__m128i *)lanes, x);
+#else
+    uint32x4_t x = vreinterpretq_u32_u16(vld1q_u16(v));
+    uint64x2_t y;
+
+    x = vorrq_u32(vandq_u32(x, vdupq_n_u32(0xFFFF)), vshlq_u32(vshrq_n_u32(x, 16), vdupq_n_s32((int)width)));
+    y = vreinterpretq_u64_u32(x);
+    y = vorrq_u64(vandq_u64(y, vdupq_n_u64(0xFFFFFFFFu)), vshlq_u64(vshrq_n_u64(y, 32), vdupq_n_s64((int64_t)(2*width))));
+    vst1q_u64(lanes, y);
+#endif
+}
+
+
+// Splits lanes into 8 zigzag coded deltas and adds them to the running code
+// *last, storing the codes in out[0..7]
+static void LJUSB_UnpackLanes(const uint64_t *lanes, unsigned int width, unsigned short *last, unsigned short *out)
+{
+    uint32_t mask = (1u << width) - 1;
+    uint32_t mask2 = (width >= 16) ? 0xFFFFFFFFu : (1u << (2*width)) - 1;
+
+#if defined(LJUSB_PACK_SSE)
+    // Built from the lanes' values, a 16-byte load of the two 8-byte
+    // stores just made would stall
+    __m128i x = _mm_set_epi64x((long long)lanes[1], (long long)lanes[0]);
+
+    x = _mm_or_si128(_mm_and_si128(x, _mm_set_epi32(0, (int)mask2, 0, (int)mask2)), _mm_slli_epi64(_mm_srl_epi64(x, _mm_cvtsi32_si128((int)(2*width))), 32));
+    x = _mm_or_si128(_mm_and_si128(x, _mm_set1_epi32((int)mask)), _mm_slli_epi32(_mm_srl_epi32(x, _mm_cvtsi32_si128((int)width)), 16));
+
+    // Zigzag decode, then a running sum in three steps
+    x = _mm_xor_si128(_mm_srli_epi16(x, 1), _mm_sub_epi16(_mm_setzero_si128(), _mm_and_si128(x, _mm_set1_epi16(1))));
+    x = _mm_add_epi16(x, _mm_slli_si128(x, 2));
+    x = _mm_add_epi16(x, _mm_slli_si128(x, 4));
+    x = _mm_add_epi16(x, _mm_slli_si128(x, 8));
+    x = _mm_add_epi16(x, _mm_set1_epi16((short)*last));
+    _mm_storeu_si128((__m128i *)out, x);
+#else
+    uint64x2_t y = vcombine_u64(vcreate_u64(lanes[0]), vcreate_u64(lanes[1]));
+    uint32x4_t x;
+    uint16x8_t z;
+    uint16x8_t zero = vdupq_n_u16(0);
+
+    y = vorrq_u64(vandq_u64(y, vdupq_n_u64(mask2)), vshlq_n_u64(vshlq_u64(y, vdupq_n_s64(-(int64_t)(2*width))), 32));
+    x = vreinterpretq_u32_u64(y);
+    x = vorrq_u32(vandq_u32(x, vdupq_n_u32(mask)), vshlq_n_u32(vshlq_u32(x, vdupq_n_s32(-(int)width)), 16));
+    z = vreinterpretq_u16_u32(x);
+
+    // Zigzag decode, then a running sum in three steps
+    z = veorq_u16(vshrq_n_u16(z, 1), vsubq_u16(zero, vandq_u16(z, vdupq_n_u16(1))));
+    z = vaddq_u16(z, vextq_u16(zero, z, 7));
+    z = vaddq_u16(z, vextq_u16(zero, z, 6));
+    z = vaddq_u16(z, vextq_u16(zero, z, 4));
+    z = vaddq_u16(z, vdupq_n_u16(*last));
+    vst1q_u16(out, z);
+#endif
+    *last = out[7];
+}
+#endif
+
+
+// Packs n values of width bits each, least significant bits first.  Returns
+// the end of the packed bytes, ceil(n*width/8) of them.
+static BYTE *LJUSB_PackBits(const unsigned short *v, unsigned int n, unsigned int width, BYTE *p)
+{
+    uint64_t acc = 0;
+    unsigned int bits = 0;
+    unsigned int i = 0;
+
+#if defined(LJUSB_PACK_SSE) || defined(LJUSB_PACK_NEON)
+    uint64_t lanes[2];
+
+    for (; i + 8 <= n; i += 8) {
+        LJUSB_PackLanes(v + i, width, lanes);
+        p = LJUSB_PackPutGroup(lanes, width, p);
+    }
+#endif
+    // The groups end on a byte, so the rest continues from there
+    for (; i < n; i++) {
+        acc |= (uint64_t)v[i] << bits;
+        bits += width;
+        if (bits >= 32) {
+            LJUSB_PackPut32(p, (uint32_t)acc);
+            p += 4;
+            acc >>= 32;
+            bits -= 32;
+        }
+    }
+    while (bits > 0) {
+        *p++ = (BYTE)acc;
+        acc >>= 8;
+        bits = (bits > 8) ? bits - 8 : 0;
+    }
+
+    return p;
+}
+
+
+// Unpacks n values of width bits each and adds them, zigzag decoded, to the
+// running code *last, storing each code at out[i*stride].  Returns the end of
+// the packed bytes.  end is the end of the chunk.
+static const BYTE *LJUSB_UnpackBits(const BYTE *p, const BYTE *end, unsigned int n, unsigned int width, unsigned short *last, unsigned short *out, unsigned int stride)
+{
+    uint64_t acc = 0;
+    unsigned int bits = 0;
+    unsigned int mask = (1u << width) - 1;
+    unsigned int i = 0, z;
+    unsigned short code;
+
+#if defined(LJUSB_PACK_SSE) || defined(LJUSB_PACK_NEON)
+    uint64_t lanes[2];
+    unsigned short t[8];
+    unsigned int k;
+
+    // The groups near the end of the chunk are left to the loop below
+    for (; i + 8 <= n && end - p >= 16; i += 8) {
+        p = LJUSB_UnpackGetGroup(p, width, lanes);
+        LJUSB_UnpackLanes(lanes, width, last, t);
+        for (k = 0; k < 8; k++) {
+            out[(unsigned long)(i + k)*stride] = t[k];
+        }
+    }
+#endif
+    code = *last;
+    for (; i < n; i++) {
+        while (bits < width) {
+            acc |= (uint64_t)*p++ << bits;
+            bits += 8;
+        }
+        z = (unsigned int)acc & mask;
+        acc >>= width;
+        bits -= width;
+        code = (unsigned short)(code + ((z >> 1) ^ (0u - (z & 1))));
+        out[(unsigned long)i*stride] = code;
+    }
+    *last = code;
+
+    return p;
+}
+
+
+unsigned long LJUSB_StreamPackHeaderSize(unsigned int numChannels)
+{
+    return LJUSB_PACK_HEADER_FIXED_SIZE + (unsigned long)numChannels*LJUSB_PACK_CHANNEL_SIZE + 4;
+}
+
+
+long LJUSB_StreamPackHeaderEncode(const LJUSB_StreamPackHeader *header, BYTE *pOut, unsigned long outSize)
+{
+    unsigned long size;
+    unsigned int i;
+    BYTE *p;
+
+    if (header == NULL || pOut == NULL || header->numChannels < 1 ||
+        header->numChannels > LJUSB_STREAM_MAX_CHANNELS || header->scansPerChunk < 1 ||
+        header->scansPerChunk > LJUSB_STREAM_PACK_MAX_CHUNK_SCANS) {
+        errno = EINVAL;
+        return -1;
+    }
+    size = LJUSB_StreamPackHeaderSize(header->numChannels);
+    if (outSize < size) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    memcpy(pOut, LJUSB_PackFileMagic, 4);
+    LJUSB_PackPut16(pOut + 4, LJUSB_STREAM_PACK_VERSION);
+    LJUSB_PackPut16(pOut + 6, (unsigned int)size);
+    LJUSB_PackPut32(pOut + 8, (uint32_t)header->productID);
+    LJUSB_PackPut32(pOut + 12, header->numChannels);
+    LJUSB_PackPut32(pOut + 16, header->scansPerChunk);
+    LJUSB_PackPut32(pOut + 20, (uint32_t)header->resolutionIndex);
+    LJUSB_PackPutDouble(pOut + 24, header->scanRate);
+    LJUSB_PackPut64(pOut + 32, header->startTimeNs);
+
+    p = pOut + LJUSB_PACK_HEADER_FIXED_SIZE;
+    for (i = 0; i < header->numChannels; i++) {
+        p[0] = header->channelNumbers[i];
+        p[1] = header->channelOptions[i];
+        LJUSB_PackPut16(p + 2, 0);
+        LJUSB_PackPutDouble(p + 4, header->cal[i].center);
+        LJUSB_PackPutDouble(p + 12, header->cal[i].slopeBelow);
+        LJUSB_PackPutDouble(p + 20, header->cal[i].slopeAbove);
+        LJUSB_PackPutDouble(p + 28, header->cal[i].offset);
+        p += LJUSB_PACK_CHANNEL_SIZE;
+    }
+    LJUSB_PackPut32(p, LJUSB_PackCrc(pOut, size - 4));
+
+    return (long)size;
+}
+
+
+long LJUSB_StreamPackHeaderDecode(const BYTE *pBuff, unsigned long count, LJUSB_StreamPackHeader *header)
+{
+    unsigned long size;
+    unsigned int i;
+    const BYTE *p;
+
+    if (pBuff == NULL || header == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (count < 16) {
+        errno = EAGAIN;
+        return -1;
+    }
+    if (memcmp(pBuff, LJUSB_PackFileMagic, 4) != 0) {
+        errno = EBADMSG;
+        return -1;
+    }
+    if (LJUSB_PackGet16(pBuff + 4) > LJUSB_STREAM_PACK_VERSION) {
+        errno = ENOTSUP;
+        return -1;
+    }
+
+    memset(header, 0, sizeof(LJUSB_StreamPackHeader));
+    header->productID = LJUSB_PackGet32(pBuff + 8);
+    header->numChannels = LJUSB_PackGet32(pBuff + 12);
+    if (header->numChannels < 1 || header->numChannels > LJUSB_STREAM_MAX_CHANNELS) {
+        errno = EBADMSG;
+        return -1;
+    }
+    size = LJUSB_StreamPackHeaderSize(header->numChannels);
+    if (LJUSB_PackGet16(pBuff + 6) != size) {
+        errno = EBADMSG;
+        return -1;
+    }
+    if (count < size) {
+        errno = EAGAIN;
+        return -1;
+    }
+    if (LJUSB_PackGet32(pBuff + size - 4) != LJUSB_PackCrc(pBuff, size - 4)) {
+        errno = EBADMSG;
+        return -1;
+    }
+
+    header->scansPerChunk = LJUSB_PackGet32(pBuff + 16);
+    header->resolutionIndex = (int)LJUSB_PackGet32(pBuff + 20);
+    header->scanRate = LJUSB_PackGetDouble(pBuff + 24);
+    header->startTimeNs = LJUSB_PackGet64(pBuff + 32);
+    if (header->scansPerChunk < 1 || header->scansPerChunk > LJUSB_STREAM_PACK_MAX_CHUNK_SCANS) {
+        errno = EBADMSG;
+        return -1;
+    }
+
+    p = pBuff + LJUSB_PACK_HEADER_FIXED_SIZE;
+    for (i = 0; i < header->numChannels; i++) {
+        header->channelNumbers[i] = p[0];
+        header->channelOptions[i] = p[1];
+        header->cal[i].center = LJUSB_PackGetDouble(p + 4);
+        header->cal[i].slopeBelow = LJUSB_PackGetDouble(p + 12);
+        header->cal[i].slopeAbove = LJUSB_PackGetDouble(p + 20);
+        header->cal[i].offset = LJUSB_PackGetDouble(p + 28);
+        p += LJUSB_PACK_CHANNEL_SIZE;
+    }
+
+    return (long)size;
+}
+
+
+unsigned long LJUSB_StreamPackBound(unsigned int numChannels, unsigned long numScans)
+{
+    unsigned long deltas = (numScans > 0) ? numScans - 1 : 0;
+    unsigned long blocks = (deltas + LJUSB_STREAM_PACK_BLOCK_SIZE - 1)/LJUSB_STREAM_PACK_BLOCK_SIZE;
+
+    // 16-bit deltas at worst, and a width byte per block
+    return LJUSB_STREAM_PACK_CHUNK_HEADER_SIZE + numChannels*(2 + blocks + deltas*2);
+}
+
+
+long LJUSB_StreamPack(const unsigned short *pRaw, unsigned int numChannels, unsigned long numScans, unsigned long long firstScan, unsigned long long timestampNs, BYTE *pOut, unsigned long outSize)
+{
+    unsigned short codes[LJUSB_STREAM_PACK_BLOCK_SIZE + 1];
+    unsigned short zigzag[LJUSB_STREAM_PACK_BLOCK_SIZE];
+    const unsigned short *in;
+    unsigned long scan, size;
+    unsigned int ch, i, n, width, all;
+    unsigned short prev;
+    BYTE *p;
+
+    if (pRaw == NULL || pOut == NULL || numChannels < 1 || numChannels > LJUSB_STREAM_MAX_CHANNELS ||
+        numScans < 1 || numScans > LJUSB_STREAM_PACK_MAX_CHUNK_SCANS ||
+        outSize < LJUSB_StreamPackBound(numChannels, numScans)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    p = pOut + LJUSB_STREAM_PACK_CHUNK_HEADER_SIZE;
+    for (ch = 0; ch < numChannels; ch++) {
+        in = pRaw + ch;
+        prev = in[0];
+        LJUSB_PackPut16(p, prev);
+        p += 2;
+
+        for (scan = 1; scan < numScans; scan += n) {
+            n = LJUSB_STREAM_PACK_BLOCK_SIZE;
+            if (numScans - scan < n) {
+                n = (unsigned int)(numScans - scan);
+            }
+
+            // The channel's codes are gathered from the scans so the deltas
+            // are taken on contiguous values
+            codes[0] = prev;
+            for (i = 0; i < n; i++) {
+                codes[i + 1] = in[(scan + i)*numChannels];
+            }
+            prev = codes[n];
+            all = LJUSB_PackZigzag(codes, n, zigzag);
+
+            width = 0;
+            while (all >> width) {
+                width++;
+            }
+            *p++ = (BYTE)width;
+            p = LJUSB_PackBits(zigzag, n, width, p);
+        }
+    }
+
+    size = (unsigned long)(p - pOut);
+    memcpy(pOut, LJUSB_PackChunkMagic, 4);
+    LJUSB_PackPut32(pOut + 4, (uint32_t)size);
+    LJUSB_PackPut64(pOut + 8, firstScan);
+    LJUSB_PackPut64(pOut + 16, timestampNs);
+    LJUSB_PackPut32(pOut + 24, (uint32_t)numScans);
+    LJUSB_PackPut32(pOut + 28, LJUSB_PackCrc(pOut + LJUSB_STREAM_PACK_CHUNK_HEADER_SIZE, size - LJUSB_STREAM_PACK_CHUNK_HEADER_SIZE));
+
+    return (long)size;
+}
+
+
+int LJUSB_StreamPackChunkInfo(const BYTE *pChunk, unsigned long count, LJUSB_StreamPackChunk *info)
+{
+    if (pChunk == NULL || info == NULL || count < LJUSB_STREAM_PACK_CHUNK_HEADER_SIZE) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (memcmp(pChunk, LJUSB_PackChunkMagic, 4) != 0) {
+        errno = EBADMSG;
+        return -1;
+    }
+
+    info->size = LJUSB_PackGet32(pChunk + 4);
+    info->firstScan = LJUSB_PackGet64(pChunk + 8);
+    info->timestampNs = LJUSB_PackGet64(pChunk + 16);
+    info->numScans = LJUSB_PackGet32(pChunk + 24);
+    info->offset = 0;
+    if (info->size < LJUSB_STREAM_PACK_CHUNK_HEADER_SIZE || info->numScans < 1 ||
+        info->numScans > LJUSB_STREAM_PACK_MAX_CHUNK_SCANS) {
+        errno = EBADMSG;
+        return -1;
+    }
+
+    return 0;
+}
+
+
+long LJUSB_StreamUnpack(const BYTE *pChunk, unsigned long count, unsigned int numChannels, unsigned short *pRaw, unsigned long maxScans, unsigned long long *pFirstScan)
+{
+    LJUSB_StreamPackChunk info;
+    const BYTE *p, *end;
+    unsigned long scan;
+    unsigned int ch, n, width;
+    unsigned short last;
+
+    if (pRaw == NULL || numChannels < 1 || numChannels > LJUSB_STREAM_MAX_CHANNELS) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (LJUSB_StreamPackChunkInfo(pChunk, count, &info) != 0) {
+        return -1;
+    }
+    if (count < info.size) {
+        errno = EAGAIN;
+        return -1;
+    }
+    if (info.size > LJUSB_StreamPackBound(numChannels, info.numScans) ||
+        LJUSB_PackGet32(pChunk + 28) != LJUSB_PackCrc(pChunk + LJUSB_STREAM_PACK_CHUNK_HEADER_SIZE, info.size - LJUSB_STREAM_PACK_CHUNK_HEADER_SIZE)) {
+        errno = EBADMSG;
+        return -1;
+    }
+    if (info.numScans > maxScans) {
+        errno = EMSGSIZE;
+        return -1;
+    }
+
+    // The CRC matched, so the sizes are only checked against overruns
+    p = pChunk + LJUSB_STREAM_PACK_CHUNK_HEADER_SIZE;
+    end = pChunk + info.size;
+    for (ch = 0; ch < numChannels; ch++) {
+        if (end - p < 2) {
+            errno = EBADMSG;
+            return -1;
+        }
+        last = (unsigned short)LJUSB_PackGet16(p);
+        p += 2;
+        pRaw[ch] = last;
+
+        for (scan = 1; scan < info.numScans; scan += n) {
+            n = LJUSB_STREAM_PACK_BLOCK_SIZE;
+            if (info.numScans - scan < n) {
+                n = (unsigned int)(info.numScans - scan);
+            }
+            if (p >= end || (width = *p++) > 16 ||
+                (unsigned long)(end - p) < ((unsigned long)n*width + 7)/8) {
+                errno = EBADMSG;
+                return -1;
+            }
+            p = LJUSB_UnpackBits(p, end, n, width, &last, pRaw + scan*numChannels + ch, numChannels);
+        }
+    }
+
+    if (pFirstScan != NULL) {
+        *pFirstScan = info.firstScan;
+    }
+    return (long)info.numScans;
+}
+
+
+// Packs the pending scans and passes the chunk to the stream writer, or drops
+// it whole if the stream writer has no room.  Returns 0, or -1 and errno is
+// set.
+static int LJUSB_PackWriterFlush(LJUSB_StreamPackWriter *packWriter)
+{
+    unsigned long numScans = packWriter->numPending;
+    unsigned long long t0;
+    LJUSB_StreamPackChunk *index;
+    unsigned long maxIndex;
+    long size;
+
+    if (numScans == 0) {
+        return 0;
+    }
+
+    t0 = LJUSB_GetTimestampNs();
+    size = LJUSB_StreamPack(packWriter->pending, packWriter->numChannels, numScans, packWriter->firstScan, packWriter->timeNs,
+                            packWriter->chunk, LJUSB_StreamPackBound(packWriter->numChannels, packWriter->scansPerChunk));
+    packWriter->stats.packNs += LJUSB_GetTimestampNs() - t0;
+    packWriter->numPending = 0;
+    if (size < 0) {
+        return -1;
+    }
+
+    if (packWriter->numIndex == packWriter->maxIndex) {
+        maxIndex = (packWriter->maxIndex > 0) ? packWriter->maxIndex*2 : 1024;
+        index = (LJUSB_StreamPackChunk *)realloc(packWriter->index, maxIndex*sizeof(LJUSB_StreamPackChunk));
+        if (index == NULL) {
+            errno = ENOMEM;
+            return -1;
+        }
+        packWriter->index = index;
+        packWriter->maxIndex = maxIndex;
+    }
+
+    if (LJUSB_StreamWriterAvailable(packWriter->writer) < (unsigned long long)size) {
+        packWriter->stats.droppedChunks++;
+        packWriter->stats.droppedScans += numScans;
+        errno = ENOBUFS;
+        return -1;
+    }
+    if (LJUSB_StreamWriterWrite(packWriter->writer, packWriter->chunk, (unsigned long)size) < 0) {
+        return -1;
+    }
+
+    index = &packWriter->index[packWriter->numIndex++];
+    index->size = (unsigned long)size;
+    index->firstScan = packWriter->firstScan;
+    index->timestampNs = packWriter->timeNs;
+    index->numScans = numScans;
+    index->offset = packWriter->stats.packedBytes;
+    packWriter->stats.packedBytes += (unsigned long long)size;
+    packWriter->stats.chunks++;
+
+    return 0;
+}
+
+
+// Starts the pending chunk at a scan and its host time
+static void LJUSB_PackWriterStartChunk(LJUSB_StreamPackWriter *packWriter, unsigned long long scan, unsigned long long timeNs)
+{
+    if (timeNs == 0) {
+        timeNs = packWriter->startTimeNs + (unsigned long long)(scan*packWriter->scanPeriodNs);
+    }
+    if (timeNs < packWriter->lastTimeNs) {
+        timeNs = packWriter->lastTimeNs;
+    }
+    packWriter->firstScan = scan;
+    packWriter->timeNs = timeNs;
+    packWriter->lastTimeNs = timeNs;
+}
+
+
+// Passes count bytes to the stream writer, waiting for room as needed.
+// Returns 0, or -1 and errno is set.
+static int LJUSB_PackWriterWriteAll(LJUSB_StreamPackWriter *packWriter, const BYTE *p, unsigned long count)
+{
+    LJUSB_StreamWriterStats stats;
+    unsigned long long available;
+    unsigned long n;
+
+    while (count > 0) {
+        available = LJUSB_StreamWriterAvailable(packWriter->writer);
+        if (available == 0) {
+            if (LJUSB_StreamWriterGetStats(packWriter->writer, &stats) != 0) {
+                return -1;
+            }
+            if (stats.error != 0) {
+                errno = stats.error;
+                return -1;
+            }
+            usleep(1000);
+            continue;
+        }
+
+        n = (available < count) ? (unsigned long)available : count;
+        if (LJUSB_StreamWriterWrite(packWriter->writer, p, n) < 0) {
+            return -1;
+        }
+        p += n;
+        count -= n;
+    }
+
+    return 0;
+}
+
+
+// Writes the index and the footer.  Returns 0, or -1 and errno is set.
+static int LJUSB_PackWriterWriteIndex(LJUSB_StreamPackWriter *packWriter)
+{
+    unsigned long size = 8 + packWriter->numIndex*LJUSB_PACK_INDEX_ENTRY_SIZE + 4;
+    BYTE footer[LJUSB_PACK_FOOTER_SIZE];
+    const LJUSB_StreamPackChunk *c;
+    unsigned long i;
+    BYTE *record, *p;
+    int r;
+
+    record = (BYTE *)malloc(size);
+    if (record == NULL) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    memcpy(record, LJUSB_PackIndexMagic, 4);
+    LJUSB_PackPut32(record + 4, (uint32_t)packWriter->numIndex);
+    p = record + 8;
+    for (i = 0; i < packWriter->numIndex; i++) {
+        c = &packWriter->index[i];
+        LJUSB_PackPut64(p, c->firstScan);
+        LJUSB_PackPut64(p + 8, c->timestampNs);
+        LJUSB_PackPut64(p + 16, c->offset);
+        LJUSB_PackPut32(p + 24, (uint32_t)c->numScans);
+        LJUSB_PackPut32(p + 28, (uint32_t)c->size);
+        p += LJUSB_PACK_INDEX_ENTRY_SIZE;
+    }
+    LJUSB_PackPut32(p, LJUSB_PackCrc(record, size - 4));
+
+    memcpy(footer, LJUSB_PackFooterMagic, 4);
+    LJUSB_PackPut64(footer + 4, packWriter->stats.packedBytes);
+    LJUSB_PackPut32(footer + 12, LJUSB_PackCrc(footer, 12));
+
+    r = LJUSB_PackWriterWriteAll(packWriter, record, size);
+    if (r == 0) {
+        r = LJUSB_PackWriterWriteAll(packWriter, footer, LJUSB_PACK_FOOTER_SIZE);
+    }
+    if (r == 0) {
+        packWriter->stats.packedBytes += size + LJUSB_PACK_FOOTER_SIZE;
+    }
+
+    free(record);
+    return r;
+}
+
+
+LJUSB_StreamPackWriter *LJUSB_StreamPackWriterOpen(const char *path, const LJUSB_StreamPackHeader *header, unsigned long bufferSize, unsigned int numBuffers, int options)
+{
+    LJUSB_StreamPackWriter *packWriter;
+    BYTE encoded[LJUSB_PACK_HEADER_FIXED_SIZE + LJUSB_STREAM_MAX_CHANNELS*LJUSB_PACK_CHANNEL_SIZE + 4];
+    long size;
+    int error;
+
+    if ((options & LJUSB_WRITER_APPEND) != 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+    size = LJUSB_StreamPackHeaderEncode(header, encoded, sizeof(encoded));
+    if (size < 0) {
+        return NULL;
+    }
+
+    packWriter = (LJUSB_StreamPackWriter *)calloc(1, sizeof(LJUSB_StreamPackWriter));
+    if (packWriter == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    packWriter->numChannels = header->numChannels;
+    packWriter->scansPerChunk = header->scansPerChunk;
+    packWriter->scanPeriodNs = (header->scanRate > 0) ? 1.0e9/header->scanRate : 0;
+    packWriter->startTimeNs = header->startTimeNs;
+    packWriter->pending = (unsigned short *)malloc((size_t)header->scansPerChunk*header->numChannels*sizeof(unsigned short));
+    packWriter->chunk = (BYTE *)malloc(LJUSB_StreamPackBound(header->numChannels, header->scansPerChunk));
+    if (packWriter->pending == NULL || packWriter->chunk == NULL) {
+        free(packWriter->pending);
+        free(packWriter->chunk);
+        free(packWriter);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    packWriter->writer = LJUSB_StreamWriterOpen(path, bufferSize, numBuffers, 0, options);
+    if (packWriter->writer == NULL || LJUSB_StreamWriterWrite(packWriter->writer, encoded, (unsigned long)size) < 0) {
+        error = errno;
+        if (packWriter->writer != NULL) {
+            LJUSB_StreamWriterClose(packWriter->writer, NULL);
+        }
+        free(packWriter->pending);
+        free(packWriter->chunk);
+        free(packWriter);
+        errno = error;
+        return NULL;
+    }
+    packWriter->stats.packedBytes = (unsigned long long)size;
+
+    return packWriter;
+}
+
+
+long LJUSB_StreamPackWriterWrite(LJUSB_StreamPackWriter *packWriter, unsigned long long firstScan, const unsigned short *pRaw, unsigned long numScans)
+{
+    return LJUSB_StreamPackWriterWriteStamped(packWriter, firstScan, 0, pRaw, numScans);
+}
+
+
+long LJUSB_StreamPackWriterWriteStamped(LJUSB_StreamPackWriter *packWriter, unsigned long long firstScan, unsigned long long timestampNs, const unsigned short *pRaw, unsigned long numScans)
+{
+    unsigned long n, done = 0;
+    int dropped = 0;
+
+    if (packWriter == NULL || (pRaw == NULL && numScans > 0)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // Scans that do not follow the pending ones start a new chunk
+    if (packWriter->numPending > 0 && firstScan != packWriter->firstScan + packWriter->numPending) {
+        if (LJUSB_PackWriterFlush(packWriter) != 0) {
+            if (errno != ENOBUFS) {
+                return -1;
+            }
+            dropped = 1;
+        }
+    }
+
+    while (done < numScans) {
+        if (packWriter->numPending == 0) {
+            LJUSB_PackWriterStartChunk(packWriter, firstScan + done,
+                                       (timestampNs != 0) ? timestampNs + (unsigned long long)(done*packWriter->scanPeriodNs) : 0);
+        }
+
+        n = packWriter->scansPerChunk - packWriter->numPending;
+        if (n > numScans - done) {
+            n = numScans - done;
+        }
+        memcpy(packWriter->pending + packWriter->numPending*packWriter->numChannels,
+               pRaw + done*packWriter->numChannels, n*packWriter->numChannels*sizeof(unsigned short));
+        packWriter->numPending += n;
+        done += n;
+
+        if (packWriter->numPending == packWriter->scansPerChunk && LJUSB_PackWriterFlush(packWriter) != 0) {
+            if (errno != ENOBUFS) {
+                return -1;
+            }
+            dropped = 1;
+        }
+    }
+
+    packWriter->stats.scans += numScans;
+    packWriter->stats.rawBytes += (unsigned long long)numScans*packWriter->numChannels*sizeof(unsigned short);
+    if (dropped) {
+        errno = ENOBUFS;
+        return -1;
+    }
+    return (long)numScans;
+}
+
+
+int LJUSB_StreamPackWriterGetStats(LJUSB_StreamPackWriter *packWriter, LJUSB_StreamPackStats *stats)
+{
+    if (packWriter == NULL || stats == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (LJUSB_StreamWriterGetStats(packWriter->writer, &packWriter->stats.writer) != 0) {
+        return -1;
+    }
+    memcpy(stats, &packWriter->stats, sizeof(LJUSB_StreamPackStats));
+
+    return 0;
+}
+
+
+int LJUSB_StreamPackWriterClose(LJUSB_StreamPackWriter *packWriter, LJUSB_StreamPackStats *stats)
+{
+    int error = 0;
+
+    if (packWriter == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (LJUSB_PackWriterFlush(packWriter) != 0) {
+        error = errno;
+    }
+    if (LJUSB_PackWriterWriteIndex(packWriter) != 0 && error == 0) {
+        error = errno;
+    }
+    if (LJUSB_StreamWriterClose(packWriter->writer, &packWriter->stats.writer) != 0 && error == 0) {
+        error = errno;
+    }
+    if (stats != NULL) {
+        memcpy(stats, &packWriter->stats, sizeof(LJUSB_StreamPackStats));
+    }
+
+    free(packWriter->pending);
+    free(packWriter->chunk);
+    free(packWriter->index);
+    free(packWriter);
+
+    if (error != 0) {
+        errno = error;
+        return -1;
+    }
+    return 0;
+}
+
+
+LJUSB_StreamPackReader *LJUSB_StreamPackReaderOpen(const char *path, LJUSB_StreamPackHeader *header)
+{
+    LJUSB_StreamPackReader *reader;
+    BYTE encoded[LJUSB_PACK_HEADER_FIXED_SIZE + LJUSB_STREAM_MAX_CHANNELS*LJUSB_PACK_CHANNEL_SIZE + 4];
+    unsigned long count;
+    long r;
+    int error;
+
+    if (path == NULL || header == NULL) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    reader = (LJUSB_StreamPackReader *)calloc(1, sizeof(LJUSB_StreamPackReader));
+    if (reader == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    reader->file = fopen(path, "rb");
+    if (reader->file == NULL) {
+        error = errno;
+        free(reader);
+        errno = error;
+        return NULL;
+    }
+
+    // The fixed part gives the number of channels and so the header size
+    count = (unsigned long)fread(encoded, 1, LJUSB_PACK_HEADER_FIXED_SIZE, reader->file);
+    r = LJUSB_StreamPackHeaderDecode(encoded, count, header);
+    if (r < 0 && errno == EAGAIN && count == LJUSB_PACK_HEADER_FIXED_SIZE) {
+        count += (unsigned long)fread(encoded + count, 1, LJUSB_StreamPackHeaderSize(header->numChannels) - count, reader->file);
+        r = LJUSB_StreamPackHeaderDecode(encoded, count, header);
+    }
+    if (r < 0) {
+        // A header cut short by the end of the file is corrupt
+        error = (errno == EAGAIN) ? EBADMSG : errno;
+        fclose(reader->file);
+        free(reader);
+        errno = error;
+        return NULL;
+    }
+
+    reader->numChannels = header->numChannels;
+    reader->chunkSize = LJUSB_StreamPackBound(header->numChannels, header->scansPerChunk);
+    reader->chunk = (BYTE *)malloc(reader->chunkSize);
+    if (reader->chunk == NULL) {
+        fclose(reader->file);
+        free(reader);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    return reader;
+}
+
+
+long LJUSB_StreamPackReaderRead(LJUSB_StreamPackReader *reader, unsigned short *pRaw, unsigned long maxScans, unsigned long long *pFirstScan)
+{
+    LJUSB_StreamPackChunk info;
+    unsigned long count;
+
+    if (reader == NULL || pRaw == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    count = (unsigned long)fread(reader->chunk, 1, LJUSB_STREAM_PACK_CHUNK_HEADER_SIZE, reader->file);
+    if (count == 0 && feof(reader->file)) {
+        return 0;
+    }
+    if (count >= 4 && memcmp(reader->chunk, LJUSB_PackIndexMagic, 4) == 0) {
+        // The index follows the last chunk
+        fseek(reader->file, 0, SEEK_END);
+        return 0;
+    }
+    if (count < LJUSB_STREAM_PACK_CHUNK_HEADER_SIZE) {
+        errno = ferror(reader->file) ? EIO : EBADMSG;
+        return -1;
+    }
+    if (LJUSB_StreamPackChunkInfo(reader->chunk, count, &info) != 0) {
+        return -1;
+    }
+    if (info.size > reader->chunkSize) {
+        errno = EBADMSG;
+        return -1;
+    }
+
+    count += (unsigned long)fread(reader->chunk + count, 1, info.size - count, reader->file);
+    if (count < info.size) {
+        errno = ferror(reader->file) ? EIO : EBADMSG;
+        return -1;
+    }
+
+    return LJUSB_StreamUnpack(reader->chunk, count, reader->numChannels, pRaw, maxScans, pFirstScan);
+}
+
+
+void LJUSB_StreamPackReaderClose(LJUSB_StreamPackReader *reader)
+{
+    if (reader == NULL) {
+        return;
+    }
+
+    fclose(reader->file);
+    free(reader->chunk);
+    free(reader);
+}
+
+
+// Reads up to count bytes at offset.  Returns the number of bytes read (less
+// than count at the end of the file), or -1 and errno is set.
+static long LJUSB_PackReadAt(int fd, BYTE *p, unsigned long count, unsigned long long offset)
+{
+    unsigned long done = 0;
+    ssize_t r;
+
+    while (done < count) {
+        r = pread(fd, p + done, count - done, (off_t)(offset + done));
+        if (r < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        if (r == 0) {
+            break;
+        }
+        done += (unsigned long)r;
+    }
+
+    return (long)done;
+}
+
+
+// Loads the index written by LJUSB_StreamPackWriterClose.  Returns 0, or -1
+// if the file has no valid index.
+static int LJUSB_PackFileLoadIndex(LJUSB_StreamPackFile *file, unsigned long long headerSize)
+{
+    BYTE footer[LJUSB_PACK_FOOTER_SIZE];
+    unsigned long long indexOffset, size;
+    unsigned long numEntries, i;
+    LJUSB_StreamPackChunk *c;
+    BYTE *record, *p;
+
+    if (file->fileSize < headerSize + 12 + LJUSB_PACK_FOOTER_SIZE ||
+        LJUSB_PackReadAt(file->fd, footer, LJUSB_PACK_FOOTER_SIZE, file->fileSize - LJUSB_PACK_FOOTER_SIZE) != LJUSB_PACK_FOOTER_SIZE ||
+        memcmp(footer, LJUSB_PackFooterMagic, 4) != 0 || LJUSB_PackGet32(footer + 12) != LJUSB_PackCrc(footer, 12)) {
+        return -1;
+    }
+
+    indexOffset = LJUSB_PackGet64(footer + 4);
+    if (indexOffset < headerSize || indexOffset > file->fileSize - LJUSB_PACK_FOOTER_SIZE - 12) {
+        return -1;
+    }
+    size = file->fileSize - LJUSB_PACK_FOOTER_SIZE - indexOffset;
+    numEntries = (unsigned long)((size - 12)/LJUSB_PACK_INDEX_ENTRY_SIZE);
+    if (size != 12 + (unsigned long long)numEntries*LJUSB_PACK_INDEX_ENTRY_SIZE) {
+        return -1;
+    }
+
+    record = (BYTE *)malloc((size_t)size);
+    file->chunks = (LJUSB_StreamPackChunk *)malloc((numEntries > 0 ? numEntries : 1)*sizeof(LJUSB_StreamPackChunk));
+    if (record == NULL || file->chunks == NULL ||
+        LJUSB_PackReadAt(file->fd, record, (unsigned long)size, indexOffset) != (long)size ||
+        memcmp(record, LJUSB_PackIndexMagic, 4) != 0 || LJUSB_PackGet32(record + 4) != numEntries ||
+        LJUSB_PackGet32(record + size - 4) != LJUSB_PackCrc(record, (unsigned long)size - 4)) {
+        free(record);
+        free(file->chunks);
+        file->chunks = NULL;
+        return -1;
+    }
+
+    p = record + 8;
+    for (i = 0; i < numEntries; i++) {
+        c = &file->chunks[i];
+        c->firstScan = LJUSB_PackGet64(p);
+        c->timestampNs = LJUSB_PackGet64(p + 8);
+        c->offset = LJUSB_PackGet64(p + 16);
+        c->numScans = LJUSB_PackGet32(p + 24);
+        c->size = LJUSB_PackGet32(p + 28);
+        p += LJUSB_PACK_INDEX_ENTRY_SIZE;
+        if (c->offset < headerSize || c->offset + c->size > indexOffset) {
+            free(record);
+            free(file->chunks);
+            file->chunks = NULL;
+            return -1;
+        }
+    }
+    file->numChunks = numEntries;
+
+    free(record);
+    return 0;
+}
+
+
+// Rebuilds the index from the chunk headers, up to the index, the end of the
+// file or the first chunk that is cut short or corrupt.  Returns 0, or -1
+// and errno is set.
+static int LJUSB_PackFileRebuildIndex(LJUSB_StreamPackFile *file, unsigned long long headerSize)
+{
+    BYTE buff[LJUSB_STREAM_PACK_CHUNK_HEADER_SIZE];
+    unsigned long long offset = headerSize;
+    unsigned long maxChunks = 0;
+    LJUSB_StreamPackChunk info, *chunks;
+
+    file->numChunks = 0;
+    while (LJUSB_PackReadAt(file->fd, buff, sizeof(buff), offset) == (long)sizeof(buff) &&
+           LJUSB_StreamPackChunkInfo(buff, sizeof(buff), &info) == 0 &&
+           info.size <= LJUSB_StreamPackBound(file->numChannels, info.numScans) &&
+           offset + info.size <= file->fileSize) {
+        if (file->numChunks == maxChunks) {
+            maxChunks = (maxChunks > 0) ? maxChunks*2 : 1024;
+            chunks = (LJUSB_StreamPackChunk *)realloc(file->chunks, maxChunks*sizeof(LJUSB_StreamPackChunk));
+            if (chunks == NULL) {
+                errno = ENOMEM;
+                return -1;
+            }
+            file->chunks = chunks;
+        }
+        info.offset = offset;
+        file->chunks[file->numChunks++] = info;
+        offset += info.size;
+    }
+    file->indexRebuilt = 1;
+
+    return 0;
+}
+
+
+LJUSB_StreamPackFile *LJUSB_StreamPackFileOpen(const char *path, LJUSB_StreamPackHeader *header)
+{
+    LJUSB_StreamPackFile *file;
+    BYTE encoded[LJUSB_PACK_HEADER_FIXED_SIZE + LJUSB_STREAM_MAX_CHANNELS*LJUSB_PACK_CHANNEL_SIZE + 4];
+    struct stat st;
+    long count, headerSize;
+    int error;
+
+    if (path == NULL || header == NULL) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    file = (LJUSB_StreamPackFile *)calloc(1, sizeof(LJUSB_StreamPackFile));
+    if (file == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    file->fd = open(path, O_RDONLY);
+    if (file->fd < 0 || fstat(file->fd, &st) != 0) {
+        error = errno;
+        goto fail;
+    }
+    file->fileSize = (unsigned long long)st.st_size;
+
+    count = LJUSB_PackReadAt(file->fd, encoded, sizeof(encoded), 0);
+    headerSize = (count < 0) ? -1 : LJUSB_StreamPackHeaderDecode(encoded, (unsigned long)count, header);
+    if (headerSize < 0) {
+        // A header cut short by the end of the file is corrupt
+        error = (errno == EAGAIN) ? EBADMSG : errno;
+        goto fail;
+    }
+    file->numChannels = header->numChannels;
+    file->scanPeriodNs = (header->scanRate > 0) ? 1.0e9/header->scanRate : 0;
+
+    if (LJUSB_PackFileLoadIndex(file, (unsigned long long)headerSize) != 0 &&
+        LJUSB_PackFileRebuildIndex(file, (unsigned long long)headerSize) != 0) {
+        error = errno;
+        goto fail;
+    }
+
+    return file;
+
+fail:
+    if (file->fd >= 0) {
+        close(file->fd);
+    }
+    free(file->chunks);
+    free(file);
+    errno = error;
+    return NULL;
+}
+
+
+int LJUSB_StreamPackFileGetInfo(LJUSB_StreamPackFile *file, LJUSB_StreamPackFileInfo *info)
+{
+    const LJUSB_StreamPackChunk *last;
+    unsigned long i;
+
+    if (file == NULL || info == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    memset(info, 0, sizeof(LJUSB_StreamPackFileInfo));
+    info->numChunks = file->numChunks;
+    info->indexRebuilt = file->indexRebuilt;
+    if (file->numChunks == 0) {
+        return 0;
+    }
+
+    last = &file->chunks[file->numChunks - 1];
+    info->firstScan = file->chunks[0].firstScan;
+    info->endScan = last->firstScan + last->numScans;
+    info->startTimeNs = file->chunks[0].timestampNs;
+    info->endTimeNs = last->timestampNs + (unsigned long long)(last->numScans*file->scanPeriodNs);
+    for (i = 0; i < file->numChunks; i++) {
+        info->numScans += file->chunks[i].numScans;
+    }
+
+    return 0;
+}
+
+
+int LJUSB_StreamPackFileGetChunk(LJUSB_StreamPackFile *file, unsigned long chunk, LJUSB_StreamPackChunk *info)
+{
+    if (file == NULL || info == NULL || chunk >= file->numChunks) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    *info = file->chunks[chunk];
+    return 0;
+}
+
+
+long LJUSB_StreamPackFileFindTime(LJUSB_StreamPackFile *file, unsigned long long timeNs)
+{
+    unsigned long lo, hi, mid;
+
+    if (file == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (file->numChunks == 0) {
+        errno = ENOENT;
+        return -1;
+    }
+
+    // Last chunk with timestampNs <= timeNs; chunk times do not decrease
+    lo = 0;
+    hi = file->numChunks;
+    while (hi - lo > 1) {
+        mid = lo + (hi - lo)/2;
+        if (file->chunks[mid].timestampNs <= timeNs) {
+            lo = mid;
+        }
+        else {
+            hi = mid;
+        }
+    }
+
+    return (long)lo;
+}
+
+
+long LJUSB_StreamPackFileFindScan(LJUSB_StreamPackFile *file, unsigned long long scan)
+{
+    unsigned long lo, hi, mid;
+
+    if (file == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (file->numChunks == 0) {
+        errno = ENOENT;
+        return -1;
+    }
+
+    lo = 0;
+    hi = file->numChunks;
+    while (hi - lo > 1) {
+        mid = lo + (hi - lo)/2;
+        if (file->chunks[mid].firstScan <= scan) {
+            lo = mid;
+        }
+        else {
+            hi = mid;
+        }
+    }
+
+    return (long)lo;
+}
+
+
+unsigned long long LJUSB_StreamPackFileScanTime(LJUSB_StreamPackFile *file, unsigned long long scan)
+{
+    const LJUSB_StreamPackChunk *c, *next;
+    long i;
+    double d;
+
+    i = LJUSB_StreamPackFileFindScan(file, scan);
+    if (i < 0) {
+        return 0;
+    }
+
+    c = &file->chunks[i];
+    d = (double)scan - (double)c->firstScan;
+    if ((unsigned long)i + 1 < file->numChunks) {
+        next = &file->chunks[i + 1];
+        if (next->firstScan > c->firstScan && next->timestampNs >= c->timestampNs) {
+            return c->timestampNs + (unsigned long long)(d*(next->timestampNs - c->timestampNs)/(next->firstScan - c->firstScan));
+        }
+    }
+    if (d < 0) {
+        return c->timestampNs;
+    }
+    return c->timestampNs + (unsigned long long)(d*file->scanPeriodNs);
+}
+
+
+// Maps the chunks first to last into memory
+static int LJUSB_PackFileMap(LJUSB_StreamPackFile *file, unsigned long first, unsigned long last, LJUSB_StreamPackRegion *region)
+{
+    unsigned long long start, end, pageStart;
+    long pageSize = sysconf(_SC_PAGESIZE);
+    void *mapping;
+
+    start = file->chunks[first].offset;
+    end = file->chunks[last].offset + file->chunks[last].size;
+    pageStart = start - start % (unsigned long long)pageSize;
+
+    mapping = mmap(NULL, (size_t)(end - pageStart), PROT_READ, MAP_SHARED, file->fd, (off_t)pageStart);
+    if (mapping == MAP_FAILED) {
+        return -1;
+    }
+#ifdef MADV_WILLNEED
+    madvise(mapping, (size_t)(end - pageStart), MADV_WILLNEED);
+#endif
+
+    region->firstChunk = first;
+    region->numChunks = last - first + 1;
+    region->data = (const BYTE *)mapping + (start - pageStart);
+    region->size = end - start;
+    region->mapping = mapping;
+    region->mappingSize = end - pageStart;
+
+    return 0;
+}
+
+
+int LJUSB_StreamPackFileMapTime(LJUSB_StreamPackFile *file, unsigned long long startNs, unsigned long long endNs, LJUSB_StreamPackRegion *region)
+{
+    const LJUSB_StreamPackChunk *last;
+    long first, lastChunk;
+
+    if (file == NULL || region == NULL || endNs <= startNs) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (file->numChunks == 0) {
+        errno = ENOENT;
+        return -1;
+    }
+
+    first = LJUSB_StreamPackFileFindTime(file, startNs);
+    lastChunk = LJUSB_StreamPackFileFindTime(file, endNs - 1);
+    last = &file->chunks[lastChunk];
+    if (endNs <= file->chunks[0].timestampNs ||
+        startNs >= last->timestampNs + (unsigned long long)(last->numScans*file->scanPeriodNs)) {
+        errno = ENOENT;
+        return -1;
+    }
+
+    return LJUSB_PackFileMap(file, (unsigned long)first, (unsigned long)lastChunk, region);
+}
+
+
+int LJUSB_StreamPackFileMapScans(LJUSB_StreamPackFile *file, unsigned long long firstScan, unsigned long long numScans, LJUSB_StreamPackRegion *region)
+{
+    const LJUSB_StreamPackChunk *last;
+    long first, lastChunk;
+
+    if (file == NULL || region == NULL || numScans == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (file->numChunks == 0) {
+        errno = ENOENT;
+        return -1;
+    }
+
+    first = LJUSB_StreamPackFileFindScan(file, firstScan);
+    lastChunk = LJUSB_StreamPackFileFindScan(file, firstScan + numScans - 1);
+    last = &file->chunks[lastChunk];
+    if (firstScan + numScans <= file->chunks[0].firstScan || firstScan >= last->firstScan + last->numScans) {
+        errno = ENOENT;
+        return -1;
+    }
+
+    return LJUSB_PackFileMap(file, (unsigned long)first, (unsigned long)lastChunk, region);
+}
+
+
+long LJUSB_StreamPackRegionUnpack(LJUSB_StreamPackFile *file, const LJUSB_StreamPackRegion *region, unsigned long i, unsigned short *pRaw, unsigned long maxScans, unsigned long long *pFirstScan)
+{
+    const LJUSB_StreamPackChunk *c;
+
+    if (file == NULL || region == NULL || i >= region->numChunks || region->firstChunk + i >= file->numChunks) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    c = &file->chunks[region->firstChunk + i];
+    return LJUSB_StreamUnpack(region->data + (c->offset - file->chunks[region->firstChunk].offset), c->size,
+                              file->numChannels, pRaw, maxScans, pFirstScan);
+}
+
+
+void LJUSB_StreamPackFileUnmap(LJUSB_StreamPackRegion *region)
+{
+    if (region == NULL || region->mapping == NULL) {
+        return;
+    }
+
+    munmap(region->mapping, (size_t)region->mappingSize);
+    region->mapping = NULL;
+    region->data = NULL;
+    region->numChunks = 0;
+}
+
+
+void LJUSB_StreamPackFileClose(LJUSB_StreamPackFile *file)
+{
+    if (file == NULL) {
+        return;
+    }
+
+    close(file->fd);
+    free(file->chunks);
+    free(file);
+}
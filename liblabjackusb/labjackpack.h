@@ -0,0 +1,355 @@
+//-----------------------------------------------------------------------------
+//
+//  labjackpack.h
+//
+//  Header file for the packed stream format of the labjackusb library.
+//  Compresses scans of raw 16-bit stream codes without loss: each channel is
+//  delta coded, the deltas are zigzag coded and bit-packed in blocks of
+//  LJUSB_STREAM_PACK_BLOCK_SIZE with the bit width of the largest delta of
+//  the block.  Adjacent samples of an analog input usually differ by a few
+//  LSBs, so a block needs a few bits per sample instead of 16.  With SSE2 or
+//  NEON when available, 8 samples are coded at a time; the file is the same
+//  either way.
+//
+//  A packed stream file is a header followed by chunks and an index.  The
+//  header holds the stream settings and the binary to volts conversion of each
+//  channel, so the file can be converted to volts without the device.  Each
+//  chunk holds the scans firstScan to firstScan+numScans-1, the host time of
+//  its first scan and a CRC-32 of its data, and can be decoded on its own.
+//  The index, written when the file is closed, lists the scans, time and file
+//  offset of each chunk, so a reader can find a time or scan in O(log n) and
+//  map only the chunks it needs (LJUSB_StreamPackFileOpen).  A file without
+//  an index, such as one cut short by a crash, is indexed by reading its chunk
+//  headers.  All values are little-endian.
+//
+//  support@labjack.com
+//
+//  SPDX-FileCopyrightText: Copyright (c) 2009 LabJack Corporation
+//  SPDX-License-Identifier: X11
+//
+//-----------------------------------------------------------------------------
+//
+
+#ifndef LABJACKPACK_H_
+#define LABJACKPACK_H_
+
+#include "labjackstream.h"
+#include "labjackwriter.h"
+
+//Version of the packed stream format written by this library
+#define LJUSB_STREAM_PACK_VERSION           1
+
+//Number of deltas bit-packed with one bit width
+#define LJUSB_STREAM_PACK_BLOCK_SIZE        128
+
+//Maximum number of scans in a chunk
+#define LJUSB_STREAM_PACK_MAX_CHUNK_SCANS   65536
+
+//Size of a chunk header in bytes
+#define LJUSB_STREAM_PACK_CHUNK_HEADER_SIZE 32
+
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+
+//Header of a packed stream file
+typedef struct LJUSB_StreamPackHeader
+{
+    unsigned long productID;            //U3_PRODUCT_ID, U6_PRODUCT_ID or UE9_PRODUCT_ID
+    unsigned int numChannels;           //Channels in each scan
+    unsigned int scansPerChunk;         //Maximum scans in a chunk
+    int resolutionIndex;                //ResolutionIndex of the StreamConfig
+    double scanRate;                    //Scans per second
+    unsigned long long startTimeNs;     //Host time of the first scan
+                                        //(LJUSB_GetTimestampNs), or 0
+    BYTE channelNumbers[LJUSB_STREAM_MAX_CHANNELS];  //Positive channel numbers
+    BYTE channelOptions[LJUSB_STREAM_MAX_CHANNELS];  //Gain and range options
+    LJUSB_StreamChannelCal cal[LJUSB_STREAM_MAX_CHANNELS];  //Binary to volts
+                                                            //conversions
+} LJUSB_StreamPackHeader;
+
+//Chunk header values, from LJUSB_StreamPackChunkInfo
+typedef struct LJUSB_StreamPackChunk
+{
+    unsigned long size;                 //Size of the chunk, header included
+    unsigned long long firstScan;       //Stream index of the first scan
+    unsigned long long timestampNs;     //Host time of the first scan
+    unsigned long numScans;             //Scans in the chunk
+    unsigned long long offset;          //File offset of the chunk (index
+                                        //entries only)
+} LJUSB_StreamPackChunk;
+
+//Counters of a packed stream file writer
+typedef struct LJUSB_StreamPackStats
+{
+    unsigned long long scans;           //Scans passed to LJUSB_StreamPackWriterWrite
+    unsigned long long rawBytes;        //Size of those scans as raw codes
+    unsigned long long packedBytes;     //Bytes passed to the stream writer,
+                                        //file header included
+    unsigned long long chunks;          //Chunks written
+    unsigned long long droppedChunks;   //Chunks dropped because the stream
+                                        //writer had no room
+    unsigned long long droppedScans;    //Scans of the dropped chunks
+    unsigned long long packNs;          //Time spent packing, in ns
+    LJUSB_StreamWriterStats writer;     //Counters of the stream writer
+} LJUSB_StreamPackStats;
+
+//Packed stream file writer, from LJUSB_StreamPackWriterOpen
+typedef struct LJUSB_StreamPackWriter LJUSB_StreamPackWriter;
+
+//Packed stream file reader, from LJUSB_StreamPackReaderOpen
+typedef struct LJUSB_StreamPackReader LJUSB_StreamPackReader;
+
+//Indexed packed stream file, from LJUSB_StreamPackFileOpen
+typedef struct LJUSB_StreamPackFile LJUSB_StreamPackFile;
+
+//Summary of an indexed packed stream file, from LJUSB_StreamPackFileGetInfo
+typedef struct LJUSB_StreamPackFileInfo
+{
+    unsigned long numChunks;            //Chunks in the file
+    unsigned long long firstScan;       //Stream index of the first scan
+    unsigned long long endScan;         //Stream index after the last scan
+    unsigned long long numScans;        //Scans in the file (less than
+                                        //endScan - firstScan after gaps)
+    unsigned long long startTimeNs;     //Host time of the first scan
+    unsigned long long endTimeNs;       //Host time after the last scan
+    int indexRebuilt;                   //1 if the file had no valid index and
+                                        //it was rebuilt from the chunk headers
+} LJUSB_StreamPackFileInfo;
+
+//Chunks of an indexed packed stream file mapped into memory, from
+//LJUSB_StreamPackFileMapTime or LJUSB_StreamPackFileMapScans
+typedef struct LJUSB_StreamPackRegion
+{
+    unsigned long firstChunk;           //Index of the first chunk mapped
+    unsigned long numChunks;            //Chunks mapped
+    const BYTE *data;                   //The first chunk
+    unsigned long long size;            //Bytes of the chunks
+    void *mapping;                      //The mapping, page aligned
+    unsigned long long mappingSize;
+} LJUSB_StreamPackRegion;
+
+
+unsigned long LJUSB_StreamPackHeaderSize(unsigned int numChannels);
+// Returns the size in bytes of the file header of a stream of numChannels
+// channels.
+
+long LJUSB_StreamPackHeaderEncode(const LJUSB_StreamPackHeader *header, BYTE *pOut, unsigned long outSize);
+// Encodes a file header.  Returns the number of bytes stored, or -1 on error
+// and errno is set.
+// header = The header.  numChannels must be 1 to LJUSB_STREAM_MAX_CHANNELS
+//          and scansPerChunk 1 to LJUSB_STREAM_PACK_MAX_CHUNK_SCANS.
+// pOut = The buffer for the encoded header.
+// outSize = The size of pOut, at least LJUSB_StreamPackHeaderSize bytes.
+
+long LJUSB_StreamPackHeaderDecode(const BYTE *pBuff, unsigned long count, LJUSB_StreamPackHeader *header);
+// Decodes a file header.  Returns its size in bytes, or -1 on error and errno
+// is set:
+//   EINVAL - a parameter is invalid
+//   EAGAIN - count is less than the size of the header; read
+//            LJUSB_StreamPackHeaderSize(header->numChannels) bytes and try
+//            again (header->numChannels is set when count is 16 or more)
+//   EBADMSG - the data is not a packed stream header, or is corrupt
+//   ENOTSUP - the header is of a newer version of the format
+// pBuff = The start of the file.
+// count = The number of bytes of pBuff.
+// header = Returns the header.
+
+unsigned long LJUSB_StreamPackBound(unsigned int numChannels, unsigned long numScans);
+// Returns the largest possible size in bytes of a chunk of numScans scans of
+// numChannels channels, header included.
+
+long LJUSB_StreamPack(const unsigned short *pRaw, unsigned int numChannels, unsigned long numScans, unsigned long long firstScan, unsigned long long timestampNs, BYTE *pOut, unsigned long outSize);
+// Packs scans of raw codes into a chunk.  Returns the size of the chunk in
+// bytes, or -1 on error and errno is set.
+// pRaw = The scans, numScans*numChannels codes, as decoded by
+//        LJUSB_StreamDecode with LJUSB_STREAM_OUTPUT_RAW16.
+// numChannels = The number of channels in each scan.
+// numScans = The number of scans, 1 to LJUSB_STREAM_PACK_MAX_CHUNK_SCANS.
+// firstScan = The stream index of the first scan.
+// timestampNs = The host time of the first scan.
+// pOut = The buffer for the chunk.
+// outSize = The size of pOut, at least LJUSB_StreamPackBound bytes.
+
+int LJUSB_StreamPackChunkInfo(const BYTE *pChunk, unsigned long count, LJUSB_StreamPackChunk *info);
+// Reads the header of a chunk without decoding or checking its data.
+// Returns 0 on success, or -1 on error and errno is set (EBADMSG if pChunk is
+// not the start of a chunk).
+// pChunk = The start of the chunk.
+// count = The number of bytes of pChunk, at least
+//         LJUSB_STREAM_PACK_CHUNK_HEADER_SIZE.
+// info = Returns the chunk header values.
+
+long LJUSB_StreamUnpack(const BYTE *pChunk, unsigned long count, unsigned int numChannels, unsigned short *pRaw, unsigned long maxScans, unsigned long long *pFirstScan);
+// Checks the CRC of a chunk and unpacks its scans.  Returns the number of
+// scans, or -1 on error and errno is set:
+//   EINVAL - a parameter is invalid
+//   EAGAIN - count is less than the size of the chunk
+//   EBADMSG - the chunk is corrupt
+//   EMSGSIZE - the chunk has more than maxScans scans
+// pChunk = The chunk.
+// count = The number of bytes of pChunk.
+// numChannels = The number of channels in each scan, from the file header.
+// pRaw = The buffer for the scans, maxScans*numChannels codes.
+// maxScans = The number of scans pRaw can hold.
+// pFirstScan = If not NULL, returns the stream index of the first scan.
+
+LJUSB_StreamPackWriter *LJUSB_StreamPackWriterOpen(const char *path, const LJUSB_StreamPackHeader *header, unsigned long bufferSize, unsigned int numBuffers, int options);
+// Creates a packed stream file and writes its header.  Scans are packed
+// scansPerChunk at a time by the calling thread and written to the file by
+// a labjackwriter.h stream writer.  Returns the writer, or NULL on error and
+// errno is set.
+// path = The path of the file.
+// header = The header of the file.
+// bufferSize, numBuffers, options = The settings of the stream writer (see
+//                                   LJUSB_StreamWriterOpen).  options must
+//                                   not include LJUSB_WRITER_APPEND.
+
+long LJUSB_StreamPackWriterWrite(LJUSB_StreamPackWriter *packWriter, unsigned long long firstScan, const unsigned short *pRaw, unsigned long numScans);
+// Adds scans of raw codes to the file.  A chunk is packed and passed to the
+// stream writer when scansPerChunk scans are waiting, or when the scans do not
+// follow the waiting ones (firstScan is not the next stream index, after a
+// gap).  Never waits for the disk:  a chunk that does not fit in the stream
+// writer is dropped whole and counted in droppedChunks and droppedScans, so
+// the file stays readable.  Returns numScans, or -1 on error and errno is set
+// (ENOBUFS if a chunk was dropped).
+// packWriter = The writer.
+// firstScan = The stream index of the first scan, for example
+//             decoder->firstScanIndex after LJUSB_StreamDecode.
+// pRaw = The scans, numScans*numChannels codes.
+// numScans = The number of scans.
+// The host times of the chunks are counted from the header's startTimeNs at
+// the header's scanRate.  Use LJUSB_StreamPackWriterWriteStamped to record
+// measured times instead.
+
+long LJUSB_StreamPackWriterWriteStamped(LJUSB_StreamPackWriter *packWriter, unsigned long long firstScan, unsigned long long timestampNs, const unsigned short *pRaw, unsigned long numScans);
+// Same as LJUSB_StreamPackWriterWrite, and records the host time of the first
+// scan, so the index can find scans by time despite clock drift and gaps.
+// The times of the chunks must not decrease; a time before the last one
+// recorded is raised to it.
+// timestampNs = The host time of the first scan, for example
+//               LJUSB_StreamClockScanTime(&decoder->clock,
+//               decoder->firstScanIndex, NULL) after
+//               LJUSB_StreamDecodeStamped, or 0 if unknown (as with
+//               LJUSB_StreamPackWriterWrite).
+
+int LJUSB_StreamPackWriterGetStats(LJUSB_StreamPackWriter *packWriter, LJUSB_StreamPackStats *stats);
+// Returns the counters of a writer.  Call it from the thread that calls
+// LJUSB_StreamPackWriterWrite.  Returns 0 on success, or -1 on error and
+// errno is set.
+// packWriter = The writer.
+// stats = Returns the counters.
+
+int LJUSB_StreamPackWriterClose(LJUSB_StreamPackWriter *packWriter, LJUSB_StreamPackStats *stats);
+// Packs the waiting scans, writes the index (waiting for room in the stream
+// writer if needed), closes the stream writer and frees the writer.
+// Returns 0 on success, or -1 on error and errno is set.  The writer is freed
+// in both cases.
+// packWriter = The writer.
+// stats = If not NULL, returns the final counters.
+
+LJUSB_StreamPackReader *LJUSB_StreamPackReaderOpen(const char *path, LJUSB_StreamPackHeader *header);
+// Opens a packed stream file and reads its header.  Returns the reader, or
+// NULL on error and errno is set (see LJUSB_StreamPackHeaderDecode).
+// path = The path of the file.
+// header = Returns the header of the file.
+
+long LJUSB_StreamPackReaderRead(LJUSB_StreamPackReader *reader, unsigned short *pRaw, unsigned long maxScans, unsigned long long *pFirstScan);
+// Reads and unpacks the next chunk of the file.  Returns the number of scans,
+// 0 at the index or the end of the file, or -1 on error and errno is set (see
+// LJUSB_StreamUnpack; EBADMSG is also set for a chunk cut short by the end
+// of the file).
+// reader = The reader.
+// pRaw = The buffer for the scans, maxScans*numChannels codes.  maxScans =
+//        header->scansPerChunk always suffices.
+// maxScans = The number of scans pRaw can hold.
+// pFirstScan = If not NULL, returns the stream index of the first scan.
+
+void LJUSB_StreamPackReaderClose(LJUSB_StreamPackReader *reader);
+// Closes the file and frees the reader.
+// reader = The reader.
+
+LJUSB_StreamPackFile *LJUSB_StreamPackFileOpen(const char *path, LJUSB_StreamPackHeader *header);
+// Opens a packed stream file for random access and loads its index, or
+// rebuilds the index from the chunk headers if the file has none (reading a
+// few bytes per chunk, not the data).  Returns the file, or NULL on error and
+// errno is set (see LJUSB_StreamPackHeaderDecode).
+// path = The path of the file.
+// header = Returns the header of the file.
+
+int LJUSB_StreamPackFileGetInfo(LJUSB_StreamPackFile *file, LJUSB_StreamPackFileInfo *info);
+// Returns a summary of the file.  Returns 0 on success, or -1 on error and
+// errno is set.
+// file = The file.
+// info = Returns the summary.
+
+int LJUSB_StreamPackFileGetChunk(LJUSB_StreamPackFile *file, unsigned long chunk, LJUSB_StreamPackChunk *info);
+// Returns the index entry of a chunk.  Returns 0 on success, or -1 on error
+// and errno is set.
+// file = The file.
+// chunk = The index of the chunk, 0 to numChunks - 1.
+// info = Returns the entry.
+
+long LJUSB_StreamPackFileFindTime(LJUSB_StreamPackFile *file, unsigned long long timeNs);
+// Finds the chunk holding the scan at a host time with a binary search of the
+// index: the last chunk starting at or before timeNs, or chunk 0 if timeNs is
+// before the file.  Returns the index of the chunk, or -1 on error and errno
+// is set (ENOENT if the file has no chunks).
+// file = The file.
+// timeNs = The host time.
+
+long LJUSB_StreamPackFileFindScan(LJUSB_StreamPackFile *file, unsigned long long scan);
+// Finds the chunk holding a stream index with a binary search of the index:
+// the last chunk starting at or before scan, or chunk 0.  Returns the index
+// of the chunk, or -1 on error and errno is set (ENOENT if the file has no
+// chunks).
+// file = The file.
+// scan = The stream index.
+
+unsigned long long LJUSB_StreamPackFileScanTime(LJUSB_StreamPackFile *file, unsigned long long scan);
+// Returns the host time of a scan, interpolated between the times of the
+// chunks around it (or counted at the header's scanRate after the last one),
+// or 0 if the file has no chunks.
+// file = The file.
+// scan = The stream index.
+
+int LJUSB_StreamPackFileMapTime(LJUSB_StreamPackFile *file, unsigned long long startNs, unsigned long long endNs, LJUSB_StreamPackRegion *region);
+// Finds the chunks holding the scans from host time startNs up to endNs and
+// maps only those into memory.  Returns 0 on success, or -1 on error and
+// errno is set (ENOENT if no chunk overlaps the times, or from mmap).
+// Release the region with LJUSB_StreamPackFileUnmap.
+// file = The file.
+// startNs = The host time of the first scan wanted.
+// endNs = The host time after the last scan wanted, greater than startNs.
+// region = Returns the mapped chunks.
+
+int LJUSB_StreamPackFileMapScans(LJUSB_StreamPackFile *file, unsigned long long firstScan, unsigned long long numScans, LJUSB_StreamPackRegion *region);
+// Same as LJUSB_StreamPackFileMapTime for the stream indexes firstScan to
+// firstScan+numScans-1.
+
+long LJUSB_StreamPackRegionUnpack(LJUSB_StreamPackFile *file, const LJUSB_StreamPackRegion *region, unsigned long i, unsigned short *pRaw, unsigned long maxScans, unsigned long long *pFirstScan);
+// Checks and unpacks a chunk of a mapped region.  Returns the number of scans,
+// or -1 on error and errno is set (see LJUSB_StreamUnpack).
+// file = The file.
+// region = The region.
+// i = The chunk of the region, 0 to region->numChunks - 1.
+// pRaw = The buffer for the scans, maxScans*numChannels codes.
+// maxScans = The number of scans pRaw can hold.
+// pFirstScan = If not NULL, returns the stream index of the first scan.
+
+void LJUSB_StreamPackFileUnmap(LJUSB_StreamPackRegion *region);
+// Releases a mapped region.
+// region = The region.
+
+void LJUSB_StreamPackFileClose(LJUSB_StreamPackFile *file);
+// Closes the file and frees its index.  Unmap its regions first.
+// file = The file.
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LABJACKPACK_H_
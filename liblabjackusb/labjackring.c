@@ -0,0 +1,534 @@
+//---------------------------------------------------------------------------
+//
+//  labjackring.c
+//
+//    Shared memory stream ring for U3, U6 and UE9 stream data.
+//
+//  support@labjack.com
+//
+//  SPDX-FileCopyrightText: Copyright (c) 2009 LabJack Corporation
+//  SPDX-License-Identifier: X11
+//
+//---------------------------------------------------------------------------
+//
+
+#include "labjackring.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+static const BYTE LJUSB_RingMagic[4] = {'L', 'J', 'R', 'G'};
+
+// Offset of the scans from the start of the shared memory, past the header
+#define LJUSB_RING_DATA_OFFSET  16384
+
+// Layout of the start of the shared memory.  Only fixed size types, so 32 and
+// 64-bit processes can share a ring.  The publisher writes everything but
+// claim, commit, commitTimeNs and closed before it writes the magic, and never
+// after.
+//
+// Scan seq is at (seq & (capacity - 1)) in the data.  Publishing n scans
+// raises claim by n, copies the scans and then raises commit to claim, so
+// scans below commit are readable, and a scan seq a reader read is intact
+// if claim was at most seq + capacity after the read.  claim and commit are
+// on their own cache lines, apart from the header the readers read once.
+typedef struct LJUSB_RingShared
+{
+    BYTE magic[4];
+    uint32_t version;
+    uint64_t mapSize;
+    uint64_t capacity;
+    uint32_t numChannels;
+    uint32_t productID;
+    int32_t resolutionIndex;
+    int32_t publisherPid;
+    double scanRate;
+    uint64_t startTimeNs;
+    BYTE channelNumbers[LJUSB_STREAM_MAX_CHANNELS];
+    BYTE channelOptions[LJUSB_STREAM_MAX_CHANNELS];
+    double cal[LJUSB_STREAM_MAX_CHANNELS][4];
+
+    uint64_t claim __attribute__((aligned(64)));
+    uint64_t commit __attribute__((aligned(64)));
+    uint64_t commitTimeNs;
+    uint32_t closed;
+} LJUSB_RingShared;
+
+
+struct LJUSB_StreamRing
+{
+    LJUSB_RingShared *shared;
+    unsigned short *data;
+    size_t mapSize;
+    unsigned long long mask;
+    unsigned int numChannels;
+    char name[LJUSB_STREAM_RING_MAX_NAME + 2];
+};
+
+
+struct LJUSB_StreamRingReader
+{
+    const LJUSB_RingShared *shared;
+    const unsigned short *data;
+    size_t mapSize;
+    unsigned long long capacity;
+    unsigned int numChannels;
+    double scanRate;
+    pid_t publisherPid;
+
+    unsigned long long next;        // Sequence number of the next scan to read
+    unsigned long long lostScans;
+    unsigned long long overruns;
+};
+
+
+// Copies name to shmName with a leading '/'.  Returns 0 on success, or -1 and
+// errno is set.
+static int LJUSB_RingName(const char *name, char *shmName)
+{
+    size_t len;
+
+    if (name == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (name[0] == '/') {
+        name++;
+    }
+    len = strlen(name);
+    if (len == 0 || len > LJUSB_STREAM_RING_MAX_NAME || strchr(name, '/') != NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+    shmName[0] = '/';
+    memcpy(shmName + 1, name, len + 1);
+    return 0;
+}
+
+
+// Returns 1 if the publisher closed the ring or exited without closing it.
+static int LJUSB_RingIsClosed(const LJUSB_StreamRingReader *reader)
+{
+    if (__atomic_load_n(&reader->shared->closed, __ATOMIC_ACQUIRE)) {
+        return 1;
+    }
+    return (kill(reader->publisherPid, 0) != 0 && errno == ESRCH) ? 1 : 0;
+}
+
+
+LJUSB_StreamRing *LJUSB_StreamRingCreate(const char *name, const LJUSB_StreamRingInfo *info)
+{
+    LJUSB_StreamRing *ring;
+    LJUSB_RingShared *shared;
+    char shmName[LJUSB_STREAM_RING_MAX_NAME + 2];
+    size_t mapSize;
+    unsigned int i;
+    void *p;
+    int fd;
+
+    if (LJUSB_RingName(name, shmName) != 0) {
+        return NULL;
+    }
+    if (info == NULL || info->numChannels == 0 || info->numChannels > LJUSB_STREAM_MAX_CHANNELS ||
+        info->capacity < 2 || (info->capacity & (info->capacity - 1)) != 0 ||
+        info->capacity > (SIZE_MAX - LJUSB_RING_DATA_OFFSET)/(info->numChannels*sizeof(unsigned short)) ||
+        info->scanRate <= 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+    mapSize = LJUSB_RING_DATA_OFFSET + (size_t)info->capacity*info->numChannels*sizeof(unsigned short);
+
+    ring = (LJUSB_StreamRing *)calloc(1, sizeof(LJUSB_StreamRing));
+    if (ring == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    // A new object each time, so readers still attached to an old ring of the
+    // same name keep the old one
+    shm_unlink(shmName);
+    fd = shm_open(shmName, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0) {
+        free(ring);
+        return NULL;
+    }
+    if (ftruncate(fd, (off_t)mapSize) != 0) {
+        goto fail;
+    }
+    p = mmap(NULL, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) {
+        goto fail;
+    }
+    close(fd);
+
+    shared = (LJUSB_RingShared *)p;
+    shared->version = LJUSB_STREAM_RING_VERSION;
+    shared->mapSize = mapSize;
+    shared->capacity = info->capacity;
+    shared->numChannels = info->numChannels;
+    shared->productID = (uint32_t)info->productID;
+    shared->resolutionIndex = info->resolutionIndex;
+    shared->publisherPid = (int32_t)getpid();
+    shared->scanRate = info->scanRate;
+    shared->startTimeNs = info->startTimeNs;
+    for (i = 0; i < info->numChannels; i++) {
+        shared->channelNumbers[i] = info->channelNumbers[i];
+        shared->channelOptions[i] = info->channelOptions[i];
+        shared->cal[i][0] = info->cal[i].center;
+        shared->cal[i][1] = info->cal[i].slopeBelow;
+        shared->cal[i][2] = info->cal[i].slopeAbove;
+        shared->cal[i][3] = info->cal[i].offset;
+    }
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(shared->magic, LJUSB_RingMagic, sizeof(LJUSB_RingMagic));
+
+    ring->shared = shared;
+    ring->data = (unsigned short *)((BYTE *)p + LJUSB_RING_DATA_OFFSET);
+    ring->mapSize = mapSize;
+    ring->mask = info->capacity - 1;
+    ring->numChannels = info->numChannels;
+    strcpy(ring->name, shmName);
+    return ring;
+
+fail:
+    i = errno;
+    close(fd);
+    shm_unlink(shmName);
+    free(ring);
+    errno = i;
+    return NULL;
+}
+
+
+long LJUSB_StreamRingPublish(LJUSB_StreamRing *ring, const unsigned short *pRaw, unsigned long numScans)
+{
+    LJUSB_RingShared *shared;
+    unsigned long long head, pos, first;
+    size_t scanSize;
+
+    if (ring == NULL || (pRaw == NULL && numScans > 0) || numScans > ring->mask + 1) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (numScans == 0) {
+        return 0;
+    }
+
+    shared = ring->shared;
+    scanSize = ring->numChannels*sizeof(unsigned short);
+    head = shared->commit;
+    pos = head & ring->mask;
+    first = ring->mask + 1 - pos;
+    if (first > numScans) {
+        first = numScans;
+    }
+
+    // Claim the slots before overwriting them, so a reader that read them
+    // sees the claim when it checks
+    __atomic_store_n(&shared->claim, head + numScans, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(ring->data + pos*ring->numChannels, pRaw, first*scanSize);
+    if (first < numScans) {
+        memcpy(ring->data, pRaw + first*ring->numChannels, (numScans - first)*scanSize);
+    }
+    __atomic_store_n(&shared->commitTimeNs, LJUSB_GetTimestampNs(), __ATOMIC_RELAXED);
+    __atomic_store_n(&shared->commit, head + numScans, __ATOMIC_RELEASE);
+    return (long)numScans;
+}
+
+
+void LJUSB_StreamRingDestroy(LJUSB_StreamRing *ring)
+{
+    if (ring == NULL) {
+        return;
+    }
+    __atomic_store_n(&ring->shared->closed, 1, __ATOMIC_RELEASE);
+    munmap(ring->shared, ring->mapSize);
+    shm_unlink(ring->name);
+    free(ring);
+}
+
+
+LJUSB_StreamRingReader *LJUSB_StreamRingAttach(const char *name, LJUSB_StreamRingInfo *info, int fromOldest)
+{
+    LJUSB_StreamRingReader *reader;
+    const LJUSB_RingShared *shared;
+    char shmName[LJUSB_STREAM_RING_MAX_NAME + 2];
+    unsigned long long claim;
+    struct stat st;
+    unsigned int i;
+    void *p;
+    int fd, err;
+
+    if (LJUSB_RingName(name, shmName) != 0) {
+        return NULL;
+    }
+    if (info == NULL) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    fd = shm_open(shmName, O_RDONLY, 0);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (fstat(fd, &st) != 0) {
+        err = errno;
+        close(fd);
+        errno = err;
+        return NULL;
+    }
+    if (st.st_size < LJUSB_RING_DATA_OFFSET) {
+        close(fd);
+        errno = EBADMSG;
+        return NULL;
+    }
+    p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    err = errno;
+    close(fd);
+    if (p == MAP_FAILED) {
+        errno = err;
+        return NULL;
+    }
+
+    shared = (const LJUSB_RingShared *)p;
+    if (memcmp(shared->magic, LJUSB_RingMagic, sizeof(LJUSB_RingMagic)) != 0) {
+        munmap(p, (size_t)st.st_size);
+        errno = EBADMSG;
+        return NULL;
+    }
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (shared->version != LJUSB_STREAM_RING_VERSION || shared->mapSize != (uint64_t)st.st_size ||
+        shared->numChannels == 0 || shared->numChannels > LJUSB_STREAM_MAX_CHANNELS || shared->capacity < 2 ||
+        (shared->capacity & (shared->capacity - 1)) != 0 ||
+        LJUSB_RING_DATA_OFFSET + shared->capacity*shared->numChannels*sizeof(unsigned short) != shared->mapSize) {
+        munmap(p, (size_t)st.st_size);
+        errno = EBADMSG;
+        return NULL;
+    }
+
+    reader = (LJUSB_StreamRingReader *)calloc(1, sizeof(LJUSB_StreamRingReader));
+    if (reader == NULL) {
+        munmap(p, (size_t)st.st_size);
+        errno = ENOMEM;
+        return NULL;
+    }
+    reader->shared = shared;
+    reader->data = (const unsigned short *)((const BYTE *)p + LJUSB_RING_DATA_OFFSET);
+    reader->mapSize = (size_t)st.st_size;
+    reader->capacity = shared->capacity;
+    reader->numChannels = shared->numChannels;
+    reader->scanRate = shared->scanRate;
+    reader->publisherPid = (pid_t)shared->publisherPid;
+    if (fromOldest) {
+        claim = __atomic_load_n(&shared->claim, __ATOMIC_ACQUIRE);
+        reader->next = (claim > reader->capacity) ? claim - reader->capacity : 0;
+    } else {
+        reader->next = __atomic_load_n(&shared->commit, __ATOMIC_ACQUIRE);
+    }
+
+    memset(info, 0, sizeof(LJUSB_StreamRingInfo));
+    info->productID = shared->productID;
+    info->numChannels = shared->numChannels;
+    info->capacity = (unsigned long)shared->capacity;
+    info->resolutionIndex = shared->resolutionIndex;
+    info->scanRate = shared->scanRate;
+    info->startTimeNs = shared->startTimeNs;
+    for (i = 0; i < shared->numChannels; i++) {
+        info->channelNumbers[i] = shared->channelNumbers[i];
+        info->channelOptions[i] = shared->channelOptions[i];
+        info->cal[i].center = shared->cal[i][0];
+        info->cal[i].slopeBelow = shared->cal[i][1];
+        info->cal[i].slopeAbove = shared->cal[i][2];
+        info->cal[i].offset = shared->cal[i][3];
+    }
+    return reader;
+}
+
+
+long LJUSB_StreamRingPeek(LJUSB_StreamRingReader *reader, const unsigned short **pScans, unsigned long long *pSeq)
+{
+    unsigned long long commit, claim, pos, count;
+
+    if (reader == NULL || pScans == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    commit = __atomic_load_n(&reader->shared->commit, __ATOMIC_ACQUIRE);
+    claim = __atomic_load_n(&reader->shared->claim, __ATOMIC_RELAXED);
+
+    // Overrun since the last read: skip to the oldest scan the publisher is
+    // not overwriting
+    if (reader->next + reader->capacity < claim) {
+        reader->lostScans += claim - reader->capacity - reader->next;
+        reader->overruns++;
+        reader->next = claim - reader->capacity;
+    }
+
+    pos = reader->next & (reader->capacity - 1);
+    count = (commit > reader->next) ? commit - reader->next : 0;
+    if (count > reader->capacity - pos) {
+        count = reader->capacity - pos;
+    }
+    *pScans = reader->data + pos*reader->numChannels;
+    if (pSeq != NULL) {
+        *pSeq = reader->next;
+    }
+    return (long)count;
+}
+
+
+int LJUSB_StreamRingRelease(LJUSB_StreamRingReader *reader, unsigned long numScans)
+{
+    unsigned long long claim;
+
+    if (reader == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // Order the reads of the scans before the load of claim
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    claim = __atomic_load_n(&reader->shared->claim, __ATOMIC_RELAXED);
+    if (reader->next + reader->capacity < claim) {
+        reader->lostScans += claim - reader->capacity - reader->next;
+        reader->overruns++;
+        reader->next = claim - reader->capacity;
+        errno = EOVERFLOW;
+        return -1;
+    }
+    reader->next += numScans;
+    return 0;
+}
+
+
+long LJUSB_StreamRingRead(LJUSB_StreamRingReader *reader, unsigned short *pOut, unsigned long maxScans, unsigned long long *pSeq)
+{
+    const unsigned short *p;
+    unsigned long long seq;
+    unsigned long total = 0;
+    long n;
+
+    if (reader == NULL || (pOut == NULL && maxScans > 0)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // Up to two peeks when the scans wrap.  Scans overwritten while being
+    // copied are discarded with the ones before them, so the scans returned
+    // are always consecutive.
+    while (total < maxScans) {
+        n = LJUSB_StreamRingPeek(reader, &p, &seq);
+        if (n <= 0) {
+            break;
+        }
+        if ((unsigned long)n > maxScans - total) {
+            n = (long)(maxScans - total);
+        }
+        if (total == 0 && pSeq != NULL) {
+            *pSeq = seq;
+        }
+        memcpy(pOut + total*reader->numChannels, p, n*reader->numChannels*sizeof(unsigned short));
+        if (LJUSB_StreamRingRelease(reader, n) != 0) {
+            total = 0;
+            continue;
+        }
+        total += n;
+    }
+    return (long)total;
+}
+
+
+long LJUSB_StreamRingWait(LJUSB_StreamRingReader *reader, unsigned long minScans, unsigned int timeout)
+{
+    unsigned long long commit, claim, oldest, available, waitNs, deadline, now;
+    struct timespec ts;
+
+    if (reader == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (minScans > reader->capacity) {
+        minScans = (unsigned long)reader->capacity;
+    }
+
+    deadline = LJUSB_GetTimestampNs() + timeout*1000000ULL;
+    while (1) {
+        commit = __atomic_load_n(&reader->shared->commit, __ATOMIC_ACQUIRE);
+        claim = __atomic_load_n(&reader->shared->claim, __ATOMIC_RELAXED);
+        if (reader->next + reader->capacity < claim) {
+            // Overrun: the next peek skips to the oldest scan
+            oldest = claim - reader->capacity;
+            available = (commit > oldest) ? commit - oldest : 0;
+        } else {
+            available = (commit > reader->next) ? commit - reader->next : 0;
+        }
+        if (available >= minScans) {
+            return (long)available;
+        }
+        if (LJUSB_RingIsClosed(reader)) {
+            if (available == 0) {
+                errno = EPIPE;
+                return -1;
+            }
+            return (long)available;
+        }
+
+        now = LJUSB_GetTimestampNs();
+        if (now >= deadline) {
+            return (long)available;
+        }
+
+        // Sleep for about the time the missing scans take, between 100 us
+        // and 10 ms, and no later than the deadline
+        waitNs = (unsigned long long)((minScans - available)*1.0e9/reader->scanRate);
+        if (waitNs < 100000) {
+            waitNs = 100000;
+        } else if (waitNs > 10000000) {
+            waitNs = 10000000;
+        }
+        if (waitNs > deadline - now) {
+            waitNs = deadline - now;
+        }
+        ts.tv_sec = waitNs/1000000000ULL;
+        ts.tv_nsec = waitNs%1000000000ULL;
+        nanosleep(&ts, NULL);
+    }
+}
+
+
+int LJUSB_StreamRingGetStatus(LJUSB_StreamRingReader *reader, LJUSB_StreamRingStatus *status)
+{
+    if (reader == NULL || status == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    status->headSeq = __atomic_load_n(&reader->shared->commit, __ATOMIC_ACQUIRE);
+    status->publishTimeNs = __atomic_load_n(&reader->shared->commitTimeNs, __ATOMIC_RELAXED);
+    status->nextSeq = reader->next;
+    status->lag = (status->headSeq > reader->next) ? status->headSeq - reader->next : 0;
+    status->lostScans = reader->lostScans;
+    status->overruns = reader->overruns;
+    status->closed = LJUSB_RingIsClosed(reader);
+    return 0;
+}
+
+
+void LJUSB_StreamRingDetach(LJUSB_StreamRingReader *reader)
+{
+    if (reader == NULL) {
+        return;
+    }
+    munmap((void *)reader->shared, reader->mapSize);
+    free(reader);
+}
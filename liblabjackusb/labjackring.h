@@ -0,0 +1,170 @@
+//-----------------------------------------------------------------------------
+//
+//  labjackring.h
+//
+//  Header file for the shared memory stream ring of the labjackusb library.
+//  Only one process can claim a device's USB interface, so one process (the
+//  publisher) streams and publishes the decoded scans to a ring in shared
+//  memory (shm_open, /dev/shm on Linux), and any number of other processes
+//  attach to the ring by name and read the scans.
+//
+//  The ring has one writer and no locks.  Scans are numbered by a 64-bit
+//  sequence number, counting from 0 at the first scan published.  Readers
+//  map the ring read-only, keep their own position and read the scans in
+//  place, without copies or system calls, so a reader never slows the
+//  publisher or the other readers.  A reader that falls more than the ring's
+//  capacity behind is overrun: it detects it, counts the lost scans and skips
+//  to the oldest scan still in the ring.
+//
+//  support@labjack.com
+//
+//  SPDX-FileCopyrightText: Copyright (c) 2009 LabJack Corporation
+//  SPDX-License-Identifier: X11
+//
+//-----------------------------------------------------------------------------
+//
+
+#ifndef LABJACKRING_H_
+#define LABJACKRING_H_
+
+#include "labjackstream.h"
+
+//Version of the ring layout
+#define LJUSB_STREAM_RING_VERSION           1
+
+//Maximum length of a ring name, without the leading '/'.  Mac OS X limits
+//shared memory names to 31 characters.
+#define LJUSB_STREAM_RING_MAX_NAME          30
+
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+
+//Stream settings published with a ring
+typedef struct LJUSB_StreamRingInfo
+{
+    unsigned long productID;            //U3_PRODUCT_ID, U6_PRODUCT_ID or UE9_PRODUCT_ID
+    unsigned int numChannels;           //Channels in each scan
+    unsigned long capacity;             //Scans the ring holds, a power of 2
+    int resolutionIndex;                //ResolutionIndex of the StreamConfig
+    double scanRate;                    //Scans per second
+    unsigned long long startTimeNs;     //Host time of sequence number 0
+                                        //(LJUSB_GetTimestampNs), or 0
+    BYTE channelNumbers[LJUSB_STREAM_MAX_CHANNELS];  //Positive channel numbers
+    BYTE channelOptions[LJUSB_STREAM_MAX_CHANNELS];  //Gain and range options
+    LJUSB_StreamChannelCal cal[LJUSB_STREAM_MAX_CHANNELS];  //Binary to volts
+                                                            //conversions
+} LJUSB_StreamRingInfo;
+
+//State of a ring reader, from LJUSB_StreamRingGetStatus
+typedef struct LJUSB_StreamRingStatus
+{
+    unsigned long long nextSeq;         //Sequence number of the next scan to read
+    unsigned long long headSeq;         //Sequence number after the last scan
+                                        //published
+    unsigned long long lag;             //Scans published but not read yet
+    unsigned long long lostScans;       //Scans lost to overruns
+    unsigned long long overruns;        //Times the reader was overrun
+    unsigned long long publishTimeNs;   //Host time of the last publish
+    int closed;                         //1 if the publisher closed the ring
+} LJUSB_StreamRingStatus;
+
+//Ring of a publisher, from LJUSB_StreamRingCreate
+typedef struct LJUSB_StreamRing LJUSB_StreamRing;
+
+//Ring reader, from LJUSB_StreamRingAttach
+typedef struct LJUSB_StreamRingReader LJUSB_StreamRingReader;
+
+
+LJUSB_StreamRing *LJUSB_StreamRingCreate(const char *name, const LJUSB_StreamRingInfo *info);
+// Creates a ring in shared memory, replacing a ring of the same name left by
+// a publisher that exited without LJUSB_StreamRingDestroy.  Returns the ring,
+// or NULL on error and errno is set (EINVAL if a parameter is out of range,
+// or from shm_open, ftruncate or mmap).
+// name = The name of the ring, with or without a leading '/', at most
+//        LJUSB_STREAM_RING_MAX_NAME characters.
+// info = The stream settings.  capacity must be a power of 2 of at least 2
+//        scans; size it for the longest time a reader may stall, for
+//        example a few seconds of scans.
+
+long LJUSB_StreamRingPublish(LJUSB_StreamRing *ring, const unsigned short *pRaw, unsigned long numScans);
+// Copies scans of raw codes to the ring and makes them visible to the
+// readers.  Never waits for readers.  Returns numScans, or -1 on error and
+// errno is set.
+// ring = The ring.
+// pRaw = The scans, numScans*numChannels codes.  Decode with gap fill
+//        (LJUSB_StreamDecoderSetGapFill) to keep the sequence numbers equal
+//        to the stream scan indexes.
+// numScans = The number of scans, at most capacity.
+
+void LJUSB_StreamRingDestroy(LJUSB_StreamRing *ring);
+// Marks the ring closed, so readers see the end of the stream, and removes
+// its name.  Readers still attached keep their mapping until they detach.
+// ring = The ring.
+
+LJUSB_StreamRingReader *LJUSB_StreamRingAttach(const char *name, LJUSB_StreamRingInfo *info, int fromOldest);
+// Attaches to a ring by name.  Returns the reader, or NULL on error and errno
+// is set (ENOENT if there is no ring of that name, EBADMSG if it is not a
+// ring of this version).
+// name = The name of the ring.
+// info = Returns the stream settings of the ring.
+// fromOldest = 1 to start at the oldest scan in the ring, 0 to start at the
+//              next scan published.
+
+long LJUSB_StreamRingPeek(LJUSB_StreamRingReader *reader, const unsigned short **pScans, unsigned long long *pSeq);
+// Returns the scans published since the last read in place, without copying
+// them.  The scans returned are contiguous in the ring, so a second peek may
+// return more after the ring wraps.  Use the scans and then call
+// LJUSB_StreamRingRelease, which tells whether the publisher overwrote them
+// in the meantime.  Returns the number of scans (0 if there are none yet), or
+// -1 on error and errno is set.
+// reader = The reader.
+// pScans = Returns a pointer to the first scan in the ring.
+// pSeq = If not NULL, returns the sequence number of the first scan.
+
+int LJUSB_StreamRingRelease(LJUSB_StreamRingReader *reader, unsigned long numScans);
+// Ends the use of scans returned by LJUSB_StreamRingPeek and moves the
+// reader past them.  Returns 0 if the scans were intact, or -1 on error and
+// errno is set (EOVERFLOW if the publisher overwrote some of them while they
+// were in use; the reader was overrun and the scans must be discarded).
+// reader = The reader.
+// numScans = The number of scans used, at most the number peeked.
+
+long LJUSB_StreamRingRead(LJUSB_StreamRingReader *reader, unsigned short *pOut, unsigned long maxScans, unsigned long long *pSeq);
+// Copies the scans published since the last read, up to maxScans, to pOut.
+// Returns the number of scans (0 if there are none yet), or -1 on error and
+// errno is set.  Overruns are counted in the status; the scans copied are
+// always intact.
+// reader = The reader.
+// pOut = The buffer for the scans, maxScans*numChannels codes.
+// maxScans = The number of scans pOut can hold.
+// pSeq = If not NULL, returns the sequence number of the first scan.
+
+long LJUSB_StreamRingWait(LJUSB_StreamRingReader *reader, unsigned long minScans, unsigned int timeout);
+// Waits until at least minScans scans can be read, the publisher closes the
+// ring or timeout milliseconds pass, sleeping in steps of about the time the
+// publisher takes to publish the missing scans.  Returns the number of scans
+// that can be read, or -1 on error and errno is set (EPIPE if the ring is
+// closed and has no scans left).
+// reader = The reader.
+// minScans = The number of scans to wait for.
+// timeout = The longest time to wait in milliseconds.
+
+int LJUSB_StreamRingGetStatus(LJUSB_StreamRingReader *reader, LJUSB_StreamRingStatus *status);
+// Returns the state of a reader.  Returns 0 on success, or -1 on error and
+// errno is set.
+// reader = The reader.
+// status = Returns the state.
+
+void LJUSB_StreamRingDetach(LJUSB_StreamRingReader *reader);
+// Unmaps the ring and frees the reader.
+// reader = The reader.
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LABJACKRING_H_
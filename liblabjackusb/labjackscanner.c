@@ -0,0 +1,316 @@
+//---------------------------------------------------------------------------
+//
+//  labjackscanner.c
+//
+//    Feedback scanner for U3, U6 and UE9 devices.
+//
+//  support@labjack.com
+//
+//  SPDX-FileCopyrightText: Copyright (c) 2009 LabJack Corporation
+//  SPDX-License-Identifier: X11
+//
+//---------------------------------------------------------------------------
+//
+
+#include "labjackscanner.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+
+struct LJUSB_FeedbackScanner
+{
+    HANDLE hDevice;
+    unsigned long responseSize;
+    unsigned long long periodNs;
+    unsigned long long spinNs;
+    int priority;
+    LJUSB_FeedbackScannerCallback callback;
+    void *userData;
+
+    // Shared with the scanner thread, under lock
+    pthread_mutex_t lock;
+    BYTE command[LJUSB_SCANNER_PACKET_SIZE];
+    unsigned long commandSize;
+    bool commandChanged;
+    bool stopping;
+    LJUSB_FeedbackScannerStats stats;
+
+    pthread_t thread;
+};
+
+
+// The clock of the deadlines, which clock_nanosleep also uses
+static unsigned long long LJUSB_ScannerNowNs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec*1000000000ULL + ts.tv_nsec;
+}
+
+
+// Sleeps until spinNs before a deadline, then polls the clock until the
+// deadline
+static void LJUSB_ScannerWaitUntil(unsigned long long deadlineNs, unsigned long long spinNs)
+{
+    struct timespec ts;
+    unsigned long long wakeNs, now;
+
+    wakeNs = (deadlineNs > spinNs) ? deadlineNs - spinNs : 0;
+    now = LJUSB_ScannerNowNs();
+    if (now < wakeNs) {
+#ifdef TIMER_ABSTIME
+        ts.tv_sec = (time_t)(wakeNs/1000000000ULL);
+        ts.tv_nsec = (long)(wakeNs%1000000000ULL);
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+        }
+#else
+        // No absolute sleep (Mac OS X):  the spin absorbs the extra latency
+        ts.tv_sec = (time_t)((wakeNs - now)/1000000000ULL);
+        ts.tv_nsec = (long)((wakeNs - now)%1000000000ULL);
+        nanosleep(&ts, NULL);
+#endif
+    }
+
+    while (LJUSB_ScannerNowNs() < deadlineNs) {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    }
+}
+
+
+// Checks the checksums of an extended response and its command bytes against
+// the command.  Returns 0 if they are good, or -1 and sets errno.
+static int LJUSB_ScannerCheckResponse(const BYTE *command, const BYTE *b, unsigned long n)
+{
+    unsigned int i, a = 0, bb;
+
+    if (n < 8) {
+        errno = EIO;
+        return -1;
+    }
+
+    //Checksum16 is the sum of bytes 6 to n-1
+    for (i = 6; i < n; i++) {
+        a += b[i];
+    }
+    if (b[4] != (BYTE)(a & 0xFF) || b[5] != (BYTE)((a >> 8) & 0xFF)) {
+        errno = EBADMSG;
+        return -1;
+    }
+
+    //Checksum8 is the sum of bytes 1 to 5, with the quotient and remainder
+    //of 256 division summed twice
+    a = 0;
+    for (i = 1; i < 6; i++) {
+        a += b[i];
+    }
+    bb = a / 256;
+    a = (a - 256*bb) + bb;
+    bb = a / 256;
+    if (b[0] != (BYTE)((a - 256*bb) + bb)) {
+        errno = EBADMSG;
+        return -1;
+    }
+
+    if (b[1] != command[1] || b[3] != command[3]) {
+        errno = EBADMSG;
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static void *LJUSB_ScannerThread(void *arg)
+{
+    LJUSB_FeedbackScanner *scanner = (LJUSB_FeedbackScanner *)arg;
+    BYTE sendBuff[LJUSB_SCANNER_PACKET_SIZE], recBuff[LJUSB_SCANNER_PACKET_SIZE];
+    unsigned long long deadline, cycle = 0, skipped, t0, t1, lateNs, timestampNs, now;
+    unsigned long sendSize = 0, recChars;
+    struct sched_param param;
+    int realtime = 0, error;
+
+    if (scanner->priority > 0) {
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = scanner->priority;
+        realtime = (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0) ? 1 : 0;
+    }
+
+    deadline = LJUSB_ScannerNowNs() + scanner->periodNs;
+
+    pthread_mutex_lock(&scanner->lock);
+    scanner->stats.realtime = realtime;
+    for (;;) {
+        if (scanner->stopping) {
+            break;
+        }
+        if (scanner->commandChanged) {
+            memcpy(sendBuff, scanner->command, scanner->commandSize);
+            sendSize = scanner->commandSize;
+            scanner->commandChanged = false;
+        }
+        pthread_mutex_unlock(&scanner->lock);
+
+        LJUSB_ScannerWaitUntil(deadline, scanner->spinNs);
+
+        t0 = LJUSB_ScannerNowNs();
+        timestampNs = LJUSB_GetTimestampNs();
+        lateNs = t0 - deadline;
+        recChars = 0;
+        error = 0;
+        errno = 0;
+        if (LJUSB_Write(scanner->hDevice, sendBuff, sendSize) < sendSize) {
+            error = (errno != 0) ? errno : EIO;
+        }
+        else {
+            recChars = LJUSB_Read(scanner->hDevice, recBuff, scanner->responseSize);
+            if (LJUSB_ScannerCheckResponse(sendBuff, recBuff, recChars) != 0) {
+                error = errno;
+            }
+            else if (recChars < scanner->responseSize && recBuff[6] == 0) {
+                //Only a response with a non-zero errorcode can be short
+                error = EIO;
+            }
+        }
+        t1 = LJUSB_ScannerNowNs();
+
+        if (error == 0 && scanner->callback != NULL) {
+            scanner->callback(recBuff, recChars, cycle, timestampNs, scanner->userData);
+        }
+
+        //A cycle that ran past the next deadline skips the deadlines that
+        //passed, so the commands stay on the grid of the period
+        cycle++;
+        deadline += scanner->periodNs;
+        now = LJUSB_ScannerNowNs();
+        skipped = 0;
+        if (now > deadline) {
+            skipped = (now - deadline)/scanner->periodNs + 1;
+            cycle += skipped;
+            deadline += skipped*scanner->periodNs;
+        }
+
+        pthread_mutex_lock(&scanner->lock);
+        scanner->stats.cycles++;
+        scanner->stats.missed += skipped;
+        LJUSB_StreamAgeStatsAdd(&scanner->stats.startJitter, lateNs/1.0e3);
+        if (error == 0) {
+            scanner->stats.responses++;
+            if (recBuff[6] != 0) {
+                scanner->stats.deviceErrors++;
+            }
+            LJUSB_StreamAgeStatsAdd(&scanner->stats.roundTrip, (t1 - t0)/1.0e3);
+        }
+        else {
+            scanner->stats.errors++;
+            scanner->stats.error = error;
+        }
+    }
+    pthread_mutex_unlock(&scanner->lock);
+
+    return NULL;
+}
+
+
+LJUSB_FeedbackScanner *LJUSB_FeedbackScannerStart(HANDLE hDevice, const BYTE *pCommand, unsigned long commandSize, unsigned long responseSize, double periodUs, double spinUs, int priority, LJUSB_FeedbackScannerCallback callback, void *userData)
+{
+    LJUSB_FeedbackScanner *scanner;
+    int r;
+
+    if (hDevice == NULL || pCommand == NULL || commandSize < 8 || commandSize > LJUSB_SCANNER_PACKET_SIZE ||
+        responseSize < 8 || responseSize > LJUSB_SCANNER_PACKET_SIZE || !(periodUs >= 10) ||
+        !(spinUs >= 0) || spinUs > periodUs || priority < 0 || priority > 99) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    scanner = (LJUSB_FeedbackScanner *)calloc(1, sizeof(LJUSB_FeedbackScanner));
+    if (scanner == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    scanner->hDevice = hDevice;
+    scanner->responseSize = responseSize;
+    scanner->periodNs = (unsigned long long)(periodUs*1000 + 0.5);
+    scanner->spinNs = (unsigned long long)(spinUs*1000 + 0.5);
+    scanner->priority = priority;
+    scanner->callback = callback;
+    scanner->userData = userData;
+    memcpy(scanner->command, pCommand, commandSize);
+    scanner->commandSize = commandSize;
+    scanner->commandChanged = true;
+
+    pthread_mutex_init(&scanner->lock, NULL);
+    LJUSB_StreamAgeStatsReset(&scanner->stats.startJitter);
+    LJUSB_StreamAgeStatsReset(&scanner->stats.roundTrip);
+
+    r = pthread_create(&scanner->thread, NULL, LJUSB_ScannerThread, scanner);
+    if (r != 0) {
+        pthread_mutex_destroy(&scanner->lock);
+        free(scanner);
+        errno = r;
+        return NULL;
+    }
+
+    return scanner;
+}
+
+
+int LJUSB_FeedbackScannerSetCommand(LJUSB_FeedbackScanner *scanner, const BYTE *pCommand, unsigned long commandSize)
+{
+    if (scanner == NULL || pCommand == NULL || commandSize < 8 || commandSize > LJUSB_SCANNER_PACKET_SIZE) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    pthread_mutex_lock(&scanner->lock);
+    memcpy(scanner->command, pCommand, commandSize);
+    scanner->commandSize = commandSize;
+    scanner->commandChanged = true;
+    pthread_mutex_unlock(&scanner->lock);
+
+    return 0;
+}
+
+
+int LJUSB_FeedbackScannerGetStats(LJUSB_FeedbackScanner *scanner, LJUSB_FeedbackScannerStats *stats)
+{
+    if (scanner == NULL || stats == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    pthread_mutex_lock(&scanner->lock);
+    *stats = scanner->stats;
+    pthread_mutex_unlock(&scanner->lock);
+
+    return 0;
+}
+
+
+int LJUSB_FeedbackScannerStop(LJUSB_FeedbackScanner *scanner, LJUSB_FeedbackScannerStats *stats)
+{
+    if (scanner == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    pthread_mutex_lock(&scanner->lock);
+    scanner->stopping = true;
+    pthread_mutex_unlock(&scanner->lock);
+    pthread_join(scanner->thread, NULL);
+
+    if (stats != NULL) {
+        *stats = scanner->stats;
+    }
+    pthread_mutex_destroy(&scanner->lock);
+    free(scanner);
+
+    return 0;
+}
@@ -0,0 +1,132 @@
+//-----------------------------------------------------------------------------
+//
+//  labjackscanner.h
+//
+//  Header file for the Feedback scanner of the labjackusb library.  Sends a
+//  prepared command/response command, such as a U3, U6 or UE9 Feedback
+//  command, at a fixed period from a dedicated thread, with absolute
+//  deadlines and an optional busy-wait before each one, and keeps histograms
+//  of how late each command starts and of its round trip time.
+//
+//  support@labjack.com
+//
+//  SPDX-FileCopyrightText: Copyright (c) 2009 LabJack Corporation
+//  SPDX-License-Identifier: X11
+//
+//-----------------------------------------------------------------------------
+//
+
+#ifndef LABJACKSCANNER_H_
+#define LABJACKSCANNER_H_
+
+#include "labjackstream.h"
+
+//Largest command and response packet of a scanner
+#define LJUSB_SCANNER_PACKET_SIZE     64
+
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+
+//Feedback scanner, from LJUSB_FeedbackScannerStart
+typedef struct LJUSB_FeedbackScanner LJUSB_FeedbackScanner;
+
+//Counters of a Feedback scanner, from LJUSB_FeedbackScannerGetStats
+typedef struct LJUSB_FeedbackScannerStats
+{
+    unsigned long long cycles;          //Commands sent
+    unsigned long long responses;       //Good responses passed to the callback
+    unsigned long long missed;          //Deadlines skipped because a cycle
+                                        //ran past the next one
+    unsigned long long errors;          //Cycles whose write or read failed, or
+                                        //whose response was short or bad
+    unsigned long long deviceErrors;    //Good responses with a non-zero
+                                        //errorcode (byte 6)
+    int error;                          //errno of the last failed cycle, or 0
+    int realtime;                       //1 if the thread runs with the
+                                        //requested real-time priority
+    LJUSB_StreamAgeStats startJitter;   //How late each command was written
+                                        //after its deadline, in us
+    LJUSB_StreamAgeStats roundTrip;     //Time from the write of each command
+                                        //to the end of its read, in us
+} LJUSB_FeedbackScannerStats;
+
+//Called by the scanner thread with each good response.  It runs inside the
+//cycle, so it should only copy or convert the response:  a callback longer
+//than the period makes the scanner miss deadlines.
+//pResponse = The response packet, responseSize bytes.  The buffer is reused
+//            when the callback returns.
+//responseSize = The number of bytes read, which can be less than the
+//               response size of LJUSB_FeedbackScannerStart if the
+//               errorcode (pResponse[6]) is not 0.
+//cycle = The number of the cycle, counting the missed deadlines, so the
+//        deadline of the command was cycle periods after the first one.
+//timestampNs = LJUSB_GetTimestampNs when the command was written.
+//userData = The userData of LJUSB_FeedbackScannerStart.
+typedef void (*LJUSB_FeedbackScannerCallback)(const BYTE *pResponse, unsigned long responseSize, unsigned long long cycle, unsigned long long timestampNs, void *userData);
+
+
+LJUSB_FeedbackScanner *LJUSB_FeedbackScannerStart(HANDLE hDevice, const BYTE *pCommand, unsigned long commandSize, unsigned long responseSize, double periodUs, double spinUs, int priority, LJUSB_FeedbackScannerCallback callback, void *userData);
+// Starts a thread that writes a command to a device and reads its response
+// once per period.  The deadlines are absolute (the first one plus a
+// multiple of the period), so the time a cycle takes does not delay the
+// next ones.  The thread sleeps with clock_nanosleep until spinUs before
+// each deadline, then polls the clock until the deadline, which removes the
+// wake-up latency of the sleep at the cost of spinUs of CPU per cycle.  A
+// cycle that ends after the next deadline skips the deadlines that passed
+// instead of sending commands back to back.  Responses are checked (size,
+// checksums and command bytes) before they are passed to the callback.  The
+// device must not be used by other threads while the scanner runs.  Returns
+// the scanner, or NULL on error and errno is set:
+//   EINVAL - a parameter is out of range
+//   ENOMEM - the scanner could not be allocated
+//   others - from pthread_create
+// hDevice = The handle of the device.
+// pCommand = The command packet with its checksums, commandSize bytes, for
+//            example the sendBuff of a U6 Feedback command built by
+//            ehFeedbackPrepare.  It is copied.
+// commandSize = The number of command bytes (8 to
+//               LJUSB_SCANNER_PACKET_SIZE).
+// responseSize = The number of response bytes expected (8 to
+//                LJUSB_SCANNER_PACKET_SIZE).
+// periodUs = The period in microseconds (10 or more).
+// spinUs = The time to busy-wait before each deadline in microseconds, from
+//          0 to periodUs.  Set it a little above the wake-up latency of the
+//          system, typically 50 to 100 us without a real-time kernel.
+// priority = The SCHED_FIFO priority of the thread (1 to 99), or 0 to keep
+//            the normal scheduling.  If it cannot be set (permissions), the
+//            thread runs with normal scheduling and the realtime field of
+//            the stats is 0.
+// callback = Called with each good response, or NULL.
+// userData = Passed to callback.
+
+int LJUSB_FeedbackScannerSetCommand(LJUSB_FeedbackScanner *scanner, const BYTE *pCommand, unsigned long commandSize);
+// Replaces the command sent by the scanner from the next cycle on, for
+// example after changing a DAC value with ehFeedbackPatch16.  The response
+// size stays the same.  Returns 0 on success, or -1 on error and errno is
+// set.
+// scanner = The scanner.
+// pCommand = The command packet with its checksums.  It is copied.
+// commandSize = The number of command bytes.
+
+int LJUSB_FeedbackScannerGetStats(LJUSB_FeedbackScanner *scanner, LJUSB_FeedbackScannerStats *stats);
+// Returns the counters of a scanner, from any thread.  Returns 0 on success,
+// or -1 on error and errno is set.
+// scanner = The scanner.
+// stats = Returns the counters.
+
+int LJUSB_FeedbackScannerStop(LJUSB_FeedbackScanner *scanner, LJUSB_FeedbackScannerStats *stats);
+// Stops the scanner thread after its current cycle, which can take up to
+// one period, and frees the scanner.  Returns 0 on success, or -1 on error
+// and errno is set.
+// scanner = The scanner.
+// stats = If not NULL, returns the final counters.
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LABJACKSCANNER_H_
@@ -0,0 +1,110 @@
+//-----------------------------------------------------------------------------
+//
+//  labjackshared.h
+//
+//  Header file for sharing U3, U6 and UE9 devices between processes with the
+//  ljshared daemon.  The daemon opens the devices with liblabjackusb and
+//  serves clients over a Unix socket.  Clients link liblabjackusb_client
+//  (make client) instead of liblabjackusb; it has the same labjackusb.h
+//  functions, so existing programs share devices without changes, either
+//  relinked or by preloading liblabjackusb_client.so.
+//
+//  Commands written by clients are queued by device, taken from the clients
+//  in turn and pipelined on the device: the next command is written while
+//  the device runs the previous one.  Each response goes back to the client
+//  that wrote the command.  Streams started by a client are read by the
+//  daemon into a shared memory stream ring (labjackring.h) of StreamData
+//  packets, and any client of the device reads them with LJUSB_Stream, so
+//  several processes can subscribe to one stream.  Only the client that
+//  started a stream stops it.
+//
+//  support@labjack.com
+//
+//  SPDX-FileCopyrightText: Copyright (c) 2009 LabJack Corporation
+//  SPDX-License-Identifier: X11
+//
+//-----------------------------------------------------------------------------
+//
+
+#ifndef LABJACKSHARED_H_
+#define LABJACKSHARED_H_
+
+#include <stdint.h>
+#include "labjackusb.h"
+
+//Socket of the daemon, unless the LJSHARED_SOCKET environment variable is
+//set
+#define LJUSB_SHARED_SOCKET             "/tmp/ljshared.sock"
+
+//Largest command a client can write.  Responses are read from the device
+//in one full speed USB packet.
+#define LJUSB_SHARED_MAX_COMMAND        256
+#define LJUSB_SHARED_MAX_RESPONSE       64
+
+//Commands a client can write ahead of reading their responses
+#define LJUSB_SHARED_MAX_PENDING        32
+
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+
+//Command timing of a client device handle, from LJUSB_SharedGetStats
+typedef struct LJUSB_SharedStats
+{
+    unsigned long long commands;        //Commands with a response read
+    double meanRoundTripUs;             //Write to read, as seen by the client
+    double meanDeviceUs;                //Write to read on the device, as seen
+                                        //by the daemon: the time of direct
+                                        //access
+    double meanQueueUs;                 //Wait for commands of other clients
+    double meanOverheadUs;              //Round trip minus device time
+    double maxOverheadUs;
+} LJUSB_SharedStats;
+
+
+int LJUSB_SharedGetStats(HANDLE hDevice, LJUSB_SharedStats *stats);
+// Returns the command timing of a device handle of liblabjackusb_client, to
+// compare the latency through the daemon with direct access.  Returns 0 on
+// success, or -1 on error and errno is set.
+// hDevice = The handle of the device.
+// stats = Returns the timing.
+
+int LJUSB_SharedResetStats(HANDLE hDevice);
+// Clears the command timing of a device handle.  Returns 0 on success, or -1
+// on error and errno is set.
+// hDevice = The handle of the device.
+
+
+//Messages between the daemon and the clients.  Each is a LJUSB_SharedMsg
+//followed by size bytes.  A client opens one connection per device handle.
+enum
+{
+    LJUSB_SHARED_MSG_COUNT = 1,     //arg = productID.  Reply arg = device count.
+    LJUSB_SHARED_MSG_OPEN,          //arg = productID << 32 | devNum.  Reply
+                                    //handle and arg = release number.
+    LJUSB_SHARED_MSG_WRITE,         //The command.  No reply.
+    LJUSB_SHARED_MSG_RESPONSE,      //From the daemon: the response of the
+                                    //oldest command written
+    LJUSB_SHARED_MSG_STREAM         //arg = read size.  Reply: the name of the
+                                    //stream ring, on a connection of its own
+};
+
+typedef struct LJUSB_SharedMsg
+{
+    uint32_t type;
+    uint32_t handle;                //Device of the daemon
+    uint32_t size;                  //Bytes after the message
+    int32_t status;                 //0, or errno of a failed request
+    uint64_t arg;
+    uint64_t deviceNs;              //RESPONSE: device time of the command
+    uint64_t queueNs;               //RESPONSE: wait behind other clients
+} LJUSB_SharedMsg;
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LABJACKSHARED_H_
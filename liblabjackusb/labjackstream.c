@@ -0,0 +1,1043 @@
+//---------------------------------------------------------------------------
+//
+//  labjackstream.c
+//
+//    Stream decoding functions for U3, U6 and UE9 StreamData responses.
+//
+//  support@labjack.com
+//
+//  SPDX-FileCopyrightText: Copyright (c) 2009 LabJack Corporation
+//  SPDX-License-Identifier: X11
+//
+//---------------------------------------------------------------------------
+//
+
+#include "labjackstream.h"
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+
+#define UE9_STREAM_SAMPLES_PER_PACKET  16
+#define UE9_STREAM_PACKET_SIZE         46  // Bytes used in each response
+#define UE9_STREAM_PACKET_STRIDE       48  // Bytes read for each response
+
+#define U3U6_STREAM_MAX_SAMPLES_PER_PACKET  25
+
+#define STREAM_PLAN_USB_LATENCY_US     1000.0    // USB frame and completion time of a read
+#define STREAM_PLAN_TURNAROUND_US      1000.0    // Time to complete and resubmit a read
+#define STREAM_PLAN_NO_BUDGET_FILL_US  100000.0  // Fill time of reads without a budget
+#define STREAM_PLAN_MAX_READ_PACKETS   256       // Responses in the largest read
+#define STREAM_PLAN_MAX_SHORT_READS    8000.0    // Reads per second of short responses
+
+#define STREAM_CLOCK_INITIAL_P         1.0e6  // Initial scaled covariance
+#define STREAM_CLOCK_SETTLE_UPDATES    16     // Pairs before outliers are rejected
+#define STREAM_CLOCK_REJECT_SIGMA      5.0    // Residual that rejects a pair
+#define STREAM_CLOCK_MAX_REJECTED      8      // Rejected pairs that restart the fit
+#define STREAM_CLOCK_RESTART_NS        1.0e9  // ... if they span this much host time
+#define STREAM_AGE_MAX_RATE_ERROR      1.0e-3 // Largest plausible device clock error
+#define STREAM_AGE_MAX_FIT_ERROR       1.0e-5 // Largest measured rate error used
+
+
+// A stream clock setting:  the ScanConfig bits and the resulting clock
+typedef struct LJUSB_StreamPlanClock
+{
+    BYTE scanConfig;
+    double hz;
+} LJUSB_StreamPlanClock;
+
+// In order of preference on a tie
+static const LJUSB_StreamPlanClock U3U6_STREAM_CLOCKS[4] = {
+    {0x08, 48.0e6}, {0x00, 4.0e6}, {0x08, 48.0e6/256}, {0x00, 4.0e6/256}
+};
+
+static const LJUSB_StreamPlanClock UE9_STREAM_CLOCKS[8] = {
+    {0x08, 48.0e6}, {0x18, 24.0e6}, {0x00, 4.0e6}, {0x10, 750.0e3},
+    {0x0A, 48.0e6/256}, {0x1A, 24.0e6/256}, {0x02, 4.0e6/256}, {0x12, 750.0e3/256}
+};
+
+// Approximate maximum stream sample rates by resolution
+static const double U3_STREAM_MAX_RATE[4] = {2500, 10000, 20000, 50000};
+static const double U6_STREAM_MAX_RATE[9] = {50000, 50000, 30000, 16000, 8400, 4000, 2000, 1000, 500};
+static const double UE9_STREAM_MAX_RATE[5] = {50000, 25000, 13000, 6000, 2500};
+
+
+static unsigned short LJUSB_StreamChecksum16(const BYTE *b, unsigned int n)
+{
+    unsigned int i, a = 0;
+
+    //Sums bytes 6 to n-1 to an unsigned 2 byte value
+    for (i = 6; i < n; i++) {
+        a += b[i];
+    }
+
+    return (unsigned short)a;
+}
+
+
+static BYTE LJUSB_StreamChecksum8(const BYTE *b)
+{
+    unsigned int i, a = 0, bb;
+
+    //Sums bytes 1 to 5.  Sums quotient and remainder of 256 division.  Again,
+    //sums quotient and remainder of 256 division.
+    for (i = 1; i < 6; i++) {
+        a += b[i];
+    }
+
+    bb = a / 256;
+    a = (a - 256*bb) + bb;
+    bb = a / 256;
+
+    return (BYTE)((a - 256*bb) + bb);
+}
+
+
+static double LJUSB_StreamConvertCode(const LJUSB_StreamChannelCal *cal, unsigned short code)
+{
+    double value = (double)code - cal->center;
+
+    if (value < 0) {
+        return value*cal->slopeBelow + cal->offset;
+    }
+    return value*cal->slopeAbove + cal->offset;
+}
+
+
+static void LJUSB_StreamEmitScan(const LJUSB_StreamDecoder *decoder, const unsigned short *row, void *pOut, unsigned long scan)
+{
+    unsigned int i;
+    unsigned int n = decoder->numChannels;
+    float *f;
+    double *d;
+
+    switch (decoder->outputMode) {
+    case LJUSB_STREAM_OUTPUT_RAW16:
+        memcpy((unsigned short *)pOut + scan*n, row, n*sizeof(unsigned short));
+        break;
+    case LJUSB_STREAM_OUTPUT_FLOAT32:
+        f = (float *)pOut + scan*n;
+        for (i = 0; i < n; i++) {
+            f[i] = (float)LJUSB_StreamConvertCode(&decoder->cal[i], row[i]);
+        }
+        break;
+    case LJUSB_STREAM_OUTPUT_FLOAT64:
+        d = (double *)pOut + scan*n;
+        for (i = 0; i < n; i++) {
+            d[i] = LJUSB_StreamConvertCode(&decoder->cal[i], row[i]);
+        }
+        break;
+    }
+}
+
+
+// Stores numFill fill scans starting at output scan scan
+static void LJUSB_StreamEmitFill(const LJUSB_StreamDecoder *decoder, void *pOut, unsigned long scan, unsigned long numFill)
+{
+    unsigned long i;
+    unsigned long n = numFill*decoder->numChannels;
+    unsigned short *u;
+    float *f;
+    double *d;
+
+    switch (decoder->outputMode) {
+    case LJUSB_STREAM_OUTPUT_RAW16:
+        u = (unsigned short *)pOut + scan*decoder->numChannels;
+        for (i = 0; i < n; i++) {
+            u[i] = decoder->gapFillCode;
+        }
+        break;
+    case LJUSB_STREAM_OUTPUT_FLOAT32:
+        f = (float *)pOut + scan*decoder->numChannels;
+        for (i = 0; i < n; i++) {
+            f[i] = NAN;
+        }
+        break;
+    case LJUSB_STREAM_OUTPUT_FLOAT64:
+        d = (double *)pOut + scan*decoder->numChannels;
+        for (i = 0; i < n; i++) {
+            d[i] = NAN;
+        }
+        break;
+    }
+}
+
+
+// Clears the sums of the channels for a new block
+static void LJUSB_StreamStatsStart(LJUSB_StreamDecoder *decoder)
+{
+    LJUSB_StreamStatsSums *sums;
+    double center;
+    unsigned int i;
+
+    for (i = 0; i < decoder->numChannels; i++) {
+        sums = &decoder->statsSums[i];
+        memset(sums, 0, sizeof(LJUSB_StreamStatsSums));
+        center = ceil(decoder->cal[i].center);
+        sums->statsCenter = (center < 0) ? 0 : (center > 65536) ? 65536 : (int)center;
+        sums->minCode = 0xFFFF;
+        sums->maxCode = 0;
+    }
+}
+
+
+static void LJUSB_StreamStatsAdd(LJUSB_StreamDecoder *decoder, unsigned int channel, unsigned short code)
+{
+    LJUSB_StreamStatsSums *sums = &decoder->statsSums[channel];
+    int d = (int)code - sums->statsCenter;
+    int above = (d >= 0);
+
+    // Without branches on the data, which is noisy around the center
+    sums->minCode = (code < sums->minCode) ? code : sums->minCode;
+    sums->maxCode = (code > sums->maxCode) ? code : sums->maxCode;
+    sums->saturated += (code <= decoder->saturationLow) | (code >= decoder->saturationHigh);
+    sums->count[above]++;
+    sums->sum[above] += d;
+    sums->sumSq[above] += (unsigned long long)((long long)d*d);
+}
+
+
+// Checks the header of one StreamData response.  Returns 0 if the response can
+// be decoded, or -1 and sets errno.
+static int LJUSB_StreamCheckPacket(LJUSB_StreamDecoder *decoder, const BYTE *p)
+{
+    unsigned int n;
+    unsigned short checksumTotal;
+
+    if (decoder->productID == UE9_PRODUCT_ID) {
+        n = UE9_STREAM_PACKET_SIZE;
+    }
+    else {
+        n = decoder->packetSize;
+    }
+
+    checksumTotal = LJUSB_StreamChecksum16(p, n);
+    if (p[4] != (BYTE)(checksumTotal & 0xFF) || p[5] != (BYTE)((checksumTotal >> 8) & 0xFF) ||
+        p[0] != LJUSB_StreamChecksum8(p)) {
+        errno = EBADMSG;
+        return -1;
+    }
+
+    if (p[1] != (BYTE)(0xF9) || p[2] != (BYTE)(n/2 - 3) || p[3] != (BYTE)(0xC0)) {
+        errno = EBADMSG;
+        return -1;
+    }
+
+    decoder->errorcode = p[11];
+    if (decoder->productID == UE9_PRODUCT_ID) {
+        if (p[11] != 0) {
+            errno = EIO;
+            return -1;
+        }
+        decoder->backlog = p[45] & 0x7F;
+        if ((p[45] & 0x80) && !decoder->overflow) {
+            decoder->overflows++;
+        }
+        decoder->overflow = (p[45] & 0x80) ? 1 : 0;
+    }
+    else {
+        //A recovery short enough to end before the next response is only
+        //reported by errorcode 60
+        if ((p[11] == LJUSB_STREAM_ERROR_AUTORECOVERY_ACTIVE || p[11] == LJUSB_STREAM_ERROR_AUTORECOVERY_END) &&
+            !decoder->autoRecoveryOn) {
+            decoder->overflows++;
+        }
+        if (p[11] == LJUSB_STREAM_ERROR_AUTORECOVERY_ACTIVE) {
+            decoder->autoRecoveryOn = 1;
+        }
+        else if (p[11] == LJUSB_STREAM_ERROR_AUTORECOVERY_END) {
+            decoder->autoRecoveryOn = 0;
+            decoder->droppedScans += p[6] + p[7]*256;
+        }
+        else if (p[11] != 0) {
+            errno = EIO;
+            return -1;
+        }
+        decoder->backlog = p[12 + decoder->samplesPerPacket*2];
+    }
+    if (decoder->backlog > decoder->maxBacklog) {
+        decoder->maxBacklog = decoder->backlog;
+    }
+
+    if (p[10] != (BYTE)decoder->packetCounter) {
+        errno = EPROTO;
+        return -1;
+    }
+    decoder->packetCounter = (decoder->packetCounter + 1) & 0xFF;
+    decoder->packets++;
+
+    return 0;
+}
+
+
+int LJUSB_StreamDecoderInit(LJUSB_StreamDecoder *decoder, unsigned long productID, unsigned int numChannels, unsigned int samplesPerPacket, int outputMode)
+{
+    unsigned int i;
+
+    if (decoder == NULL || numChannels == 0 || numChannels > LJUSB_STREAM_MAX_CHANNELS) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (outputMode != LJUSB_STREAM_OUTPUT_RAW16 &&
+        outputMode != LJUSB_STREAM_OUTPUT_FLOAT32 &&
+        outputMode != LJUSB_STREAM_OUTPUT_FLOAT64) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    memset(decoder, 0, sizeof(LJUSB_StreamDecoder));
+
+    switch (productID) {
+    case U3_PRODUCT_ID:
+    case U6_PRODUCT_ID:
+        if (samplesPerPacket == 0 || samplesPerPacket > U3U6_STREAM_MAX_SAMPLES_PER_PACKET) {
+            errno = EINVAL;
+            return -1;
+        }
+        decoder->samplesPerPacket = samplesPerPacket;
+        decoder->packetSize = 14 + samplesPerPacket*2;
+        break;
+    case UE9_PRODUCT_ID:
+        decoder->samplesPerPacket = UE9_STREAM_SAMPLES_PER_PACKET;
+        decoder->packetSize = UE9_STREAM_PACKET_STRIDE;
+        break;
+    default:
+        errno = EINVAL;
+        return -1;
+    }
+
+    decoder->productID = productID;
+    decoder->numChannels = numChannels;
+    decoder->outputMode = outputMode;
+    LJUSB_StreamClockInit(&decoder->clock, 0, LJUSB_STREAM_CLOCK_DEFAULT_FORGETTING);
+
+    for (i = 0; i < LJUSB_STREAM_MAX_CHANNELS; i++) {
+        decoder->cal[i].center = 0;
+        decoder->cal[i].slopeBelow = 1.0;
+        decoder->cal[i].slopeAbove = 1.0;
+        decoder->cal[i].offset = 0;
+    }
+
+    return 0;
+}
+
+
+void LJUSB_StreamDecoderReset(LJUSB_StreamDecoder *decoder)
+{
+    decoder->packetCounter = 0;
+    decoder->currChannel = 0;
+    decoder->scanIndex = 0;
+    decoder->packets = 0;
+    decoder->droppedScans = 0;
+    decoder->backlog = 0;
+    decoder->errorcode = 0;
+    decoder->overflow = 0;
+    decoder->autoRecoveryOn = 0;
+    decoder->maxBacklog = 0;
+    decoder->overflows = 0;
+    decoder->timestampNs = 0;
+    decoder->firstScanIndex = 0;
+    decoder->firstChannel = 0;
+    decoder->numGaps = 0;
+    decoder->totalGaps = 0;
+    LJUSB_StreamClockReset(&decoder->clock);
+}
+
+
+int LJUSB_StreamDecoderSetCal(LJUSB_StreamDecoder *decoder, unsigned int channel, const LJUSB_StreamChannelCal *cal)
+{
+    if (decoder == NULL || cal == NULL || channel >= decoder->numChannels) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    decoder->cal[channel] = *cal;
+    return 0;
+}
+
+
+int LJUSB_StreamDecoderSetGapFill(LJUSB_StreamDecoder *decoder, int gapFill, unsigned short fillCode)
+{
+    if (decoder == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    decoder->gapFill = gapFill ? 1 : 0;
+    decoder->gapFillCode = fillCode;
+    return 0;
+}
+
+
+int LJUSB_StreamDecoderSetStats(LJUSB_StreamDecoder *decoder, int stats, unsigned short saturationLow, unsigned short saturationHigh)
+{
+    if (decoder == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    decoder->stats = stats ? 1 : 0;
+    decoder->saturationLow = saturationLow;
+    decoder->saturationHigh = saturationHigh;
+    if (decoder->stats) {
+        LJUSB_StreamStatsStart(decoder);
+    }
+    return 0;
+}
+
+
+int LJUSB_StreamDecoderGetStats(const LJUSB_StreamDecoder *decoder, LJUSB_StreamChannelStats *stats)
+{
+    const LJUSB_StreamStatsSums *sums;
+    const LJUSB_StreamChannelCal *cal;
+    double frac, slope, sumD, sumD2, sumV, sumV2, a, b;
+    unsigned long long n;
+    unsigned int i;
+    int side;
+
+    if (decoder == NULL || stats == NULL || !decoder->stats) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    for (i = 0; i < decoder->numChannels; i++) {
+        sums = &decoder->statsSums[i];
+        cal = &decoder->cal[i];
+        memset(&stats[i], 0, sizeof(LJUSB_StreamChannelStats));
+        n = sums->count[0] + sums->count[1];
+        if (n == 0) {
+            continue;
+        }
+
+        // The codes were summed as d = code - statsCenter, and volts are
+        // (d - frac)*slope + offset on each side of the center
+        frac = cal->center - sums->statsCenter;
+        sumV = 0;
+        sumV2 = 0;
+        for (side = 0; side < 2; side++) {
+            slope = side ? cal->slopeAbove : cal->slopeBelow;
+            sumD = sums->sum[side] - sums->count[side]*frac;
+            sumD2 = sums->sumSq[side] - 2*frac*sums->sum[side] + sums->count[side]*frac*frac;
+            sumV += slope*sumD + cal->offset*sums->count[side];
+            sumV2 += slope*slope*sumD2 + 2*slope*cal->offset*sumD + cal->offset*cal->offset*sums->count[side];
+        }
+
+        a = LJUSB_StreamConvertCode(cal, sums->minCode);
+        b = LJUSB_StreamConvertCode(cal, sums->maxCode);
+        stats[i].count = n;
+        stats[i].saturated = sums->saturated;
+        stats[i].minCode = sums->minCode;
+        stats[i].maxCode = sums->maxCode;
+        stats[i].min = (a < b) ? a : b;
+        stats[i].max = (a < b) ? b : a;
+        stats[i].mean = sumV/n;
+        stats[i].rms = (sumV2 > 0) ? sqrt(sumV2/n) : 0;
+    }
+
+    return 0;
+}
+
+
+unsigned long LJUSB_StreamReadSize(const LJUSB_StreamDecoder *decoder, unsigned long numPackets)
+{
+    return numPackets*decoder->packetSize;
+}
+
+
+unsigned long LJUSB_StreamMaxScans(const LJUSB_StreamDecoder *decoder, unsigned long count)
+{
+    unsigned long samples;
+
+    samples = (count/decoder->packetSize)*decoder->samplesPerPacket + decoder->currChannel;
+    return samples/decoder->numChannels;
+}
+
+
+unsigned long LJUSB_StreamGapScans(const LJUSB_StreamDecoder *decoder, const BYTE *pBuff, unsigned long count)
+{
+    unsigned long offset, numFill = 0;
+    const BYTE *p;
+
+    if (!decoder->gapFill || decoder->productID == UE9_PRODUCT_ID) {
+        return 0;
+    }
+
+    for (offset = 0; offset + decoder->packetSize <= count; offset += decoder->packetSize) {
+        p = pBuff + offset;
+        if (p[11] == LJUSB_STREAM_ERROR_AUTORECOVERY_END) {
+            numFill += p[6] + p[7]*256;
+        }
+    }
+
+    return numFill;
+}
+
+
+long LJUSB_StreamDecode(LJUSB_StreamDecoder *decoder, const BYTE *pBuff, unsigned long count, void *pOut, unsigned long maxScans)
+{
+    unsigned long offset, numScans = 0, dropped;
+    unsigned long long index;
+    unsigned int i, ch;
+    const BYTE *p;
+
+    if (decoder == NULL || pBuff == NULL || pOut == NULL || count % decoder->packetSize != 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (LJUSB_StreamMaxScans(decoder, count) + LJUSB_StreamGapScans(decoder, pBuff, count) > maxScans) {
+        errno = ENOBUFS;
+        return -1;
+    }
+
+    ch = decoder->currChannel;
+    index = decoder->scanIndex;
+    decoder->firstScanIndex = index;
+    decoder->firstChannel = ch;
+    decoder->timestampNs = 0;
+    decoder->numGaps = 0;
+    if (decoder->stats) {
+        LJUSB_StreamStatsStart(decoder);
+    }
+
+    for (offset = 0; offset < count; offset += decoder->packetSize) {
+        p = pBuff + offset;
+
+        if (LJUSB_StreamCheckPacket(decoder, p) != 0) {
+            decoder->currChannel = ch;
+            decoder->scanIndex = index;
+            return -1;
+        }
+
+        //The scans dropped during auto-recovery come before this response
+        if (decoder->productID != UE9_PRODUCT_ID && decoder->errorcode == LJUSB_STREAM_ERROR_AUTORECOVERY_END) {
+            dropped = p[6] + p[7]*256;
+            if (dropped > 0) {
+                if (decoder->numGaps < LJUSB_STREAM_MAX_GAPS) {
+                    decoder->gaps[decoder->numGaps].scanIndex = index;
+                    decoder->gaps[decoder->numGaps].numScans = dropped;
+                }
+                decoder->numGaps++;
+                decoder->totalGaps++;
+                index += dropped;
+                if (decoder->gapFill) {
+                    LJUSB_StreamEmitFill(decoder, pOut, numScans, dropped);
+                    numScans += dropped;
+                }
+            }
+        }
+
+        p += 12;
+        for (i = 0; i < decoder->samplesPerPacket; i++, p += 2) {
+            decoder->row[ch] = (unsigned short)(p[0] | (p[1] << 8));
+            if (decoder->stats) {
+                LJUSB_StreamStatsAdd(decoder, ch, decoder->row[ch]);
+            }
+            if (++ch >= decoder->numChannels) {
+                LJUSB_StreamEmitScan(decoder, decoder->row, pOut, numScans);
+                numScans++;
+                index++;
+                ch = 0;
+            }
+        }
+    }
+
+    decoder->currChannel = ch;
+    decoder->scanIndex = index;
+
+    return (long)numScans;
+}
+
+
+long LJUSB_StreamDecodeStamped(LJUSB_StreamDecoder *decoder, const BYTE *pBuff, unsigned long count, unsigned long long timestampNs, void *pOut, unsigned long maxScans)
+{
+    unsigned long long lastSample;
+    long numScans;
+
+    if (decoder == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    numScans = LJUSB_StreamDecode(decoder, pBuff, count, pOut, maxScans);
+    decoder->timestampNs = (numScans >= 0) ? timestampNs : 0;
+
+    //The transfer completed after its last sample was read
+    if (numScans >= 0 && timestampNs != 0 && count > 0) {
+        lastSample = decoder->scanIndex*decoder->numChannels + decoder->currChannel - 1;
+        LJUSB_StreamClockUpdate(&decoder->clock, (double)lastSample/decoder->numChannels, timestampNs);
+    }
+
+    return numScans;
+}
+
+
+int LJUSB_StreamClockInit(LJUSB_StreamClock *clock, double nominalScanRate, double forgetting)
+{
+    if (clock == NULL || nominalScanRate < 0 || !(forgetting > 0 && forgetting <= 1)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    clock->forgetting = forgetting;
+    clock->nominalPeriodNs = (nominalScanRate > 0) ? 1.0e9/nominalScanRate : 0;
+    LJUSB_StreamClockReset(clock);
+
+    return 0;
+}
+
+
+void LJUSB_StreamClockReset(LJUSB_StreamClock *clock)
+{
+    clock->originNs = 0;
+    clock->originScan = 0;
+    clock->offsetNs = 0;
+    clock->periodNs = clock->nominalPeriodNs;
+    clock->p[0] = 0;
+    clock->p[1] = 0;
+    clock->p[2] = 0;
+    clock->residualVar = 0;
+    clock->updates = 0;
+    clock->rejected = 0;
+    clock->consecutiveRejected = 0;
+    clock->firstRejectedNs = 0;
+}
+
+
+int LJUSB_StreamClockUpdate(LJUSB_StreamClock *clock, double scan, unsigned long long timestampNs)
+{
+    double d, y, e, den, k0, k1, p00, p01, p11, w;
+    long long shift;
+
+    if (clock == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (clock->updates == 0) {
+        clock->originNs = timestampNs;
+        clock->originScan = scan;
+        clock->offsetNs = 0;
+        clock->p[0] = STREAM_CLOCK_INITIAL_P;
+        clock->p[1] = 0;
+        clock->p[2] = STREAM_CLOCK_INITIAL_P;
+        clock->updates = 1;
+        return 1;
+    }
+
+    d = scan - clock->originScan;
+    if (!(d > 0)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    //Moves the origin of the fit to this scan:  the offset becomes the
+    //prediction and the covariance is transformed to match.
+    y = (double)(long long)(timestampNs - clock->originNs);
+    e = y - (clock->offsetNs + clock->periodNs*d);
+    p00 = clock->p[0] + 2*d*clock->p[1] + d*d*clock->p[2];
+    p01 = clock->p[1] + d*clock->p[2];
+    p11 = clock->p[2];
+    den = clock->forgetting + p00;
+
+    if (clock->updates >= STREAM_CLOCK_SETTLE_UPDATES && clock->residualVar > 0 &&
+        e*e*clock->forgetting/den > STREAM_CLOCK_REJECT_SIGMA*STREAM_CLOCK_REJECT_SIGMA*clock->residualVar) {
+        clock->rejected++;
+        if (clock->consecutiveRejected++ == 0) {
+            clock->firstRejectedNs = timestampNs;
+        }
+
+        //A stalled reader catches up within a second, so rejects lasting
+        //longer mean the clocks stepped:  starts over from this pair
+        if (clock->consecutiveRejected >= STREAM_CLOCK_MAX_REJECTED &&
+            (double)(long long)(timestampNs - clock->firstRejectedNs) >= STREAM_CLOCK_RESTART_NS) {
+            LJUSB_StreamClockReset(clock);
+            LJUSB_StreamClockUpdate(clock, scan, timestampNs);
+        }
+        return 0;
+    }
+
+    k0 = p00/den;
+    k1 = p01/den;
+    clock->offsetNs += clock->periodNs*d + k0*e;
+    clock->periodNs += k1*e;
+    clock->originScan = scan;
+    clock->p[0] = (p00 - k0*p00)/clock->forgetting;
+    clock->p[1] = (p01 - k0*p01)/clock->forgetting;
+    clock->p[2] = (p11 - k1*p01)/clock->forgetting;
+
+    //The first residual only sets the period
+    if (clock->updates >= 2) {
+        w = 1.0/(clock->updates - 1);
+        if (w < 1 - clock->forgetting) {
+            w = 1 - clock->forgetting;
+        }
+        clock->residualVar += w*(e*e*clock->forgetting/den - clock->residualVar);
+    }
+
+    //Keeps the offset small
+    shift = (long long)clock->offsetNs;
+    clock->originNs += shift;
+    clock->offsetNs -= (double)shift;
+
+    clock->updates++;
+    clock->consecutiveRejected = 0;
+
+    return 1;
+}
+
+
+unsigned long long LJUSB_StreamClockScanTime(const LJUSB_StreamClock *clock, double scan, double *pErrorNs)
+{
+    double d, var;
+
+    if (pErrorNs != NULL) {
+        *pErrorNs = 0;
+    }
+    if (clock == NULL || clock->updates < 2) {
+        return 0;
+    }
+
+    d = scan - clock->originScan;
+    if (pErrorNs != NULL) {
+        var = clock->residualVar*(clock->p[0] + 2*d*clock->p[1] + d*d*clock->p[2]);
+        *pErrorNs = (var > 0) ? 3*sqrt(var) : 0;
+    }
+
+    return clock->originNs + (long long)llround(clock->offsetNs + clock->periodNs*d);
+}
+
+
+double LJUSB_StreamClockScanRate(const LJUSB_StreamClock *clock)
+{
+    if (clock->updates >= 2 && clock->periodNs > 0) {
+        return 1.0e9/clock->periodNs;
+    }
+    if (clock->nominalPeriodNs > 0) {
+        return 1.0e9/clock->nominalPeriodNs;
+    }
+    return 0;
+}
+
+
+int LJUSB_StreamPlanCompute(unsigned long productID, unsigned int numChannels, double scanRate, int resolution, double latencyBudgetUs, LJUSB_StreamPlan *plan)
+{
+    const LJUSB_StreamPlanClock *clocks;
+    unsigned int numClocks, i, minSamples;
+    double interval, err, bestErr = -1, fillUs, usableSamples;
+    unsigned long packets;
+    BYTE resolutionBits = 0;
+
+    if (plan == NULL || numChannels == 0 || numChannels > LJUSB_STREAM_MAX_CHANNELS ||
+        !(scanRate > 0) || latencyBudgetUs < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    memset(plan, 0, sizeof(LJUSB_StreamPlan));
+
+    switch (productID) {
+    case U3_PRODUCT_ID:
+        if (resolution < 0 || resolution > 3) {
+            errno = EINVAL;
+            return -1;
+        }
+        clocks = U3U6_STREAM_CLOCKS;
+        numClocks = 4;
+        plan->maxSampleRate = U3_STREAM_MAX_RATE[resolution];
+        resolutionBits = (BYTE)resolution;
+        break;
+    case U6_PRODUCT_ID:
+        if (resolution < 0 || resolution > 8) {
+            errno = EINVAL;
+            return -1;
+        }
+        clocks = U3U6_STREAM_CLOCKS;
+        numClocks = 4;
+        plan->maxSampleRate = U6_STREAM_MAX_RATE[resolution];
+        break;
+    case UE9_PRODUCT_ID:
+        if (resolution < 12 || resolution > 16) {
+            errno = EINVAL;
+            return -1;
+        }
+        clocks = UE9_STREAM_CLOCKS;
+        numClocks = 8;
+        plan->maxSampleRate = UE9_STREAM_MAX_RATE[resolution - 12];
+        break;
+    default:
+        errno = EINVAL;
+        return -1;
+    }
+
+    //The U3 and U6 use ScanConfig bit 2 and bit 1 for divide by 256
+    for (i = 0; i < numClocks; i++) {
+        interval = floor(clocks[i].hz/scanRate + 0.5);
+        if (interval < 1 || interval > 65535) {
+            continue;
+        }
+        err = fabs(clocks[i].hz/interval - scanRate);
+        if (bestErr < 0 || err < bestErr) {
+            bestErr = err;
+            plan->scanConfig = clocks[i].scanConfig;
+            if (productID != UE9_PRODUCT_ID && i >= 2) {
+                plan->scanConfig |= (productID == U3_PRODUCT_ID) ? 0x04 : 0x02;
+            }
+            plan->scanInterval = (unsigned short)interval;
+            plan->scanRate = clocks[i].hz/interval;
+        }
+    }
+    if (bestErr < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    plan->scanConfig |= resolutionBits;
+
+    plan->sampleRate = plan->scanRate*numChannels;
+    if (plan->sampleRate > plan->maxSampleRate) {
+        errno = ERANGE;
+        return -1;
+    }
+
+    //Samples a read can collect within the budget
+    if (latencyBudgetUs > 0) {
+        fillUs = latencyBudgetUs - STREAM_PLAN_USB_LATENCY_US;
+    }
+    else {
+        fillUs = STREAM_PLAN_NO_BUDGET_FILL_US;
+    }
+    usableSamples = (fillUs > 0) ? fillUs*plan->sampleRate/1.0e6 : 0;
+
+    if (productID == UE9_PRODUCT_ID) {
+        //Read in groups of 4 responses
+        plan->samplesPerPacket = UE9_STREAM_SAMPLES_PER_PACKET;
+        plan->packetSize = UE9_STREAM_PACKET_STRIDE;
+        packets = (unsigned long)(usableSamples/(4*UE9_STREAM_SAMPLES_PER_PACKET))*4;
+        if (packets < 4) {
+            packets = 4;
+        }
+    }
+    else if (usableSamples >= U3U6_STREAM_MAX_SAMPLES_PER_PACKET) {
+        //Full responses can be read several at a time
+        plan->samplesPerPacket = U3U6_STREAM_MAX_SAMPLES_PER_PACKET;
+        packets = (unsigned long)(usableSamples/U3U6_STREAM_MAX_SAMPLES_PER_PACKET);
+    }
+    else {
+        //A short response ends a transfer, so each read returns one response
+        //and the read rate limits how small the responses can be
+        plan->samplesPerPacket = (unsigned int)usableSamples;
+        if (plan->samplesPerPacket >= numChannels) {
+            plan->samplesPerPacket -= plan->samplesPerPacket % numChannels;
+        }
+        minSamples = (unsigned int)ceil(plan->sampleRate/STREAM_PLAN_MAX_SHORT_READS);
+        if (plan->samplesPerPacket < minSamples) {
+            plan->samplesPerPacket = minSamples;
+        }
+        if (plan->samplesPerPacket < 1) {
+            plan->samplesPerPacket = 1;
+        }
+        if (plan->samplesPerPacket > U3U6_STREAM_MAX_SAMPLES_PER_PACKET) {
+            plan->samplesPerPacket = U3U6_STREAM_MAX_SAMPLES_PER_PACKET;
+        }
+        packets = 1;
+    }
+    if (productID != UE9_PRODUCT_ID) {
+        plan->packetSize = 14 + plan->samplesPerPacket*2;
+    }
+    if (packets > STREAM_PLAN_MAX_READ_PACKETS) {
+        packets = STREAM_PLAN_MAX_READ_PACKETS;
+    }
+
+    plan->packetsPerRead = packets;
+    plan->readSize = packets*plan->packetSize;
+    plan->readRate = plan->sampleRate/(packets*plan->samplesPerPacket);
+    plan->latencyUs = packets*plan->samplesPerPacket/plan->sampleRate*1.0e6 + STREAM_PLAN_USB_LATENCY_US;
+    plan->meetsLatency = (latencyBudgetUs == 0 || plan->latencyUs <= latencyBudgetUs) ? 1 : 0;
+
+    //Twice the transfers needed to cover the resubmit time
+    plan->numTransfers = (unsigned int)ceil(2*plan->readRate*STREAM_PLAN_TURNAROUND_US/1.0e6);
+    if (plan->numTransfers < 1) {
+        plan->numTransfers = 1;
+    }
+    if (plan->numTransfers > LJUSB_STREAM_PLAN_MAX_TRANSFERS) {
+        plan->numTransfers = LJUSB_STREAM_PLAN_MAX_TRANSFERS;
+    }
+
+    return 0;
+}
+
+
+double LJUSB_StreamSampleAgeUs(const LJUSB_StreamDecoder *decoder, unsigned long long startNs, unsigned long long nowNs)
+{
+    const LJUSB_StreamClock *clock;
+    unsigned long long scan;
+    double rate, sampleNs;
+
+    if (decoder == NULL || (decoder->scanIndex == 0 && decoder->currChannel == 0)) {
+        return -1;
+    }
+
+    //The newest sample is in the scan being filled, or else the last scan
+    scan = (decoder->currChannel > 0) ? decoder->scanIndex : decoder->scanIndex - 1;
+    //The measured rate is noisy until the fit spans many transfers:  it is
+    //used once its 3 sigma error is below STREAM_AGE_MAX_FIT_ERROR
+    clock = &decoder->clock;
+    rate = LJUSB_StreamClockScanRate(clock);
+    if (clock->nominalPeriodNs > 0 &&
+        (clock->updates < STREAM_CLOCK_SETTLE_UPDATES ||
+         3*sqrt(clock->p[2]*clock->residualVar) > STREAM_AGE_MAX_FIT_ERROR*clock->periodNs ||
+         fabs(rate*clock->nominalPeriodNs/1.0e9 - 1) > STREAM_AGE_MAX_RATE_ERROR)) {
+        rate = 1.0e9/clock->nominalPeriodNs;
+    }
+    if (!(rate > 0)) {
+        return -1;
+    }
+
+    sampleNs = (scan + 1)*1.0e9/rate;
+    return ((double)(long long)(nowNs - startNs) - sampleNs)/1.0e3;
+}
+
+
+// Returns the histogram bucket of an age:  1 us buckets below
+// 2*LJUSB_STREAM_AGE_SUB_BUCKETS us, then LJUSB_STREAM_AGE_SUB_BUCKETS
+// buckets per power of two.
+static unsigned int LJUSB_StreamAgeBucket(double ageUs)
+{
+    unsigned long long v;
+    unsigned int shift = 0, bucket;
+
+    if (!(ageUs > 0)) {
+        return 0;
+    }
+    if (ageUs >= 9.0e18) {
+        return LJUSB_STREAM_AGE_BUCKETS - 1;
+    }
+
+    v = (unsigned long long)ageUs;
+    while (v >= 2*LJUSB_STREAM_AGE_SUB_BUCKETS) {
+        v >>= 1;
+        shift++;
+    }
+    bucket = shift*LJUSB_STREAM_AGE_SUB_BUCKETS + (unsigned int)v;
+    if (bucket >= LJUSB_STREAM_AGE_BUCKETS) {
+        bucket = LJUSB_STREAM_AGE_BUCKETS - 1;
+    }
+    return bucket;
+}
+
+
+// Returns the middle of a histogram bucket in microseconds
+static double LJUSB_StreamAgeBucketMiddle(unsigned int bucket)
+{
+    unsigned int shift, v;
+
+    if (bucket < 2*LJUSB_STREAM_AGE_SUB_BUCKETS) {
+        return bucket + 0.5;
+    }
+    shift = bucket/LJUSB_STREAM_AGE_SUB_BUCKETS - 1;
+    v = bucket % LJUSB_STREAM_AGE_SUB_BUCKETS + LJUSB_STREAM_AGE_SUB_BUCKETS;
+    return ldexp(v + 0.5, (int)shift);
+}
+
+
+void LJUSB_StreamAgeStatsReset(LJUSB_StreamAgeStats *stats)
+{
+    if (stats != NULL) {
+        memset(stats, 0, sizeof(LJUSB_StreamAgeStats));
+    }
+}
+
+
+void LJUSB_StreamAgeStatsAdd(LJUSB_StreamAgeStats *stats, double ageUs)
+{
+    if (stats == NULL) {
+        return;
+    }
+
+    if (!(ageUs > 0)) {
+        ageUs = 0;
+    }
+    if (stats->count == 0 || ageUs < stats->minUs) {
+        stats->minUs = ageUs;
+    }
+    if (stats->count == 0 || ageUs > stats->maxUs) {
+        stats->maxUs = ageUs;
+    }
+    stats->sumUs += ageUs;
+    stats->count++;
+    stats->buckets[LJUSB_StreamAgeBucket(ageUs)]++;
+}
+
+
+double LJUSB_StreamAgeStatsPercentile(const LJUSB_StreamAgeStats *stats, double percent)
+{
+    unsigned long long rank, seen = 0;
+    unsigned int i;
+    double age;
+
+    if (stats == NULL || stats->count == 0) {
+        return 0;
+    }
+    if (percent <= 0) {
+        return stats->minUs;
+    }
+    if (percent >= 100) {
+        return stats->maxUs;
+    }
+
+    //The age with rank ceil(percent% of count), counting from 1
+    rank = (unsigned long long)ceil(percent/100.0*stats->count);
+    if (rank < 1) {
+        rank = 1;
+    }
+    for (i = 0; i < LJUSB_STREAM_AGE_BUCKETS; i++) {
+        seen += stats->buckets[i];
+        if (seen >= rank) {
+            break;
+        }
+    }
+
+    age = LJUSB_StreamAgeBucketMiddle(i);
+    if (age < stats->minUs) {
+        age = stats->minUs;
+    }
+    if (age > stats->maxUs) {
+        age = stats->maxUs;
+    }
+    return age;
+}
+
+
+int LJUSB_StreamConvert(const LJUSB_StreamChannelCal *cal, unsigned int numChannels, const unsigned short *pRaw, unsigned long numScans, void *pOut, int outputMode)
+{
+    unsigned long i;
+    unsigned int ch;
+    float *f = (float *)pOut;
+    double *d = (double *)pOut;
+
+    if (cal == NULL || pRaw == NULL || pOut == NULL || numChannels == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (outputMode == LJUSB_STREAM_OUTPUT_FLOAT32) {
+        for (i = 0; i < numScans; i++) {
+            for (ch = 0; ch < numChannels; ch++, pRaw++) {
+                *f++ = (float)LJUSB_StreamConvertCode(&cal[ch], *pRaw);
+            }
+        }
+    }
+    else if (outputMode == LJUSB_STREAM_OUTPUT_FLOAT64) {
+        for (i = 0; i < numScans; i++) {
+            for (ch = 0; ch < numChannels; ch++, pRaw++) {
+                *d++ = LJUSB_StreamConvertCode(&cal[ch], *pRaw);
+            }
+        }
+    }
+    else {
+        errno = EINVAL;
+        return -1;
+    }
+
+    return 0;
+}
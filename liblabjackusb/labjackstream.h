@@ -0,0 +1,479 @@
+//-----------------------------------------------------------------------------
+//
+//  labjackstream.h
+//
+//  Header file for the stream decoding functions of the labjackusb library.
+//  Decodes the StreamData responses of U3, U6 and UE9 devices read with
+//  LJUSB_Stream into scans of raw binary codes or calibrated volts.
+//
+//  support@labjack.com
+//
+//  SPDX-FileCopyrightText: Copyright (c) 2009 LabJack Corporation
+//  SPDX-License-Identifier: X11
+//
+//-----------------------------------------------------------------------------
+//
+
+#ifndef LABJACKSTREAM_H_
+#define LABJACKSTREAM_H_
+
+#include "labjackusb.h"
+
+//Maximum number of channels in a stream scan
+#define LJUSB_STREAM_MAX_CHANNELS     128
+
+//Stream decoder output modes
+#define LJUSB_STREAM_OUTPUT_RAW16     0  //Raw 16-bit binary codes (unsigned short)
+#define LJUSB_STREAM_OUTPUT_FLOAT32   1  //Calibrated volts (float)
+#define LJUSB_STREAM_OUTPUT_FLOAT64   2  //Calibrated volts (double)
+
+//StreamData errorcodes handled by the decoder
+#define LJUSB_STREAM_ERROR_AUTORECOVERY_ACTIVE   59
+#define LJUSB_STREAM_ERROR_AUTORECOVERY_END      60
+
+//Maximum number of gaps recorded by one LJUSB_StreamDecode call
+#define LJUSB_STREAM_MAX_GAPS                    16
+
+//Maximum number of transfers LJUSB_StreamPlanCompute plans to keep in flight
+#define LJUSB_STREAM_PLAN_MAX_TRANSFERS          16
+
+//Sample age histogram of LJUSB_StreamAgeStats: LJUSB_STREAM_AGE_SUB_BUCKETS
+//buckets per power of two (about 3% resolution), for ages up to about 16 s
+#define LJUSB_STREAM_AGE_SUB_BUCKETS             32
+#define LJUSB_STREAM_AGE_BUCKETS                 640
+
+//Default forgetting factor of the stream clock estimator.  Each stamped buffer
+//is weighted 1/1000 less than the next one.
+#define LJUSB_STREAM_CLOCK_DEFAULT_FORGETTING    0.999
+
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+
+//Binary to volts conversion of one stream channel.  A code below center is
+//converted with (code - center)*slopeBelow + offset, and a code at or above
+//center with (code - center)*slopeAbove + offset.  A linear conversion
+//(slope*code + offset) has center = 0 and both slopes equal.  The device
+//helper functions (getStreamCalibration in u3.c, u6.c and ue9.c) fill this in
+//from the device's calibration constants.
+typedef struct LJUSB_StreamChannelCal
+{
+    double center;
+    double slopeBelow;
+    double slopeAbove;
+    double offset;
+} LJUSB_StreamChannelCal;
+
+//Scans dropped by a U3/U6 during stream auto-recovery.  The scans at stream
+//indexes scanIndex to scanIndex+numScans-1 were not sampled or not sent.
+typedef struct LJUSB_StreamGap
+{
+    unsigned long long scanIndex;   //Stream index of the first dropped scan
+    unsigned long long numScans;    //Number of scans dropped
+} LJUSB_StreamGap;
+
+//Online estimate of the line host time = offset + period*scan, fitted by
+//recursive least squares with exponential forgetting to (scan, host timestamp)
+//pairs of stamped stream buffers.  The device scan clock drifts relative to the
+//host clock, and the forgetting factor lets the fit follow the drift.  The
+//fit is kept relative to the last pair so it stays well conditioned in long
+//captures.  Set up with LJUSB_StreamClockInit and do not modify the fields
+//directly, except for reading them.
+typedef struct LJUSB_StreamClock
+{
+    double forgetting;              //Forgetting factor (0 to 1)
+    double nominalPeriodNs;         //Scan period set by the StreamConfig, or 0
+
+    unsigned long long originNs;    //Host time the fit is relative to
+    double originScan;              //Scan the fit is relative to
+    double offsetNs;                //Fitted host time of originScan - originNs
+    double periodNs;                //Fitted scan period in host nanoseconds
+    double p[3];                    //Scaled covariance of offset and period
+                                    //(p00, p01, p11)
+    double residualVar;             //Weighted variance of the residuals (ns^2)
+    unsigned long long updates;     //Pairs used in the fit
+    unsigned long long rejected;    //Pairs rejected as outliers
+    unsigned int consecutiveRejected;
+    unsigned long long firstRejectedNs; //Host time of the first of them
+} LJUSB_StreamClock;
+
+//Sums of the codes of one channel in the block being decoded, kept for
+//LJUSB_StreamDecoderGetStats.  The codes below and at or above the center of
+//the channel conversion are summed apart, as code - statsCenter, so that the
+//volts statistics are exact for both slopes.
+typedef struct LJUSB_StreamStatsSums
+{
+    int statsCenter;                //Smallest code at or above the center
+    unsigned short minCode;
+    unsigned short maxCode;
+    unsigned long long saturated;
+    unsigned long long count[2];    //Below and at or above the center
+    long long sum[2];
+    unsigned long long sumSq[2];
+} LJUSB_StreamStatsSums;
+
+//Statistics of one channel in a block of StreamData responses, from
+//LJUSB_StreamDecoderGetStats
+typedef struct LJUSB_StreamChannelStats
+{
+    unsigned long long count;       //Samples in the block
+    unsigned long long saturated;   //Samples at or beyond the saturation codes
+    unsigned short minCode;
+    unsigned short maxCode;
+    double min;                     //Volts (codes with the default conversion)
+    double max;
+    double mean;
+    double rms;
+} LJUSB_StreamChannelStats;
+
+//Stream decoder state.  Set up with LJUSB_StreamDecoderInit and do not modify
+//the fields directly, except for reading them.
+typedef struct LJUSB_StreamDecoder
+{
+    unsigned long productID;        //U3_PRODUCT_ID, U6_PRODUCT_ID or UE9_PRODUCT_ID
+    unsigned int numChannels;       //Channels per scan
+    unsigned int samplesPerPacket;  //Samples in each StreamData response
+    unsigned int packetSize;        //Bytes in each StreamData response read
+    int outputMode;                 //LJUSB_STREAM_OUTPUT_*
+    LJUSB_StreamChannelCal cal[LJUSB_STREAM_MAX_CHANNELS];
+
+    unsigned int packetCounter;     //Expected PacketCounter of the next response
+    unsigned int currChannel;       //Channel of the next sample
+    unsigned short row[LJUSB_STREAM_MAX_CHANNELS];  //Codes of the current scan
+
+    unsigned long long scanIndex;   //Stream index of the next scan: complete
+                                    //scans decoded plus scans dropped in gaps
+    unsigned long long packets;     //Number of StreamData responses decoded
+    unsigned long long droppedScans;  //Scans dropped by the device, from U3/U6
+                                      //auto-recovery reports (errorcode 60)
+    int backlog;                    //Backlog of the last response
+    int errorcode;                  //Errorcode of the last response
+    int autoRecoveryOn;             //1 if a U3/U6 buffer overflow is being recovered
+    int overflow;                   //1 if the last UE9 response reported a Comm
+                                    //buffer overflow
+    int maxBacklog;                 //Largest backlog since the decoder was reset
+    unsigned long long overflows;   //Buffer overflows since the decoder was
+                                    //reset:  U3/U6 auto-recoveries and UE9
+                                    //runs of responses with the overflow bit
+
+    int gapFill;                    //1 to store fill scans for dropped scans
+    unsigned short gapFillCode;     //Raw code of fill scans (volts are NaN)
+    unsigned int numGaps;           //Gaps found by the last decode call
+    LJUSB_StreamGap gaps[LJUSB_STREAM_MAX_GAPS];  //The first LJUSB_STREAM_MAX_GAPS
+                                                  //of them
+    unsigned long long totalGaps;   //Gaps found since the decoder was reset
+
+    unsigned long long timestampNs;     //Host completion time of the last buffer
+                                        //decoded with LJUSB_StreamDecodeStamped,
+                                        //or 0
+    unsigned long long firstScanIndex;  //Scan of the first sample of the last
+                                        //buffer decoded
+    unsigned int firstChannel;          //Channel of the first sample of the last
+                                        //buffer decoded
+
+    LJUSB_StreamClock clock;            //Device to host clock estimate, updated
+                                        //by LJUSB_StreamDecodeStamped
+
+    int stats;                          //1 to sum the codes of each block
+    unsigned short saturationLow;       //Codes counted as saturated: at or
+    unsigned short saturationHigh;      //below low, or at or above high
+    LJUSB_StreamStatsSums statsSums[LJUSB_STREAM_MAX_CHANNELS];
+} LJUSB_StreamDecoder;
+
+//Stream settings planned by LJUSB_StreamPlanCompute
+typedef struct LJUSB_StreamPlan
+{
+    BYTE scanConfig;                //ScanConfig byte of the StreamConfig: clock
+                                    //and divide by 256 bits (and the U3
+                                    //resolution bits)
+    unsigned short scanInterval;    //ScanInterval of the StreamConfig
+    unsigned int samplesPerPacket;  //SamplesPerPacket of the StreamConfig (16
+                                    //for the UE9)
+    unsigned int packetSize;        //Bytes read for each StreamData response
+    unsigned long packetsPerRead;   //StreamData responses in each read
+    unsigned long readSize;         //Bytes in each read (LJUSB_Stream count)
+    unsigned int numTransfers;      //Reads to keep in flight
+
+    double scanRate;                //Scan rate of scanConfig and scanInterval
+    double sampleRate;              //scanRate*numChannels
+    double maxSampleRate;           //Approximate maximum sample rate of the
+                                    //device at the resolution
+    double readRate;                //Reads per second
+    double latencyUs;               //Expected age of the first sample of a
+                                    //read when the read completes
+    int meetsLatency;               //1 if latencyUs is within the budget
+} LJUSB_StreamPlan;
+
+//Distribution of sample ages, in microseconds, for latency percentiles.  Set
+//up with LJUSB_StreamAgeStatsReset.
+typedef struct LJUSB_StreamAgeStats
+{
+    unsigned long long count;       //Ages added
+    double minUs;
+    double maxUs;
+    double sumUs;
+    unsigned long long buckets[LJUSB_STREAM_AGE_BUCKETS];
+} LJUSB_StreamAgeStats;
+
+
+int LJUSB_StreamDecoderInit(LJUSB_StreamDecoder *decoder, unsigned long productID, unsigned int numChannels, unsigned int samplesPerPacket, int outputMode);
+// Sets up a stream decoder for a stream configured with StreamConfig.  The
+// channel conversions are set so that volts equal the binary codes; use
+// LJUSB_StreamDecoderSetCal to set calibrated conversions.  The clock
+// estimator is set up with an unknown scan rate and the default forgetting
+// factor; call LJUSB_StreamClockInit on decoder->clock to change them.
+// Returns 0 on success, or -1 on error and errno is set.
+// decoder = The decoder to set up.
+// productID = U3_PRODUCT_ID, U6_PRODUCT_ID or UE9_PRODUCT_ID.
+// numChannels = NumChannels of the StreamConfig.
+// samplesPerPacket = SamplesPerPacket of the StreamConfig (U3/U6, 1-25).  The
+//                    UE9 always uses 16 and this value is ignored.
+// outputMode = The output of LJUSB_StreamDecode: LJUSB_STREAM_OUTPUT_RAW16,
+//              LJUSB_STREAM_OUTPUT_FLOAT32 or LJUSB_STREAM_OUTPUT_FLOAT64.
+
+void LJUSB_StreamDecoderReset(LJUSB_StreamDecoder *decoder);
+// Resets the packet counter, scan index, partial scan, gaps and clock estimate
+// of a decoder, for when a stream is restarted.  The configuration,
+// conversions, gap fill and clock estimator settings are kept.
+// decoder = The decoder to reset.
+
+int LJUSB_StreamDecoderSetCal(LJUSB_StreamDecoder *decoder, unsigned int channel, const LJUSB_StreamChannelCal *cal);
+// Sets the binary to volts conversion of a channel.  Returns 0 on success, or
+// -1 on error and errno is set.
+// decoder = The decoder.
+// channel = The index of the channel in the scan (0 to numChannels-1).
+// cal = The conversion.
+
+int LJUSB_StreamDecoderSetGapFill(LJUSB_StreamDecoder *decoder, int gapFill, unsigned short fillCode);
+// Sets whether LJUSB_StreamDecode stores fill scans in place of the scans
+// dropped during U3/U6 auto-recovery, so that the n-th scan in the output is
+// always stream scan n.  Gaps are recorded in decoder->gaps either way.  By
+// default gaps are not filled.  Returns 0 on success, or -1 on error and errno
+// is set.
+// decoder = The decoder.
+// gapFill = 1 to store fill scans, 0 to skip the dropped scans.
+// fillCode = The code of fill scans in LJUSB_STREAM_OUTPUT_RAW16 mode, for
+//            example 0xFFFF.  Fill scans are NaN in the volts modes.
+
+int LJUSB_StreamDecoderSetStats(LJUSB_StreamDecoder *decoder, int stats, unsigned short saturationLow, unsigned short saturationHigh);
+// Sets whether LJUSB_StreamDecode computes the statistics of each channel in
+// each block it decodes, in the same pass that decodes the samples, so that
+// they need not be computed again from the output.  Only the minimum,
+// maximum, sums and saturation counts of the codes are kept per sample; the
+// volts statistics are computed from them by LJUSB_StreamDecoderGetStats.  By
+// default statistics are off.  Returns 0 on success, or -1 on error and errno
+// is set.
+// decoder = The decoder.
+// stats = 1 to compute the statistics, 0 not to.
+// saturationLow = Codes at or below it are counted as saturated, for example
+//                 0.
+// saturationHigh = Codes at or above it are counted as saturated, for
+//                  example 65535.
+
+int LJUSB_StreamDecoderGetStats(const LJUSB_StreamDecoder *decoder, LJUSB_StreamChannelStats *stats);
+// Returns the statistics of each channel in the samples of the last
+// LJUSB_StreamDecode call, including the samples of a scan that is completed
+// by the next call and not including fill scans.  After a decode error, they
+// are of the responses before the bad one.  The volts are computed with the
+// channel conversions.  Returns 0 on success, or -1 on error and errno is
+// set.
+// decoder = The decoder, with statistics on (LJUSB_StreamDecoderSetStats).
+// stats = Returns the statistics of the numChannels channels.  A channel
+//         with no samples has a count of 0 and the other values are 0.
+
+unsigned long LJUSB_StreamReadSize(const LJUSB_StreamDecoder *decoder, unsigned long numPackets);
+// Returns the number of bytes to pass to LJUSB_Stream to read numPackets
+// StreamData responses.  The UE9 is read in groups of 4 responses, so
+// numPackets should be a multiple of 4 for the UE9.
+// decoder = The decoder.
+// numPackets = The number of StreamData responses.
+
+unsigned long LJUSB_StreamMaxScans(const LJUSB_StreamDecoder *decoder, unsigned long count);
+// Returns the maximum number of complete scans LJUSB_StreamDecode can return
+// for count bytes of StreamData responses.  Use it to size the output buffer.
+// With gap fill on, the fill scans are not included; see
+// LJUSB_StreamGapScans.
+// decoder = The decoder.
+// count = The number of bytes that will be decoded.
+
+unsigned long LJUSB_StreamGapScans(const LJUSB_StreamDecoder *decoder, const BYTE *pBuff, unsigned long count);
+// Returns the number of fill scans LJUSB_StreamDecode would store for count
+// bytes of StreamData responses, from the auto-recovery reports in them.
+// Returns 0 when gap fill is off.  Each report can drop up to 65535 scans.
+// decoder = The decoder.
+// pBuff = The StreamData responses.
+// count = The number of bytes in pBuff.
+
+long LJUSB_StreamDecode(LJUSB_StreamDecoder *decoder, const BYTE *pBuff, unsigned long count, void *pOut, unsigned long maxScans);
+// Checks and decodes StreamData responses read with LJUSB_Stream.  Complete
+// scans are stored in pOut, channel-interleaved, as unsigned shorts, floats
+// or doubles depending on the output mode.  A scan that is split across
+// calls is completed on the next call.  StreamData errorcodes 59 and 60
+// (U3/U6 auto-recovery) are tracked in autoRecoveryOn and are not errors.
+// Each errorcode 60 response reports the scans dropped since the overflow;
+// they are recorded as a gap before the samples of that response, the scan
+// index skips over them, and with gap fill on fill scans are stored in their
+// place.  The device drops whole scans, so a gap starts on a scan boundary.
+// Returns the number of scans stored in pOut, or -1 on error and errno is set:
+//   EINVAL - count is not a multiple of the response size
+//   ENOBUFS - maxScans is too small (see LJUSB_StreamMaxScans and
+//             LJUSB_StreamGapScans)
+//   EBADMSG - a response has a bad checksum or bad command bytes
+//   EPROTO - a response has an unexpected PacketCounter
+//   EIO - a response has a non-zero errorcode (see decoder->errorcode)
+// On error, the scans and gaps of the responses before the bad one are stored
+// in pOut and decoder->gaps and are counted in decoder->scanIndex.
+// decoder = The decoder.
+// pBuff = The StreamData responses.
+// count = The number of bytes in pBuff.
+// pOut = The buffer for the scans, maxScans*numChannels elements in size.
+// maxScans = The number of scans pOut can hold.
+
+long LJUSB_StreamDecodeStamped(LJUSB_StreamDecoder *decoder, const BYTE *pBuff, unsigned long count, unsigned long long timestampNs, void *pOut, unsigned long maxScans);
+// Same as LJUSB_StreamDecode, and also stores the host time of the buffer in
+// decoder->timestampNs next to decoder->firstScanIndex and
+// decoder->firstChannel, the scan and channel of the first sample in the
+// buffer.  The first sample may belong to a scan that was started in the
+// previous buffer; its sample number in the stream is
+// firstScanIndex*numChannels + firstChannel.  The time is when the transfer
+// completed, so it is closest to the last sample in the buffer, and that
+// (scan, time) pair updates decoder->clock.  Returns the same values as
+// LJUSB_StreamDecode.  On error, decoder->timestampNs is 0 and the clock is
+// not updated.
+// decoder = The decoder.
+// pBuff = The StreamData responses.
+// count = The number of bytes in pBuff.
+// timestampNs = The host time of the transfer, from LJUSB_StreamStampedTO.
+// pOut = The buffer for the scans, maxScans*numChannels elements in size.
+// maxScans = The number of scans pOut can hold.
+
+int LJUSB_StreamClockInit(LJUSB_StreamClock *clock, double nominalScanRate, double forgetting);
+// Sets up a clock estimator and discards its estimate.  Returns 0 on success,
+// or -1 on error and errno is set.
+// clock = The estimator, for example &decoder->clock.
+// nominalScanRate = The scan rate set by the StreamConfig in scans per second,
+//                   used as the starting estimate, or 0 if unknown.
+// forgetting = The forgetting factor, greater than 0 and at most 1.  Smaller
+//              values follow drift faster but average less USB latency
+//              jitter.  1 keeps all pairs.  Use
+//              LJUSB_STREAM_CLOCK_DEFAULT_FORGETTING if unsure.
+
+void LJUSB_StreamClockReset(LJUSB_StreamClock *clock);
+// Discards the estimate of a clock estimator, keeping its settings.
+// clock = The estimator.
+
+int LJUSB_StreamClockUpdate(LJUSB_StreamClock *clock, double scan, unsigned long long timestampNs);
+// Adds a (scan, host time) pair to the estimate.  LJUSB_StreamDecodeStamped
+// calls it for each buffer.  Pairs far above the fit, such as transfers that
+// completed late because the reading thread was not scheduled, are rejected
+// once the fit has settled; a run of rejected pairs lasting over a second
+// restarts the estimate.
+// Returns 1 if the pair was used, 0 if it was rejected, or -1 on error and
+// errno is set.
+// clock = The estimator.
+// scan = The scan of the pair; may be fractional.  Must increase.
+// timestampNs = The host time of the pair in nanoseconds.
+
+unsigned long long LJUSB_StreamClockScanTime(const LJUSB_StreamClock *clock, double scan, double *pErrorNs);
+// Returns the host time in nanoseconds of a scan interpolated (or
+// extrapolated) from the estimate, on the clock of the timestamps.  The times
+// are those of the stamped transfers, so they include the fixed part of the
+// USB latency.  Returns 0 if fewer than 2 pairs were used.
+// clock = The estimator.
+// scan = The scan, for example a scan index of the decoder.
+// pErrorNs = If not NULL, returns a bound on the error of the fitted line at
+//            that scan: 3 standard deviations, from the residual variance and
+//            the covariance of the fit.
+
+double LJUSB_StreamClockScanRate(const LJUSB_StreamClock *clock);
+// Returns the measured scan rate in scans per second of host time, or the
+// nominal scan rate if fewer than 2 pairs were used (0 if unknown).  Multiply
+// by the number of channels for the sample rate.
+// clock = The estimator.
+
+int LJUSB_StreamPlanCompute(unsigned long productID, unsigned int numChannels, double scanRate, int resolution, double latencyBudgetUs, LJUSB_StreamPlan *plan);
+// Plans the StreamConfig parameters and host reads of a stream.  The clock,
+// divider and ScanInterval closest to the scan rate are picked (the faster
+// clock without the divider on a tie).  Reads are made as large as the
+// latency budget allows, since each read and each short StreamData response
+// costs a USB transfer, and SamplesPerPacket is only reduced below 25 when a
+// full response would take longer to fill than the budget.  Smaller
+// responses are a multiple of numChannels when possible, so each response
+// holds whole scans.  The number of transfers in flight is sized so that
+// reads are resubmitted in time at the planned read rate; it can be met with
+// several threads or LJUSB_StreamAsyncStart, and 1 means LJUSB_Stream calls
+// in a loop keep up.  For closed-loop control, a budget of 1 to 2 ms gives
+// short responses read one per transfer, with several transfers in flight.
+// Returns 0 on success, or -1 on error and errno is set:
+//   EINVAL - a parameter is out of range
+//   ERANGE - the sample rate is above the maximum of the device at the
+//            resolution
+// productID = U3_PRODUCT_ID, U6_PRODUCT_ID or UE9_PRODUCT_ID.
+// numChannels = The number of channels in each scan.
+// scanRate = The target scan rate in scans per second.
+// resolution = The resolution of the stream: the U3 ScanConfig resolution
+//              bits (0-3), the U6 ResolutionIndex (0-8) or the UE9
+//              Resolution (12-16).
+// latencyBudgetUs = The longest acceptable time in microseconds from the
+//                   first sample of a read being taken to the read completing,
+//                   or 0 for no limit (throughput only).
+// plan = Returns the plan.  plan->meetsLatency is 0 when the budget is below
+//        what the device and USB can do; the plan is then the lowest latency
+//        one.
+
+double LJUSB_StreamSampleAgeUs(const LJUSB_StreamDecoder *decoder, unsigned long long startNs, unsigned long long nowNs);
+// Returns the age at host time nowNs of the newest sample decoded, in
+// microseconds, or -1 if no sample was decoded.  The device time of a sample
+// is when its scan was taken:  scan n is taken n+1 scan periods after the
+// stream started, and the channels of a scan are converted right after it.
+// The scan rate measured by decoder->clock is used once it is known to 10
+// ppm and is within 0.1% of the nominal rate, and the nominal rate otherwise.
+// At high read rates, give the clock a forgetting factor that keeps a minute
+// or so of transfers (1 - 1/(reads per second*60)) so that it gets there.
+// Unlike the clock estimate, this includes the USB latency, so it is the
+// delay of the data as seen by the host.
+// decoder = The decoder, after a LJUSB_StreamDecodeStamped call.
+// startNs = The host time the device started the stream.  The middle of the
+//           StreamStart command and its response (LJUSB_GetTimestampNs
+//           before the write and after the read) is within half the round
+//           trip time of it.
+// nowNs = The host time to measure the age at, for example the timestampNs
+//         of the transfer or LJUSB_GetTimestampNs in a callback.
+
+void LJUSB_StreamAgeStatsReset(LJUSB_StreamAgeStats *stats);
+// Discards the ages of a sample age distribution.
+// stats = The distribution.
+
+void LJUSB_StreamAgeStatsAdd(LJUSB_StreamAgeStats *stats, double ageUs);
+// Adds an age to a sample age distribution.  Negative ages count as 0.
+// stats = The distribution.
+// ageUs = The age in microseconds, from LJUSB_StreamSampleAgeUs.
+
+double LJUSB_StreamAgeStatsPercentile(const LJUSB_StreamAgeStats *stats, double percent);
+// Returns a percentile of a sample age distribution in microseconds, within
+// the resolution of its histogram, or 0 if it is empty.  0 returns the
+// minimum and 100 the maximum.
+// stats = The distribution.
+// percent = The percentile, 0 to 100 (for example 50, 99 or 99.9).
+
+int LJUSB_StreamConvert(const LJUSB_StreamChannelCal *cal, unsigned int numChannels, const unsigned short *pRaw, unsigned long numScans, void *pOut, int outputMode);
+// Converts scans of raw codes (decoded with LJUSB_STREAM_OUTPUT_RAW16) to
+// volts, so that pipelines which store or forward raw codes can convert later
+// and only when needed.  Returns 0 on success, or -1 on error and errno is
+// set.
+// cal = The conversions of the numChannels channels, for example
+//       decoder->cal.
+// numChannels = The number of channels in each scan.
+// pRaw = The raw scans, numScans*numChannels codes.
+// numScans = The number of scans to convert.
+// pOut = The buffer for the volts, numScans*numChannels floats or doubles.
+// outputMode = LJUSB_STREAM_OUTPUT_FLOAT32 or LJUSB_STREAM_OUTPUT_FLOAT64.
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LABJACKSTREAM_H_
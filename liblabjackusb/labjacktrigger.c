@@ -0,0 +1,450 @@
+//---------------------------------------------------------------------------
+//
+//  labjacktrigger.c
+//
+//    Triggered capture with a pre-trigger ring for U3, U6 and UE9 stream
+//    scans.
+//
+//  support@labjack.com
+//
+//  SPDX-FileCopyrightText: Copyright (c) 2009 LabJack Corporation
+//  SPDX-License-Identifier: X11
+//
+//---------------------------------------------------------------------------
+//
+
+#include "labjacktrigger.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <stdint.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define LJUSB_TRIGGER_SSE
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define LJUSB_TRIGGER_NEON
+#endif
+
+// Scans searched per pair of bit masks
+#define LJUSB_TRIGGER_CHUNK     64
+
+
+// Where the trigger fires and where it is armed are each a range of the
+// channel, or the outside of a range
+typedef struct LJUSB_TriggerRange
+{
+    float low;
+    float high;
+    int outside;
+} LJUSB_TriggerRange;
+
+
+struct LJUSB_StreamTrigger
+{
+    unsigned int numChannels;
+    LJUSB_StreamTriggerConfig config;
+    LJUSB_StreamTriggerCallback callback;
+    void *userData;
+
+    LJUSB_TriggerRange fire;
+    LJUSB_TriggerRange arm;
+    int alwaysArmed;                // Level triggers
+    int armed;
+    int enabled;                    // 0 after a single shot capture
+
+    float *ring;                    // The last preScans scans
+    unsigned long ringPos;          // Where the next scan goes
+    unsigned long ringCount;        // Scans in the ring
+
+    float *capture;                 // (preScans + postScans) scans
+    int capturing;
+    unsigned long captureScans;     // Scans in the capture so far
+    unsigned long captureTrigger;   // Index of the trigger scan in the capture
+
+    unsigned long long scanIndex;   // Scans processed before the current call
+    unsigned long long nextSearch;  // First scan searched after the holdoff
+    unsigned long long triggerIndex;
+    unsigned long long count;
+};
+
+
+static float LJUSB_TriggerBit(float v, int bit)
+{
+    return (float)(((int)v >> bit) & 1);
+}
+
+
+// Sets bit i of *pFire and *pArm for each scan i of the n (up to
+// LJUSB_TRIGGER_CHUNK) scans of channel x, numChannels floats apart
+static void LJUSB_TriggerMasks(const LJUSB_StreamTrigger *trigger, const float *x, unsigned int n, uint64_t *pFire, uint64_t *pArm)
+{
+    unsigned int nc = trigger->numChannels;
+    int bit = trigger->config.bit;
+    uint64_t fire = 0, arm = 0, valid = 0, all;
+    unsigned int i = 0;
+    float v;
+
+#if defined(LJUSB_TRIGGER_SSE)
+    __m128 fireLow = _mm_set1_ps(trigger->fire.low);
+    __m128 fireHigh = _mm_set1_ps(trigger->fire.high);
+    __m128 armLow = _mm_set1_ps(trigger->arm.low);
+    __m128 armHigh = _mm_set1_ps(trigger->arm.high);
+    __m128 vx;
+    __m128i vi;
+
+    for (; i + 4 <= n; i += 4) {
+        if (nc == 1) {
+            vx = _mm_loadu_ps(x + i);
+        }
+        else {
+            vx = _mm_setr_ps(x[i*nc], x[(i + 1)*nc], x[(i + 2)*nc], x[(i + 3)*nc]);
+        }
+        valid |= (uint64_t)_mm_movemask_ps(_mm_cmpord_ps(vx, vx)) << i;
+        if (bit >= 0) {
+            vi = _mm_srl_epi32(_mm_cvttps_epi32(vx), _mm_cvtsi32_si128(bit));
+            vx = _mm_cvtepi32_ps(_mm_and_si128(vi, _mm_set1_epi32(1)));
+        }
+        fire |= (uint64_t)_mm_movemask_ps(_mm_and_ps(_mm_cmpge_ps(vx, fireLow), _mm_cmple_ps(vx, fireHigh))) << i;
+        arm |= (uint64_t)_mm_movemask_ps(_mm_and_ps(_mm_cmpge_ps(vx, armLow), _mm_cmple_ps(vx, armHigh))) << i;
+    }
+#elif defined(LJUSB_TRIGGER_NEON)
+    float32x4_t fireLow = vdupq_n_f32(trigger->fire.low);
+    float32x4_t fireHigh = vdupq_n_f32(trigger->fire.high);
+    float32x4_t armLow = vdupq_n_f32(trigger->arm.low);
+    float32x4_t armHigh = vdupq_n_f32(trigger->arm.high);
+    static const uint32_t laneBits[4] = {1, 2, 4, 8};
+    uint32x4_t lanes = vld1q_u32(laneBits);
+    float32x4_t vx;
+    float t[4];
+
+    for (; i + 4 <= n; i += 4) {
+        if (nc == 1) {
+            vx = vld1q_f32(x + i);
+        }
+        else {
+            t[0] = x[i*nc];
+            t[1] = x[(i + 1)*nc];
+            t[2] = x[(i + 2)*nc];
+            t[3] = x[(i + 3)*nc];
+            vx = vld1q_f32(t);
+        }
+        valid |= (uint64_t)vaddvq_u32(vandq_u32(vceqq_f32(vx, vx), lanes)) << i;
+        if (bit >= 0) {
+            vx = vcvtq_f32_s32(vandq_s32(vshlq_s32(vcvtq_s32_f32(vx), vdupq_n_s32(-bit)), vdupq_n_s32(1)));
+        }
+        fire |= (uint64_t)vaddvq_u32(vandq_u32(vandq_u32(vcgeq_f32(vx, fireLow), vcleq_f32(vx, fireHigh)), lanes)) << i;
+        arm |= (uint64_t)vaddvq_u32(vandq_u32(vandq_u32(vcgeq_f32(vx, armLow), vcleq_f32(vx, armHigh)), lanes)) << i;
+    }
+#endif
+    for (; i < n; i++) {
+        if (x[i*nc] != x[i*nc]) {
+            continue;
+        }
+        valid |= 1ull << i;
+        v = (bit >= 0) ? LJUSB_TriggerBit(x[i*nc], bit) : x[i*nc];
+        fire |= ((v >= trigger->fire.low && v <= trigger->fire.high) ? 1ull : 0) << i;
+        arm |= ((v >= trigger->arm.low && v <= trigger->arm.high) ? 1ull : 0) << i;
+    }
+
+    // NaN scans (gaps filled by the stream) neither arm nor fire the trigger,
+    // also when the condition is outside of its range
+    all = (n == 64) ? ~0ull : (1ull << n) - 1;
+    *pFire = (trigger->fire.outside ? ~fire & all : fire) & valid;
+    *pArm = (trigger->alwaysArmed ? all : (trigger->arm.outside ? ~arm & all : arm)) & valid;
+}
+
+
+// Returns the first scan from start at which the trigger fires, or -1 if it
+// does not fire in the n scans.  The armed state is kept across calls.
+static long LJUSB_TriggerSearch(LJUSB_StreamTrigger *trigger, const float *pScans, unsigned long start, unsigned long n)
+{
+    const float *x = pScans + trigger->config.channel;
+    unsigned long base;
+    unsigned int len, pos;
+    uint64_t fire, arm, m;
+
+    for (base = start; base < n; base += LJUSB_TRIGGER_CHUNK) {
+        len = (n - base < LJUSB_TRIGGER_CHUNK) ? (unsigned int)(n - base) : LJUSB_TRIGGER_CHUNK;
+        LJUSB_TriggerMasks(trigger, x + base*trigger->numChannels, len, &fire, &arm);
+
+        pos = 0;
+        if (!trigger->armed) {
+            if (arm == 0) {
+                continue;
+            }
+            pos = __builtin_ctzll(arm);
+            trigger->armed = 1;
+        }
+        m = fire & (~0ull << pos);
+        if (m != 0) {
+            trigger->armed = 0;
+            return (long)(base + __builtin_ctzll(m));
+        }
+    }
+    return -1;
+}
+
+
+// Copies scans first to first+count-1 (indexes of the scans processed) from
+// the ring and the scans of the current call
+static void LJUSB_TriggerCopy(const LJUSB_StreamTrigger *trigger, float *pOut, unsigned long long first, unsigned long count, const float *pScans)
+{
+    unsigned int nc = trigger->numChannels;
+    unsigned long preScans = trigger->config.preScans;
+    unsigned long back, pos, n;
+
+    // Scans before the current call are the last ringCount scans of the ring
+    if (first < trigger->scanIndex) {
+        back = (unsigned long)(trigger->scanIndex - first);
+        pos = (trigger->ringPos + preScans - back) % preScans;
+        while (back > 0 && count > 0) {
+            n = (pos + back > preScans) ? preScans - pos : back;
+            if (n > count) {
+                n = count;
+            }
+            memcpy(pOut, trigger->ring + (size_t)pos*nc, (size_t)n*nc*sizeof(float));
+            pOut += (size_t)n*nc;
+            pos = (pos + n) % preScans;
+            back -= n;
+            count -= n;
+        }
+        first = trigger->scanIndex;
+    }
+
+    if (count > 0) {
+        memcpy(pOut, pScans + (size_t)(first - trigger->scanIndex)*nc, (size_t)count*nc*sizeof(float));
+    }
+}
+
+
+// Keeps the last preScans scans of the current call in the ring
+static void LJUSB_TriggerKeep(LJUSB_StreamTrigger *trigger, const float *pScans, unsigned long numScans)
+{
+    unsigned int nc = trigger->numChannels;
+    unsigned long preScans = trigger->config.preScans;
+    unsigned long n;
+
+    if (preScans == 0) {
+        return;
+    }
+    if (numScans > preScans) {
+        pScans += (size_t)(numScans - preScans)*nc;
+        numScans = preScans;
+    }
+    while (numScans > 0) {
+        n = preScans - trigger->ringPos;
+        if (n > numScans) {
+            n = numScans;
+        }
+        memcpy(trigger->ring + (size_t)trigger->ringPos*nc, pScans, (size_t)n*nc*sizeof(float));
+        trigger->ringPos = (trigger->ringPos + n) % preScans;
+        trigger->ringCount = (trigger->ringCount + n > preScans) ? preScans : trigger->ringCount + n;
+        pScans += (size_t)n*nc;
+        numScans -= n;
+    }
+}
+
+
+LJUSB_StreamTrigger *LJUSB_StreamTriggerCreate(unsigned int numChannels, const LJUSB_StreamTriggerConfig *config, LJUSB_StreamTriggerCallback callback, void *userData)
+{
+    LJUSB_StreamTrigger *trigger;
+    const LJUSB_StreamTriggerConfig *c = config;
+    double level, h;
+
+    if (numChannels < 1 || numChannels > LJUSB_STREAM_MAX_CHANNELS || c == NULL || callback == NULL ||
+        c->channel >= numChannels || c->bit < -1 || c->bit > 15 ||
+        (c->direction != LJUSB_TRIGGER_RISING && c->direction != LJUSB_TRIGGER_FALLING) ||
+        !(c->hysteresis >= 0) || c->postScans < 1 || c->postScans > LJUSB_TRIGGER_MAX_SCANS ||
+        c->preScans > LJUSB_TRIGGER_MAX_SCANS - c->postScans) {
+        errno = EINVAL;
+        return NULL;
+    }
+    if (c->type == LJUSB_TRIGGER_WINDOW && (c->bit >= 0 || !(c->low <= c->high))) {
+        errno = EINVAL;
+        return NULL;
+    }
+    if (c->type != LJUSB_TRIGGER_EDGE && c->type != LJUSB_TRIGGER_LEVEL && c->type != LJUSB_TRIGGER_WINDOW) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    trigger = (LJUSB_StreamTrigger *)calloc(1, sizeof(LJUSB_StreamTrigger));
+    if (trigger == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    trigger->numChannels = numChannels;
+    trigger->config = *c;
+    trigger->callback = callback;
+    trigger->userData = userData;
+
+    trigger->ring = (float *)malloc(((size_t)c->preScans + 1)*numChannels*sizeof(float));
+    trigger->capture = (float *)malloc(((size_t)c->preScans + c->postScans)*numChannels*sizeof(float));
+    if (trigger->ring == NULL || trigger->capture == NULL) {
+        LJUSB_StreamTriggerDestroy(trigger);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    // A bit of a digital channel is compared as 0 or 1 against 0.5
+    level = (c->bit >= 0) ? 0.5 : c->level;
+    h = (c->bit >= 0) ? 0 : c->hysteresis;
+
+    switch (c->type) {
+    case LJUSB_TRIGGER_EDGE:
+        // Armed once the channel is below level - hysteresis (rising) or
+        // above level + hysteresis (falling)
+        if (c->direction == LJUSB_TRIGGER_RISING) {
+            trigger->fire.low = (float)level;
+            trigger->fire.high = INFINITY;
+            trigger->arm.low = (float)(level - h);
+            trigger->arm.high = INFINITY;
+            trigger->arm.outside = 1;
+        }
+        else {
+            trigger->fire.low = -INFINITY;
+            trigger->fire.high = (float)level;
+            trigger->arm.low = -INFINITY;
+            trigger->arm.high = (float)(level + h);
+            trigger->arm.outside = 1;
+        }
+        break;
+
+    case LJUSB_TRIGGER_LEVEL:
+        trigger->fire.low = (c->direction == LJUSB_TRIGGER_RISING) ? (float)level : -INFINITY;
+        trigger->fire.high = (c->direction == LJUSB_TRIGGER_RISING) ? INFINITY : (float)level;
+        trigger->alwaysArmed = 1;
+        break;
+
+    case LJUSB_TRIGGER_WINDOW:
+        // Entering fires inside the window and is armed outside the window
+        // widened by the hysteresis; leaving is the opposite
+        if (c->direction == LJUSB_TRIGGER_RISING) {
+            trigger->fire.low = (float)c->low;
+            trigger->fire.high = (float)c->high;
+            trigger->arm.low = (float)(c->low - h);
+            trigger->arm.high = (float)(c->high + h);
+            trigger->arm.outside = 1;
+        }
+        else {
+            trigger->fire.low = (float)c->low;
+            trigger->fire.high = (float)c->high;
+            trigger->fire.outside = 1;
+            trigger->arm.low = (float)(c->low + h);
+            trigger->arm.high = (float)(c->high - h);
+        }
+        break;
+    }
+
+    LJUSB_StreamTriggerReset(trigger);
+    return trigger;
+}
+
+
+long LJUSB_StreamTriggerProcess(LJUSB_StreamTrigger *trigger, const float *pScans, unsigned long numScans)
+{
+    LJUSB_StreamTriggerConfig *c = &trigger->config;
+    unsigned int nc = trigger->numChannels;
+    unsigned long s = 0, n, pre, start;
+    long t, callbacks = 0;
+
+    while (s < numScans) {
+        if (trigger->capturing) {
+            n = trigger->captureTrigger + c->postScans - trigger->captureScans;
+            if (n > numScans - s) {
+                n = numScans - s;
+            }
+            memcpy(trigger->capture + (size_t)trigger->captureScans*nc, pScans + (size_t)s*nc, (size_t)n*nc*sizeof(float));
+            trigger->captureScans += n;
+            s += n;
+
+            if (trigger->captureScans == trigger->captureTrigger + c->postScans) {
+                trigger->capturing = 0;
+                trigger->nextSearch = trigger->scanIndex + s + c->holdoffScans;
+                if (c->singleShot) {
+                    trigger->enabled = 0;
+                }
+                trigger->callback(trigger->capture, trigger->captureScans, trigger->captureTrigger, trigger->triggerIndex, trigger->userData);
+                callbacks++;
+            }
+            continue;
+        }
+
+        if (!trigger->enabled) {
+            break;
+        }
+
+        start = s;
+        if (trigger->nextSearch > trigger->scanIndex + s) {
+            if (trigger->nextSearch - trigger->scanIndex >= numScans) {
+                break;
+            }
+            start = (unsigned long)(trigger->nextSearch - trigger->scanIndex);
+        }
+
+        t = LJUSB_TriggerSearch(trigger, pScans, start, numScans);
+        if (t < 0) {
+            break;
+        }
+
+        // The capture starts with the scans before the trigger, from the ring
+        // and this call
+        trigger->count++;
+        trigger->triggerIndex = trigger->scanIndex + t;
+        pre = trigger->ringCount + t;
+        if (pre > c->preScans) {
+            pre = c->preScans;
+        }
+        LJUSB_TriggerCopy(trigger, trigger->capture, trigger->triggerIndex - pre, pre, pScans);
+        trigger->captureScans = pre;
+        trigger->captureTrigger = pre;
+        trigger->capturing = 1;
+        s = t;
+    }
+
+    LJUSB_TriggerKeep(trigger, pScans, numScans);
+    trigger->scanIndex += numScans;
+    return callbacks;
+}
+
+
+void LJUSB_StreamTriggerArm(LJUSB_StreamTrigger *trigger)
+{
+    trigger->enabled = 1;
+}
+
+
+unsigned long long LJUSB_StreamTriggerCount(const LJUSB_StreamTrigger *trigger)
+{
+    return trigger->count;
+}
+
+
+void LJUSB_StreamTriggerReset(LJUSB_StreamTrigger *trigger)
+{
+    trigger->armed = trigger->alwaysArmed;
+    trigger->enabled = 1;
+    trigger->ringPos = 0;
+    trigger->ringCount = 0;
+    trigger->capturing = 0;
+    trigger->captureScans = 0;
+    trigger->captureTrigger = 0;
+    trigger->scanIndex = 0;
+    trigger->nextSearch = 0;
+    trigger->triggerIndex = 0;
+    trigger->count = 0;
+}
+
+
+void LJUSB_StreamTriggerDestroy(LJUSB_StreamTrigger *trigger)
+{
+    if (trigger == NULL) {
+        return;
+    }
+    free(trigger->ring);
+    free(trigger->capture);
+    free(trigger);
+}
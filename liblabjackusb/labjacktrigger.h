@@ -0,0 +1,143 @@
+//-----------------------------------------------------------------------------
+//
+//  labjacktrigger.h
+//
+//  Header file for the triggered stream capture of the labjackusb library.
+//  Watches scans of volts decoded with LJUSB_STREAM_OUTPUT_FLOAT32 for a
+//  level, edge or window trigger on an analog channel or a bit of a digital
+//  channel, keeps the scans before the trigger in a ring, and passes each
+//  capture of pre-trigger and post-trigger scans to a callback.
+//
+//  support@labjack.com
+//
+//  SPDX-FileCopyrightText: Copyright (c) 2009 LabJack Corporation
+//  SPDX-License-Identifier: X11
+//
+//-----------------------------------------------------------------------------
+//
+
+#ifndef LABJACKTRIGGER_H_
+#define LABJACKTRIGGER_H_
+
+#include "labjackstream.h"
+
+//Trigger types
+#define LJUSB_TRIGGER_EDGE            0  //The channel crosses the level
+#define LJUSB_TRIGGER_LEVEL           1  //The channel is beyond the level
+#define LJUSB_TRIGGER_WINDOW          2  //The channel enters or leaves a window
+
+//Trigger directions
+#define LJUSB_TRIGGER_RISING          0  //Edge: crosses up through the level.
+                                         //Level: at or above the level.
+                                         //Window: enters the window.
+#define LJUSB_TRIGGER_FALLING         1  //Edge: crosses down through the level.
+                                         //Level: at or below the level.
+                                         //Window: leaves the window.
+
+//Largest number of scans in a capture
+#define LJUSB_TRIGGER_MAX_SCANS       16777216
+
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+
+//Trigger and capture settings of LJUSB_StreamTriggerCreate
+typedef struct LJUSB_StreamTriggerConfig
+{
+    int type;                       //LJUSB_TRIGGER_EDGE, LJUSB_TRIGGER_LEVEL or
+                                    //LJUSB_TRIGGER_WINDOW
+    int direction;                  //LJUSB_TRIGGER_RISING or LJUSB_TRIGGER_FALLING
+    unsigned int channel;           //Index of the channel in the scan
+    int bit;                        //-1 for an analog channel, or the bit (0-15)
+                                    //of a digital channel, such as the FIO/EIO
+                                    //state, decoded without a conversion.
+                                    //The bit is 1 or 0 against a level of 0.5.
+    double level;                   //Edge and level triggers, in volts
+    double low;                     //Window triggers, in volts
+    double high;
+    double hysteresis;              //Edge and window triggers: how far the
+                                    //channel must go back past the level or
+                                    //window edge before the trigger can fire
+                                    //again, to ignore noise.  0 for none.
+    unsigned long preScans;         //Scans before the trigger scan kept in the
+                                    //ring and passed to the callback
+    unsigned long postScans;        //Scans from the trigger scan on (1 or more)
+    unsigned long holdoffScans;     //Scans after a capture before the trigger
+                                    //is evaluated again
+    int singleShot;                 //1 to stop after one capture until
+                                    //LJUSB_StreamTriggerArm
+} LJUSB_StreamTriggerConfig;
+
+//Called by LJUSB_StreamTriggerProcess for each complete capture.
+//pScans = The capture, numScans*numChannels floats, channel-interleaved.  The
+//         buffer is reused when the callback returns.
+//numScans = The number of scans: the pre-trigger scans available (up to
+//           preScans, fewer right after the trigger was created or reset)
+//           plus postScans.
+//triggerScan = The index of the trigger scan in pScans, which is the number
+//              of pre-trigger scans.
+//triggerIndex = The number of scans passed to LJUSB_StreamTriggerProcess
+//               before the trigger scan; with gap fill on, the stream scan
+//               index of the decoder.
+//userData = The userData of LJUSB_StreamTriggerCreate.
+typedef void (*LJUSB_StreamTriggerCallback)(const float *pScans, unsigned long numScans, unsigned long triggerScan, unsigned long long triggerIndex, void *userData);
+
+//Triggered capture, from LJUSB_StreamTriggerCreate
+typedef struct LJUSB_StreamTrigger LJUSB_StreamTrigger;
+
+
+LJUSB_StreamTrigger *LJUSB_StreamTriggerCreate(unsigned int numChannels, const LJUSB_StreamTriggerConfig *config, LJUSB_StreamTriggerCallback callback, void *userData);
+// Creates a triggered capture.  The trigger channel is compared 4 scans at a
+// time with SSE or NEON when available, into bit masks of where the trigger
+// can fire and where it is armed again, so scans are searched 64 at a time
+// and the cost per scan is a few instructions whatever the number of
+// channels.  The ring and capture buffers are allocated here, so
+// LJUSB_StreamTriggerProcess does not allocate.  Edge and window triggers
+// start disarmed: the channel must first be on the other side of the level
+// or window.  Returns the capture, or NULL on error and errno is set.
+// numChannels = The number of channels in each scan (1 to
+//               LJUSB_STREAM_MAX_CHANNELS).
+// config = The trigger and capture settings.  preScans + postScans can be up
+//          to LJUSB_TRIGGER_MAX_SCANS.
+// callback = Called with each capture.
+// userData = Passed to callback.
+
+long LJUSB_StreamTriggerProcess(LJUSB_StreamTrigger *trigger, const float *pScans, unsigned long numScans);
+// Searches scans for the trigger, copies the scans of captures in progress,
+// and calls the callback for each capture completed, from the calling thread.
+// The last preScans scans are kept for the captures of later calls.  A
+// trigger is not searched for while a capture is in progress and during the
+// holdoff after it.  NaN scans (gap fill) never arm or fire the trigger,
+// whatever its condition.
+// Returns the number of callbacks made.
+// trigger = The triggered capture.
+// pScans = The scans, numScans*numChannels floats, from LJUSB_StreamDecode
+//          with LJUSB_STREAM_OUTPUT_FLOAT32 or LJUSB_StreamConvert.
+// numScans = The number of scans in pScans.
+
+void LJUSB_StreamTriggerArm(LJUSB_StreamTrigger *trigger);
+// Lets a single shot trigger fire again.
+// trigger = The triggered capture.
+
+unsigned long long LJUSB_StreamTriggerCount(const LJUSB_StreamTrigger *trigger);
+// Returns the number of times the trigger fired, including a capture in
+// progress.
+// trigger = The triggered capture.
+
+void LJUSB_StreamTriggerReset(LJUSB_StreamTrigger *trigger);
+// Discards the ring, a capture in progress and the scan count, for when a
+// stream is restarted, and arms the trigger.
+// trigger = The triggered capture.
+
+void LJUSB_StreamTriggerDestroy(LJUSB_StreamTrigger *trigger);
+// Frees a triggered capture.  A capture in progress is discarded.
+// trigger = The triggered capture.
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LABJACKTRIGGER_H_
@@ -24,10 +24,12 @@
 #include <sys/utsname.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <time.h>
 
 #include <libusb-1.0/libusb.h>
 
 #define LJ_LIBUSB_TIMEOUT_DEFAULT   1000   // Milliseconds to wait on USB transfers
+#define LJ_ASYNC_STOP_MAX_ERRORS    5      // Event handling failures before leaking reads
 
 // With a recent Linux kernel, firmware and hardware checks aren't necessary
 #define LJ_RECENT_KERNEL_MAJOR  2
@@ -1060,6 +1062,272 @@ unsigned long LJUSB_StreamTO(HANDLE hDevice, BYTE *pBuff, unsigned long count, u
 }
 
 
+unsigned long LJUSB_StreamStampedTO(HANDLE hDevice, BYTE *pBuff, unsigned long count, unsigned int timeout, unsigned long long *pTimestampNs)
+{
+    unsigned long r;
+
+    r = LJUSB_SetupTransfer(hDevice, pBuff, count, timeout, LJUSB_STREAM);
+    if (pTimestampNs != NULL) {
+        *pTimestampNs = LJUSB_GetTimestampNs();
+    }
+    return r;
+}
+
+
+unsigned long long LJUSB_GetTimestampNs(void)
+{
+    struct timespec ts;
+
+#ifdef CLOCK_MONOTONIC_RAW
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+#else
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#endif
+    return (unsigned long long)ts.tv_sec*1000000000ULL + ts.tv_nsec;
+}
+
+
+struct LJUSB_StreamAsync
+{
+    HANDLE hDevice;
+    unsigned int numTransfers;
+    unsigned int inFlight;          //Transfers submitted and not yet completed
+    unsigned int completed;         //Callbacks made by the current LJUSB_StreamAsyncHandleEvents
+    bool stopping;
+    int error;                      //errno of the first failed transfer, or 0
+    LJUSB_StreamCallback callback;
+    void *userData;
+    struct libusb_transfer *transfers[LJUSB_STREAM_ASYNC_MAX_TRANSFERS];
+    BYTE *buffers;
+};
+
+
+// Returns the stream endpoint of a device, or 0 if it has none.
+static unsigned char LJUSB_StreamEndpoint(HANDLE hDevice)
+{
+    struct libusb_device_descriptor desc;
+
+    if (libusb_get_device_descriptor(libusb_get_device(hDevice), &desc) < 0) {
+        return 0;
+    }
+
+    switch (desc.idProduct) {
+    case UE9_PRODUCT_ID:
+        return UE9_PIPE_EP2_IN;
+    case U3_PRODUCT_ID:
+        return U3_PIPE_EP3_IN;
+    case U6_PRODUCT_ID:
+        return U6_PIPE_EP3_IN;
+    case BRIDGE_PRODUCT_ID:
+        return BRIDGE_PIPE_EP3_IN;
+    case T4_PRODUCT_ID:
+        return T4_PIPE_EP3_IN;
+    case T5_PRODUCT_ID:
+        return T5_PIPE_EP3_IN;
+    case T7_PRODUCT_ID:
+        return T7_PIPE_EP3_IN;
+    default:
+        return 0;
+    }
+}
+
+
+static void LIBUSB_CALL LJUSB_StreamAsyncCallback(struct libusb_transfer *transfer)
+{
+    LJUSB_StreamAsync *async = (LJUSB_StreamAsync *)transfer->user_data;
+    unsigned long long timestampNs = LJUSB_GetTimestampNs();
+    int error = 0, r;
+
+    async->inFlight--;
+
+    switch (transfer->status) {
+    case LIBUSB_TRANSFER_COMPLETED:
+        break;
+    case LIBUSB_TRANSFER_TIMED_OUT:
+        error = ETIMEDOUT;
+        break;
+    case LIBUSB_TRANSFER_CANCELLED:
+        return;
+    case LIBUSB_TRANSFER_NO_DEVICE:
+        error = ENODEV;
+        break;
+    case LIBUSB_TRANSFER_OVERFLOW:
+        error = EOVERFLOW;
+        break;
+    default:
+        error = EIO;
+        break;
+    }
+
+    if (async->stopping) {
+        return;
+    }
+
+    async->callback(transfer->buffer, (unsigned long)transfer->actual_length, timestampNs, error, async->userData);
+    async->completed++;
+
+    if (error != 0 && error != ETIMEDOUT) {
+        if (async->error == 0) {
+            async->error = error;
+        }
+        return;
+    }
+
+    r = libusb_submit_transfer(transfer);
+    if (r != 0) {
+        LJUSB_libusbError(r);
+        if (async->error == 0) {
+            async->error = errno;
+        }
+        return;
+    }
+    async->inFlight++;
+}
+
+
+LJUSB_StreamAsync *LJUSB_StreamAsyncStart(HANDLE hDevice, unsigned long count, unsigned int numTransfers, unsigned int timeout, LJUSB_StreamCallback callback, void *userData)
+{
+    LJUSB_StreamAsync *async;
+    unsigned char endpoint;
+    unsigned int i;
+    int r;
+
+    if (LJUSB_isNullHandle(hDevice)) {
+        return NULL;
+    }
+
+    if (count == 0 || count > 65535 || numTransfers == 0 ||
+        numTransfers > LJUSB_STREAM_ASYNC_MAX_TRANSFERS || callback == NULL) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    endpoint = LJUSB_StreamEndpoint(hDevice);
+    if (endpoint == 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    async = (LJUSB_StreamAsync *)calloc(1, sizeof(LJUSB_StreamAsync));
+    if (async == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    async->hDevice = hDevice;
+    async->numTransfers = numTransfers;
+    async->callback = callback;
+    async->userData = userData;
+    async->buffers = (BYTE *)malloc(count*numTransfers);
+    if (async->buffers == NULL) {
+        free(async);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    for (i = 0; i < numTransfers; i++) {
+        async->transfers[i] = libusb_alloc_transfer(0);
+        if (async->transfers[i] == NULL) {
+            LJUSB_StreamAsyncStop(async);
+            errno = ENOMEM;
+            return NULL;
+        }
+        libusb_fill_bulk_transfer(async->transfers[i], hDevice, endpoint, async->buffers + i*count,
+                                  (int)count, LJUSB_StreamAsyncCallback, async, timeout);
+    }
+
+    //The transfers are queued on the endpoint in this order and complete in it
+    for (i = 0; i < numTransfers; i++) {
+        r = libusb_submit_transfer(async->transfers[i]);
+        if (r != 0) {
+            LJUSB_libusbError(r);
+            r = errno;
+            LJUSB_StreamAsyncStop(async);
+            errno = r;
+            return NULL;
+        }
+        async->inFlight++;
+    }
+
+    return async;
+}
+
+
+int LJUSB_StreamAsyncHandleEvents(LJUSB_StreamAsync *async, unsigned int timeout)
+{
+    struct timeval tv;
+    int r;
+
+    if (async == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    async->completed = 0;
+    if (async->error == 0) {
+        tv.tv_sec = timeout/1000;
+        tv.tv_usec = (timeout % 1000)*1000;
+        r = libusb_handle_events_timeout_completed(gLJContext, &tv, NULL);
+        if (r < 0) {
+            return LJUSB_libusbError(r);
+        }
+    }
+
+    if (async->error != 0) {
+        errno = async->error;
+        return -1;
+    }
+    return (int)async->completed;
+}
+
+
+void LJUSB_StreamAsyncStop(LJUSB_StreamAsync *async)
+{
+    struct timeval tv;
+    unsigned int i;
+    int errors = 0;
+    int r = 0;
+
+    if (async == NULL) {
+        return;
+    }
+
+    async->stopping = true;
+    for (i = 0; i < async->numTransfers; i++) {
+        if (async->transfers[i] != NULL) {
+            libusb_cancel_transfer(async->transfers[i]);
+        }
+    }
+
+    //Cancelled transfers still complete through the event handler
+    while (async->inFlight > 0 && errors < LJ_ASYNC_STOP_MAX_ERRORS) {
+        tv.tv_sec = 1;
+        tv.tv_usec = 0;
+        r = libusb_handle_events_timeout_completed(gLJContext, &tv, NULL);
+        if (r < 0 && r != LIBUSB_ERROR_INTERRUPTED) {
+            errors++;
+        }
+        else {
+            errors = 0;
+        }
+    }
+
+    //libusb still owns transfers that have not completed, and their callbacks
+    //reference async, so freeing them here would be a use-after-free
+    if (async->inFlight > 0) {
+        fprintf(stderr, "LJUSB_StreamAsyncStop: %u reads did not complete (libusb error %d), leaking them\n", async->inFlight, r);
+        return;
+    }
+
+    for (i = 0; i < async->numTransfers; i++) {
+        if (async->transfers[i] != NULL) {
+            libusb_free_transfer(async->transfers[i]);
+        }
+    }
+    free(async->buffers);
+    free(async);
+}
+
+
 void LJUSB_CloseDevice(HANDLE hDevice)
 {
 #if LJ_DEBUG
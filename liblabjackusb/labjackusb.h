@@ -72,13 +72,58 @@
 //  2.0600 - Initial T4 and T5 support
 //  2.0700 - Added new function LJUSB_OpenAllDevicesOfProductId
 //         - Bug fixes, spelling corrections and code cleanup
+//  2.0800 - Added U3/U6/UE9 stream decoding functions (labjackstream.h) with
+//           raw 16-bit, float and double output modes
+//         - Added I2C transaction engine (labjacki2c.h) with queued and
+//           pipelined I2C commands
+//         - Added LJUSB_StreamStampedTO and LJUSB_GetTimestampNs for host
+//           timestamps of stream transfers
+//         - Added stream clock estimator (LJUSB_StreamClock) that fits device
+//           scans to host time and measures the actual scan rate
+//         - Stream decoder records U3/U6 auto-recovery gaps and can fill
+//           them so scan indexes stay aligned with stream time
+//         - Added LJUSB_StreamPlanCompute, which plans StreamConfig parameters
+//           and read sizes for a scan rate and latency budget
+//         - Simulated devices (make sim) stream, with buffer overflows
+//         - Added LJUSB_StreamAsyncStart, LJUSB_StreamAsyncHandleEvents and
+//           LJUSB_StreamAsyncStop for stream reads with several transfers in
+//           flight and completion callbacks
+//         - Added stream sample age measurement (LJUSB_StreamSampleAgeUs and
+//           LJUSB_StreamAgeStats percentiles)
+//         - Added stream writer (labjackwriter.h) that writes stream data to
+//           a file from a writer thread with aligned buffers, optional
+//           O_DIRECT and preallocation
+//         - Added lossless packed stream format (labjackpack.h) with delta,
+//           zigzag and bit-packed codes, CRC-checked chunks and the channel
+//           calibration in the file header
+//         - Packed stream files end with a chunk index (scan, host time and
+//           file offset), and LJUSB_StreamPackFileOpen finds and maps time or
+//           scan ranges in O(log n)
+//         - Added shared memory stream ring (labjackring.h) that publishes
+//           stream scans to lock-free readers in other processes, with
+//           overrun detection instead of waiting for slow readers
+//         - Added the ljshared daemon and liblabjackusb_client
+//           (labjackshared.h) to share devices and streams between processes
+//         - Added stream decimation filters (labjackfilter.h): boxcar, CIC
+//           and polyphase FIR, with SSE/NEON inner loops
+//         - Added per-block channel statistics computed by the stream decoder
+//           (LJUSB_StreamDecoderSetStats and LJUSB_StreamDecoderGetStats)
+//         - Added triggered stream capture (labjacktrigger.h) with level, edge
+//           and window triggers and a pre-trigger ring
+//         - Added a Feedback scanner (labjackscanner.h) that sends a command at
+//           a fixed period from its own thread with absolute deadlines
+//         - Stream decoder keeps the largest backlog and counts buffer
+//           overflows since it was reset (maxBacklog and overflows)
+//         - Added device workers (labjackworker.h) that run the commands of a
+//           device on a thread pinned to a CPU, submitted through a lock-free
+//           queue and completed as futures or with callbacks
 //-----------------------------------------------------------------------------
 //
 
 #ifndef LABJACKUSB_H_
 #define LABJACKUSB_H_
 
-#define LJUSB_LIBRARY_VERSION 2.0700f
+#define LJUSB_LIBRARY_VERSION 2.0800f
 
 #include <stdbool.h>
 
@@ -146,11 +191,31 @@ typedef unsigned char BYTE;
 #define DIGIT_PIPE_EP2_IN      0x82
 
 
+//Maximum number of transfers kept in flight by LJUSB_StreamAsyncStart
+#define LJUSB_STREAM_ASYNC_MAX_TRANSFERS  32
+
+
 #ifdef __cplusplus
 extern "C"{
 #endif
 
 
+//Asynchronous stream reads started by LJUSB_StreamAsyncStart
+typedef struct LJUSB_StreamAsync LJUSB_StreamAsync;
+
+//Called by LJUSB_StreamAsyncHandleEvents for each completed stream transfer,
+//in the order the data was read.
+//pBuff = The bytes read.  The buffer is reused when the callback returns.
+//count = The number of bytes read.
+//timestampNs = The host time the transfer completed, from
+//              LJUSB_GetTimestampNs.
+//error = 0, ETIMEDOUT if the transfer timed out (count may be above 0), or
+//        the errno of a failed transfer.  Failed transfers are not submitted
+//        again.
+//userData = The userData of LJUSB_StreamAsyncStart.
+typedef void (*LJUSB_StreamCallback)(BYTE *pBuff, unsigned long count, unsigned long long timestampNs, int error, void *userData);
+
+
 float LJUSB_GetLibraryVersion(void);
 //Returns the labjackusb library version number.
 
@@ -285,6 +350,64 @@ unsigned long LJUSB_StreamTO(HANDLE hDevice, BYTE *pBuff, unsigned long count, u
 // timeout = The USB communication timeout value in milliseconds.  Pass 0 for
 //           an unlimited timeout.
 
+unsigned long LJUSB_StreamStampedTO(HANDLE hDevice, BYTE *pBuff, unsigned long count, unsigned int timeout, unsigned long long *pTimestampNs);
+// Same as LJUSB_StreamTO, and also returns the host time at which the transfer
+// completed, taken with LJUSB_GetTimestampNs as soon as libusb returns.  Pass
+// the time to LJUSB_StreamDecodeStamped (labjackstream.h) to tag the decoded
+// scans.  Returns the number of bytes read, or 0 on error and errno is set.
+// hDevice = The handle for your device
+// pBuff = The buffer to be filled in with bytes from the device.
+// count = The number of bytes expected to be read.
+// timeout = The USB communication timeout value in milliseconds.  Pass 0 for
+//           an unlimited timeout.
+// pTimestampNs = Returns the completion time in nanoseconds.  Set on errors
+//                and timeouts too, since a timed out transfer may have read
+//                some bytes.
+
+unsigned long long LJUSB_GetTimestampNs(void);
+// Returns the current host time in nanoseconds on the clock used by
+// LJUSB_StreamStampedTO: CLOCK_MONOTONIC_RAW where available, otherwise
+// CLOCK_MONOTONIC.  The raw clock is not slewed by NTP, so intervals measured
+// with it follow the host oscillator.  Use it to timestamp data from other
+// sensors on the same time base.
+
+LJUSB_StreamAsync *LJUSB_StreamAsyncStart(HANDLE hDevice, unsigned long count, unsigned int numTransfers, unsigned int timeout, LJUSB_StreamCallback callback, void *userData);
+// Submits numTransfers stream reads of count bytes so that several reads are
+// waiting on the device at all times.  Each transfer that completes is passed
+// to callback by LJUSB_StreamAsyncHandleEvents and submitted again, so there
+// is no gap between reads for the host to resubmit, and small reads can be
+// used for low latency.  Start the stream on the device (StreamStart)
+// before or after this call.  Returns the reads, or NULL on error and errno
+// is set.
+// hDevice = The handle for your device.
+// count = The number of bytes of each read.  For U3 and U6 devices, a
+//         StreamData response shorter than 64 bytes ends a read, so reads of
+//         short responses return one response each.
+// numTransfers = The number of reads kept in flight (1 to
+//                LJUSB_STREAM_ASYNC_MAX_TRANSFERS).  See
+//                LJUSB_StreamPlanCompute (labjackstream.h).
+// timeout = The USB communication timeout of each read in milliseconds.  Pass
+//           0 for an unlimited timeout.
+// callback = The function called for each completed read.
+// userData = Passed to callback.
+
+int LJUSB_StreamAsyncHandleEvents(LJUSB_StreamAsync *async, unsigned int timeout);
+// Waits up to timeout milliseconds for reads to complete and calls the
+// callback of each, from the calling thread.  Call it in a loop.  Returns the
+// number of callbacks made, or -1 on error and errno is set.  After a read
+// fails, it is not submitted again and -1 is returned with its errno; call
+// LJUSB_StreamAsyncStop.
+// async = The reads of LJUSB_StreamAsyncStart.
+// timeout = The longest time to wait in milliseconds.
+
+void LJUSB_StreamAsyncStop(LJUSB_StreamAsync *async);
+// Cancels the reads in flight, waits for them to end and frees async.
+// Callbacks are not made for cancelled reads.  Stop the stream on the device
+// (StreamStop) afterwards.  If libusb event handling keeps failing before all
+// reads end, async is left allocated (leaked) with a warning on stderr rather
+// than freeing transfers libusb still owns.
+// async = The reads of LJUSB_StreamAsyncStart.
+
 void LJUSB_CloseDevice(HANDLE hDevice);
 // Closes the handle of a LabJack USB device.
 
@@ -0,0 +1,832 @@
+//---------------------------------------------------------------------------
+//
+//  labjackusb_client.c
+//
+//    The labjackusb.h functions as a client of the ljshared daemon, which
+//    shares U3, U6 and UE9 devices between processes (labjackshared.h).
+//    "make client" builds it with the rest of the library as
+//    liblabjackusb_client.a and liblabjackusb_client.so (.dylib on Mac OS X).
+//
+//    Each device handle is a connection to the daemon.  LJUSB_Write sends the
+//    command and returns; LJUSB_Read waits for the response of the oldest
+//    command written, so commands can be written ahead like with direct
+//    access.  LJUSB_Stream reads the StreamData packets the daemon publishes
+//    to the stream ring of the device.
+//
+//    Environment variables:
+//      LJSHARED_SOCKET   Socket of the daemon.  Default is
+//                        LJUSB_SHARED_SOCKET.
+//
+//  support@labjack.com
+//
+//  SPDX-FileCopyrightText: Copyright (c) 2009 LabJack Corporation
+//  SPDX-License-Identifier: X11
+//
+//---------------------------------------------------------------------------
+//
+
+#include "labjackusb.h"
+#include "labjackshared.h"
+#include "labjackring.h"
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+#define LJCLIENT_MAGIC          0x4C4A5348  // "LJSH"
+#define LJCLIENT_MAX_DEVICES    16
+
+struct LJCLIENT_Device
+{
+    unsigned int magic;
+    int fd;
+    uint32_t id;                    // Handle of the device in the daemon
+    unsigned long productID;
+    unsigned short releaseNumber;
+
+    // Commands written and not read yet
+    pthread_mutex_t lock;
+    unsigned long long writtenNs[LJUSB_SHARED_MAX_PENDING];
+    unsigned int pendingHead;
+    unsigned int pendingCount;
+
+    // Command timing, under lock
+    unsigned long long commands;
+    unsigned long long roundTripNs;
+    unsigned long long deviceNs;
+    unsigned long long queueNs;
+    unsigned long long overheadNs;
+    unsigned long long maxOverheadNs;
+
+    // Stream, used by the thread reading the stream
+    pthread_mutex_t streamLock;
+    LJUSB_StreamRingReader *reader;
+    unsigned long packetSize;
+};
+
+
+static struct LJCLIENT_Device *LJCLIENT_GetDevice(HANDLE hDevice)
+{
+    struct LJCLIENT_Device *dev = (struct LJCLIENT_Device *)hDevice;
+
+    if (dev == NULL || dev->magic != LJCLIENT_MAGIC) {
+        errno = EINVAL;
+        return NULL;
+    }
+    return dev;
+}
+
+
+// Connects to the daemon.  Returns the socket, or -1 and errno is set.
+static int LJCLIENT_Connect(void)
+{
+    struct sockaddr_un addr;
+    const char *path = getenv("LJSHARED_SOCKET");
+    int fd, err;
+
+    if (path == NULL) {
+        path = LJUSB_SHARED_SOCKET;
+    }
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+#ifdef SO_NOSIGPIPE
+    err = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &err, sizeof(err));
+#endif
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        err = errno;
+        close(fd);
+        errno = err;
+        return -1;
+    }
+    return fd;
+}
+
+
+// Sends a message and its data.  Returns 0 on success, or -1 and errno is
+// set.
+static int LJCLIENT_Send(int fd, const LJUSB_SharedMsg *msg, const void *data)
+{
+    BYTE buff[sizeof(LJUSB_SharedMsg) + LJUSB_SHARED_MAX_COMMAND];
+    size_t left = sizeof(LJUSB_SharedMsg) + msg->size;
+    const BYTE *p = buff;
+    ssize_t r;
+
+    // One send, so the daemon gets the command in one piece
+    memcpy(buff, msg, sizeof(LJUSB_SharedMsg));
+    if (msg->size > 0) {
+        memcpy(buff + sizeof(LJUSB_SharedMsg), data, msg->size);
+    }
+    while (left > 0) {
+        r = send(fd, p, left, MSG_NOSIGNAL);
+        if (r < 0 && errno == EINTR) {
+            continue;
+        }
+        if (r <= 0) {
+            if (r == 0) {
+                errno = EPIPE;
+            }
+            return -1;
+        }
+        p += r;
+        left -= (size_t)r;
+    }
+    return 0;
+}
+
+
+// Reads n bytes.  Returns 0 on success, or -1 and errno is set.
+static int LJCLIENT_RecvAll(int fd, void *p, size_t n)
+{
+    ssize_t r;
+
+    while (n > 0) {
+        r = recv(fd, p, n, 0);
+        if (r < 0 && errno == EINTR) {
+            continue;
+        }
+        if (r <= 0) {
+            if (r == 0) {
+                errno = EPIPE;
+            }
+            return -1;
+        }
+        p = (BYTE *)p + r;
+        n -= (size_t)r;
+    }
+    return 0;
+}
+
+
+// Reads a message and up to maxData bytes of its data; the rest is
+// discarded.  Returns 0 on success, or -1 and errno is set.
+static int LJCLIENT_Recv(int fd, LJUSB_SharedMsg *msg, void *data, unsigned long maxData)
+{
+    BYTE discard[64];
+    unsigned long n, left;
+
+    if (LJCLIENT_RecvAll(fd, msg, sizeof(LJUSB_SharedMsg)) != 0) {
+        return -1;
+    }
+    n = (msg->size < maxData) ? msg->size : maxData;
+    if (n > 0 && LJCLIENT_RecvAll(fd, data, n) != 0) {
+        return -1;
+    }
+    for (left = msg->size - n; left > 0; left -= n) {
+        n = (left < sizeof(discard)) ? left : sizeof(discard);
+        if (LJCLIENT_RecvAll(fd, discard, n) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+
+// Sends a request on a connection of its own and reads the reply.  Returns 0
+// on success, or -1 and errno is set (to the status of the reply if the
+// daemon failed it).
+static int LJCLIENT_Request(LJUSB_SharedMsg *msg, LJUSB_SharedMsg *reply, void *data, unsigned long maxData)
+{
+    int fd, err;
+
+    fd = LJCLIENT_Connect();
+    if (fd < 0) {
+        return -1;
+    }
+    if (LJCLIENT_Send(fd, msg, NULL) != 0 || LJCLIENT_Recv(fd, reply, data, maxData) != 0) {
+        err = errno;
+        close(fd);
+        errno = err;
+        return -1;
+    }
+    close(fd);
+    if (reply->status != 0) {
+        errno = reply->status;
+        return -1;
+    }
+    return 0;
+}
+
+
+static void LJCLIENT_SleepMs(unsigned int ms)
+{
+    struct timespec ts;
+
+    ts.tv_sec = ms/1000;
+    ts.tv_nsec = (ms%1000)*1000000L;
+    nanosleep(&ts, NULL);
+}
+
+
+// Reads count bytes of StreamData packets from the stream ring of the
+// device, attaching to it on the first read of a stream.  Waits up to
+// timeout ms (0 for no limit) for them.  If they do not all arrive, returns
+// the ones that did if partial is true, or leaves them for the next read.
+// Returns the number of bytes, and errno is ETIMEDOUT if less than count.
+static unsigned long LJCLIENT_StreamRead(struct LJCLIENT_Device *dev, BYTE *pBuff, unsigned long count, unsigned int timeout, bool partial)
+{
+    LJUSB_StreamRingInfo info;
+    LJUSB_SharedMsg msg, reply;
+    char name[LJUSB_STREAM_RING_MAX_NAME + 1];
+    unsigned long long deadline = LJUSB_GetTimestampNs() + timeout*1000000ULL, now;
+    unsigned long packets;
+    unsigned int wait;
+    long avail, n;
+    bool asked = false;
+
+    pthread_mutex_lock(&dev->streamLock);
+    while (1) {
+        if (dev->reader == NULL) {
+            // The name of the ring of the stream running, if any.  The first
+            // read size asked for is the size the daemon reads the device in.
+            memset(&msg, 0, sizeof(msg));
+            msg.type = LJUSB_SHARED_MSG_STREAM;
+            msg.handle = dev->id;
+            msg.arg = count;
+            if (!asked && LJCLIENT_Request(&msg, &reply, name, sizeof(name)) == 0 && reply.size > 0) {
+                name[sizeof(name) - 1] = '\0';
+                dev->reader = LJUSB_StreamRingAttach(name, &info, 1);
+                dev->packetSize = (unsigned long)reply.arg;
+            }
+            asked = true;
+            if (dev->reader == NULL) {
+                // Not streaming, like a read of the stream endpoint of an
+                // idle device
+                pthread_mutex_unlock(&dev->streamLock);
+                if (timeout > 0) {
+                    LJCLIENT_SleepMs(timeout);
+                }
+                errno = ETIMEDOUT;
+                return 0;
+            }
+        }
+
+        packets = count/dev->packetSize;
+        if (packets == 0) {
+            pthread_mutex_unlock(&dev->streamLock);
+            errno = EINVAL;
+            return 0;
+        }
+
+        now = LJUSB_GetTimestampNs();
+        wait = (timeout == 0) ? 1000 : (now < deadline) ? (unsigned int)((deadline - now)/1000000ULL) : 0;
+        avail = LJUSB_StreamRingWait(dev->reader, packets, wait);
+        if (avail < 0) {
+            // The stream stopped: a new one may have started since
+            LJUSB_StreamRingDetach(dev->reader);
+            dev->reader = NULL;
+            continue;
+        }
+        if ((unsigned long)avail >= packets || (timeout > 0 && LJUSB_GetTimestampNs() >= deadline)) {
+            break;
+        }
+    }
+
+    n = 0;
+    if ((unsigned long)avail >= packets || partial) {
+        n = LJUSB_StreamRingRead(dev->reader, (unsigned short *)pBuff, packets, NULL);
+        if (n < 0) {
+            n = 0;
+        }
+    }
+    pthread_mutex_unlock(&dev->streamLock);
+
+    if ((unsigned long)n < packets) {
+        errno = ETIMEDOUT;
+    }
+    return (unsigned long)n*dev->packetSize;
+}
+
+
+int LJUSB_SharedGetStats(HANDLE hDevice, LJUSB_SharedStats *stats)
+{
+    struct LJCLIENT_Device *dev = LJCLIENT_GetDevice(hDevice);
+    double n;
+
+    if (dev == NULL) {
+        return -1;
+    }
+    if (stats == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    pthread_mutex_lock(&dev->lock);
+    memset(stats, 0, sizeof(LJUSB_SharedStats));
+    stats->commands = dev->commands;
+    if (dev->commands > 0) {
+        n = (double)dev->commands*1000;
+        stats->meanRoundTripUs = dev->roundTripNs/n;
+        stats->meanDeviceUs = dev->deviceNs/n;
+        stats->meanQueueUs = dev->queueNs/n;
+        stats->meanOverheadUs = dev->overheadNs/n;
+        stats->maxOverheadUs = dev->maxOverheadNs/1000.0;
+    }
+    pthread_mutex_unlock(&dev->lock);
+    return 0;
+}
+
+
+int LJUSB_SharedResetStats(HANDLE hDevice)
+{
+    struct LJCLIENT_Device *dev = LJCLIENT_GetDevice(hDevice);
+
+    if (dev == NULL) {
+        return -1;
+    }
+    pthread_mutex_lock(&dev->lock);
+    dev->commands = 0;
+    dev->roundTripNs = 0;
+    dev->deviceNs = 0;
+    dev->queueNs = 0;
+    dev->overheadNs = 0;
+    dev->maxOverheadNs = 0;
+    pthread_mutex_unlock(&dev->lock);
+    return 0;
+}
+
+
+float LJUSB_GetLibraryVersion(void)
+{
+    return LJUSB_LIBRARY_VERSION;
+}
+
+
+unsigned int LJUSB_GetDevCount(unsigned long ProductID)
+{
+    LJUSB_SharedMsg msg, reply;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.type = LJUSB_SHARED_MSG_COUNT;
+    msg.arg = ProductID;
+    if (LJCLIENT_Request(&msg, &reply, NULL, 0) != 0) {
+        return 0;
+    }
+    return (unsigned int)reply.arg;
+}
+
+
+unsigned int LJUSB_GetDevCounts(UINT *productCounts, UINT * productIds, UINT n)
+{
+    const UINT ids[3] = {U3_PRODUCT_ID, U6_PRODUCT_ID, UE9_PRODUCT_ID};
+    UINT i, total = 0;
+
+    for (i = 0; i < n; i++) {
+        productIds[i] = (i < 3) ? ids[i] : 0;
+        productCounts[i] = (i < 3) ? LJUSB_GetDevCount(ids[i]) : 0;
+        total += productCounts[i];
+    }
+    return total;
+}
+
+
+HANDLE LJUSB_OpenDevice(UINT DevNum, unsigned int dwReserved, unsigned long ProductID)
+{
+    struct LJCLIENT_Device *dev;
+    LJUSB_SharedMsg msg, reply;
+    int fd, err;
+
+    fd = LJCLIENT_Connect();
+    if (fd < 0) {
+        return NULL;
+    }
+
+    memset(&msg, 0, sizeof(msg));
+    msg.type = LJUSB_SHARED_MSG_OPEN;
+    msg.arg = ((uint64_t)ProductID << 32) | DevNum;
+    if (LJCLIENT_Send(fd, &msg, NULL) != 0 || LJCLIENT_Recv(fd, &reply, NULL, 0) != 0) {
+        err = errno;
+        close(fd);
+        errno = err;
+        return NULL;
+    }
+    if (reply.status != 0) {
+        close(fd);
+        errno = reply.status;
+        return NULL;
+    }
+
+    dev = (struct LJCLIENT_Device *)calloc(1, sizeof(struct LJCLIENT_Device));
+    if (dev == NULL) {
+        close(fd);
+        errno = ENOMEM;
+        return NULL;
+    }
+    dev->magic = LJCLIENT_MAGIC;
+    dev->fd = fd;
+    dev->id = reply.handle;
+    dev->productID = ProductID;
+    dev->releaseNumber = (unsigned short)reply.arg;
+    pthread_mutex_init(&dev->lock, NULL);
+    pthread_mutex_init(&dev->streamLock, NULL);
+    return (HANDLE)dev;
+}
+
+
+int LJUSB_OpenAllDevices(HANDLE* devHandles, UINT* productIds, UINT maxDevices)
+{
+    const UINT ids[3] = {U3_PRODUCT_ID, U6_PRODUCT_ID, UE9_PRODUCT_ID};
+    UINT i, d, count, n = 0;
+
+    for (i = 0; i < 3; i++) {
+        count = LJUSB_GetDevCount(ids[i]);
+        for (d = 1; d <= count && n < maxDevices; d++) {
+            devHandles[n] = LJUSB_OpenDevice(d, 0, ids[i]);
+            if (devHandles[n] != NULL) {
+                productIds[n++] = ids[i];
+            }
+        }
+    }
+    return (int)n;
+}
+
+
+int LJUSB_OpenAllDevicesOfProductId(UINT productId, HANDLE **devHandles)
+{
+    HANDLE handles[LJCLIENT_MAX_DEVICES];
+    UINT ids[LJCLIENT_MAX_DEVICES];
+    int i, n, count = 0;
+
+    n = LJUSB_OpenAllDevices(handles, ids, LJCLIENT_MAX_DEVICES);
+    *devHandles = (HANDLE *)malloc(sizeof(HANDLE)*LJCLIENT_MAX_DEVICES);
+    if (*devHandles == NULL) {
+        return -1;
+    }
+    for (i = 0; i < n; i++) {
+        if (productId == 0 || ids[i] == productId) {
+            (*devHandles)[count++] = handles[i];
+        }
+        else {
+            LJUSB_CloseDevice(handles[i]);
+        }
+    }
+    return count;
+}
+
+
+bool LJUSB_ResetConnection(HANDLE hDevice)
+{
+    return LJCLIENT_GetDevice(hDevice) != NULL;
+}
+
+
+unsigned long LJUSB_WriteTO(HANDLE hDevice, const BYTE *pBuff, unsigned long count, unsigned int timeout)
+{
+    struct LJCLIENT_Device *dev = LJCLIENT_GetDevice(hDevice);
+    LJUSB_SharedMsg msg;
+    unsigned long ret = count;
+
+    if (dev == NULL) {
+        return 0;
+    }
+    if (pBuff == NULL || count == 0 || count > LJUSB_SHARED_MAX_COMMAND) {
+        errno = EINVAL;
+        return 0;
+    }
+
+    memset(&msg, 0, sizeof(msg));
+    msg.type = LJUSB_SHARED_MSG_WRITE;
+    msg.handle = dev->id;
+    msg.size = (uint32_t)count;
+
+    pthread_mutex_lock(&dev->lock);
+    if (dev->pendingCount == LJUSB_SHARED_MAX_PENDING) {
+        // Responses not read yet fill the device
+        errno = ETIMEDOUT;
+        ret = 0;
+    }
+    else if (LJCLIENT_Send(dev->fd, &msg, pBuff) != 0) {
+        ret = 0;
+    }
+    else {
+        dev->writtenNs[(dev->pendingHead + dev->pendingCount) % LJUSB_SHARED_MAX_PENDING] = LJUSB_GetTimestampNs();
+        dev->pendingCount++;
+    }
+    pthread_mutex_unlock(&dev->lock);
+    return ret;
+}
+
+
+unsigned long LJUSB_ReadTO(HANDLE hDevice, BYTE *pBuff, unsigned long count, unsigned int timeout)
+{
+    struct LJCLIENT_Device *dev = LJCLIENT_GetDevice(hDevice);
+    BYTE resp[LJUSB_SHARED_MAX_RESPONSE];
+    LJUSB_SharedMsg msg;
+    struct pollfd pfd;
+    unsigned long long now, roundTripNs, overheadNs;
+    int r;
+
+    if (dev == NULL) {
+        return 0;
+    }
+    if (pBuff == NULL) {
+        errno = EINVAL;
+        return 0;
+    }
+
+    pthread_mutex_lock(&dev->lock);
+    r = (dev->pendingCount > 0);
+    pthread_mutex_unlock(&dev->lock);
+    if (!r) {
+        errno = ETIMEDOUT;
+        return 0;
+    }
+
+    pfd.fd = dev->fd;
+    pfd.events = POLLIN;
+    do {
+        r = poll(&pfd, 1, (timeout > 0) ? (int)timeout : -1);
+    } while (r < 0 && errno == EINTR);
+    if (r == 0) {
+        errno = ETIMEDOUT;
+        return 0;
+    }
+    if (r < 0 || LJCLIENT_Recv(dev->fd, &msg, resp, sizeof(resp)) != 0) {
+        return 0;
+    }
+    now = LJUSB_GetTimestampNs();
+
+    pthread_mutex_lock(&dev->lock);
+    roundTripNs = now - dev->writtenNs[dev->pendingHead];
+    dev->pendingHead = (dev->pendingHead + 1) % LJUSB_SHARED_MAX_PENDING;
+    dev->pendingCount--;
+    overheadNs = (roundTripNs > msg.deviceNs) ? roundTripNs - msg.deviceNs : 0;
+    dev->commands++;
+    dev->roundTripNs += roundTripNs;
+    dev->deviceNs += msg.deviceNs;
+    dev->queueNs += msg.queueNs;
+    dev->overheadNs += overheadNs;
+    if (overheadNs > dev->maxOverheadNs) {
+        dev->maxOverheadNs = overheadNs;
+    }
+    pthread_mutex_unlock(&dev->lock);
+
+    if (msg.status != 0) {
+        errno = msg.status;
+        return 0;
+    }
+    if (count > msg.size) {
+        count = msg.size;
+    }
+    memcpy(pBuff, resp, count);
+    return count;
+}
+
+
+unsigned long LJUSB_StreamTO(HANDLE hDevice, BYTE *pBuff, unsigned long count, unsigned int timeout)
+{
+    struct LJCLIENT_Device *dev = LJCLIENT_GetDevice(hDevice);
+
+    if (dev == NULL) {
+        return 0;
+    }
+    if (pBuff == NULL) {
+        errno = EINVAL;
+        return 0;
+    }
+    return LJCLIENT_StreamRead(dev, pBuff, count, timeout, true);
+}
+
+
+unsigned long LJUSB_StreamStampedTO(HANDLE hDevice, BYTE *pBuff, unsigned long count, unsigned int timeout, unsigned long long *pTimestampNs)
+{
+    unsigned long r;
+
+    r = LJUSB_StreamTO(hDevice, pBuff, count, timeout);
+    if (pTimestampNs != NULL) {
+        *pTimestampNs = LJUSB_GetTimestampNs();
+    }
+    return r;
+}
+
+
+unsigned long long LJUSB_GetTimestampNs(void)
+{
+    struct timespec ts;
+
+#ifdef CLOCK_MONOTONIC_RAW
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+#else
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#endif
+    return (unsigned long long)ts.tv_sec*1000000000ULL + ts.tv_nsec;
+}
+
+
+// Asynchronous reads of the stream ring.  A transfer completes once its
+// packets are in the ring; the packets are read into one buffer, so the
+// callback must be done with it before the next transfer completes.
+struct LJUSB_StreamAsync
+{
+    struct LJCLIENT_Device *dev;
+    unsigned long count;
+    unsigned int numTransfers;
+    unsigned int timeout;
+    unsigned long long submittedNs;     // Time the next transfer was submitted
+    LJUSB_StreamCallback callback;
+    void *userData;
+    BYTE *buffer;
+};
+
+
+LJUSB_StreamAsync *LJUSB_StreamAsyncStart(HANDLE hDevice, unsigned long count, unsigned int numTransfers, unsigned int timeout, LJUSB_StreamCallback callback, void *userData)
+{
+    struct LJCLIENT_Device *dev = LJCLIENT_GetDevice(hDevice);
+    LJUSB_StreamAsync *async;
+
+    if (dev == NULL) {
+        return NULL;
+    }
+    if (count == 0 || count > 65535 || numTransfers == 0 ||
+        numTransfers > LJUSB_STREAM_ASYNC_MAX_TRANSFERS || callback == NULL) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    async = (LJUSB_StreamAsync *)calloc(1, sizeof(LJUSB_StreamAsync));
+    if (async == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    async->buffer = (BYTE *)malloc(count);
+    if (async->buffer == NULL) {
+        free(async);
+        errno = ENOMEM;
+        return NULL;
+    }
+    async->dev = dev;
+    async->count = count;
+    async->numTransfers = numTransfers;
+    async->timeout = timeout;
+    async->callback = callback;
+    async->userData = userData;
+    async->submittedNs = LJUSB_GetTimestampNs();
+    return async;
+}
+
+
+int LJUSB_StreamAsyncHandleEvents(LJUSB_StreamAsync *async, unsigned int timeout)
+{
+    unsigned long long now, deadline, transferDeadline;
+    unsigned long size;
+    unsigned int wait;
+    int completed = 0;
+
+    if (async == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // Completes the transfers whose packets are in the ring, waiting up to
+    // timeout for the first one
+    now = LJUSB_GetTimestampNs();
+    deadline = now + timeout*1000000ULL;
+    while (completed < (int)async->numTransfers) {
+        transferDeadline = (async->timeout > 0) ? async->submittedNs + async->timeout*1000000ULL : (unsigned long long)-1;
+        if (completed > 0) {
+            wait = 0;
+        }
+        else {
+            now = LJUSB_GetTimestampNs();
+            wait = (deadline < transferDeadline) ? (unsigned int)(((deadline > now) ? deadline - now : 0)/1000000ULL) :
+                   (unsigned int)(((transferDeadline > now) ? transferDeadline - now : 0)/1000000ULL);
+            if (wait == 0) {
+                wait = 1;
+            }
+        }
+
+        size = LJCLIENT_StreamRead(async->dev, async->buffer, async->count, wait, false);
+        now = LJUSB_GetTimestampNs();
+        if (size == async->count) {
+            async->callback(async->buffer, size, now, 0, async->userData);
+        }
+        else if (now >= transferDeadline) {
+            // The transfer timed out with what it has
+            size = LJCLIENT_StreamRead(async->dev, async->buffer, async->count, 1, true);
+            async->callback(async->buffer, size, now, ETIMEDOUT, async->userData);
+        }
+        else {
+            break;
+        }
+        async->submittedNs = now;
+        completed++;
+    }
+    return completed;
+}
+
+
+void LJUSB_StreamAsyncStop(LJUSB_StreamAsync *async)
+{
+    if (async == NULL) {
+        return;
+    }
+    free(async->buffer);
+    free(async);
+}
+
+
+unsigned long LJUSB_Write(HANDLE hDevice, const BYTE *pBuff, unsigned long count)
+{
+    return LJUSB_WriteTO(hDevice, pBuff, count, 1000);
+}
+
+
+unsigned long LJUSB_Read(HANDLE hDevice, BYTE *pBuff, unsigned long count)
+{
+    return LJUSB_ReadTO(hDevice, pBuff, count, 1000);
+}
+
+
+unsigned long LJUSB_Stream(HANDLE hDevice, BYTE *pBuff, unsigned long count)
+{
+    return LJUSB_StreamTO(hDevice, pBuff, count, 1000);
+}
+
+
+void LJUSB_CloseDevice(HANDLE hDevice)
+{
+    struct LJCLIENT_Device *dev = LJCLIENT_GetDevice(hDevice);
+
+    if (dev == NULL) {
+        return;
+    }
+    // The daemon stops the stream of the device if this handle started it
+    close(dev->fd);
+    if (dev->reader != NULL) {
+        LJUSB_StreamRingDetach(dev->reader);
+    }
+    dev->magic = 0;
+    pthread_mutex_destroy(&dev->lock);
+    pthread_mutex_destroy(&dev->streamLock);
+    free(dev);
+}
+
+
+bool LJUSB_IsHandleValid(HANDLE hDevice)
+{
+    return LJCLIENT_GetDevice(hDevice) != NULL;
+}
+
+
+unsigned short LJUSB_GetDeviceDescriptorReleaseNumber(HANDLE hDevice)
+{
+    struct LJCLIENT_Device *dev = LJCLIENT_GetDevice(hDevice);
+
+    if (dev == NULL) {
+        return 0;
+    }
+    return dev->releaseNumber;
+}
+
+
+unsigned long LJUSB_GetHIDReportDescriptor(HANDLE hDevice, BYTE *pBuff, unsigned long count)
+{
+    errno = ENOTSUP;
+    return 0;
+}
+
+
+unsigned long LJUSB_BulkRead(HANDLE hDevice, unsigned char endpoint, BYTE *pBuff, unsigned long count)
+{
+    struct LJCLIENT_Device *dev = LJCLIENT_GetDevice(hDevice);
+
+    if (dev == NULL) {
+        return 0;
+    }
+    if ((dev->productID == UE9_PRODUCT_ID) ? (endpoint == UE9_PIPE_EP2_IN) : (endpoint == U3_PIPE_EP3_IN)) {
+        return LJUSB_Stream(hDevice, pBuff, count);
+    }
+    return LJUSB_Read(hDevice, pBuff, count);
+}
+
+
+unsigned long LJUSB_BulkWrite(HANDLE hDevice, unsigned char endpoint, BYTE *pBuff, unsigned long count)
+{
+    return LJUSB_Write(hDevice, pBuff, count);
+}
+
+
+bool LJUSB_AbortPipe(HANDLE hDevice, unsigned long Pipe)
+{
+    errno = ENOTSUP;
+    return false;
+}
@@ -0,0 +1,1729 @@
+//---------------------------------------------------------------------------
+//
+//  labjackusb_sim.c
+//
+//    Simulated U3, U6 and UE9 devices behind the labjackusb.h functions, for
+//    running the examples and benchmarks without hardware (make sim).  The
+//    simulated devices answer the low-level commands used by the example
+//    helpers with fixed latencies, so results are repeatable.  Streams are
+//    simulated in host time:  scans are added to the device buffer at the
+//    configured scan rate, and scans taken while the buffer is full are
+//    dropped and reported like the devices do (U3/U6 auto-recovery, UE9
+//    overflow bit).
+//
+//    Environment variables:
+//      LJSIM_DEVICES     Comma separated list of devices, for example
+//                        "U3,U6,U6,UE9".  Default is "U3,U6,UE9".
+//      LJSIM_LATENCY_US  USB round trip time of a command in microseconds,
+//                        added to the time the device takes to run it.
+//                        Default is 0.
+//
+//  support@labjack.com
+//
+//  SPDX-FileCopyrightText: Copyright (c) 2009 LabJack Corporation
+//  SPDX-License-Identifier: X11
+//
+//---------------------------------------------------------------------------
+//
+
+#include "labjackusb.h"
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+
+#define LJSIM_MAX_DEVICES        16
+#define LJSIM_MAX_PENDING        32    // Responses queued on one device
+#define LJSIM_MAX_PACKET         256   // Largest command or response
+
+#define LJSIM_ERROR_INVALID_COMMAND  1   // Errorcode of unsupported commands and IOTypes
+#define LJSIM_ERROR_BUFFER_OVERFLOW  2   // Errorcode of Feedback responses that do not fit
+#define LJSIM_ERROR_STREAM_ACTIVE        48
+#define LJSIM_ERROR_STREAM_CONFIG        50
+#define LJSIM_ERROR_STREAM_NOT_RUNNING   52
+#define LJSIM_ERROR_AUTORECOVERY_ACTIVE  59
+#define LJSIM_ERROR_AUTORECOVERY_END     60
+
+#define LJSIM_U3U6_MAX_PACKET    64
+#define LJSIM_U3_CAL_BLOCKS      5
+#define LJSIM_U6_CAL_BLOCKS      10
+#define LJSIM_UE9_CAL_BLOCKS     5
+
+#define LJSIM_U3U6_STREAM_BUFFER 984   // Samples in the stream buffer
+#define LJSIM_UE9_STREAM_BUFFER  4096
+#define LJSIM_STREAM_PACKET_NS   50000 // USB time of the last response of a read
+#define LJSIM_MAX_STREAM_GAPS    64    // Overflows not yet sent to the host
+
+struct LJSIM_StreamGap
+{
+    unsigned long long sample;      // Stored sample the gap comes before
+    unsigned long long dropped;     // Scans dropped
+};
+
+struct LJSIM_Response
+{
+    BYTE data[LJSIM_MAX_PACKET];
+    unsigned long size;
+    unsigned long long readyNs;     // Time the response can be read
+};
+
+struct LJSIM_Device
+{
+    unsigned long productID;
+    unsigned int serialNumber;
+    bool isOpen;
+    pthread_mutex_t lock;
+    unsigned long long openNs;
+
+    struct LJSIM_Response pending[LJSIM_MAX_PENDING];
+    unsigned int pendingHead;
+    unsigned int pendingCount;
+    unsigned long long busyUntilNs; // Time the device finishes its last command
+
+    // ConfigIO and ConfigTimerClock settings
+    BYTE timerCounterConfig;
+    BYTE dac1Enable;
+    BYTE fioAnalog;
+    BYTE eioAnalog;
+    BYTE timerClockConfig;
+    BYTE timerClockDivisor;
+
+    // Digital I/O, one bit per line (FIO0-7, EIO0-7, CIO0-3, MIO0-2)
+    unsigned int dioDir;
+    unsigned int dioState;
+
+    unsigned short dac[2];
+    unsigned int timer[6];
+    unsigned int counterBase[2];
+    unsigned int noise;
+
+    // LJTDAC on the I2C lines: EEPROM (address 0xA0) and DAC (address 0x24)
+    BYTE tdacEeprom[128];
+    BYTE tdacEepromPointer;
+    unsigned short tdacDac[2];
+
+    // Stream.  Scans are stored in the stream buffer when they complete and
+    // dropped when it is full.  Responses leave the buffer when the host
+    // reads them, or as soon as they are complete while a read is pending.
+    bool streamConfigured;
+    bool streaming;
+    unsigned int streamNumChannels;
+    unsigned int streamSamplesPerPacket;
+    unsigned int streamPacketSize;          // Bytes read for each response
+    unsigned int streamBufferSize;          // Samples the stream buffer holds
+    double streamScanPeriodNs;
+    unsigned long long streamStartNs;
+    unsigned long long streamScans;         // Scans stored or dropped
+    unsigned long long streamStored;        // Samples stored
+    unsigned long long streamSent;          // Responses sent
+    unsigned long long streamDroppedSent;   // Scans dropped before the next sample sent
+    unsigned int streamBuffered;            // Samples in the stream buffer
+    unsigned long long streamDropRun;       // Scans dropped in the current overflow
+    struct LJSIM_StreamGap streamGaps[LJSIM_MAX_STREAM_GAPS];
+    unsigned int streamGapHead;
+    unsigned int streamGapCount;
+};
+
+static struct LJSIM_Device gDevices[LJSIM_MAX_DEVICES];
+static unsigned int gNumDevices = 0;
+static unsigned long long gLatencyNs = 0;
+static pthread_once_t gInitOnce = PTHREAD_ONCE_INIT;
+
+
+// Nominal calibration constants stored in the calibration memory of the
+// simulated devices
+static const double LJSIM_U3_CAL[20] = {
+    0.000037231, 0.0, 0.000074463, -2.44, 51.717, 0.0, 51.717, 0.0,
+    0.013021, 2.44, 3.66, 3.3, 0.000314, 0.000314, 0.000314, 0.000314,
+    -10.3, -10.3, -10.3, -10.3
+};
+
+static const double LJSIM_U6_CAL[40] = {
+    0.00031580578, -10.5869565220, 0.000031580578, -1.05869565220,
+    0.0000031580578, -0.105869565220, 0.00000031580578, -0.0105869565220,
+    -.000315805800, 33523.0, -.0000315805800, 33523.0,
+    -.00000315805800, 33523.0, -.000000315805800, 33523.0,
+    13200.0, 0.0, 13200.0, 0.0, 0.00001, 0.0002, -92.379, 465.129,
+    0.00031580578, -10.5869565220, 0.000031580578, -1.05869565220,
+    0.0000031580578, -0.105869565220, 0.00000031580578, -0.0105869565220,
+    -.000315805800, 33523.0, -.0000315805800, 33523.0,
+    -.00000315805800, 33523.0, -.000000315805800, 33523.0
+};
+
+// UE9 constants by calibration memory block.  Block 2 constants 5 and 7 are
+// reserved.
+static const double LJSIM_UE9_CAL[5][16] = {
+    { 0.000077503, -0.012, 0.000038736, -0.012, 0.000019353, -0.012,
+      0.0000096764, -0.012 },
+    { 0.00015629, -5.176 },
+    { 842.59, 0.0, 842.259, 0.0, 0.012968, 0.0, 0.012968, 0.0, 298.15, 2.43,
+      0.0, 1.215, 0.00009272 },
+    { 0.000077503, -0.012 },
+    { 0.00015629, -5.176 }
+};
+
+// Nominal LJTDAC calibration constants (DACA slope and offset, DACB slope and
+// offset) stored at EEPROM address 64
+static const double LJSIM_TDAC_CAL[4] = {
+    3158.6, 32624.0, 3158.6, 32624.0
+};
+
+// Approximate AIN conversion times in microseconds, by U6 ResolutionIndex
+// (1-12)
+static const unsigned int LJSIM_U6_AIN_US[13] = {
+    40, 40, 40, 60, 90, 160, 300, 570, 1110, 3200, 6300, 12500, 25000
+};
+#define LJSIM_U3_AIN_US              120
+#define LJSIM_U3_AIN_QUICKSAMPLE_US  30
+
+// Approximate UE9 AIN conversion times in microseconds, by Resolution (12-18)
+static const unsigned int LJSIM_UE9_AIN_US[7] = {
+    25, 40, 70, 130, 250, 500, 1200
+};
+
+
+static void LJSIM_FPDoubleToBytes(double value, BYTE *b);
+
+
+// Device time runs on the clock of LJUSB_GetTimestampNs, so stream
+// timestamps and simulated scan times can be compared.
+static unsigned long long LJSIM_Now(void)
+{
+    return LJUSB_GetTimestampNs();
+}
+
+
+static void LJSIM_SleepUntil(unsigned long long ns)
+{
+    struct timespec ts;
+    unsigned long long now;
+
+    // CLOCK_MONOTONIC_RAW has no absolute sleeps
+    while ((now = LJSIM_Now()) < ns) {
+        ts.tv_sec = (ns - now)/1000000000ULL;
+        ts.tv_nsec = (ns - now)%1000000000ULL;
+        nanosleep(&ts, NULL);
+    }
+}
+
+
+static void LJSIM_AddDevice(unsigned long productID)
+{
+    struct LJSIM_Device *dev;
+    unsigned int n = 0, i;
+
+    if (gNumDevices >= LJSIM_MAX_DEVICES) {
+        return;
+    }
+
+    for (i = 0; i < gNumDevices; i++) {
+        if (gDevices[i].productID == productID) {
+            n++;
+        }
+    }
+
+    dev = &gDevices[gNumDevices++];
+    memset(dev, 0, sizeof(struct LJSIM_Device));
+    dev->productID = productID;
+    switch (productID) {
+    case U3_PRODUCT_ID:
+        dev->serialNumber = 320000001 + n;
+        break;
+    case U6_PRODUCT_ID:
+        dev->serialNumber = 360000001 + n;
+        break;
+    default:
+        dev->serialNumber = 0x10000000 + 1 + n;
+        break;
+    }
+    for (i = 0; i < 4; i++) {
+        LJSIM_FPDoubleToBytes(LJSIM_TDAC_CAL[i], dev->tdacEeprom + 64 + i*8);
+    }
+    dev->tdacEeprom[96] = (BYTE)((dev->serialNumber + 1000) & 0xFF);
+    dev->tdacEeprom[97] = (BYTE)(((dev->serialNumber + 1000) >> 8) & 0xFF);
+    dev->tdacEeprom[98] = (BYTE)(((dev->serialNumber + 1000) >> 16) & 0xFF);
+    dev->tdacEeprom[99] = (BYTE)(((dev->serialNumber + 1000) >> 24) & 0xFF);
+    pthread_mutex_init(&dev->lock, NULL);
+}
+
+
+static void LJSIM_Init(void)
+{
+    const char *s;
+    char list[256], *tok, *save = NULL;
+
+    s = getenv("LJSIM_LATENCY_US");
+    if (s != NULL) {
+        gLatencyNs = strtoull(s, NULL, 10)*1000ULL;
+    }
+
+    s = getenv("LJSIM_DEVICES");
+    if (s == NULL) {
+        s = "U3,U6,UE9";
+    }
+    strncpy(list, s, sizeof(list) - 1);
+    list[sizeof(list) - 1] = 0;
+
+    for (tok = strtok_r(list, ",", &save); tok != NULL; tok = strtok_r(NULL, ",", &save)) {
+        if (strcmp(tok, "U3") == 0) {
+            LJSIM_AddDevice(U3_PRODUCT_ID);
+        }
+        else if (strcmp(tok, "U6") == 0) {
+            LJSIM_AddDevice(U6_PRODUCT_ID);
+        }
+        else if (strcmp(tok, "UE9") == 0) {
+            LJSIM_AddDevice(UE9_PRODUCT_ID);
+        }
+        else {
+            fprintf(stderr, "LJSIM_DEVICES: unknown device %s\n", tok);
+        }
+    }
+}
+
+
+static struct LJSIM_Device *LJSIM_GetDevice(HANDLE hDevice)
+{
+    struct LJSIM_Device *dev = (struct LJSIM_Device *)hDevice;
+
+    if (dev == NULL || dev < gDevices || dev >= gDevices + gNumDevices || !dev->isOpen) {
+        errno = EINVAL;
+        return NULL;
+    }
+    return dev;
+}
+
+
+static void LJSIM_Checksum(BYTE *b, unsigned int n, bool extended)
+{
+    unsigned int i, a = 0, bb;
+
+    if (extended) {
+        for (i = 6; i < n; i++) {
+            a += b[i];
+        }
+        b[4] = (BYTE)(a & 0xFF);
+        b[5] = (BYTE)((a >> 8) & 0xFF);
+        n = 6;
+        a = 0;
+    }
+
+    for (i = 1; i < n; i++) {
+        a += b[i];
+    }
+    bb = a/256;
+    a = (a - 256*bb) + bb;
+    bb = a/256;
+    b[0] = (BYTE)((a - 256*bb) + bb);
+}
+
+
+// Returns true if the normal or extended checksums of a command are correct
+static bool LJSIM_ChecksumValid(const BYTE *b, unsigned long n, bool extended)
+{
+    BYTE tmp[LJSIM_MAX_PACKET];
+
+    if (n < 6 || n > LJSIM_MAX_PACKET) {
+        return false;
+    }
+    memcpy(tmp, b, n);
+    LJSIM_Checksum(tmp, (unsigned int)n, extended);
+    return tmp[0] == b[0] && (!extended || (tmp[4] == b[4] && tmp[5] == b[5]));
+}
+
+
+// Simulated analog input of a channel in the range -1 to 1: a slow sine per
+// channel plus a few LSBs of noise
+static double LJSIM_Signal(struct LJSIM_Device *dev, unsigned int channel, double t)
+{
+    dev->noise = dev->noise*1103515245u + 12345u;
+    return 0.5*sin(2*M_PI*(channel + 1)*0.1*t) + ((int)((dev->noise >> 16) & 7) - 3)/65536.0;
+}
+
+
+static void LJSIM_FPDoubleToBytes(double value, BYTE *b)
+{
+    long long fixed = (long long)floor(value*4294967296.0 + 0.5);
+    int i;
+
+    for (i = 0; i < 8; i++) {
+        b[i] = (BYTE)((unsigned long long)fixed >> (8*i));
+    }
+}
+
+
+static unsigned long LJSIM_ReadMem(struct LJSIM_Device *dev, const BYTE *cmd, BYTE *resp)
+{
+    unsigned int block, i, n, dataSize;
+
+    if (dev->productID == UE9_PRODUCT_ID) {
+        dataSize = 128;
+        n = LJSIM_UE9_CAL_BLOCKS;
+        resp[2] = (BYTE)(0x41);
+        block = cmd[7];
+    }
+    else {
+        dataSize = 32;
+        n = (dev->productID == U3_PRODUCT_ID) ? LJSIM_U3_CAL_BLOCKS : LJSIM_U6_CAL_BLOCKS;
+        resp[2] = (BYTE)(0x11);
+        block = cmd[7];
+    }
+
+    resp[1] = (BYTE)(0xF8);
+    resp[3] = cmd[3];
+    resp[7] = (BYTE)block;
+    memset(resp + 8, 0, dataSize);
+
+    if (block >= n) {
+        resp[6] = LJSIM_ERROR_INVALID_COMMAND;
+    }
+    else if (dev->productID == UE9_PRODUCT_ID) {
+        for (i = 0; i < 16; i++) {
+            LJSIM_FPDoubleToBytes(LJSIM_UE9_CAL[block][i], resp + 8 + i*8);
+        }
+    }
+    else if (dev->productID == U3_PRODUCT_ID) {
+        for (i = 0; i < 4; i++) {
+            LJSIM_FPDoubleToBytes(LJSIM_U3_CAL[block*4 + i], resp + 8 + i*8);
+        }
+    }
+    else {
+        for (i = 0; i < 4; i++) {
+            LJSIM_FPDoubleToBytes(LJSIM_U6_CAL[block*4 + i], resp + 8 + i*8);
+        }
+    }
+
+    return 8 + dataSize;
+}
+
+
+static unsigned long LJSIM_ConfigU3U6(struct LJSIM_Device *dev, BYTE *resp)
+{
+    resp[1] = (BYTE)(0xF8);
+    resp[2] = (BYTE)(0x10);
+    resp[3] = (BYTE)(0x08);
+    resp[9] = 0;            // Firmware version
+    resp[10] = 1;
+    resp[11] = 0;           // Bootloader version
+    resp[12] = 1;
+    resp[15] = (BYTE)(dev->serialNumber & 0xFF);
+    resp[16] = (BYTE)((dev->serialNumber >> 8) & 0xFF);
+    resp[17] = (BYTE)((dev->serialNumber >> 16) & 0xFF);
+    resp[18] = (BYTE)((dev->serialNumber >> 24) & 0xFF);
+    resp[19] = (BYTE)(dev->productID);
+    resp[21] = 1;           // LocalID
+
+    if (dev->productID == U3_PRODUCT_ID) {
+        resp[10] = 1;       // Firmware 1.46, hardware 1.30, U3-LV
+        resp[9] = 46;
+        resp[13] = 30;
+        resp[14] = 1;
+        resp[23] = dev->fioAnalog;
+        resp[26] = dev->eioAnalog;
+        resp[37] = 2;
+    }
+    else {
+        resp[10] = 1;       // Firmware 1.43, hardware 2.00, U6-Pro
+        resp[9] = 43;
+        resp[13] = 0;
+        resp[14] = 2;
+        resp[37] = 12;
+    }
+
+    return 38;
+}
+
+
+static unsigned long LJSIM_ConfigIO(struct LJSIM_Device *dev, const BYTE *cmd, BYTE *resp)
+{
+    BYTE writeMask = cmd[6];
+    unsigned long size = (dev->productID == U3_PRODUCT_ID) ? 12 : 16;
+
+    if (writeMask & 1) {
+        dev->timerCounterConfig = cmd[8];
+    }
+    if (dev->productID == U3_PRODUCT_ID) {
+        if (writeMask & 2) {
+            dev->dac1Enable = cmd[9];
+        }
+        if (writeMask & 4) {
+            dev->fioAnalog = cmd[10];
+        }
+        if (writeMask & 8) {
+            dev->eioAnalog = cmd[11];
+        }
+    }
+    else if (writeMask & 1) {
+        // U6 NumberTimersEnabled, CounterEnable and TimerCounterPinOffset
+        dev->timerCounterConfig = cmd[8] | (cmd[9] << 3) | (cmd[10] << 5);
+    }
+
+    resp[1] = (BYTE)(0xF8);
+    resp[2] = (BYTE)((size - 6)/2);
+    resp[3] = (BYTE)(0x0B);
+    if (dev->productID == U3_PRODUCT_ID) {
+        resp[8] = dev->timerCounterConfig;
+        resp[9] = dev->dac1Enable;
+        resp[10] = dev->fioAnalog;
+        resp[11] = dev->eioAnalog;
+    }
+    else {
+        resp[8] = dev->timerCounterConfig & 7;
+        resp[9] = (dev->timerCounterConfig >> 3) & 3;
+        resp[10] = dev->timerCounterConfig >> 5;
+    }
+
+    return size;
+}
+
+
+static unsigned long LJSIM_ConfigTimerClock(struct LJSIM_Device *dev, const BYTE *cmd, BYTE *resp)
+{
+    if (cmd[8] & 128) {
+        dev->timerClockConfig = cmd[8] & 0x7F;
+        dev->timerClockDivisor = cmd[9];
+    }
+
+    resp[1] = (BYTE)(0xF8);
+    resp[2] = (BYTE)(0x02);
+    resp[3] = (BYTE)(0x0A);
+    resp[8] = dev->timerClockConfig;
+    resp[9] = dev->timerClockDivisor;
+
+    return 10;
+}
+
+
+static unsigned int LJSIM_PortBits(const BYTE *b)
+{
+    return b[0] | (b[1] << 8) | (b[2] << 16);
+}
+
+
+static void LJSIM_Put32(BYTE *b, unsigned int value)
+{
+    b[0] = (BYTE)(value & 0xFF);
+    b[1] = (BYTE)((value >> 8) & 0xFF);
+    b[2] = (BYTE)((value >> 16) & 0xFF);
+    b[3] = (BYTE)((value >> 24) & 0xFF);
+}
+
+
+// Runs one U3/U6 Feedback IOType.  Returns the number of command bytes used,
+// or 0 if the IOType is not supported.  The response data is written to out
+// and its size to outSize, and the time the IOType takes is added to timeUs.
+static unsigned int LJSIM_FeedbackIOType(struct LJSIM_Device *dev, const BYTE *in, unsigned int inSize, BYTE *out, unsigned int *outSize, unsigned long long *timeUs)
+{
+    unsigned int bit, mask, value, res;
+    double t = (LJSIM_Now() - dev->openNs)/1e9;
+    double v;
+    bool isU3 = (dev->productID == U3_PRODUCT_ID);
+
+    *outSize = 0;
+    switch (in[0]) {
+    case 1:     // AIN (U3)
+        if (!isU3 || inSize < 3) {
+            return 0;
+        }
+        v = LJSIM_Signal(dev, in[1] & 31, t);
+        value = (unsigned int)(32768 + v*32000);
+        out[0] = (BYTE)(value & 0xF0);  // 12-bit resolution
+        out[1] = (BYTE)(value >> 8);
+        *outSize = 2;
+        *timeUs += (in[1] & 128) ? LJSIM_U3_AIN_QUICKSAMPLE_US : LJSIM_U3_AIN_US;
+        return 3;
+    case 2:     // AIN24 (U6)
+    case 3:     // AIN24AR (U6)
+        if (isU3 || inSize < 4) {
+            return 0;
+        }
+        v = LJSIM_Signal(dev, in[1], t);
+        value = (unsigned int)(8388608 + v*8000000);
+        out[0] = (BYTE)(value & 0xFF);
+        out[1] = (BYTE)((value >> 8) & 0xFF);
+        out[2] = (BYTE)((value >> 16) & 0xFF);
+        res = in[2] & 15;
+        *timeUs += LJSIM_U6_AIN_US[(res == 0 || res > 12) ? 8 : res];
+        if (in[0] == 2) {
+            *outSize = 3;
+        }
+        else {
+            out[3] = (BYTE)(in[2] >> 4);    // GainIndex
+            out[4] = 0;                     // Status
+            *outSize = 5;
+        }
+        return 4;
+    case 5:     // WaitShort
+        *timeUs += in[1]*(isU3 ? 128 : 64);
+        return 2;
+    case 6:     // WaitLong
+        *timeUs += in[1]*(isU3 ? 32768 : 16384);
+        return 2;
+    case 9:     // LED
+        return 2;
+    case 10:    // BitStateRead
+        out[0] = (dev->dioState >> (in[1] & 31)) & 1;
+        *outSize = 1;
+        return 2;
+    case 11:    // BitStateWrite
+        bit = 1u << (in[1] & 31);
+        dev->dioState = (in[1] & 128) ? (dev->dioState | bit) : (dev->dioState & ~bit);
+        return 2;
+    case 12:    // BitDirRead
+        out[0] = (dev->dioDir >> (in[1] & 31)) & 1;
+        *outSize = 1;
+        return 2;
+    case 13:    // BitDirWrite
+        bit = 1u << (in[1] & 31);
+        dev->dioDir = (in[1] & 128) ? (dev->dioDir | bit) : (dev->dioDir & ~bit);
+        return 2;
+    case 26:    // PortStateRead
+        out[0] = (BYTE)(dev->dioState & 0xFF);
+        out[1] = (BYTE)((dev->dioState >> 8) & 0xFF);
+        out[2] = (BYTE)((dev->dioState >> 16) & 0xFF);
+        *outSize = 3;
+        return 1;
+    case 27:    // PortStateWrite
+    case 29:    // PortDirWrite
+        if (inSize < 7) {
+            return 0;
+        }
+        mask = LJSIM_PortBits(in + 1);
+        value = LJSIM_PortBits(in + 4);
+        if (in[0] == 27) {
+            dev->dioState = (dev->dioState & ~mask) | (value & mask);
+        }
+        else {
+            dev->dioDir = (dev->dioDir & ~mask) | (value & mask);
+        }
+        return 7;
+    case 28:    // PortDirRead
+        out[0] = (BYTE)(dev->dioDir & 0xFF);
+        out[1] = (BYTE)((dev->dioDir >> 8) & 0xFF);
+        out[2] = (BYTE)((dev->dioDir >> 16) & 0xFF);
+        *outSize = 3;
+        return 1;
+    case 34:    // DAC0 (8-bit)
+    case 35:    // DAC1 (8-bit)
+        dev->dac[in[0] - 34] = (unsigned short)(in[1] << 8);
+        return 2;
+    case 38:    // DAC0 (16-bit)
+    case 39:    // DAC1 (16-bit)
+        if (inSize < 3) {
+            return 0;
+        }
+        dev->dac[in[0] - 38] = (unsigned short)(in[1] | (in[2] << 8));
+        return 3;
+    case 42: case 44: case 46: case 48:    // Timer0-3
+        if (inSize < 4 || (isU3 && in[0] > 44)) {
+            return 0;
+        }
+        LJSIM_Put32(out, dev->timer[(in[0] - 42)/2]);
+        if (in[1] & 1) {
+            dev->timer[(in[0] - 42)/2] = in[2] | (in[3] << 8);
+        }
+        *outSize = 4;
+        return 4;
+    case 43: case 45: case 47: case 49:    // Timer0-3Config
+        if (inSize < 4 || (isU3 && in[0] > 45)) {
+            return 0;
+        }
+        dev->timer[(in[0] - 43)/2] = in[2] | (in[3] << 8);
+        return 4;
+    case 54:    // Counter0
+    case 55:    // Counter1
+        // Counters count at 1 kHz since the device was opened
+        value = (unsigned int)(t*1000);
+        LJSIM_Put32(out, value - dev->counterBase[in[0] - 54]);
+        if (in[1] & 1) {
+            dev->counterBase[in[0] - 54] = value;
+        }
+        *outSize = 4;
+        return 2;
+    default:
+        return 0;
+    }
+}
+
+
+static unsigned long LJSIM_Feedback(struct LJSIM_Device *dev, const BYTE *cmd, unsigned long cmdSize, BYTE *resp, unsigned long long *timeUs)
+{
+    unsigned int in = 7, out = 9, used, outSize, frame = 0;
+    BYTE data[LJSIM_MAX_PACKET];
+
+    resp[1] = (BYTE)(0xF8);
+    resp[3] = (BYTE)(0x00);
+    resp[8] = cmd[6];   // Echo
+
+    while (in < cmdSize && cmd[in] != 0) {
+        used = LJSIM_FeedbackIOType(dev, cmd + in, (unsigned int)(cmdSize - in), data, &outSize, timeUs);
+        if (used == 0) {
+            resp[6] = LJSIM_ERROR_INVALID_COMMAND;
+            resp[7] = (BYTE)frame;
+            break;
+        }
+        if (out + outSize > LJSIM_U3U6_MAX_PACKET) {
+            resp[6] = LJSIM_ERROR_BUFFER_OVERFLOW;
+            resp[7] = (BYTE)frame;
+            break;
+        }
+        memcpy(resp + out, data, outSize);
+        out += outSize;
+        in += used;
+        frame++;
+    }
+
+    if (out%2 != 0) {
+        resp[out++] = 0;
+    }
+    resp[2] = (BYTE)((out - 6)/2);
+
+    return out;
+}
+
+
+static unsigned int LJSIM_UE9AinTimeUs(BYTE resolution)
+{
+    if (resolution < 12) {
+        resolution = 12;
+    }
+    else if (resolution > 18) {
+        resolution = 18;
+    }
+    return LJSIM_UE9_AIN_US[resolution - 12];
+}
+
+
+// UE9 analog input reading, 16-bit justified
+static unsigned short LJSIM_UE9AinBits(struct LJSIM_Device *dev, unsigned int channel)
+{
+    double v = LJSIM_Signal(dev, channel, (LJSIM_Now() - dev->openNs)/1e9);
+
+    return (unsigned short)(32768 + v*32000);
+}
+
+
+// Sets the direction and output state bits of one UE9 digital port from a
+// Feedback mask, direction and state
+static void LJSIM_UE9SetPort(struct LJSIM_Device *dev, unsigned int shift, BYTE mask, BYTE dir, BYTE state)
+{
+    unsigned int m = (unsigned int)mask << shift;
+
+    dev->dioDir = (dev->dioDir & ~m) | (((unsigned int)dir << shift) & m);
+
+    // The states of inputs are not written
+    m &= (unsigned int)dir << shift;
+    dev->dioState = (dev->dioState & ~m) | (((unsigned int)state << shift) & m);
+}
+
+
+static unsigned long LJSIM_UE9Feedback(struct LJSIM_Device *dev, const BYTE *cmd, BYTE *resp, unsigned long long *timeUs)
+{
+    unsigned int i, channel, mask;
+    unsigned short bits;
+
+    LJSIM_UE9SetPort(dev, 0, cmd[6], cmd[7], cmd[8]);
+    LJSIM_UE9SetPort(dev, 8, cmd[9], cmd[10], cmd[11]);
+    LJSIM_UE9SetPort(dev, 16, cmd[12] & 15, cmd[13] >> 4, cmd[13] & 15);
+    LJSIM_UE9SetPort(dev, 20, cmd[14] & 7, cmd[15] >> 4, cmd[15] & 7);
+
+    resp[1] = (BYTE)(0xF8);
+    resp[2] = (BYTE)(0x1D);
+    resp[3] = (BYTE)(0x00);
+    resp[6] = (BYTE)(dev->dioDir & 0xFF);
+    resp[7] = (BYTE)(dev->dioState & 0xFF);
+    resp[8] = (BYTE)((dev->dioDir >> 8) & 0xFF);
+    resp[9] = (BYTE)((dev->dioState >> 8) & 0xFF);
+    resp[10] = (BYTE)((((dev->dioDir >> 16) & 15) << 4) | ((dev->dioState >> 16) & 15));
+    resp[11] = (BYTE)((((dev->dioDir >> 20) & 7) << 4) | ((dev->dioState >> 20) & 7));
+
+    mask = cmd[20] | (cmd[21] << 8);
+    for (i = 0; i < 16; i++) {
+        if (!(mask & (1u << i))) {
+            continue;
+        }
+        channel = (i < 14) ? i : cmd[22 + i - 14];
+        bits = LJSIM_UE9AinBits(dev, channel);
+        resp[12 + i*2] = (BYTE)(bits & 0xFF);
+        resp[13 + i*2] = (BYTE)(bits >> 8);
+        *timeUs += LJSIM_UE9AinTimeUs(cmd[24]) + cmd[25]*5;
+    }
+
+    return 64;
+}
+
+
+// UE9 SingleIO command.  The response uses the normal checksum.
+static unsigned long LJSIM_UE9SingleIO(struct LJSIM_Device *dev, const BYTE *cmd, BYTE *resp, unsigned long long *timeUs)
+{
+    unsigned short bits;
+    unsigned int bit;
+
+    resp[1] = (BYTE)(0xA3);
+    resp[2] = cmd[2];
+    resp[3] = cmd[3];
+    switch (cmd[2]) {
+    case 1:     // Digital bit read
+    case 2:     // Digital bit write
+        bit = 1u << (cmd[3] % 23);
+        if (cmd[2] == 2) {
+            dev->dioDir = (cmd[4] & 1) ? (dev->dioDir | bit) : (dev->dioDir & ~bit);
+            dev->dioState = (cmd[5] & 1) ? (dev->dioState | bit) : (dev->dioState & ~bit);
+        }
+        resp[4] = (dev->dioDir & bit) ? 1 : 0;
+        resp[5] = (dev->dioState & bit) ? 1 : 0;
+        break;
+    case 4:     // Analog input
+        bits = LJSIM_UE9AinBits(dev, cmd[3]);
+        resp[4] = cmd[4];
+        resp[5] = (BYTE)(bits & 0xFF);
+        resp[6] = (BYTE)(bits >> 8);
+        *timeUs += LJSIM_UE9AinTimeUs(cmd[5]) + cmd[6]*5;
+        break;
+    case 5:     // Analog output
+        if (cmd[3] < 2) {
+            dev->dac[cmd[3]] = (unsigned short)(cmd[4] | ((cmd[5] & 15) << 8));
+        }
+        break;
+    }
+
+    return 8;
+}
+
+
+// I2C command with an LJTDAC on any pair of lines.  Sending to the EEPROM sets
+// its address pointer and writes the following bytes, and receiving reads from
+// the pointer.  The DAC takes 3 byte writes (48 = DACA or 49 = DACB, MSB, LSB).
+// Other addresses are not acked.
+static unsigned long LJSIM_I2C(struct LJSIM_Device *dev, const BYTE *cmd, unsigned long cmdSize, BYTE *resp, unsigned long long *timeUs)
+{
+    unsigned int numSend = cmd[12], numReceive = cmd[13], i, ack = 0, size;
+    const BYTE *data = cmd + 14;
+    BYTE address = cmd[10] & 0xFE;
+
+    // The UE9 takes I2C commands and responses larger than 64 bytes
+    size = 12 + numReceive + (numReceive & 1);
+    if (14 + numSend > cmdSize ||
+        size > ((dev->productID == UE9_PRODUCT_ID) ? LJSIM_MAX_PACKET : LJSIM_U3U6_MAX_PACKET)) {
+        return 0;
+    }
+
+    resp[1] = (BYTE)(0xF8);
+    resp[2] = (BYTE)((size - 6)/2);
+    resp[3] = (BYTE)(0x3B);
+
+    if (address == 0xA0) {
+        ack = (numSend + 1 >= 32) ? 0xFFFFFFFF : (1u << (numSend + 1)) - 1;
+        for (i = 0; i < numSend; i++) {
+            if (i == 0) {
+                dev->tdacEepromPointer = data[0] & 0x7F;
+            }
+            else {
+                dev->tdacEeprom[dev->tdacEepromPointer] = data[i];
+                dev->tdacEepromPointer = (dev->tdacEepromPointer + 1) & 0x7F;
+            }
+        }
+        for (i = 0; i < numReceive; i++) {
+            resp[12 + i] = dev->tdacEeprom[dev->tdacEepromPointer];
+            dev->tdacEepromPointer = (dev->tdacEepromPointer + 1) & 0x7F;
+        }
+    }
+    else if (address == 0x24) {
+        ack = (numSend + 1 >= 32) ? 0xFFFFFFFF : (1u << (numSend + 1)) - 1;
+        for (i = 0; i + 2 < numSend; i += 3) {
+            if (data[i] == 48 || data[i] == 49) {
+                dev->tdacDac[data[i] - 48] = (unsigned short)((data[i + 1] << 8) | data[i + 2]);
+            }
+        }
+    }
+    else {
+        ack = 0;
+    }
+    LJSIM_Put32(resp + 8, ack);
+
+    // Address byte and data bytes with 9 clocks each, plus start and stop.
+    // SpeedAdjust 0 is about 130 kHz and each step adds about 10 us per clock.
+    *timeUs += ((1 + numSend + numReceive)*9 + 2)*(7700ULL + cmd[7]*10000ULL)/1000 + 20;
+
+    return size;
+}
+
+
+// UE9 CommConfig response with the serial number and default network settings
+static unsigned long LJSIM_CommConfig(struct LJSIM_Device *dev, BYTE *resp)
+{
+    resp[1] = (BYTE)(0x78);
+    resp[2] = (BYTE)(0x10);
+    resp[3] = (BYTE)(0x01);
+    resp[8] = 1;                // LocalID
+    resp[9] = 1;                // PowerLevel
+    resp[10] = 50;              // IPAddress 192.168.1.50
+    resp[11] = 1;
+    resp[12] = 168;
+    resp[13] = 192;
+    resp[28] = (BYTE)(dev->serialNumber & 0xFF);
+    resp[29] = (BYTE)((dev->serialNumber >> 8) & 0xFF);
+    resp[30] = (BYTE)((dev->serialNumber >> 16) & 0xFF);
+    resp[31] = 0x10;
+    resp[35] = 1;               // Firmware 1.52 (Comm)
+    resp[36] = 52;
+    resp[37] = (BYTE)(0x09);   // Product ID
+
+    return 38;
+}
+
+
+// StreamConfig (U3, U6 and UE9 layouts)
+static unsigned long LJSIM_StreamConfig(struct LJSIM_Device *dev, const BYTE *cmd, unsigned long cmdSize, BYTE *resp)
+{
+    unsigned int numChannels, samplesPerPacket, interval, header;
+    BYTE scanConfig;
+    double hz;
+
+    resp[1] = (BYTE)(0xF8);
+    resp[2] = 1;
+    resp[3] = (BYTE)(0x11);
+
+    header = (dev->productID == U6_PRODUCT_ID) ? 14 : 12;
+    numChannels = cmd[6];
+    if (dev->productID == U3_PRODUCT_ID) {
+        samplesPerPacket = cmd[7];
+        scanConfig = cmd[9];
+        interval = cmd[10] + cmd[11]*256;
+        hz = (scanConfig & 0x08) ? 48.0e6 : 4.0e6;
+        if (scanConfig & 0x04) {
+            hz /= 256;
+        }
+    }
+    else if (dev->productID == U6_PRODUCT_ID) {
+        samplesPerPacket = cmd[8];
+        scanConfig = cmd[11];
+        interval = cmd[12] + cmd[13]*256;
+        hz = (scanConfig & 0x08) ? 48.0e6 : 4.0e6;
+        if (scanConfig & 0x02) {
+            hz /= 256;
+        }
+    }
+    else {
+        samplesPerPacket = 16;
+        scanConfig = cmd[9];
+        interval = cmd[10] + cmd[11]*256;
+        switch ((scanConfig >> 3) & 3) {
+        case 0:
+            hz = 4.0e6;
+            break;
+        case 1:
+            hz = 48.0e6;
+            break;
+        case 2:
+            hz = 750.0e3;
+            break;
+        default:
+            hz = 24.0e6;
+            break;
+        }
+        if (scanConfig & 0x02) {
+            hz /= 256;
+        }
+    }
+
+    if (dev->streaming) {
+        resp[6] = LJSIM_ERROR_STREAM_ACTIVE;
+        return 8;
+    }
+    if (numChannels == 0 || cmdSize < header + numChannels*2UL || interval == 0 ||
+        samplesPerPacket == 0 || samplesPerPacket > 25) {
+        resp[6] = LJSIM_ERROR_STREAM_CONFIG;
+        return 8;
+    }
+
+    dev->streamConfigured = true;
+    dev->streamNumChannels = numChannels;
+    dev->streamSamplesPerPacket = samplesPerPacket;
+    if (dev->productID == UE9_PRODUCT_ID) {
+        dev->streamPacketSize = 48;
+        dev->streamBufferSize = LJSIM_UE9_STREAM_BUFFER;
+    }
+    else {
+        dev->streamPacketSize = 14 + samplesPerPacket*2;
+        dev->streamBufferSize = LJSIM_U3U6_STREAM_BUFFER;
+    }
+    dev->streamBufferSize -= dev->streamBufferSize % numChannels;
+    dev->streamScanPeriodNs = interval/hz*1.0e9;
+    return 8;
+}
+
+
+// StreamStart (0xA8) and StreamStop (0xB0)
+static unsigned long LJSIM_StreamStartStop(struct LJSIM_Device *dev, BYTE command, BYTE *resp)
+{
+    resp[1] = (BYTE)(command + 1);
+    if (command == (BYTE)(0xA8)) {
+        if (!dev->streamConfigured) {
+            resp[2] = LJSIM_ERROR_STREAM_CONFIG;
+        }
+        else if (dev->streaming) {
+            resp[2] = LJSIM_ERROR_STREAM_ACTIVE;
+        }
+        else {
+            dev->streaming = true;
+            dev->streamStartNs = LJSIM_Now() + gLatencyNs/2;
+            dev->streamScans = 0;
+            dev->streamStored = 0;
+            dev->streamSent = 0;
+            dev->streamDroppedSent = 0;
+            dev->streamBuffered = 0;
+            dev->streamDropRun = 0;
+            dev->streamGapHead = 0;
+            dev->streamGapCount = 0;
+        }
+    }
+    else {
+        if (!dev->streaming) {
+            resp[2] = LJSIM_ERROR_STREAM_NOT_RUNNING;
+        }
+        dev->streaming = false;
+    }
+    return 4;
+}
+
+
+// Builds the next StreamData response and removes it from the stream buffer
+static void LJSIM_StreamSend(struct LJSIM_Device *dev, BYTE *out)
+{
+    unsigned int n, i, spp = dev->streamSamplesPerPacket;
+    unsigned long long sample = dev->streamSent*spp;
+    unsigned long long reported = 0, scan;
+    struct LJSIM_StreamGap *gap;
+    unsigned short code;
+    bool overflow = false;
+
+    n = (dev->productID == UE9_PRODUCT_ID) ? 46 : dev->streamPacketSize;
+    memset(out, 0, dev->streamPacketSize);
+
+    for (i = 0; i < spp; i++, sample++) {
+        while (dev->streamGapCount > 0) {
+            gap = &dev->streamGaps[dev->streamGapHead];
+            if (gap->sample > sample) {
+                break;
+            }
+            dev->streamDroppedSent += gap->dropped;
+            reported += gap->dropped;
+            dev->streamGapHead = (dev->streamGapHead + 1) % LJSIM_MAX_STREAM_GAPS;
+            dev->streamGapCount--;
+        }
+
+        scan = sample/dev->streamNumChannels + dev->streamDroppedSent;
+        code = (unsigned short)(32768 + 30000*LJSIM_Signal(dev, (unsigned int)(sample % dev->streamNumChannels),
+                                                          scan*dev->streamScanPeriodNs/1.0e9));
+        out[12 + i*2] = (BYTE)(code & 0xFF);
+        out[13 + i*2] = (BYTE)(code >> 8);
+    }
+
+    out[1] = (BYTE)(0xF9);
+    out[2] = (BYTE)(n/2 - 3);
+    out[3] = (BYTE)(0xC0);
+    out[10] = (BYTE)(dev->streamSent & 0xFF);
+    if (dev->productID == UE9_PRODUCT_ID) {
+        overflow = (reported > 0 || dev->streamDropRun > 0);
+        out[45] = (BYTE)((dev->streamBuffered*127/dev->streamBufferSize) | (overflow ? 0x80 : 0));
+    }
+    else {
+        if (reported > 0) {
+            out[11] = LJSIM_ERROR_AUTORECOVERY_END;
+            if (reported > 65535) {
+                reported = 65535;
+            }
+            out[6] = (BYTE)(reported & 0xFF);
+            out[7] = (BYTE)(reported >> 8);
+        }
+        else if (dev->streamDropRun > 0) {
+            out[11] = LJSIM_ERROR_AUTORECOVERY_ACTIVE;
+        }
+        out[12 + spp*2] = (BYTE)(dev->streamBuffered*255/dev->streamBufferSize);
+    }
+    LJSIM_Checksum(out, n, true);
+
+    dev->streamSent++;
+    dev->streamBuffered -= spp;
+}
+
+
+// Runs the stream up to untilNs.  While a read is pending (limit is above the
+// number of responses sent), responses are sent to out as soon as they are
+// complete, up to response number limit, and *readyNs is set to the time the
+// last one was.
+static void LJSIM_StreamRun(struct LJSIM_Device *dev, unsigned long long untilNs, unsigned long long limit, BYTE *out, unsigned long long *readyNs)
+{
+    unsigned long long scans, first = dev->streamSent;
+    unsigned int numChannels = dev->streamNumChannels;
+    struct LJSIM_StreamGap *gap;
+    double t;
+
+    for (;;) {
+        //Responses already complete
+        while (dev->streamSent < limit && dev->streamSent < dev->streamStored/dev->streamSamplesPerPacket) {
+            LJSIM_StreamSend(dev, out + (dev->streamSent - first)*dev->streamPacketSize);
+        }
+        if (limit > first && dev->streamSent >= limit) {
+            break;
+        }
+
+        //Without a pending read, a full buffer drops every scan until untilNs
+        if (limit == first && dev->streamBuffered + numChannels > dev->streamBufferSize) {
+            scans = (unsigned long long)((untilNs - dev->streamStartNs)/dev->streamScanPeriodNs);
+            if (untilNs > dev->streamStartNs && scans > dev->streamScans) {
+                dev->streamDropRun += scans - dev->streamScans;
+                dev->streamScans = scans;
+            }
+            break;
+        }
+
+        t = dev->streamStartNs + (dev->streamScans + 1)*dev->streamScanPeriodNs;
+        if (t > untilNs) {
+            break;
+        }
+        dev->streamScans++;
+
+        if (dev->streamBuffered + numChannels > dev->streamBufferSize) {
+            dev->streamDropRun++;
+            continue;
+        }
+
+        if (dev->streamDropRun > 0) {
+            if (dev->streamGapCount < LJSIM_MAX_STREAM_GAPS) {
+                gap = &dev->streamGaps[(dev->streamGapHead + dev->streamGapCount) % LJSIM_MAX_STREAM_GAPS];
+                gap->sample = dev->streamStored;
+                gap->dropped = dev->streamDropRun;
+                dev->streamGapCount++;
+            }
+            else {
+                gap = &dev->streamGaps[(dev->streamGapHead + dev->streamGapCount - 1) % LJSIM_MAX_STREAM_GAPS];
+                gap->dropped += dev->streamDropRun;
+            }
+            dev->streamDropRun = 0;
+        }
+        dev->streamStored += numChannels;
+        dev->streamBuffered += numChannels;
+
+        if (dev->streamSent < limit && dev->streamSent < dev->streamStored/dev->streamSamplesPerPacket) {
+            *readyNs = (unsigned long long)t;
+        }
+    }
+}
+
+
+// Runs a command and returns the size of its response.  timeUs is set to the time the device takes to run it.
+static unsigned long LJSIM_RunCommand(struct LJSIM_Device *dev, const BYTE *cmd, unsigned long cmdSize, BYTE *resp, unsigned long long *timeUs)
+{
+    unsigned long size;
+
+    *timeUs = 0;
+    memset(resp, 0, LJSIM_MAX_PACKET);
+
+    if (cmdSize >= 38 && dev->productID == UE9_PRODUCT_ID && cmd[1] == (BYTE)(0x78) &&
+        cmd[2] == (BYTE)(0x10) && cmd[3] == (BYTE)(0x01)) {
+        return LJSIM_CommConfig(dev, resp);
+    }
+
+    if (cmdSize == 8 && dev->productID == UE9_PRODUCT_ID && cmd[1] == (BYTE)(0xA3)) {
+        if (!LJSIM_ChecksumValid(cmd, 8, false)) {
+            resp[0] = (BYTE)(0xB8);
+            resp[1] = (BYTE)(0xB8);
+            return 2;
+        }
+        return LJSIM_UE9SingleIO(dev, cmd, resp, timeUs);
+    }
+
+    if (cmdSize == 2 && dev->productID == UE9_PRODUCT_ID && cmd[0] == (BYTE)(0x08) && cmd[1] == (BYTE)(0x08)) {
+        // FlushBuffer:  StreamStart empties the simulated stream buffer
+        resp[0] = (BYTE)(0x08);
+        resp[1] = (BYTE)(0x08);
+        return 2;
+    }
+
+    if (cmdSize == 2 && (cmd[1] == (BYTE)(0xA8) || cmd[1] == (BYTE)(0xB0))) {
+        if (cmd[0] != cmd[1]) {
+            resp[0] = (BYTE)(0xB8);
+            resp[1] = (BYTE)(0xB8);
+            return 2;
+        }
+        return LJSIM_StreamStartStop(dev, cmd[1], resp);
+    }
+
+    if (cmdSize < 8 || cmd[1] != (BYTE)(0xF8) || cmd[2] != (cmdSize - 6)/2 ||
+        !LJSIM_ChecksumValid(cmd, cmdSize, true)) {
+        // Bad checksum or unknown command
+        resp[0] = (BYTE)(0xB8);
+        resp[1] = (BYTE)(0xB8);
+        return 2;
+    }
+
+    switch (cmd[3]) {
+    case 0x00:
+        if (dev->productID == UE9_PRODUCT_ID) {
+            if (cmdSize != 34) {
+                break;
+            }
+            return LJSIM_UE9Feedback(dev, cmd, resp, timeUs);
+        }
+        return LJSIM_Feedback(dev, cmd, cmdSize, resp, timeUs);
+    case 0x08:
+        if (dev->productID == UE9_PRODUCT_ID || cmdSize != 26) {
+            break;
+        }
+        return LJSIM_ConfigU3U6(dev, resp);
+    case 0x0A:
+        if (dev->productID == UE9_PRODUCT_ID || cmdSize != 10) {
+            break;
+        }
+        return LJSIM_ConfigTimerClock(dev, cmd, resp);
+    case 0x0B:
+        if (dev->productID == UE9_PRODUCT_ID) {
+            break;
+        }
+        return LJSIM_ConfigIO(dev, cmd, resp);
+    case 0x11:
+        return LJSIM_StreamConfig(dev, cmd, cmdSize, resp);
+    case 0x2A:
+        if (dev->productID != UE9_PRODUCT_ID) {
+            break;
+        }
+        return LJSIM_ReadMem(dev, cmd, resp);
+    case 0x2D:
+        if (dev->productID == UE9_PRODUCT_ID) {
+            break;
+        }
+        return LJSIM_ReadMem(dev, cmd, resp);
+    case 0x3B:
+        size = LJSIM_I2C(dev, cmd, cmdSize, resp, timeUs);
+        if (size == 0) {
+            break;
+        }
+        return size;
+    }
+
+    resp[1] = cmd[1];
+    resp[2] = 1;
+    resp[3] = cmd[3];
+    resp[6] = LJSIM_ERROR_INVALID_COMMAND;
+    return 8;
+}
+
+
+float LJUSB_GetLibraryVersion(void)
+{
+    return LJUSB_LIBRARY_VERSION;
+}
+
+
+unsigned int LJUSB_GetDevCount(unsigned long ProductID)
+{
+    unsigned int i, n = 0;
+
+    pthread_once(&gInitOnce, LJSIM_Init);
+    for (i = 0; i < gNumDevices; i++) {
+        if (gDevices[i].productID == ProductID) {
+            n++;
+        }
+    }
+    return n;
+}
+
+
+unsigned int LJUSB_GetDevCounts(UINT *productCounts, UINT * productIds, UINT n)
+{
+    const UINT ids[3] = {U3_PRODUCT_ID, U6_PRODUCT_ID, UE9_PRODUCT_ID};
+    UINT i;
+
+    for (i = 0; i < n; i++) {
+        productIds[i] = (i < 3) ? ids[i] : 0;
+        productCounts[i] = (i < 3) ? LJUSB_GetDevCount(ids[i]) : 0;
+    }
+    return gNumDevices;
+}
+
+
+HANDLE LJUSB_OpenDevice(UINT DevNum, unsigned int dwReserved, unsigned long ProductID)
+{
+    struct LJSIM_Device *dev;
+    unsigned int i, n = 0;
+
+    pthread_once(&gInitOnce, LJSIM_Init);
+    for (i = 0; i < gNumDevices; i++) {
+        dev = &gDevices[i];
+        if (dev->productID != ProductID || ++n != DevNum) {
+            continue;
+        }
+
+        pthread_mutex_lock(&dev->lock);
+        if (dev->isOpen) {
+            pthread_mutex_unlock(&dev->lock);
+            errno = EBUSY;
+            return NULL;
+        }
+        dev->isOpen = true;
+        dev->openNs = LJSIM_Now();
+        dev->pendingHead = 0;
+        dev->pendingCount = 0;
+        dev->busyUntilNs = 0;
+        dev->dioState = 0xFFFFFF;   // Inputs are pulled up
+        pthread_mutex_unlock(&dev->lock);
+        return (HANDLE)dev;
+    }
+
+    errno = ENODEV;
+    return NULL;
+}
+
+
+int LJUSB_OpenAllDevices(HANDLE* devHandles, UINT* productIds, UINT maxDevices)
+{
+    UINT i, n = 0, num[UE9_PRODUCT_ID + 1];
+
+    pthread_once(&gInitOnce, LJSIM_Init);
+    memset(num, 0, sizeof(num));
+    for (i = 0; i < gNumDevices && n < maxDevices; i++) {
+        num[gDevices[i].productID]++;
+        devHandles[n] = LJUSB_OpenDevice(num[gDevices[i].productID], 0, gDevices[i].productID);
+        if (devHandles[n] != NULL) {
+            productIds[n++] = gDevices[i].productID;
+        }
+    }
+    return (int)n;
+}
+
+
+int LJUSB_OpenAllDevicesOfProductId(UINT productId, HANDLE **devHandles)
+{
+    HANDLE handles[LJSIM_MAX_DEVICES];
+    UINT ids[LJSIM_MAX_DEVICES];
+    int i, n, count = 0;
+
+    n = LJUSB_OpenAllDevices(handles, ids, LJSIM_MAX_DEVICES);
+    *devHandles = (HANDLE *)malloc(sizeof(HANDLE)*LJSIM_MAX_DEVICES);
+    if (*devHandles == NULL) {
+        return -1;
+    }
+    for (i = 0; i < n; i++) {
+        if (productId == 0 || ids[i] == productId) {
+            (*devHandles)[count++] = handles[i];
+        }
+        else {
+            LJUSB_CloseDevice(handles[i]);
+        }
+    }
+    return count;
+}
+
+
+bool LJUSB_ResetConnection(HANDLE hDevice)
+{
+    struct LJSIM_Device *dev = LJSIM_GetDevice(hDevice);
+
+    if (dev == NULL) {
+        return false;
+    }
+    pthread_mutex_lock(&dev->lock);
+    dev->pendingCount = 0;
+    pthread_mutex_unlock(&dev->lock);
+    return true;
+}
+
+
+unsigned long LJUSB_WriteTO(HANDLE hDevice, const BYTE *pBuff, unsigned long count, unsigned int timeout)
+{
+    struct LJSIM_Device *dev = LJSIM_GetDevice(hDevice);
+    struct LJSIM_Response *r;
+    unsigned long long timeUs, now;
+
+    if (dev == NULL) {
+        return 0;
+    }
+    if (pBuff == NULL || count == 0 || count > LJSIM_MAX_PACKET) {
+        errno = EINVAL;
+        return 0;
+    }
+
+    pthread_mutex_lock(&dev->lock);
+    if (dev->pendingCount >= LJSIM_MAX_PENDING) {
+        pthread_mutex_unlock(&dev->lock);
+        errno = ETIMEDOUT;
+        return 0;
+    }
+
+    r = &dev->pending[(dev->pendingHead + dev->pendingCount) % LJSIM_MAX_PENDING];
+    r->size = LJSIM_RunCommand(dev, pBuff, count, r->data, &timeUs);
+    if (r->data[1] != (BYTE)(0xB8)) {
+        // Extended responses all have command byte 0xF8
+        LJSIM_Checksum(r->data, (unsigned int)r->size, r->data[1] == (BYTE)(0xF8));
+    }
+
+    // The command reaches the device after half the round trip time and the
+    // response reaches the host after the other half.  The device runs one
+    // command at a time, but commands written ahead overlap their transfers.
+    now = LJSIM_Now() + gLatencyNs/2;
+    if (dev->busyUntilNs < now) {
+        dev->busyUntilNs = now;
+    }
+    dev->busyUntilNs += timeUs*1000ULL;
+    r->readyNs = dev->busyUntilNs + gLatencyNs - gLatencyNs/2;
+    dev->pendingCount++;
+    pthread_mutex_unlock(&dev->lock);
+
+    return count;
+}
+
+
+unsigned long LJUSB_ReadTO(HANDLE hDevice, BYTE *pBuff, unsigned long count, unsigned int timeout)
+{
+    struct LJSIM_Device *dev = LJSIM_GetDevice(hDevice);
+    struct LJSIM_Response r;
+
+    if (dev == NULL) {
+        return 0;
+    }
+    if (pBuff == NULL) {
+        errno = EINVAL;
+        return 0;
+    }
+
+    pthread_mutex_lock(&dev->lock);
+    if (dev->pendingCount == 0) {
+        pthread_mutex_unlock(&dev->lock);
+        errno = ETIMEDOUT;
+        return 0;
+    }
+    r = dev->pending[dev->pendingHead];
+    dev->pendingHead = (dev->pendingHead + 1) % LJSIM_MAX_PENDING;
+    dev->pendingCount--;
+    pthread_mutex_unlock(&dev->lock);
+
+    LJSIM_SleepUntil(r.readyNs);
+    if (count > r.size) {
+        count = r.size;
+    }
+    memcpy(pBuff, r.data, count);
+    return count;
+}
+
+
+unsigned long LJUSB_StreamTO(HANDLE hDevice, BYTE *pBuff, unsigned long count, unsigned int timeout)
+{
+    struct LJSIM_Device *dev = LJSIM_GetDevice(hDevice);
+    unsigned long long now, deadline, readyNs, first, wanted;
+    unsigned long size;
+
+    if (dev == NULL) {
+        return 0;
+    }
+    if (pBuff == NULL) {
+        errno = EINVAL;
+        return 0;
+    }
+
+    now = LJSIM_Now();
+    deadline = (timeout > 0) ? now + timeout*1000000ULL : (unsigned long long)-1;
+
+    pthread_mutex_lock(&dev->lock);
+    if (!dev->streaming || count < dev->streamPacketSize) {
+        pthread_mutex_unlock(&dev->lock);
+        if (timeout > 0) {
+            LJSIM_SleepUntil(deadline);
+        }
+        errno = ETIMEDOUT;
+        return 0;
+    }
+
+    // A U3/U6 response shorter than 64 bytes ends the transfer
+    wanted = count/dev->streamPacketSize;
+    if (dev->productID != UE9_PRODUCT_ID && dev->streamPacketSize < 64) {
+        wanted = 1;
+    }
+
+    LJSIM_StreamRun(dev, now, dev->streamSent, NULL, &readyNs);
+    first = dev->streamSent;
+    readyNs = now;
+    LJSIM_StreamRun(dev, deadline, first + wanted, pBuff, &readyNs);
+    size = (unsigned long)(dev->streamSent - first)*dev->streamPacketSize;
+    pthread_mutex_unlock(&dev->lock);
+
+    if (size < wanted*dev->streamPacketSize) {
+        LJSIM_SleepUntil(deadline);
+        errno = ETIMEDOUT;
+        return size;
+    }
+
+    LJSIM_SleepUntil(readyNs + LJSIM_STREAM_PACKET_NS + gLatencyNs/2);
+    return size;
+}
+
+
+unsigned long LJUSB_StreamStampedTO(HANDLE hDevice, BYTE *pBuff, unsigned long count, unsigned int timeout, unsigned long long *pTimestampNs)
+{
+    unsigned long r;
+
+    r = LJUSB_StreamTO(hDevice, pBuff, count, timeout);
+    if (pTimestampNs != NULL) {
+        *pTimestampNs = LJUSB_GetTimestampNs();
+    }
+    return r;
+}
+
+
+unsigned long long LJUSB_GetTimestampNs(void)
+{
+    struct timespec ts;
+
+#ifdef CLOCK_MONOTONIC_RAW
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+#else
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#endif
+    return (unsigned long long)ts.tv_sec*1000000000ULL + ts.tv_nsec;
+}
+
+
+// Simulated asynchronous reads.  The transfers are kept as a ring in the
+// order they complete; while one or more are in flight, responses go to the
+// oldest as soon as they are complete.
+struct LJUSB_StreamAsync
+{
+    HANDLE hDevice;
+    unsigned long count;
+    unsigned int numTransfers;
+    unsigned int timeout;
+    unsigned int head;                  // Transfer that completes next
+    unsigned long long filled;          // Responses in the head transfer
+    unsigned long long readyNs;         // Time the last of them was complete
+    unsigned long long submittedNs[LJUSB_STREAM_ASYNC_MAX_TRANSFERS];
+    unsigned long long lastDoneNs;      // Completion time of the last transfer
+    int error;
+    LJUSB_StreamCallback callback;
+    void *userData;
+    BYTE *buffers;
+};
+
+
+LJUSB_StreamAsync *LJUSB_StreamAsyncStart(HANDLE hDevice, unsigned long count, unsigned int numTransfers, unsigned int timeout, LJUSB_StreamCallback callback, void *userData)
+{
+    LJUSB_StreamAsync *async;
+    unsigned long long now;
+    unsigned int i;
+
+    if (LJSIM_GetDevice(hDevice) == NULL) {
+        return NULL;
+    }
+    if (count == 0 || count > 65535 || numTransfers == 0 ||
+        numTransfers > LJUSB_STREAM_ASYNC_MAX_TRANSFERS || callback == NULL) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    async = (LJUSB_StreamAsync *)calloc(1, sizeof(LJUSB_StreamAsync));
+    if (async == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    async->buffers = (BYTE *)malloc(count*numTransfers);
+    if (async->buffers == NULL) {
+        free(async);
+        errno = ENOMEM;
+        return NULL;
+    }
+    async->hDevice = hDevice;
+    async->count = count;
+    async->numTransfers = numTransfers;
+    async->timeout = timeout;
+    async->callback = callback;
+    async->userData = userData;
+
+    now = LJSIM_Now();
+    for (i = 0; i < numTransfers; i++) {
+        async->submittedNs[i] = now;
+    }
+    async->lastDoneNs = now;
+
+    return async;
+}
+
+
+int LJUSB_StreamAsyncHandleEvents(LJUSB_StreamAsync *async, unsigned int timeout)
+{
+    struct LJSIM_Device *dev;
+    unsigned long long now, deadline, transferDeadline, doneNs, first, wanted;
+    unsigned long size;
+    BYTE *buff;
+    int completed = 0, error;
+
+    if (async == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (async->error != 0) {
+        errno = async->error;
+        return -1;
+    }
+    dev = LJSIM_GetDevice(async->hDevice);
+    if (dev == NULL) {
+        async->error = errno;
+        return -1;
+    }
+
+    now = LJSIM_Now();
+    deadline = now + timeout*1000000ULL;
+
+    // Completes transfers until one is not done by the deadline.  Returns
+    // after the first callback unless more transfers are already complete.
+    for (;;) {
+        buff = async->buffers + async->head*async->count;
+        transferDeadline = (async->timeout > 0) ? async->submittedNs[async->head] + async->timeout*1000000ULL : (unsigned long long)-1;
+
+        pthread_mutex_lock(&dev->lock);
+        if (!dev->streaming || async->count < dev->streamPacketSize) {
+            wanted = 1;
+            size = 0;
+        }
+        else {
+            // A U3/U6 response shorter than 64 bytes ends the transfer
+            wanted = async->count/dev->streamPacketSize;
+            if (dev->productID != UE9_PRODUCT_ID && dev->streamPacketSize < 64) {
+                wanted = 1;
+            }
+
+            // With one transfer, nothing is in flight while the host runs
+            // the callback and resubmits
+            if (async->numTransfers == 1 && async->filled == 0) {
+                LJSIM_StreamRun(dev, now, dev->streamSent, NULL, &async->readyNs);
+            }
+            if (async->filled < wanted) {
+                first = dev->streamSent;
+                async->readyNs = now;
+                LJSIM_StreamRun(dev, (deadline < transferDeadline) ? deadline : transferDeadline,
+                                first + wanted - async->filled, buff + async->filled*dev->streamPacketSize, &async->readyNs);
+                async->filled += dev->streamSent - first;
+            }
+            size = (unsigned long)(async->filled*dev->streamPacketSize);
+        }
+        pthread_mutex_unlock(&dev->lock);
+
+        if (async->filled >= wanted) {
+            doneNs = async->readyNs + LJSIM_STREAM_PACKET_NS + gLatencyNs/2;
+            if (doneNs < async->lastDoneNs + LJSIM_STREAM_PACKET_NS) {
+                doneNs = async->lastDoneNs + LJSIM_STREAM_PACKET_NS;
+            }
+            if (completed > 0 && doneNs > LJSIM_Now()) {
+                break;
+            }
+            LJSIM_SleepUntil(doneNs);
+            error = 0;
+        }
+        else if (transferDeadline <= deadline) {
+            LJSIM_SleepUntil(transferDeadline);
+            doneNs = transferDeadline;
+            error = ETIMEDOUT;
+        }
+        else {
+            LJSIM_SleepUntil(deadline);
+            break;
+        }
+
+        async->lastDoneNs = doneNs;
+        async->callback(buff, size, LJUSB_GetTimestampNs(), error, async->userData);
+        completed++;
+
+        now = LJSIM_Now();
+        async->submittedNs[async->head] = now;
+        async->filled = 0;
+        async->head = (async->head + 1) % async->numTransfers;
+    }
+
+    return completed;
+}
+
+
+void LJUSB_StreamAsyncStop(LJUSB_StreamAsync *async)
+{
+    if (async == NULL) {
+        return;
+    }
+    free(async->buffers);
+    free(async);
+}
+
+
+unsigned long LJUSB_Write(HANDLE hDevice, const BYTE *pBuff, unsigned long count)
+{
+    return LJUSB_WriteTO(hDevice, pBuff, count, 1000);
+}
+
+
+unsigned long LJUSB_Read(HANDLE hDevice, BYTE *pBuff, unsigned long count)
+{
+    return LJUSB_ReadTO(hDevice, pBuff, count, 1000);
+}
+
+
+unsigned long LJUSB_Stream(HANDLE hDevice, BYTE *pBuff, unsigned long count)
+{
+    return LJUSB_StreamTO(hDevice, pBuff, count, 1000);
+}
+
+
+void LJUSB_CloseDevice(HANDLE hDevice)
+{
+    struct LJSIM_Device *dev = LJSIM_GetDevice(hDevice);
+
+    if (dev == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&dev->lock);
+    dev->isOpen = false;
+    dev->streaming = false;
+    dev->streamConfigured = false;
+    pthread_mutex_unlock(&dev->lock);
+}
+
+
+bool LJUSB_IsHandleValid(HANDLE hDevice)
+{
+    return LJSIM_GetDevice(hDevice) != NULL;
+}
+
+
+unsigned short LJUSB_GetDeviceDescriptorReleaseNumber(HANDLE hDevice)
+{
+    if (LJSIM_GetDevice(hDevice) == NULL) {
+        return 0;
+    }
+    return 0x0100;
+}
+
+
+unsigned long LJUSB_GetHIDReportDescriptor(HANDLE hDevice, BYTE *pBuff, unsigned long count)
+{
+    errno = ENOTSUP;
+    return 0;
+}
+
+
+unsigned long LJUSB_BulkRead(HANDLE hDevice, unsigned char endpoint, BYTE *pBuff, unsigned long count)
+{
+    return LJUSB_Read(hDevice, pBuff, count);
+}
+
+
+unsigned long LJUSB_BulkWrite(HANDLE hDevice, unsigned char endpoint, BYTE *pBuff, unsigned long count)
+{
+    return LJUSB_Write(hDevice, pBuff, count);
+}
+
+
+bool LJUSB_AbortPipe(HANDLE hDevice, unsigned long Pipe)
+{
+    errno = ENOTSUP;
+    return false;
+}
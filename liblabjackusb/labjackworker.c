@@ -0,0 +1,409 @@
+//---------------------------------------------------------------------------
+//
+//  labjackworker.c
+//
+//    Per-device worker threads with a lock-free command queue.
+//
+//  support@labjack.com
+//
+//  SPDX-FileCopyrightText: Copyright (c) 2009 LabJack Corporation
+//  SPDX-License-Identifier: X11
+//
+//---------------------------------------------------------------------------
+//
+
+#ifdef __linux__
+// pthread_setaffinity_np
+#define _GNU_SOURCE
+#endif
+
+#include "labjackworker.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/time.h>
+
+
+struct LJUSB_DeviceWorker
+{
+    HANDLE hDevice;
+    int cpu;
+    int priority;
+
+    // The queue is a lock-free stack of submitted commands:  submitters push
+    // with a compare and swap, and the worker takes the whole stack with an
+    // exchange and reverses it, so commands run in the order submitted.
+    LJUSB_WorkerCommand *pending;
+    unsigned long long submitted;
+    int sleeping;                   // 1 while the worker may wait on wake
+
+    // Shared with the worker thread, under lock
+    pthread_mutex_t lock;
+    pthread_cond_t wake;            // Signaled by a submit to a sleeping worker
+    pthread_cond_t done;            // Broadcast when a command has a waiter
+    int waiters;                    // Threads in LJUSB_WorkerWait
+    bool stopping;
+    LJUSB_WorkerStats stats;
+
+    pthread_t thread;
+};
+
+
+// Takes the queued commands, in the order they were submitted
+static LJUSB_WorkerCommand *LJUSB_WorkerTakePending(LJUSB_DeviceWorker *worker)
+{
+    LJUSB_WorkerCommand *stack, *list = NULL, *next;
+
+    stack = __atomic_exchange_n(&worker->pending, NULL, __ATOMIC_ACQUIRE);
+    while (stack != NULL) {
+        next = stack->next;
+        stack->next = list;
+        list = stack;
+        stack = next;
+    }
+
+    return list;
+}
+
+
+// Marks a command completed and wakes its waiters.  The command belongs to
+// the caller again once done is set, so it is not used after that.  A
+// callback that submits the command again bumps its generation, and the
+// command is then left queued instead of marked done.
+static void LJUSB_WorkerComplete(LJUSB_DeviceWorker *worker, LJUSB_WorkerCommand *command)
+{
+    unsigned int generation = __atomic_load_n(&command->generation, __ATOMIC_RELAXED);
+
+    if (command->callback != NULL) {
+        command->callback(command, command->userData);
+        if (__atomic_load_n(&command->generation, __ATOMIC_ACQUIRE) != generation) {
+            return;
+        }
+    }
+
+    __atomic_store_n(&command->done, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&worker->waiters, __ATOMIC_SEQ_CST) > 0) {
+        pthread_mutex_lock(&worker->lock);
+        pthread_cond_broadcast(&worker->done);
+        pthread_mutex_unlock(&worker->lock);
+    }
+}
+
+
+// Writes a command and reads its response
+static void LJUSB_WorkerRun(LJUSB_DeviceWorker *worker, LJUSB_WorkerCommand *command)
+{
+    unsigned int timeout = (command->timeout > 0) ? command->timeout : 1000;
+
+    command->startNs = LJUSB_GetTimestampNs();
+    errno = 0;
+    if (command->commandSize > 0) {
+        command->writeCount = LJUSB_WriteTO(worker->hDevice, command->pCommand, command->commandSize, timeout);
+        if (command->writeCount < command->commandSize) {
+            command->error = (errno != 0) ? errno : EIO;
+        }
+    }
+    if (command->error == 0 && command->responseSize > 0) {
+        command->readCount = LJUSB_ReadTO(worker->hDevice, command->pResponse, command->responseSize, timeout);
+        if (command->readCount == 0) {
+            command->error = (errno != 0) ? errno : EIO;
+        }
+    }
+    command->endNs = LJUSB_GetTimestampNs();
+}
+
+
+static void *LJUSB_WorkerThread(void *arg)
+{
+    LJUSB_DeviceWorker *worker = (LJUSB_DeviceWorker *)arg;
+    LJUSB_WorkerCommand *list, *command;
+    struct sched_param param;
+    int cpu = -1, realtime = 0;
+#ifdef __linux__
+    cpu_set_t cpus;
+
+    if (worker->cpu >= 0 && worker->cpu < CPU_SETSIZE) {
+        CPU_ZERO(&cpus);
+        CPU_SET(worker->cpu, &cpus);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0) {
+            cpu = worker->cpu;
+        }
+    }
+#endif
+
+    if (worker->priority > 0) {
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = worker->priority;
+        realtime = (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0) ? 1 : 0;
+    }
+
+    pthread_mutex_lock(&worker->lock);
+    worker->stats.cpu = cpu;
+    worker->stats.realtime = realtime;
+    pthread_mutex_unlock(&worker->lock);
+
+    for (;;) {
+        list = LJUSB_WorkerTakePending(worker);
+        if (list == NULL) {
+            // Announce the sleep before checking the queue again, so a submit
+            // either sees sleeping set and signals, or is seen here
+            __atomic_store_n(&worker->sleeping, 1, __ATOMIC_SEQ_CST);
+            pthread_mutex_lock(&worker->lock);
+            while (!worker->stopping && __atomic_load_n(&worker->pending, __ATOMIC_SEQ_CST) == NULL) {
+                pthread_cond_wait(&worker->wake, &worker->lock);
+            }
+            pthread_mutex_unlock(&worker->lock);
+            __atomic_store_n(&worker->sleeping, 0, __ATOMIC_RELAXED);
+
+            list = LJUSB_WorkerTakePending(worker);
+            if (list == NULL) {
+                // Stopping with an empty queue
+                break;
+            }
+        }
+
+        pthread_mutex_lock(&worker->lock);
+        worker->stats.batches++;
+        pthread_mutex_unlock(&worker->lock);
+
+        while (list != NULL) {
+            command = list;
+            list = list->next;
+
+            // After a stop, the commands taken with the current one are
+            // cancelled instead of run
+            if (__atomic_load_n(&worker->stopping, __ATOMIC_RELAXED)) {
+                command->error = ECANCELED;
+                command->startNs = command->endNs = LJUSB_GetTimestampNs();
+            }
+            else {
+                LJUSB_WorkerRun(worker, command);
+            }
+
+            pthread_mutex_lock(&worker->lock);
+            worker->stats.completed++;
+            if (command->error == 0) {
+                LJUSB_StreamAgeStatsAdd(&worker->stats.queueTime, (command->startNs - command->submitNs)/1.0e3);
+                LJUSB_StreamAgeStatsAdd(&worker->stats.roundTrip, (command->endNs - command->startNs)/1.0e3);
+            }
+            else {
+                worker->stats.errors++;
+                worker->stats.error = command->error;
+            }
+            pthread_mutex_unlock(&worker->lock);
+
+            LJUSB_WorkerComplete(worker, command);
+        }
+
+        if (__atomic_load_n(&worker->stopping, __ATOMIC_RELAXED)) {
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+
+LJUSB_DeviceWorker *LJUSB_WorkerStart(HANDLE hDevice, int cpu, int priority)
+{
+    LJUSB_DeviceWorker *worker;
+    int r;
+
+    if (hDevice == NULL || cpu < -1 || priority < 0 || priority > 99) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    worker = (LJUSB_DeviceWorker *)calloc(1, sizeof(LJUSB_DeviceWorker));
+    if (worker == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    worker->hDevice = hDevice;
+    worker->cpu = cpu;
+    worker->priority = priority;
+
+    pthread_mutex_init(&worker->lock, NULL);
+    pthread_cond_init(&worker->wake, NULL);
+    pthread_cond_init(&worker->done, NULL);
+    worker->stats.cpu = -1;
+    LJUSB_StreamAgeStatsReset(&worker->stats.queueTime);
+    LJUSB_StreamAgeStatsReset(&worker->stats.roundTrip);
+
+    r = pthread_create(&worker->thread, NULL, LJUSB_WorkerThread, worker);
+    if (r != 0) {
+        pthread_cond_destroy(&worker->done);
+        pthread_cond_destroy(&worker->wake);
+        pthread_mutex_destroy(&worker->lock);
+        free(worker);
+        errno = r;
+        return NULL;
+    }
+
+    return worker;
+}
+
+
+int LJUSB_WorkerSubmit(LJUSB_DeviceWorker *worker, LJUSB_WorkerCommand *command)
+{
+    LJUSB_WorkerCommand *head;
+
+    if (worker == NULL || command == NULL || (command->commandSize > 0 && command->pCommand == NULL) ||
+        (command->responseSize > 0 && command->pResponse == NULL) ||
+        (command->commandSize == 0 && command->responseSize == 0)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    command->writeCount = 0;
+    command->readCount = 0;
+    command->error = 0;
+    command->startNs = 0;
+    command->endNs = 0;
+    command->submitNs = LJUSB_GetTimestampNs();
+    __atomic_store_n(&command->done, 0, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&command->generation, 1, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&worker->submitted, 1, __ATOMIC_RELAXED);
+
+    head = __atomic_load_n(&worker->pending, __ATOMIC_RELAXED);
+    do {
+        command->next = head;
+    } while (!__atomic_compare_exchange_n(&worker->pending, &head, command, true, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED));
+
+    if (__atomic_load_n(&worker->sleeping, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock(&worker->lock);
+        pthread_cond_signal(&worker->wake);
+        pthread_mutex_unlock(&worker->lock);
+    }
+
+    return 0;
+}
+
+
+int LJUSB_WorkerPoll(LJUSB_WorkerCommand *command)
+{
+    if (command == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    return __atomic_load_n(&command->done, __ATOMIC_ACQUIRE) ? 1 : 0;
+}
+
+
+int LJUSB_WorkerWait(LJUSB_DeviceWorker *worker, LJUSB_WorkerCommand *command, unsigned int timeout)
+{
+    struct timeval now;
+    struct timespec deadline;
+    int r = 0;
+
+    if (worker == NULL || command == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (__atomic_load_n(&command->done, __ATOMIC_ACQUIRE)) {
+        return 0;
+    }
+
+    if (timeout > 0) {
+        // pthread_cond_timedwait uses the real-time clock
+        gettimeofday(&now, NULL);
+        deadline.tv_sec = now.tv_sec + timeout/1000;
+        deadline.tv_nsec = now.tv_usec*1000L + (timeout%1000)*1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+    }
+
+    // The waiter is counted before done is checked again, so the worker
+    // either sees it and broadcasts, or has set done already
+    pthread_mutex_lock(&worker->lock);
+    __atomic_add_fetch(&worker->waiters, 1, __ATOMIC_SEQ_CST);
+    while (r == 0 && !__atomic_load_n(&command->done, __ATOMIC_SEQ_CST)) {
+        if (timeout > 0) {
+            r = pthread_cond_timedwait(&worker->done, &worker->lock, &deadline);
+        }
+        else {
+            pthread_cond_wait(&worker->done, &worker->lock);
+        }
+    }
+    if (__atomic_sub_fetch(&worker->waiters, 1, __ATOMIC_SEQ_CST) == 0 && worker->stopping) {
+        // LJUSB_WorkerStop waits for the last waiter before freeing
+        pthread_cond_broadcast(&worker->done);
+    }
+    pthread_mutex_unlock(&worker->lock);
+
+    if (!__atomic_load_n(&command->done, __ATOMIC_ACQUIRE)) {
+        errno = ETIMEDOUT;
+        return -1;
+    }
+
+    return 0;
+}
+
+
+int LJUSB_WorkerGetStats(LJUSB_DeviceWorker *worker, LJUSB_WorkerStats *stats)
+{
+    if (worker == NULL || stats == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    pthread_mutex_lock(&worker->lock);
+    *stats = worker->stats;
+    pthread_mutex_unlock(&worker->lock);
+    stats->submitted = __atomic_load_n(&worker->submitted, __ATOMIC_RELAXED);
+
+    return 0;
+}
+
+
+int LJUSB_WorkerStop(LJUSB_DeviceWorker *worker, LJUSB_WorkerStats *stats)
+{
+    LJUSB_WorkerCommand *list, *command;
+
+    if (worker == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    pthread_mutex_lock(&worker->lock);
+    __atomic_store_n(&worker->stopping, true, __ATOMIC_RELAXED);
+    pthread_cond_signal(&worker->wake);
+    pthread_mutex_unlock(&worker->lock);
+    pthread_join(worker->thread, NULL);
+
+    // Cancel the commands the worker did not run
+    list = LJUSB_WorkerTakePending(worker);
+    while (list != NULL) {
+        command = list;
+        list = list->next;
+        command->error = ECANCELED;
+        command->endNs = LJUSB_GetTimestampNs();
+        worker->stats.completed++;
+        worker->stats.errors++;
+        worker->stats.error = ECANCELED;
+        LJUSB_WorkerComplete(worker, command);
+    }
+
+    // Waiters leave once their commands are complete
+    pthread_mutex_lock(&worker->lock);
+    while (worker->waiters > 0) {
+        pthread_cond_wait(&worker->done, &worker->lock);
+    }
+    pthread_mutex_unlock(&worker->lock);
+
+    if (stats != NULL) {
+        *stats = worker->stats;
+        stats->submitted = worker->submitted;
+    }
+    pthread_cond_destroy(&worker->done);
+    pthread_cond_destroy(&worker->wake);
+    pthread_mutex_destroy(&worker->lock);
+    free(worker);
+
+    return 0;
+}
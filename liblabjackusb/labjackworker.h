@@ -0,0 +1,171 @@
+//-----------------------------------------------------------------------------
+//
+//  labjackworker.h
+//
+//  Header file for the device workers of the labjackusb library.  A worker
+//  owns one opened device and runs its command-response commands on a
+//  dedicated thread, optionally pinned to a CPU.  Any number of threads
+//  submit commands to a worker through a lock-free queue and wait for them
+//  like futures, or get a callback when they complete, so an application
+//  with many devices gets a thread per device without writing one around
+//  the blocking LJUSB_Write and LJUSB_Read calls.
+//
+//  support@labjack.com
+//
+//  SPDX-FileCopyrightText: Copyright (c) 2009 LabJack Corporation
+//  SPDX-License-Identifier: X11
+//
+//-----------------------------------------------------------------------------
+//
+
+#ifndef LABJACKWORKER_H_
+#define LABJACKWORKER_H_
+
+#include "labjackstream.h"
+
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+
+//Device worker, from LJUSB_WorkerStart
+typedef struct LJUSB_DeviceWorker LJUSB_DeviceWorker;
+
+typedef struct LJUSB_WorkerCommand LJUSB_WorkerCommand;
+
+//Called by the worker thread when a command completes, before
+//LJUSB_WorkerWait and LJUSB_WorkerPoll see it complete.  It runs on the
+//worker thread, so it delays the next commands of the device:  it should
+//only copy or convert the response, or hand it to another thread.  The
+//command can be submitted again from the callback (not when its error is
+//ECANCELED); it then stays incomplete until the new submit completes.
+//command = The completed command, with its result fields set.
+//userData = The userData of the command.
+typedef void (*LJUSB_WorkerCallback)(LJUSB_WorkerCommand *command, void *userData);
+
+//A command for a worker, owned by the caller.  Fill in the fields up to
+//userData, submit it with LJUSB_WorkerSubmit, and read the result fields
+//once it completes.  The command and its buffers must stay valid and
+//unchanged until then.
+struct LJUSB_WorkerCommand
+{
+    const BYTE *pCommand;           //The bytes to write, or NULL
+    unsigned long commandSize;      //The number of bytes to write, or 0 to
+                                    //only read
+    BYTE *pResponse;                //The buffer of the response, or NULL
+    unsigned long responseSize;     //The number of bytes to read, or 0 to
+                                    //only write
+    unsigned int timeout;           //USB timeout of the write and of the read
+                                    //in milliseconds, or 0 for the 1 second
+                                    //of LJUSB_Write and LJUSB_Read
+    LJUSB_WorkerCallback callback;  //Called when the command completes, or
+                                    //NULL
+    void *userData;                 //Passed to callback
+
+    //Result, set by the worker
+    unsigned long writeCount;       //Bytes written
+    unsigned long readCount;        //Bytes read.  A response can be shorter
+                                    //than responseSize, for example when it
+                                    //has a non-zero errorcode.
+    int error;                      //0, or the errno of a failed write or
+                                    //read (ECANCELED if the worker stopped
+                                    //before running the command)
+    unsigned long long submitNs;    //LJUSB_GetTimestampNs when submitted
+    unsigned long long startNs;     //LJUSB_GetTimestampNs when the worker
+                                    //started the write
+    unsigned long long endNs;       //LJUSB_GetTimestampNs when the read ended
+
+    //Used by the worker
+    LJUSB_WorkerCommand *next;
+    int done;
+    unsigned int generation;        //Counts the submits of the command
+};
+
+//Counters of a worker, from LJUSB_WorkerGetStats
+typedef struct LJUSB_WorkerStats
+{
+    unsigned long long submitted;       //Commands submitted
+    unsigned long long completed;       //Commands completed, including the
+                                        //failed ones
+    unsigned long long errors;          //Commands whose write or read failed
+    unsigned long long batches;         //Times the worker took the queued
+                                        //commands; completed/batches is the
+                                        //mean queue depth it found
+    int error;                          //errno of the last failed command, or 0
+    int cpu;                            //The CPU the thread is pinned to, or -1
+    int realtime;                       //1 if the thread runs with the
+                                        //requested real-time priority
+    LJUSB_StreamAgeStats queueTime;     //Time from the submit of each command
+                                        //to its write, in us
+    LJUSB_StreamAgeStats roundTrip;     //Time from the write of each command
+                                        //to the end of its read, in us
+} LJUSB_WorkerStats;
+
+
+LJUSB_DeviceWorker *LJUSB_WorkerStart(HANDLE hDevice, int cpu, int priority);
+// Starts the worker thread of an opened device.  The worker runs the
+// submitted commands in the order they were submitted, one at a time:  it
+// writes the command, then reads the response.  The device must not be used
+// by other threads while the worker runs, except through the worker.
+// Returns the worker, or NULL on error and errno is set:
+//   EINVAL - a parameter is out of range
+//   ENOMEM - the worker could not be allocated
+//   others - from pthread_create
+// hDevice = The handle of the device.
+// cpu = The CPU to pin the thread to (0 to the number of CPUs - 1), or -1
+//       to let the scheduler place it.  Pinning the workers of several
+//       devices to different CPUs keeps them from delaying each other.  If
+//       the thread cannot be pinned (Mac OS X, or a CPU outside the
+//       process's affinity), it runs unpinned and the cpu field of the stats
+//       is -1.
+// priority = The SCHED_FIFO priority of the thread (1 to 99), or 0 to keep
+//            the normal scheduling.  If it cannot be set (permissions), the
+//            thread runs with normal scheduling and the realtime field of
+//            the stats is 0.
+
+int LJUSB_WorkerSubmit(LJUSB_DeviceWorker *worker, LJUSB_WorkerCommand *command);
+// Queues a command for the worker thread without waiting:  the queue is
+// lock-free, so any number of threads can submit at the same time, and a
+// submit never waits for a command in progress.  Returns 0 on success, or
+// -1 on error and errno is set.
+// worker = The worker.
+// command = The command.  It must not be queued already.
+
+int LJUSB_WorkerPoll(LJUSB_WorkerCommand *command);
+// Returns 1 if a submitted command has completed, 0 if it has not, or -1 on
+// error and errno is set.  Does not wait.
+// command = The command.
+
+int LJUSB_WorkerWait(LJUSB_DeviceWorker *worker, LJUSB_WorkerCommand *command, unsigned int timeout);
+// Waits for a submitted command to complete.  Returns 0 when it has
+// completed (check its error field), or -1 on error and errno is set:
+//   ETIMEDOUT - the command did not complete in time.  It stays queued, so
+//               it must not be reused or freed until it completes.
+//   EINVAL - a parameter is invalid
+// worker = The worker the command was submitted to.
+// command = The command.
+// timeout = The time to wait in milliseconds, or 0 to wait until the
+//           command completes.
+
+int LJUSB_WorkerGetStats(LJUSB_DeviceWorker *worker, LJUSB_WorkerStats *stats);
+// Returns the counters of a worker, from any thread.  Returns 0 on success,
+// or -1 on error and errno is set.
+// worker = The worker.
+// stats = Returns the counters.
+
+int LJUSB_WorkerStop(LJUSB_DeviceWorker *worker, LJUSB_WorkerStats *stats);
+// Stops the worker thread after its current command and frees the worker.
+// Commands still queued complete with the error ECANCELED, and their
+// callbacks are called from the worker thread or the calling thread.  No
+// command may be submitted while or after the worker stops.  The device is
+// not closed.  Returns 0 on success, or -1 on error and errno is set.
+// worker = The worker.
+// stats = If not NULL, returns the final counters.
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LABJACKWORKER_H_
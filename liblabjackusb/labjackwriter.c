@@ -0,0 +1,423 @@
+//---------------------------------------------------------------------------
+//
+//  labjackwriter.c
+//
+//    Stream writer with a writer thread for U3, U6 and UE9 stream data.
+//
+//  support@labjack.com
+//
+//  SPDX-FileCopyrightText: Copyright (c) 2009 LabJack Corporation
+//  SPDX-License-Identifier: X11
+//
+//---------------------------------------------------------------------------
+//
+
+#ifdef __linux__
+#define _GNU_SOURCE  // O_DIRECT and fallocate
+#endif
+
+#include "labjackwriter.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+
+struct LJUSB_StreamWriter
+{
+    int fd;
+    unsigned long bufferSize;
+    unsigned int numBuffers;
+    BYTE *memory;                   // numBuffers*bufferSize bytes, aligned
+
+    // Only used by the thread calling LJUSB_StreamWriterWrite
+    BYTE *fill;                     // Buffer being filled, or NULL
+    unsigned long fillCount;
+
+    // Shared with the writer thread, under lock
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    BYTE *freeList[LJUSB_WRITER_MAX_BUFFERS];
+    unsigned int numFree;
+    BYTE *queue[LJUSB_WRITER_MAX_BUFFERS];
+    unsigned long queueCount[LJUSB_WRITER_MAX_BUFFERS];
+    unsigned int queueHead;
+    unsigned int queueLength;
+    bool closing;
+    LJUSB_StreamWriterStats stats;
+
+    // Only used by the writer thread
+    unsigned long long offset;      // File offset of the next buffer
+
+    unsigned long long startOffset; // File size when opened
+    pthread_t thread;
+};
+
+
+// Writes count bytes at offset, retrying short writes.  Returns 0 on success,
+// or -1 and errno is set.
+static int LJUSB_WriterWriteAll(int fd, const BYTE *p, unsigned long count, unsigned long long offset)
+{
+    ssize_t r;
+
+    while (count > 0) {
+        r = pwrite(fd, p, count, (off_t)offset);
+        if (r < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        if (r == 0) {
+            errno = EIO;
+            return -1;
+        }
+        p += r;
+        count -= (unsigned long)r;
+        offset += (unsigned long long)r;
+    }
+
+    return 0;
+}
+
+
+static void *LJUSB_WriterThread(void *arg)
+{
+    LJUSB_StreamWriter *writer = (LJUSB_StreamWriter *)arg;
+    unsigned long long t0 = 0, t1 = 0;
+    unsigned long count;
+    BYTE *buff;
+    int r, error;
+
+    pthread_mutex_lock(&writer->lock);
+    for (;;) {
+        while (writer->queueLength == 0 && !writer->closing) {
+            pthread_cond_wait(&writer->work, &writer->lock);
+        }
+        if (writer->queueLength == 0) {
+            break;
+        }
+        buff = writer->queue[writer->queueHead];
+        count = writer->queueCount[writer->queueHead];
+        error = writer->stats.error;
+        pthread_mutex_unlock(&writer->lock);
+
+        // After a failed write, the queued buffers are discarded
+        r = 0;
+        if (error == 0) {
+            t0 = LJUSB_GetTimestampNs();
+            r = LJUSB_WriterWriteAll(writer->fd, buff, count, writer->offset);
+            error = (r == 0) ? 0 : errno;
+            t1 = LJUSB_GetTimestampNs();
+            writer->offset += count;
+        }
+
+        pthread_mutex_lock(&writer->lock);
+        writer->queueHead = (writer->queueHead + 1) % writer->numBuffers;
+        writer->queueLength--;
+        writer->stats.queueDepth = writer->queueLength;
+        writer->freeList[writer->numFree++] = buff;
+        if (r == 0 && writer->stats.error == 0) {
+            writer->stats.bytesWritten += count;
+            writer->stats.buffersWritten++;
+            LJUSB_StreamAgeStatsAdd(&writer->stats.writeLatency, (t1 - t0)/1.0e3);
+        }
+        else {
+            // The buffer that failed and the ones discarded after it never
+            // reach the file
+            writer->stats.bytesDropped += count;
+            if (writer->stats.error == 0) {
+                writer->stats.error = error;
+            }
+        }
+    }
+    pthread_mutex_unlock(&writer->lock);
+
+    return NULL;
+}
+
+
+// Queues the buffer being filled for the writer thread
+static void LJUSB_WriterQueueFill(LJUSB_StreamWriter *writer)
+{
+    unsigned int i;
+
+    pthread_mutex_lock(&writer->lock);
+    i = (writer->queueHead + writer->queueLength) % writer->numBuffers;
+    writer->queue[i] = writer->fill;
+    writer->queueCount[i] = writer->fillCount;
+    writer->queueLength++;
+    writer->stats.queueDepth = writer->queueLength;
+    if (writer->queueLength > writer->stats.maxQueueDepth) {
+        writer->stats.maxQueueDepth = writer->queueLength;
+    }
+    pthread_cond_signal(&writer->work);
+    pthread_mutex_unlock(&writer->lock);
+
+    writer->fill = NULL;
+    writer->fillCount = 0;
+}
+
+
+LJUSB_StreamWriter *LJUSB_StreamWriterOpen(const char *path, unsigned long bufferSize, unsigned int numBuffers, unsigned long long preallocateBytes, int options)
+{
+    LJUSB_StreamWriter *writer;
+    struct stat st;
+    void *memory;
+    unsigned int i;
+    int flags, r;
+
+    if (path == NULL || bufferSize == 0 || bufferSize % LJUSB_WRITER_ALIGNMENT != 0 ||
+        numBuffers < 2 || numBuffers > LJUSB_WRITER_MAX_BUFFERS) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    writer = (LJUSB_StreamWriter *)calloc(1, sizeof(LJUSB_StreamWriter));
+    if (writer == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    writer->bufferSize = bufferSize;
+    writer->numBuffers = numBuffers;
+    writer->stats.numBuffers = numBuffers;
+
+    r = posix_memalign(&memory, LJUSB_WRITER_ALIGNMENT, (size_t)bufferSize*numBuffers);
+    if (r != 0) {
+        free(writer);
+        errno = ENOMEM;
+        return NULL;
+    }
+    writer->memory = (BYTE *)memory;
+    for (i = 0; i < numBuffers; i++) {
+        writer->freeList[i] = writer->memory + (size_t)i*bufferSize;
+    }
+    writer->numFree = numBuffers;
+
+    flags = O_WRONLY | O_CREAT | ((options & LJUSB_WRITER_APPEND) ? 0 : O_TRUNC);
+    writer->fd = -1;
+#ifdef O_DIRECT
+    if (options & LJUSB_WRITER_DIRECT) {
+        writer->fd = open(path, flags | O_DIRECT, 0644);
+        writer->stats.direct = (writer->fd >= 0) ? 1 : 0;
+    }
+#endif
+    if (writer->fd < 0) {
+        // Also the fallback for file systems without O_DIRECT (EINVAL)
+        writer->fd = open(path, flags, 0644);
+    }
+    if (writer->fd < 0) {
+        r = errno;
+        free(writer->memory);
+        free(writer);
+        errno = r;
+        return NULL;
+    }
+#ifdef F_NOCACHE
+    if ((options & LJUSB_WRITER_DIRECT) && fcntl(writer->fd, F_NOCACHE, 1) == 0) {
+        writer->stats.direct = 1;
+    }
+#endif
+
+    if (fstat(writer->fd, &st) == 0) {
+        writer->startOffset = (unsigned long long)st.st_size;
+    }
+    writer->offset = writer->startOffset;
+
+#ifdef O_DIRECT
+    // Appending at an unaligned end of file cannot use O_DIRECT
+    if (writer->stats.direct && writer->startOffset % LJUSB_WRITER_ALIGNMENT != 0) {
+        fcntl(writer->fd, F_SETFL, fcntl(writer->fd, F_GETFL) & ~O_DIRECT);
+        writer->stats.direct = 0;
+    }
+#endif
+
+#ifdef __linux__
+    if (preallocateBytes > 0 && fallocate(writer->fd, 0, (off_t)writer->startOffset, (off_t)preallocateBytes) == 0) {
+        writer->stats.preallocated = 1;
+    }
+#endif
+
+    pthread_mutex_init(&writer->lock, NULL);
+    pthread_cond_init(&writer->work, NULL);
+    LJUSB_StreamAgeStatsReset(&writer->stats.writeLatency);
+
+    r = pthread_create(&writer->thread, NULL, LJUSB_WriterThread, writer);
+    if (r != 0) {
+        pthread_cond_destroy(&writer->work);
+        pthread_mutex_destroy(&writer->lock);
+        close(writer->fd);
+        free(writer->memory);
+        free(writer);
+        errno = r;
+        return NULL;
+    }
+
+    return writer;
+}
+
+
+long LJUSB_StreamWriterWrite(LJUSB_StreamWriter *writer, const void *pData, unsigned long count)
+{
+    const BYTE *p = (const BYTE *)pData;
+    unsigned long long available;
+    unsigned long left = count, n;
+    int error;
+
+    if (writer == NULL || (pData == NULL && count > 0)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // Only this thread takes free buffers, so the room checked here cannot
+    // shrink before the data is copied and the data is accepted whole or not
+    // at all
+    pthread_mutex_lock(&writer->lock);
+    error = writer->stats.error;
+    available = (unsigned long long)writer->numFree*writer->bufferSize;
+    if (writer->fill != NULL) {
+        available += writer->bufferSize - writer->fillCount;
+    }
+    if (error != 0 || available < (unsigned long long)count) {
+        writer->stats.bytesDropped += count;
+    }
+    else {
+        writer->stats.bytesAccepted += count;
+    }
+    pthread_mutex_unlock(&writer->lock);
+
+    if (error != 0 || available < (unsigned long long)count) {
+        errno = (error != 0) ? error : ENOBUFS;
+        return -1;
+    }
+
+    while (left > 0) {
+        if (writer->fill == NULL) {
+            pthread_mutex_lock(&writer->lock);
+            writer->fill = writer->freeList[--writer->numFree];
+            pthread_mutex_unlock(&writer->lock);
+        }
+
+        n = writer->bufferSize - writer->fillCount;
+        if (n > left) {
+            n = left;
+        }
+        memcpy(writer->fill + writer->fillCount, p, n);
+        writer->fillCount += n;
+        p += n;
+        left -= n;
+
+        if (writer->fillCount == writer->bufferSize) {
+            LJUSB_WriterQueueFill(writer);
+        }
+    }
+
+    return (long)count;
+}
+
+
+unsigned long long LJUSB_StreamWriterAvailable(LJUSB_StreamWriter *writer)
+{
+    unsigned long long available = 0;
+
+    if (writer == NULL) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&writer->lock);
+    if (writer->stats.error == 0) {
+        available = (unsigned long long)writer->numFree*writer->bufferSize;
+        if (writer->fill != NULL) {
+            available += writer->bufferSize - writer->fillCount;
+        }
+    }
+    pthread_mutex_unlock(&writer->lock);
+
+    return available;
+}
+
+
+int LJUSB_StreamWriterGetStats(LJUSB_StreamWriter *writer, LJUSB_StreamWriterStats *stats)
+{
+    if (writer == NULL || stats == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    pthread_mutex_lock(&writer->lock);
+    memcpy(stats, &writer->stats, sizeof(LJUSB_StreamWriterStats));
+    pthread_mutex_unlock(&writer->lock);
+
+    return 0;
+}
+
+
+int LJUSB_StreamWriterClose(LJUSB_StreamWriter *writer, LJUSB_StreamWriterStats *stats)
+{
+    unsigned long long size;
+    unsigned long padded, pad = 0;
+    int error;
+
+    if (writer == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // O_DIRECT writes whole blocks, so the last buffer is padded and the file
+    // is cut back to the data afterwards
+    if (writer->fill != NULL && writer->fillCount > 0) {
+        if (writer->stats.direct) {
+            padded = (writer->fillCount + LJUSB_WRITER_ALIGNMENT - 1)/LJUSB_WRITER_ALIGNMENT*LJUSB_WRITER_ALIGNMENT;
+            pad = padded - writer->fillCount;
+            memset(writer->fill + writer->fillCount, 0, pad);
+            writer->fillCount = padded;
+        }
+        LJUSB_WriterQueueFill(writer);
+    }
+
+    pthread_mutex_lock(&writer->lock);
+    writer->closing = true;
+    pthread_cond_signal(&writer->work);
+    pthread_mutex_unlock(&writer->lock);
+    pthread_join(writer->thread, NULL);
+
+    // bytesWritten, or bytesDropped if the last buffer was not written,
+    // counts the padding; the caller only sees the data
+    if (writer->stats.bytesWritten > writer->stats.bytesAccepted) {
+        writer->stats.bytesWritten = writer->stats.bytesAccepted;
+    }
+    else {
+        writer->stats.bytesDropped -= pad;
+    }
+
+    // Buffers are written in order and none after a failed write, so the
+    // data written ends at bytesWritten.  Cutting there also removes the
+    // part of a failed write that reached the file.
+    size = writer->startOffset + writer->stats.bytesWritten;
+    error = writer->stats.error;
+    if (ftruncate(writer->fd, (off_t)size) != 0 && error == 0) {
+        error = errno;
+    }
+    if (close(writer->fd) != 0 && error == 0) {
+        error = errno;
+    }
+
+    if (stats != NULL) {
+        memcpy(stats, &writer->stats, sizeof(LJUSB_StreamWriterStats));
+    }
+
+    pthread_cond_destroy(&writer->work);
+    pthread_mutex_destroy(&writer->lock);
+    free(writer->memory);
+    free(writer);
+
+    if (error != 0) {
+        errno = error;
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,131 @@
+//-----------------------------------------------------------------------------
+//
+//  labjackwriter.h
+//
+//  Header file for the stream writer of the labjackusb library.  Copies
+//  stream data (StreamData responses, raw codes or volts) into large aligned
+//  buffers and writes full buffers to a file from a writer thread, so the
+//  thread reading the stream never waits for the disk.
+//
+//  support@labjack.com
+//
+//  SPDX-FileCopyrightText: Copyright (c) 2009 LabJack Corporation
+//  SPDX-License-Identifier: X11
+//
+//-----------------------------------------------------------------------------
+//
+
+#ifndef LABJACKWRITER_H_
+#define LABJACKWRITER_H_
+
+#include "labjackstream.h"
+
+//Alignment of the writer buffers, their sizes and the file offsets written.
+//Meets the O_DIRECT requirements of common file systems and NVMe drives.
+#define LJUSB_WRITER_ALIGNMENT        4096
+
+//Maximum number of buffers of a writer
+#define LJUSB_WRITER_MAX_BUFFERS      256
+
+//LJUSB_StreamWriterOpen options
+#define LJUSB_WRITER_DIRECT           0x01  //Bypass the page cache (O_DIRECT on
+                                            //Linux, F_NOCACHE on Mac OS X)
+#define LJUSB_WRITER_APPEND           0x02  //Append to an existing file instead
+                                            //of truncating it
+
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+
+//Stream writer, from LJUSB_StreamWriterOpen
+typedef struct LJUSB_StreamWriter LJUSB_StreamWriter;
+
+//Counters of a stream writer, from LJUSB_StreamWriterGetStats
+typedef struct LJUSB_StreamWriterStats
+{
+    unsigned long long bytesAccepted;   //Bytes copied into buffers by
+                                        //LJUSB_StreamWriterWrite
+    unsigned long long bytesWritten;    //Bytes written to the file
+    unsigned long long bytesDropped;    //Bytes not accepted because every
+                                        //buffer was full or waiting for the
+                                        //disk, or not written because of a
+                                        //write error
+    unsigned long long buffersWritten;  //Buffers written by the writer thread
+    unsigned int queueDepth;            //Full buffers waiting for the writer thread
+    unsigned int maxQueueDepth;         //Largest queueDepth so far
+    unsigned int numBuffers;            //Buffers of the writer
+    int direct;                         //1 if the page cache is bypassed
+    int preallocated;                   //1 if the file space was preallocated
+    int error;                          //errno of the first failed write, or 0
+    LJUSB_StreamAgeStats writeLatency;  //Time to write each buffer, in us
+} LJUSB_StreamWriterStats;
+
+
+LJUSB_StreamWriter *LJUSB_StreamWriterOpen(const char *path, unsigned long bufferSize, unsigned int numBuffers, unsigned long long preallocateBytes, int options);
+// Creates (or truncates) a file and starts the writer thread that writes to
+// it.  Returns the writer, or NULL on error and errno is set:
+//   EINVAL - a parameter is out of range
+//   ENOMEM - the buffers could not be allocated
+//   others - from open or pthread_create
+// If the file system does not support O_DIRECT, the file is written through
+// the page cache; check the direct field of the stats.
+// path = The path of the file.
+// bufferSize = The size of each buffer in bytes, a multiple of
+//              LJUSB_WRITER_ALIGNMENT.  Larger buffers mean fewer, more
+//              efficient writes; 1 MB or more suits NVMe drives.
+// numBuffers = The number of buffers (2 to LJUSB_WRITER_MAX_BUFFERS).
+//              (numBuffers - 1)*bufferSize bytes of stream data can wait for
+//              the disk before data is dropped, so size it for the longest
+//              disk stall to ride out at the data rate.
+// preallocateBytes = The file space to allocate up front (fallocate on
+//                    Linux), so that writes do not wait for the file system
+//                    to find blocks, or 0.  Space that is not used is
+//                    released by LJUSB_StreamWriterClose.
+// options = LJUSB_WRITER_DIRECT and LJUSB_WRITER_APPEND bits, or 0.
+
+long LJUSB_StreamWriterWrite(LJUSB_StreamWriter *writer, const void *pData, unsigned long count);
+// Copies data to the writer's buffers.  Full buffers are queued for the
+// writer thread.  Never waits for the disk:  if the free buffers cannot hold
+// all of the data, none of it is accepted and it is counted in bytesDropped.
+// Call it from one thread at a time.  Returns count, or -1 on error and errno
+// is set:
+//   ENOBUFS - the data did not fit and was dropped
+//   EINVAL - a parameter is invalid
+//   others - a write of the writer thread failed; no more data is accepted
+// writer = The writer.
+// pData = The data, for example the decoded scans of LJUSB_StreamDecode or
+//         the StreamData responses read with LJUSB_Stream.
+// count = The number of bytes of data.
+
+unsigned long long LJUSB_StreamWriterAvailable(LJUSB_StreamWriter *writer);
+// Returns the number of bytes LJUSB_StreamWriterWrite can accept now without
+// dropping data, or 0 if the writer is invalid or a write failed.  Callers
+// that cannot drop data, like the index of labjackpack.h, use it to pass the
+// data in pieces that fit.  Call it from the thread that calls
+// LJUSB_StreamWriterWrite.
+// writer = The writer.
+
+int LJUSB_StreamWriterGetStats(LJUSB_StreamWriter *writer, LJUSB_StreamWriterStats *stats);
+// Returns the counters of a writer, from any thread.  Returns 0 on success,
+// or -1 on error and errno is set.
+// writer = The writer.
+// stats = Returns the counters.
+
+int LJUSB_StreamWriterClose(LJUSB_StreamWriter *writer, LJUSB_StreamWriterStats *stats);
+// Queues the data of the partly filled buffer, waits for the writer thread to
+// write everything, sets the file size to the bytes written (releasing unused
+// preallocated space, and cutting the file after the last buffer written if a
+// write failed), closes the file and frees the writer.  Returns 0 on
+// success, or -1 if a write failed and errno is set.  The writer is freed in
+// both cases.
+// writer = The writer.
+// stats = If not NULL, returns the final counters.
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LABJACKWRITER_H_
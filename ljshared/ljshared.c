@@ -0,0 +1,831 @@
+//---------------------------------------------------------------------------
+//
+//  ljshared.c
+//
+//    Daemon that shares U3, U6 and UE9 devices between processes
+//    (labjackshared.h).  It opens the devices with liblabjackusb and serves
+//    the clients of liblabjackusb_client over a Unix socket.
+//
+//    Usage: ljshared [-s socket] [-v]
+//      -s  Socket path.  Default is the LJSHARED_SOCKET environment
+//          variable, or LJUSB_SHARED_SOCKET.
+//      -v  Print the clients and their command timing when they disconnect.
+//
+//    Each device has a thread that takes the commands of its clients in
+//    turn, up to LJSHARED_PIPELINE_DEPTH at a time, writes them all and then
+//    reads their responses, so the USB transfers of a command overlap the
+//    device running the one before.  Responses are matched to commands by
+//    their order, so after a failed read the rest of the batch fails, late
+//    responses are drained from the device, and commands are sent one at a
+//    time until a read succeeds again.  Responses are sent to the clients
+//    without waiting:  a client that does not read them is disconnected
+//    instead of stalling the device.  A stream started by a client is read
+//    by a stream thread into a stream ring of StreamData packets, one packet
+//    per ring scan.
+//
+//  support@labjack.com
+//
+//  SPDX-FileCopyrightText: Copyright (c) 2009 LabJack Corporation
+//  SPDX-License-Identifier: X11
+//
+//---------------------------------------------------------------------------
+//
+
+#include "labjackshared.h"
+#include "labjackring.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+
+#define LJSHARED_MAX_DEVICES        16
+#define LJSHARED_MAX_CLIENTS        64
+#define LJSHARED_PIPELINE_DEPTH     4       // Commands written ahead on a device
+#define LJSHARED_DRAIN_TIMEOUT      100     // ms to wait for late responses
+#define LJSHARED_DRAIN_MAX          (LJSHARED_PIPELINE_DEPTH*2)
+#define LJSHARED_STREAM_PACKETS     16384   // StreamData packets a stream ring holds
+#define LJSHARED_STREAM_TIMEOUT     100     // ms, so stream threads see stops
+#define LJSHARED_MAX_STREAM_READ    65535
+// Socket send buffer of a client:  room for the responses of all its pending
+// commands and for the replies of its other requests
+#define LJSHARED_SEND_BUFFER        (4*LJUSB_SHARED_MAX_PENDING*(sizeof(LJUSB_SharedMsg) + LJUSB_SHARED_MAX_RESPONSE))
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+struct LJSHARED_Device;
+
+struct LJSHARED_Command
+{
+    BYTE data[LJUSB_SHARED_MAX_COMMAND];
+    unsigned long size;
+    unsigned long long receivedNs;
+};
+
+struct LJSHARED_Client
+{
+    int fd;
+    unsigned int id;
+    struct LJSHARED_Device *device;
+    pthread_mutex_t sendLock;
+
+    // Under the device lock
+    struct LJSHARED_Command queue[LJUSB_SHARED_MAX_PENDING];
+    unsigned int queueHead;
+    unsigned int queueCount;
+    unsigned int refs;              // Commands of the client the device thread runs
+    bool closed;
+
+    // Only used by the device thread
+    unsigned long long commands;
+    unsigned long long deviceNs;
+    unsigned long long queueNs;
+};
+
+struct LJSHARED_Device
+{
+    unsigned int id;                // Handle of the device in the messages
+    unsigned long productID;
+    unsigned int devNum;
+    HANDLE handle;
+    unsigned short releaseNumber;
+    pthread_t thread;
+
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    bool quit;
+    struct LJSHARED_Client *clients[LJSHARED_MAX_CLIENTS];
+    unsigned int numClients;
+    unsigned int nextClient;        // Client the next batch starts with
+    unsigned int depth;             // Commands per batch, 1 after a failed read
+    bool stopStream;                // Internal StreamStop queued
+
+    // Stream.  Set by the device thread, read under lock.
+    unsigned int packetSize;        // Of the last good StreamConfig
+    double packetRate;
+    struct LJSHARED_Client *streamOwner;
+    LJUSB_StreamRing *ring;
+    char ringName[LJUSB_STREAM_RING_MAX_NAME + 1];
+    unsigned int streamCount;
+    unsigned long readSize;         // First read size asked for by a client
+    volatile int streamStop;
+    pthread_t streamThread;
+};
+
+static struct LJSHARED_Device *gDevices[LJSHARED_MAX_DEVICES];
+static unsigned int gNumDevices = 0;
+static volatile sig_atomic_t gQuit = 0;
+static int gVerbose = 0;
+
+
+static void LJSHARED_OnSignal(int sig)
+{
+    gQuit = 1;
+}
+
+
+// Reads n bytes.  Returns 0 on success, or -1 on error or end of file.
+static int LJSHARED_RecvAll(int fd, void *p, size_t n)
+{
+    ssize_t r;
+
+    while (n > 0) {
+        r = recv(fd, p, n, 0);
+        if (r < 0 && errno == EINTR) {
+            continue;
+        }
+        if (r <= 0) {
+            return -1;
+        }
+        p = (BYTE *)p + r;
+        n -= (size_t)r;
+    }
+    return 0;
+}
+
+
+// Sends a message and its data to a client without waiting.  A client whose
+// socket buffer is full is not reading its responses, and a partly sent
+// message would break the framing, so the connection is shut down (the main
+// loop then closes it).  Returns 0 on success, or -1.
+static int LJSHARED_Send(struct LJSHARED_Client *client, LJUSB_SharedMsg *msg, const void *data)
+{
+    struct iovec iov[2];
+    struct msghdr mh;
+    size_t left;
+    ssize_t r;
+    int ret = 0;
+
+    iov[0].iov_base = msg;
+    iov[0].iov_len = sizeof(LJUSB_SharedMsg);
+    iov[1].iov_base = (void *)data;
+    iov[1].iov_len = msg->size;
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_iov = iov;
+    mh.msg_iovlen = (msg->size > 0) ? 2 : 1;
+    left = sizeof(LJUSB_SharedMsg) + msg->size;
+
+    pthread_mutex_lock(&client->sendLock);
+    do {
+        r = sendmsg(client->fd, &mh, MSG_NOSIGNAL | MSG_DONTWAIT);
+    } while (r < 0 && errno == EINTR);
+    if (r < 0 || (size_t)r != left) {
+        shutdown(client->fd, SHUT_RDWR);
+        ret = -1;
+    }
+    pthread_mutex_unlock(&client->sendLock);
+    return ret;
+}
+
+
+static void LJSHARED_FreeClient(struct LJSHARED_Client *client)
+{
+    if (gVerbose && client->commands > 0) {
+        printf("ljshared: client %u: %llu commands, %.1f us on the device, %.1f us waiting for other clients\n",
+               client->id, client->commands, client->deviceNs/1.0e3/client->commands, client->queueNs/1.0e3/client->commands);
+    }
+    close(client->fd);
+    pthread_mutex_destroy(&client->sendLock);
+    free(client);
+}
+
+
+// Packets per second of a StreamConfig, with the scan clocks of the
+// StreamConfig documentation of each device.  Returns 0 if unknown.
+static double LJSHARED_PacketRate(unsigned long productID, const BYTE *cmd, unsigned long size, unsigned int *packetSize)
+{
+    unsigned int numChannels, samplesPerPacket, interval;
+    BYTE scanConfig;
+    double hz;
+
+    if (size < 14) {
+        return 0;
+    }
+    numChannels = cmd[6];
+    if (productID == U3_PRODUCT_ID) {
+        samplesPerPacket = cmd[7];
+        scanConfig = cmd[9];
+        interval = cmd[10] + cmd[11]*256;
+        hz = (scanConfig & 0x08) ? 48.0e6 : 4.0e6;
+        hz /= (scanConfig & 0x04) ? 256 : 1;
+        *packetSize = 14 + samplesPerPacket*2;
+    }
+    else if (productID == U6_PRODUCT_ID) {
+        samplesPerPacket = cmd[8];
+        scanConfig = cmd[11];
+        interval = cmd[12] + cmd[13]*256;
+        hz = (scanConfig & 0x08) ? 48.0e6 : 4.0e6;
+        hz /= (scanConfig & 0x02) ? 256 : 1;
+        *packetSize = 14 + samplesPerPacket*2;
+    }
+    else {
+        const double ue9Clocks[4] = {4.0e6, 48.0e6, 750.0e3, 24.0e6};
+
+        samplesPerPacket = 16;
+        scanConfig = cmd[9];
+        interval = cmd[10] + cmd[11]*256;
+        hz = ue9Clocks[(scanConfig >> 3) & 3];
+        hz /= (scanConfig & 0x02) ? 256 : 1;
+        *packetSize = 48;
+    }
+    if (numChannels == 0 || interval == 0 || samplesPerPacket == 0) {
+        return 0;
+    }
+    return hz/interval*numChannels/samplesPerPacket;
+}
+
+
+// Reads the stream of a device into its ring until the stream stops
+static void *LJSHARED_StreamThread(void *arg)
+{
+    struct LJSHARED_Device *dev = (struct LJSHARED_Device *)arg;
+    unsigned long readSize, n;
+    unsigned short *buff;
+
+    buff = (unsigned short *)malloc(LJSHARED_MAX_STREAM_READ + 1);
+    if (buff == NULL) {
+        return NULL;
+    }
+
+    while (!dev->streamStop) {
+        // Reads start with the first client that reads, like reads of the
+        // device would
+        pthread_mutex_lock(&dev->lock);
+        readSize = dev->readSize;
+        pthread_mutex_unlock(&dev->lock);
+        if (readSize == 0) {
+            usleep(1000);
+            continue;
+        }
+
+        n = LJUSB_StreamTO(dev->handle, (BYTE *)buff, readSize, LJSHARED_STREAM_TIMEOUT);
+        if (n >= dev->packetSize) {
+            LJUSB_StreamRingPublish(dev->ring, buff, n/dev->packetSize);
+        }
+    }
+
+    free(buff);
+    return NULL;
+}
+
+
+// Called by the device thread when a StreamStart succeeds
+static void LJSHARED_StartStream(struct LJSHARED_Device *dev, struct LJSHARED_Client *owner)
+{
+    LJUSB_StreamRingInfo info;
+    LJUSB_StreamRing *ring;
+
+    if (dev->packetSize == 0 || dev->ring != NULL) {
+        return;
+    }
+
+    memset(&info, 0, sizeof(info));
+    info.productID = dev->productID;
+    info.numChannels = dev->packetSize/2;
+    info.capacity = LJSHARED_STREAM_PACKETS;
+    info.scanRate = (dev->packetRate > 0) ? dev->packetRate : 1000;
+    info.startTimeNs = LJUSB_GetTimestampNs();
+    snprintf(dev->ringName, sizeof(dev->ringName), "ljshared.%d.%u.%u", (int)getpid(), dev->id, dev->streamCount++);
+
+    ring = LJUSB_StreamRingCreate(dev->ringName, &info);
+    if (ring == NULL) {
+        fprintf(stderr, "ljshared: LJUSB_StreamRingCreate error : %s\n", strerror(errno));
+        return;
+    }
+
+    // The stream is published before the thread starts, so the thread never
+    // sees the read size of the previous stream
+    pthread_mutex_lock(&dev->lock);
+    dev->ring = ring;
+    dev->streamOwner = owner;
+    dev->readSize = 0;
+    dev->streamStop = 0;
+    pthread_mutex_unlock(&dev->lock);
+
+    if (pthread_create(&dev->streamThread, NULL, LJSHARED_StreamThread, dev) != 0) {
+        pthread_mutex_lock(&dev->lock);
+        dev->ring = NULL;
+        dev->streamOwner = NULL;
+        pthread_mutex_unlock(&dev->lock);
+        LJUSB_StreamRingDestroy(ring);
+    }
+}
+
+
+// Called by the device thread after the stream of the device stopped
+static void LJSHARED_StopStream(struct LJSHARED_Device *dev)
+{
+    if (dev->ring == NULL) {
+        return;
+    }
+    dev->streamStop = 1;
+    pthread_join(dev->streamThread, NULL);
+
+    pthread_mutex_lock(&dev->lock);
+    LJUSB_StreamRingDestroy(dev->ring);
+    dev->ring = NULL;
+    dev->streamOwner = NULL;
+    pthread_mutex_unlock(&dev->lock);
+}
+
+
+// Reads and discards the responses a device sends after a failed read, so
+// they are not taken for the responses of later commands
+static void LJSHARED_Drain(struct LJSHARED_Device *dev)
+{
+    BYTE resp[LJUSB_SHARED_MAX_RESPONSE];
+    unsigned int i;
+
+    for (i = 0; i < LJSHARED_DRAIN_MAX; i++) {
+        if (LJUSB_ReadTO(dev->handle, resp, LJUSB_SHARED_MAX_RESPONSE, LJSHARED_DRAIN_TIMEOUT) == 0) {
+            break;
+        }
+    }
+}
+
+
+// Runs the commands of the clients of a device
+static void *LJSHARED_DeviceThread(void *arg)
+{
+    struct LJSHARED_Device *dev = (struct LJSHARED_Device *)arg;
+    struct LJSHARED_Client *clients[LJSHARED_PIPELINE_DEPTH];
+    struct LJSHARED_Command cmds[LJSHARED_PIPELINE_DEPTH];
+    unsigned long long writtenNs[LJSHARED_PIPELINE_DEPTH];
+    BYTE resp[LJUSB_SHARED_MAX_RESPONSE];
+    const BYTE streamStop[2] = {0xB0, 0xB0};
+    LJUSB_SharedMsg msg;
+    struct LJSHARED_Client *c;
+    unsigned int n, i, k, taken;
+    unsigned long size;
+    bool written[LJSHARED_PIPELINE_DEPTH];
+    bool local[LJSHARED_PIPELINE_DEPTH];
+    bool readFailed;
+
+    pthread_mutex_lock(&dev->lock);
+    while (!dev->quit) {
+        // Take the commands in turn from the clients, one from each per round
+        n = 0;
+        if (dev->stopStream) {
+            // The stream owner left: stop its stream before anything else
+            dev->stopStream = false;
+            clients[0] = NULL;
+            memcpy(cmds[0].data, streamStop, 2);
+            cmds[0].size = 2;
+            cmds[0].receivedNs = LJUSB_GetTimestampNs();
+            n = 1;
+        }
+        do {
+            taken = 0;
+            for (k = 0; k < dev->numClients && n < dev->depth; k++) {
+                c = dev->clients[(dev->nextClient + k) % dev->numClients];
+                if (c->queueCount == 0) {
+                    continue;
+                }
+                cmds[n] = c->queue[c->queueHead];
+                c->queueHead = (c->queueHead + 1) % LJUSB_SHARED_MAX_PENDING;
+                c->queueCount--;
+                c->refs++;
+                clients[n++] = c;
+                taken++;
+            }
+        } while (taken > 0 && n < dev->depth);
+        if (dev->numClients > 0) {
+            dev->nextClient = (dev->nextClient + 1) % dev->numClients;
+        }
+        if (n == 0) {
+            pthread_cond_wait(&dev->work, &dev->lock);
+            continue;
+        }
+
+        // A subscriber stopping the stream only stops reading it
+        for (i = 0; i < n; i++) {
+            local[i] = (cmds[i].size == 2 && cmds[i].data[1] == 0xB0 && clients[i] != NULL && dev->ring != NULL &&
+                        dev->streamOwner != clients[i]);
+        }
+        pthread_mutex_unlock(&dev->lock);
+
+        // Write them all, then read the responses in order
+        for (i = 0; i < n; i++) {
+            writtenNs[i] = LJUSB_GetTimestampNs();
+            written[i] = !local[i];
+            if (local[i]) {
+                continue;
+            }
+            if (LJUSB_Write(dev->handle, cmds[i].data, cmds[i].size) != cmds[i].size) {
+                written[i] = false;
+                cmds[i].size = 0;
+            }
+        }
+
+        readFailed = false;
+        for (i = 0; i < n; i++) {
+            memset(&msg, 0, sizeof(msg));
+            msg.type = LJUSB_SHARED_MSG_RESPONSE;
+            msg.handle = dev->id;
+            if (written[i] && readFailed) {
+                // A late response would be taken for this one
+                size = 0;
+                msg.status = EIO;
+            }
+            else if (written[i]) {
+                errno = 0;
+                size = LJUSB_Read(dev->handle, resp, LJUSB_SHARED_MAX_RESPONSE);
+                if (size == 0) {
+                    msg.status = (errno != 0) ? errno : EIO;
+                    readFailed = true;
+                }
+            }
+            else if (local[i]) {
+                // StreamStop response, checksum included
+                resp[0] = 0xB1;
+                resp[1] = 0xB1;
+                resp[2] = 0;
+                resp[3] = 0;
+                size = 4;
+            }
+            else {
+                size = 0;
+                msg.status = EIO;
+            }
+            msg.deviceNs = LJUSB_GetTimestampNs() - writtenNs[i];
+            msg.queueNs = writtenNs[i] - cmds[i].receivedNs;
+            msg.size = (uint32_t)size;
+
+            // StreamConfig, StreamStart and StreamStop that succeeded
+            if (written[i] && cmds[i].size >= 8 && cmds[i].data[1] == 0xF8 && cmds[i].data[3] == 0x11 &&
+                size >= 8 && resp[6] == 0) {
+                dev->packetRate = LJSHARED_PacketRate(dev->productID, cmds[i].data, cmds[i].size, &dev->packetSize);
+            }
+            else if (written[i] && cmds[i].size == 2 && cmds[i].data[1] == 0xA8 && size >= 3 && resp[2] == 0) {
+                LJSHARED_StartStream(dev, clients[i]);
+            }
+            else if (written[i] && cmds[i].size == 2 && cmds[i].data[1] == 0xB0) {
+                LJSHARED_StopStream(dev);
+            }
+
+            if (clients[i] != NULL) {
+                clients[i]->commands++;
+                clients[i]->deviceNs += msg.deviceNs;
+                clients[i]->queueNs += msg.queueNs;
+                if (!clients[i]->closed) {
+                    LJSHARED_Send(clients[i], &msg, resp);
+                }
+            }
+        }
+        if (readFailed) {
+            LJSHARED_Drain(dev);
+        }
+
+        pthread_mutex_lock(&dev->lock);
+        dev->depth = readFailed ? 1 : LJSHARED_PIPELINE_DEPTH;
+        for (i = 0; i < n; i++) {
+            if (clients[i] != NULL && --clients[i]->refs == 0 && clients[i]->closed) {
+                LJSHARED_FreeClient(clients[i]);
+            }
+        }
+    }
+    pthread_mutex_unlock(&dev->lock);
+    return NULL;
+}
+
+
+// Returns the device, opening it and starting its thread the first time.
+// Returns NULL on error and errno is set.
+static struct LJSHARED_Device *LJSHARED_GetDevice(unsigned long productID, unsigned int devNum)
+{
+    struct LJSHARED_Device *dev;
+    unsigned int i;
+
+    for (i = 0; i < gNumDevices; i++) {
+        if (gDevices[i]->productID == productID && gDevices[i]->devNum == devNum) {
+            return gDevices[i];
+        }
+    }
+    if (gNumDevices == LJSHARED_MAX_DEVICES) {
+        errno = ENOSPC;
+        return NULL;
+    }
+
+    dev = (struct LJSHARED_Device *)calloc(1, sizeof(struct LJSHARED_Device));
+    if (dev == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    dev->handle = LJUSB_OpenDevice(devNum, 0, productID);
+    if (dev->handle == NULL) {
+        free(dev);
+        return NULL;
+    }
+    dev->id = gNumDevices + 1;
+    dev->productID = productID;
+    dev->devNum = devNum;
+    dev->releaseNumber = LJUSB_GetDeviceDescriptorReleaseNumber(dev->handle);
+    dev->depth = LJSHARED_PIPELINE_DEPTH;
+    pthread_mutex_init(&dev->lock, NULL);
+    pthread_cond_init(&dev->work, NULL);
+    if (pthread_create(&dev->thread, NULL, LJSHARED_DeviceThread, dev) != 0) {
+        LJUSB_CloseDevice(dev->handle);
+        free(dev);
+        errno = EAGAIN;
+        return NULL;
+    }
+    gDevices[gNumDevices++] = dev;
+    if (gVerbose) {
+        printf("ljshared: opened device %u of product %lu\n", devNum, productID);
+    }
+    return dev;
+}
+
+
+// Handles a message from a client.  Returns 0 to keep the connection, or -1
+// to close it.
+static int LJSHARED_HandleMessage(struct LJSHARED_Client *client)
+{
+    struct LJSHARED_Device *dev;
+    struct LJSHARED_Command *cmd;
+    LJUSB_SharedMsg msg, reply;
+    BYTE data[LJUSB_SHARED_MAX_COMMAND];
+    char name[LJUSB_STREAM_RING_MAX_NAME + 1];
+    unsigned long readSize;
+
+    name[0] = '\0';
+    if (LJSHARED_RecvAll(client->fd, &msg, sizeof(msg)) != 0 || msg.size > sizeof(data) ||
+        LJSHARED_RecvAll(client->fd, data, msg.size) != 0) {
+        return -1;
+    }
+
+    memset(&reply, 0, sizeof(reply));
+    reply.type = msg.type;
+
+    switch (msg.type) {
+    case LJUSB_SHARED_MSG_COUNT:
+        reply.arg = LJUSB_GetDevCount((unsigned long)msg.arg);
+        return LJSHARED_Send(client, &reply, NULL);
+
+    case LJUSB_SHARED_MSG_OPEN:
+        if (client->device != NULL) {
+            return -1;
+        }
+        dev = LJSHARED_GetDevice((unsigned long)(msg.arg >> 32), (unsigned int)(msg.arg & 0xFFFFFFFF));
+        if (dev == NULL) {
+            reply.status = errno;
+            return LJSHARED_Send(client, &reply, NULL);
+        }
+        pthread_mutex_lock(&dev->lock);
+        if (dev->numClients == LJSHARED_MAX_CLIENTS) {
+            pthread_mutex_unlock(&dev->lock);
+            reply.status = EBUSY;
+            return LJSHARED_Send(client, &reply, NULL);
+        }
+        dev->clients[dev->numClients++] = client;
+        client->device = dev;
+        pthread_mutex_unlock(&dev->lock);
+        reply.handle = dev->id;
+        reply.arg = dev->releaseNumber;
+        return LJSHARED_Send(client, &reply, NULL);
+
+    case LJUSB_SHARED_MSG_WRITE:
+        dev = client->device;
+        if (dev == NULL || msg.size == 0) {
+            return -1;
+        }
+        pthread_mutex_lock(&dev->lock);
+        if (client->queueCount == LJUSB_SHARED_MAX_PENDING) {
+            // The client writes ahead of its limit
+            pthread_mutex_unlock(&dev->lock);
+            return -1;
+        }
+        cmd = &client->queue[(client->queueHead + client->queueCount) % LJUSB_SHARED_MAX_PENDING];
+        memcpy(cmd->data, data, msg.size);
+        cmd->size = msg.size;
+        cmd->receivedNs = LJUSB_GetTimestampNs();
+        client->queueCount++;
+        pthread_cond_signal(&dev->work);
+        pthread_mutex_unlock(&dev->lock);
+        return 0;
+
+    case LJUSB_SHARED_MSG_STREAM:
+        if (msg.handle == 0 || msg.handle > gNumDevices) {
+            reply.status = ENODEV;
+            LJSHARED_Send(client, &reply, NULL);
+            return -1;
+        }
+        dev = gDevices[msg.handle - 1];
+        pthread_mutex_lock(&dev->lock);
+        if (dev->ring == NULL) {
+            reply.status = ENODATA;
+        }
+        else {
+            if (dev->readSize == 0) {
+                readSize = (unsigned long)msg.arg;
+                if (readSize > LJSHARED_MAX_STREAM_READ) {
+                    readSize = LJSHARED_MAX_STREAM_READ;
+                }
+                readSize -= readSize % dev->packetSize;
+                dev->readSize = (readSize > 0) ? readSize : dev->packetSize;
+            }
+            strcpy(name, dev->ringName);
+            reply.handle = dev->id;
+            reply.arg = dev->packetSize;
+            reply.size = (uint32_t)strlen(name) + 1;
+        }
+        pthread_mutex_unlock(&dev->lock);
+        LJSHARED_Send(client, &reply, name);
+        return -1;
+    }
+
+    return -1;
+}
+
+
+// Removes a client from its device.  The client is freed once the device
+// thread is done with its commands.
+static void LJSHARED_CloseClient(struct LJSHARED_Client *client)
+{
+    struct LJSHARED_Device *dev = client->device;
+    unsigned int i;
+
+    if (dev == NULL) {
+        LJSHARED_FreeClient(client);
+        return;
+    }
+
+    pthread_mutex_lock(&dev->lock);
+    for (i = 0; i < dev->numClients; i++) {
+        if (dev->clients[i] == client) {
+            dev->clients[i] = dev->clients[--dev->numClients];
+            break;
+        }
+    }
+    client->queueCount = 0;
+    client->closed = true;
+    if (dev->streamOwner == client) {
+        dev->streamOwner = NULL;
+        dev->stopStream = true;
+        pthread_cond_signal(&dev->work);
+    }
+    if (client->refs == 0) {
+        LJSHARED_FreeClient(client);
+    }
+    pthread_mutex_unlock(&dev->lock);
+}
+
+
+static int LJSHARED_Listen(const char *path)
+{
+    struct sockaddr_un addr;
+    int fd;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    unlink(path);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 16) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+
+int main(int argc, char **argv)
+{
+    struct LJSHARED_Client *clients[LJSHARED_MAX_CLIENTS*2];
+    struct pollfd fds[LJSHARED_MAX_CLIENTS*2 + 1];
+    struct LJSHARED_Device *dev;
+    struct LJSHARED_Client *client;
+    struct sigaction sa;
+    const char *path = getenv("LJSHARED_SOCKET");
+    const BYTE streamStop[2] = {0xB0, 0xB0};
+    BYTE resp[LJUSB_SHARED_MAX_RESPONSE];
+    unsigned int numClients = 0, nextId = 1, i;
+    int listenFd, fd, opt, sendBuffer;
+    socklen_t optLen;
+
+    if (path == NULL) {
+        path = LJUSB_SHARED_SOCKET;
+    }
+    while ((opt = getopt(argc, argv, "s:v")) != -1) {
+        switch (opt) {
+        case 's':
+            path = optarg;
+            break;
+        case 'v':
+            gVerbose = 1;
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-s socket] [-v]\n", argv[0]);
+            return 1;
+        }
+    }
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = LJSHARED_OnSignal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    listenFd = LJSHARED_Listen(path);
+    if (listenFd < 0) {
+        fprintf(stderr, "ljshared: cannot listen on %s : %s\n", path, strerror(errno));
+        return 1;
+    }
+    if (gVerbose) {
+        printf("ljshared: listening on %s\n", path);
+    }
+
+    while (!gQuit) {
+        fds[0].fd = listenFd;
+        fds[0].events = POLLIN;
+        for (i = 0; i < numClients; i++) {
+            fds[i + 1].fd = clients[i]->fd;
+            fds[i + 1].events = POLLIN;
+        }
+        if (poll(fds, numClients + 1, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+
+        // Messages first, so closed clients leave room for new ones
+        for (i = numClients; i > 0; i--) {
+            if (fds[i].revents == 0) {
+                continue;
+            }
+            if (LJSHARED_HandleMessage(clients[i - 1]) != 0) {
+                LJSHARED_CloseClient(clients[i - 1]);
+                clients[i - 1] = clients[--numClients];
+            }
+        }
+
+        if (fds[0].revents & POLLIN) {
+            fd = accept(listenFd, NULL, NULL);
+            if (fd < 0) {
+                continue;
+            }
+            if (numClients == LJSHARED_MAX_CLIENTS*2) {
+                close(fd);
+                continue;
+            }
+            client = (struct LJSHARED_Client *)calloc(1, sizeof(struct LJSHARED_Client));
+            if (client == NULL) {
+                close(fd);
+                continue;
+            }
+            // Responses are sent without waiting (LJSHARED_Send), so the
+            // buffer must hold those of every command a client can queue
+            optLen = sizeof(sendBuffer);
+            if (getsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sendBuffer, &optLen) != 0 ||
+                sendBuffer < (int)LJSHARED_SEND_BUFFER) {
+                sendBuffer = (int)LJSHARED_SEND_BUFFER;
+                setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sendBuffer, sizeof(sendBuffer));
+            }
+            client->fd = fd;
+            client->id = nextId++;
+            pthread_mutex_init(&client->sendLock, NULL);
+            clients[numClients++] = client;
+        }
+    }
+
+    // Stop the device threads and any streams left running
+    for (i = 0; i < numClients; i++) {
+        LJSHARED_CloseClient(clients[i]);
+    }
+    for (i = 0; i < gNumDevices; i++) {
+        dev = gDevices[i];
+        pthread_mutex_lock(&dev->lock);
+        dev->quit = true;
+        pthread_cond_signal(&dev->work);
+        pthread_mutex_unlock(&dev->lock);
+        pthread_join(dev->thread, NULL);
+        if (dev->ring != NULL) {
+            if (LJUSB_Write(dev->handle, streamStop, 2) == 2) {
+                LJUSB_Read(dev->handle, resp, LJUSB_SHARED_MAX_RESPONSE);
+            }
+            LJSHARED_StopStream(dev);
+        }
+        LJUSB_CloseDevice(dev->handle);
+    }
+    close(listenFd);
+    unlink(path);
+    return 0;
+}